@@ -1685,6 +1685,14 @@ void __init alternative_instructions(void)
 	 * patching.
 	 */
 
+#ifdef CONFIG_PARAVIRT_SPINLOCKS
+	/*
+	 * Pick the NUMA-aware spinlock slowpath if requested, before the
+	 * paravirt call sites below are patched.
+	 */
+	cna_configure_spin_lock_slowpath();
+#endif
+
 	/*
 	 * Make sure to set (artificial) features depending on used paravirt
 	 * functions which can later influence alternative patching.
@@ -23,6 +23,9 @@
 
 #define CRYPTO_ENGINE_MAX_QLEN 10
 
+/* Most requests handed to a driver's do_requests() in one call */
+#define CRYPTO_ENGINE_MAX_BATCH 16
+
 /* Temporary algorithm flag used to indicate an updated driver. */
 #define CRYPTO_ALG_ENGINE 0x200
 
@@ -43,17 +46,15 @@ static void crypto_finalize_request(struct crypto_engine *engine,
 	unsigned long flags;
 
 	/*
-	 * If hardware cannot enqueue more requests
-	 * and retry mechanism is not supported
-	 * make sure we are completing the current request
+	 * Release the hardware slot of the request so the pump can hand
+	 * the next one to the driver.
 	 */
-	if (!engine->retry_support) {
-		spin_lock_irqsave(&engine->queue_lock, flags);
-		if (engine->cur_req == req) {
-			engine->cur_req = NULL;
-		}
-		spin_unlock_irqrestore(&engine->queue_lock, flags);
-	}
+	spin_lock_irqsave(&engine->queue_lock, flags);
+	if (engine->cur_req == req)
+		engine->cur_req = NULL;
+	if (engine->inflight)
+		engine->inflight--;
+	spin_unlock_irqrestore(&engine->queue_lock, flags);
 
 	lockdep_assert_in_softirq();
 	crypto_request_complete(req, err);
@@ -61,29 +62,46 @@ static void crypto_finalize_request(struct crypto_engine *engine,
 	kthread_queue_work(engine->kworker, &engine->pump_requests);
 }
 
+static struct crypto_engine_op *crypto_engine_req_op(
+	struct crypto_async_request *req)
+{
+	struct crypto_engine_alg *alg;
+
+	if (!(req->tfm->__crt_alg->cra_flags & CRYPTO_ALG_ENGINE))
+		return NULL;
+
+	alg = container_of(req->tfm->__crt_alg, struct crypto_engine_alg, base);
+	return &alg->op;
+}
+
 /**
- * crypto_pump_requests - dequeue one request from engine queue to process
+ * crypto_pump_requests - dequeue requests from engine queue to process
  * @engine: the hardware engine
  * @in_kthread: true if we are in the context of the request pump thread
  *
  * This function checks if there is any request in the engine queue that
  * needs processing and if so call out to the driver to initialize hardware
- * and handle each request.
+ * and handle each request.  Up to @engine->max_inflight requests are
+ * handed to the driver before the first one is finalized; consecutive
+ * requests for an algorithm implementing do_requests are passed to it
+ * in groups of up to @engine->max_batch.
  */
 static void crypto_pump_requests(struct crypto_engine *engine,
 				 bool in_kthread)
 {
-	struct crypto_async_request *async_req, *backlog;
-	struct crypto_engine_alg *alg;
+	struct crypto_async_request *backlogs[CRYPTO_ENGINE_MAX_BATCH];
+	struct crypto_async_request *reqs[CRYPTO_ENGINE_MAX_BATCH];
+	struct crypto_async_request *async_req;
 	struct crypto_engine_op *op;
 	unsigned long flags;
 	bool was_busy = false;
+	unsigned int i, nr;
 	int ret;
 
 	spin_lock_irqsave(&engine->queue_lock, flags);
 
-	/* Make sure we are not already running a request */
-	if (!engine->retry_support && engine->cur_req)
+	/* Make sure there is a free hardware slot */
+	if (engine->inflight >= engine->max_inflight)
 		goto out;
 
 	/* If another context is idling then defer */
@@ -94,7 +112,7 @@ static void crypto_pump_requests(struct crypto_engine *engine,
 
 	/* Check if the engine queue is idle */
 	if (!crypto_queue_len(&engine->queue) || !engine->running) {
-		if (!engine->busy)
+		if (!engine->busy || engine->inflight)
 			goto out;
 
 		/* Only do teardown in the thread */
@@ -118,19 +136,43 @@ static void crypto_pump_requests(struct crypto_engine *engine,
 	}
 
 start_request:
+	if (engine->inflight >= engine->max_inflight)
+		goto out;
+
 	/* Get the fist request from the engine queue to handle */
-	backlog = crypto_get_backlog(&engine->queue);
+	backlogs[0] = crypto_get_backlog(&engine->queue);
 	async_req = crypto_dequeue_request(&engine->queue);
 	if (!async_req)
 		goto out;
+	reqs[0] = async_req;
+	nr = 1;
+
+	/*
+	 * Gather the following requests for the same algorithm while
+	 * there are free slots, if the driver takes them in one go.
+	 */
+	op = crypto_engine_req_op(async_req);
+	while (op && op->do_requests && nr < engine->max_batch &&
+	       engine->inflight + nr < engine->max_inflight &&
+	       crypto_queue_len(&engine->queue)) {
+		struct crypto_async_request *next;
+
+		next = list_first_entry(&engine->queue.list,
+					struct crypto_async_request, list);
+		if (next->tfm->__crt_alg != async_req->tfm->__crt_alg)
+			break;
+
+		backlogs[nr] = crypto_get_backlog(&engine->queue);
+		reqs[nr++] = crypto_dequeue_request(&engine->queue);
+	}
 
 	/*
-	 * If hardware doesn't support the retry mechanism,
-	 * keep track of the request we are processing now.
-	 * We'll need it on completion (crypto_finalize_request).
+	 * Keep track of the request we are processing now and of the
+	 * number of hardware slots in use.  We'll need them on completion
+	 * (crypto_finalize_request).
 	 */
-	if (!engine->retry_support)
-		engine->cur_req = async_req;
+	engine->cur_req = async_req;
+	engine->inflight += nr;
 
 	if (engine->busy)
 		was_busy = true;
@@ -148,17 +190,16 @@ static void crypto_pump_requests(struct crypto_engine *engine,
 		}
 	}
 
-	if (async_req->tfm->__crt_alg->cra_flags & CRYPTO_ALG_ENGINE) {
-		alg = container_of(async_req->tfm->__crt_alg,
-				   struct crypto_engine_alg, base);
-		op = &alg->op;
-	} else {
+	if (!op) {
 		dev_err(engine->dev, "failed to do request\n");
 		ret = -EINVAL;
 		goto req_err_1;
 	}
 
-	ret = op->do_one_request(engine, async_req);
+	if (nr > 1)
+		ret = op->do_requests(engine, (void **)reqs, nr);
+	else
+		ret = op->do_one_request(engine, async_req);
 
 	/* Request unsuccessfully executed by hardware */
 	if (ret < 0) {
@@ -180,7 +221,11 @@ static void crypto_pump_requests(struct crypto_engine *engine,
 		 * back in front of crypto-engine queue, to keep the order
 		 * of requests.
 		 */
-		crypto_enqueue_request_head(&engine->queue, async_req);
+		for (i = nr; i-- > 0; )
+			crypto_enqueue_request_head(&engine->queue, reqs[i]);
+		engine->inflight -= nr;
+		if (engine->cur_req == async_req)
+			engine->cur_req = NULL;
 
 		kthread_queue_work(engine->kworker, &engine->pump_requests);
 		goto out;
@@ -189,15 +234,24 @@ static void crypto_pump_requests(struct crypto_engine *engine,
 	goto retry;
 
 req_err_1:
-	crypto_request_complete(async_req, ret);
+	spin_lock_irqsave(&engine->queue_lock, flags);
+	engine->inflight -= nr;
+	if (engine->cur_req == async_req)
+		engine->cur_req = NULL;
+	spin_unlock_irqrestore(&engine->queue_lock, flags);
+
+	for (i = 0; i < nr; i++)
+		crypto_request_complete(reqs[i], ret);
 
 retry:
-	if (backlog)
-		crypto_request_complete(backlog, -EINPROGRESS);
+	for (i = 0; i < nr; i++)
+		if (backlogs[i])
+			crypto_request_complete(backlogs[i], -EINPROGRESS);
 
-	/* If retry mechanism is supported, send new requests to engine */
-	if (engine->retry_support) {
+	/* Send new requests to engine while hardware slots remain */
+	if (engine->retry_support || engine->max_inflight > 1) {
 		spin_lock_irqsave(&engine->queue_lock, flags);
+		was_busy = true;
 		goto start_request;
 	}
 	return;
@@ -504,6 +558,13 @@ struct crypto_engine *crypto_engine_alloc_init_and_set(struct device *dev,
 	engine->busy = false;
 	engine->idling = false;
 	engine->retry_support = retry_support;
+	/*
+	 * Without retry support, the hardware is assumed to take only one
+	 * request at a time unless the driver says otherwise with
+	 * crypto_engine_set_parallel().
+	 */
+	engine->max_inflight = retry_support ? UINT_MAX : 1;
+	engine->max_batch = 1;
 	engine->priv_data = dev;
 	/*
 	 * Batch requests is possible only if
@@ -533,6 +594,44 @@ struct crypto_engine *crypto_engine_alloc_init_and_set(struct device *dev,
 }
 EXPORT_SYMBOL_GPL(crypto_engine_alloc_init_and_set);
 
+/**
+ * crypto_engine_set_parallel - let the engine use several hardware slots
+ * @engine: the hardware engine, not yet started
+ * @max_inflight: number of requests the hardware can work on at once
+ * @max_batch: most requests passed to an algorithm's do_requests() in one
+ *             call, at most CRYPTO_ENGINE_MAX_BATCH
+ *
+ * By default an engine without retry support hands one request to the
+ * driver and waits for it to be finalized before sending the next.
+ * Drivers for hardware with several slots or rings use this to keep them
+ * all busy; requests are still finalized individually.
+ *
+ * Return: 0 on success, -EINVAL for bad limits, -EBUSY if the engine is
+ * already running.
+ */
+int crypto_engine_set_parallel(struct crypto_engine *engine,
+			       unsigned int max_inflight,
+			       unsigned int max_batch)
+{
+	unsigned long flags;
+	int ret = 0;
+
+	if (!max_inflight || !max_batch || max_batch > CRYPTO_ENGINE_MAX_BATCH)
+		return -EINVAL;
+
+	spin_lock_irqsave(&engine->queue_lock, flags);
+	if (engine->running) {
+		ret = -EBUSY;
+	} else {
+		engine->max_inflight = max_inflight;
+		engine->max_batch = max_batch;
+	}
+	spin_unlock_irqrestore(&engine->queue_lock, flags);
+
+	return ret;
+}
+EXPORT_SYMBOL_GPL(crypto_engine_set_parallel);
+
 /**
  * crypto_engine_alloc_init - allocate crypto hardware engine structure and
  * initialize it.
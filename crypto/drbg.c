@@ -101,6 +101,7 @@
 #include <crypto/internal/cipher.h>
 #include <linux/kernel.h>
 #include <linux/jiffies.h>
+#include <linux/percpu.h>
 
 /***************************************************************
  * Backend cipher definitions available to DRBG
@@ -183,6 +184,17 @@ static const struct drbg_core drbg_cores[] = {
 
 static int drbg_uninstantiate(struct drbg_state *drbg);
 
+/*
+ * With percpu set, every crypto API instance seeded outside of the self
+ * tests serves requests from a separate DRBG per CPU.  Each of those is
+ * instantiated on first use with its own entropy and reseeds on its own
+ * schedule, so callers such as the default RNG no longer serialise on a
+ * single drbg_mutex.
+ */
+static bool drbg_percpu;
+module_param_named(percpu, drbg_percpu, bool, 0644);
+MODULE_PARM_DESC(percpu, "Use one DRBG instance per CPU for crypto API users");
+
 /******************************************************************
  * Generic helper functions
  ******************************************************************/
@@ -1915,9 +1927,76 @@ static int drbg_kcapi_init(struct crypto_tfm *tfm)
 	return 0;
 }
 
+static void drbg_free_pcpu(struct drbg_state *drbg)
+{
+	struct drbg_state *child;
+	int cpu;
+
+	if (!drbg->pcpu)
+		return;
+
+	for_each_possible_cpu(cpu) {
+		child = *per_cpu_ptr(drbg->pcpu, cpu);
+		if (!child)
+			continue;
+		drbg_uninstantiate(child);
+		kfree_sensitive(child);
+	}
+	free_percpu(drbg->pcpu);
+	drbg->pcpu = NULL;
+}
+
 static void drbg_kcapi_cleanup(struct crypto_tfm *tfm)
 {
-	drbg_uninstantiate(crypto_tfm_ctx(tfm));
+	struct drbg_state *drbg = crypto_tfm_ctx(tfm);
+
+	drbg_free_pcpu(drbg);
+	drbg_uninstantiate(drbg);
+}
+
+/*
+ * Return the DRBG serving the current CPU, instantiating it on first use.
+ * The CPU may change under us; that is harmless as every instance has its
+ * own mutex.  Falls back to the parent if a child cannot be set up.
+ */
+static struct drbg_state *drbg_get_pcpu(struct drbg_state *drbg)
+{
+	unsigned int cpu = raw_smp_processor_id();
+	struct drbg_state **slot = per_cpu_ptr(drbg->pcpu, cpu);
+	unsigned int gen = READ_ONCE(drbg->seed_gen);
+	struct drbg_state *child = READ_ONCE(*slot);
+	struct drbg_string pers;
+	u32 id = cpu;
+
+	drbg_string_fill(&pers, (u8 *)&id, sizeof(id));
+
+	if (child) {
+		/* Follow a reseed of the parent with a reseed of our own */
+		if (READ_ONCE(child->seed_gen) != gen &&
+		    !drbg_instantiate(child, &pers, child->core - drbg_cores,
+				      child->pr))
+			WRITE_ONCE(child->seed_gen, gen);
+		return child;
+	}
+
+	child = kzalloc(sizeof(*child), GFP_KERNEL);
+	if (!child)
+		return drbg;
+
+	mutex_init(&child->drbg_mutex);
+	child->seed_gen = gen;
+	if (drbg_instantiate(child, &pers, drbg->core - drbg_cores, drbg->pr)) {
+		kfree_sensitive(child);
+		return drbg;
+	}
+
+	if (cmpxchg(slot, NULL, child)) {
+		drbg_uninstantiate(child);
+		kfree_sensitive(child);
+		child = READ_ONCE(*slot);
+	}
+
+	return child;
 }
 
 /*
@@ -1943,6 +2022,9 @@ static int drbg_kcapi_random(struct crypto_rng *tfm,
 		addtl = &string;
 	}
 
+	if (drbg->pcpu)
+		drbg = drbg_get_pcpu(drbg);
+
 	return drbg_generate_long(drbg, dst, dlen, addtl);
 }
 
@@ -1958,6 +2040,7 @@ static int drbg_kcapi_seed(struct crypto_rng *tfm,
 	struct drbg_string string;
 	struct drbg_string *seed_string = NULL;
 	int coreref = 0;
+	int ret;
 
 	drbg_convert_tfm_core(crypto_tfm_alg_driver_name(tfm_base), &coreref,
 			      &pr);
@@ -1966,7 +2049,21 @@ static int drbg_kcapi_seed(struct crypto_rng *tfm,
 		seed_string = &string;
 	}
 
-	return drbg_instantiate(drbg, seed_string, coreref, pr);
+	ret = drbg_instantiate(drbg, seed_string, coreref, pr);
+	if (ret)
+		return ret;
+
+	/* Children pick the reseed up lazily on their next request */
+	if (drbg->pcpu) {
+		WRITE_ONCE(drbg->seed_gen, drbg->seed_gen + 1);
+		return 0;
+	}
+
+	/* Self tests supply their own entropy and need a single instance */
+	if (drbg_percpu && !list_empty(&drbg->test_data.list))
+		drbg->pcpu = alloc_percpu(struct drbg_state *);
+
+	return 0;
 }
 
 /***************************************************************
@@ -1408,6 +1408,243 @@ static void ecc_point_add(const struct ecc_point *result,
 	apply_z(result->x, result->y, z, curve);
 }
 
+/*
+ * Interleaved wNAF evaluation of u1 * P + u2 * Q.  Both scalars are public
+ * in signature verification, so this trades constant time for far fewer
+ * point additions than the bit-by-bit Shamir loop: one per w + 1 bits on
+ * average for each scalar instead of three in four bits.  Odd multiples
+ * of the NIST generators are computed once and cached with a wider
+ * window, those of any other point are computed per call.
+ */
+#define ECC_WNAF_G		7
+#define ECC_WNAF_P		5
+#define ECC_WNAF_ENTRIES(w)	(1 << ((w) - 2))
+#define ECC_WNAF_LEN		(ECC_MAX_DIGITS * 64 + 1)
+
+struct ecc_wnaf_scratch {
+	s8 naf[2][ECC_WNAF_LEN];
+	u64 tab[2][ECC_WNAF_ENTRIES(ECC_WNAF_P) * 2 * ECC_MAX_DIGITS];
+	u64 tz[ECC_WNAF_ENTRIES(ECC_WNAF_G) * ECC_MAX_DIGITS];
+};
+
+static const struct ecc_curve *const ecc_gtab_curves[] = {
+	&nist_p192, &nist_p256, &nist_p384, &nist_p521,
+};
+static u64 *ecc_gtab[ARRAY_SIZE(ecc_gtab_curves)];
+
+/*
+ * Fill @tab with the affine points P, 3P, 5P, ... (@count of them), stored
+ * as x followed by y.  The multiples are built with co-Z additions of 2P,
+ * so each Z is the previous one times a known factor; those factors are
+ * kept in @tz and a single inversion then normalises the whole table.
+ */
+static void ecc_odd_multiples(u64 *tab, unsigned int count,
+			      const struct ecc_point *pt, u64 *tz,
+			      const struct ecc_curve *curve)
+{
+	const unsigned int ndigits = curve->g.ndigits;
+	u64 dx[ECC_MAX_DIGITS];
+	u64 dy[ECC_MAX_DIGITS];
+	u64 z[ECC_MAX_DIGITS];
+	u64 *ax, *ay;
+	unsigned int i;
+
+	vli_set(tab, pt->x, ndigits);
+	vli_set(tab + ndigits, pt->y, ndigits);
+	if (count == 1)
+		return;
+
+	/* D = 2P, and P brought to the same Z as D in the second slot */
+	vli_set(dx, pt->x, ndigits);
+	vli_set(dy, pt->y, ndigits);
+	vli_clear(z, ndigits);
+	z[0] = 1;
+	ecc_point_double_jacobian(dx, dy, z, curve);
+
+	ax = tab + 2 * ndigits;
+	ay = ax + ndigits;
+	vli_set(ax, pt->x, ndigits);
+	vli_set(ay, pt->y, ndigits);
+	apply_z(ax, ay, z, curve);
+
+	for (i = 1; i < count; i++) {
+		ax = tab + 2 * i * ndigits;
+		ay = ax + ndigits;
+		if (i > 1) {
+			vli_set(ax, ax - 2 * ndigits, ndigits);
+			vli_set(ay, ay - 2 * ndigits, ndigits);
+		}
+
+		/* A + D, with Z multiplied by (X_A - X_D) */
+		vli_mod_sub(tz + i * ndigits, ax, dx, curve->p, ndigits);
+		xycz_add(dx, dy, ax, ay, curve);
+		vli_mod_mult_fast(z, z, tz + i * ndigits, curve);
+	}
+
+	vli_mod_inv(z, z, curve->p, ndigits);
+	for (i = count - 1; i > 0; i--) {
+		ax = tab + 2 * i * ndigits;
+		apply_z(ax, ax + ndigits, z, curve);
+		vli_mod_mult_fast(z, z, tz + i * ndigits, curve);
+	}
+}
+
+static const u64 *ecc_get_gtable(const struct ecc_curve *curve, u64 *tz)
+{
+	const unsigned int count = ECC_WNAF_ENTRIES(ECC_WNAF_G);
+	u64 *tab;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(ecc_gtab_curves); i++)
+		if (ecc_gtab_curves[i] == curve)
+			break;
+	if (i == ARRAY_SIZE(ecc_gtab_curves))
+		return NULL;
+
+	tab = smp_load_acquire(&ecc_gtab[i]);
+	if (tab)
+		return tab;
+
+	tab = kmalloc_array(count * 2, curve->g.ndigits * sizeof(u64),
+			    GFP_KERNEL);
+	if (!tab)
+		return NULL;
+
+	ecc_odd_multiples(tab, count, &curve->g, tz, curve);
+	if (cmpxchg_release(&ecc_gtab[i], NULL, tab)) {
+		kfree(tab);
+		tab = smp_load_acquire(&ecc_gtab[i]);
+	}
+
+	return tab;
+}
+
+/* Width-w non-adjacent form of @scalar, least significant digit first */
+static int ecc_wnaf(s8 *naf, const u64 *scalar, unsigned int w,
+		    unsigned int ndigits)
+{
+	u64 k[ECC_MAX_DIGITS + 1];
+	int len = 0;
+	int d;
+
+	vli_set(k, scalar, ndigits);
+	k[ndigits] = 0;
+
+	while (!vli_is_zero(k, ndigits + 1)) {
+		d = 0;
+		if (k[0] & 1) {
+			d = k[0] & ((1 << w) - 1);
+			if (d >= 1 << (w - 1))
+				d -= 1 << w;
+			if (d > 0)
+				vli_usub(k, k, d, ndigits + 1);
+			else
+				vli_uadd(k, k, -d, ndigits + 1);
+		}
+		naf[len++] = d;
+		vli_rshift1(k, ndigits + 1);
+	}
+
+	return len;
+}
+
+/*
+ * R += d * T for a table entry T, R in Jacobian coordinates.  Unlike the
+ * co-Z addition itself this copes with R being infinity, R == dT and
+ * R == -dT, all of which an attacker choosing the key can arrange.
+ */
+static void ecc_wnaf_add(u64 *rx, u64 *ry, u64 *z, bool *inf,
+			 const u64 *tab, int d, const struct ecc_curve *curve)
+{
+	const unsigned int ndigits = curve->g.ndigits;
+	const u64 *pt = tab + (abs(d) >> 1) * 2 * ndigits;
+	u64 tx[ECC_MAX_DIGITS];
+	u64 ty[ECC_MAX_DIGITS];
+	u64 tz[ECC_MAX_DIGITS];
+
+	vli_set(tx, pt, ndigits);
+	if (d < 0)
+		vli_sub(ty, curve->p, pt + ndigits, ndigits);
+	else
+		vli_set(ty, pt + ndigits, ndigits);
+
+	if (*inf) {
+		vli_set(rx, tx, ndigits);
+		vli_set(ry, ty, ndigits);
+		vli_clear(z, ndigits);
+		z[0] = 1;
+		*inf = false;
+		return;
+	}
+
+	apply_z(tx, ty, z, curve);
+	vli_mod_sub(tz, rx, tx, curve->p, ndigits);
+	if (vli_is_zero(tz, ndigits)) {
+		if (!vli_cmp(ry, ty, ndigits))
+			ecc_point_double_jacobian(rx, ry, z, curve);
+		else
+			*inf = true;
+		return;
+	}
+
+	xycz_add(tx, ty, rx, ry, curve);
+	vli_mod_mult_fast(z, z, tz, curve);
+}
+
+static bool ecc_point_mult_wnaf(const struct ecc_point *result,
+				const u64 *u1, const struct ecc_point *p,
+				const u64 *u2, const struct ecc_point *q,
+				const struct ecc_curve *curve)
+{
+	const unsigned int ndigits = curve->g.ndigits;
+	const unsigned int count = ECC_WNAF_ENTRIES(ECC_WNAF_P);
+	struct ecc_wnaf_scratch *s;
+	u64 z[ECC_MAX_DIGITS];
+	const u64 *tab[2];
+	bool inf = true;
+	int len[2];
+	int i, j;
+
+	s = kmalloc(sizeof(*s), GFP_KERNEL);
+	if (!s)
+		return false;
+
+	tab[0] = p == &curve->g ? ecc_get_gtable(curve, s->tz) : NULL;
+	if (tab[0]) {
+		len[0] = ecc_wnaf(s->naf[0], u1, ECC_WNAF_G, ndigits);
+	} else {
+		ecc_odd_multiples(s->tab[0], count, p, s->tz, curve);
+		tab[0] = s->tab[0];
+		len[0] = ecc_wnaf(s->naf[0], u1, ECC_WNAF_P, ndigits);
+	}
+
+	ecc_odd_multiples(s->tab[1], count, q, s->tz, curve);
+	tab[1] = s->tab[1];
+	len[1] = ecc_wnaf(s->naf[1], u2, ECC_WNAF_P, ndigits);
+
+	for (i = max(len[0], len[1]) - 1; i >= 0; i--) {
+		if (!inf)
+			ecc_point_double_jacobian(result->x, result->y, z,
+						  curve);
+		for (j = 0; j < 2; j++)
+			if (i < len[j] && s->naf[j][i])
+				ecc_wnaf_add(result->x, result->y, z, &inf,
+					     tab[j], s->naf[j][i], curve);
+	}
+
+	kfree(s);
+
+	if (inf) {
+		vli_clear(result->x, ndigits);
+		vli_clear(result->y, ndigits);
+		return true;
+	}
+
+	vli_mod_inv(z, z, curve->p, ndigits);
+	apply_z(result->x, result->y, z, curve);
+	return true;
+}
+
 /* Computes R = u1P + u2Q mod p using Shamir's trick.
  * Based on: Kenneth MacKay's micro-ecc (2014).
  */
@@ -1428,6 +1665,9 @@ void ecc_point_mult_shamir(const struct ecc_point *result,
 	unsigned int idx;
 	int i;
 
+	if (ecc_point_mult_wnaf(result, u1, p, u2, q, curve))
+		return;
+
 	ecc_point_add(&sum, p, q, curve);
 	points[0] = NULL;
 	points[1] = p;
@@ -1715,5 +1955,14 @@ int crypto_ecdh_shared_secret(unsigned int curve_id, unsigned int ndigits,
 }
 EXPORT_SYMBOL(crypto_ecdh_shared_secret);
 
+static void __exit ecc_exit(void)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(ecc_gtab); i++)
+		kfree(ecc_gtab[i]);
+}
+module_exit(ecc_exit);
+
 MODULE_DESCRIPTION("core elliptic curve module");
 MODULE_LICENSE("Dual BSD/GPL");
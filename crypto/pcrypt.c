@@ -15,12 +15,28 @@
 #include <linux/slab.h>
 #include <linux/kobject.h>
 #include <linux/cpu.h>
+#include <linux/percpu.h>
+#include <linux/topology.h>
+#include <linux/workqueue.h>
 #include <crypto/pcrypt.h>
 
 static struct padata_instance *pencrypt;
 static struct padata_instance *pdecrypt;
 static struct kset           *pcrypt_kset;
 
+/*
+ * Unordered tfms bypass padata: each request runs on a cpu picked round
+ * robin and completes as soon as it's done, without waiting for the
+ * requests submitted before it.
+ */
+static struct workqueue_struct *pcrypt_unordered_wq;
+static DEFINE_PER_CPU(unsigned int, pcrypt_unordered_seq);
+
+static bool node_local = true;
+module_param(node_local, bool, 0644);
+MODULE_PARM_DESC(node_local,
+		 "Keep unordered requests on the submitting cpu's NUMA node (default: true)");
+
 struct pcrypt_instance_ctx {
 	struct crypto_aead_spawn spawn;
 	struct padata_shell *psenc;
@@ -31,6 +47,7 @@ struct pcrypt_instance_ctx {
 struct pcrypt_aead_ctx {
 	struct crypto_aead *child;
 	unsigned int cb_cpu;
+	bool unordered;
 };
 
 static inline struct pcrypt_instance_ctx *pcrypt_tfm_ictx(
@@ -89,6 +106,80 @@ static void pcrypt_aead_enc(struct padata_priv *padata)
 	padata_do_serial(padata);
 }
 
+static void pcrypt_aead_unordered_done(void *data, int err)
+{
+	struct aead_request *req = data;
+
+	aead_request_complete(req, err);
+}
+
+static void pcrypt_aead_unordered_work(struct work_struct *work)
+{
+	struct pcrypt_request *preq = container_of(work, struct pcrypt_request,
+						   work);
+	struct aead_request *creq = pcrypt_request_ctx(preq);
+	struct aead_request *req = creq->base.data;
+	int ret;
+
+	if (preq->encrypt)
+		ret = crypto_aead_encrypt(creq);
+	else
+		ret = crypto_aead_decrypt(creq);
+
+	if (ret == -EINPROGRESS || ret == -EBUSY)
+		return;
+
+	local_bh_disable();
+	aead_request_complete(req, ret);
+	local_bh_enable();
+}
+
+static int pcrypt_unordered_cpu(void)
+{
+	const struct cpumask *mask = cpu_online_mask;
+	unsigned int seq, weight;
+	int cpu;
+
+	seq = this_cpu_inc_return(pcrypt_unordered_seq);
+
+	if (READ_ONCE(node_local))
+		mask = cpumask_of_node(numa_node_id());
+
+	weight = cpumask_weight_and(mask, cpu_online_mask);
+	if (!weight)
+		return raw_smp_processor_id();
+
+	cpu = cpumask_nth_and(seq % weight, mask, cpu_online_mask);
+	if (cpu >= nr_cpu_ids)
+		return raw_smp_processor_id();
+
+	return cpu;
+}
+
+static int pcrypt_aead_unordered(struct aead_request *req, bool encrypt)
+{
+	struct pcrypt_request *preq = aead_request_ctx(req);
+	struct aead_request *creq = pcrypt_request_ctx(preq);
+	struct crypto_aead *aead = crypto_aead_reqtfm(req);
+	struct pcrypt_aead_ctx *ctx = crypto_aead_ctx(aead);
+	u32 flags = aead_request_flags(req);
+
+	INIT_WORK(&preq->work, pcrypt_aead_unordered_work);
+	preq->encrypt = encrypt;
+
+	aead_request_set_tfm(creq, ctx->child);
+	aead_request_set_callback(creq, flags & ~CRYPTO_TFM_REQ_MAY_SLEEP,
+				  pcrypt_aead_unordered_done, req);
+	aead_request_set_crypt(creq, req->src, req->dst,
+			       req->cryptlen, req->iv);
+	aead_request_set_ad(creq, req->assoclen);
+
+	queue_work_on(pcrypt_unordered_cpu(), pcrypt_unordered_wq,
+		      &preq->work);
+
+	return -EINPROGRESS;
+}
+
 static int pcrypt_aead_encrypt(struct aead_request *req)
 {
 	int err;
@@ -100,6 +191,9 @@ static int pcrypt_aead_encrypt(struct aead_request *req)
 	u32 flags = aead_request_flags(req);
 	struct pcrypt_instance_ctx *ictx;
 
+	if (READ_ONCE(ctx->unordered))
+		return pcrypt_aead_unordered(req, true);
+
 	ictx = pcrypt_tfm_ictx(aead);
 
 	memset(padata, 0, sizeof(struct padata_priv));
@@ -149,6 +243,9 @@ static int pcrypt_aead_decrypt(struct aead_request *req)
 	u32 flags = aead_request_flags(req);
 	struct pcrypt_instance_ctx *ictx;
 
+	if (READ_ONCE(ctx->unordered))
+		return pcrypt_aead_unordered(req, false);
+
 	ictx = pcrypt_tfm_ictx(aead);
 
 	memset(padata, 0, sizeof(struct padata_priv));
@@ -172,6 +269,33 @@ static int pcrypt_aead_decrypt(struct aead_request *req)
 	return err;
 }
 
+/**
+ * pcrypt_aead_set_unordered - let a pcrypt tfm complete requests out of order
+ * @tfm: tfm allocated from a pcrypt instance
+ * @unordered: whether requests may complete in any order
+ *
+ * For users whose requests are independent of each other, such as
+ * different disk sectors, this skips the padata serialization.  Requests
+ * are spread over the cpus of the submitting node (or all cpus if the
+ * node_local parameter is off) and complete as soon as they are done.
+ * Must not be changed while requests are in flight.
+ *
+ * Return: 0 on success, -EINVAL if @tfm isn't a pcrypt tfm.
+ */
+int pcrypt_aead_set_unordered(struct crypto_aead *tfm, bool unordered)
+{
+	struct pcrypt_aead_ctx *ctx;
+
+	if (crypto_aead_alg(tfm)->encrypt != pcrypt_aead_encrypt)
+		return -EINVAL;
+
+	ctx = crypto_aead_ctx(tfm);
+	WRITE_ONCE(ctx->unordered, unordered);
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(pcrypt_aead_set_unordered);
+
 static int pcrypt_aead_init_tfm(struct crypto_aead *tfm)
 {
 	int cpu, cpu_index;
@@ -345,9 +469,15 @@ static int __init pcrypt_init(void)
 {
 	int err = -ENOMEM;
 
+	pcrypt_unordered_wq = alloc_workqueue("pcrypt_unordered",
+					      WQ_MEM_RECLAIM | WQ_CPU_INTENSIVE,
+					      0);
+	if (!pcrypt_unordered_wq)
+		goto err;
+
 	pcrypt_kset = kset_create_and_add("pcrypt", NULL, kernel_kobj);
 	if (!pcrypt_kset)
-		goto err;
+		goto err_destroy_wq;
 
 	err = pcrypt_init_padata(&pencrypt, "pencrypt");
 	if (err)
@@ -363,6 +493,8 @@ static int __init pcrypt_init(void)
 	padata_free(pencrypt);
 err_unreg_kset:
 	kset_unregister(pcrypt_kset);
+err_destroy_wq:
+	destroy_workqueue(pcrypt_unordered_wq);
 err:
 	return err;
 }
@@ -375,6 +507,8 @@ static void __exit pcrypt_exit(void)
 	padata_free(pdecrypt);
 
 	kset_unregister(pcrypt_kset);
+
+	destroy_workqueue(pcrypt_unordered_wq);
 }
 
 subsys_initcall(pcrypt_init);
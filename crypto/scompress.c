@@ -12,7 +12,9 @@
 #include <crypto/scatterwalk.h>
 #include <linux/cryptouser.h>
 #include <linux/err.h>
+#include <linux/highmem.h>
 #include <linux/kernel.h>
+#include <linux/mm.h>
 #include <linux/module.h>
 #include <linux/scatterlist.h>
 #include <linux/seq_file.h>
@@ -110,43 +112,110 @@ static int crypto_scomp_init_tfm(struct crypto_tfm *tfm)
 	return ret;
 }
 
+/*
+ * Check whether the first @len bytes of @sg can be handed to the algorithm
+ * in place.  Lowmem is linear in the direct map, so any run of physically
+ * contiguous lowmem entries qualifies; highmem only when it fits in the
+ * single page that kmap_local_page() maps.
+ */
+static bool scomp_sg_linear(struct scatterlist *sg, unsigned int len)
+{
+	phys_addr_t next = sg_phys(sg);
+	unsigned int seen = 0;
+
+	if (PageHighMem(sg_page(sg)))
+		return sg->length >= len &&
+		       offset_in_page(sg->offset) + len <= PAGE_SIZE;
+
+	for (; sg && seen < len; sg = sg_next(sg)) {
+		if (sg_phys(sg) != next || PageHighMem(sg_page(sg)))
+			return false;
+		next += sg->length;
+		seen += sg->length;
+	}
+
+	return seen >= len && !PageHighMem(pfn_to_page(PHYS_PFN(next - 1)));
+}
+
+static void *scomp_sg_map(struct scatterlist *sg)
+{
+	struct page *page = sg_page(sg);
+
+	if (PageHighMem(page))
+		return kmap_local_page(nth_page(page, sg->offset / PAGE_SIZE)) +
+		       offset_in_page(sg->offset);
+
+	return page_to_virt(page) + sg->offset;
+}
+
+static void scomp_sg_unmap(struct scatterlist *sg, void *addr)
+{
+	if (PageHighMem(sg_page(sg)))
+		kunmap_local(addr);
+}
+
 static int scomp_acomp_comp_decomp(struct acomp_req *req, int dir)
 {
 	struct crypto_acomp *tfm = crypto_acomp_reqtfm(req);
 	void **tfm_ctx = acomp_tfm_ctx(tfm);
 	struct crypto_scomp *scomp = *tfm_ctx;
 	void **ctx = acomp_request_ctx(req);
-	struct scomp_scratch *scratch;
-	void *src, *dst;
+	struct scomp_scratch *scratch = NULL;
+	void *src, *dst, *sbuf = NULL, *dbuf = NULL;
+	bool src_linear, dst_linear;
 	unsigned int dlen;
+	gfp_t gfp;
 	int ret;
 
-	if (!req->src || !req->slen || req->slen > SCOMP_SCRATCH_SIZE)
+	if (!req->src || !req->slen)
 		return -EINVAL;
 
 	if (req->dst && !req->dlen)
 		return -EINVAL;
 
-	if (!req->dlen || req->dlen > SCOMP_SCRATCH_SIZE)
+	if (!req->dst && (!req->dlen || req->dlen > SCOMP_SCRATCH_SIZE))
 		req->dlen = SCOMP_SCRATCH_SIZE;
 
 	dlen = req->dlen;
+	gfp = req->base.flags & CRYPTO_TFM_REQ_MAY_SLEEP ? GFP_KERNEL :
+							    GFP_ATOMIC;
+
+	src_linear = scomp_sg_linear(req->src, req->slen);
+	dst_linear = req->dst && scomp_sg_linear(req->dst, dlen);
+
+	/*
+	 * Requests that don't fit the per-CPU scratch and can't be used in
+	 * place get a buffer of their own rather than failing.
+	 */
+	if (!src_linear && req->slen > SCOMP_SCRATCH_SIZE) {
+		sbuf = kvmalloc(req->slen, gfp);
+		if (!sbuf)
+			return -ENOMEM;
+	}
+	if (!dst_linear && dlen > SCOMP_SCRATCH_SIZE) {
+		dbuf = kvmalloc(dlen, gfp);
+		if (!dbuf) {
+			kvfree(sbuf);
+			return -ENOMEM;
+		}
+	}
 
-	scratch = raw_cpu_ptr(&scomp_scratch);
-	spin_lock(&scratch->lock);
+	if ((!src_linear && !sbuf) || (!dst_linear && !dbuf)) {
+		scratch = raw_cpu_ptr(&scomp_scratch);
+		spin_lock(&scratch->lock);
+	}
 
-	if (sg_nents(req->src) == 1 && !PageHighMem(sg_page(req->src))) {
-		src = page_to_virt(sg_page(req->src)) + req->src->offset;
+	if (src_linear) {
+		src = scomp_sg_map(req->src);
 	} else {
-		scatterwalk_map_and_copy(scratch->src, req->src, 0,
-					 req->slen, 0);
-		src = scratch->src;
+		src = sbuf ?: scratch->src;
+		scatterwalk_map_and_copy(src, req->src, 0, req->slen, 0);
 	}
 
-	if (req->dst && sg_nents(req->dst) == 1 && !PageHighMem(sg_page(req->dst)))
-		dst = page_to_virt(sg_page(req->dst)) + req->dst->offset;
+	if (dst_linear)
+		dst = scomp_sg_map(req->dst);
 	else
-		dst = scratch->dst;
+		dst = dbuf ?: scratch->dst;
 
 	if (dir)
 		ret = crypto_scomp_compress(scomp, src, req->slen,
@@ -165,8 +234,8 @@ static int scomp_acomp_comp_decomp(struct acomp_req *req, int dir)
 			ret = -ENOSPC;
 			goto out;
 		}
-		if (dst == scratch->dst) {
-			scatterwalk_map_and_copy(scratch->dst, req->dst, 0,
+		if (!dst_linear) {
+			scatterwalk_map_and_copy(dst, req->dst, 0,
 						 req->dlen, 1);
 		} else {
 			int nr_pages = DIV_ROUND_UP(req->dst->offset + req->dlen, PAGE_SIZE);
@@ -174,11 +243,18 @@ static int scomp_acomp_comp_decomp(struct acomp_req *req, int dir)
 			struct page *dst_page = sg_page(req->dst);
 
 			for (i = 0; i < nr_pages; i++)
-				flush_dcache_page(dst_page + i);
+				flush_dcache_page(nth_page(dst_page, i));
 		}
 	}
 out:
-	spin_unlock(&scratch->lock);
+	if (dst_linear)
+		scomp_sg_unmap(req->dst, dst);
+	if (src_linear)
+		scomp_sg_unmap(req->src, src);
+	if (scratch)
+		spin_unlock(&scratch->lock);
+	kvfree(dbuf);
+	kvfree(sbuf);
 	return ret;
 }
 
@@ -19,7 +19,9 @@
 
 #define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
 
+#include <crypto/acompress.h>
 #include <crypto/aead.h>
+#include <crypto/akcipher.h>
 #include <crypto/hash.h>
 #include <crypto/skcipher.h>
 #include <linux/err.h>
@@ -28,6 +30,8 @@
 #include <linux/interrupt.h>
 #include <linux/jiffies.h>
 #include <linux/kernel.h>
+#include <linux/kthread.h>
+#include <linux/ktime.h>
 #include <linux/module.h>
 #include <linux/moduleparam.h>
 #include <linux/scatterlist.h>
@@ -67,6 +71,7 @@ static u32 mask;
 static int mode;
 static u32 num_mb = 8;
 static unsigned int klen;
+static unsigned int threads = 1;
 static char *tvmem[TVMEMSIZE];
 
 static const int block_sizes[] = { 16, 64, 128, 256, 1024, 1420, 4096, 0 };
@@ -1436,6 +1441,674 @@ static void test_cipher_speed(const char *algo, int enc, unsigned int secs,
 				   false);
 }
 
+/*
+ * Benchmark modes (700 and up).  Each of @threads kthreads owns its own
+ * tfm, request and buffers and issues requests back to back for @sec
+ * seconds (one if unset).  Running more threads than CPUs is allowed and
+ * keeps more requests in flight on asynchronous drivers.  Request sizes
+ * cycle through a fixed, weighted distribution so that runs are
+ * repeatable, and every operation is summarised in a single "key=value"
+ * line that scripts can pick out of the kernel log.
+ */
+#define BENCH_MAX_LENS		4
+#define BENCH_MAX_SEQ		16
+#define BENCH_MAX_KEYLEN	64
+#define BENCH_AAD_SIZE		16
+#define BENCH_AUTHSIZE		16
+#define BENCH_RSA_KEYLEN	256
+#define BENCH_HIST_SUB_BITS	3
+#define BENCH_HIST_BUCKETS	(64 << BENCH_HIST_SUB_BITS)
+
+struct bench_size {
+	unsigned int len;
+	unsigned int weight;
+};
+
+/* Simple IMIX: small, medium and full-MTU packets in a 7:4:1 ratio */
+static const struct bench_size bench_imix[] = {
+	{ 64, 7 }, { 576, 4 }, { 1500, 1 }, { 0, 0 }
+};
+
+/* Whole pages, as compressed by zswap and zram */
+static const struct bench_size bench_page[] = {
+	{ PAGE_SIZE, 1 }, { 0, 0 }
+};
+
+static const u8 bench_key[BENCH_MAX_KEYLEN];
+
+struct bench_thread;
+
+struct bench_ops {
+	const char *op[2];
+	int (*init)(struct bench_thread *t);
+	int (*run)(struct bench_thread *t, unsigned int idx);
+	void (*exit)(struct bench_thread *t);
+};
+
+struct bench_ctx {
+	const char *alg;
+	const struct bench_ops *ops;
+	int enc;
+	unsigned long end;
+	struct completion go;
+	unsigned int nlens;
+	unsigned int lens[BENCH_MAX_LENS];
+	unsigned int max_len;
+	unsigned int nseq;
+	u8 seq[BENCH_MAX_SEQ];
+	char driver[CRYPTO_MAX_ALG_NAME];
+};
+
+struct bench_thread {
+	struct bench_ctx *ctx;
+	unsigned int id;
+	struct task_struct *task;
+	struct completion ready;
+	struct completion done;
+	int err;
+
+	struct crypto_tfm *base;
+	void *tfm;
+	void *req;
+	struct crypto_wait wait;
+	u8 *src[BENCH_MAX_LENS];
+	unsigned int slen[BENCH_MAX_LENS];
+	u8 *dst;
+	unsigned int dlen;
+	u8 iv[MAX_IVLEN];
+
+	u64 ops;
+	u64 bytes;
+	u64 cycles;
+	u64 max_ns;
+	u64 stop_ns;
+	u64 hist[BENCH_HIST_BUCKETS];
+};
+
+/*
+ * Latencies are kept in a log-linear histogram: one row per power of two,
+ * split into 2^BENCH_HIST_SUB_BITS columns, i.e. about 12% resolution.
+ */
+static unsigned int bench_hist_idx(u64 ns)
+{
+	unsigned int msb;
+
+	if (ns < (1 << BENCH_HIST_SUB_BITS))
+		return ns;
+
+	msb = fls64(ns) - 1;
+	return ((msb - BENCH_HIST_SUB_BITS + 1) << BENCH_HIST_SUB_BITS) |
+	       ((ns >> (msb - BENCH_HIST_SUB_BITS)) &
+		((1 << BENCH_HIST_SUB_BITS) - 1));
+}
+
+static u64 bench_hist_val(unsigned int idx)
+{
+	unsigned int row = idx >> BENCH_HIST_SUB_BITS;
+	unsigned int col = idx & ((1 << BENCH_HIST_SUB_BITS) - 1);
+
+	if (!row)
+		return col;
+	return (u64)((1 << BENCH_HIST_SUB_BITS) | col) << (row - 1);
+}
+
+static u64 bench_percentile(const u64 *hist, u64 count, unsigned int permille)
+{
+	u64 want = DIV_ROUND_UP_ULL(count * permille, 1000);
+	u64 seen = 0;
+	unsigned int i;
+
+	for (i = 0; i < BENCH_HIST_BUCKETS; i++) {
+		seen += hist[i];
+		if (seen >= want)
+			return bench_hist_val(i);
+	}
+
+	return bench_hist_val(BENCH_HIST_BUCKETS - 1);
+}
+
+/* Text-like data over a 16 letter alphabet, roughly 2:1 compressible */
+static void bench_fill(u8 *buf, unsigned int len)
+{
+	u32 x = 0x2545f491;
+	unsigned int i;
+
+	for (i = 0; i < len; i++) {
+		x = x * 1103515245 + 12345;
+		buf[i] = "etaoinshrdlucmfw"[x >> 28];
+	}
+}
+
+/*
+ * Expand the weighted distribution into a request sequence using smooth
+ * weighted round robin, so that sizes are interleaved rather than issued
+ * in runs.
+ */
+static int bench_init_sizes(struct bench_ctx *ctx,
+			    const struct bench_size *sizes)
+{
+	int cur[BENCH_MAX_LENS] = {};
+	unsigned int total = 0;
+	unsigned int i, j;
+
+	for (i = 0; sizes[i].len; i++) {
+		if (i == BENCH_MAX_LENS)
+			return -EINVAL;
+		ctx->lens[i] = sizes[i].len;
+		ctx->max_len = max(ctx->max_len, sizes[i].len);
+		total += sizes[i].weight;
+	}
+	ctx->nlens = i;
+
+	if (!total || total > BENCH_MAX_SEQ)
+		return -EINVAL;
+
+	for (j = 0; j < total; j++) {
+		unsigned int best = 0;
+
+		for (i = 0; i < ctx->nlens; i++) {
+			cur[i] += sizes[i].weight;
+			if (cur[i] > cur[best])
+				best = i;
+		}
+		cur[best] -= total;
+		ctx->seq[j] = best;
+	}
+	ctx->nseq = total;
+
+	return 0;
+}
+
+static int bench_aead_init(struct bench_thread *t)
+{
+	struct bench_ctx *ctx = t->ctx;
+	struct crypto_aead *tfm;
+	struct aead_request *req;
+	struct scatterlist sg;
+	unsigned int i;
+	int err;
+
+	tfm = crypto_alloc_aead(ctx->alg, 0, 0);
+	if (IS_ERR(tfm))
+		return PTR_ERR(tfm);
+	t->tfm = tfm;
+	t->base = crypto_aead_tfm(tfm);
+
+	if (crypto_aead_ivsize(tfm) > MAX_IVLEN)
+		return -EINVAL;
+
+	err = crypto_aead_setkey(tfm, bench_key, klen ?: 16);
+	if (err)
+		return err;
+
+	err = crypto_aead_setauthsize(tfm, BENCH_AUTHSIZE);
+	if (err)
+		return err;
+
+	req = aead_request_alloc(tfm, GFP_KERNEL);
+	if (!req)
+		return -ENOMEM;
+	t->req = req;
+
+	aead_request_set_callback(req, CRYPTO_TFM_REQ_MAY_BACKLOG,
+				  crypto_req_done, &t->wait);
+	aead_request_set_ad(req, BENCH_AAD_SIZE);
+
+	t->dlen = BENCH_AAD_SIZE + ctx->max_len + BENCH_AUTHSIZE;
+	t->dst = kmalloc(t->dlen, GFP_KERNEL);
+	if (!t->dst)
+		return -ENOMEM;
+
+	for (i = 0; i < ctx->nlens; i++) {
+		t->slen[i] = BENCH_AAD_SIZE + ctx->lens[i] + BENCH_AUTHSIZE;
+		t->src[i] = kmalloc(t->slen[i], GFP_KERNEL);
+		if (!t->src[i])
+			return -ENOMEM;
+		bench_fill(t->src[i], t->slen[i]);
+
+		if (ctx->enc == ENCRYPT)
+			continue;
+
+		/* Decryption needs a valid tag, so encrypt each buffer once */
+		sg_init_one(&sg, t->src[i], t->slen[i]);
+		aead_request_set_crypt(req, &sg, &sg, ctx->lens[i], t->iv);
+		err = crypto_wait_req(crypto_aead_encrypt(req), &t->wait);
+		if (err)
+			return err;
+	}
+
+	return 0;
+}
+
+static int bench_aead_run(struct bench_thread *t, unsigned int idx)
+{
+	struct aead_request *req = t->req;
+	unsigned int len = t->ctx->lens[idx];
+	struct scatterlist src, dst;
+
+	sg_init_one(&src, t->src[idx], t->slen[idx]);
+	sg_init_one(&dst, t->dst, t->slen[idx]);
+
+	if (t->ctx->enc == ENCRYPT) {
+		aead_request_set_crypt(req, &src, &dst, len, t->iv);
+		return crypto_wait_req(crypto_aead_encrypt(req), &t->wait);
+	}
+
+	aead_request_set_crypt(req, &src, &dst, len + BENCH_AUTHSIZE, t->iv);
+	return crypto_wait_req(crypto_aead_decrypt(req), &t->wait);
+}
+
+static void bench_aead_exit(struct bench_thread *t)
+{
+	aead_request_free(t->req);
+	crypto_free_aead(t->tfm);
+}
+
+static const struct bench_ops bench_aead_ops = {
+	.op	= { [ENCRYPT] = "encrypt", [DECRYPT] = "decrypt" },
+	.init	= bench_aead_init,
+	.run	= bench_aead_run,
+	.exit	= bench_aead_exit,
+};
+
+static int bench_acomp_init(struct bench_thread *t)
+{
+	struct bench_ctx *ctx = t->ctx;
+	struct scatterlist src, dst;
+	struct crypto_acomp *tfm;
+	struct acomp_req *req;
+	unsigned int i;
+	u8 *buf;
+	int err;
+
+	tfm = crypto_alloc_acomp(ctx->alg, 0, 0);
+	if (IS_ERR(tfm))
+		return PTR_ERR(tfm);
+	t->tfm = tfm;
+	t->base = crypto_acomp_tfm(tfm);
+
+	req = acomp_request_alloc(tfm);
+	if (!req)
+		return -ENOMEM;
+	t->req = req;
+
+	acomp_request_set_callback(req, CRYPTO_TFM_REQ_MAY_BACKLOG,
+				   crypto_req_done, &t->wait);
+
+	t->dlen = 2 * ctx->max_len;
+	t->dst = kmalloc(t->dlen, GFP_KERNEL);
+	if (!t->dst)
+		return -ENOMEM;
+
+	for (i = 0; i < ctx->nlens; i++) {
+		buf = kmalloc(ctx->lens[i], GFP_KERNEL);
+		if (!buf)
+			return -ENOMEM;
+		bench_fill(buf, ctx->lens[i]);
+
+		if (ctx->enc == ENCRYPT) {
+			t->src[i] = buf;
+			t->slen[i] = ctx->lens[i];
+			continue;
+		}
+
+		/* Decompression is fed the output of one compression */
+		sg_init_one(&src, buf, ctx->lens[i]);
+		sg_init_one(&dst, t->dst, t->dlen);
+		acomp_request_set_params(req, &src, &dst, ctx->lens[i],
+					 t->dlen);
+		err = crypto_wait_req(crypto_acomp_compress(req), &t->wait);
+		kfree(buf);
+		if (err)
+			return err;
+
+		t->slen[i] = req->dlen;
+		t->src[i] = kmemdup(t->dst, req->dlen, GFP_KERNEL);
+		if (!t->src[i])
+			return -ENOMEM;
+	}
+
+	return 0;
+}
+
+static int bench_acomp_run(struct bench_thread *t, unsigned int idx)
+{
+	struct acomp_req *req = t->req;
+	struct scatterlist src, dst;
+
+	sg_init_one(&src, t->src[idx], t->slen[idx]);
+	sg_init_one(&dst, t->dst, t->dlen);
+	acomp_request_set_params(req, &src, &dst, t->slen[idx], t->dlen);
+
+	if (t->ctx->enc == ENCRYPT)
+		return crypto_wait_req(crypto_acomp_compress(req), &t->wait);
+	return crypto_wait_req(crypto_acomp_decompress(req), &t->wait);
+}
+
+static void bench_acomp_exit(struct bench_thread *t)
+{
+	if (t->req)
+		acomp_request_free(t->req);
+	crypto_free_acomp(t->tfm);
+}
+
+static const struct bench_ops bench_acomp_ops = {
+	.op	= { [ENCRYPT] = "compress", [DECRYPT] = "decompress" },
+	.init	= bench_acomp_init,
+	.run	= bench_acomp_run,
+	.exit	= bench_acomp_exit,
+};
+
+/*
+ * Build a BER encoded RSA public key (n, e = 65537) with an all-ones
+ * modulus.  It is not a real key, but public key operations cost the
+ * same as with one, and it saves carrying key material around.
+ */
+static unsigned int bench_rsa_pub_key(u8 *buf, unsigned int nlen)
+{
+	unsigned int ilen = nlen + 1;
+	unsigned int slen = 4 + ilen + 5;
+	u8 *p = buf;
+
+	*p++ = 0x30;
+	*p++ = 0x82;
+	*p++ = slen >> 8;
+	*p++ = slen;
+	*p++ = 0x02;
+	*p++ = 0x82;
+	*p++ = ilen >> 8;
+	*p++ = ilen;
+	*p++ = 0x00;
+	memset(p, 0xff, nlen);
+	p += nlen;
+	*p++ = 0x02;
+	*p++ = 0x03;
+	*p++ = 0x01;
+	*p++ = 0x00;
+	*p++ = 0x01;
+
+	return p - buf;
+}
+
+static int bench_akcipher_init(struct bench_thread *t)
+{
+	struct bench_ctx *ctx = t->ctx;
+	unsigned int nlen = ctx->lens[0];
+	struct crypto_akcipher *tfm;
+	struct akcipher_request *req;
+	unsigned int keylen;
+	u8 *key;
+	int err;
+
+	tfm = crypto_alloc_akcipher(ctx->alg, 0, 0);
+	if (IS_ERR(tfm))
+		return PTR_ERR(tfm);
+	t->tfm = tfm;
+	t->base = crypto_akcipher_tfm(tfm);
+
+	key = kmalloc(nlen + 16, GFP_KERNEL);
+	if (!key)
+		return -ENOMEM;
+	keylen = bench_rsa_pub_key(key, nlen);
+	err = crypto_akcipher_set_pub_key(tfm, key, keylen);
+	kfree(key);
+	if (err)
+		return err;
+
+	req = akcipher_request_alloc(tfm, GFP_KERNEL);
+	if (!req)
+		return -ENOMEM;
+	t->req = req;
+
+	akcipher_request_set_callback(req, CRYPTO_TFM_REQ_MAY_BACKLOG,
+				      crypto_req_done, &t->wait);
+
+	t->dlen = crypto_akcipher_maxsize(tfm);
+	t->dst = kmalloc(t->dlen, GFP_KERNEL);
+	if (!t->dst)
+		return -ENOMEM;
+
+	/* Leading zero byte keeps the message below the modulus */
+	t->slen[0] = nlen;
+	t->src[0] = kmalloc(nlen, GFP_KERNEL);
+	if (!t->src[0])
+		return -ENOMEM;
+	bench_fill(t->src[0], nlen);
+	t->src[0][0] = 0;
+
+	return 0;
+}
+
+static int bench_akcipher_run(struct bench_thread *t, unsigned int idx)
+{
+	struct akcipher_request *req = t->req;
+	struct scatterlist src, dst;
+
+	sg_init_one(&src, t->src[idx], t->slen[idx]);
+	sg_init_one(&dst, t->dst, t->dlen);
+	akcipher_request_set_crypt(req, &src, &dst, t->slen[idx], t->dlen);
+
+	return crypto_wait_req(crypto_akcipher_encrypt(req), &t->wait);
+}
+
+static void bench_akcipher_exit(struct bench_thread *t)
+{
+	akcipher_request_free(t->req);
+	crypto_free_akcipher(t->tfm);
+}
+
+static const struct bench_ops bench_akcipher_ops = {
+	.op	= { [ENCRYPT] = "encrypt" },
+	.init	= bench_akcipher_init,
+	.run	= bench_akcipher_run,
+	.exit	= bench_akcipher_exit,
+};
+
+static int bench_thread_fn(void *data)
+{
+	struct bench_thread *t = data;
+	struct bench_ctx *ctx = t->ctx;
+	unsigned int i, n = 0;
+	u64 start, ns, c;
+	int err;
+
+	crypto_init_wait(&t->wait);
+
+	err = ctx->ops->init(t);
+	if (!err && !t->id)
+		strscpy(ctx->driver, crypto_tfm_alg_driver_name(t->base),
+			sizeof(ctx->driver));
+	t->err = err;
+	complete(&t->ready);
+
+	wait_for_completion(&ctx->go);
+
+	while (!err && time_before(jiffies, ctx->end)) {
+		i = ctx->seq[n++ % ctx->nseq];
+
+		start = ktime_get_ns();
+		c = get_cycles();
+		err = ctx->ops->run(t, i);
+		c = get_cycles() - c;
+		ns = ktime_get_ns() - start;
+		if (err)
+			break;
+
+		t->hist[bench_hist_idx(ns)]++;
+		t->max_ns = max(t->max_ns, ns);
+		t->cycles += c;
+		t->bytes += ctx->lens[i];
+		t->ops++;
+
+		cond_resched();
+	}
+	t->stop_ns = ktime_get_ns();
+	t->err = err;
+
+	ctx->ops->exit(t);
+	for (i = 0; i < BENCH_MAX_LENS; i++)
+		kfree(t->src[i]);
+	kfree(t->dst);
+
+	kthread_complete_and_exit(&t->done, 0);
+}
+
+static void bench_report(struct bench_ctx *ctx, const char *dist,
+			 struct bench_thread *t, unsigned int nthreads,
+			 u64 start)
+{
+	u64 ops = 0, bytes = 0, cycles = 0, max_ns = 0, stop = start;
+	u64 *hist = t[0].hist;
+	unsigned int i, j;
+	u64 elapsed, cpb;
+	u32 rem;
+
+	for (i = 0; i < nthreads; i++) {
+		ops += t[i].ops;
+		bytes += t[i].bytes;
+		cycles += t[i].cycles;
+		max_ns = max(max_ns, t[i].max_ns);
+		stop = max(stop, t[i].stop_ns);
+	}
+
+	for (i = 1; i < nthreads; i++)
+		for (j = 0; j < BENCH_HIST_BUCKETS; j++)
+			hist[j] += t[i].hist[j];
+
+	if (!ops) {
+		pr_err("bench: no %s operations completed for %s\n",
+		       ctx->ops->op[ctx->enc], ctx->alg);
+		return;
+	}
+
+	elapsed = max(stop - start, 1ULL);
+	cpb = div_u64_rem(div64_u64(cycles * 100, bytes), 100, &rem);
+
+	pr_info("bench: alg=%s driver=%s op=%s threads=%u dist=%s ns=%llu ops=%llu bytes=%llu ops_per_sec=%llu mb_per_sec=%llu cycles_per_op=%llu cycles_per_byte=%llu.%02u p50_ns=%llu p90_ns=%llu p99_ns=%llu p999_ns=%llu max_ns=%llu\n",
+		ctx->alg, ctx->driver, ctx->ops->op[ctx->enc], nthreads, dist,
+		elapsed, ops, bytes,
+		div64_u64(ops * NSEC_PER_SEC, elapsed),
+		div64_u64(bytes * 1000, elapsed),
+		div64_u64(cycles, ops), cpb, rem,
+		bench_percentile(hist, ops, 500),
+		bench_percentile(hist, ops, 900),
+		bench_percentile(hist, ops, 990),
+		bench_percentile(hist, ops, 999), max_ns);
+}
+
+static int bench_run(const char *algo, const struct bench_ops *ops, int enc,
+		     const char *dist, const struct bench_size *sizes)
+{
+	unsigned int nthreads = max(threads, 1U);
+	unsigned int secs = sec ?: 1;
+	unsigned int i, started;
+	struct bench_thread *t;
+	struct bench_ctx *ctx;
+	int cpu, err;
+	u64 start;
+
+	ctx = kzalloc(sizeof(*ctx), GFP_KERNEL);
+	t = kvcalloc(nthreads, sizeof(*t), GFP_KERNEL);
+	err = -ENOMEM;
+	if (!ctx || !t)
+		goto out;
+
+	ctx->alg = algo;
+	ctx->ops = ops;
+	ctx->enc = enc;
+	init_completion(&ctx->go);
+	err = bench_init_sizes(ctx, sizes);
+	if (err)
+		goto out;
+
+	/* Spread the threads round robin over the online CPUs */
+	cpu = cpumask_first(cpu_online_mask);
+	for (i = 0; i < nthreads; i++) {
+		t[i].ctx = ctx;
+		t[i].id = i;
+		init_completion(&t[i].ready);
+		init_completion(&t[i].done);
+
+		t[i].task = kthread_create_on_node(bench_thread_fn, &t[i],
+						   cpu_to_node(cpu),
+						   "tcrypt-bench/%u", i);
+		if (IS_ERR(t[i].task)) {
+			err = PTR_ERR(t[i].task);
+			break;
+		}
+		kthread_bind(t[i].task, cpu);
+
+		cpu = cpumask_next(cpu, cpu_online_mask);
+		if (cpu >= nr_cpu_ids)
+			cpu = cpumask_first(cpu_online_mask);
+	}
+	started = i;
+
+	for (i = 0; i < started; i++)
+		wake_up_process(t[i].task);
+
+	for (i = 0; i < started; i++) {
+		wait_for_completion(&t[i].ready);
+		if (t[i].err && !err)
+			err = t[i].err;
+	}
+
+	/* On setup failure the threads see an expired deadline and exit */
+	start = ktime_get_ns();
+	ctx->end = err ? jiffies : jiffies + secs * HZ;
+	complete_all(&ctx->go);
+
+	for (i = 0; i < started; i++) {
+		wait_for_completion(&t[i].done);
+		if (t[i].err && !err)
+			err = t[i].err;
+	}
+
+	if (err) {
+		pr_err("bench: %s %s failed: %d\n", algo, ops->op[enc], err);
+		goto out;
+	}
+
+	bench_report(ctx, dist, t, nthreads, start);
+
+out:
+	kvfree(t);
+	kfree(ctx);
+	return err;
+}
+
+static int bench_aead(const char *algo)
+{
+	int ret;
+
+	if (klen > BENCH_MAX_KEYLEN) {
+		pr_err("bench: key length %u too big\n", klen);
+		return -EINVAL;
+	}
+
+	ret = bench_run(algo, &bench_aead_ops, ENCRYPT, "imix", bench_imix);
+	return min(ret, bench_run(algo, &bench_aead_ops, DECRYPT, "imix",
+				  bench_imix));
+}
+
+static int bench_acomp(const char *algo)
+{
+	int ret;
+
+	ret = bench_run(algo, &bench_acomp_ops, ENCRYPT, "page", bench_page);
+	return min(ret, bench_run(algo, &bench_acomp_ops, DECRYPT, "page",
+				  bench_page));
+}
+
+static int bench_akcipher(const char *algo)
+{
+	struct bench_size sizes[] = {
+		{ klen ?: BENCH_RSA_KEYLEN, 1 }, { 0, 0 }
+	};
+
+	return bench_run(algo, &bench_akcipher_ops, ENCRYPT, "key", sizes);
+}
+
 static inline int tcrypt_test(const char *alg)
 {
 	int ret;
@@ -2816,6 +3489,18 @@ static int do_test(const char *alg, u32 type, u32 mask, int m, u32 num_mb)
 				       speed_template_16_32, num_mb);
 		break;
 
+	case 700:
+		ret = bench_aead(alg ?: "gcm(aes)");
+		break;
+
+	case 701:
+		ret = bench_acomp(alg ?: "deflate");
+		break;
+
+	case 702:
+		ret = bench_akcipher(alg ?: "rsa");
+		break;
+
 	}
 
 	return ret;
@@ -2878,6 +3563,8 @@ module_param(num_mb, uint, 0000);
 MODULE_PARM_DESC(num_mb, "Number of concurrent requests to be used in mb speed tests (defaults to 8)");
 module_param(klen, uint, 0);
 MODULE_PARM_DESC(klen, "Key length (defaults to 0)");
+module_param(threads, uint, 0);
+MODULE_PARM_DESC(threads, "Number of threads used in benchmark modes (defaults to 1)");
 
 MODULE_LICENSE("GPL");
 MODULE_DESCRIPTION("Quick & dirty crypto testing module");
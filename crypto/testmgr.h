@@ -35946,6 +35946,29 @@ static const struct comp_testvec lz4_decomp_tv_template[] = {
 			 "decoder, with speed in multiple GB/s per core, "
 			 "typically reaching RAM speed limits on multi-core "
 			 "systems.",
+	}, {
+		/* Matches with offsets 1, 2 and 4, filled by pattern */
+		.inlen	= 42,
+		.outlen	= 229,
+		.input	= "\x1f\x61\x01\x00\x2c\x2f\x61\x62\x02\x00\x2b\x4f\x61"
+			  "\x62\x63\x64\x04\x00\x29\x1f\x7a\x01\x00\x01\xf0\x01"
+			  "\x4c\x5a\x34\x20\x70\x61\x74\x74\x65\x72\x6e\x20\x66"
+			  "\x69\x6c\x6c",
+		.output	= "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa"
+			  "aaaaaaaaaaaaaaaa"
+			  "abababababababababababababababababababababababab"
+			  "abababababababab"
+			  "abcdabcdabcdabcdabcdabcdabcdabcdabcdabcdabcdabcd"
+			  "abcdabcdabcdabcd"
+			  "zzzzzzzzzzzzzzzzzzzzz"
+			  "LZ4 pattern fill",
+	}, {
+		/* Offset 1 match ending within 12 bytes of the output end */
+		.inlen	= 14,
+		.outlen	= 29,
+		.input	= "\x1f\x79\x01\x00\x01\x80\x4c\x5a\x34\x20\x74"
+			  "\x61\x69\x6c",
+		.output	= "yyyyyyyyyyyyyyyyyyyyyLZ4 tail",
 	},
 };
 
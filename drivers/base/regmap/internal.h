@@ -192,6 +192,8 @@ struct regcache_ops {
 	int (*write)(struct regmap *map, unsigned int reg, unsigned int value);
 	int (*sync)(struct regmap *map, unsigned int min, unsigned int max);
 	int (*drop)(struct regmap *map, unsigned int min, unsigned int max);
+	/* read() may be called without map->lock held */
+	bool lockless_read;
 };
 
 bool regmap_cached(struct regmap *map, unsigned int reg);
@@ -254,6 +256,8 @@ int regcache_init(struct regmap *map, const struct regmap_config *config);
 void regcache_exit(struct regmap *map);
 int regcache_read(struct regmap *map,
 		       unsigned int reg, unsigned int *value);
+int regcache_read_lockless(struct regmap *map,
+			   unsigned int reg, unsigned int *value);
 int regcache_write(struct regmap *map,
 			unsigned int reg, unsigned int value);
 int regcache_sync(struct regmap *map);
@@ -319,7 +323,10 @@ struct regmap_ram_data {
 	bool *read;
 	bool *written;
 	enum regmap_endian reg_endian;
+	unsigned int reg_stride;
 	bool (*noinc_reg)(struct regmap_ram_data *data, unsigned int reg);
+	/* Called after every bus write, raw RAM only */
+	void (*write_hook)(struct regmap_ram_data *data, unsigned int reg);
 };
 
 /*
@@ -9,10 +9,54 @@
 #include <linux/debugfs.h>
 #include <linux/device.h>
 #include <linux/maple_tree.h>
+#include <linux/rcupdate.h>
 #include <linux/slab.h>
 
 #include "internal.h"
 
+/*
+ * Cached values are stored in blocks covering a range of registers.  The
+ * tree is in RCU mode and blocks are freed after a grace period so that
+ * regcache_maple_read() can run without holding map->lock.
+ */
+struct regcache_maple_block {
+	struct rcu_head rcu;
+	unsigned long vals[];
+};
+
+static unsigned long *regcache_maple_alloc(struct regmap *map, size_t n)
+{
+	struct regcache_maple_block *blk;
+
+	blk = kmalloc(struct_size(blk, vals, n), map->alloc_flags);
+	if (!blk)
+		return NULL;
+
+	return blk->vals;
+}
+
+static unsigned long *regcache_maple_dup(struct regmap *map,
+					 const unsigned long *src, size_t n)
+{
+	unsigned long *entry = regcache_maple_alloc(map, n);
+
+	if (entry)
+		memcpy(entry, src, n * sizeof(*entry));
+
+	return entry;
+}
+
+static void regcache_maple_free(unsigned long *entry)
+{
+	struct regcache_maple_block *blk;
+
+	if (!entry)
+		return;
+
+	blk = container_of(entry, struct regcache_maple_block, vals[0]);
+	kfree_rcu(blk, rcu);
+}
+
 static int regcache_maple_read(struct regmap *map,
 			       unsigned int reg, unsigned int *value)
 {
@@ -28,7 +72,7 @@ static int regcache_maple_read(struct regmap *map,
 		return -ENOENT;
 	}
 
-	*value = entry[reg - mas.index];
+	*value = READ_ONCE(entry[reg - mas.index]);
 
 	rcu_read_unlock();
 
@@ -49,7 +93,7 @@ static int regcache_maple_write(struct regmap *map, unsigned int reg,
 
 	entry = mas_walk(&mas);
 	if (entry) {
-		entry[reg - mas.index] = val;
+		WRITE_ONCE(entry[reg - mas.index], val);
 		rcu_read_unlock();
 		return 0;
 	}
@@ -73,8 +117,7 @@ static int regcache_maple_write(struct regmap *map, unsigned int reg,
 
 	rcu_read_unlock();
 
-	entry = kmalloc((last - index + 1) * sizeof(unsigned long),
-			map->alloc_flags);
+	entry = regcache_maple_alloc(map, last - index + 1);
 	if (!entry)
 		return -ENOMEM;
 
@@ -97,10 +140,12 @@ static int regcache_maple_write(struct regmap *map, unsigned int reg,
 	mas_unlock(&mas);
 
 	if (ret == 0) {
-		kfree(lower);
-		kfree(upper);
+		regcache_maple_free(lower);
+		regcache_maple_free(upper);
+	} else {
+		regcache_maple_free(entry);
 	}
-	
+
 	return ret;
 }
 
@@ -133,9 +178,8 @@ static int regcache_maple_drop(struct regmap *map, unsigned int min,
 			lower_index = mas.index;
 			lower_last = min -1;
 
-			lower = kmemdup_array(entry,
-					      min - mas.index, sizeof(*lower),
-					      map->alloc_flags);
+			lower = regcache_maple_dup(map, entry,
+						   min - mas.index);
 			if (!lower) {
 				ret = -ENOMEM;
 				goto out_unlocked;
@@ -146,18 +190,19 @@ static int regcache_maple_drop(struct regmap *map, unsigned int min,
 			upper_index = max + 1;
 			upper_last = mas.last;
 
-			upper = kmemdup_array(&entry[max - mas.index + 1],
-					      mas.last - max, sizeof(*upper),
-					      map->alloc_flags);
+			upper = regcache_maple_dup(map,
+						   &entry[max - mas.index + 1],
+						   mas.last - max);
 			if (!upper) {
 				ret = -ENOMEM;
 				goto out_unlocked;
 			}
 		}
 
-		kfree(entry);
 		mas_lock(&mas);
 		mas_erase(&mas);
+		/* Only once unreachable, lockless readers may still see it */
+		regcache_maple_free(entry);
 
 		/* Insert new nodes with the saved data */
 		if (lower) {
@@ -180,57 +225,54 @@ static int regcache_maple_drop(struct regmap *map, unsigned int min,
 out:
 	mas_unlock(&mas);
 out_unlocked:
-	kfree(lower);
-	kfree(upper);
+	regcache_maple_free(lower);
+	regcache_maple_free(upper);
 
 	return ret;
 }
 
-static int regcache_maple_sync_block(struct regmap *map, unsigned long *entry,
-				     struct ma_state *mas,
-				     unsigned int min, unsigned int max)
-{
+/*
+ * Registers waiting to be synced.  A run only ever holds registers that are
+ * consecutive in the device's address space, so it can be sent as a single
+ * raw write even when it spans several cache blocks.
+ */
+struct regcache_maple_run {
+	unsigned long *vals;
 	void *buf;
-	unsigned long r;
-	size_t val_bytes = map->format.val_bytes;
-	int ret = 0;
+	unsigned int max;
+	unsigned int start;
+	unsigned int len;
+};
 
-	mas_pause(mas);
-	rcu_read_unlock();
+static int regcache_maple_sync_run(struct regmap *map,
+				   struct regcache_maple_run *run)
+{
+	unsigned int i;
+	int ret = 0;
 
 	/*
 	 * Use a raw write if writing more than one register to a
 	 * device that supports raw writes to reduce transaction
 	 * overheads.
 	 */
-	if (max - min > 1 && regmap_can_raw_write(map)) {
-		buf = kmalloc(val_bytes * (max - min), map->alloc_flags);
-		if (!buf) {
-			ret = -ENOMEM;
-			goto out;
-		}
-
-		/* Render the data for a raw write */
-		for (r = min; r < max; r++) {
-			regcache_set_val(map, buf, r - min,
-					 entry[r - mas->index]);
-		}
+	if (run->len > 1 && run->buf) {
+		for (i = 0; i < run->len; i++)
+			regcache_set_val(map, run->buf, i, run->vals[i]);
 
-		ret = _regmap_raw_write(map, min, buf, (max - min) * val_bytes,
+		ret = _regmap_raw_write(map, run->start, run->buf,
+					run->len * map->format.val_bytes,
 					false);
-
-		kfree(buf);
 	} else {
-		for (r = min; r < max; r++) {
-			ret = _regmap_write(map, r,
-					    entry[r - mas->index]);
+		for (i = 0; i < run->len; i++) {
+			ret = _regmap_write(map,
+					    run->start + i * map->reg_stride,
+					    run->vals[i]);
 			if (ret != 0)
-				goto out;
+				break;
 		}
 	}
 
-out:
-	rcu_read_lock();
+	run->len = 0;
 
 	return ret;
 }
@@ -243,9 +285,36 @@ static int regcache_maple_sync(struct regmap *map, unsigned int min,
 	MA_STATE(mas, mt, min, max);
 	unsigned long lmin = min;
 	unsigned long lmax = max;
-	unsigned int r, v, sync_start;
+	struct regcache_maple_run run = { };
+	unsigned long single;
+	unsigned int r, v;
 	int ret = 0;
-	bool sync_needed = false;
+
+	/*
+	 * Size the run for the largest raw write the bus takes, but no
+	 * larger than the range being synced.  Devices without raw writes
+	 * get one register at a time.
+	 */
+	if (regmap_can_raw_write(map)) {
+		run.max = PAGE_SIZE / map->format.val_bytes;
+		if (map->max_raw_write)
+			run.max = clamp_t(size_t,
+					  map->max_raw_write / map->format.val_bytes,
+					  1, run.max);
+		if ((max - min) / map->reg_stride < run.max)
+			run.max = (max - min) / map->reg_stride + 1;
+		run.vals = kmalloc_array(run.max, sizeof(*run.vals),
+					 map->alloc_flags);
+		run.buf = kmalloc_array(run.max, map->format.val_bytes,
+					map->alloc_flags);
+	}
+	if (!run.vals || !run.buf) {
+		kfree(run.vals);
+		kfree(run.buf);
+		run.vals = &single;
+		run.buf = NULL;
+		run.max = 1;
+	}
 
 	map->cache_bypass = true;
 
@@ -255,38 +324,39 @@ static int regcache_maple_sync(struct regmap *map, unsigned int min,
 		for (r = max(mas.index, lmin); r <= min(mas.last, lmax); r++) {
 			v = entry[r - mas.index];
 
-			if (regcache_reg_needs_sync(map, r, v)) {
-				if (!sync_needed) {
-					sync_start = r;
-					sync_needed = true;
-				}
+			if (!regcache_reg_needs_sync(map, r, v))
 				continue;
-			}
 
-			if (!sync_needed)
-				continue;
-
-			ret = regcache_maple_sync_block(map, entry, &mas,
-							sync_start, r);
-			if (ret != 0)
-				goto out;
-			sync_needed = false;
-		}
+			if (run.len &&
+			    (r != run.start + run.len * map->reg_stride ||
+			     run.len == run.max)) {
+				mas_pause(&mas);
+				rcu_read_unlock();
+				ret = regcache_maple_sync_run(map, &run);
+				rcu_read_lock();
+				if (ret != 0)
+					goto out;
+			}
 
-		if (sync_needed) {
-			ret = regcache_maple_sync_block(map, entry, &mas,
-							sync_start, r);
-			if (ret != 0)
-				goto out;
-			sync_needed = false;
+			if (!run.len)
+				run.start = r;
+			run.vals[run.len++] = v;
 		}
 	}
 
 out:
 	rcu_read_unlock();
 
+	if (ret == 0)
+		ret = regcache_maple_sync_run(map, &run);
+
 	map->cache_bypass = false;
 
+	if (run.buf) {
+		kfree(run.vals);
+		kfree(run.buf);
+	}
+
 	return ret;
 }
 
@@ -294,7 +364,7 @@ static int regcache_maple_exit(struct regmap *map)
 {
 	struct maple_tree *mt = map->cache;
 	MA_STATE(mas, mt, 0, UINT_MAX);
-	unsigned int *entry;
+	unsigned long *entry;
 
 	/* if we've already been called then just return */
 	if (!mt)
@@ -302,7 +372,7 @@ static int regcache_maple_exit(struct regmap *map)
 
 	mas_lock(&mas);
 	mas_for_each(&mas, entry, UINT_MAX)
-		kfree(entry);
+		regcache_maple_free(entry);
 	__mt_destroy(mt);
 	mas_unlock(&mas);
 
@@ -320,7 +390,7 @@ static int regcache_maple_insert_block(struct regmap *map, int first,
 	unsigned long *entry;
 	int i, ret;
 
-	entry = kcalloc(last - first + 1, sizeof(unsigned long), map->alloc_flags);
+	entry = regcache_maple_alloc(map, last - first + 1);
 	if (!entry)
 		return -ENOMEM;
 
@@ -336,7 +406,7 @@ static int regcache_maple_insert_block(struct regmap *map, int first,
 	mas_unlock(&mas);
 
 	if (ret)
-		kfree(entry);
+		regcache_maple_free(entry);
 
 	return ret;
 }
@@ -353,7 +423,7 @@ static int regcache_maple_init(struct regmap *map)
 		return -ENOMEM;
 	map->cache = mt;
 
-	mt_init(mt);
+	mt_init_flags(mt, MT_FLAGS_USE_RCU);
 
 	if (!map->num_reg_defaults)
 		return 0;
@@ -392,6 +462,7 @@ struct regcache_ops regcache_maple_ops = {
 	.init = regcache_maple_init,
 	.exit = regcache_maple_exit,
 	.read = regcache_maple_read,
+	.lockless_read = true,
 	.write = regcache_maple_write,
 	.drop = regcache_maple_drop,
 	.sync = regcache_maple_sync,
@@ -258,6 +258,38 @@ int regcache_read(struct regmap *map,
 	return -EINVAL;
 }
 
+/**
+ * regcache_read_lockless - Fetch the value of a given register from the
+ * cache without holding the map lock.
+ *
+ * @map: map to configure.
+ * @reg: The register index.
+ * @value: The value to be returned.
+ *
+ * Only cache types that can be looked up locklessly support this, and only
+ * for registers that a locked regcache_read() would serve from the cache.
+ * On any failure the caller should take the lock and do a normal read.
+ *
+ * Return a negative value on failure, 0 on success.
+ */
+int regcache_read_lockless(struct regmap *map,
+			   unsigned int reg, unsigned int *value)
+{
+	int ret;
+
+	if (!map->cache_ops || !map->cache_ops->lockless_read)
+		return -EOPNOTSUPP;
+
+	if (READ_ONCE(map->cache_bypass) || regmap_volatile(map, reg))
+		return -EINVAL;
+
+	ret = map->cache_ops->read(map, reg, value);
+	if (ret == 0)
+		trace_regmap_reg_read_cache(map, reg, *value);
+
+	return ret;
+}
+
 /**
  * regcache_write - Set the value of a given register in the cache.
  *
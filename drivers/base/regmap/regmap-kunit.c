@@ -7,6 +7,7 @@
 #include <kunit/device.h>
 #include <kunit/resource.h>
 #include <kunit/test.h>
+#include <kunit/test-bug.h>
 #include "internal.h"
 
 #define BLOCK_TEST_SIZE 12
@@ -15,6 +16,13 @@ KUNIT_DEFINE_ACTION_WRAPPER(regmap_exit_action, regmap_exit, struct regmap *);
 
 struct regmap_test_priv {
 	struct device *dev;
+
+	/* For tests acting from the raw RAM write hook */
+	struct regmap *map;
+	unsigned int hook_writes;
+	unsigned int hook_reg;
+	unsigned int hook_val;
+	int hook_ret;
 };
 
 struct regmap_test_param {
@@ -1561,6 +1569,13 @@ static const struct regmap_test_param raw_cache_types_list[] = {
 
 KUNIT_ARRAY_PARAM(raw_test_cache_types, raw_cache_types_list, param_to_desc);
 
+static const struct regmap_test_param raw_maple_types_list[] = {
+	{ .cache = REGCACHE_MAPLE,  .val_endian = REGMAP_ENDIAN_LITTLE },
+	{ .cache = REGCACHE_MAPLE,  .val_endian = REGMAP_ENDIAN_BIG },
+};
+
+KUNIT_ARRAY_PARAM(raw_test_maple_types, raw_maple_types_list, param_to_desc);
+
 static const struct regmap_config raw_regmap_config = {
 	.max_register = BLOCK_TEST_SIZE,
 
@@ -1575,6 +1590,7 @@ static struct regmap *gen_raw_regmap(struct kunit *test,
 {
 	struct regmap_test_priv *priv = test->priv;
 	const struct regmap_test_param *param = test->param_value;
+	unsigned int stride = config->reg_stride ?: 1;
 	u16 *buf;
 	struct regmap *ret = ERR_PTR(-ENOMEM);
 	int i, error;
@@ -1598,7 +1614,7 @@ static struct regmap *gen_raw_regmap(struct kunit *test,
 		goto out_free;
 	(*data)->vals = (void *)buf;
 
-	config->num_reg_defaults = config->max_register + 1;
+	config->num_reg_defaults = config->max_register / stride + 1;
 	defaults = kunit_kcalloc(test,
 				 config->num_reg_defaults,
 				 sizeof(struct reg_default),
@@ -1608,13 +1624,13 @@ static struct regmap *gen_raw_regmap(struct kunit *test,
 	config->reg_defaults = defaults;
 
 	for (i = 0; i < config->num_reg_defaults; i++) {
-		defaults[i].reg = i;
+		defaults[i].reg = i * stride;
 		switch (param->val_endian) {
 		case REGMAP_ENDIAN_LITTLE:
-			defaults[i].def = le16_to_cpu(buf[i]);
+			defaults[i].def = le16_to_cpu(buf[i * stride]);
 			break;
 		case REGMAP_ENDIAN_BIG:
-			defaults[i].def = be16_to_cpu(buf[i]);
+			defaults[i].def = be16_to_cpu(buf[i * stride]);
 			break;
 		default:
 			ret = ERR_PTR(-EINVAL);
@@ -1908,6 +1924,122 @@ static void raw_sync(struct kunit *test)
 	KUNIT_EXPECT_MEMEQ(test, &hw_buf[2], &val[0], sizeof(val));
 }
 
+static void raw_sync_count_writes(struct regmap_ram_data *data,
+				  unsigned int reg)
+{
+	struct kunit *test = kunit_get_current_test();
+	struct regmap_test_priv *priv = test->priv;
+
+	priv->hook_writes++;
+}
+
+static void raw_sync_stride(struct kunit *test)
+{
+	struct regmap_test_priv *priv = test->priv;
+	struct regmap *map;
+	struct regmap_config config;
+	struct regmap_ram_data *data;
+	unsigned int val[BLOCK_TEST_SIZE + 1];
+	unsigned int rval;
+	int i;
+
+	/* Every register is its own cache block with a stride */
+	config = raw_regmap_config;
+	config.reg_stride = 2;
+	config.max_register = BLOCK_TEST_SIZE * config.reg_stride;
+
+	map = gen_raw_regmap(test, &config, &data);
+	KUNIT_ASSERT_FALSE(test, IS_ERR(map));
+	if (IS_ERR(map))
+		return;
+
+	/* Change every register in cache only mode */
+	regcache_cache_only(map, true);
+	for (i = 0; i < ARRAY_SIZE(val); i++) {
+		KUNIT_EXPECT_EQ(test, 0, regmap_read(map, i * 2, &rval));
+		val[i] = ~rval & 0xffff;
+		KUNIT_EXPECT_EQ(test, 0, regmap_write(map, i * 2, val[i]));
+	}
+
+	for (i = 0; i < config.max_register + 1; i++)
+		data->written[i] = false;
+
+	/* The sync should send them all in a single raw write */
+	data->write_hook = raw_sync_count_writes;
+	regcache_cache_only(map, false);
+	KUNIT_EXPECT_EQ(test, 0, regcache_sync(map));
+	data->write_hook = NULL;
+	KUNIT_EXPECT_EQ(test, 1, priv->hook_writes);
+
+	/* And they should have landed in the right registers */
+	regcache_cache_bypass(map, true);
+	for (i = 0; i < ARRAY_SIZE(val); i++) {
+		KUNIT_EXPECT_TRUE(test, data->written[i * 2]);
+		KUNIT_EXPECT_EQ(test, 0, regmap_read(map, i * 2, &rval));
+		KUNIT_EXPECT_EQ(test, val[i], rval);
+	}
+	for (i = 1; i < config.max_register + 1; i += 2)
+		KUNIT_EXPECT_FALSE(test, data->written[i]);
+}
+
+static void raw_sync_read_hook(struct regmap_ram_data *data,
+			       unsigned int reg)
+{
+	struct kunit *test = kunit_get_current_test();
+	struct regmap_test_priv *priv = test->priv;
+
+	if (priv->hook_writes++)
+		return;
+
+	data->read[priv->hook_reg] = false;
+	priv->hook_ret = regmap_read(priv->map, priv->hook_reg,
+				     &priv->hook_val);
+}
+
+static void raw_sync_read(struct kunit *test)
+{
+	struct regmap_test_priv *priv = test->priv;
+	struct regmap *map;
+	struct regmap_config config;
+	struct regmap_ram_data *data;
+	unsigned int val, rval;
+
+	config = raw_regmap_config;
+
+	map = gen_raw_regmap(test, &config, &data);
+	KUNIT_ASSERT_FALSE(test, IS_ERR(map));
+	if (IS_ERR(map))
+		return;
+
+	/* Fill the cache and change one register in cache only mode */
+	KUNIT_EXPECT_EQ(test, 0, regmap_read(map, 2, &rval));
+	regcache_cache_only(map, true);
+	val = ~rval & 0xffff;
+	KUNIT_EXPECT_EQ(test, 0, regmap_write(map, 2, val));
+
+	/*
+	 * A read issued while the sync is writing must not be served from
+	 * the cache without the lock, the sync bypasses it.
+	 */
+	priv->map = map;
+	priv->hook_reg = 2;
+	data->write_hook = raw_sync_read_hook;
+	regcache_cache_only(map, false);
+	KUNIT_EXPECT_EQ(test, 0, regcache_sync(map));
+	data->write_hook = NULL;
+
+	KUNIT_EXPECT_EQ(test, 1, priv->hook_writes);
+	KUNIT_EXPECT_EQ(test, 0, priv->hook_ret);
+	KUNIT_EXPECT_TRUE(test, data->read[2]);
+	KUNIT_EXPECT_EQ(test, val, priv->hook_val);
+
+	/* Once the sync is done reads come from the cache again */
+	data->read[2] = false;
+	KUNIT_EXPECT_EQ(test, 0, regmap_read(map, 2, &rval));
+	KUNIT_EXPECT_EQ(test, val, rval);
+	KUNIT_EXPECT_FALSE(test, data->read[2]);
+}
+
 static void raw_ranges(struct kunit *test)
 {
 	struct regmap *map;
@@ -2007,6 +2139,8 @@ static struct kunit_case regmap_test_cases[] = {
 	KUNIT_CASE_PARAM(raw_write, raw_test_types_gen_params),
 	KUNIT_CASE_PARAM(raw_noinc_write, raw_test_types_gen_params),
 	KUNIT_CASE_PARAM(raw_sync, raw_test_cache_types_gen_params),
+	KUNIT_CASE_PARAM(raw_sync_stride, raw_test_maple_types_gen_params),
+	KUNIT_CASE_PARAM(raw_sync_read, raw_test_maple_types_gen_params),
 	KUNIT_CASE_PARAM(raw_ranges, raw_test_cache_types_gen_params),
 	{}
 };
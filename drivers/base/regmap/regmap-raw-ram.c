@@ -45,12 +45,16 @@ static int regmap_raw_ram_gather_write(void *context,
 		memcpy(&our_buf[r], val + val_len - 2, 2);
 		data->written[r] = true;
 	} else {
-		memcpy(&our_buf[r], val, val_len);
-
-		for (i = 0; i < val_len / 2; i++)
-			data->written[r + i] = true;
+		for (i = 0; i < val_len / 2; i++) {
+			memcpy(&our_buf[r + i * data->reg_stride],
+			       val + i * 2, 2);
+			data->written[r + i * data->reg_stride] = true;
+		}
 	}
-	
+
+	if (data->write_hook)
+		data->write_hook(data, r);
+
 	return 0;
 }
 
@@ -80,10 +84,11 @@ static int regmap_raw_ram_read(void *context,
 			memcpy(val + i, &our_buf[r], 2);
 		data->read[r] = true;
 	} else {
-		memcpy(val, &our_buf[r], val_len);
-
-		for (i = 0; i < val_len / 2; i++)
-			data->read[r + i] = true;
+		for (i = 0; i < val_len / 2; i++) {
+			memcpy(val + i * 2,
+			       &our_buf[r + i * data->reg_stride], 2);
+			data->read[r + i * data->reg_stride] = true;
+		}
 	}
 
 	return 0;
@@ -134,6 +139,7 @@ struct regmap *__regmap_init_raw_ram(struct device *dev,
 		return ERR_PTR(-ENOMEM);
 
 	data->reg_endian = config->reg_format_endian;
+	data->reg_stride = config->reg_stride ?: 1;
 
 	map = __regmap_init(dev, &regmap_raw_ram, data, config,
 			    lock_key, lock_name);
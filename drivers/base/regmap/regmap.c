@@ -2828,6 +2828,10 @@ int regmap_read(struct regmap *map, unsigned int reg, unsigned int *val)
 	if (!IS_ALIGNED(reg, map->reg_stride))
 		return -EINVAL;
 
+	/* Cache hits don't need to serialise against other users */
+	if (regcache_read_lockless(map, reg, val) == 0)
+		return 0;
+
 	map->lock(map->lock_arg);
 
 	ret = _regmap_read(map, reg, val);
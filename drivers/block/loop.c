@@ -69,6 +69,7 @@ struct loop_device {
 	struct rb_root          worker_tree;
 	struct timer_list       timer;
 	bool			use_dio;
+	bool			nowait;
 	bool			sysfs_inited;
 
 	struct request_queue	*lo_queue;
@@ -81,6 +82,7 @@ struct loop_device {
 struct loop_cmd {
 	struct list_head list_entry;
 	bool use_aio; /* use AIO interface to handle I/O */
+	bool nowait_failed; /* inline submission would block, use the worker */
 	atomic_t ref; /* only for aio */
 	long ret;
 	struct kiocb iocb;
@@ -358,22 +360,23 @@ static void lo_complete_rq(struct request *rq)
 	blk_status_t ret = BLK_STS_OK;
 
 	if (!cmd->use_aio || cmd->ret < 0 || cmd->ret == blk_rq_bytes(rq) ||
-	    req_op(rq) != REQ_OP_READ) {
+	    (req_op(rq) != REQ_OP_READ && req_op(rq) != REQ_OP_WRITE)) {
 		if (cmd->ret < 0)
 			ret = errno_to_blk_status(cmd->ret);
 		goto end_io;
 	}
 
 	/*
-	 * Short READ - if we got some data, advance our request and
-	 * retry it. If we got no data, end the rest with EIO.
+	 * Short READ or WRITE, which IOCB_NOWAIT submission can produce - if
+	 * we got some data, advance our request and retry it. If we got no
+	 * data, end the rest with EIO.
 	 */
 	if (cmd->ret) {
 		blk_update_request(rq, BLK_STS_OK, cmd->ret);
 		cmd->ret = 0;
 		blk_mq_requeue_request(rq, true);
 	} else {
-		if (cmd->use_aio) {
+		if (req_op(rq) == REQ_OP_READ) {
 			struct bio *bio = rq->bio;
 
 			while (bio) {
@@ -395,6 +398,15 @@ static void lo_rw_aio_do_completion(struct loop_cmd *cmd)
 		return;
 	kfree(cmd->bvec);
 	cmd->bvec = NULL;
+	/*
+	 * The backing device refused to wait for resources: retry the
+	 * request from the worker, which is allowed to block.
+	 */
+	if (cmd->ret == -EAGAIN && (cmd->iocb.ki_flags & IOCB_NOWAIT)) {
+		cmd->nowait_failed = true;
+		blk_mq_requeue_request(rq, true);
+		return;
+	}
 	if (likely(!blk_should_fake_timeout(rq->q)))
 		blk_mq_complete_request(rq);
 }
@@ -408,7 +420,7 @@ static void lo_rw_aio_complete(struct kiocb *iocb, long ret)
 }
 
 static int lo_rw_aio(struct loop_device *lo, struct loop_cmd *cmd,
-		     loff_t pos, int rw)
+		     loff_t pos, int rw, bool nowait)
 {
 	struct iov_iter iter;
 	struct req_iterator rq_iter;
@@ -427,9 +439,9 @@ static int lo_rw_aio(struct loop_device *lo, struct loop_cmd *cmd,
 	if (rq->bio != rq->biotail) {
 
 		bvec = kmalloc_array(nr_bvec, sizeof(struct bio_vec),
-				     GFP_NOIO);
+				     nowait ? GFP_NOWAIT : GFP_NOIO);
 		if (!bvec)
-			return -EIO;
+			return nowait ? -EAGAIN : -EIO;
 		cmd->bvec = bvec;
 
 		/*
@@ -462,6 +474,8 @@ static int lo_rw_aio(struct loop_device *lo, struct loop_cmd *cmd,
 	cmd->iocb.ki_filp = file;
 	cmd->iocb.ki_complete = lo_rw_aio_complete;
 	cmd->iocb.ki_flags = IOCB_DIRECT;
+	if (nowait)
+		cmd->iocb.ki_flags |= IOCB_NOWAIT;
 	cmd->iocb.ki_ioprio = IOPRIO_PRIO_VALUE(IOPRIO_CLASS_NONE, 0);
 
 	if (rw == ITER_SOURCE)
@@ -469,6 +483,13 @@ static int lo_rw_aio(struct loop_device *lo, struct loop_cmd *cmd,
 	else
 		ret = file->f_op->read_iter(&cmd->iocb, &iter);
 
+	/* Nothing was issued, the caller hands the request to the worker */
+	if (ret == -EAGAIN && nowait) {
+		kfree(cmd->bvec);
+		cmd->bvec = NULL;
+		return -EAGAIN;
+	}
+
 	lo_rw_aio_do_completion(cmd);
 
 	if (ret != -EIOCBQUEUED)
@@ -506,12 +527,12 @@ static int do_req_filebacked(struct loop_device *lo, struct request *rq)
 		return lo_fallocate(lo, rq, pos, FALLOC_FL_PUNCH_HOLE);
 	case REQ_OP_WRITE:
 		if (cmd->use_aio)
-			return lo_rw_aio(lo, cmd, pos, ITER_SOURCE);
+			return lo_rw_aio(lo, cmd, pos, ITER_SOURCE, false);
 		else
 			return lo_write_simple(lo, rq, pos);
 	case REQ_OP_READ:
 		if (cmd->use_aio)
-			return lo_rw_aio(lo, cmd, pos, ITER_DEST);
+			return lo_rw_aio(lo, cmd, pos, ITER_DEST, false);
 		else
 			return lo_read_simple(lo, rq, pos);
 	default:
@@ -520,6 +541,61 @@ static int do_req_filebacked(struct loop_device *lo, struct request *rq)
 	}
 }
 
+/*
+ * Inline submission charges the I/O to the submitting task, so only use it
+ * when that is the cgroup the request belongs to anyway.
+ */
+static bool loop_cmd_css_is_current(struct loop_cmd *cmd)
+{
+#ifdef CONFIG_BLK_CGROUP
+	bool ret;
+
+	if (!cmd->blkcg_css)
+		return true;
+	rcu_read_lock();
+	ret = cmd->blkcg_css == task_css(current, io_cgrp_id);
+	rcu_read_unlock();
+	return ret;
+#else
+	return true;
+#endif
+}
+
+static bool loop_can_nowait(struct loop_device *lo, struct loop_cmd *cmd)
+{
+	struct request *rq = blk_mq_rq_from_pdu(cmd);
+
+	if (cmd->nowait_failed) {
+		cmd->nowait_failed = false;
+		return false;
+	}
+	if (!lo->nowait || !cmd->use_aio ||
+	    !(lo->lo_backing_file->f_mode & FMODE_NOWAIT))
+		return false;
+	if (op_is_write(req_op(rq)) && (lo->lo_flags & LO_FLAGS_READ_ONLY))
+		return false;
+	return loop_cmd_css_is_current(cmd);
+}
+
+/*
+ * Try to issue a direct I/O request to the backing file without blocking.
+ * Returns false if it has to be handed to the worker instead.
+ */
+static bool loop_queue_nowait(struct loop_device *lo, struct loop_cmd *cmd)
+{
+	struct request *rq = blk_mq_rq_from_pdu(cmd);
+	loff_t pos = ((loff_t) blk_rq_pos(rq) << 9) + lo->lo_offset;
+	unsigned int noio_flag;
+	int ret;
+
+	noio_flag = memalloc_noio_save();
+	ret = lo_rw_aio(lo, cmd, pos,
+			op_is_write(req_op(rq)) ? ITER_SOURCE : ITER_DEST, true);
+	memalloc_noio_restore(noio_flag);
+
+	return ret != -EAGAIN;
+}
+
 static inline void loop_update_dio(struct loop_device *lo)
 {
 	__loop_update_dio(lo, (lo->lo_backing_file->f_flags & O_DIRECT) |
@@ -1832,6 +1908,10 @@ static const struct kernel_param_ops loop_hw_qdepth_param_ops = {
 device_param_cb(hw_queue_depth, &loop_hw_qdepth_param_ops, &hw_queue_depth, 0444);
 MODULE_PARM_DESC(hw_queue_depth, "Queue depth for each hardware queue. Default: " __stringify(LOOP_DEFAULT_HW_Q_DEPTH));
 
+static bool nowait;
+module_param(nowait, bool, 0444);
+MODULE_PARM_DESC(nowait, "Issue direct I/O to the backing file from the submitting context with IOCB_NOWAIT, falling back to the worker if it would block. Default: false");
+
 MODULE_DESCRIPTION("Loopback device support");
 MODULE_LICENSE("GPL");
 MODULE_ALIAS_BLOCKDEV_MAJOR(LOOP_MAJOR);
@@ -1863,15 +1943,18 @@ static blk_status_t loop_queue_rq(struct blk_mq_hw_ctx *hctx,
 	cmd->blkcg_css = NULL;
 	cmd->memcg_css = NULL;
 #ifdef CONFIG_BLK_CGROUP
-	if (rq->bio) {
+	if (rq->bio)
 		cmd->blkcg_css = bio_blkcg_css(rq->bio);
-#ifdef CONFIG_MEMCG
-		if (cmd->blkcg_css) {
-			cmd->memcg_css =
-				cgroup_get_e_css(cmd->blkcg_css->cgroup,
-						&memory_cgrp_subsys);
-		}
 #endif
+
+	if (loop_can_nowait(lo, cmd) && loop_queue_nowait(lo, cmd))
+		return BLK_STS_OK;
+
+#if defined(CONFIG_BLK_CGROUP) && defined(CONFIG_MEMCG)
+	if (cmd->blkcg_css) {
+		cmd->memcg_css =
+			cgroup_get_e_css(cmd->blkcg_css->cgroup,
+					&memory_cgrp_subsys);
 	}
 #endif
 	loop_queue_work(lo, cmd);
@@ -2026,6 +2109,10 @@ static int loop_add(int i)
 	lo->tag_set.cmd_size = sizeof(struct loop_cmd);
 	lo->tag_set.flags = BLK_MQ_F_SHOULD_MERGE | BLK_MQ_F_STACKING |
 		BLK_MQ_F_NO_SCHED_BY_DEFAULT;
+	/* inline submission may sleep, e.g. for memory or filesystem locks */
+	lo->nowait = nowait;
+	if (lo->nowait)
+		lo->tag_set.flags |= BLK_MQ_F_BLOCKING;
 	lo->tag_set.driver_data = lo;
 
 	err = blk_mq_alloc_tag_set(&lo->tag_set);
@@ -34,6 +34,7 @@
 #include <linux/slab.h>
 #include <net/sock.h>
 #include <linux/net.h>
+#include <linux/tcp.h>
 #include <linux/kthread.h>
 #include <linux/types.h>
 #include <linux/debugfs.h>
@@ -62,6 +63,7 @@ struct nbd_sock {
 	bool dead;
 	int fallback_index;
 	int cookie;
+	bool corked;
 };
 
 struct recv_thread_args {
@@ -101,6 +103,7 @@ struct nbd_config {
 	atomic_t recv_threads;
 	wait_queue_head_t recv_wq;
 	unsigned int blksize_bits;
+	unsigned int stripe_bits;
 	loff_t bytesize;
 #if IS_ENABLED(CONFIG_DEBUG_FS)
 	struct dentry *dbg_dir;
@@ -352,6 +355,8 @@ static int __nbd_set_size(struct nbd_device *nbd, loff_t bytesize,
 	}
 	lim.logical_block_size = blksize;
 	lim.physical_block_size = blksize;
+	if (nbd->config->stripe_bits)
+		lim.chunk_sectors = 1U << (nbd->config->stripe_bits - SECTOR_SHIFT);
 	error = queue_limits_commit_update(nbd->disk->queue, &lim);
 	if (error)
 		return error;
@@ -601,7 +606,7 @@ static inline int was_interrupted(int result)
  * Returns BLK_STS_IOERR if sending failed.
  */
 static blk_status_t nbd_send_cmd(struct nbd_device *nbd, struct nbd_cmd *cmd,
-				 int index)
+				 int index, bool more)
 {
 	struct request *req = blk_mq_rq_from_pdu(cmd);
 	struct nbd_config *config = nbd->config;
@@ -669,7 +674,7 @@ static blk_status_t nbd_send_cmd(struct nbd_device *nbd, struct nbd_cmd *cmd,
 		req, nbdcmd_to_ascii(type),
 		(unsigned long long)blk_rq_pos(req) << 9, blk_rq_bytes(req));
 	result = sock_xmit(nbd, index, 1, &from,
-			(type == NBD_CMD_WRITE) ? MSG_MORE : 0, &sent);
+			(type == NBD_CMD_WRITE || more) ? MSG_MORE : 0, &sent);
 	trace_nbd_header_sent(req, handle);
 	if (result < 0) {
 		if (was_interrupted(result)) {
@@ -701,7 +706,14 @@ static blk_status_t nbd_send_cmd(struct nbd_device *nbd, struct nbd_cmd *cmd,
 
 		bio_for_each_segment(bvec, bio, iter) {
 			bool is_last = !next && bio_iter_last(bvec, iter);
-			int flags = is_last ? 0 : MSG_MORE;
+			int flags = (is_last && !more) ? 0 : MSG_MORE;
+
+			/*
+			 * Let the socket take references to the bio pages
+			 * instead of copying them, when it is allowed to.
+			 */
+			if (sendpage_ok(bvec.bv_page))
+				flags |= MSG_SPLICE_PAGES;
 
 			dev_dbg(nbd_to_dev(nbd), "request %p: sending %d bytes data\n",
 				req, bvec.bv_len);
@@ -746,6 +758,7 @@ static blk_status_t nbd_send_cmd(struct nbd_device *nbd, struct nbd_cmd *cmd,
 	trace_nbd_payload_sent(req, handle);
 	nsock->pending = NULL;
 	nsock->sent = 0;
+	nsock->corked = more;
 	__set_bit(NBD_CMD_INFLIGHT, &cmd->flags);
 	return BLK_STS_OK;
 
@@ -1030,7 +1043,25 @@ static int wait_for_reconnect(struct nbd_device *nbd)
 	return !test_bit(NBD_RT_DISCONNECTED, &config->runtime_flags);
 }
 
-static blk_status_t nbd_handle_cmd(struct nbd_cmd *cmd, int index)
+/*
+ * With striping, requests carrying data go to the connection owning the
+ * stripe they fall in. The chunk_sectors limit keeps them within a stripe.
+ */
+static int nbd_stripe_index(struct nbd_config *config, struct request *req,
+			    int index)
+{
+	u32 rem;
+
+	if (!config->stripe_bits || config->num_connections <= 1 ||
+	    !blk_rq_sectors(req))
+		return index;
+
+	div_u64_rem(blk_rq_pos(req) >> (config->stripe_bits - SECTOR_SHIFT),
+		    config->num_connections, &rem);
+	return rem;
+}
+
+static blk_status_t nbd_handle_cmd(struct nbd_cmd *cmd, int index, bool last)
 {
 	struct request *req = blk_mq_rq_from_pdu(cmd);
 	struct nbd_device *nbd = cmd->nbd;
@@ -1053,6 +1084,7 @@ static blk_status_t nbd_handle_cmd(struct nbd_cmd *cmd, int index)
 		nbd_config_put(nbd);
 		return BLK_STS_IOERR;
 	}
+	index = nbd_stripe_index(config, req, index);
 	cmd->status = BLK_STS_OK;
 again:
 	nsock = config->socks[index];
@@ -1090,13 +1122,42 @@ static blk_status_t nbd_handle_cmd(struct nbd_cmd *cmd, int index)
 		ret = BLK_STS_OK;
 		goto out;
 	}
-	ret = nbd_send_cmd(nbd, cmd, index);
+	ret = nbd_send_cmd(nbd, cmd, index, !last);
 out:
 	mutex_unlock(&nsock->tx_lock);
 	nbd_config_put(nbd);
 	return ret;
 }
 
+/*
+ * Requests that are not the last of a dispatch batch are sent with MSG_MORE,
+ * so that the socket coalesces them into as few segments as possible. Push
+ * out whatever such requests left queued on the sockets.
+ */
+static void nbd_push_socks(struct nbd_device *nbd)
+{
+	struct nbd_config *config;
+	int i;
+
+	config = nbd_get_config_unlocked(nbd);
+	if (!config)
+		return;
+
+	for (i = 0; i < config->num_connections; i++) {
+		struct nbd_sock *nsock = config->socks[i];
+
+		if (!READ_ONCE(nsock->corked))
+			continue;
+
+		mutex_lock(&nsock->tx_lock);
+		if (nsock->corked && !nsock->dead && sk_is_tcp(nsock->sock->sk))
+			tcp_sock_set_cork(nsock->sock->sk, false);
+		nsock->corked = false;
+		mutex_unlock(&nsock->tx_lock);
+	}
+	nbd_config_put(nbd);
+}
+
 static blk_status_t nbd_queue_rq(struct blk_mq_hw_ctx *hctx,
 			const struct blk_mq_queue_data *bd)
 {
@@ -1120,12 +1181,24 @@ static blk_status_t nbd_queue_rq(struct blk_mq_hw_ctx *hctx,
 	 * this case we need to return that we are busy, otherwise error out as
 	 * appropriate.
 	 */
-	ret = nbd_handle_cmd(cmd, hctx->queue_num);
+	ret = nbd_handle_cmd(cmd, hctx->queue_num, bd->last);
 	mutex_unlock(&cmd->lock);
 
+	/*
+	 * The last request of a batch pushed out its own socket, but with
+	 * striping earlier ones may have left other sockets corked.
+	 */
+	if (bd->last)
+		nbd_push_socks(cmd->nbd);
+
 	return ret;
 }
 
+static void nbd_commit_rqs(struct blk_mq_hw_ctx *hctx)
+{
+	nbd_push_socks(hctx->queue->tag_set->driver_data);
+}
+
 static struct socket *nbd_get_socket(struct nbd_device *nbd, unsigned long fd,
 				     int *err)
 {
@@ -1791,6 +1864,7 @@ static int nbd_init_request(struct blk_mq_tag_set *set, struct request *rq,
 
 static const struct blk_mq_ops nbd_mq_ops = {
 	.queue_rq	= nbd_queue_rq,
+	.commit_rqs	= nbd_commit_rqs,
 	.complete	= nbd_complete_rq,
 	.init_request	= nbd_init_request,
 	.timeout	= nbd_xmit_timeout,
@@ -1931,6 +2005,7 @@ static const struct nla_policy nbd_attr_policy[NBD_ATTR_MAX + 1] = {
 	[NBD_ATTR_DEAD_CONN_TIMEOUT]	=	{ .type = NLA_U64 },
 	[NBD_ATTR_DEVICE_LIST]		=	{ .type = NLA_NESTED},
 	[NBD_ATTR_BACKEND_IDENTIFIER]	=	{ .type = NLA_STRING},
+	[NBD_ATTR_STRIPE_SIZE_BYTES]	=	{ .type = NLA_U64 },
 };
 
 static const struct nla_policy nbd_sock_policy[NBD_SOCK_MAX + 1] = {
@@ -2057,6 +2132,17 @@ static int nbd_genl_connect(struct sk_buff *skb, struct genl_info *info)
 	if (info->attrs[NBD_ATTR_SERVER_FLAGS])
 		config->flags =
 			nla_get_u64(info->attrs[NBD_ATTR_SERVER_FLAGS]);
+	if (info->attrs[NBD_ATTR_STRIPE_SIZE_BYTES]) {
+		u64 stripe = nla_get_u64(info->attrs[NBD_ATTR_STRIPE_SIZE_BYTES]);
+
+		if (!is_power_of_2(stripe) || stripe < nbd_blksize(config) ||
+		    stripe > (u64)UINT_MAX << SECTOR_SHIFT) {
+			pr_err("invalid stripe size %llu\n", stripe);
+			ret = -EINVAL;
+			goto out;
+		}
+		config->stripe_bits = ilog2(stripe);
+	}
 	if (info->attrs[NBD_ATTR_CLIENT_FLAGS]) {
 		u64 flags = nla_get_u64(info->attrs[NBD_ATTR_CLIENT_FLAGS]);
 		if (flags & NBD_CFLAG_DESTROY_ON_DISCONNECT) {
@@ -45,25 +45,27 @@ enum nullb_device_flags {
 	NULLB_DEV_FL_CACHE	= 3,
 };
 
-#define MAP_SZ		((PAGE_SIZE >> SECTOR_SHIFT) + 2)
 /*
  * nullb_page is a page in memory for nullb devices.
  *
- * @page:	The page holding the data.
+ * @page:	The page holding the data, of order nullb_device.memory_order.
+ *		NULL if the device only keeps metadata.
+ * @idx:	Index of the page in the data or cache radix tree.
+ * @flags:	LOCK means the cache page is being flushing to storage. FREE
+ *		means the cache page is freed and should be skipped from
+ *		flushing to storage. Please see null_make_cache_space
  * @bitmap:	The bitmap represents which sector in the page has data.
  *		Each bit represents one block size. For example, sector 8
  *		will use the 7th bit
- * The highest 2 bits of bitmap are for special purpose. LOCK means the cache
- * page is being flushing to storage. FREE means the cache page is freed and
- * should be skipped from flushing to storage. Please see
- * null_make_cache_space
  */
 struct nullb_page {
 	struct page *page;
-	DECLARE_BITMAP(bitmap, MAP_SZ);
+	u64 idx;
+	unsigned long flags;
+	unsigned long bitmap[];
 };
-#define NULLB_PAGE_LOCK (MAP_SZ - 1)
-#define NULLB_PAGE_FREE (MAP_SZ - 2)
+#define NULLB_PAGE_LOCK 0
+#define NULLB_PAGE_FREE 1
 
 static LIST_HEAD(nullb_list);
 static struct mutex lock;
@@ -205,6 +207,14 @@ static unsigned long g_completion_nsec = 10000;
 module_param_named(completion_nsec, g_completion_nsec, ulong, 0444);
 MODULE_PARM_DESC(completion_nsec, "Time in ns to complete a request in hardware. Default: 10,000ns");
 
+static unsigned int g_irq_coalesce_count;
+module_param_named(irq_coalesce_count, g_irq_coalesce_count, uint, 0444);
+MODULE_PARM_DESC(irq_coalesce_count, "Number of completions per coalesced interrupt. Default: 0 (no limit, requires irq_coalesce_usec)");
+
+static unsigned int g_irq_coalesce_usec;
+module_param_named(irq_coalesce_usec, g_irq_coalesce_usec, uint, 0444);
+MODULE_PARM_DESC(irq_coalesce_usec, "Maximum time in us a completion is held back for interrupt coalescing. Default: 0 (no coalescing)");
+
 static int g_hw_queue_depth = 64;
 module_param_named(hw_queue_depth, g_hw_queue_depth, int, 0444);
 MODULE_PARM_DESC(hw_queue_depth, "Queue depth for each hardware queue. Default: 64");
@@ -217,6 +227,14 @@ static bool g_memory_backed;
 module_param_named(memory_backed, g_memory_backed, bool, 0444);
 MODULE_PARM_DESC(memory_backed, "Create a memory-backed block device. Default: false");
 
+static unsigned int g_memory_order;
+module_param_named(memory_order, g_memory_order, uint, 0444);
+MODULE_PARM_DESC(memory_order, "Allocation order of the pages backing a memory-backed device. Default: 0");
+
+static bool g_metadata_only;
+module_param_named(metadata_only, g_metadata_only, bool, 0444);
+MODULE_PARM_DESC(metadata_only, "Only track written sectors of a memory-backed device, discarding the data. Default: false");
+
 static bool g_discard;
 module_param_named(discard, g_discard, bool, 0444);
 MODULE_PARM_DESC(discard, "Support discard operations (requires memory-backed null_blk device). Default: false");
@@ -452,8 +470,12 @@ NULLB_DEVICE_ATTR(index, uint, NULL);
 NULLB_DEVICE_ATTR(blocking, bool, NULL);
 NULLB_DEVICE_ATTR(use_per_node_hctx, bool, NULL);
 NULLB_DEVICE_ATTR(memory_backed, bool, NULL);
+NULLB_DEVICE_ATTR(memory_order, uint, NULL);
+NULLB_DEVICE_ATTR(metadata_only, bool, NULL);
 NULLB_DEVICE_ATTR(discard, bool, NULL);
 NULLB_DEVICE_ATTR(mbps, uint, NULL);
+NULLB_DEVICE_ATTR(irq_coalesce_count, uint, NULL);
+NULLB_DEVICE_ATTR(irq_coalesce_usec, uint, NULL);
 NULLB_DEVICE_ATTR(cache_size, ulong, NULL);
 NULLB_DEVICE_ATTR(zoned, bool, NULL);
 NULLB_DEVICE_ATTR(zone_size, ulong, NULL);
@@ -568,6 +590,113 @@ static ssize_t nullb_device_badblocks_store(struct config_item *item,
 }
 CONFIGFS_ATTR(nullb_device_, badblocks);
 
+/*
+ * The completion latency distribution is written as a list of
+ * "<percentile>:<nsec>" points, e.g. "50:10000 99:50000 99.9:200000", with
+ * increasing percentiles and non-decreasing latencies. Percentiles take up
+ * to two decimals. Latencies between two points are linearly interpolated,
+ * latencies below the first point and above the last one are clamped to
+ * that point. An empty string reverts to the fixed completion_nsec.
+ */
+static ssize_t nullb_device_completion_lat_show(struct config_item *item,
+						char *page)
+{
+	struct nullb_device *dev = to_nullb_device(item);
+	ssize_t len = 0;
+	unsigned int i;
+
+	for (i = 0; i < dev->nr_lat_entries; i++) {
+		struct nullb_lat_entry *e = &dev->lat[i];
+
+		len += scnprintf(page + len, PAGE_SIZE - len, "%s%u.%02u:%llu",
+				 i ? " " : "", e->pct / 100, e->pct % 100,
+				 e->nsec);
+	}
+	len += scnprintf(page + len, PAGE_SIZE - len, "\n");
+	return len;
+}
+
+static int null_parse_lat_pct(char *str, unsigned int *pct)
+{
+	char *frac = strchr(str, '.');
+	unsigned int val, fval = 0;
+	size_t flen = 0;
+	int ret;
+
+	if (frac) {
+		*frac++ = '\0';
+		flen = strlen(frac);
+		if (!flen || flen > 2)
+			return -EINVAL;
+		ret = kstrtouint(frac, 10, &fval);
+		if (ret)
+			return ret;
+		if (flen == 1)
+			fval *= 10;
+	}
+
+	ret = kstrtouint(str, 10, &val);
+	if (ret)
+		return ret;
+	if (val > 100 || val * 100 + fval > NULLB_LAT_PCT_MAX)
+		return -EINVAL;
+
+	*pct = val * 100 + fval;
+	return 0;
+}
+
+static ssize_t nullb_device_completion_lat_store(struct config_item *item,
+						 const char *page, size_t count)
+{
+	struct nullb_device *dev = to_nullb_device(item);
+	struct nullb_lat_entry lat[NULLB_LAT_MAX_ENTRIES];
+	unsigned int nr = 0;
+	char *orig, *buf, *tok;
+	ssize_t ret;
+
+	if (test_bit(NULLB_DEV_FL_CONFIGURED, &dev->flags))
+		return -EBUSY;
+
+	orig = kstrndup(page, count, GFP_KERNEL);
+	if (!orig)
+		return -ENOMEM;
+
+	buf = strim(orig);
+	while ((tok = strsep(&buf, " \t,")) != NULL) {
+		struct nullb_lat_entry *e = &lat[nr];
+		char *nsec;
+
+		if (!*tok)
+			continue;
+		ret = -EINVAL;
+		if (nr == NULLB_LAT_MAX_ENTRIES)
+			goto out;
+		nsec = strchr(tok, ':');
+		if (!nsec)
+			goto out;
+		*nsec++ = '\0';
+		ret = null_parse_lat_pct(tok, &e->pct);
+		if (ret)
+			goto out;
+		ret = kstrtou64(nsec, 10, &e->nsec);
+		if (ret)
+			goto out;
+		ret = -EINVAL;
+		if (nr && (e->pct <= lat[nr - 1].pct ||
+			   e->nsec < lat[nr - 1].nsec))
+			goto out;
+		nr++;
+	}
+
+	memcpy(dev->lat, lat, nr * sizeof(lat[0]));
+	dev->nr_lat_entries = nr;
+	ret = count;
+out:
+	kfree(orig);
+	return ret;
+}
+CONFIGFS_ATTR(nullb_device_, completion_lat);
+
 static ssize_t nullb_device_zone_readonly_store(struct config_item *item,
 						const char *page, size_t count)
 {
@@ -602,8 +731,13 @@ static struct configfs_attribute *nullb_device_attrs[] = {
 	&nullb_device_attr_use_per_node_hctx,
 	&nullb_device_attr_power,
 	&nullb_device_attr_memory_backed,
+	&nullb_device_attr_memory_order,
+	&nullb_device_attr_metadata_only,
 	&nullb_device_attr_discard,
 	&nullb_device_attr_mbps,
+	&nullb_device_attr_irq_coalesce_count,
+	&nullb_device_attr_irq_coalesce_usec,
+	&nullb_device_attr_completion_lat,
 	&nullb_device_attr_cache_size,
 	&nullb_device_attr_badblocks,
 	&nullb_device_attr_zoned,
@@ -700,8 +834,10 @@ static ssize_t memb_group_features_show(struct config_item *item, char *page)
 {
 	return snprintf(page, PAGE_SIZE,
 			"badblocks,blocking,blocksize,cache_size,fua,"
-			"completion_nsec,discard,home_node,hw_queue_depth,"
-			"irqmode,max_sectors,mbps,memory_backed,no_sched,"
+			"completion_lat,completion_nsec,discard,home_node,"
+			"hw_queue_depth,irq_coalesce_count,irq_coalesce_usec,"
+			"irqmode,max_sectors,mbps,memory_backed,memory_order,"
+			"metadata_only,no_sched,"
 			"poll_queues,power,queue_mode,shared_tag_bitmap,"
 			"shared_tags,size,submit_queues,use_per_node_hctx,"
 			"virt_boundary,zoned,zone_capacity,zone_max_active,"
@@ -776,9 +912,13 @@ static struct nullb_device *null_alloc_dev(void)
 	dev->hw_queue_depth = g_hw_queue_depth;
 	dev->blocking = g_blocking;
 	dev->memory_backed = g_memory_backed;
+	dev->memory_order = g_memory_order;
+	dev->metadata_only = g_metadata_only;
 	dev->discard = g_discard;
 	dev->cache_size = g_cache_size;
 	dev->mbps = g_mbps;
+	dev->irq_coalesce_count = g_irq_coalesce_count;
+	dev->irq_coalesce_usec = g_irq_coalesce_usec;
 	dev->use_per_node_hctx = g_use_per_node_hctx;
 	dev->zoned = g_zoned;
 	dev->zone_size = g_zone_size;
@@ -807,17 +947,114 @@ static void null_free_dev(struct nullb_device *dev)
 	kfree(dev);
 }
 
+static void null_coalesce_flush(struct nullb_device *dev,
+				struct list_head *list)
+{
+	struct request *rq, *next;
+
+	list_for_each_entry_safe(rq, next, list, queuelist) {
+		struct nullb_cmd *cmd = blk_mq_rq_to_pdu(rq);
+
+		list_del_init(&rq->queuelist);
+		if (dev->irqmode == NULL_IRQ_SOFTIRQ)
+			blk_mq_complete_request(rq);
+		else
+			blk_mq_end_request(rq, cmd->error);
+	}
+}
+
+static enum hrtimer_restart null_coalesce_timer_fn(struct hrtimer *timer)
+{
+	struct nullb_queue *nq =
+		container_of(timer, struct nullb_queue, coalesce_timer);
+	unsigned long flags;
+	LIST_HEAD(list);
+
+	spin_lock_irqsave(&nq->coalesce_lock, flags);
+	list_splice_init(&nq->coalesce_list, &list);
+	nq->coalesce_nr = 0;
+	spin_unlock_irqrestore(&nq->coalesce_lock, flags);
+
+	null_coalesce_flush(nq->dev, &list);
+	return HRTIMER_NORESTART;
+}
+
+/*
+ * Emulate interrupt coalescing: hold the completion back until either
+ * irq_coalesce_count completions are pending on the queue or the oldest
+ * one has waited for irq_coalesce_usec, then complete them all at once.
+ */
+static void null_coalesce_cmd(struct nullb_cmd *cmd)
+{
+	struct nullb_queue *nq = cmd->nq;
+	struct nullb_device *dev = nq->dev;
+	unsigned long flags;
+	LIST_HEAD(list);
+
+	spin_lock_irqsave(&nq->coalesce_lock, flags);
+	list_add_tail(&blk_mq_rq_from_pdu(cmd)->queuelist, &nq->coalesce_list);
+	if (dev->irq_coalesce_count &&
+	    ++nq->coalesce_nr >= dev->irq_coalesce_count) {
+		list_splice_init(&nq->coalesce_list, &list);
+		nq->coalesce_nr = 0;
+		hrtimer_try_to_cancel(&nq->coalesce_timer);
+	} else if (list_is_singular(&nq->coalesce_list)) {
+		hrtimer_start(&nq->coalesce_timer,
+			      ns_to_ktime((u64)dev->irq_coalesce_usec *
+					  NSEC_PER_USEC),
+			      HRTIMER_MODE_REL);
+	}
+	spin_unlock_irqrestore(&nq->coalesce_lock, flags);
+
+	null_coalesce_flush(dev, &list);
+}
+
 static enum hrtimer_restart null_cmd_timer_expired(struct hrtimer *timer)
 {
 	struct nullb_cmd *cmd = container_of(timer, struct nullb_cmd, timer);
 
-	blk_mq_end_request(blk_mq_rq_from_pdu(cmd), cmd->error);
+	if (cmd->nq->dev->irq_coalesce_usec)
+		null_coalesce_cmd(cmd);
+	else
+		blk_mq_end_request(blk_mq_rq_from_pdu(cmd), cmd->error);
 	return HRTIMER_NORESTART;
 }
 
+/*
+ * Sample a completion latency from the configured distribution, linearly
+ * interpolating between the two points around a random percentile.
+ */
+static u64 null_sample_latency(struct nullb_device *dev)
+{
+	unsigned int r = get_random_u32_below(NULLB_LAT_PCT_MAX);
+	struct nullb_lat_entry *prev = NULL;
+	unsigned int i;
+
+	for (i = 0; i < dev->nr_lat_entries; i++) {
+		struct nullb_lat_entry *e = &dev->lat[i];
+
+		if (r < e->pct) {
+			if (!prev)
+				return e->nsec;
+			return prev->nsec + div_u64((e->nsec - prev->nsec) *
+						    (r - prev->pct),
+						    e->pct - prev->pct);
+		}
+		prev = e;
+	}
+
+	return prev->nsec;
+}
+
 static void null_cmd_end_timer(struct nullb_cmd *cmd)
 {
-	ktime_t kt = cmd->nq->dev->completion_nsec;
+	struct nullb_device *dev = cmd->nq->dev;
+	ktime_t kt;
+
+	if (dev->nr_lat_entries)
+		kt = ns_to_ktime(null_sample_latency(dev));
+	else
+		kt = dev->completion_nsec;
 
 	hrtimer_start(&cmd->timer, kt, HRTIMER_MODE_REL);
 }
@@ -829,36 +1066,74 @@ static void null_complete_rq(struct request *rq)
 	blk_mq_end_request(rq, cmd->error);
 }
 
-static struct nullb_page *null_alloc_page(void)
+/* Number of sectors covered by one nullb_page, as a shift */
+static inline unsigned int null_page_sectors_shift(struct nullb_device *dev)
+{
+	return PAGE_SECTORS_SHIFT + dev->memory_order;
+}
+
+static inline unsigned int null_page_sectors(struct nullb_device *dev)
+{
+	return 1U << null_page_sectors_shift(dev);
+}
+
+static inline unsigned long null_page_bytes(struct nullb_device *dev)
+{
+	return PAGE_SIZE << dev->memory_order;
+}
+
+static inline unsigned int null_sector_bit(struct nullb_device *dev,
+					   sector_t sector)
+{
+	return sector & (null_page_sectors(dev) - 1);
+}
+
+/* Base page of @t_page holding byte @offset */
+static inline struct page *null_page_at(struct nullb_page *t_page,
+					unsigned int offset)
 {
+	return nth_page(t_page->page, offset >> PAGE_SHIFT);
+}
+
+static struct nullb_page *null_alloc_page(struct nullb_device *dev)
+{
+	unsigned int nr_longs = BITS_TO_LONGS(null_page_sectors(dev));
 	struct nullb_page *t_page;
+	gfp_t gfp = GFP_NOIO;
 
-	t_page = kmalloc(sizeof(struct nullb_page), GFP_NOIO);
+	t_page = kmalloc(struct_size(t_page, bitmap, nr_longs), GFP_NOIO);
 	if (!t_page)
 		return NULL;
 
-	t_page->page = alloc_pages(GFP_NOIO, 0);
-	if (!t_page->page) {
-		kfree(t_page);
-		return NULL;
+	t_page->page = NULL;
+	if (!dev->metadata_only) {
+		if (dev->memory_order)
+			gfp |= __GFP_COMP | __GFP_NOWARN;
+		t_page->page = alloc_pages(gfp, dev->memory_order);
+		if (!t_page->page) {
+			kfree(t_page);
+			return NULL;
+		}
 	}
 
-	memset(t_page->bitmap, 0, sizeof(t_page->bitmap));
+	t_page->flags = 0;
+	bitmap_zero(t_page->bitmap, null_page_sectors(dev));
 	return t_page;
 }
 
 static void null_free_page(struct nullb_page *t_page)
 {
-	__set_bit(NULLB_PAGE_FREE, t_page->bitmap);
-	if (test_bit(NULLB_PAGE_LOCK, t_page->bitmap))
+	__set_bit(NULLB_PAGE_FREE, &t_page->flags);
+	if (test_bit(NULLB_PAGE_LOCK, &t_page->flags))
 		return;
-	__free_page(t_page->page);
+	if (t_page->page)
+		__free_pages(t_page->page, compound_order(t_page->page));
 	kfree(t_page);
 }
 
-static bool null_page_empty(struct nullb_page *page)
+static bool null_page_empty(struct nullb_device *dev, struct nullb_page *page)
 {
-	int size = MAP_SZ - 2;
+	unsigned int size = null_page_sectors(dev);
 
 	return find_first_bit(page->bitmap, size) == size;
 }
@@ -872,19 +1147,20 @@ static void null_free_sector(struct nullb *nullb, sector_t sector,
 	struct radix_tree_root *root;
 
 	root = is_cache ? &nullb->dev->cache : &nullb->dev->data;
-	idx = sector >> PAGE_SECTORS_SHIFT;
-	sector_bit = (sector & SECTOR_MASK);
+	idx = sector >> null_page_sectors_shift(nullb->dev);
+	sector_bit = null_sector_bit(nullb->dev, sector);
 
 	t_page = radix_tree_lookup(root, idx);
 	if (t_page) {
 		__clear_bit(sector_bit, t_page->bitmap);
 
-		if (null_page_empty(t_page)) {
+		if (null_page_empty(nullb->dev, t_page)) {
 			ret = radix_tree_delete_item(root, idx, t_page);
 			WARN_ON(ret != t_page);
 			null_free_page(ret);
 			if (is_cache)
-				nullb->dev->curr_cache -= PAGE_SIZE;
+				nullb->dev->curr_cache -=
+					null_page_bytes(nullb->dev);
 		}
 	}
 }
@@ -899,9 +1175,9 @@ static struct nullb_page *null_radix_tree_insert(struct nullb *nullb, u64 idx,
 	if (radix_tree_insert(root, idx, t_page)) {
 		null_free_page(t_page);
 		t_page = radix_tree_lookup(root, idx);
-		WARN_ON(!t_page || t_page->page->index != idx);
+		WARN_ON(!t_page || t_page->idx != idx);
 	} else if (is_cache)
-		nullb->dev->curr_cache += PAGE_SIZE;
+		nullb->dev->curr_cache += null_page_bytes(nullb->dev);
 
 	return t_page;
 }
@@ -922,7 +1198,7 @@ static void null_free_device_storage(struct nullb_device *dev, bool is_cache)
 				(void **)t_pages, pos, FREE_BATCH);
 
 		for (i = 0; i < nr_pages; i++) {
-			pos = t_pages[i]->page->index;
+			pos = t_pages[i]->idx;
 			ret = radix_tree_delete_item(root, pos, t_pages[i]);
 			WARN_ON(ret != t_pages[i]);
 			null_free_page(ret);
@@ -943,12 +1219,12 @@ static struct nullb_page *__null_lookup_page(struct nullb *nullb,
 	struct nullb_page *t_page;
 	struct radix_tree_root *root;
 
-	idx = sector >> PAGE_SECTORS_SHIFT;
-	sector_bit = (sector & SECTOR_MASK);
+	idx = sector >> null_page_sectors_shift(nullb->dev);
+	sector_bit = null_sector_bit(nullb->dev, sector);
 
 	root = is_cache ? &nullb->dev->cache : &nullb->dev->data;
 	t_page = radix_tree_lookup(root, idx);
-	WARN_ON(t_page && t_page->page->index != idx);
+	WARN_ON(t_page && t_page->idx != idx);
 
 	if (t_page && (for_write || test_bit(sector_bit, t_page->bitmap)))
 		return t_page;
@@ -982,7 +1258,7 @@ static struct nullb_page *null_insert_page(struct nullb *nullb,
 
 	spin_unlock_irq(&nullb->lock);
 
-	t_page = null_alloc_page();
+	t_page = null_alloc_page(nullb->dev);
 	if (!t_page)
 		goto out_lock;
 
@@ -990,8 +1266,8 @@ static struct nullb_page *null_insert_page(struct nullb *nullb,
 		goto out_freepage;
 
 	spin_lock_irq(&nullb->lock);
-	idx = sector >> PAGE_SECTORS_SHIFT;
-	t_page->page->index = idx;
+	idx = sector >> null_page_sectors_shift(nullb->dev);
+	t_page->idx = idx;
 	t_page = null_radix_tree_insert(nullb, idx, t_page, !ignore_cache);
 	radix_tree_preload_end();
 
@@ -1005,20 +1281,20 @@ static struct nullb_page *null_insert_page(struct nullb *nullb,
 
 static int null_flush_cache_page(struct nullb *nullb, struct nullb_page *c_page)
 {
-	int i;
-	unsigned int offset;
+	struct nullb_device *dev = nullb->dev;
+	unsigned int i, offset;
 	u64 idx;
 	struct nullb_page *t_page, *ret;
-	void *dst, *src;
 
-	idx = c_page->page->index;
+	idx = c_page->idx;
 
-	t_page = null_insert_page(nullb, idx << PAGE_SECTORS_SHIFT, true);
+	t_page = null_insert_page(nullb, idx << null_page_sectors_shift(dev),
+				  true);
 
-	__clear_bit(NULLB_PAGE_LOCK, c_page->bitmap);
-	if (test_bit(NULLB_PAGE_FREE, c_page->bitmap)) {
+	__clear_bit(NULLB_PAGE_LOCK, &c_page->flags);
+	if (test_bit(NULLB_PAGE_FREE, &c_page->flags)) {
 		null_free_page(c_page);
-		if (t_page && null_page_empty(t_page)) {
+		if (t_page && null_page_empty(dev, t_page)) {
 			ret = radix_tree_delete_item(&nullb->dev->data,
 				idx, t_page);
 			null_free_page(t_page);
@@ -1029,25 +1305,21 @@ static int null_flush_cache_page(struct nullb *nullb, struct nullb_page *c_page)
 	if (!t_page)
 		return -ENOMEM;
 
-	src = kmap_local_page(c_page->page);
-	dst = kmap_local_page(t_page->page);
-
-	for (i = 0; i < PAGE_SECTORS;
-			i += (nullb->dev->blocksize >> SECTOR_SHIFT)) {
+	for (i = 0; i < null_page_sectors(dev);
+			i += (dev->blocksize >> SECTOR_SHIFT)) {
 		if (test_bit(i, c_page->bitmap)) {
 			offset = (i << SECTOR_SHIFT);
-			memcpy(dst + offset, src + offset,
-				nullb->dev->blocksize);
+			memcpy_page(null_page_at(t_page, offset),
+				    offset_in_page(offset),
+				    null_page_at(c_page, offset),
+				    offset_in_page(offset), dev->blocksize);
 			__set_bit(i, t_page->bitmap);
 		}
 	}
 
-	kunmap_local(dst);
-	kunmap_local(src);
-
-	ret = radix_tree_delete_item(&nullb->dev->cache, idx, c_page);
+	ret = radix_tree_delete_item(&dev->cache, idx, c_page);
 	null_free_page(ret);
-	nullb->dev->curr_cache -= PAGE_SIZE;
+	dev->curr_cache -= null_page_bytes(dev);
 
 	return 0;
 }
@@ -1070,15 +1342,15 @@ static int null_make_cache_space(struct nullb *nullb, unsigned long n)
 	 * avoid race, we don't allow page free
 	 */
 	for (i = 0; i < nr_pages; i++) {
-		nullb->cache_flush_pos = c_pages[i]->page->index;
+		nullb->cache_flush_pos = c_pages[i]->idx;
 		/*
 		 * We found the page which is being flushed to disk by other
 		 * threads
 		 */
-		if (test_bit(NULLB_PAGE_LOCK, c_pages[i]->bitmap))
+		if (test_bit(NULLB_PAGE_LOCK, &c_pages[i]->flags))
 			c_pages[i] = NULL;
 		else
-			__set_bit(NULLB_PAGE_LOCK, c_pages[i]->bitmap);
+			__set_bit(NULLB_PAGE_LOCK, &c_pages[i]->flags);
 	}
 
 	one_round = 0;
@@ -1090,7 +1362,7 @@ static int null_make_cache_space(struct nullb *nullb, unsigned long n)
 			return err;
 		one_round++;
 	}
-	flushed += one_round << PAGE_SHIFT;
+	flushed += one_round * null_page_bytes(nullb->dev);
 
 	if (n > flushed) {
 		if (nr_pages == 0)
@@ -1105,31 +1377,43 @@ static int null_make_cache_space(struct nullb *nullb, unsigned long n)
 	return 0;
 }
 
+/*
+ * Blocks are copied in runs that stay within one base page of the backing
+ * store, so that only one lookup is needed for all the blocks of a run.
+ */
 static int copy_to_nullb(struct nullb *nullb, struct page *source,
 	unsigned int off, sector_t sector, size_t n, bool is_fua)
 {
+	struct nullb_device *dev = nullb->dev;
 	size_t temp, count = 0;
-	unsigned int offset;
+	unsigned int offset, sector_bit, i;
 	struct nullb_page *t_page;
 
 	while (count < n) {
-		temp = min_t(size_t, nullb->dev->blocksize, n - count);
+		sector_bit = null_sector_bit(dev, sector);
+		offset = sector_bit << SECTOR_SHIFT;
+		temp = min_t(size_t, PAGE_SIZE - offset_in_page(offset),
+			     n - count);
 
 		if (null_cache_active(nullb) && !is_fua)
-			null_make_cache_space(nullb, PAGE_SIZE);
+			null_make_cache_space(nullb, null_page_bytes(dev));
 
-		offset = (sector & SECTOR_MASK) << SECTOR_SHIFT;
 		t_page = null_insert_page(nullb, sector,
 			!null_cache_active(nullb) || is_fua);
 		if (!t_page)
 			return -ENOSPC;
 
-		memcpy_page(t_page->page, offset, source, off + count, temp);
+		if (t_page->page)
+			memcpy_page(null_page_at(t_page, offset),
+				    offset_in_page(offset), source,
+				    off + count, temp);
 
-		__set_bit(sector & SECTOR_MASK, t_page->bitmap);
-
-		if (is_fua)
-			null_free_sector(nullb, sector, true);
+		for (i = 0; i < temp >> SECTOR_SHIFT;
+		     i += dev->blocksize >> SECTOR_SHIFT) {
+			__set_bit(sector_bit + i, t_page->bitmap);
+			if (is_fua)
+				null_free_sector(nullb, sector + i, true);
+		}
 
 		count += temp;
 		sector += temp >> SECTOR_SHIFT;
@@ -1140,22 +1424,40 @@ static int copy_to_nullb(struct nullb *nullb, struct page *source,
 static int copy_from_nullb(struct nullb *nullb, struct page *dest,
 	unsigned int off, sector_t sector, size_t n)
 {
+	struct nullb_device *dev = nullb->dev;
 	size_t temp, count = 0;
-	unsigned int offset;
+	unsigned int offset, sector_bit, i;
 	struct nullb_page *t_page;
 
 	while (count < n) {
-		temp = min_t(size_t, nullb->dev->blocksize, n - count);
+		sector_bit = null_sector_bit(dev, sector);
+		offset = sector_bit << SECTOR_SHIFT;
 
-		offset = (sector & SECTOR_MASK) << SECTOR_SHIFT;
-		t_page = null_lookup_page(nullb, sector, false,
-			!null_cache_active(nullb));
+		/*
+		 * With a cache, each block may live in either the cache or
+		 * the data tree, so look them up one by one.
+		 */
+		if (null_cache_active(nullb)) {
+			temp = min_t(size_t, dev->blocksize, n - count);
+			t_page = null_lookup_page(nullb, sector, false, false);
+		} else {
+			temp = min_t(size_t, PAGE_SIZE - offset_in_page(offset),
+				     n - count);
+			t_page = null_lookup_page(nullb, sector, true, true);
+		}
 
-		if (t_page)
-			memcpy_page(dest, off + count, t_page->page, offset,
-				    temp);
-		else
-			zero_user(dest, off + count, temp);
+		for (i = 0; i < temp; i += dev->blocksize) {
+			if (t_page &&
+			    test_bit(sector_bit + (i >> SECTOR_SHIFT),
+				     t_page->bitmap))
+				memcpy_page(dest, off + count + i,
+					    null_page_at(t_page, offset + i),
+					    offset_in_page(offset + i),
+					    dev->blocksize);
+			else
+				zero_user(dest, off + count + i,
+					  dev->blocksize);
+		}
 
 		count += temp;
 		sector += temp >> SECTOR_SHIFT;
@@ -1218,6 +1520,14 @@ static int null_transfer(struct nullb *nullb, struct page *page,
 	unsigned int valid_len = len;
 	int err = 0;
 
+	/*
+	 * Only the map of written sectors is kept. Reads return zeroes, like
+	 * a device that is not memory backed: the buffer is zero filled at
+	 * completion by nullb_zero_read_cmd_buffer().
+	 */
+	if (dev->metadata_only && !is_write)
+		return 0;
+
 	if (!is_write) {
 		if (dev->zoned)
 			valid_len = null_zone_valid_read_len(nullb,
@@ -1320,7 +1630,8 @@ static void nullb_zero_read_cmd_buffer(struct nullb_cmd *cmd)
 	struct nullb_device *dev = cmd->nq->dev;
 	struct bio *bio;
 
-	if (!dev->memory_backed && req_op(rq) == REQ_OP_READ) {
+	if ((!dev->memory_backed || dev->metadata_only) &&
+	    req_op(rq) == REQ_OP_READ) {
 		__rq_for_each_bio(bio, rq)
 			zero_fill_bio(bio);
 	}
@@ -1343,10 +1654,16 @@ static inline void nullb_complete_cmd(struct nullb_cmd *cmd)
 	/* Complete IO by inline, softirq or timer */
 	switch (cmd->nq->dev->irqmode) {
 	case NULL_IRQ_SOFTIRQ:
-		blk_mq_complete_request(rq);
+		if (cmd->nq->dev->irq_coalesce_usec)
+			null_coalesce_cmd(cmd);
+		else
+			blk_mq_complete_request(rq);
 		break;
 	case NULL_IRQ_NONE:
-		blk_mq_end_request(rq, cmd->error);
+		if (cmd->nq->dev->irq_coalesce_usec)
+			null_coalesce_cmd(cmd);
+		else
+			blk_mq_end_request(rq, cmd->error);
 		break;
 	case NULL_IRQ_TIMER:
 		null_cmd_end_timer(cmd);
@@ -1693,6 +2010,7 @@ static const struct blk_mq_ops null_mq_ops = {
 static void null_del_dev(struct nullb *nullb)
 {
 	struct nullb_device *dev;
+	int i;
 
 	if (!nullb)
 		return;
@@ -1714,6 +2032,8 @@ static void null_del_dev(struct nullb *nullb)
 	put_disk(nullb->disk);
 	if (nullb->tag_set == &nullb->__tag_set)
 		blk_mq_free_tag_set(nullb->tag_set);
+	for (i = 0; i < nr_cpu_ids + g_poll_queues; i++)
+		hrtimer_cancel(&nullb->queues[i].coalesce_timer);
 	kfree(nullb->queues);
 	if (null_cache_active(nullb))
 		null_free_device_storage(nullb->dev, true);
@@ -1749,6 +2069,7 @@ static const struct block_device_operations null_ops = {
 static int setup_queues(struct nullb *nullb)
 {
 	int nqueues = nr_cpu_ids;
+	int i;
 
 	if (g_poll_queues)
 		nqueues += g_poll_queues;
@@ -1758,6 +2079,20 @@ static int setup_queues(struct nullb *nullb)
 	if (!nullb->queues)
 		return -ENOMEM;
 
+	/*
+	 * The coalescing state is set up once here rather than in
+	 * null_init_hctx() so it survives hardware queue remapping.
+	 */
+	for (i = 0; i < nqueues; i++) {
+		struct nullb_queue *nq = &nullb->queues[i];
+
+		INIT_LIST_HEAD(&nq->coalesce_list);
+		spin_lock_init(&nq->coalesce_lock);
+		hrtimer_init(&nq->coalesce_timer, CLOCK_MONOTONIC,
+			     HRTIMER_MODE_REL);
+		nq->coalesce_timer.function = null_coalesce_timer_fn;
+	}
+
 	return 0;
 }
 
@@ -1845,15 +2180,26 @@ static int null_validate_conf(struct nullb_device *dev)
 	dev->prev_poll_queues = dev->poll_queues;
 	dev->irqmode = min_t(unsigned int, dev->irqmode, NULL_IRQ_TIMER);
 
+	if (dev->memory_order > MAX_PAGE_ORDER) {
+		pr_err("memory_order must not exceed %u\n", MAX_PAGE_ORDER);
+		return -EINVAL;
+	}
+
 	/* Do memory allocation, so set blocking */
 	if (dev->memory_backed)
 		dev->blocking = true;
-	else /* cache is meaningless */
+	/* cache is meaningless without memory backing or without data */
+	if (!dev->memory_backed || dev->metadata_only)
 		dev->cache_size = 0;
 	dev->cache_size = min_t(unsigned long, ULONG_MAX / 1024 / 1024,
 						dev->cache_size);
 	dev->mbps = min_t(unsigned int, 1024 * 40, dev->mbps);
 
+	if (dev->irq_coalesce_count && !dev->irq_coalesce_usec) {
+		pr_err("irq_coalesce_count requires irq_coalesce_usec\n");
+		return -EINVAL;
+	}
+
 	if (dev->zoned &&
 	    (!dev->zone_size || !is_power_of_2(dev->zone_size))) {
 		pr_err("zone_size must be power-of-two\n");
@@ -28,6 +28,24 @@ struct nullb_queue {
 
 	struct list_head poll_list;
 	spinlock_t poll_lock;
+
+	/* Completions held back by interrupt coalescing emulation */
+	struct list_head coalesce_list;
+	unsigned int coalesce_nr;
+	spinlock_t coalesce_lock;
+	struct hrtimer coalesce_timer;
+};
+
+/*
+ * One point of the completion latency distribution: @pct is a percentile
+ * in hundredths of a percent (0 - 10000) and @nsec the latency at it.
+ */
+#define NULLB_LAT_PCT_MAX	10000
+#define NULLB_LAT_MAX_ENTRIES	16
+
+struct nullb_lat_entry {
+	unsigned int pct;
+	u64 nsec;
 };
 
 struct nullb_zone {
@@ -93,12 +111,18 @@ struct nullb_device {
 	unsigned int max_sectors; /* Max sectors per command */
 	unsigned int irqmode; /* IRQ completion handler */
 	unsigned int hw_queue_depth; /* queue depth */
+	unsigned int memory_order; /* allocation order of the backing pages */
 	unsigned int index; /* index of the disk, only valid with a disk */
 	unsigned int mbps; /* Bandwidth throttle cap (in MB/s) */
+	unsigned int irq_coalesce_count; /* completions per coalesced interrupt */
+	unsigned int irq_coalesce_usec; /* max delay of a coalesced completion */
+	unsigned int nr_lat_entries; /* number of completion latency points */
+	struct nullb_lat_entry lat[NULLB_LAT_MAX_ENTRIES]; /* latency distribution */
 	bool blocking; /* blocking blk-mq device */
 	bool use_per_node_hctx; /* use per-node allocation for hardware context */
 	bool power; /* power on/off the device */
 	bool memory_backed; /* if data is stored in memory */
+	bool metadata_only; /* if only written sectors are tracked, not data */
 	bool discard; /* if support discard */
 	bool zoned; /* if device is zoned */
 	bool zone_full; /* Initialize zones to be full */
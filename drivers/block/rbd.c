@@ -46,6 +46,7 @@
 #include <linux/slab.h>
 #include <linux/idr.h>
 #include <linux/workqueue.h>
+#include <linux/hrtimer.h>
 
 #include "rbd_types.h"
 
@@ -341,6 +342,10 @@ struct rbd_img_request {
 
 	struct list_head	lock_item;
 	struct list_head	object_extents;	/* obj_req.ex structs */
+	struct rbd_obj_request	*next_obj;	/* first one not started */
+
+	struct list_head	coalesce_item;	/* staged or merged */
+	struct list_head	coalesced;	/* merged into this one */
 
 	struct mutex		state_mutex;
 	struct pending_result	pending;
@@ -429,6 +434,15 @@ struct rbd_device {
 	u64			object_map_size;	/* in objects */
 	u64			object_map_flags;
 
+	/* small writes staged for coalescing, see rbd_img_coalesce() */
+	spinlock_t		coalesce_lock;
+	struct list_head	coalesce_list;
+	u64			coalesce_off;
+	u64			coalesce_end;
+	unsigned int		coalesce_count;
+	struct hrtimer		coalesce_timer;
+	struct work_struct	coalesce_work;
+
 	struct workqueue_struct	*task_wq;
 
 	struct rbd_spec		*parent_spec;
@@ -781,6 +795,8 @@ enum {
 	Opt_queue_depth,
 	Opt_alloc_size,
 	Opt_lock_timeout,
+	Opt_write_coalesce_us,
+	Opt_max_obj_requests,
 	/* int args above */
 	Opt_pool_ns,
 	Opt_compression_hint,
@@ -812,6 +828,7 @@ static const struct fs_parameter_spec rbd_parameters[] = {
 	fsparam_flag	("exclusive",			Opt_exclusive),
 	fsparam_flag	("lock_on_read",		Opt_lock_on_read),
 	fsparam_u32	("lock_timeout",		Opt_lock_timeout),
+	fsparam_u32	("max_obj_requests",		Opt_max_obj_requests),
 	fsparam_flag	("notrim",			Opt_notrim),
 	fsparam_string	("_pool_ns",			Opt_pool_ns),
 	fsparam_u32	("queue_depth",			Opt_queue_depth),
@@ -819,6 +836,7 @@ static const struct fs_parameter_spec rbd_parameters[] = {
 	fsparam_flag	("read_write",			Opt_read_write),
 	fsparam_flag	("ro",				Opt_read_only),
 	fsparam_flag	("rw",				Opt_read_write),
+	fsparam_u32	("write_coalesce_us",		Opt_write_coalesce_us),
 	{}
 };
 
@@ -826,6 +844,8 @@ struct rbd_options {
 	int	queue_depth;
 	int	alloc_size;
 	unsigned long	lock_timeout;
+	u32	write_coalesce_us;
+	u32	max_obj_requests;
 	bool	read_only;
 	bool	lock_on_read;
 	bool	exclusive;
@@ -837,6 +857,10 @@ struct rbd_options {
 #define RBD_QUEUE_DEPTH_DEFAULT	BLKDEV_DEFAULT_RQ
 #define RBD_ALLOC_SIZE_DEFAULT	(64 * 1024)
 #define RBD_LOCK_TIMEOUT_DEFAULT 0  /* no timeout */
+#define RBD_WRITE_COALESCE_US_DEFAULT	0  /* don't coalesce */
+#define RBD_MAX_OBJ_REQUESTS_DEFAULT	0  /* no limit */
+
+#define RBD_COALESCE_MAX_REQS	16	/* writes merged into one OSD op */
 #define RBD_READ_ONLY_DEFAULT	false
 #define RBD_LOCK_ON_READ_DEFAULT false
 #define RBD_EXCLUSIVE_DEFAULT	false
@@ -1595,6 +1619,8 @@ static void rbd_img_request_init(struct rbd_img_request *img_request,
 
 	INIT_LIST_HEAD(&img_request->lock_item);
 	INIT_LIST_HEAD(&img_request->object_extents);
+	INIT_LIST_HEAD(&img_request->coalesce_item);
+	INIT_LIST_HEAD(&img_request->coalesced);
 	mutex_init(&img_request->state_mutex);
 }
 
@@ -3486,10 +3512,48 @@ static int rbd_img_exclusive_lock(struct rbd_img_request *img_req)
 	return 0;
 }
 
+static bool rbd_img_all_issued(struct rbd_img_request *img_req)
+{
+	return list_entry_is_head(img_req->next_obj, &img_req->object_extents,
+				  ex.oe_item);
+}
+
+/*
+ * Start object requests in order, keeping at most max_obj_requests of
+ * them in flight if that is set.  Requests spanning many objects are
+ * otherwise fanned out all at once.
+ */
+static void rbd_img_issue_object_requests(struct rbd_img_request *img_req)
+{
+	struct rbd_options *opts = img_req->rbd_dev->opts;
+	u32 limit = opts ? opts->max_obj_requests : 0;
+	struct rbd_obj_request *obj_req = img_req->next_obj;
+
+	if (img_req->pending.result)
+		return;
+
+	list_for_each_entry_from(obj_req, &img_req->object_extents,
+				 ex.oe_item) {
+		int result = 0;
+
+		if (limit && img_req->pending.num_pending >= limit)
+			break;
+
+		if (__rbd_obj_handle_request(obj_req, &result)) {
+			if (result) {
+				img_req->pending.result = result;
+				break;
+			}
+		} else {
+			img_req->pending.num_pending++;
+		}
+	}
+	img_req->next_obj = obj_req;
+}
+
 static void rbd_img_object_requests(struct rbd_img_request *img_req)
 {
 	struct rbd_device *rbd_dev = img_req->rbd_dev;
-	struct rbd_obj_request *obj_req;
 
 	rbd_assert(!img_req->pending.result && !img_req->pending.num_pending);
 	rbd_assert(!need_exclusive_lock(img_req) ||
@@ -3502,18 +3566,10 @@ static void rbd_img_object_requests(struct rbd_img_request *img_req)
 		up_read(&rbd_dev->header_rwsem);
 	}
 
-	for_each_obj_request(img_req, obj_req) {
-		int result = 0;
-
-		if (__rbd_obj_handle_request(obj_req, &result)) {
-			if (result) {
-				img_req->pending.result = result;
-				return;
-			}
-		} else {
-			img_req->pending.num_pending++;
-		}
-	}
+	img_req->next_obj = list_first_entry(&img_req->object_extents,
+					     struct rbd_obj_request,
+					     ex.oe_item);
+	rbd_img_issue_object_requests(img_req);
 }
 
 static bool rbd_img_advance(struct rbd_img_request *img_req, int *result)
@@ -3547,8 +3603,16 @@ static bool rbd_img_advance(struct rbd_img_request *img_req, int *result)
 		img_req->state = __RBD_IMG_OBJECT_REQUESTS;
 		return false;
 	case __RBD_IMG_OBJECT_REQUESTS:
-		if (!pending_result_dec(&img_req->pending, result))
+		if (!pending_result_dec(&img_req->pending, result)) {
+			rbd_img_issue_object_requests(img_req);
 			return false;
+		}
+		if (!*result && !rbd_img_all_issued(img_req)) {
+			rbd_img_issue_object_requests(img_req);
+			if (img_req->pending.num_pending)
+				return false;
+			*result = img_req->pending.result;
+		}
 		fallthrough;
 	case RBD_IMG_OBJECT_REQUESTS:
 		return true;
@@ -3589,6 +3653,31 @@ static bool __rbd_img_handle_request(struct rbd_img_request *img_req,
 	return done;
 }
 
+/*
+ * Complete the block request behind @img_req along with any requests
+ * that were coalesced into it.
+ */
+static void rbd_img_end_request(struct rbd_img_request *img_req, int result)
+{
+	struct request *rq = blk_mq_rq_from_pdu(img_req);
+	blk_status_t status = errno_to_blk_status(result);
+	struct rbd_img_request *merged, *next;
+
+	rq->biotail->bi_next = NULL;
+	list_for_each_entry_safe(merged, next, &img_req->coalesced,
+				 coalesce_item) {
+		struct request *merged_rq = blk_mq_rq_from_pdu(merged);
+
+		list_del_init(&merged->coalesce_item);
+		merged_rq->biotail->bi_next = NULL;
+		rbd_img_request_destroy(merged);
+		blk_mq_end_request(merged_rq, status);
+	}
+
+	rbd_img_request_destroy(img_req);
+	blk_mq_end_request(rq, status);
+}
+
 static void rbd_img_handle_request(struct rbd_img_request *img_req, int result)
 {
 again:
@@ -3604,10 +3693,7 @@ static void rbd_img_handle_request(struct rbd_img_request *img_req, int result)
 			goto again;
 		}
 	} else {
-		struct request *rq = blk_mq_rq_from_pdu(img_req);
-
-		rbd_img_request_destroy(img_req);
-		blk_mq_end_request(rq, errno_to_blk_status(result));
+		rbd_img_end_request(img_req, result);
 	}
 }
 
@@ -4716,6 +4802,124 @@ static int rbd_obj_method_sync(struct rbd_device *rbd_dev,
 	return ret;
 }
 
+/*
+ * Issue a run of staged writes as one image request: the bio chains of
+ * the followers are linked behind the first request, so the whole run
+ * maps to a single object extent and goes out as one OSD op.
+ */
+static void rbd_img_submit_coalesced(struct list_head *staged)
+{
+	struct rbd_img_request *img_req, *merged;
+	struct request *rq;
+	struct bio *tail;
+	u64 offset, length;
+	int result;
+
+	if (list_empty(staged))
+		return;
+
+	img_req = list_first_entry(staged, struct rbd_img_request,
+				   coalesce_item);
+	list_del_init(&img_req->coalesce_item);
+	list_splice_init(staged, &img_req->coalesced);
+
+	rq = blk_mq_rq_from_pdu(img_req);
+	offset = (u64)blk_rq_pos(rq) << SECTOR_SHIFT;
+	length = blk_rq_bytes(rq);
+	tail = rq->biotail;
+	list_for_each_entry(merged, &img_req->coalesced, coalesce_item) {
+		struct request *merged_rq = blk_mq_rq_from_pdu(merged);
+
+		tail->bi_next = merged_rq->bio;
+		tail = merged_rq->biotail;
+		length += blk_rq_bytes(merged_rq);
+	}
+
+	dout("%s img_req %p coalesced %llu~%llu\n", __func__, img_req, offset,
+	     length);
+
+	result = rbd_img_fill_from_bio(img_req, offset, length, rq->bio);
+	if (result) {
+		rbd_warn(img_req->rbd_dev, "%s %llx at %llx result %d",
+			 obj_op_name(img_req->op_type), length, offset, result);
+		rbd_img_end_request(img_req, result);
+		return;
+	}
+
+	rbd_img_handle_request(img_req, 0);
+}
+
+static void rbd_coalesce_workfn(struct work_struct *work)
+{
+	struct rbd_device *rbd_dev =
+	    container_of(work, struct rbd_device, coalesce_work);
+	LIST_HEAD(staged);
+
+	spin_lock(&rbd_dev->coalesce_lock);
+	list_splice_init(&rbd_dev->coalesce_list, &staged);
+	spin_unlock(&rbd_dev->coalesce_lock);
+
+	rbd_img_submit_coalesced(&staged);
+}
+
+static enum hrtimer_restart rbd_coalesce_timer_fn(struct hrtimer *timer)
+{
+	struct rbd_device *rbd_dev =
+	    container_of(timer, struct rbd_device, coalesce_timer);
+
+	queue_work(rbd_wq, &rbd_dev->coalesce_work);
+	return HRTIMER_NORESTART;
+}
+
+/*
+ * With write_coalesce_us set, small writes are held back for up to that
+ * long so that a run of contiguous writes to the same object (journal
+ * writes, for example) costs one OSD round trip instead of one each.
+ * The blk-mq requests stay separate, only the OSD op is shared.
+ *
+ * Return true if @img_req was staged, it is then issued either by the
+ * timer or when the next write can't be appended to the run.
+ */
+static bool rbd_img_coalesce(struct rbd_img_request *img_req, u64 off,
+			     u64 len)
+{
+	struct rbd_device *rbd_dev = img_req->rbd_dev;
+	u32 obj_size = rbd_dev->layout.object_size;
+	u64 window_us = rbd_dev->opts->write_coalesce_us;
+	u64 objno = div_u64(off, obj_size);
+	LIST_HEAD(prev);
+	LIST_HEAD(full);
+
+	if (!window_us || img_req->op_type != OBJ_OP_WRITE ||
+	    len > rbd_dev->opts->alloc_size ||
+	    rbd_layout_is_fancy(&rbd_dev->layout) ||
+	    div_u64(off + len - 1, obj_size) != objno)
+		return false;
+
+	spin_lock(&rbd_dev->coalesce_lock);
+	if (!list_empty(&rbd_dev->coalesce_list) &&
+	    (off != rbd_dev->coalesce_end ||
+	     div_u64(rbd_dev->coalesce_off, obj_size) != objno))
+		list_splice_init(&rbd_dev->coalesce_list, &prev);
+
+	if (list_empty(&rbd_dev->coalesce_list)) {
+		rbd_dev->coalesce_off = off;
+		rbd_dev->coalesce_count = 0;
+		hrtimer_start(&rbd_dev->coalesce_timer,
+			      window_us * NSEC_PER_USEC, HRTIMER_MODE_REL);
+	}
+	list_add_tail(&img_req->coalesce_item, &rbd_dev->coalesce_list);
+	rbd_dev->coalesce_end = off + len;
+
+	if (++rbd_dev->coalesce_count >= RBD_COALESCE_MAX_REQS)
+		list_splice_init(&rbd_dev->coalesce_list, &full);
+	spin_unlock(&rbd_dev->coalesce_lock);
+
+	rbd_img_submit_coalesced(&prev);
+	rbd_img_submit_coalesced(&full);
+	return true;
+}
+
 static void rbd_queue_workfn(struct work_struct *work)
 {
 	struct rbd_img_request *img_request =
@@ -4752,6 +4956,9 @@ static void rbd_queue_workfn(struct work_struct *work)
 	dout("%s rbd_dev %p img_req %p %s %llu~%llu\n", __func__, rbd_dev,
 	     img_request, obj_op_name(op_type), offset, length);
 
+	if (rbd_img_coalesce(img_request, offset, length))
+		return;
+
 	if (op_type == OBJ_OP_DISCARD || op_type == OBJ_OP_ZEROOUT)
 		result = rbd_img_fill_nodata(img_request, offset, length);
 	else
@@ -5380,6 +5587,13 @@ static struct rbd_device *__rbd_dev_create(struct rbd_spec *spec)
 
 	spin_lock_init(&rbd_dev->object_map_lock);
 
+	spin_lock_init(&rbd_dev->coalesce_lock);
+	INIT_LIST_HEAD(&rbd_dev->coalesce_list);
+	hrtimer_init(&rbd_dev->coalesce_timer, CLOCK_MONOTONIC,
+		     HRTIMER_MODE_REL);
+	rbd_dev->coalesce_timer.function = rbd_coalesce_timer_fn;
+	INIT_WORK(&rbd_dev->coalesce_work, rbd_coalesce_workfn);
+
 	rbd_dev->dev.bus = &rbd_bus_type;
 	rbd_dev->dev.type = &rbd_device_type;
 	rbd_dev->dev.parent = &rbd_root_dev;
@@ -6288,6 +6502,15 @@ static int rbd_parse_param(struct fs_parameter *param,
 			goto out_of_range;
 		opt->lock_timeout = msecs_to_jiffies(result.uint_32 * 1000);
 		break;
+	case Opt_write_coalesce_us:
+		if (result.uint_32 > USEC_PER_SEC)
+			goto out_of_range;
+		opt->write_coalesce_us = result.uint_32;
+		break;
+	case Opt_max_obj_requests:
+		/* 0 is "no limit" */
+		opt->max_obj_requests = result.uint_32;
+		break;
 	case Opt_pool_ns:
 		kfree(pctx->spec->pool_ns);
 		pctx->spec->pool_ns = param->string;
@@ -6509,6 +6732,8 @@ static int rbd_add_parse_args(const char *buf,
 	pctx.opts->queue_depth = RBD_QUEUE_DEPTH_DEFAULT;
 	pctx.opts->alloc_size = RBD_ALLOC_SIZE_DEFAULT;
 	pctx.opts->lock_timeout = RBD_LOCK_TIMEOUT_DEFAULT;
+	pctx.opts->write_coalesce_us = RBD_WRITE_COALESCE_US_DEFAULT;
+	pctx.opts->max_obj_requests = RBD_MAX_OBJ_REQUESTS_DEFAULT;
 	pctx.opts->lock_on_read = RBD_LOCK_ON_READ_DEFAULT;
 	pctx.opts->exclusive = RBD_EXCLUSIVE_DEFAULT;
 	pctx.opts->trim = RBD_TRIM_DEFAULT;
@@ -6770,6 +6995,11 @@ static int rbd_dev_probe_parent(struct rbd_device *rbd_dev, int depth)
 
 static void rbd_dev_device_release(struct rbd_device *rbd_dev)
 {
+	/* All staged writes were issued before the queue drained. */
+	WARN_ON(!list_empty(&rbd_dev->coalesce_list));
+	hrtimer_cancel(&rbd_dev->coalesce_timer);
+	cancel_work_sync(&rbd_dev->coalesce_work);
+
 	clear_bit(RBD_DEV_FLAG_EXISTS, &rbd_dev->flags);
 	rbd_free_disk(rbd_dev);
 	if (!single_major)
@@ -44,12 +44,15 @@
 #include <linux/task_work.h>
 #include <linux/namei.h>
 #include <linux/kref.h>
+#include <linux/splice.h>
+#include <linux/pipe_fs_i.h>
 #include <uapi/linux/ublk_cmd.h>
 
 #define UBLK_MINORS		(1U << MINORBITS)
 
 /* private ioctl command mirror */
 #define UBLK_CMD_DEL_DEV_ASYNC	_IOC_NR(UBLK_U_CMD_DEL_DEV_ASYNC)
+#define UBLK_CMD_GET_QUEUE_MAP	_IOC_NR(UBLK_U_CMD_GET_QUEUE_MAP)
 
 /* All UBLK_F_* have to be included into UBLK_F_ALL */
 #define UBLK_F_ALL (UBLK_F_SUPPORT_ZERO_COPY \
@@ -60,7 +63,9 @@
 		| UBLK_F_UNPRIVILEGED_DEV \
 		| UBLK_F_CMD_IOCTL_ENCODE \
 		| UBLK_F_USER_COPY \
-		| UBLK_F_ZONED)
+		| UBLK_F_ZONED \
+		| UBLK_F_BATCH_IO \
+		| UBLK_F_QUEUE_NUMA)
 
 /* All UBLK_PARAM_TYPE_* should be included here */
 #define UBLK_PARAM_TYPE_ALL                                \
@@ -81,6 +86,9 @@ struct ublk_uring_cmd_pdu {
 	u16 tag;
 };
 
+/* pdu tag of UBLK_IO_COMMIT_AND_FETCH_BATCH commands */
+#define UBLK_BATCH_TAG	UBLK_MAX_QUEUE_DEPTH
+
 /*
  * io command is active: sqe cmd is received, and its cqe isn't done
  *
@@ -148,6 +156,13 @@ struct ublk_queue {
 	bool canceling;
 	unsigned short nr_io_ready;	/* how many ios setup */
 	spinlock_t		cancel_lock;
+
+	/* UBLK_F_BATCH_IO */
+	struct ublk_batch_elem	*batch_buf;
+	spinlock_t		batch_lock;
+	struct io_uring_cmd	*batch_cmd;	/* waiting for requests */
+	bool			batch_busy;	/* batch command in flight */
+	unsigned short		batch_nr;	/* tags filled in batch_buf */
 	struct ublk_device *dev;
 	struct ublk_io ios[];
 };
@@ -202,6 +217,11 @@ static inline bool ublk_dev_is_user_copy(const struct ublk_device *ub)
 	return ub->dev_info.flags & UBLK_F_USER_COPY;
 }
 
+static inline bool ublk_dev_support_zero_copy(const struct ublk_device *ub)
+{
+	return ub->dev_info.flags & UBLK_F_SUPPORT_ZERO_COPY;
+}
+
 static inline bool ublk_dev_is_zoned(const struct ublk_device *ub)
 {
 	return ub->dev_info.flags & UBLK_F_ZONED;
@@ -549,6 +569,16 @@ static inline bool ublk_support_user_copy(const struct ublk_queue *ubq)
 	return ubq->flags & UBLK_F_USER_COPY;
 }
 
+static inline bool ublk_queue_numa(const struct ublk_queue *ubq)
+{
+	return ubq->flags & UBLK_F_QUEUE_NUMA;
+}
+
+static inline bool ublk_support_batch(const struct ublk_queue *ubq)
+{
+	return ubq->flags & UBLK_F_BATCH_IO;
+}
+
 static inline bool ublk_need_req_ref(const struct ublk_queue *ubq)
 {
 	/*
@@ -642,6 +672,56 @@ static inline int ublk_queue_cmd_buf_size(struct ublk_device *ub, int q_id)
 			PAGE_SIZE);
 }
 
+static inline int ublk_queue_batch_buf_size(struct ublk_device *ub, int q_id)
+{
+	struct ublk_queue *ubq = ublk_get_queue(ub, q_id);
+
+	return round_up(ubq->q_depth * sizeof(struct ublk_batch_elem),
+			PAGE_SIZE);
+}
+
+static int ublk_alloc_queue_buf(void **buf, int size, int node)
+{
+	struct page *page;
+
+	if (READ_ONCE(*buf))
+		return 0;
+
+	page = alloc_pages_node(node, GFP_KERNEL | __GFP_ZERO, get_order(size));
+	if (!page)
+		return -ENOMEM;
+
+	/* lost the race against another thread of the daemon */
+	if (cmpxchg(buf, NULL, page_address(page)))
+		__free_pages(page, get_order(size));
+	return 0;
+}
+
+/*
+ * Allocate the buffers shared with ublksrv, on @node. Called when the
+ * device is added, or with UBLK_F_QUEUE_NUMA on first use by ublksrv.
+ */
+static int ublk_alloc_queue_bufs(struct ublk_device *ub, int q_id, int node)
+{
+	struct ublk_queue *ubq = ublk_get_queue(ub, q_id);
+	int ret;
+
+	ret = ublk_alloc_queue_buf((void **)&ubq->io_cmd_buf,
+				   ublk_queue_cmd_buf_size(ub, q_id), node);
+	if (ret || !ublk_support_batch(ubq))
+		return ret;
+
+	return ublk_alloc_queue_buf((void **)&ubq->batch_buf,
+				    ublk_queue_batch_buf_size(ub, q_id), node);
+}
+
+static inline int ublk_queue_use_bufs(struct ublk_device *ub, int q_id)
+{
+	if (!ublk_queue_numa(ublk_get_queue(ub, q_id)))
+		return 0;
+	return ublk_alloc_queue_bufs(ub, q_id, numa_node_id());
+}
+
 static inline bool ublk_queue_can_use_recovery_reissue(
 		struct ublk_queue *ubq)
 {
@@ -1055,6 +1135,30 @@ static void ubq_complete_io_cmd(struct ublk_io *io, int res,
 	io_uring_cmd_done(io->cmd, res, 0, issue_flags);
 }
 
+/* pass the request of @tag to ublksrv with the pending batch command */
+static void ublk_batch_add_io(struct ublk_queue *ubq, struct ublk_io *io,
+			      int tag)
+{
+	struct ublk_batch_elem *elem = &ubq->batch_buf[ubq->batch_nr++];
+
+	io->flags |= UBLK_IO_FLAG_OWNED_BY_SRV;
+	io->flags &= ~UBLK_IO_FLAG_ACTIVE;
+
+	WRITE_ONCE(elem->tag, tag);
+	WRITE_ONCE(elem->result, 0);
+	WRITE_ONCE(elem->zone_append_lba, 0);
+}
+
+static void ublk_batch_done(struct ublk_queue *ubq, struct io_uring_cmd *cmd,
+			    int res, unsigned int issue_flags)
+{
+	spin_lock(&ubq->batch_lock);
+	ubq->batch_busy = false;
+	spin_unlock(&ubq->batch_lock);
+
+	io_uring_cmd_done(cmd, res, 0, issue_flags);
+}
+
 #define UBLK_REQUEUE_DELAY_MS	3
 
 static inline void __ublk_abort_rq(struct ublk_queue *ubq,
@@ -1076,7 +1180,8 @@ static inline void __ublk_rq_task_work(struct request *req,
 	unsigned int mapped_bytes;
 
 	pr_devel("%s: complete: op %d, qid %d tag %d io_flags %x addr %llx\n",
-			__func__, io->cmd->cmd_op, ubq->q_id, req->tag, io->flags,
+			__func__, io->cmd ? io->cmd->cmd_op : 0, ubq->q_id,
+			req->tag, io->flags,
 			ublk_get_iod(ubq, req->tag)->addr);
 
 	/*
@@ -1143,7 +1248,10 @@ static inline void __ublk_rq_task_work(struct request *req,
 	}
 
 	ublk_init_req_ref(ubq, req);
-	ubq_complete_io_cmd(io, UBLK_IO_RES_OK, issue_flags);
+	if (ublk_support_batch(ubq))
+		ublk_batch_add_io(ubq, io, tag);
+	else
+		ubq_complete_io_cmd(io, UBLK_IO_RES_OK, issue_flags);
 }
 
 static inline void ublk_forward_io_cmds(struct ublk_queue *ubq,
@@ -1165,6 +1273,34 @@ static void ublk_rq_task_work_cb(struct io_uring_cmd *cmd, unsigned issue_flags)
 	ublk_forward_io_cmds(ubq, issue_flags);
 }
 
+static void ublk_batch_task_work_cb(struct io_uring_cmd *cmd,
+				    unsigned issue_flags)
+{
+	struct ublk_uring_cmd_pdu *pdu = ublk_get_uring_cmd_pdu(cmd);
+	struct ublk_queue *ubq = pdu->ubq;
+
+	ubq->batch_nr = 0;
+	ublk_forward_io_cmds(ubq, issue_flags);
+	ublk_batch_done(ubq, cmd, ubq->batch_nr, issue_flags);
+}
+
+/*
+ * Claim the armed batch command for delivering the queued requests. If
+ * there is none, the next UBLK_IO_COMMIT_AND_FETCH_BATCH finds them.
+ */
+static void ublk_batch_kick(struct ublk_queue *ubq)
+{
+	struct io_uring_cmd *cmd;
+
+	spin_lock(&ubq->batch_lock);
+	cmd = ubq->batch_cmd;
+	ubq->batch_cmd = NULL;
+	spin_unlock(&ubq->batch_lock);
+
+	if (cmd)
+		io_uring_cmd_complete_in_task(cmd, ublk_batch_task_work_cb);
+}
+
 static void ublk_queue_cmd(struct ublk_queue *ubq, struct request *rq)
 {
 	struct ublk_rq_data *data = blk_mq_rq_to_pdu(rq);
@@ -1172,7 +1308,11 @@ static void ublk_queue_cmd(struct ublk_queue *ubq, struct request *rq)
 	if (llist_add(&data->node, &ubq->io_cmds)) {
 		struct ublk_io *io = &ubq->ios[rq->tag];
 
-		io_uring_cmd_complete_in_task(io->cmd, ublk_rq_task_work_cb);
+		if (ublk_support_batch(ubq))
+			ublk_batch_kick(ubq);
+		else
+			io_uring_cmd_complete_in_task(io->cmd,
+						      ublk_rq_task_work_cb);
 	}
 }
 
@@ -1201,8 +1341,12 @@ static enum blk_eh_timer_return ublk_timeout(struct request *rq)
 			nr_inflight++;
 	}
 
-	/* cancelable uring_cmd can't help us if all commands are in-flight */
-	if (nr_inflight == ubq->q_depth) {
+	/*
+	 * cancelable uring_cmd can't help us if all commands are in-flight,
+	 * or for batch io, if there is no batch command in flight
+	 */
+	if (nr_inflight == ubq->q_depth ||
+	    (ublk_support_batch(ubq) && !READ_ONCE(ubq->batch_busy))) {
 		struct ublk_device *ub = ubq->dev;
 
 		if (ublk_abort_requests(ub, ubq)) {
@@ -1287,6 +1431,34 @@ static int ublk_ch_release(struct inode *inode, struct file *filp)
 	return 0;
 }
 
+/* map the per-queue batch io array, which ublksrv writes commits to */
+static int ublk_ch_mmap_batch(struct ublk_device *ub,
+		struct vm_area_struct *vma, unsigned long phys_off)
+{
+	size_t sz = vma->vm_end - vma->vm_start;
+	unsigned max_sz = UBLK_MAX_QUEUE_DEPTH * sizeof(struct ublk_batch_elem);
+	unsigned long pfn, end;
+	int q_id;
+
+	if (!(ub->dev_info.flags & UBLK_F_BATCH_IO))
+		return -EINVAL;
+
+	end = UBLKSRV_BATCH_BUF_OFFSET + ub->dev_info.nr_hw_queues * max_sz;
+	if (phys_off >= end)
+		return -EINVAL;
+
+	q_id = (phys_off - UBLKSRV_BATCH_BUF_OFFSET) / max_sz;
+	if (phys_off != UBLKSRV_BATCH_BUF_OFFSET + q_id * max_sz ||
+	    sz != ublk_queue_batch_buf_size(ub, q_id))
+		return -EINVAL;
+
+	if (ublk_queue_use_bufs(ub, q_id))
+		return -ENOMEM;
+
+	pfn = virt_to_phys(ublk_get_queue(ub, q_id)->batch_buf) >> PAGE_SHIFT;
+	return remap_pfn_range(vma, vma->vm_start, pfn, sz, vma->vm_page_prot);
+}
+
 /* map pre-allocated per-queue cmd buffer to ublksrv daemon */
 static int ublk_ch_mmap(struct file *filp, struct vm_area_struct *vma)
 {
@@ -1306,6 +1478,9 @@ static int ublk_ch_mmap(struct file *filp, struct vm_area_struct *vma)
 	if (ret)
 		return ret;
 
+	if (phys_off >= UBLKSRV_BATCH_BUF_OFFSET)
+		return ublk_ch_mmap_batch(ub, vma, phys_off);
+
 	if (vma->vm_flags & VM_WRITE)
 		return -EPERM;
 
@@ -1321,6 +1496,9 @@ static int ublk_ch_mmap(struct file *filp, struct vm_area_struct *vma)
 	if (sz != ublk_queue_cmd_buf_size(ub, q_id))
 		return -EINVAL;
 
+	if (ublk_queue_use_bufs(ub, q_id))
+		return -ENOMEM;
+
 	pfn = virt_to_phys(ublk_queue_cmd_buf(ub, q_id)) >> PAGE_SHIFT;
 	return remap_pfn_range(vma, vma->vm_start, pfn, sz, vma->vm_page_prot);
 }
@@ -1358,6 +1536,18 @@ static void ublk_abort_queue(struct ublk_device *ub, struct ublk_queue *ubq)
 {
 	int i;
 
+	/*
+	 * Batch io requests are queued without a command of their own, fail
+	 * the ones no batch command has picked up.
+	 */
+	if (ublk_support_batch(ubq)) {
+		struct llist_node *io_cmds = llist_del_all(&ubq->io_cmds);
+		struct ublk_rq_data *data, *tmp;
+
+		llist_for_each_entry_safe(data, tmp, io_cmds, node)
+			__ublk_abort_rq(ubq, blk_mq_rq_from_pdu(data));
+	}
+
 	for (i = 0; i < ubq->q_depth; i++) {
 		struct ublk_io *io = &ubq->ios[i];
 
@@ -1409,6 +1599,20 @@ static bool ublk_abort_requests(struct ublk_device *ub, struct ublk_queue *ubq)
 	return true;
 }
 
+static void ublk_cancel_batch(struct ublk_queue *ubq, unsigned int issue_flags)
+{
+	struct io_uring_cmd *cmd;
+
+	spin_lock(&ubq->batch_lock);
+	cmd = ubq->batch_cmd;
+	ubq->batch_cmd = NULL;
+	spin_unlock(&ubq->batch_lock);
+
+	/* a claimed command is completed by its task work */
+	if (cmd)
+		ublk_batch_done(ubq, cmd, UBLK_IO_RES_ABORT, issue_flags);
+}
+
 static void ublk_cancel_cmd(struct ublk_queue *ubq, struct ublk_io *io,
 		unsigned int issue_flags)
 {
@@ -1444,7 +1648,7 @@ static void ublk_uring_cmd_cancel_fn(struct io_uring_cmd *cmd,
 	if (WARN_ON_ONCE(!ubq))
 		return;
 
-	if (WARN_ON_ONCE(pdu->tag >= ubq->q_depth))
+	if (WARN_ON_ONCE(pdu->tag >= ubq->q_depth && pdu->tag != UBLK_BATCH_TAG))
 		return;
 
 	task = io_uring_cmd_get_task(cmd);
@@ -1454,9 +1658,13 @@ static void ublk_uring_cmd_cancel_fn(struct io_uring_cmd *cmd,
 	ub = ubq->dev;
 	need_schedule = ublk_abort_requests(ub, ubq);
 
-	io = &ubq->ios[pdu->tag];
-	WARN_ON_ONCE(io->cmd != cmd);
-	ublk_cancel_cmd(ubq, io, issue_flags);
+	if (pdu->tag == UBLK_BATCH_TAG) {
+		ublk_cancel_batch(ubq, issue_flags);
+	} else {
+		io = &ubq->ios[pdu->tag];
+		WARN_ON_ONCE(io->cmd != cmd);
+		ublk_cancel_cmd(ubq, io, issue_flags);
+	}
 
 	if (need_schedule) {
 		if (ublk_can_use_recovery(ub))
@@ -1475,6 +1683,11 @@ static void ublk_cancel_queue(struct ublk_queue *ubq)
 {
 	int i;
 
+	if (ublk_support_batch(ubq)) {
+		ublk_cancel_batch(ubq, IO_URING_F_UNLOCKED);
+		return;
+	}
+
 	for (i = 0; i < ubq->q_depth; i++)
 		ublk_cancel_cmd(ubq, &ubq->ios[i], IO_URING_F_UNLOCKED);
 }
@@ -1650,6 +1863,97 @@ static inline void ublk_prep_cancel(struct io_uring_cmd *cmd,
 	io_uring_cmd_mark_cancelable(cmd, issue_flags);
 }
 
+/* the first batch command of a queue readies all of its ios */
+static void ublk_batch_fetch_all(struct ublk_device *ub, struct ublk_queue *ubq)
+{
+	int i;
+
+	for (i = 0; i < ubq->q_depth; i++) {
+		ublk_fill_io_cmd(&ubq->ios[i], NULL, 0);
+		ublk_mark_io_ready(ub, ubq);
+	}
+}
+
+static int ublk_batch_commit(struct ublk_device *ub, struct ublk_queue *ubq,
+			     unsigned int nr)
+{
+	unsigned int i;
+
+	for (i = 0; i < nr; i++) {
+		const struct ublk_batch_elem *elem = &ubq->batch_buf[i];
+		struct ublksrv_io_cmd ub_cmd = {
+			.q_id = ubq->q_id,
+			.tag = READ_ONCE(elem->tag),
+			.result = READ_ONCE(elem->result),
+			.zone_append_lba = READ_ONCE(elem->zone_append_lba),
+		};
+		struct ublk_io *io;
+
+		if (ub_cmd.tag >= ubq->q_depth)
+			return -EINVAL;
+
+		io = &ubq->ios[ub_cmd.tag];
+		if (!(io->flags & UBLK_IO_FLAG_OWNED_BY_SRV))
+			return -EINVAL;
+
+		ublk_fill_io_cmd(io, NULL, 0);
+		ublk_commit_completion(ub, &ub_cmd);
+	}
+	return 0;
+}
+
+static int ublk_batch_commit_and_fetch(struct ublk_device *ub,
+		struct ublk_queue *ubq, struct io_uring_cmd *cmd,
+		unsigned int issue_flags, unsigned int nr)
+{
+	int ret;
+
+	if (!ublk_support_batch(ubq) || nr > ubq->q_depth)
+		return -EINVAL;
+
+	spin_lock(&ubq->batch_lock);
+	if (ubq->batch_busy) {
+		spin_unlock(&ubq->batch_lock);
+		return -EBUSY;
+	}
+	ubq->batch_busy = true;
+	spin_unlock(&ubq->batch_lock);
+
+	if (!ublk_queue_ready(ubq)) {
+		if (nr) {
+			ret = -EINVAL;
+			goto fail;
+		}
+		ret = ublk_queue_use_bufs(ub, ubq->q_id);
+		if (ret)
+			goto fail;
+		ublk_batch_fetch_all(ub, ubq);
+	}
+
+	ret = ublk_batch_commit(ub, ubq, nr);
+	if (ret)
+		goto fail;
+
+	ublk_prep_cancel(cmd, issue_flags, ubq, UBLK_BATCH_TAG);
+
+	/* pairs with ublk_batch_kick() */
+	spin_lock(&ubq->batch_lock);
+	if (llist_empty(&ubq->io_cmds)) {
+		ubq->batch_cmd = cmd;
+		cmd = NULL;
+	}
+	spin_unlock(&ubq->batch_lock);
+
+	if (cmd)
+		io_uring_cmd_complete_in_task(cmd, ublk_batch_task_work_cb);
+	return -EIOCBQUEUED;
+fail:
+	spin_lock(&ubq->batch_lock);
+	ubq->batch_busy = false;
+	spin_unlock(&ubq->batch_lock);
+	return ret;
+}
+
 static int __ublk_ch_uring_cmd(struct io_uring_cmd *cmd,
 			       unsigned int issue_flags,
 			       const struct ublksrv_io_cmd *ub_cmd)
@@ -1676,6 +1980,20 @@ static int __ublk_ch_uring_cmd(struct io_uring_cmd *cmd,
 	if (ubq->ubq_daemon && ubq->ubq_daemon != current)
 		goto out;
 
+	if (_IOC_NR(cmd_op) == UBLK_IO_COMMIT_AND_FETCH_BATCH) {
+		ret = ublk_check_cmd_op(cmd_op);
+		if (!ret)
+			ret = ublk_batch_commit_and_fetch(ub, ubq, cmd,
+					issue_flags, ub_cmd->result);
+		if (ret == -EIOCBQUEUED)
+			return ret;
+		goto out;
+	}
+
+	/* batch io queues take batch commands only */
+	if (ublk_support_batch(ubq))
+		goto out;
+
 	if (tag >= ubq->q_depth)
 		goto out;
 
@@ -1727,6 +2045,11 @@ static int __ublk_ch_uring_cmd(struct io_uring_cmd *cmd,
 			goto out;
 		}
 
+		if (ublk_queue_use_bufs(ub, ubq->q_id)) {
+			ret = -ENOMEM;
+			goto out;
+		}
+
 		ublk_fill_io_cmd(io, cmd, ub_cmd->addr);
 		ublk_mark_io_ready(ub, ubq);
 		break;
@@ -1864,27 +2187,20 @@ static inline bool ublk_check_ubuf_dir(const struct request *req,
 	return false;
 }
 
-static struct request *ublk_check_and_get_req(struct kiocb *iocb,
-		struct iov_iter *iter, size_t *off, int dir)
+static struct request *ublk_check_and_get_req(struct ublk_device *ub,
+		loff_t pos, size_t *off, int dir)
 {
-	struct ublk_device *ub = iocb->ki_filp->private_data;
 	struct ublk_queue *ubq;
 	struct request *req;
 	size_t buf_off;
 	u16 tag, q_id;
 
-	if (!ub)
-		return ERR_PTR(-EACCES);
-
-	if (!user_backed_iter(iter))
-		return ERR_PTR(-EACCES);
-
 	if (ub->dev_info.state == UBLK_S_DEV_DEAD)
 		return ERR_PTR(-EACCES);
 
-	tag = ublk_pos_to_tag(iocb->ki_pos);
-	q_id = ublk_pos_to_hwq(iocb->ki_pos);
-	buf_off = ublk_pos_to_buf_off(iocb->ki_pos);
+	tag = ublk_pos_to_tag(pos);
+	q_id = ublk_pos_to_hwq(pos);
+	buf_off = ublk_pos_to_buf_off(pos);
 
 	if (q_id >= ub->dev_info.nr_hw_queues)
 		return ERR_PTR(-EINVAL);
@@ -1915,12 +2231,16 @@ static struct request *ublk_check_and_get_req(struct kiocb *iocb,
 
 static ssize_t ublk_ch_read_iter(struct kiocb *iocb, struct iov_iter *to)
 {
+	struct ublk_device *ub = iocb->ki_filp->private_data;
 	struct ublk_queue *ubq;
 	struct request *req;
 	size_t buf_off;
 	size_t ret;
 
-	req = ublk_check_and_get_req(iocb, to, &buf_off, ITER_DEST);
+	if (!ub || !user_backed_iter(to))
+		return -EACCES;
+
+	req = ublk_check_and_get_req(ub, iocb->ki_pos, &buf_off, ITER_DEST);
 	if (IS_ERR(req))
 		return PTR_ERR(req);
 
@@ -1933,12 +2253,21 @@ static ssize_t ublk_ch_read_iter(struct kiocb *iocb, struct iov_iter *to)
 
 static ssize_t ublk_ch_write_iter(struct kiocb *iocb, struct iov_iter *from)
 {
+	struct ublk_device *ub = iocb->ki_filp->private_data;
 	struct ublk_queue *ubq;
 	struct request *req;
 	size_t buf_off;
 	size_t ret;
 
-	req = ublk_check_and_get_req(iocb, from, &buf_off, ITER_SOURCE);
+	if (!ub)
+		return -EACCES;
+
+	/* pipe pages are passed as bvec by iter_file_splice_write() */
+	if (!user_backed_iter(from) &&
+	    !(iov_iter_is_bvec(from) && ublk_dev_support_zero_copy(ub)))
+		return -EACCES;
+
+	req = ublk_check_and_get_req(ub, iocb->ki_pos, &buf_off, ITER_SOURCE);
 	if (IS_ERR(req))
 		return PTR_ERR(req);
 
@@ -1949,6 +2278,106 @@ static ssize_t ublk_ch_write_iter(struct kiocb *iocb, struct iov_iter *from)
 	return ret;
 }
 
+/*
+ * Pipe buffers filled by ublk_ch_splice_read() hold a request reference
+ * besides the page one, so the request isn't completed, and its pages
+ * aren't handed back to the upper layer, until the data is consumed.
+ */
+static void ublk_pipe_buf_release(struct pipe_inode_info *pipe,
+		struct pipe_buffer *buf)
+{
+	struct request *req = (struct request *)buf->private;
+
+	put_page(buf->page);
+	ublk_put_req_ref(req->mq_hctx->driver_data, req);
+}
+
+static bool ublk_pipe_buf_get(struct pipe_inode_info *pipe,
+		struct pipe_buffer *buf)
+{
+	struct request *req = (struct request *)buf->private;
+	struct ublk_queue *ubq = req->mq_hctx->driver_data;
+
+	if (!ublk_get_req_ref(ubq, req))
+		return false;
+	if (!generic_pipe_buf_get(pipe, buf)) {
+		ublk_put_req_ref(ubq, req);
+		return false;
+	}
+	return true;
+}
+
+static const struct pipe_buf_operations ublk_pipe_buf_ops = {
+	.release	= ublk_pipe_buf_release,
+	.get		= ublk_pipe_buf_get,
+};
+
+/*
+ * Zero copy of WRITE request data: the request's bio pages are added to
+ * the pipe, from which the server can splice them to a socket or file.
+ */
+static ssize_t ublk_ch_splice_read(struct file *in, loff_t *ppos,
+		struct pipe_inode_info *pipe, size_t len, unsigned int flags)
+{
+	struct ublk_device *ub = in->private_data;
+	struct ublk_io_iter iter;
+	struct ublk_queue *ubq;
+	struct request *req;
+	size_t buf_off;
+	ssize_t ret = 0;
+
+	if (!ub || !ublk_dev_support_zero_copy(ub))
+		return -EINVAL;
+
+	req = ublk_check_and_get_req(ub, *ppos, &buf_off, ITER_DEST);
+	if (IS_ERR(req))
+		return PTR_ERR(req);
+	ubq = req->mq_hctx->driver_data;
+
+	len = min_t(size_t, len, blk_rq_bytes(req) - buf_off);
+	if (!ublk_advance_io_iter(req, &iter, buf_off))
+		goto out;
+
+	while (len && iter.bio) {
+		struct bio_vec bv = bio_iter_iovec(iter.bio, iter.iter);
+		struct pipe_buffer buf = {
+			.ops		= &ublk_pipe_buf_ops,
+			.page		= bv.bv_page,
+			.offset		= bv.bv_offset,
+			.len		= min_t(size_t, len, bv.bv_len),
+			.private	= (unsigned long)req,
+		};
+		ssize_t added;
+
+		/* we hold a reference already, so this can't fail */
+		WARN_ON_ONCE(!ublk_get_req_ref(ubq, req));
+		get_page(bv.bv_page);
+
+		/* add_to_pipe() releases the buffer on failure */
+		added = add_to_pipe(pipe, &buf);
+		if (added < 0) {
+			if (!ret)
+				ret = added;
+			break;
+		}
+
+		ret += added;
+		len -= added;
+		bio_advance_iter_single(iter.bio, &iter.iter, added);
+		if (!iter.iter.bi_size) {
+			iter.bio = iter.bio->bi_next;
+			if (iter.bio)
+				iter.iter = iter.bio->bi_iter;
+		}
+	}
+
+	if (ret > 0)
+		*ppos += ret;
+out:
+	ublk_put_req_ref(ubq, req);
+	return ret;
+}
+
 static const struct file_operations ublk_ch_fops = {
 	.owner = THIS_MODULE,
 	.open = ublk_ch_open,
@@ -1956,6 +2385,8 @@ static const struct file_operations ublk_ch_fops = {
 	.llseek = no_llseek,
 	.read_iter = ublk_ch_read_iter,
 	.write_iter = ublk_ch_write_iter,
+	.splice_read = ublk_ch_splice_read,
+	.splice_write = iter_file_splice_write,
 	.uring_cmd = ublk_ch_uring_cmd,
 	.mmap = ublk_ch_mmap,
 };
@@ -1969,28 +2400,27 @@ static void ublk_deinit_queue(struct ublk_device *ub, int q_id)
 		put_task_struct(ubq->ubq_daemon);
 	if (ubq->io_cmd_buf)
 		free_pages((unsigned long)ubq->io_cmd_buf, get_order(size));
+	if (ubq->batch_buf)
+		free_pages((unsigned long)ubq->batch_buf,
+			   get_order(ublk_queue_batch_buf_size(ub, q_id)));
 }
 
 static int ublk_init_queue(struct ublk_device *ub, int q_id)
 {
 	struct ublk_queue *ubq = ublk_get_queue(ub, q_id);
-	gfp_t gfp_flags = GFP_KERNEL | __GFP_ZERO;
-	void *ptr;
-	int size;
 
 	spin_lock_init(&ubq->cancel_lock);
+	spin_lock_init(&ubq->batch_lock);
 	ubq->flags = ub->dev_info.flags;
 	ubq->q_id = q_id;
 	ubq->q_depth = ub->dev_info.queue_depth;
-	size = ublk_queue_cmd_buf_size(ub, q_id);
+	ubq->dev = ub;
 
-	ptr = (void *) __get_free_pages(gfp_flags, get_order(size));
-	if (!ptr)
-		return -ENOMEM;
+	/* allocated once the daemon's node is known */
+	if (ublk_queue_numa(ubq))
+		return 0;
 
-	ubq->io_cmd_buf = ptr;
-	ubq->dev = ub;
-	return 0;
+	return ublk_alloc_queue_bufs(ub, q_id, NUMA_NO_NODE);
 }
 
 static void ublk_deinit_queues(struct ublk_device *ub)
@@ -2311,6 +2741,84 @@ static int ublk_ctrl_get_queue_affinity(struct ublk_device *ub,
 	return ret;
 }
 
+static void ublk_fill_queue_map_entry(struct ublk_device *ub, int q_id,
+		struct ublk_queue_map_entry *e)
+{
+	struct ublk_queue *ubq = ublk_get_queue(ub, q_id);
+	unsigned int cpu;
+
+	e->q_id = q_id;
+	/* ublk_init_hctx() binds hw queue N to ublk queue N */
+	e->hctx = q_id;
+	e->hctx_node = NUMA_NO_NODE;
+	for_each_possible_cpu(cpu) {
+		if (ub->tag_set.map[HCTX_TYPE_DEFAULT].mq_map[cpu] != q_id)
+			continue;
+		if (!e->nr_cpus++)
+			e->hctx_node = cpu_to_node(cpu);
+	}
+
+	e->buf_node = ubq->io_cmd_buf ?
+		page_to_nid(virt_to_page(ubq->io_cmd_buf)) : NUMA_NO_NODE;
+
+	/* ubq_daemon is protected by ub->mutex */
+	if (ubq->ubq_daemon) {
+		e->daemon_tid = task_pid_vnr(ubq->ubq_daemon);
+		e->daemon_cpu = task_cpu(ubq->ubq_daemon);
+	} else {
+		e->daemon_tid = -1;
+		e->daemon_cpu = -1;
+	}
+}
+
+static int ublk_ctrl_get_queue_map(struct ublk_device *ub,
+		struct io_uring_cmd *cmd)
+{
+	const struct ublksrv_ctrl_cmd *header = io_uring_sqe_cmd(cmd->sqe);
+	void __user *argp = (void __user *)(unsigned long)header->addr;
+	unsigned int nr_queues = ub->dev_info.nr_hw_queues;
+	struct ublk_queue_map map = {
+		.nr_hw_queues = nr_queues,
+		.nr_cpus = nr_cpu_ids,
+	};
+	struct ublk_queue_map_entry *entries;
+	size_t entries_len, len;
+	__u16 *cpu_queue;
+	unsigned int cpu;
+	int i, ret;
+
+	if (header->len < sizeof(map) || !header->addr)
+		return -EINVAL;
+
+	entries_len = nr_queues * sizeof(*entries);
+	len = sizeof(map) + entries_len + nr_cpu_ids * sizeof(*cpu_queue);
+
+	if (copy_to_user(argp, &map, sizeof(map)))
+		return -EFAULT;
+	if (header->len < len)
+		return -EOVERFLOW;
+
+	entries = kvzalloc(len - sizeof(map), GFP_KERNEL);
+	if (!entries)
+		return -ENOMEM;
+	cpu_queue = (void *)entries + entries_len;
+
+	mutex_lock(&ub->mutex);
+	for (i = 0; i < nr_queues; i++)
+		ublk_fill_queue_map_entry(ub, i, &entries[i]);
+	mutex_unlock(&ub->mutex);
+
+	for (cpu = 0; cpu < nr_cpu_ids; cpu++)
+		cpu_queue[cpu] = cpu_possible(cpu) ?
+			ub->tag_set.map[HCTX_TYPE_DEFAULT].mq_map[cpu] : U16_MAX;
+
+	ret = 0;
+	if (copy_to_user(argp + sizeof(map), entries, len - sizeof(map)))
+		ret = -EFAULT;
+	kvfree(entries);
+	return ret;
+}
+
 static inline void ublk_dump_dev_info(struct ublksrv_ctrl_dev_info *info)
 {
 	pr_devel("%s: dev id %d flags %llx\n", __func__,
@@ -2409,10 +2917,21 @@ static int ublk_ctrl_add_dev(struct io_uring_cmd *cmd)
 	ub->dev_info.flags |= UBLK_F_CMD_IOCTL_ENCODE |
 		UBLK_F_URING_CMD_COMP_IN_TASK;
 
+	/* zero copy uses the same buffer addressing as USER_COPY */
+	if (ublk_dev_support_zero_copy(ub))
+		ub->dev_info.flags |= UBLK_F_USER_COPY;
+
 	/* GET_DATA isn't needed any more with USER_COPY */
 	if (ublk_dev_is_user_copy(ub))
 		ub->dev_info.flags &= ~UBLK_F_NEED_GET_DATA;
 
+	/* Batch io commands don't pass buffer addresses */
+	if ((ub->dev_info.flags & UBLK_F_BATCH_IO) &&
+	    !ublk_dev_is_user_copy(ub)) {
+		ret = -EINVAL;
+		goto out_free_dev_number;
+	}
+
 	/* Zoned storage support requires user copy feature */
 	if (ublk_dev_is_zoned(ub) &&
 	    (!IS_ENABLED(CONFIG_BLK_DEV_ZONED) || !ublk_dev_is_user_copy(ub))) {
@@ -2420,9 +2939,6 @@ static int ublk_ctrl_add_dev(struct io_uring_cmd *cmd)
 		goto out_free_dev_number;
 	}
 
-	/* We are not ready to support zero copy */
-	ub->dev_info.flags &= ~UBLK_F_SUPPORT_ZERO_COPY;
-
 	ub->dev_info.nr_hw_queues = min_t(unsigned int,
 			ub->dev_info.nr_hw_queues, nr_cpu_ids);
 	ublk_align_max_io_size(ub);
@@ -2642,6 +3158,8 @@ static void ublk_queue_reinit(struct ublk_device *ub, struct ublk_queue *ubq)
 	ubq->ubq_daemon = NULL;
 	ubq->timeout = false;
 	ubq->canceling = false;
+	ubq->batch_cmd = NULL;
+	ubq->batch_busy = false;
 
 	for (i = 0; i < ubq->q_depth; i++) {
 		struct ublk_io *io = &ubq->ios[i];
@@ -2737,7 +3255,7 @@ static int ublk_ctrl_get_features(struct io_uring_cmd *cmd)
 {
 	const struct ublksrv_ctrl_cmd *header = io_uring_sqe_cmd(cmd->sqe);
 	void __user *argp = (void __user *)(unsigned long)header->addr;
-	u64 features = UBLK_F_ALL & ~UBLK_F_SUPPORT_ZERO_COPY;
+	u64 features = UBLK_F_ALL;
 
 	if (header->len != UBLK_FEATURES_LEN || !header->addr)
 		return -EINVAL;
@@ -2822,6 +3340,7 @@ static int ublk_ctrl_uring_cmd_permission(struct ublk_device *ub,
 	case UBLK_CMD_GET_DEV_INFO:
 	case UBLK_CMD_GET_DEV_INFO2:
 	case UBLK_CMD_GET_QUEUE_AFFINITY:
+	case UBLK_CMD_GET_QUEUE_MAP:
 	case UBLK_CMD_GET_PARAMS:
 	case (_IOC_NR(UBLK_U_CMD_GET_FEATURES)):
 		mask = MAY_READ;
@@ -2912,6 +3431,9 @@ static int ublk_ctrl_uring_cmd(struct io_uring_cmd *cmd,
 	case UBLK_CMD_GET_QUEUE_AFFINITY:
 		ret = ublk_ctrl_get_queue_affinity(ub, cmd);
 		break;
+	case UBLK_CMD_GET_QUEUE_MAP:
+		ret = ublk_ctrl_get_queue_map(ub, cmd);
+		break;
 	case UBLK_CMD_GET_PARAMS:
 		ret = ublk_ctrl_get_params(ub, cmd);
 		break;
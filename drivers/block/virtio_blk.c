@@ -16,6 +16,7 @@
 #include <linux/blk-mq-virtio.h>
 #include <linux/numa.h>
 #include <linux/vmalloc.h>
+#include <linux/dim.h>
 #include <uapi/linux/virtio_ring.h>
 
 #define PART_BITS 4
@@ -31,6 +32,12 @@
 #define VIRTIO_BLK_INLINE_SG_CNT	2
 #endif
 
+/*
+ * Indirect tables preallocated per descriptor: out header, two data
+ * segments and the in header, enough for small random I/O.
+ */
+#define VIRTIO_BLK_INDIRECT_POOL_SG	4
+
 static unsigned int num_request_queues;
 module_param(num_request_queues, uint, 0644);
 MODULE_PARM_DESC(num_request_queues,
@@ -42,6 +49,11 @@ static unsigned int poll_queues;
 module_param(poll_queues, uint, 0644);
 MODULE_PARM_DESC(poll_queues, "The number of dedicated virtqueues for polling I/O");
 
+static bool adaptive_irq;
+module_param(adaptive_irq, bool, 0444);
+MODULE_PARM_DESC(adaptive_irq,
+		 "Adaptively delay completion interrupts under load (requires VIRTIO_RING_F_EVENT_IDX)");
+
 static int major;
 static DEFINE_IDA(vd_index_ida);
 
@@ -50,6 +62,14 @@ static struct workqueue_struct *virtblk_wq;
 struct virtio_blk_vq {
 	struct virtqueue *vq;
 	spinlock_t lock;
+	/* Re-arm the callback with virtqueue_enable_cb_delayed() */
+	bool cb_delayed;
+	bool dim_enabled;
+	struct dim dim;
+	/* DIM sample counters, protected by lock */
+	u16 dim_events;
+	u64 dim_comps;
+	u64 dim_bytes;
 	char name[VQ_NAME_LEN];
 } ____cacheline_aligned_in_smp;
 
@@ -348,31 +368,105 @@ static inline void virtblk_request_done(struct request *req)
 	blk_mq_end_request(req, status);
 }
 
+static void virtblk_complete_batch(struct io_comp_batch *iob)
+{
+	struct request *req;
+
+	rq_list_for_each(&iob->req_list, req) {
+		virtblk_unmap_data(req, blk_mq_rq_to_pdu(req));
+		virtblk_cleanup_cmd(req);
+	}
+	blk_mq_end_request_batch(iob);
+}
+
+/*
+ * virtio-blk has no device side interrupt moderation, the only knob we have
+ * is where the used event index is placed when the callback is re-armed.
+ * DIM runs the generic CQ algorithm on completions and bytes per interrupt,
+ * like a NIC receive queue does. When it picks a profile with a longer
+ * moderation period than the default, ask the device to interrupt only once
+ * most of the outstanding buffers have been used.
+ */
+static void virtblk_dim_work(struct work_struct *work)
+{
+	struct dim *dim = container_of(work, struct dim, work);
+	struct virtio_blk_vq *vblk_vq = container_of(dim, struct virtio_blk_vq,
+						     dim);
+	struct dim_cq_moder moder, def;
+
+	if (!IS_ENABLED(CONFIG_DIMLIB))
+		return;
+
+	moder = net_dim_get_rx_moderation(dim->mode, dim->profile_ix);
+	def = net_dim_get_def_rx_moderation(dim->mode);
+	WRITE_ONCE(vblk_vq->cb_delayed, moder.usec > def.usec);
+	dim->state = DIM_START_MEASURE;
+}
+
+static void virtblk_dim_update(struct virtio_blk_vq *vblk_vq,
+			       unsigned int found, u64 bytes)
+{
+	struct dim_sample sample = {};
+
+	vblk_vq->dim_events++;
+	vblk_vq->dim_comps += found;
+	vblk_vq->dim_bytes += bytes;
+	dim_update_sample(vblk_vq->dim_events, vblk_vq->dim_comps,
+			  vblk_vq->dim_bytes, &sample);
+	net_dim(&vblk_vq->dim, sample);
+}
+
+static bool virtblk_enable_cb(struct virtio_blk_vq *vblk_vq)
+{
+	if (READ_ONCE(vblk_vq->cb_delayed))
+		return virtqueue_enable_cb_delayed(vblk_vq->vq);
+	return virtqueue_enable_cb(vblk_vq->vq);
+}
+
 static void virtblk_done(struct virtqueue *vq)
 {
 	struct virtio_blk *vblk = vq->vdev->priv;
-	bool req_done = false;
-	int qid = vq->index;
+	struct virtio_blk_vq *vblk_vq = &vblk->vqs[vq->index];
+	DEFINE_IO_COMP_BATCH(iob);
+	unsigned int found = 0;
+	u64 bytes = 0;
 	struct virtblk_req *vbr;
 	unsigned long flags;
 	unsigned int len;
 
-	spin_lock_irqsave(&vblk->vqs[qid].lock, flags);
+	spin_lock_irqsave(&vblk_vq->lock, flags);
 	do {
 		virtqueue_disable_cb(vq);
-		while ((vbr = virtqueue_get_buf(vblk->vqs[qid].vq, &len)) != NULL) {
+		while ((vbr = virtqueue_get_buf(vblk_vq->vq, &len)) != NULL) {
 			struct request *req = blk_mq_rq_from_pdu(vbr);
 
-			if (likely(!blk_should_fake_timeout(req->q)))
-				blk_mq_complete_request(req);
-			req_done = true;
+			found++;
+			bytes += blk_rq_bytes(req);
+			if (unlikely(blk_should_fake_timeout(req->q)))
+				continue;
+			if (blk_mq_complete_request_remote(req))
+				continue;
+			/*
+			 * Zone append needs the written sector copied back
+			 * in virtblk_request_done(), keep it off the batch.
+			 */
+			if (req_op(req) == REQ_OP_ZONE_APPEND ||
+			    !blk_mq_add_to_batch(req, &iob,
+						 virtblk_vbr_status(vbr),
+						 virtblk_complete_batch))
+				virtblk_request_done(req);
 		}
-	} while (!virtqueue_enable_cb(vq));
+	} while (!virtblk_enable_cb(vblk_vq));
 
 	/* In case queue is stopped waiting for more buffers. */
-	if (req_done)
+	if (found)
 		blk_mq_start_stopped_hw_queues(vblk->disk->queue, true);
-	spin_unlock_irqrestore(&vblk->vqs[qid].lock, flags);
+	if (IS_ENABLED(CONFIG_DIMLIB) && vblk_vq->dim_enabled)
+		virtblk_dim_update(vblk_vq, found, bytes);
+	spin_unlock_irqrestore(&vblk_vq->lock, flags);
+
+	if (iob.complete)
+		iob.complete(&iob);
 }
 
 static void virtio_commit_rqs(struct blk_mq_hw_ctx *hctx)
@@ -1025,8 +1119,24 @@ static int init_vq(struct virtio_blk *vblk)
 		goto out;
 
 	for (i = 0; i < num_vqs; i++) {
-		spin_lock_init(&vblk->vqs[i].lock);
-		vblk->vqs[i].vq = vqs[i];
+		struct virtio_blk_vq *vblk_vq = &vblk->vqs[i];
+
+		spin_lock_init(&vblk_vq->lock);
+		vblk_vq->vq = vqs[i];
+		/* Not fatal, the ring falls back to allocating tables. */
+		virtqueue_set_indirect_pool(vqs[i], VIRTIO_BLK_INDIRECT_POOL_SG);
+		vblk_vq->cb_delayed = false;
+		vblk_vq->dim_enabled = IS_ENABLED(CONFIG_DIMLIB) &&
+			adaptive_irq &&
+			i < num_vqs - num_poll_vqs &&
+			virtio_has_feature(vdev, VIRTIO_RING_F_EVENT_IDX);
+		memset(&vblk_vq->dim, 0, sizeof(vblk_vq->dim));
+		INIT_WORK(&vblk_vq->dim.work, virtblk_dim_work);
+		vblk_vq->dim.mode = DIM_CQ_PERIOD_MODE_START_FROM_CQE;
+		vblk_vq->dim.profile_ix = NET_DIM_DEF_PROFILE_CQE;
+		vblk_vq->dim_events = 0;
+		vblk_vq->dim_comps = 0;
+		vblk_vq->dim_bytes = 0;
 	}
 	vblk->num_vqs = num_vqs;
 
@@ -1038,6 +1148,18 @@ static int init_vq(struct virtio_blk *vblk)
 	return err;
 }
 
+static void virtblk_del_vqs(struct virtio_device *vdev,
+			    struct virtio_blk *vblk)
+{
+	int i;
+
+	for (i = 0; i < vblk->num_vqs; i++)
+		cancel_work_sync(&vblk->vqs[i].dim.work);
+
+	vdev->config->del_vqs(vdev);
+	kfree(vblk->vqs);
+}
+
 /*
  * Legacy naming scheme used for virtio devices.  We are stuck with it for
  * virtio blk but don't ever use it for any new driver.
@@ -1190,17 +1312,6 @@ static void virtblk_map_queues(struct blk_mq_tag_set *set)
 	}
 }
 
-static void virtblk_complete_batch(struct io_comp_batch *iob)
-{
-	struct request *req;
-
-	rq_list_for_each(&iob->req_list, req) {
-		virtblk_unmap_data(req, blk_mq_rq_to_pdu(req));
-		virtblk_cleanup_cmd(req);
-	}
-	blk_mq_end_request_batch(iob);
-}
-
 static int virtblk_poll(struct blk_mq_hw_ctx *hctx, struct io_comp_batch *iob)
 {
 	struct virtio_blk *vblk = hctx->queue->queuedata;
@@ -1551,8 +1662,7 @@ static int virtblk_probe(struct virtio_device *vdev)
 out_free_tags:
 	blk_mq_free_tag_set(&vblk->tag_set);
 out_free_vq:
-	vdev->config->del_vqs(vdev);
-	kfree(vblk->vqs);
+	virtblk_del_vqs(vdev, vblk);
 out_free_vblk:
 	kfree(vblk);
 out_free_index:
@@ -1579,8 +1689,7 @@ static void virtblk_remove(struct virtio_device *vdev)
 	/* Virtqueues are stopped, nothing can use vblk->vdev anymore. */
 	vblk->vdev = NULL;
 
-	vdev->config->del_vqs(vdev);
-	kfree(vblk->vqs);
+	virtblk_del_vqs(vdev, vblk);
 
 	mutex_unlock(&vblk->vdev_mutex);
 
@@ -1601,8 +1710,7 @@ static int virtblk_freeze(struct virtio_device *vdev)
 	/* Make sure no work handler is accessing the device. */
 	flush_work(&vblk->config_work);
 
-	vdev->config->del_vqs(vdev);
-	kfree(vblk->vqs);
+	virtblk_del_vqs(vdev, vblk);
 
 	return 0;
 }
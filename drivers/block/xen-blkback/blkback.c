@@ -668,17 +668,11 @@ static unsigned int xen_blkbk_unmap_prepare(
 	return invcount;
 }
 
-static void xen_blkbk_unmap_and_respond_callback(int result, struct gntab_unmap_queue_data *data)
+static void xen_blkbk_respond(struct pending_req *pending_req)
 {
-	struct pending_req *pending_req = (struct pending_req *)(data->data);
 	struct xen_blkif_ring *ring = pending_req->ring;
 	struct xen_blkif *blkif = ring->blkif;
 
-	/* BUG_ON used to reproduce existing behaviour,
-	   but is this the best way to deal with this? */
-	BUG_ON(result);
-
-	gnttab_page_cache_put(&ring->free_pages, data->pages, data->count);
 	make_response(ring, pending_req->id,
 		      pending_req->operation, pending_req->status);
 	free_req(ring, pending_req);
@@ -700,6 +694,19 @@ static void xen_blkbk_unmap_and_respond_callback(int result, struct gntab_unmap_
 	xen_blkif_put(blkif);
 }
 
+static void xen_blkbk_unmap_and_respond_callback(int result, struct gntab_unmap_queue_data *data)
+{
+	struct pending_req *pending_req = (struct pending_req *)(data->data);
+	struct xen_blkif_ring *ring = pending_req->ring;
+
+	/* BUG_ON used to reproduce existing behaviour,
+	   but is this the best way to deal with this? */
+	BUG_ON(result);
+
+	gnttab_page_cache_put(&ring->free_pages, data->pages, data->count);
+	xen_blkbk_respond(pending_req);
+}
+
 static void xen_blkbk_unmap_and_respond(struct pending_req *req)
 {
 	struct gntab_unmap_queue_data* work = &req->gnttab_unmap_data;
@@ -721,6 +728,218 @@ static void xen_blkbk_unmap_and_respond(struct pending_req *req)
 }
 
 
+/*
+ * Grant copy mode: the request data lives in local pages and is moved
+ * to/from the frontend with batched GNTTABOP_copy hypercalls, so the data
+ * grants are never mapped into the backend. Indirect descriptor pages are
+ * still mapped through xen_blkbk_map() like in the default mode.
+ */
+static int xen_blkbk_copy_alloc(struct pending_req *req)
+{
+	struct grant_page **pages = req->segments;
+	struct seg_buf *seg = req->seg;
+	struct page *page = NULL;
+	unsigned int off = PAGE_SIZE;
+	int i;
+
+	/*
+	 * Frontends often send segments smaller than a page, so pack them
+	 * back to back into as few local pages as possible. A segment must
+	 * not straddle a Xen page, as that would need two copy ops. Every
+	 * segment holds a reference to the page it lives in.
+	 */
+	for (i = 0; i < req->nr_segs; i++) {
+		unsigned int len = seg[i].nsec << 9;
+
+		if (xen_offset_in_page(off) + len > XEN_PAGE_SIZE)
+			off = ALIGN(off, XEN_PAGE_SIZE);
+		if (off + len > PAGE_SIZE) {
+			page = alloc_page(GFP_KERNEL | __GFP_NOWARN);
+			if (!page)
+				goto fail;
+			off = 0;
+		} else {
+			get_page(page);
+		}
+
+		pages[i]->page = page;
+		pages[i]->persistent_gnt = NULL;
+		pages[i]->handle = BLKBACK_INVALID_HANDLE;
+		seg[i].buf_offset = off;
+		off += len;
+	}
+
+	return 0;
+
+fail:
+	while (i--) {
+		put_page(pages[i]->page);
+		pages[i]->page = NULL;
+	}
+	return -ENOMEM;
+}
+
+static void xen_blkbk_copy_release(struct pending_req *req)
+{
+	struct grant_page **pages = req->segments;
+	int i;
+
+	for (i = 0; i < req->nr_segs; i++) {
+		put_page(pages[i]->page);
+		pages[i]->page = NULL;
+	}
+}
+
+static void xen_blkbk_copy_setup(struct pending_req *req,
+				 struct gnttab_copy *op, bool to_frontend)
+{
+	domid_t domid = req->ring->blkif->domid;
+	int i;
+
+	for (i = 0; i < req->nr_segs; i++, op++) {
+		struct grant_page *page = req->segments[i];
+		struct seg_buf *seg = &req->seg[i];
+		unsigned long gfn = pfn_to_gfn(page_to_xen_pfn(page->page) +
+					       XEN_PFN_DOWN(seg->buf_offset));
+		unsigned int off = xen_offset_in_page(seg->buf_offset);
+
+		if (to_frontend) {
+			op->source.u.gmfn = gfn;
+			op->source.domid = DOMID_SELF;
+			op->source.offset = off;
+			op->dest.u.ref = page->gref;
+			op->dest.domid = domid;
+			op->dest.offset = seg->offset;
+			op->flags = GNTCOPY_dest_gref;
+		} else {
+			op->source.u.ref = page->gref;
+			op->source.domid = domid;
+			op->source.offset = seg->offset;
+			op->dest.u.gmfn = gfn;
+			op->dest.domid = DOMID_SELF;
+			op->dest.offset = off;
+			op->flags = GNTCOPY_source_gref;
+		}
+		op->len = seg->nsec << 9;
+	}
+}
+
+static bool xen_blkbk_copy_failed(struct pending_req *req,
+				  struct gnttab_copy *op)
+{
+	int i;
+
+	for (i = 0; i < req->nr_segs; i++) {
+		if (op[i].status != GNTST_okay) {
+			pr_debug("grant copy failed for gref %u: %d\n",
+				 req->segments[i]->gref, op[i].status);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/*
+ * Copy in the data of all queued writes with one batched hypercall and
+ * hand their bios to the block layer. Called from the ring thread only.
+ */
+static void xen_blkbk_copy_flush(struct xen_blkif_ring *ring)
+{
+	struct pending_req *req, *n;
+	struct gnttab_copy *op = ring->copy_ops;
+	struct blk_plug plug;
+	int i;
+
+	if (!ring->copy_nr)
+		return;
+
+	gnttab_batch_copy(ring->copy_ops, ring->copy_nr);
+
+	blk_start_plug(&plug);
+	list_for_each_entry_safe(req, n, &ring->copy_wr_list, copy_list) {
+		bool failed = xen_blkbk_copy_failed(req, op);
+
+		list_del(&req->copy_list);
+		op += req->nr_segs;
+
+		for (i = 0; i < req->nr_bios; i++) {
+			if (failed)
+				bio_io_error(req->biolist[i]);
+			else
+				submit_bio(req->biolist[i]);
+		}
+	}
+	blk_finish_plug(&plug);
+
+	ring->copy_nr = 0;
+}
+
+static void xen_blkbk_copy_queue_write(struct xen_blkif_ring *ring,
+				       struct pending_req *req)
+{
+	if (ring->copy_nr + req->nr_segs > BLKBACK_COPY_BATCH)
+		xen_blkbk_copy_flush(ring);
+
+	xen_blkbk_copy_setup(req, ring->copy_ops + ring->copy_nr, false);
+	ring->copy_nr += req->nr_segs;
+	list_add_tail(&req->copy_list, &ring->copy_wr_list);
+}
+
+/*
+ * Copy out the data of completed reads, batching as many requests per
+ * hypercall as fit, and respond to the frontend.
+ */
+void xen_blkbk_copy_rd_work(struct work_struct *work)
+{
+	struct xen_blkif_ring *ring = container_of(work, typeof(*ring),
+						   copy_rd_work);
+	struct llist_node *node, *first;
+	struct pending_req *req;
+
+	node = llist_reverse_order(llist_del_all(&ring->copy_rd_done));
+	while (node) {
+		struct gnttab_copy *op = ring->copy_out_ops;
+		unsigned int nr = 0;
+
+		for (first = node; node; node = node->next) {
+			req = llist_entry(node, struct pending_req, copy_node);
+			if (nr && nr + req->nr_segs > BLKBACK_COPY_BATCH)
+				break;
+			xen_blkbk_copy_setup(req, op + nr, true);
+			nr += req->nr_segs;
+		}
+
+		gnttab_batch_copy(op, nr);
+
+		while (first != node) {
+			req = llist_entry(first, struct pending_req, copy_node);
+			first = first->next;
+			if (xen_blkbk_copy_failed(req, op))
+				req->status = BLKIF_RSP_ERROR;
+			op += req->nr_segs;
+			xen_blkbk_copy_release(req);
+			xen_blkbk_respond(req);
+		}
+	}
+}
+
+static void xen_blkbk_copy_complete(struct pending_req *req)
+{
+	struct xen_blkif_ring *ring = req->ring;
+
+	if (req->operation == BLKIF_OP_READ && req->nr_segs &&
+	    req->status == BLKIF_RSP_OKAY) {
+		if (llist_add(&req->copy_node, &ring->copy_rd_done))
+			schedule_work(&ring->copy_rd_work);
+		return;
+	}
+
+	xen_blkbk_copy_release(req);
+	xen_blkbk_respond(req);
+}
+
+
 /*
  * Unmap the grant references.
  *
@@ -953,6 +1172,7 @@ static int xen_blkbk_parse_indirect(struct blkif_request *req,
 
 		seg[n].nsec = last_sect - first_sect + 1;
 		seg[n].offset = first_sect << 9;
+		seg[n].buf_offset = seg[n].offset;
 		preq->nr_sects += seg[n].nsec;
 	}
 
@@ -1059,8 +1279,12 @@ static void __end_block_io_op(struct pending_req *pending_req,
 	 * the grant references associated with 'request' and provide
 	 * the proper response on the ring.
 	 */
-	if (atomic_dec_and_test(&pending_req->pendcnt))
-		xen_blkbk_unmap_and_respond(pending_req);
+	if (atomic_dec_and_test(&pending_req->pendcnt)) {
+		if (pending_req->ring->blkif->vbd.grant_copy)
+			xen_blkbk_copy_complete(pending_req);
+		else
+			xen_blkbk_unmap_and_respond(pending_req);
+	}
 }
 
 /*
@@ -1264,6 +1488,8 @@ __do_block_io_op(struct xen_blkif_ring *ring, unsigned int *eoi_flags)
 		cond_resched();
 	}
 done:
+	/* Start the writes whose data copy was batched above. */
+	xen_blkbk_copy_flush(ring);
 	return more_to_do;
 }
 
@@ -1368,6 +1594,7 @@ static int dispatch_rw_block_io(struct xen_blkif_ring *ring,
 			seg[i].nsec = req->u.rw.seg[i].last_sect -
 				req->u.rw.seg[i].first_sect + 1;
 			seg[i].offset = (req->u.rw.seg[i].first_sect << 9);
+			seg[i].buf_offset = seg[i].offset;
 			if ((req->u.rw.seg[i].last_sect >= (XEN_PAGE_SIZE >> 9)) ||
 			    (req->u.rw.seg[i].last_sect <
 			     req->u.rw.seg[i].first_sect))
@@ -1406,8 +1633,11 @@ static int dispatch_rw_block_io(struct xen_blkif_ring *ring,
 	/* Wait on all outstanding I/O's and once that has been completed
 	 * issue the flush.
 	 */
-	if (drain)
+	if (drain) {
+		/* Writes still waiting for their data count as inflight. */
+		xen_blkbk_copy_flush(ring);
 		xen_blk_drain_io(pending_req->ring);
+	}
 
 	/*
 	 * If we have failed at this point, we need to undo the M2P override,
@@ -1415,7 +1645,10 @@ static int dispatch_rw_block_io(struct xen_blkif_ring *ring,
 	 * the hypercall to unmap the grants - that is all done in
 	 * xen_blkbk_unmap.
 	 */
-	if (xen_blkbk_map_seg(pending_req))
+	if (ring->blkif->vbd.grant_copy) {
+		if (xen_blkbk_copy_alloc(pending_req))
+			goto fail_response;
+	} else if (xen_blkbk_map_seg(pending_req))
 		goto fail_flush;
 
 	/*
@@ -1430,7 +1663,7 @@ static int dispatch_rw_block_io(struct xen_blkif_ring *ring,
 		       (bio_add_page(bio,
 				     pages[i]->page,
 				     seg[i].nsec << 9,
-				     seg[i].offset) == 0)) {
+				     seg[i].buf_offset) == 0)) {
 			bio = bio_alloc(preq.bdev, bio_max_segs(nseg - i),
 					operation | operation_flags,
 					GFP_KERNEL);
@@ -1455,13 +1688,20 @@ static int dispatch_rw_block_io(struct xen_blkif_ring *ring,
 	}
 
 	atomic_set(&pending_req->pendcnt, nbio);
-	blk_start_plug(&plug);
 
-	for (i = 0; i < nbio; i++)
-		submit_bio(biolist[i]);
+	if (ring->blkif->vbd.grant_copy && operation == REQ_OP_WRITE && nseg) {
+		/* Submitted once the data has been copied in. */
+		pending_req->nr_bios = nbio;
+		xen_blkbk_copy_queue_write(ring, pending_req);
+	} else {
+		blk_start_plug(&plug);
+
+		for (i = 0; i < nbio; i++)
+			submit_bio(biolist[i]);
 
-	/* Let the I/Os go.. */
-	blk_finish_plug(&plug);
+		/* Let the I/Os go.. */
+		blk_finish_plug(&plug);
+	}
 
 	if (operation == REQ_OP_READ)
 		ring->st_rd_sect += preq.nr_sects;
@@ -35,6 +35,7 @@
 #include <linux/wait.h>
 #include <linux/io.h>
 #include <linux/rbtree.h>
+#include <linux/llist.h>
 #include <asm/setup.h>
 #include <asm/hypervisor.h>
 #include <xen/grant_table.h>
@@ -231,6 +232,8 @@ struct xen_vbd {
 	/* Persistent grants feature negotiation result */
 	unsigned int		feature_gnt_persistent:1;
 	unsigned int		overflow_max_grants:1;
+	/* Connect-time cached grant_copy parameter value */
+	unsigned int		grant_copy:1;
 };
 
 struct backend_info;
@@ -238,6 +241,13 @@ struct backend_info;
 /* Number of requests that we can fit in a ring */
 #define XEN_BLKIF_REQS_PER_PAGE		32
 
+/*
+ * Maximum number of grant copy operations issued in a single hypercall
+ * when the backend copies data instead of mapping grants. Large enough
+ * to hold any single request.
+ */
+#define BLKBACK_COPY_BATCH		MAX_INDIRECT_SEGMENTS
+
 struct persistent_gnt {
 	struct page *page;
 	grant_ref_t gnt;
@@ -293,6 +303,17 @@ struct xen_blkif_ring {
 	/* Buffer of free pages to map grant refs. */
 	struct gnttab_page_cache free_pages;
 
+	/*
+	 * Grant copy mode: writes whose data is queued for copy-in and
+	 * reads waiting to have their data copied out to the frontend.
+	 */
+	struct gnttab_copy	*copy_ops;
+	unsigned int		copy_nr;
+	struct list_head	copy_wr_list;
+	struct gnttab_copy	*copy_out_ops;
+	struct llist_head	copy_rd_done;
+	struct work_struct	copy_rd_work;
+
 	struct work_struct	free_work;
 	/* Thread shutdown wait queue. */
 	wait_queue_head_t	shutdown_wq;
@@ -326,6 +347,8 @@ struct xen_blkif {
 struct seg_buf {
 	unsigned long offset;
 	unsigned int nsec;
+	/* Offset in the local page, differs from offset in grant copy mode */
+	unsigned int buf_offset;
 };
 
 struct grant_page {
@@ -349,6 +372,10 @@ struct pending_req {
 	unsigned short		operation;
 	int			status;
 	struct list_head	free_list;
+	/* Grant copy mode only. */
+	int			nr_bios;
+	struct list_head	copy_list;
+	struct llist_node	copy_node;
 	struct grant_page	*segments[MAX_INDIRECT_SEGMENTS];
 	/* Indirect descriptors */
 	struct grant_page	*indirect_pages[MAX_INDIRECT_PAGES];
@@ -393,5 +420,6 @@ int xen_blkbk_barrier(struct xenbus_transaction xbt,
 		      struct backend_info *be, int state);
 struct xenbus_device *xen_blkbk_xenbus(struct backend_info *be);
 void xen_blkbk_unmap_purged_grants(struct work_struct *work);
+void xen_blkbk_copy_rd_work(struct work_struct *work);
 
 #endif /* __XEN_BLKIF__BACKEND__COMMON_H__ */
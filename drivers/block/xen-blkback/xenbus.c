@@ -146,6 +146,18 @@ static int xen_blkif_alloc_rings(struct xen_blkif *blkif)
 		INIT_WORK(&ring->persistent_purge_work, xen_blkbk_unmap_purged_grants);
 		gnttab_page_cache_init(&ring->free_pages);
 
+		if (blkif->vbd.grant_copy) {
+			ring->copy_ops = kcalloc(2 * BLKBACK_COPY_BATCH,
+						 sizeof(struct gnttab_copy),
+						 GFP_KERNEL);
+			if (!ring->copy_ops)
+				goto fail;
+			ring->copy_out_ops = ring->copy_ops + BLKBACK_COPY_BATCH;
+		}
+		INIT_LIST_HEAD(&ring->copy_wr_list);
+		init_llist_head(&ring->copy_rd_done);
+		INIT_WORK(&ring->copy_rd_work, xen_blkbk_copy_rd_work);
+
 		spin_lock_init(&ring->pending_free_lock);
 		init_waitqueue_head(&ring->pending_free_wq);
 		init_waitqueue_head(&ring->shutdown_wq);
@@ -155,6 +167,13 @@ static int xen_blkif_alloc_rings(struct xen_blkif *blkif)
 	}
 
 	return 0;
+
+fail:
+	while (r--)
+		kfree(blkif->rings[r].copy_ops);
+	kfree(blkif->rings);
+	blkif->rings = NULL;
+	return -ENOMEM;
 }
 
 /* Enable the persistent grants feature. */
@@ -162,6 +181,15 @@ static bool feature_persistent = true;
 module_param(feature_persistent, bool, 0644);
 MODULE_PARM_DESC(feature_persistent, "Enables the persistent grants feature");
 
+/*
+ * Copy request data with batched grant copy hypercalls instead of mapping
+ * and unmapping the frontend's grants. This avoids the map/unmap and TLB
+ * flush cost for frontends that do not use persistent grants.
+ */
+static bool grant_copy;
+module_param(grant_copy, bool, 0644);
+MODULE_PARM_DESC(grant_copy, "Copy data using grant copy instead of mapping grants");
+
 static struct xen_blkif *xen_blkif_alloc(domid_t domid)
 {
 	struct xen_blkif *blkif;
@@ -292,6 +320,9 @@ static int xen_blkif_disconnect(struct xen_blkif *blkif)
 			continue;
 		}
 
+		/* The last read completion may still be dropping its refs. */
+		flush_work(&ring->copy_rd_work);
+
 		if (ring->irq) {
 			unbind_from_irqhandler(ring->irq, ring);
 			ring->irq = 0;
@@ -335,6 +366,8 @@ static int xen_blkif_disconnect(struct xen_blkif *blkif)
 	 * blkif->rings was allocated in connect_ring, so we should free it in
 	 * here.
 	 */
+	for (r = 0; r < blkif->nr_rings; r++)
+		kfree(blkif->rings[r].copy_ops);
 	kfree(blkif->rings);
 	blkif->rings = NULL;
 	blkif->nr_rings = 0;
@@ -1089,6 +1122,13 @@ static int connect_ring(struct backend_info *be)
 		blkif->vbd.feature_gnt_persistent_parm &&
 		xenbus_read_unsigned(dev->otherend, "feature-persistent", 0);
 
+	/*
+	 * Persistent grants already avoid the per-request map/unmap cost, so
+	 * only fall back to copying when they were not negotiated.
+	 */
+	blkif->vbd.grant_copy = grant_copy &&
+		!blkif->vbd.feature_gnt_persistent;
+
 	blkif->vbd.overflow_max_grants = 0;
 
 	/*
@@ -1111,7 +1151,8 @@ static int connect_ring(struct backend_info *be)
 
 	pr_info("%s: using %d queues, protocol %d (%s) %s\n", dev->nodename,
 		 blkif->nr_rings, blkif->blk_protocol, protocol,
-		 blkif->vbd.feature_gnt_persistent ? "persistent grants" : "");
+		 blkif->vbd.feature_gnt_persistent ? "persistent grants" :
+		 blkif->vbd.grant_copy ? "grant copy" : "");
 
 	err = xenbus_scanf(XBT_NIL, dev->otherend, "ring-page-order", "%u",
 			   &ring_page_order);
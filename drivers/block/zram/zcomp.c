@@ -12,6 +12,7 @@
 #include <linux/cpu.h>
 #include <linux/crypto.h>
 #include <linux/vmalloc.h>
+#include <crypto/acompress.h>
 
 #include "zcomp.h"
 
@@ -34,8 +35,106 @@ static const char * const backends[] = {
 #endif
 };
 
+#ifdef CONFIG_ZRAM_ASYNC_COMP
+static void zcomp_strm_free_async(struct zcomp_strm *zstrm)
+{
+	unsigned int i;
+
+	if (zstrm->reqs) {
+		for (i = 0; i < ZCOMP_ASYNC_DEPTH; i++) {
+			if (zstrm->reqs[i].req)
+				acomp_request_free(zstrm->reqs[i].req);
+			kfree(zstrm->reqs[i].buffer);
+		}
+		kfree(zstrm->reqs);
+	}
+	if (!IS_ERR_OR_NULL(zstrm->atfm))
+		crypto_free_acomp(zstrm->atfm);
+	zstrm->reqs = NULL;
+	zstrm->atfm = NULL;
+	INIT_LIST_HEAD(&zstrm->free_reqs);
+}
+
+static void zcomp_req_work(struct work_struct *work)
+{
+	struct zcomp_req *zreq = container_of(work, struct zcomp_req, work);
+
+	zreq->done(zreq, zreq->err);
+}
+
+/* May be called from (soft)irq context, defer to process context */
+static void zcomp_acomp_done(void *data, int err)
+{
+	struct zcomp_req *zreq = data;
+
+	/* Backlogged request has been queued, it is still in flight */
+	if (err == -EINPROGRESS)
+		return;
+
+	zreq->err = err;
+	zreq->dst_len = zreq->req->dlen;
+	queue_work(zreq->comp->wq, &zreq->work);
+}
+
+static int zcomp_strm_init_async(struct zcomp_strm *zstrm,
+				 struct zcomp *comp, int node)
+{
+	unsigned int i;
+
+	spin_lock_init(&zstrm->req_lock);
+	INIT_LIST_HEAD(&zstrm->free_reqs);
+	zstrm->nr_inflight = 0;
+	if (!comp->async)
+		return 0;
+
+	zstrm->atfm = crypto_alloc_acomp_node(comp->name, 0, 0, node);
+	if (IS_ERR(zstrm->atfm))
+		return PTR_ERR(zstrm->atfm);
+
+	zstrm->reqs = kcalloc_node(ZCOMP_ASYNC_DEPTH, sizeof(*zstrm->reqs),
+				   GFP_KERNEL, node);
+	if (!zstrm->reqs)
+		return -ENOMEM;
+
+	for (i = 0; i < ZCOMP_ASYNC_DEPTH; i++) {
+		struct zcomp_req *zreq = &zstrm->reqs[i];
+
+		zreq->req = acomp_request_alloc(zstrm->atfm);
+		/* Must be linearly mapped for the dst scatterlist */
+		zreq->buffer = kmalloc_node(2 * PAGE_SIZE, GFP_KERNEL, node);
+		if (!zreq->req || !zreq->buffer)
+			return -ENOMEM;
+
+		zreq->comp = comp;
+		zreq->zstrm = zstrm;
+		INIT_WORK(&zreq->work, zcomp_req_work);
+		sg_init_table(&zreq->src, 1);
+		sg_init_one(&zreq->dst, zreq->buffer, 2 * PAGE_SIZE);
+		acomp_request_set_callback(zreq->req,
+					   CRYPTO_TFM_REQ_MAY_BACKLOG,
+					   zcomp_acomp_done, zreq);
+		list_add_tail(&zreq->entry, &zstrm->free_reqs);
+	}
+	return 0;
+}
+
+static bool zcomp_strm_busy(struct zcomp_strm *zstrm)
+{
+	return READ_ONCE(zstrm->nr_inflight);
+}
+#else
+static void zcomp_strm_free_async(struct zcomp_strm *zstrm) {}
+
+static int zcomp_strm_init_async(struct zcomp_strm *zstrm,
+				 struct zcomp *comp, int node)
+{
+	return 0;
+}
+#endif
+
 static void zcomp_strm_free(struct zcomp_strm *zstrm)
 {
+	zcomp_strm_free_async(zstrm);
 	if (!IS_ERR_OR_NULL(zstrm->tfm))
 		crypto_free_comp(zstrm->tfm);
 	vfree(zstrm->buffer);
@@ -45,21 +144,30 @@ static void zcomp_strm_free(struct zcomp_strm *zstrm)
 
 /*
  * Initialize zcomp_strm structure with ->tfm initialized by backend, and
- * ->buffer. Return a negative value on error.
+ * ->buffer. For asynchronous zcomp also allocate the pool of in-flight
+ * requests. Return a negative value on error.
  */
-static int zcomp_strm_init(struct zcomp_strm *zstrm, struct zcomp *comp)
+static int zcomp_strm_init(struct zcomp_strm *zstrm, struct zcomp *comp,
+			   int node)
 {
+	int ret;
+
 	zstrm->tfm = crypto_alloc_comp(comp->name, 0, 0);
 	/*
-	 * allocate 2 pages. 1 for compressed data, plus 1 extra for the
-	 * case when compressed size is larger than the original one
+	 * allocate 2 pages per batch slot. 1 for compressed data, plus 1
+	 * extra for the case when compressed size is larger than the
+	 * original one
 	 */
-	zstrm->buffer = vzalloc(2 * PAGE_SIZE);
+	zstrm->buffer = vzalloc(ZCOMP_BATCH_SIZE * 2 * PAGE_SIZE);
 	if (IS_ERR_OR_NULL(zstrm->tfm) || !zstrm->buffer) {
 		zcomp_strm_free(zstrm);
 		return -ENOMEM;
 	}
-	return 0;
+
+	ret = zcomp_strm_init_async(zstrm, comp, node);
+	if (ret)
+		zcomp_strm_free(zstrm);
+	return ret;
 }
 
 bool zcomp_available_algorithm(const char *comp)
@@ -139,6 +247,117 @@ int zcomp_compress(struct zcomp_strm *zstrm,
 			zstrm->buffer, dst_len);
 }
 
+#ifdef CONFIG_ZRAM_ASYNC_COMP
+static struct zcomp_req *zcomp_req_tryget(struct zcomp *comp)
+{
+	struct zcomp_strm *zstrm;
+	struct zcomp_req *zreq;
+
+	/* Keeps the CPU, and hence its stream, from going away */
+	local_lock(&comp->stream->lock);
+	zstrm = this_cpu_ptr(comp->stream);
+	spin_lock(&zstrm->req_lock);
+	zreq = list_first_entry_or_null(&zstrm->free_reqs,
+					struct zcomp_req, entry);
+	if (zreq) {
+		list_del(&zreq->entry);
+		zstrm->nr_inflight++;
+	}
+	spin_unlock(&zstrm->req_lock);
+	local_unlock(&comp->stream->lock);
+
+	return zreq;
+}
+
+/*
+ * Get an idle request from the local CPU's pool, sleeping until one of
+ * the in-flight requests completes if the pool is exhausted. The wait
+ * condition must not take the stream locks, so it only watches
+ * ->req_puts and the pool is retried with the locks held afterwards.
+ */
+struct zcomp_req *zcomp_req_get(struct zcomp *comp)
+{
+	struct zcomp_req *zreq;
+	int puts;
+
+	for (;;) {
+		puts = atomic_read_acquire(&comp->req_puts);
+		zreq = zcomp_req_tryget(comp);
+		if (zreq)
+			return zreq;
+		wait_event(comp->req_wait,
+			   atomic_read(&comp->req_puts) != puts);
+	}
+}
+
+void zcomp_req_put(struct zcomp_req *zreq)
+{
+	struct zcomp_strm *zstrm = zreq->zstrm;
+	struct zcomp *comp = zreq->comp;
+
+	spin_lock(&zstrm->req_lock);
+	list_add(&zreq->entry, &zstrm->free_reqs);
+	zstrm->nr_inflight--;
+	spin_unlock(&zstrm->req_lock);
+	atomic_inc(&comp->req_puts);
+
+	wake_up(&comp->req_wait);
+}
+
+/*
+ * Start compression of zreq->page. zreq->done() is called with the result
+ * from process context once the backend is done with it: either directly
+ * (synchronous backends) or from comp->wq. zreq->buffer and zreq->dst_len
+ * hold the compressed data on success.
+ */
+void zcomp_compress_async(struct zcomp_req *zreq)
+{
+	int ret;
+
+	sg_set_page(&zreq->src, zreq->page, PAGE_SIZE, 0);
+	/* See zcomp_compress() on why dst is `2 * PAGE_SIZE' */
+	acomp_request_set_params(zreq->req, &zreq->src, &zreq->dst,
+				 PAGE_SIZE, 2 * PAGE_SIZE);
+
+	ret = crypto_acomp_compress(zreq->req);
+	if (ret == -EINPROGRESS || ret == -EBUSY)
+		return;
+
+	zreq->err = ret;
+	zreq->dst_len = zreq->req->dlen;
+	zreq->done(zreq, ret);
+}
+#endif
+
+/*
+ * Compress @nr (at most ZCOMP_BATCH_SIZE) pages in one go. The compressed
+ * data of @src[i] lands in zcomp_strm_buffer(zstrm, i) and its length in
+ * @dst_len[i]. The whole batch is done under a single stream acquisition,
+ * which is where multi-buffer (SIMD or offload) backends would plug in;
+ * the crypto_comp API is single-buffer, so for now we just iterate.
+ */
+int zcomp_compress_batch(struct zcomp_strm *zstrm,
+		const void * const *src, unsigned int *dst_len,
+		unsigned int nr)
+{
+	unsigned int i;
+	int ret;
+
+	if (WARN_ON_ONCE(nr > ZCOMP_BATCH_SIZE))
+		return -EINVAL;
+
+	for (i = 0; i < nr; i++) {
+		/* See zcomp_compress() on why dst is `2 * PAGE_SIZE' */
+		dst_len[i] = PAGE_SIZE * 2;
+		ret = crypto_comp_compress(zstrm->tfm, src[i], PAGE_SIZE,
+					   zcomp_strm_buffer(zstrm, i),
+					   &dst_len[i]);
+		if (ret)
+			return ret;
+	}
+	return 0;
+}
+
 int zcomp_decompress(struct zcomp_strm *zstrm,
 		const void *src, unsigned int src_len, void *dst)
 {
@@ -158,7 +377,7 @@ int zcomp_cpu_up_prepare(unsigned int cpu, struct hlist_node *node)
 	zstrm = per_cpu_ptr(comp->stream, cpu);
 	local_lock_init(&zstrm->lock);
 
-	ret = zcomp_strm_init(zstrm, comp);
+	ret = zcomp_strm_init(zstrm, comp, cpu_to_node(cpu));
 	if (ret)
 		pr_err("Can't allocate a compression stream\n");
 	return ret;
@@ -170,10 +389,42 @@ int zcomp_cpu_dead(unsigned int cpu, struct hlist_node *node)
 	struct zcomp_strm *zstrm;
 
 	zstrm = per_cpu_ptr(comp->stream, cpu);
+#ifdef CONFIG_ZRAM_ASYNC_COMP
+	/* In-flight requests still reference the stream */
+	wait_event(comp->req_wait, !zcomp_strm_busy(zstrm));
+#endif
 	zcomp_strm_free(zstrm);
 	return 0;
 }
 
+#ifdef CONFIG_ZRAM_ASYNC_COMP
+static int zcomp_init_async(struct zcomp *comp)
+{
+	init_waitqueue_head(&comp->req_wait);
+	atomic_set(&comp->req_puts, 0);
+	if (!comp->async)
+		return 0;
+
+	/* zram may be a swap device, completions must make progress */
+	comp->wq = alloc_workqueue("zcomp_%s", WQ_MEM_RECLAIM | WQ_HIGHPRI, 0,
+				   comp->name);
+	return comp->wq ? 0 : -ENOMEM;
+}
+
+static void zcomp_destroy_async(struct zcomp *comp)
+{
+	if (comp->wq)
+		destroy_workqueue(comp->wq);
+}
+#else
+static int zcomp_init_async(struct zcomp *comp)
+{
+	return 0;
+}
+
+static void zcomp_destroy_async(struct zcomp *comp) {}
+#endif
+
 static int zcomp_init(struct zcomp *comp)
 {
 	int ret;
@@ -182,11 +433,17 @@ static int zcomp_init(struct zcomp *comp)
 	if (!comp->stream)
 		return -ENOMEM;
 
+	ret = zcomp_init_async(comp);
+	if (ret)
+		goto cleanup;
+
 	ret = cpuhp_state_add_instance(CPUHP_ZCOMP_PREPARE, &comp->node);
 	if (ret < 0)
-		goto cleanup;
+		goto cleanup_async;
 	return 0;
 
+cleanup_async:
+	zcomp_destroy_async(comp);
 cleanup:
 	free_percpu(comp->stream);
 	return ret;
@@ -195,6 +452,7 @@ static int zcomp_init(struct zcomp *comp)
 void zcomp_destroy(struct zcomp *comp)
 {
 	cpuhp_state_remove_instance(CPUHP_ZCOMP_PREPARE, &comp->node);
+	zcomp_destroy_async(comp);
 	free_percpu(comp->stream);
 	kfree(comp);
 }
@@ -205,9 +463,11 @@ void zcomp_destroy(struct zcomp *comp)
  * backend pointer or ERR_PTR if things went bad. ERR_PTR(-EINVAL)
  * if requested algorithm is not supported, ERR_PTR(-ENOMEM) in
  * case of allocation error, or any other error potentially
- * returned by zcomp_init().
+ * returned by zcomp_init(). @async requests an asynchronous zcomp,
+ * see zcomp_compress_async(); it is ignored without
+ * CONFIG_ZRAM_ASYNC_COMP.
  */
-struct zcomp *zcomp_create(const char *alg)
+struct zcomp *zcomp_create(const char *alg, bool async)
 {
 	struct zcomp *comp;
 	int error;
@@ -225,6 +485,9 @@ struct zcomp *zcomp_create(const char *alg)
 		return ERR_PTR(-ENOMEM);
 
 	comp->name = alg;
+#ifdef CONFIG_ZRAM_ASYNC_COMP
+	comp->async = async;
+#endif
 	error = zcomp_init(comp);
 	if (error) {
 		kfree(comp);
@@ -6,13 +6,60 @@
 #ifndef _ZCOMP_H_
 #define _ZCOMP_H_
 #include <linux/local_lock.h>
+#include <linux/scatterlist.h>
+#include <linux/workqueue.h>
+
+#ifdef CONFIG_ZRAM_BATCH_WRITE
+#define ZCOMP_BATCH_SIZE	8
+#else
+#define ZCOMP_BATCH_SIZE	1
+#endif
+
+#ifdef CONFIG_ZRAM_ASYNC_COMP
+#define ZCOMP_ASYNC_DEPTH	CONFIG_ZRAM_ASYNC_COMP_DEPTH
+#endif
+
+struct zcomp_req;
+typedef void (*zcomp_done_t)(struct zcomp_req *zreq, int err);
+
+/* in-flight asynchronous compression of one page */
+struct zcomp_req {
+	struct acomp_req *req;
+	struct zcomp *comp;
+	struct zcomp_strm *zstrm;	/* stream the request belongs to */
+	struct list_head entry;		/* zstrm->free_reqs */
+	struct scatterlist src;
+	struct scatterlist dst;
+	/* `2 * PAGE_SIZE' long, see zcomp_compress() */
+	void *buffer;
+	unsigned int dst_len;
+	int err;
+	struct work_struct work;
+	/* set by zcomp users */
+	zcomp_done_t done;
+	struct page *page;
+	void *private;
+	u32 index;
+	u32 checksum;
+};
 
 struct zcomp_strm {
 	/* The members ->buffer and ->tfm are protected by ->lock. */
 	local_lock_t lock;
-	/* compression/decompression buffer */
+	/*
+	 * compression/decompression buffer, ZCOMP_BATCH_SIZE slots of
+	 * `2 * PAGE_SIZE' each (see zcomp_strm_buffer())
+	 */
 	void *buffer;
 	struct crypto_comp *tfm;
+#ifdef CONFIG_ZRAM_ASYNC_COMP
+	struct crypto_acomp *atfm;
+	struct zcomp_req *reqs;
+	/* idle ->reqs, protected by ->req_lock */
+	struct list_head free_reqs;
+	unsigned int nr_inflight;
+	spinlock_t req_lock;
+#endif
 };
 
 /* dynamic per-device compression frontend */
@@ -20,6 +67,15 @@ struct zcomp {
 	struct zcomp_strm __percpu *stream;
 	const char *name;
 	struct hlist_node node;
+#ifdef CONFIG_ZRAM_ASYNC_COMP
+	bool async;
+	/* completions are finished in process context */
+	struct workqueue_struct *wq;
+	/* waiters for an idle request or for in-flight requests to drain */
+	wait_queue_head_t req_wait;
+	/* bumped on every zcomp_req_put(), see zcomp_req_get() */
+	atomic_t req_puts;
+#endif
 };
 
 int zcomp_cpu_up_prepare(unsigned int cpu, struct hlist_node *node);
@@ -27,7 +83,7 @@ int zcomp_cpu_dead(unsigned int cpu, struct hlist_node *node);
 ssize_t zcomp_available_show(const char *comp, char *buf);
 bool zcomp_available_algorithm(const char *comp);
 
-struct zcomp *zcomp_create(const char *alg);
+struct zcomp *zcomp_create(const char *alg, bool async);
 void zcomp_destroy(struct zcomp *comp);
 
 struct zcomp_strm *zcomp_stream_get(struct zcomp *comp);
@@ -36,6 +92,40 @@ void zcomp_stream_put(struct zcomp *comp);
 int zcomp_compress(struct zcomp_strm *zstrm,
 		const void *src, unsigned int *dst_len);
 
+int zcomp_compress_batch(struct zcomp_strm *zstrm,
+		const void * const *src, unsigned int *dst_len,
+		unsigned int nr);
+
+static inline void *zcomp_strm_buffer(struct zcomp_strm *zstrm,
+				      unsigned int slot)
+{
+	return zstrm->buffer + slot * 2 * PAGE_SIZE;
+}
+
+#ifdef CONFIG_ZRAM_ASYNC_COMP
+static inline bool zcomp_is_async(struct zcomp *comp)
+{
+	return comp->async;
+}
+
+struct zcomp_req *zcomp_req_get(struct zcomp *comp);
+void zcomp_req_put(struct zcomp_req *zreq);
+void zcomp_compress_async(struct zcomp_req *zreq);
+#else
+static inline bool zcomp_is_async(struct zcomp *comp)
+{
+	return false;
+}
+
+static inline struct zcomp_req *zcomp_req_get(struct zcomp *comp)
+{
+	return NULL;
+}
+
+static inline void zcomp_req_put(struct zcomp_req *zreq) {}
+static inline void zcomp_compress_async(struct zcomp_req *zreq) {}
+#endif
+
 int zcomp_decompress(struct zcomp_strm *zstrm,
 		const void *src, unsigned int src_len, void *dst);
 
@@ -0,0 +1,250 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Content based deduplication of zram objects.
+ *
+ * Every compressed object stored while deduplication is enabled gets an
+ * entry in a hash of rb-trees, keyed by the xxhash of the uncompressed
+ * page. A page being written is first looked up there, and if an object
+ * with identical content exists the slot just takes a reference on it,
+ * skipping compression and allocation altogether.
+ */
+
+#define KMSG_COMPONENT "zram"
+#define pr_fmt(fmt) KMSG_COMPONENT ": " fmt
+
+#include <linux/highmem.h>
+#include <linux/rbtree.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/vmalloc.h>
+#include <linux/xxhash.h>
+
+#include "zram_drv.h"
+
+/* One hash bucket per this many pages of disksize */
+#define ZRAM_DEDUP_BUCKET_SHIFT	7
+
+struct zram_hash {
+	spinlock_t lock;
+	struct rb_root root;
+};
+
+struct zram_dedup_entry {
+	struct rb_node rb_node;
+	u32 checksum;
+	unsigned int len;
+	/* number of slots referencing the object, protected by hash lock */
+	unsigned long refcount;
+	unsigned long handle;
+};
+
+static struct zram_hash *zram_dedup_hash(struct zram *zram, u32 checksum)
+{
+	return &zram->hash[checksum & (zram->hash_size - 1)];
+}
+
+u32 zram_dedup_checksum(struct page *page)
+{
+	void *mem;
+	u32 checksum;
+
+	mem = kmap_local_page(page);
+	checksum = xxh32(mem, PAGE_SIZE, 0);
+	kunmap_local(mem);
+
+	return checksum;
+}
+
+unsigned long zram_dedup_handle(struct zram_dedup_entry *entry)
+{
+	return entry->handle;
+}
+
+unsigned int zram_dedup_len(struct zram_dedup_entry *entry)
+{
+	return entry->len;
+}
+
+/*
+ * Checksums may collide, so compare the actual content. Must be called
+ * with the compression stream held, its buffer receives the decompressed
+ * object.
+ */
+static bool zram_dedup_match(struct zram *zram, struct zcomp_strm *zstrm,
+			     struct zram_dedup_entry *entry, struct page *page)
+{
+	void *src, *cmp, *mem;
+	bool match;
+	int ret = 0;
+
+	src = zs_map_object(zram->mem_pool, entry->handle, ZS_MM_RO);
+	cmp = src;
+	if (entry->len != PAGE_SIZE) {
+		cmp = zstrm->buffer;
+		ret = zcomp_decompress(zstrm, src, entry->len, cmp);
+	}
+
+	mem = kmap_local_page(page);
+	match = !ret && !memcmp(mem, cmp, PAGE_SIZE);
+	kunmap_local(mem);
+	zs_unmap_object(zram->mem_pool, entry->handle);
+
+	return match;
+}
+
+/*
+ * Look up an object with the same content as @page. On success a
+ * reference on the returned entry is held on behalf of the caller's slot.
+ */
+struct zram_dedup_entry *zram_dedup_find(struct zram *zram, struct page *page,
+					 u32 checksum)
+{
+	struct zram_hash *hash = zram_dedup_hash(zram, checksum);
+	struct zram_dedup_entry *entry, *found = NULL;
+	struct zcomp_strm *zstrm;
+	struct rb_node *rb;
+
+	zstrm = zcomp_stream_get(zram->comps[ZRAM_PRIMARY_COMP]);
+	spin_lock(&hash->lock);
+	rb = hash->root.rb_node;
+	while (rb) {
+		entry = rb_entry(rb, struct zram_dedup_entry, rb_node);
+		if (checksum == entry->checksum) {
+			/*
+			 * Collision: keep looking to the right, where equal
+			 * checksums are inserted. Missing a duplicate left of
+			 * us after rebalancing only costs a lost opportunity.
+			 */
+			if (zram_dedup_match(zram, zstrm, entry, page)) {
+				found = entry;
+				break;
+			}
+			rb = rb->rb_right;
+		} else if (checksum < entry->checksum) {
+			rb = rb->rb_left;
+		} else {
+			rb = rb->rb_right;
+		}
+	}
+
+	if (found) {
+		found->refcount++;
+		atomic64_add(found->len, &zram->stats.dup_data_size);
+	}
+	spin_unlock(&hash->lock);
+	zcomp_stream_put(zram->comps[ZRAM_PRIMARY_COMP]);
+
+	return found;
+}
+
+/*
+ * Make the freshly stored object @handle available for deduplication.
+ * Returns NULL if no memory is available for the entry, in which case
+ * the caller stores @handle in the slot as usual.
+ */
+struct zram_dedup_entry *zram_dedup_insert(struct zram *zram,
+					   unsigned long handle,
+					   unsigned int len, u32 checksum)
+{
+	struct zram_hash *hash = zram_dedup_hash(zram, checksum);
+	struct rb_node **rb, *parent = NULL;
+	struct zram_dedup_entry *entry;
+
+	entry = kmalloc(sizeof(*entry), GFP_NOIO | __GFP_NOWARN);
+	if (!entry)
+		return NULL;
+
+	entry->checksum = checksum;
+	entry->len = len;
+	entry->refcount = 1;
+	entry->handle = handle;
+
+	spin_lock(&hash->lock);
+	rb = &hash->root.rb_node;
+	while (*rb) {
+		struct zram_dedup_entry *cur;
+
+		parent = *rb;
+		cur = rb_entry(parent, struct zram_dedup_entry, rb_node);
+		if (checksum < cur->checksum)
+			rb = &parent->rb_left;
+		else
+			rb = &parent->rb_right;
+	}
+	rb_link_node(&entry->rb_node, parent, rb);
+	rb_insert_color(&entry->rb_node, &hash->root);
+	spin_unlock(&hash->lock);
+
+	atomic64_add(sizeof(*entry), &zram->stats.meta_data_size);
+	return entry;
+}
+
+/*
+ * Drop a slot's reference. The object is freed together with the last
+ * reference. Called with the slot lock held.
+ */
+void zram_dedup_put(struct zram *zram, struct zram_dedup_entry *entry)
+{
+	struct zram_hash *hash = zram_dedup_hash(zram, entry->checksum);
+
+	spin_lock(&hash->lock);
+	if (--entry->refcount) {
+		spin_unlock(&hash->lock);
+		atomic64_sub(entry->len, &zram->stats.dup_data_size);
+		return;
+	}
+	rb_erase(&entry->rb_node, &hash->root);
+	spin_unlock(&hash->lock);
+
+	zs_free(zram->mem_pool, entry->handle);
+	atomic64_sub(entry->len, &zram->stats.compr_data_size);
+	atomic64_sub(sizeof(*entry), &zram->stats.meta_data_size);
+	kfree(entry);
+}
+
+/*
+ * Whether slots other than the caller's reference the object. The answer
+ * may go stale as soon as the hash lock is dropped, a new reference only
+ * keeps the object alive past the caller's zram_dedup_put().
+ */
+bool zram_dedup_shared(struct zram *zram, struct zram_dedup_entry *entry)
+{
+	struct zram_hash *hash = zram_dedup_hash(zram, entry->checksum);
+	bool shared;
+
+	spin_lock(&hash->lock);
+	shared = entry->refcount > 1;
+	spin_unlock(&hash->lock);
+
+	return shared;
+}
+
+int zram_dedup_init(struct zram *zram, size_t num_pages)
+{
+	size_t i;
+
+	if (!zram_dedup_enabled(zram))
+		return 0;
+
+	zram->hash_size = roundup_pow_of_two(max_t(size_t, 1,
+				num_pages >> ZRAM_DEDUP_BUCKET_SHIFT));
+	zram->hash = vzalloc(array_size(zram->hash_size, sizeof(*zram->hash)));
+	if (!zram->hash) {
+		pr_err("Error allocating zram entry hash\n");
+		return -ENOMEM;
+	}
+
+	for (i = 0; i < zram->hash_size; i++) {
+		spin_lock_init(&zram->hash[i].lock);
+		zram->hash[i].root = RB_ROOT;
+	}
+	return 0;
+}
+
+/* All slots must have been freed already */
+void zram_dedup_fini(struct zram *zram)
+{
+	vfree(zram->hash);
+	zram->hash = NULL;
+	zram->hash_size = 0;
+}
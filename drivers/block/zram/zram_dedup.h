@@ -0,0 +1,77 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Content based deduplication of zram objects.
+ */
+
+#ifndef _ZRAM_DEDUP_H_
+#define _ZRAM_DEDUP_H_
+
+#include <linux/types.h>
+
+struct page;
+struct zram;
+struct zram_dedup_entry;
+
+#ifdef CONFIG_ZRAM_DEDUP
+u32 zram_dedup_checksum(struct page *page);
+struct zram_dedup_entry *zram_dedup_find(struct zram *zram, struct page *page,
+					 u32 checksum);
+struct zram_dedup_entry *zram_dedup_insert(struct zram *zram,
+					   unsigned long handle,
+					   unsigned int len, u32 checksum);
+void zram_dedup_put(struct zram *zram, struct zram_dedup_entry *entry);
+bool zram_dedup_shared(struct zram *zram, struct zram_dedup_entry *entry);
+unsigned long zram_dedup_handle(struct zram_dedup_entry *entry);
+unsigned int zram_dedup_len(struct zram_dedup_entry *entry);
+
+int zram_dedup_init(struct zram *zram, size_t num_pages);
+void zram_dedup_fini(struct zram *zram);
+#else
+static inline u32 zram_dedup_checksum(struct page *page)
+{
+	return 0;
+}
+
+static inline struct zram_dedup_entry *zram_dedup_find(struct zram *zram,
+						       struct page *page,
+						       u32 checksum)
+{
+	return NULL;
+}
+
+static inline struct zram_dedup_entry *zram_dedup_insert(struct zram *zram,
+							 unsigned long handle,
+							 unsigned int len,
+							 u32 checksum)
+{
+	return NULL;
+}
+
+static inline void zram_dedup_put(struct zram *zram,
+				  struct zram_dedup_entry *entry) {}
+
+static inline bool zram_dedup_shared(struct zram *zram,
+				     struct zram_dedup_entry *entry)
+{
+	return false;
+}
+
+static inline unsigned long zram_dedup_handle(struct zram_dedup_entry *entry)
+{
+	return 0;
+}
+
+static inline unsigned int zram_dedup_len(struct zram_dedup_entry *entry)
+{
+	return 0;
+}
+
+static inline int zram_dedup_init(struct zram *zram, size_t num_pages)
+{
+	return 0;
+}
+
+static inline void zram_dedup_fini(struct zram *zram) {}
+#endif
+
+#endif /* _ZRAM_DEDUP_H_ */
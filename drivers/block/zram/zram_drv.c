@@ -69,6 +69,8 @@ static void zram_slot_lock(struct zram *zram, u32 index)
 
 static void zram_slot_unlock(struct zram *zram, u32 index)
 {
+	/* Tell lockless readers the slot may have changed */
+	zram->table[index].flags += ZRAM_SEQ_INC;
 	bit_spin_unlock(ZRAM_LOCK, &zram->table[index].flags);
 }
 
@@ -82,11 +84,6 @@ static inline struct zram *dev_to_zram(struct device *dev)
 	return (struct zram *)dev_to_disk(dev)->private_data;
 }
 
-static unsigned long zram_get_handle(struct zram *zram, u32 index)
-{
-	return zram->table[index].handle;
-}
-
 static void zram_set_handle(struct zram *zram, u32 index, unsigned long handle)
 {
 	zram->table[index].handle = handle;
@@ -111,6 +108,13 @@ static void zram_clear_flag(struct zram *zram, u32 index,
 	zram->table[index].flags &= ~BIT(flag);
 }
 
+static unsigned long zram_get_handle(struct zram *zram, u32 index)
+{
+	if (zram_test_flag(zram, index, ZRAM_DEDUP))
+		return zram_dedup_handle((void *)zram->table[index].element);
+	return zram->table[index].handle;
+}
+
 static inline void zram_set_element(struct zram *zram, u32 index,
 			unsigned long element)
 {
@@ -178,8 +182,29 @@ static void zram_accessed(struct zram *zram, u32 index)
 {
 	zram_clear_flag(zram, index, ZRAM_IDLE);
 #ifdef CONFIG_ZRAM_TRACK_ENTRY_ACTIME
-	zram->table[index].ac_time = ktime_get_boottime();
+	zram->ac_time[index] = ktime_get_boottime();
+#endif
+}
+
+/*
+ * Update the access state after a read. Readers of different slots should
+ * not write to shared cache lines, so the slot is only locked when it is
+ * marked idle or its access time is more than a second old.
+ */
+static void zram_read_accessed(struct zram *zram, u32 index)
+{
+	bool stale = false;
+
+#ifdef CONFIG_ZRAM_TRACK_ENTRY_ACTIME
+	stale = ktime_get_boottime() - READ_ONCE(zram->ac_time[index]) >=
+		NSEC_PER_SEC;
 #endif
+	if (!stale && !(READ_ONCE(zram->table[index].flags) & BIT(ZRAM_IDLE)))
+		return;
+
+	zram_slot_lock(zram, index);
+	zram_accessed(zram, index);
+	zram_slot_unlock(zram, index);
 }
 
 static inline void update_used_max(struct zram *zram,
@@ -303,7 +328,7 @@ static void mark_idle(struct zram *zram, ktime_t cutoff)
 				!zram_test_flag(zram, index, ZRAM_UNDER_WB)) {
 #ifdef CONFIG_ZRAM_TRACK_ENTRY_ACTIME
 			is_idle = !cutoff || ktime_after(cutoff,
-							 zram->table[index].ac_time);
+							 zram->ac_time[index]);
 #endif
 			if (is_idle)
 				zram_set_flag(zram, index, ZRAM_IDLE);
@@ -586,18 +611,257 @@ static void read_from_bdev_async(struct zram *zram, struct page *page,
 #define IDLE_WRITEBACK			(1<<1)
 #define INCOMPRESSIBLE_WRITEBACK	(1<<2)
 
+/*
+ * Writeback is done in batches of up to ZRAM_WB_BATCH slots: the slots are
+ * decompressed into private pages, then written out with as few bios as
+ * the allocated backing device blocks allow, all in flight at once.
+ */
+#define ZRAM_WB_BATCH		32
+
+struct zram_wb_ctl {
+	struct page *pages[ZRAM_WB_BATCH];
+	u32 indices[ZRAM_WB_BATCH];
+	unsigned long blk_idx[ZRAM_WB_BATCH];
+	int err[ZRAM_WB_BATCH];
+	unsigned int nr;
+	unsigned int max;
+	atomic_t pending;
+	struct completion done;
+};
+
+static void zram_wb_ctl_free(struct zram_wb_ctl *ctl)
+{
+	unsigned int i;
+
+	for (i = 0; i < ctl->max; i++)
+		__free_page(ctl->pages[i]);
+	kfree(ctl);
+}
+
+static struct zram_wb_ctl *zram_wb_ctl_alloc(void)
+{
+	struct zram_wb_ctl *ctl;
+
+	ctl = kzalloc(sizeof(*ctl), GFP_KERNEL);
+	if (!ctl)
+		return NULL;
+
+	/* Make do with a smaller batch under memory pressure */
+	for (ctl->max = 0; ctl->max < ZRAM_WB_BATCH; ctl->max++) {
+		struct page *page = alloc_page(GFP_KERNEL | __GFP_NOWARN);
+
+		if (!page)
+			break;
+		/* lets the end_io handler find the slot of a page */
+		set_page_private(page, ctl->max);
+		ctl->pages[ctl->max] = page;
+	}
+
+	if (!ctl->max) {
+		kfree(ctl);
+		return NULL;
+	}
+	return ctl;
+}
+
+static bool zram_wb_limit_reached(struct zram *zram, struct zram_wb_ctl *ctl)
+{
+	bool reached;
+
+	spin_lock(&zram->wb_limit_lock);
+	reached = zram->wb_limit_enable &&
+		  zram->bd_wb_limit <= (u64)ctl->nr << (PAGE_SHIFT - 12);
+	spin_unlock(&zram->wb_limit_lock);
+
+	return reached;
+}
+
+static void zram_wb_end_io(struct bio *bio)
+{
+	struct zram_wb_ctl *ctl = bio->bi_private;
+
+	if (bio->bi_status) {
+		int err = blk_status_to_errno(bio->bi_status);
+		struct bvec_iter_all iter;
+		struct bio_vec *bv;
+
+		bio_for_each_segment_all(bv, bio, iter)
+			ctl->err[page_private(bv->bv_page)] = err;
+	}
+	bio_put(bio);
+
+	if (atomic_dec_and_test(&ctl->pending))
+		complete(&ctl->done);
+}
+
+static void zram_wb_submit(struct zram_wb_ctl *ctl, struct bio *bio)
+{
+	bio->bi_end_io = zram_wb_end_io;
+	bio->bi_private = ctl;
+	atomic_inc(&ctl->pending);
+	submit_bio(bio);
+}
+
+/*
+ * Called once the IO for the slot is done. The slot lock was released
+ * while the IO was in flight, so check whether the slot has changed.
+ */
+static int zram_wb_finish(struct zram *zram, u32 index, unsigned long blk_idx,
+			  int err)
+{
+	if (err) {
+		zram_slot_lock(zram, index);
+		zram_clear_flag(zram, index, ZRAM_UNDER_WB);
+		zram_clear_flag(zram, index, ZRAM_IDLE);
+		zram_slot_unlock(zram, index);
+		free_block_bdev(zram, blk_idx);
+		/*
+		 * BIO errors are not fatal, we continue and simply
+		 * attempt to writeback the remaining objects (pages).
+		 * At the same time we need to signal user-space that
+		 * some writes (at least one, but also could be all of
+		 * them) were not successful and we do so by returning
+		 * the most recent BIO error.
+		 */
+		return err;
+	}
+
+	atomic64_inc(&zram->stats.bd_writes);
+	/*
+	 * If there is freeing for the slot, we can catch it easily by
+	 * zram_allocated.
+	 * A subtle case is the slot is freed/reallocated/marked as
+	 * ZRAM_IDLE again. To close the race, idle_store doesn't
+	 * mark ZRAM_IDLE once it found the slot was ZRAM_UNDER_WB.
+	 * Thus, we could close the race by checking ZRAM_IDLE bit.
+	 */
+	zram_slot_lock(zram, index);
+	if (!zram_allocated(zram, index) ||
+	    !zram_test_flag(zram, index, ZRAM_IDLE)) {
+		zram_clear_flag(zram, index, ZRAM_UNDER_WB);
+		zram_clear_flag(zram, index, ZRAM_IDLE);
+		zram_slot_unlock(zram, index);
+		free_block_bdev(zram, blk_idx);
+		return 0;
+	}
+
+	zram_free_page(zram, index);
+	zram_clear_flag(zram, index, ZRAM_UNDER_WB);
+	zram_set_flag(zram, index, ZRAM_WB);
+	zram_set_element(zram, index, blk_idx);
+	atomic64_inc(&zram->stats.pages_stored);
+	spin_lock(&zram->wb_limit_lock);
+	if (zram->wb_limit_enable && zram->bd_wb_limit > 0)
+		zram->bd_wb_limit -=  1UL << (PAGE_SHIFT - 12);
+	spin_unlock(&zram->wb_limit_lock);
+	zram_slot_unlock(zram, index);
+
+	return 0;
+}
+
+/* Write out all batched slots and wait for the IO to complete */
+static int zram_wb_flush(struct zram *zram, struct zram_wb_ctl *ctl)
+{
+	struct blk_plug plug;
+	struct bio *bio = NULL;
+	unsigned int i;
+	int ret = 0;
+
+	if (!ctl->nr)
+		return 0;
+
+	init_completion(&ctl->done);
+	atomic_set(&ctl->pending, 1);
+
+	blk_start_plug(&plug);
+	for (i = 0; i < ctl->nr; i++) {
+		ctl->err[i] = 0;
+		/* Merge pages that landed on adjacent blocks */
+		if (bio && ctl->blk_idx[i] == ctl->blk_idx[i - 1] + 1 &&
+		    bio_add_page(bio, ctl->pages[i], PAGE_SIZE, 0))
+			continue;
+
+		if (bio)
+			zram_wb_submit(ctl, bio);
+		bio = bio_alloc(zram->bdev, ctl->nr - i,
+				REQ_OP_WRITE | REQ_SYNC, GFP_NOIO);
+		bio->bi_iter.bi_sector = ctl->blk_idx[i] * (PAGE_SIZE >> 9);
+		__bio_add_page(bio, ctl->pages[i], PAGE_SIZE, 0);
+	}
+	zram_wb_submit(ctl, bio);
+	blk_finish_plug(&plug);
+
+	if (!atomic_dec_and_test(&ctl->pending))
+		wait_for_completion_io(&ctl->done);
+
+	for (i = 0; i < ctl->nr; i++) {
+		int err = zram_wb_finish(zram, ctl->indices[i],
+					 ctl->blk_idx[i], ctl->err[i]);
+
+		if (err)
+			ret = err;
+	}
+	ctl->nr = 0;
+
+	return ret;
+}
+
+/*
+ * Add a slot, selected for writeback by the caller under the slot lock, to
+ * the batch. The slot lock is released. Returns -ENOSPC when the backing
+ * device is full and any other error of zram_wb_flush().
+ */
+static int zram_wb_add(struct zram *zram, struct zram_wb_ctl *ctl, u32 index)
+{
+	struct page *page = ctl->pages[ctl->nr];
+	unsigned long blk_idx;
+
+	/*
+	 * Clearing ZRAM_UNDER_WB is duty of caller.
+	 * IOW, zram_free_page never clear it.
+	 */
+	zram_set_flag(zram, index, ZRAM_UNDER_WB);
+	/* Need for hugepage writeback racing */
+	zram_set_flag(zram, index, ZRAM_IDLE);
+	zram_slot_unlock(zram, index);
+
+	blk_idx = alloc_block_bdev(zram);
+	if (!blk_idx || zram_read_page(zram, page, index, NULL)) {
+		zram_slot_lock(zram, index);
+		zram_clear_flag(zram, index, ZRAM_UNDER_WB);
+		zram_clear_flag(zram, index, ZRAM_IDLE);
+		zram_slot_unlock(zram, index);
+		if (!blk_idx)
+			return -ENOSPC;
+		free_block_bdev(zram, blk_idx);
+		return 0;
+	}
+
+	ctl->indices[ctl->nr] = index;
+	ctl->blk_idx[ctl->nr] = blk_idx;
+	if (++ctl->nr == ctl->max)
+		return zram_wb_flush(zram, ctl);
+	return 0;
+}
+
+/* Slots that are already on, or can't go to, the backing device */
+static bool zram_wb_skip(struct zram *zram, u32 index)
+{
+	return !zram_allocated(zram, index) ||
+		zram_test_flag(zram, index, ZRAM_WB) ||
+		zram_test_flag(zram, index, ZRAM_SAME) ||
+		zram_test_flag(zram, index, ZRAM_UNDER_WB);
+}
+
 static ssize_t writeback_store(struct device *dev,
 		struct device_attribute *attr, const char *buf, size_t len)
 {
 	struct zram *zram = dev_to_zram(dev);
 	unsigned long nr_pages = zram->disksize >> PAGE_SHIFT;
 	unsigned long index = 0;
-	struct bio bio;
-	struct bio_vec bio_vec;
-	struct page *page;
+	struct zram_wb_ctl *ctl;
 	ssize_t ret = len;
 	int mode, err;
-	unsigned long blk_idx = 0;
 
 	if (sysfs_streq(buf, "idle"))
 		mode = IDLE_WRITEBACK;
@@ -630,36 +894,20 @@ static ssize_t writeback_store(struct device *dev,
 		goto release_init_lock;
 	}
 
-	page = alloc_page(GFP_KERNEL);
-	if (!page) {
+	ctl = zram_wb_ctl_alloc();
+	if (!ctl) {
 		ret = -ENOMEM;
 		goto release_init_lock;
 	}
 
 	for (; nr_pages != 0; index++, nr_pages--) {
-		spin_lock(&zram->wb_limit_lock);
-		if (zram->wb_limit_enable && !zram->bd_wb_limit) {
-			spin_unlock(&zram->wb_limit_lock);
+		if (zram_wb_limit_reached(zram, ctl)) {
 			ret = -EIO;
 			break;
 		}
-		spin_unlock(&zram->wb_limit_lock);
-
-		if (!blk_idx) {
-			blk_idx = alloc_block_bdev(zram);
-			if (!blk_idx) {
-				ret = -ENOSPC;
-				break;
-			}
-		}
 
 		zram_slot_lock(zram, index);
-		if (!zram_allocated(zram, index))
-			goto next;
-
-		if (zram_test_flag(zram, index, ZRAM_WB) ||
-				zram_test_flag(zram, index, ZRAM_SAME) ||
-				zram_test_flag(zram, index, ZRAM_UNDER_WB))
+		if (zram_wb_skip(zram, index))
 			goto next;
 
 		if (mode & IDLE_WRITEBACK &&
@@ -672,90 +920,201 @@ static ssize_t writeback_store(struct device *dev,
 		    !zram_test_flag(zram, index, ZRAM_INCOMPRESSIBLE))
 			goto next;
 
-		/*
-		 * Clearing ZRAM_UNDER_WB is duty of caller.
-		 * IOW, zram_free_page never clear it.
-		 */
-		zram_set_flag(zram, index, ZRAM_UNDER_WB);
-		/* Need for hugepage writeback racing */
-		zram_set_flag(zram, index, ZRAM_IDLE);
-		zram_slot_unlock(zram, index);
-		if (zram_read_page(zram, page, index, NULL)) {
-			zram_slot_lock(zram, index);
-			zram_clear_flag(zram, index, ZRAM_UNDER_WB);
-			zram_clear_flag(zram, index, ZRAM_IDLE);
-			zram_slot_unlock(zram, index);
-			continue;
+		err = zram_wb_add(zram, ctl, index);
+		if (err == -ENOSPC) {
+			ret = err;
+			break;
 		}
+		if (err)
+			ret = err;
+		continue;
+next:
+		zram_slot_unlock(zram, index);
+	}
 
-		bio_init(&bio, zram->bdev, &bio_vec, 1,
-			 REQ_OP_WRITE | REQ_SYNC);
-		bio.bi_iter.bi_sector = blk_idx * (PAGE_SIZE >> 9);
-		__bio_add_page(&bio, page, PAGE_SIZE, 0);
+	err = zram_wb_flush(zram, ctl);
+	if (err)
+		ret = err;
+	zram_wb_ctl_free(ctl);
+release_init_lock:
+	up_read(&zram->init_lock);
 
-		/*
-		 * XXX: A single page IO would be inefficient for write
-		 * but it would be not bad as starter.
-		 */
-		err = submit_bio_wait(&bio);
-		if (err) {
-			zram_slot_lock(zram, index);
-			zram_clear_flag(zram, index, ZRAM_UNDER_WB);
-			zram_clear_flag(zram, index, ZRAM_IDLE);
-			zram_slot_unlock(zram, index);
-			/*
-			 * BIO errors are not fatal, we continue and simply
-			 * attempt to writeback the remaining objects (pages).
-			 * At the same time we need to signal user-space that
-			 * some writes (at least one, but also could be all of
-			 * them) were not successful and we do so by returning
-			 * the most recent BIO error.
-			 */
-			ret = err;
-			continue;
+	return ret;
+}
+
+#ifdef CONFIG_ZRAM_TIERING
+/*
+ * Stored pages are bucketed by the time since their last access: bucket 0
+ * holds pages accessed less than a second ago, bucket b >= 1 pages of age
+ * [2^(b-1), 2^b) seconds, and the last bucket everything older.
+ */
+#define ZRAM_AGE_BUCKETS	16
+#define ZRAM_TIER_INTERVAL	10	/* seconds */
+
+static unsigned int zram_age_bucket(struct zram *zram, u32 index, ktime_t now)
+{
+	u64 age = ktime_divns(ktime_sub(now, zram->ac_time[index]),
+			      NSEC_PER_SEC);
+
+	return min_t(unsigned int, fls64(age), ZRAM_AGE_BUCKETS - 1);
+}
+
+static u64 zram_age_bucket_start(unsigned int bucket)
+{
+	return bucket ? 1ULL << (bucket - 1) : 0;
+}
+
+/*
+ * Histogram of the pages that could be written back: number of pages and
+ * their compressed size per age bucket.
+ */
+static void zram_age_histogram(struct zram *zram, u64 *pages, u64 *size)
+{
+	unsigned long nr_pages = zram->disksize >> PAGE_SHIFT;
+	ktime_t now = ktime_get_boottime();
+	unsigned long index;
+
+	for (index = 0; index < nr_pages; index++) {
+		unsigned int b;
+
+		zram_slot_lock(zram, index);
+		if (!zram_wb_skip(zram, index)) {
+			b = zram_age_bucket(zram, index, now);
+			pages[b]++;
+			size[b] += zram_get_obj_size(zram, index);
 		}
+		zram_slot_unlock(zram, index);
+
+		if (!(index % SZ_64K))
+			cond_resched();
+	}
+}
+
+static ssize_t age_histogram_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	u64 pages[ZRAM_AGE_BUCKETS] = { 0 }, size[ZRAM_AGE_BUCKETS] = { 0 };
+	struct zram *zram = dev_to_zram(dev);
+	ssize_t sz = 0;
+	unsigned int b;
+
+	down_read(&zram->init_lock);
+	if (init_done(zram))
+		zram_age_histogram(zram, pages, size);
+	up_read(&zram->init_lock);
+
+	for (b = 0; b < ZRAM_AGE_BUCKETS; b++)
+		sz += scnprintf(buf + sz, PAGE_SIZE - sz,
+				"%8llu %8llu %8llu\n",
+				zram_age_bucket_start(b), pages[b], size[b]);
+	return sz;
+}
+
+/*
+ * Write back the coldest pages until @excess bytes of compressed data have
+ * left memory: find the youngest age bucket such that it and all older
+ * buckets together hold @excess bytes, then write back every page of at
+ * least that age. Pages younger than a second are never written back.
+ */
+static void zram_tier_writeback(struct zram *zram, u64 excess)
+{
+	u64 pages[ZRAM_AGE_BUCKETS] = { 0 }, size[ZRAM_AGE_BUCKETS] = { 0 };
+	unsigned long nr_pages = zram->disksize >> PAGE_SHIFT;
+	ktime_t now = ktime_get_boottime();
+	struct zram_wb_ctl *ctl;
+	unsigned long index;
+	unsigned int cutoff;
+	u64 sum = 0;
+
+	zram_age_histogram(zram, pages, size);
+	for (cutoff = ZRAM_AGE_BUCKETS - 1; cutoff > 1; cutoff--) {
+		sum += size[cutoff];
+		if (sum >= excess)
+			break;
+	}
+
+	ctl = zram_wb_ctl_alloc();
+	if (!ctl)
+		return;
+
+	sum = 0;
+	for (index = 0; index < nr_pages && sum < excess; index++) {
+		if (zram_wb_limit_reached(zram, ctl))
+			break;
 
-		atomic64_inc(&zram->stats.bd_writes);
-		/*
-		 * We released zram_slot_lock so need to check if the slot was
-		 * changed. If there is freeing for the slot, we can catch it
-		 * easily by zram_allocated.
-		 * A subtle case is the slot is freed/reallocated/marked as
-		 * ZRAM_IDLE again. To close the race, idle_store doesn't
-		 * mark ZRAM_IDLE once it found the slot was ZRAM_UNDER_WB.
-		 * Thus, we could close the race by checking ZRAM_IDLE bit.
-		 */
 		zram_slot_lock(zram, index);
-		if (!zram_allocated(zram, index) ||
-			  !zram_test_flag(zram, index, ZRAM_IDLE)) {
-			zram_clear_flag(zram, index, ZRAM_UNDER_WB);
-			zram_clear_flag(zram, index, ZRAM_IDLE);
-			goto next;
+		if (zram_wb_skip(zram, index) ||
+		    zram_age_bucket(zram, index, now) < cutoff) {
+			zram_slot_unlock(zram, index);
+			continue;
 		}
 
-		zram_free_page(zram, index);
-		zram_clear_flag(zram, index, ZRAM_UNDER_WB);
-		zram_set_flag(zram, index, ZRAM_WB);
-		zram_set_element(zram, index, blk_idx);
-		blk_idx = 0;
-		atomic64_inc(&zram->stats.pages_stored);
-		spin_lock(&zram->wb_limit_lock);
-		if (zram->wb_limit_enable && zram->bd_wb_limit > 0)
-			zram->bd_wb_limit -=  1UL << (PAGE_SHIFT - 12);
-		spin_unlock(&zram->wb_limit_lock);
-next:
-		zram_slot_unlock(zram, index);
+		sum += zram_get_obj_size(zram, index);
+		if (zram_wb_add(zram, ctl, index) == -ENOSPC)
+			break;
 	}
+	zram_wb_flush(zram, ctl);
+	zram_wb_ctl_free(ctl);
+}
 
-	if (blk_idx)
-		free_block_bdev(zram, blk_idx);
-	__free_page(page);
-release_init_lock:
+static void zram_tier_work(struct work_struct *work)
+{
+	struct zram *zram = container_of(to_delayed_work(work), struct zram,
+					 tier_work);
+	u64 budget, used;
+
+	down_read(&zram->init_lock);
+	budget = READ_ONCE(zram->tier_budget);
+	if (!budget || !init_done(zram) || !zram->backing_dev)
+		goto out;
+
+	used = zs_get_total_pages(zram->mem_pool) << PAGE_SHIFT;
+	if (used > budget)
+		zram_tier_writeback(zram, used - budget);
+
+	queue_delayed_work(system_freezable_wq, &zram->tier_work,
+			   ZRAM_TIER_INTERVAL * HZ);
+out:
 	up_read(&zram->init_lock);
+}
 
-	return ret;
+/* Callers should hold the zram init lock */
+static void zram_tier_schedule(struct zram *zram)
+{
+	if (READ_ONCE(zram->tier_budget) && init_done(zram) &&
+	    zram->backing_dev)
+		mod_delayed_work(system_freezable_wq, &zram->tier_work, 0);
 }
 
+static ssize_t tier_budget_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	char *tmp;
+	u64 budget;
+
+	budget = memparse(buf, &tmp);
+	if (buf == tmp) /* no chars parsed, invalid input */
+		return -EINVAL;
+
+	down_read(&zram->init_lock);
+	WRITE_ONCE(zram->tier_budget, PAGE_ALIGN(budget));
+	zram_tier_schedule(zram);
+	up_read(&zram->init_lock);
+
+	return len;
+}
+
+static ssize_t tier_budget_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct zram *zram = dev_to_zram(dev);
+
+	return scnprintf(buf, PAGE_SIZE, "%llu\n",
+			 READ_ONCE(zram->tier_budget));
+}
+#endif
+
 struct zram_work {
 	struct work_struct work;
 	struct zram *zram;
@@ -821,6 +1180,10 @@ static int read_from_bdev(struct zram *zram, struct page *page,
 static void free_block_bdev(struct zram *zram, unsigned long blk_idx) {};
 #endif
 
+#ifndef CONFIG_ZRAM_TIERING
+static void zram_tier_schedule(struct zram *zram) {}
+#endif
+
 #ifdef CONFIG_ZRAM_MEMORY_TRACKING
 
 static struct dentry *zram_debugfs_root;
@@ -862,12 +1225,13 @@ static ssize_t read_block_state(struct file *file, char __user *buf,
 		if (!zram_allocated(zram, index))
 			goto next;
 
-		ts = ktime_to_timespec64(zram->table[index].ac_time);
+		ts = ktime_to_timespec64(zram->ac_time[index]);
 		copied = snprintf(kbuf + written, count,
 			"%12zd %12lld.%06lu %c%c%c%c%c%c\n",
 			index, (s64)ts.tv_sec,
 			ts.tv_nsec / NSEC_PER_USEC,
-			zram_test_flag(zram, index, ZRAM_SAME) ? 's' : '.',
+			zram_test_flag(zram, index, ZRAM_SAME) ? 's' :
+			zram_test_flag(zram, index, ZRAM_DEDUP) ? 'd' : '.',
 			zram_test_flag(zram, index, ZRAM_WB) ? 'w' : '.',
 			zram_test_flag(zram, index, ZRAM_HUGE) ? 'h' : '.',
 			zram_test_flag(zram, index, ZRAM_IDLE) ? 'i' : '.',
@@ -943,6 +1307,88 @@ static ssize_t max_comp_streams_store(struct device *dev,
 	return len;
 }
 
+#ifdef CONFIG_ZRAM_ASYNC_COMP
+static bool zram_async_comp(struct zram *zram)
+{
+	return zram->async_comp;
+}
+
+static ssize_t async_comp_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	bool val;
+
+	if (kstrtobool(buf, &val))
+		return -EINVAL;
+
+	down_write(&zram->init_lock);
+	if (init_done(zram)) {
+		up_write(&zram->init_lock);
+		pr_info("Can't change async_comp for initialized device\n");
+		return -EBUSY;
+	}
+	zram->async_comp = val;
+	up_write(&zram->init_lock);
+
+	return len;
+}
+
+static ssize_t async_comp_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct zram *zram = dev_to_zram(dev);
+	bool val;
+
+	down_read(&zram->init_lock);
+	val = zram->async_comp;
+	up_read(&zram->init_lock);
+
+	return scnprintf(buf, PAGE_SIZE, "%d\n", val);
+}
+#else
+static bool zram_async_comp(struct zram *zram)
+{
+	return false;
+}
+#endif
+
+#ifdef CONFIG_ZRAM_DEDUP
+static ssize_t use_dedup_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	bool val;
+
+	if (kstrtobool(buf, &val))
+		return -EINVAL;
+
+	down_write(&zram->init_lock);
+	if (init_done(zram)) {
+		up_write(&zram->init_lock);
+		pr_info("Can't change dedup usage for initialized device\n");
+		return -EBUSY;
+	}
+	zram->use_dedup = val;
+	up_write(&zram->init_lock);
+
+	return len;
+}
+
+static ssize_t use_dedup_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct zram *zram = dev_to_zram(dev);
+	bool val;
+
+	down_read(&zram->init_lock);
+	val = zram->use_dedup;
+	up_read(&zram->init_lock);
+
+	return scnprintf(buf, PAGE_SIZE, "%d\n", val);
+}
+#endif
+
 static void comp_algorithm_set(struct zram *zram, u32 prio, const char *alg)
 {
 	/* Do not free statically defined compression algorithms */
@@ -1136,7 +1582,7 @@ static ssize_t mm_stat_show(struct device *dev,
 	max_used = atomic_long_read(&zram->stats.max_used_pages);
 
 	ret = scnprintf(buf, PAGE_SIZE,
-			"%8llu %8llu %8llu %8lu %8ld %8llu %8lu %8llu %8llu\n",
+			"%8llu %8llu %8llu %8lu %8ld %8llu %8lu %8llu %8llu %8llu %8llu\n",
 			orig_size << PAGE_SHIFT,
 			(u64)atomic64_read(&zram->stats.compr_data_size),
 			mem_used << PAGE_SHIFT,
@@ -1145,7 +1591,9 @@ static ssize_t mm_stat_show(struct device *dev,
 			(u64)atomic64_read(&zram->stats.same_pages),
 			atomic_long_read(&pool_stats.pages_compacted),
 			(u64)atomic64_read(&zram->stats.huge_pages),
-			(u64)atomic64_read(&zram->stats.huge_pages_since));
+			(u64)atomic64_read(&zram->stats.huge_pages_since),
+			(u64)atomic64_read(&zram->stats.dup_data_size),
+			(u64)atomic64_read(&zram->stats.meta_data_size));
 	up_read(&zram->init_lock);
 
 	return ret;
@@ -1196,6 +1644,150 @@ static DEVICE_ATTR_RO(bd_stat);
 #endif
 static DEVICE_ATTR_RO(debug_stat);
 
+/*
+ * Lockless readers (see zram_read_page_lockless()) may still access an
+ * object after its slot was freed. Freed handles are therefore collected
+ * in per-CPU batches and only returned to zsmalloc after an RCU grace
+ * period, from process context as zs_free() is not softirq safe.
+ */
+#define ZRAM_FREE_BATCH		64
+#define ZRAM_FREE_DELAY		(HZ / 10)
+
+struct zram_free_batch {
+	struct rcu_work rwork;
+	struct zs_pool *pool;
+	unsigned int nr;
+	unsigned long handles[ZRAM_FREE_BATCH];
+};
+
+struct zram_free_pcp {
+	spinlock_t lock;
+	struct zram_free_batch *batch;
+};
+
+static struct workqueue_struct *zram_free_wq;
+
+static void zram_free_batch_fn(struct work_struct *work)
+{
+	struct zram_free_batch *batch = container_of(to_rcu_work(work),
+						     struct zram_free_batch,
+						     rwork);
+	unsigned int i;
+
+	for (i = 0; i < batch->nr; i++)
+		zs_free(batch->pool, batch->handles[i]);
+	kfree(batch);
+}
+
+static void zram_free_batch_submit(struct zram_free_batch *batch)
+{
+	INIT_RCU_WORK(&batch->rwork, zram_free_batch_fn);
+	queue_rcu_work(zram_free_wq, &batch->rwork);
+}
+
+/* Submit the partially filled batches, so freed memory does not linger */
+static void zram_free_flush(struct zram *zram)
+{
+	struct zram_free_batch *batch;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		struct zram_free_pcp *pcp = per_cpu_ptr(zram->free_pcp, cpu);
+
+		spin_lock(&pcp->lock);
+		batch = pcp->batch;
+		pcp->batch = NULL;
+		spin_unlock(&pcp->lock);
+
+		if (batch)
+			zram_free_batch_submit(batch);
+	}
+}
+
+static void zram_free_work(struct work_struct *work)
+{
+	struct zram *zram = container_of(to_delayed_work(work), struct zram,
+					 free_work);
+
+	zram_free_flush(zram);
+}
+
+/*
+ * Lockless readers run with preemption disabled, which makes them RCU
+ * readers, and are counted in zram->readers for zram_free_handle_sync().
+ */
+static bool zram_lockless_read_begin(struct zram *zram)
+{
+	preempt_disable();
+	this_cpu_inc(*zram->readers);
+	/* Pairs with smp_mb__after_atomic() in zram_free_handle_sync() */
+	smp_mb();
+	if (likely(!atomic_read(&zram->lockless_off)))
+		return true;
+
+	this_cpu_dec(*zram->readers);
+	preempt_enable();
+	return false;
+}
+
+static void zram_lockless_read_end(struct zram *zram)
+{
+	/* Complete all object accesses before dropping out of the count */
+	smp_mb();
+	this_cpu_dec(*zram->readers);
+	preempt_enable();
+}
+
+/*
+ * Fallback for when no batch can be allocated: keep new lockless readers
+ * out and wait for the ones in progress, which do not block, to finish.
+ */
+static void zram_free_handle_sync(struct zram *zram, unsigned long handle)
+{
+	int cpu;
+
+	atomic_inc(&zram->lockless_off);
+	smp_mb__after_atomic();
+	for_each_possible_cpu(cpu) {
+		while (READ_ONCE(*per_cpu_ptr(zram->readers, cpu)))
+			cpu_relax();
+	}
+	zs_free(zram->mem_pool, handle);
+	atomic_dec(&zram->lockless_off);
+}
+
+static void zram_free_handle(struct zram *zram, unsigned long handle)
+{
+	struct zram_free_pcp *pcp = raw_cpu_ptr(zram->free_pcp);
+	struct zram_free_batch *batch;
+
+	spin_lock(&pcp->lock);
+	batch = pcp->batch;
+	if (!batch) {
+		batch = kmalloc(sizeof(*batch), GFP_ATOMIC | __GFP_NOWARN);
+		if (!batch) {
+			spin_unlock(&pcp->lock);
+			zram_free_handle_sync(zram, handle);
+			return;
+		}
+		batch->pool = zram->mem_pool;
+		batch->nr = 0;
+		pcp->batch = batch;
+		queue_delayed_work(zram_free_wq, &zram->free_work,
+				   ZRAM_FREE_DELAY);
+	}
+
+	batch->handles[batch->nr++] = handle;
+	if (batch->nr == ZRAM_FREE_BATCH)
+		pcp->batch = NULL;
+	else
+		batch = NULL;
+	spin_unlock(&pcp->lock);
+
+	if (batch)
+		zram_free_batch_submit(batch);
+}
+
 static void zram_meta_free(struct zram *zram, u64 disksize)
 {
 	size_t num_pages = disksize >> PAGE_SHIFT;
@@ -1205,28 +1797,73 @@ static void zram_meta_free(struct zram *zram, u64 disksize)
 	for (index = 0; index < num_pages; index++)
 		zram_free_page(zram, index);
 
+	/* Wait for the deferred frees before the pool goes away */
+	cancel_delayed_work_sync(&zram->free_work);
+	zram_free_flush(zram);
+	rcu_barrier();
+	flush_workqueue(zram_free_wq);
+
+	zram_dedup_fini(zram);
 	zs_destroy_pool(zram->mem_pool);
+	free_percpu(zram->readers);
+	free_percpu(zram->free_pcp);
+#ifdef CONFIG_ZRAM_TRACK_ENTRY_ACTIME
+	vfree(zram->ac_time);
+#endif
 	vfree(zram->table);
 }
 
 static bool zram_meta_alloc(struct zram *zram, u64 disksize)
 {
 	size_t num_pages;
+	int cpu;
 
 	num_pages = disksize >> PAGE_SHIFT;
 	zram->table = vzalloc(array_size(num_pages, sizeof(*zram->table)));
 	if (!zram->table)
 		return false;
 
+#ifdef CONFIG_ZRAM_TRACK_ENTRY_ACTIME
+	zram->ac_time = vzalloc(array_size(num_pages, sizeof(*zram->ac_time)));
+	if (!zram->ac_time)
+		goto free_table;
+#endif
+
+	zram->free_pcp = alloc_percpu(struct zram_free_pcp);
+	if (!zram->free_pcp)
+		goto free_actime;
+	for_each_possible_cpu(cpu)
+		spin_lock_init(&per_cpu_ptr(zram->free_pcp, cpu)->lock);
+
+	zram->readers = alloc_percpu(unsigned int);
+	if (!zram->readers)
+		goto free_pcp;
+	atomic_set(&zram->lockless_off, 0);
+
 	zram->mem_pool = zs_create_pool(zram->disk->disk_name);
-	if (!zram->mem_pool) {
-		vfree(zram->table);
-		return false;
-	}
+	if (!zram->mem_pool)
+		goto free_readers;
+
+	if (zram_dedup_init(zram, num_pages))
+		goto destroy_pool;
 
 	if (!huge_class_size)
 		huge_class_size = zs_huge_class_size(zram->mem_pool);
 	return true;
+
+destroy_pool:
+	zs_destroy_pool(zram->mem_pool);
+free_readers:
+	free_percpu(zram->readers);
+free_pcp:
+	free_percpu(zram->free_pcp);
+free_actime:
+#ifdef CONFIG_ZRAM_TRACK_ENTRY_ACTIME
+	vfree(zram->ac_time);
+free_table:
+#endif
+	vfree(zram->table);
+	return false;
 }
 
 /*
@@ -1239,7 +1876,7 @@ static void zram_free_page(struct zram *zram, size_t index)
 	unsigned long handle;
 
 #ifdef CONFIG_ZRAM_TRACK_ENTRY_ACTIME
-	zram->table[index].ac_time = 0;
+	zram->ac_time[index] = 0;
 #endif
 	if (zram_test_flag(zram, index, ZRAM_IDLE))
 		zram_clear_flag(zram, index, ZRAM_IDLE);
@@ -1270,11 +1907,18 @@ static void zram_free_page(struct zram *zram, size_t index)
 		goto out;
 	}
 
+	/* The shared object is freed with its last reference */
+	if (zram_test_flag(zram, index, ZRAM_DEDUP)) {
+		zram_dedup_put(zram, (void *)zram_get_element(zram, index));
+		zram_clear_flag(zram, index, ZRAM_DEDUP);
+		goto out;
+	}
+
 	handle = zram_get_handle(zram, index);
 	if (!handle)
 		return;
 
-	zs_free(zram->mem_pool, handle);
+	zram_free_handle(zram, handle);
 
 	atomic64_sub(zram_get_obj_size(zram, index),
 			&zram->stats.compr_data_size);
@@ -1282,56 +1926,105 @@ static void zram_free_page(struct zram *zram, size_t index)
 	atomic64_dec(&zram->stats.pages_stored);
 	zram_set_handle(zram, index, 0);
 	zram_set_obj_size(zram, index, 0);
-	WARN_ON_ONCE(zram->table[index].flags &
+	WARN_ON_ONCE(zram->table[index].flags & (ZRAM_SEQ_INC - 1) &
 		~(1UL << ZRAM_LOCK | 1UL << ZRAM_UNDER_WB));
 }
 
 /*
- * Reads (decompresses if needed) a page from zspool (zsmalloc).
- * Corresponding ZRAM slot should be locked.
+ * Reads (decompresses if needed) the object @handle with slot @flags into
+ * @page. For same filled pages @handle is the element.
  */
-static int zram_read_from_zspool(struct zram *zram, struct page *page,
-				 u32 index)
+static int zram_read_object(struct zram *zram, struct page *page,
+			    unsigned long handle, unsigned long flags)
 {
 	struct zcomp_strm *zstrm;
-	unsigned long handle;
 	unsigned int size;
 	void *src, *dst;
 	u32 prio;
 	int ret;
 
-	handle = zram_get_handle(zram, index);
-	if (!handle || zram_test_flag(zram, index, ZRAM_SAME)) {
-		unsigned long value;
+	if (!handle || (flags & BIT(ZRAM_SAME))) {
 		void *mem;
 
-		value = handle ? zram_get_element(zram, index) : 0;
 		mem = kmap_local_page(page);
-		zram_fill_page(mem, PAGE_SIZE, value);
+		zram_fill_page(mem, PAGE_SIZE, handle);
 		kunmap_local(mem);
 		return 0;
 	}
 
-	size = zram_get_obj_size(zram, index);
+	size = flags & (BIT(ZRAM_FLAG_SHIFT) - 1);
 
 	if (size != PAGE_SIZE) {
-		prio = zram_get_priority(zram, index);
+		prio = (flags >> ZRAM_COMP_PRIORITY_BIT1) &
+			ZRAM_COMP_PRIORITY_MASK;
 		zstrm = zcomp_stream_get(zram->comps[prio]);
 	}
 
-	src = zs_map_object(zram->mem_pool, handle, ZS_MM_RO);
-	if (size == PAGE_SIZE) {
-		dst = kmap_local_page(page);
-		copy_page(dst, src);
-		kunmap_local(dst);
-		ret = 0;
-	} else {
-		dst = kmap_local_page(page);
-		ret = zcomp_decompress(zstrm, src, size, dst);
-		kunmap_local(dst);
-		zcomp_stream_put(zram->comps[prio]);
-	}
-	zs_unmap_object(zram->mem_pool, handle);
+	src = zs_map_object(zram->mem_pool, handle, ZS_MM_RO);
+	if (size == PAGE_SIZE) {
+		dst = kmap_local_page(page);
+		copy_page(dst, src);
+		kunmap_local(dst);
+		ret = 0;
+	} else {
+		dst = kmap_local_page(page);
+		ret = zcomp_decompress(zstrm, src, size, dst);
+		kunmap_local(dst);
+		zcomp_stream_put(zram->comps[prio]);
+	}
+	zs_unmap_object(zram->mem_pool, handle);
+	return ret;
+}
+
+/*
+ * Reads (decompresses if needed) a page from zspool (zsmalloc).
+ * Corresponding ZRAM slot should be locked.
+ */
+static int zram_read_from_zspool(struct zram *zram, struct page *page,
+				 u32 index)
+{
+	return zram_read_object(zram, page, zram_get_handle(zram, index),
+				zram->table[index].flags);
+}
+
+/*
+ * Read an in-memory slot without taking its lock, so that readers of
+ * different slots never write to shared cache lines. The handle is only
+ * used if the slot flags, including their sequence count, are the same
+ * before and after reading it; the object itself stays valid until the
+ * reader is done, see zram_free_handle(). Returns -EAGAIN if the caller
+ * has to fall back to a locked read.
+ *
+ * Limited to 64-bit, where the sequence count is wide enough not to wrap
+ * within a read, and to !PREEMPT_RT, where decompression must not run
+ * with preemption disabled.
+ */
+static int zram_read_page_lockless(struct zram *zram, struct page *page,
+				   u32 index)
+{
+	struct zram_table_entry *entry = &zram->table[index];
+	unsigned long flags, handle;
+	int ret = -EAGAIN;
+
+	if (!IS_ENABLED(CONFIG_64BIT) || IS_ENABLED(CONFIG_PREEMPT_RT))
+		return -EAGAIN;
+
+	if (!zram_lockless_read_begin(zram))
+		return -EAGAIN;
+
+	flags = smp_load_acquire(&entry->flags);
+	/* Written back and deduplicated slots point to unprotected memory */
+	if (flags & (BIT(ZRAM_LOCK) | BIT(ZRAM_WB) | BIT(ZRAM_DEDUP)))
+		goto out;
+
+	handle = READ_ONCE(entry->handle);
+	smp_rmb();
+	if (READ_ONCE(entry->flags) != flags)
+		goto out;
+
+	ret = zram_read_object(zram, page, handle, flags);
+out:
+	zram_lockless_read_end(zram);
 	return ret;
 }
 
@@ -1340,6 +2033,10 @@ static int zram_read_page(struct zram *zram, struct page *page, u32 index,
 {
 	int ret;
 
+	ret = zram_read_page_lockless(zram, page, index);
+	if (ret != -EAGAIN)
+		goto out;
+
 	zram_slot_lock(zram, index);
 	if (!zram_test_flag(zram, index, ZRAM_WB)) {
 		/* Slot should be locked through out the function call */
@@ -1356,6 +2053,7 @@ static int zram_read_page(struct zram *zram, struct page *page, u32 index,
 				     parent);
 	}
 
+out:
 	/* Should NEVER happen. Return bio error if it does. */
 	if (WARN_ON(ret < 0))
 		pr_err("Decompression failed! err=%d, page=%u\n", ret, index);
@@ -1390,6 +2088,83 @@ static int zram_bvec_read(struct zram *zram, struct bio_vec *bvec,
 	return zram_read_page(zram, bvec->bv_page, index, bio);
 }
 
+/*
+ * Install a freshly written object (or same filled element) into the slot,
+ * freeing whatever the slot held before.
+ */
+static void zram_store_slot(struct zram *zram, u32 index, unsigned long handle,
+			    unsigned int comp_len, enum zram_pageflags flags,
+			    unsigned long element)
+{
+	/*
+	 * Free memory associated with this sector
+	 * before overwriting unused sectors.
+	 */
+	zram_slot_lock(zram, index);
+	zram_free_page(zram, index);
+
+	if (comp_len == PAGE_SIZE) {
+		zram_set_flag(zram, index, ZRAM_HUGE);
+		atomic64_inc(&zram->stats.huge_pages);
+		atomic64_inc(&zram->stats.huge_pages_since);
+	}
+
+	if (flags) {
+		zram_set_flag(zram, index, flags);
+		zram_set_element(zram, index, element);
+	}  else {
+		zram_set_handle(zram, index, handle);
+	}
+	zram_set_obj_size(zram, index, comp_len);
+	zram_slot_unlock(zram, index);
+
+	/* Update stats */
+	atomic64_inc(&zram->stats.pages_stored);
+}
+
+/*
+ * Store a freshly compressed object, making it available for
+ * deduplication of later writes if enabled.
+ */
+static void zram_store_object(struct zram *zram, u32 index,
+			      unsigned long handle, unsigned int comp_len,
+			      u32 checksum)
+{
+	struct zram_dedup_entry *entry = NULL;
+
+	if (zram_dedup_enabled(zram))
+		entry = zram_dedup_insert(zram, handle, comp_len, checksum);
+
+	if (entry)
+		zram_store_slot(zram, index, 0, comp_len, ZRAM_DEDUP,
+				(unsigned long)entry);
+	else
+		zram_store_slot(zram, index, handle, comp_len, 0, 0);
+}
+
+/*
+ * Store @page as a reference to an existing object of identical content.
+ * The checksum of @page is returned for zram_store_object() otherwise.
+ */
+static bool zram_write_dup(struct zram *zram, struct page *page, u32 index,
+			   u32 *checksum)
+{
+	struct zram_dedup_entry *entry;
+
+	*checksum = 0;
+	if (!zram_dedup_enabled(zram))
+		return false;
+
+	*checksum = zram_dedup_checksum(page);
+	entry = zram_dedup_find(zram, page, *checksum);
+	if (!entry)
+		return false;
+
+	zram_store_slot(zram, index, 0, zram_dedup_len(entry), ZRAM_DEDUP,
+			(unsigned long)entry);
+	return true;
+}
+
 static int zram_write_page(struct zram *zram, struct page *page, u32 index)
 {
 	int ret = 0;
@@ -1400,6 +2175,7 @@ static int zram_write_page(struct zram *zram, struct page *page, u32 index)
 	struct zcomp_strm *zstrm;
 	unsigned long element = 0;
 	enum zram_pageflags flags = 0;
+	u32 checksum;
 
 	mem = kmap_local_page(page);
 	if (page_same_filled(mem, &element)) {
@@ -1411,6 +2187,9 @@ static int zram_write_page(struct zram *zram, struct page *page, u32 index)
 	}
 	kunmap_local(mem);
 
+	if (zram_write_dup(zram, page, index, &checksum))
+		return 0;
+
 compress_again:
 	zstrm = zcomp_stream_get(zram->comps[ZRAM_PRIMARY_COMP]);
 	src = kmap_local_page(page);
@@ -1487,31 +2266,132 @@ static int zram_write_page(struct zram *zram, struct page *page, u32 index)
 	zcomp_stream_put(zram->comps[ZRAM_PRIMARY_COMP]);
 	zs_unmap_object(zram->mem_pool, handle);
 	atomic64_add(comp_len, &zram->stats.compr_data_size);
+	zram_store_object(zram, index, handle, comp_len, checksum);
+	return ret;
 out:
+	zram_store_slot(zram, index, handle, comp_len, flags, element);
+	return ret;
+}
+
+/*
+ * Store @page as a ZRAM_SAME slot if it is filled with a single element.
+ */
+static bool zram_write_same_filled(struct zram *zram, struct page *page,
+				   u32 index)
+{
+	unsigned long element = 0;
+	void *mem;
+	bool same;
+
+	mem = kmap_local_page(page);
+	same = page_same_filled(mem, &element);
+	kunmap_local(mem);
+	if (!same)
+		return false;
+
+	atomic64_inc(&zram->stats.same_pages);
+	zram_store_slot(zram, index, 0, 0, ZRAM_SAME, element);
+	return true;
+}
+
+/*
+ * Write a batch of full pages: all pages are compressed under a single
+ * stream acquisition and zsmalloc handles are allocated on the fast path
+ * only. Pages for which the fast path allocation fails are handed over
+ * to zram_write_page(), which knows how to wait for memory.
+ */
+static int zram_write_pages(struct zram *zram, struct page **pages,
+			    u32 *indices, unsigned int nr)
+{
+	unsigned long handle[ZCOMP_BATCH_SIZE];
+	unsigned int comp_len[ZCOMP_BATCH_SIZE];
+	u32 checksum[ZCOMP_BATCH_SIZE];
+	const void *src[ZCOMP_BATCH_SIZE];
+	unsigned int slot[ZCOMP_BATCH_SIZE];
+	unsigned long alloced_pages;
+	struct zcomp_strm *zstrm;
+	unsigned int i, n = 0;
+	int ret;
+
 	/*
-	 * Free memory associated with this sector
-	 * before overwriting unused sectors.
+	 * Same filled and duplicate pages don't need compression, store
+	 * them right away. slot[] maps the rest back to @pages and @indices,
+	 * which the caller still walks in full afterwards.
 	 */
-	zram_slot_lock(zram, index);
-	zram_free_page(zram, index);
+	for (i = 0; i < nr; i++) {
+		if (zram_write_same_filled(zram, pages[i], indices[i]) ||
+		    zram_write_dup(zram, pages[i], indices[i], &checksum[n]))
+			continue;
+		slot[n++] = i;
+	}
 
-	if (comp_len == PAGE_SIZE) {
-		zram_set_flag(zram, index, ZRAM_HUGE);
-		atomic64_inc(&zram->stats.huge_pages);
-		atomic64_inc(&zram->stats.huge_pages_since);
+	if (!n)
+		return 0;
+
+	zstrm = zcomp_stream_get(zram->comps[ZRAM_PRIMARY_COMP]);
+	for (i = 0; i < n; i++)
+		src[i] = kmap_local_page(pages[slot[i]]);
+	ret = zcomp_compress_batch(zstrm, src, comp_len, n);
+	/* kmap_local mappings have to be released in reverse order */
+	for (i = n; i-- > 0; )
+		kunmap_local(src[i]);
+
+	if (unlikely(ret)) {
+		zcomp_stream_put(zram->comps[ZRAM_PRIMARY_COMP]);
+		pr_err("Compression failed! err=%d\n", ret);
+		return ret;
 	}
 
-	if (flags) {
-		zram_set_flag(zram, index, flags);
-		zram_set_element(zram, index, element);
-	}  else {
-		zram_set_handle(zram, index, handle);
-		zram_set_obj_size(zram, index, comp_len);
+	for (i = 0; i < n; i++) {
+		void *dst, *mem;
+
+		if (comp_len[i] >= huge_class_size)
+			comp_len[i] = PAGE_SIZE;
+
+		handle[i] = zs_malloc(zram->mem_pool, comp_len[i],
+				      __GFP_KSWAPD_RECLAIM |
+				      __GFP_NOWARN |
+				      __GFP_HIGHMEM |
+				      __GFP_MOVABLE);
+		if (IS_ERR_VALUE(handle[i]))
+			continue;
+
+		dst = zs_map_object(zram->mem_pool, handle[i], ZS_MM_WO);
+		if (comp_len[i] == PAGE_SIZE) {
+			mem = kmap_local_page(pages[slot[i]]);
+			memcpy(dst, mem, PAGE_SIZE);
+			kunmap_local(mem);
+		} else {
+			memcpy(dst, zcomp_strm_buffer(zstrm, i), comp_len[i]);
+		}
+		zs_unmap_object(zram->mem_pool, handle[i]);
 	}
-	zram_slot_unlock(zram, index);
+	zcomp_stream_put(zram->comps[ZRAM_PRIMARY_COMP]);
 
-	/* Update stats */
-	atomic64_inc(&zram->stats.pages_stored);
+	alloced_pages = zs_get_total_pages(zram->mem_pool);
+	update_used_max(zram, alloced_pages);
+
+	for (i = 0; i < n; i++) {
+		if (IS_ERR_VALUE(handle[i])) {
+			/* Slow path: compress again with direct reclaim */
+			if (!ret)
+				ret = zram_write_page(zram, pages[slot[i]],
+						      indices[slot[i]]);
+			continue;
+		}
+
+		if (ret || (zram->limit_pages &&
+			    alloced_pages > zram->limit_pages)) {
+			zs_free(zram->mem_pool, handle[i]);
+			if (!ret)
+				ret = -ENOMEM;
+			continue;
+		}
+
+		atomic64_add(comp_len[i], &zram->stats.compr_data_size);
+		zram_store_object(zram, indices[slot[i]], handle[i],
+				  comp_len[i], checksum[i]);
+	}
 	return ret;
 }
 
@@ -1817,6 +2697,15 @@ static ssize_t recompress_store(struct device *dev,
 		    zram_test_flag(zram, index, ZRAM_INCOMPRESSIBLE))
 			goto next;
 
+		/*
+		 * Recompressing a shared object would only give this slot a
+		 * private copy. A sole reference is freed like a plain handle.
+		 */
+		if (zram_test_flag(zram, index, ZRAM_DEDUP) &&
+		    zram_dedup_shared(zram,
+				      (void *)zram_get_element(zram, index)))
+			goto next;
+
 		err = zram_recompress(zram, index, page, &num_recomp_pages,
 				      threshold, prio, prio_max);
 next:
@@ -1894,9 +2783,7 @@ static void zram_bio_read(struct zram *zram, struct bio *bio)
 		}
 		flush_dcache_page(bv.bv_page);
 
-		zram_slot_lock(zram, index);
-		zram_accessed(zram, index);
-		zram_slot_unlock(zram, index);
+		zram_read_accessed(zram, index);
 
 		bio_advance_iter_single(bio, &iter, bv.bv_len);
 	} while (iter.bi_size);
@@ -1905,36 +2792,233 @@ static void zram_bio_read(struct zram *zram, struct bio *bio)
 	bio_endio(bio);
 }
 
+static int zram_bio_write_batch(struct zram *zram, struct page **pages,
+				u32 *indices, unsigned int nr)
+{
+	unsigned int i;
+	int ret;
+
+	ret = zram_write_pages(zram, pages, indices, nr);
+	if (ret < 0)
+		return ret;
+
+	for (i = 0; i < nr; i++) {
+		zram_slot_lock(zram, indices[i]);
+		zram_accessed(zram, indices[i]);
+		zram_slot_unlock(zram, indices[i]);
+	}
+	return 0;
+}
+
 static void zram_bio_write(struct zram *zram, struct bio *bio)
 {
 	unsigned long start_time = bio_start_io_acct(bio);
 	struct bvec_iter iter = bio->bi_iter;
+	struct page *pages[ZCOMP_BATCH_SIZE];
+	u32 indices[ZCOMP_BATCH_SIZE];
+	unsigned int nr = 0;
 
 	do {
 		u32 index = iter.bi_sector >> SECTORS_PER_PAGE_SHIFT;
 		u32 offset = (iter.bi_sector & (SECTORS_PER_PAGE - 1)) <<
 				SECTOR_SHIFT;
 		struct bio_vec bv = bio_iter_iovec(bio, iter);
+		int ret;
 
 		bv.bv_len = min_t(u32, bv.bv_len, PAGE_SIZE - offset);
 
-		if (zram_bvec_write(zram, &bv, index, offset, bio) < 0) {
+		if (ZCOMP_BATCH_SIZE > 1 && !is_partial_io(&bv)) {
+			pages[nr] = bv.bv_page;
+			indices[nr++] = index;
+			ret = 0;
+			if (nr == ZCOMP_BATCH_SIZE) {
+				ret = zram_bio_write_batch(zram, pages,
+							   indices, nr);
+				nr = 0;
+			}
+			goto next;
+		}
+
+		if (nr) {
+			ret = zram_bio_write_batch(zram, pages, indices, nr);
+			nr = 0;
+			if (ret < 0)
+				goto next;
+		}
+
+		ret = zram_bvec_write(zram, &bv, index, offset, bio);
+		if (!ret) {
+			zram_slot_lock(zram, index);
+			zram_accessed(zram, index);
+			zram_slot_unlock(zram, index);
+		}
+next:
+		if (ret < 0) {
+			nr = 0;
 			atomic64_inc(&zram->stats.failed_writes);
 			bio->bi_status = BLK_STS_IOERR;
 			break;
 		}
 
-		zram_slot_lock(zram, index);
-		zram_accessed(zram, index);
-		zram_slot_unlock(zram, index);
-
 		bio_advance_iter_single(bio, &iter, bv.bv_len);
 	} while (iter.bi_size);
 
+	if (nr && zram_bio_write_batch(zram, pages, indices, nr) < 0) {
+		atomic64_inc(&zram->stats.failed_writes);
+		bio->bi_status = BLK_STS_IOERR;
+	}
+
 	bio_end_io_acct(bio, start_time);
 	bio_endio(bio);
 }
 
+#ifdef CONFIG_ZRAM_ASYNC_COMP
+/* a bio whose pages are being compressed asynchronously */
+struct zram_async_ctl {
+	struct bio *bio;
+	unsigned long start_time;
+	atomic_t pending;
+};
+
+static void zram_async_ctl_put(struct zram_async_ctl *ctl)
+{
+	struct bio *bio = ctl->bio;
+
+	if (!atomic_dec_and_test(&ctl->pending))
+		return;
+
+	bio_end_io_acct(bio, ctl->start_time);
+	bio_endio(bio);
+	kfree(ctl);
+}
+
+/*
+ * Completion of an asynchronous page compression started by
+ * zram_bio_write_async(), called in process context.
+ */
+static void zram_write_page_done(struct zcomp_req *zreq, int err)
+{
+	struct zram_async_ctl *ctl = zreq->private;
+	struct bio *bio = ctl->bio;
+	struct zram *zram = bio->bi_bdev->bd_disk->private_data;
+	unsigned int comp_len = zreq->dst_len;
+	unsigned long alloced_pages;
+	unsigned long handle;
+	u32 index = zreq->index;
+	void *src, *dst;
+
+	if (unlikely(err)) {
+		pr_err("Compression failed! err=%d\n", err);
+		goto out_err;
+	}
+
+	if (comp_len >= huge_class_size)
+		comp_len = PAGE_SIZE;
+
+	/* Unlike zram_write_page() we are allowed to sleep here */
+	handle = zs_malloc(zram->mem_pool, comp_len,
+			   GFP_NOIO | __GFP_HIGHMEM | __GFP_MOVABLE);
+	if (IS_ERR_VALUE(handle))
+		goto out_err;
+
+	alloced_pages = zs_get_total_pages(zram->mem_pool);
+	update_used_max(zram, alloced_pages);
+
+	if (zram->limit_pages && alloced_pages > zram->limit_pages) {
+		zs_free(zram->mem_pool, handle);
+		goto out_err;
+	}
+
+	dst = zs_map_object(zram->mem_pool, handle, ZS_MM_WO);
+	if (comp_len == PAGE_SIZE) {
+		src = kmap_local_page(zreq->page);
+		memcpy(dst, src, PAGE_SIZE);
+		kunmap_local(src);
+	} else {
+		memcpy(dst, zreq->buffer, comp_len);
+	}
+	zs_unmap_object(zram->mem_pool, handle);
+	atomic64_add(comp_len, &zram->stats.compr_data_size);
+
+	zram_store_object(zram, index, handle, comp_len, zreq->checksum);
+
+	zram_slot_lock(zram, index);
+	zram_accessed(zram, index);
+	zram_slot_unlock(zram, index);
+	goto out;
+
+out_err:
+	atomic64_inc(&zram->stats.failed_writes);
+	bio->bi_status = BLK_STS_IOERR;
+out:
+	zcomp_req_put(zreq);
+	zram_async_ctl_put(ctl);
+}
+
+/*
+ * Submit every full page of the bio for asynchronous compression, each
+ * holding a reference on the bio's control. The bio completes, and its
+ * accounting ends, once the last compressed page has been stored.
+ */
+static void zram_bio_write_async(struct zram *zram, struct bio *bio)
+{
+	struct zcomp *comp = zram->comps[ZRAM_PRIMARY_COMP];
+	struct bvec_iter iter = bio->bi_iter;
+	struct zram_async_ctl *ctl;
+
+	ctl = kmalloc(sizeof(*ctl), GFP_NOIO | __GFP_NOWARN);
+	if (!ctl) {
+		zram_bio_write(zram, bio);
+		return;
+	}
+	ctl->bio = bio;
+	ctl->start_time = bio_start_io_acct(bio);
+	atomic_set(&ctl->pending, 1);
+
+	do {
+		u32 index = iter.bi_sector >> SECTORS_PER_PAGE_SHIFT;
+		u32 offset = (iter.bi_sector & (SECTORS_PER_PAGE - 1)) <<
+				SECTOR_SHIFT;
+		struct bio_vec bv = bio_iter_iovec(bio, iter);
+		struct zcomp_req *zreq;
+		u32 checksum;
+
+		bv.bv_len = min_t(u32, bv.bv_len, PAGE_SIZE - offset);
+
+		if (is_partial_io(&bv) ||
+		    zram_write_same_filled(zram, bv.bv_page, index) ||
+		    zram_write_dup(zram, bv.bv_page, index, &checksum)) {
+			if (is_partial_io(&bv) &&
+			    zram_bvec_write(zram, &bv, index, offset, bio) < 0) {
+				atomic64_inc(&zram->stats.failed_writes);
+				bio->bi_status = BLK_STS_IOERR;
+				break;
+			}
+
+			zram_slot_lock(zram, index);
+			zram_accessed(zram, index);
+			zram_slot_unlock(zram, index);
+			goto next;
+		}
+
+		zreq = zcomp_req_get(comp);
+		zreq->done = zram_write_page_done;
+		zreq->page = bv.bv_page;
+		zreq->private = ctl;
+		zreq->index = index;
+		zreq->checksum = checksum;
+		atomic_inc(&ctl->pending);
+		zcomp_compress_async(zreq);
+next:
+		bio_advance_iter_single(bio, &iter, bv.bv_len);
+	} while (iter.bi_size);
+
+	zram_async_ctl_put(ctl);
+}
+#else
+static void zram_bio_write_async(struct zram *zram, struct bio *bio) {}
+#endif
+
 /*
  * Handler function for all zram I/O requests.
  */
@@ -1947,7 +3031,10 @@ static void zram_submit_bio(struct bio *bio)
 		zram_bio_read(zram, bio);
 		break;
 	case REQ_OP_WRITE:
-		zram_bio_write(zram, bio);
+		if (zcomp_is_async(zram->comps[ZRAM_PRIMARY_COMP]))
+			zram_bio_write_async(zram, bio);
+		else
+			zram_bio_write(zram, bio);
 		break;
 	case REQ_OP_DISCARD:
 	case REQ_OP_WRITE_ZEROES:
@@ -2013,7 +3100,15 @@ static void zram_reset_device(struct zram *zram)
 	reset_bdev(zram);
 
 	comp_algorithm_set(zram, ZRAM_PRIMARY_COMP, default_compressor);
+#ifdef CONFIG_ZRAM_TIERING
+	WRITE_ONCE(zram->tier_budget, 0);
+#endif
 	up_write(&zram->init_lock);
+
+#ifdef CONFIG_ZRAM_TIERING
+	/* Not rearmed anymore without a budget */
+	cancel_delayed_work_sync(&zram->tier_work);
+#endif
 }
 
 static ssize_t disksize_store(struct device *dev,
@@ -2046,7 +3141,9 @@ static ssize_t disksize_store(struct device *dev,
 		if (!zram->comp_algs[prio])
 			continue;
 
-		comp = zcomp_create(zram->comp_algs[prio]);
+		comp = zcomp_create(zram->comp_algs[prio],
+				    prio == ZRAM_PRIMARY_COMP &&
+				    zram_async_comp(zram));
 		if (IS_ERR(comp)) {
 			pr_err("Cannot initialise %s compressing backend\n",
 			       zram->comp_algs[prio]);
@@ -2059,6 +3156,7 @@ static ssize_t disksize_store(struct device *dev,
 	}
 	zram->disksize = disksize;
 	set_capacity_and_notify(zram->disk, zram->disksize >> SECTOR_SHIFT);
+	zram_tier_schedule(zram);
 	up_write(&zram->init_lock);
 
 	return len;
@@ -2139,12 +3237,22 @@ static DEVICE_ATTR_WO(mem_used_max);
 static DEVICE_ATTR_WO(idle);
 static DEVICE_ATTR_RW(max_comp_streams);
 static DEVICE_ATTR_RW(comp_algorithm);
+#ifdef CONFIG_ZRAM_ASYNC_COMP
+static DEVICE_ATTR_RW(async_comp);
+#endif
+#ifdef CONFIG_ZRAM_DEDUP
+static DEVICE_ATTR_RW(use_dedup);
+#endif
 #ifdef CONFIG_ZRAM_WRITEBACK
 static DEVICE_ATTR_RW(backing_dev);
 static DEVICE_ATTR_WO(writeback);
 static DEVICE_ATTR_RW(writeback_limit);
 static DEVICE_ATTR_RW(writeback_limit_enable);
 #endif
+#ifdef CONFIG_ZRAM_TIERING
+static DEVICE_ATTR_RW(tier_budget);
+static DEVICE_ATTR_RO(age_histogram);
+#endif
 #ifdef CONFIG_ZRAM_MULTI_COMP
 static DEVICE_ATTR_RW(recomp_algorithm);
 static DEVICE_ATTR_WO(recompress);
@@ -2160,11 +3268,21 @@ static struct attribute *zram_disk_attrs[] = {
 	&dev_attr_idle.attr,
 	&dev_attr_max_comp_streams.attr,
 	&dev_attr_comp_algorithm.attr,
+#ifdef CONFIG_ZRAM_ASYNC_COMP
+	&dev_attr_async_comp.attr,
+#endif
+#ifdef CONFIG_ZRAM_DEDUP
+	&dev_attr_use_dedup.attr,
+#endif
 #ifdef CONFIG_ZRAM_WRITEBACK
 	&dev_attr_backing_dev.attr,
 	&dev_attr_writeback.attr,
 	&dev_attr_writeback_limit.attr,
 	&dev_attr_writeback_limit_enable.attr,
+#endif
+#ifdef CONFIG_ZRAM_TIERING
+	&dev_attr_tier_budget.attr,
+	&dev_attr_age_histogram.attr,
 #endif
 	&dev_attr_io_stat.attr,
 	&dev_attr_mm_stat.attr,
@@ -2224,9 +3342,13 @@ static int zram_add(void)
 	device_id = ret;
 
 	init_rwsem(&zram->init_lock);
+	INIT_DELAYED_WORK(&zram->free_work, zram_free_work);
 #ifdef CONFIG_ZRAM_WRITEBACK
 	spin_lock_init(&zram->wb_limit_lock);
 #endif
+#ifdef CONFIG_ZRAM_TIERING
+	INIT_DELAYED_WORK(&zram->tier_work, zram_tier_work);
+#endif
 
 	/* gendisk structure */
 	zram->disk = blk_alloc_disk(&lim, NUMA_NO_NODE);
@@ -2397,6 +3519,7 @@ static void destroy_devices(void)
 	idr_destroy(&zram_index_idr);
 	unregister_blkdev(zram_major, "zram");
 	cpuhp_remove_multi_state(CPUHP_ZCOMP_PREPARE);
+	destroy_workqueue(zram_free_wq);
 }
 
 static int __init zram_init(void)
@@ -2404,16 +3527,25 @@ static int __init zram_init(void)
 	int ret;
 
 	BUILD_BUG_ON(__NR_ZRAM_PAGEFLAGS > BITS_PER_LONG);
+	BUILD_BUG_ON(!is_power_of_2(sizeof(struct zram_table_entry)));
+
+	zram_free_wq = alloc_workqueue("zram_free",
+				       WQ_UNBOUND | WQ_MEM_RECLAIM, 0);
+	if (!zram_free_wq)
+		return -ENOMEM;
 
 	ret = cpuhp_setup_state_multi(CPUHP_ZCOMP_PREPARE, "block/zram:prepare",
 				      zcomp_cpu_up_prepare, zcomp_cpu_dead);
-	if (ret < 0)
+	if (ret < 0) {
+		destroy_workqueue(zram_free_wq);
 		return ret;
+	}
 
 	ret = class_register(&zram_control_class);
 	if (ret) {
 		pr_err("Unable to register zram-control class\n");
 		cpuhp_remove_multi_state(CPUHP_ZCOMP_PREPARE);
+		destroy_workqueue(zram_free_wq);
 		return ret;
 	}
 
@@ -2423,6 +3555,7 @@ static int __init zram_init(void)
 		pr_err("Unable to get major number\n");
 		class_unregister(&zram_control_class);
 		cpuhp_remove_multi_state(CPUHP_ZCOMP_PREPARE);
+		destroy_workqueue(zram_free_wq);
 		return -EBUSY;
 	}
 
@@ -20,6 +20,7 @@
 #include <linux/crypto.h>
 
 #include "zcomp.h"
+#include "zram_dedup.h"
 
 #define SECTORS_PER_PAGE_SHIFT	(PAGE_SHIFT - SECTOR_SHIFT)
 #define SECTORS_PER_PAGE	(1 << SECTORS_PER_PAGE_SHIFT)
@@ -53,6 +54,7 @@ enum zram_pageflags {
 	ZRAM_HUGE,	/* Incompressible page */
 	ZRAM_IDLE,	/* not accessed page since last idle marking */
 	ZRAM_INCOMPRESSIBLE, /* none of the algorithms could compress it */
+	ZRAM_DEDUP,	/* element points to a shared zram_dedup_entry */
 
 	ZRAM_COMP_PRIORITY_BIT1, /* First bit of comp priority index */
 	ZRAM_COMP_PRIORITY_BIT2, /* Second bit of comp priority index */
@@ -60,18 +62,27 @@ enum zram_pageflags {
 	__NR_ZRAM_PAGEFLAGS,
 };
 
+/*
+ * The flags bits above the pageflags hold a sequence count which is bumped
+ * on every slot unlock. Lockless readers use it to detect that the slot
+ * changed under them.
+ */
+#define ZRAM_SEQ_SHIFT	__NR_ZRAM_PAGEFLAGS
+#define ZRAM_SEQ_INC	BIT(ZRAM_SEQ_SHIFT)
+
 /*-- Data structures */
 
-/* Allocated for each disk page */
+/*
+ * Allocated for each disk page. Kept at a power of two size so that no
+ * entry straddles a cache line; the access times, which are updated far
+ * more often than the rest of the slot, live in a separate array.
+ */
 struct zram_table_entry {
 	union {
 		unsigned long handle;
 		unsigned long element;
 	};
 	unsigned long flags;
-#ifdef CONFIG_ZRAM_TRACK_ENTRY_ACTIME
-	ktime_t ac_time;
-#endif
 };
 
 struct zram_stats {
@@ -86,6 +97,8 @@ struct zram_stats {
 	atomic_long_t max_used_pages;	/* no. of maximum pages stored */
 	atomic64_t writestall;		/* no. of write slow paths */
 	atomic64_t miss_free;		/* no. of missed free */
+	atomic64_t dup_data_size;	/* compressed size of deduplicated pages */
+	atomic64_t meta_data_size;	/* size of deduplication metadata */
 #ifdef	CONFIG_ZRAM_WRITEBACK
 	atomic64_t bd_count;		/* no. of pages in backing device */
 	atomic64_t bd_reads;		/* no. of reads from backing device */
@@ -103,9 +116,20 @@ struct zram_stats {
 #define ZRAM_MAX_COMPS	1U
 #endif
 
+struct zram_free_pcp;
+
 struct zram {
 	struct zram_table_entry *table;
+#ifdef CONFIG_ZRAM_TRACK_ENTRY_ACTIME
+	ktime_t *ac_time;
+#endif
 	struct zs_pool *mem_pool;
+	/* objects freed while lockless readers may still access them */
+	struct zram_free_pcp __percpu *free_pcp;
+	struct delayed_work free_work;
+	/* lockless readers in progress, per CPU */
+	unsigned int __percpu *readers;
+	atomic_t lockless_off;
 	struct zcomp *comps[ZRAM_MAX_COMPS];
 	struct gendisk *disk;
 	/* Prevent concurrent execution of device init */
@@ -127,6 +151,9 @@ struct zram {
 	 * zram is claimed so open request will be failed
 	 */
 	bool claim; /* Protected by disk->open_mutex */
+#ifdef CONFIG_ZRAM_ASYNC_COMP
+	bool async_comp;
+#endif
 #ifdef CONFIG_ZRAM_WRITEBACK
 	struct file *backing_dev;
 	spinlock_t wb_limit_lock;
@@ -136,8 +163,27 @@ struct zram {
 	unsigned long *bitmap;
 	unsigned long nr_pages;
 #endif
+#ifdef CONFIG_ZRAM_TIERING
+	/* memory zram may use before cold pages are written back */
+	u64 tier_budget;
+	struct delayed_work tier_work;
+#endif
 #ifdef CONFIG_ZRAM_MEMORY_TRACKING
 	struct dentry *debugfs_dir;
 #endif
+#ifdef CONFIG_ZRAM_DEDUP
+	bool use_dedup;
+	struct zram_hash *hash;
+	size_t hash_size;
+#endif
 };
+
+static inline bool zram_dedup_enabled(struct zram *zram)
+{
+#ifdef CONFIG_ZRAM_DEDUP
+	return zram->use_dedup;
+#else
+	return false;
+#endif
+}
 #endif
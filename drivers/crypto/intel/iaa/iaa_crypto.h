@@ -79,6 +79,9 @@ struct iaa_device {
 	atomic64_t			decomp_bytes;
 };
 
+/* Number of devices' worth of wqs a cpu's wq table entry can hold */
+#define IAA_WQ_TABLE_DEVICES		4
+
 struct wq_table_entry {
 	struct idxd_wq **wqs;
 	int	max_wqs;
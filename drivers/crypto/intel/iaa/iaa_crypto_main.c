@@ -38,16 +38,34 @@ static struct crypto_comp *deflate_generic_tfm;
 /* Per-cpu lookup table for balanced wqs */
 static struct wq_table_entry __percpu *wq_table;
 
+/*
+ * Pick the least loaded of the cpu's wqs, starting after the one used
+ * last so that idle wqs are still taken in turn.  The client count of a
+ * wq includes every request in flight on it; it's read without the
+ * device lock and is only a hint.
+ */
 static struct idxd_wq *wq_table_next_wq(int cpu)
 {
 	struct wq_table_entry *entry = per_cpu_ptr(wq_table, cpu);
+	int i, idx, load, best = -1, best_load = INT_MAX;
 
-	if (++entry->cur_wq >= entry->n_wqs)
-		entry->cur_wq = 0;
+	for (i = 0; i < entry->n_wqs; i++) {
+		idx = (entry->cur_wq + 1 + i) % entry->n_wqs;
+		if (!entry->wqs[idx])
+			continue;
+
+		load = READ_ONCE(entry->wqs[idx]->client_count);
+		if (load < best_load) {
+			best = idx;
+			best_load = load;
+		}
+	}
 
-	if (!entry->wqs[entry->cur_wq])
+	if (best < 0)
 		return NULL;
 
+	entry->cur_wq = best;
+
 	pr_debug("%s: returning wq at idx %d (iaa wq %d.%d) from cpu %d\n", __func__,
 		 entry->cur_wq, entry->wqs[entry->cur_wq]->idxd->id,
 		 entry->wqs[entry->cur_wq]->id, cpu);
@@ -887,11 +905,40 @@ static int wq_table_add_wqs(int iaa, int cpu)
 	return ret;
 }
 
+/*
+ * Give @cpu the wqs of every IAA device on @node, up to the capacity of
+ * its table entry, so that wq_table_next_wq() can spread the load over
+ * all local accelerators.  Returns the number of wqs added.
+ */
+static int wq_table_add_node_wqs(int node, int cpu)
+{
+	struct wq_table_entry *entry = per_cpu_ptr(wq_table, cpu);
+	struct iaa_device *iaa_device;
+	struct iaa_wq *iaa_wq;
+	int n_wqs_added = 0;
+
+	list_for_each_entry(iaa_device, &iaa_devices, list) {
+		if (dev_to_node(&iaa_device->idxd->pdev->dev) != node)
+			continue;
+
+		list_for_each_entry(iaa_wq, &iaa_device->wqs, list) {
+			if (entry->n_wqs == entry->max_wqs)
+				return n_wqs_added;
+
+			wq_table_add(cpu, iaa_wq->wq);
+			n_wqs_added++;
+		}
+	}
+
+	return n_wqs_added;
+}
+
 /*
  * Rebalance the wq table so that given a cpu, it's easy to find the
  * closest IAA instance.  The idea is to try to choose the most
  * appropriate IAA instance for a caller and spread available
- * workqueues around to clients.
+ * workqueues around to clients.  CPUs on a node with IAA devices use
+ * all of that node's wqs; the others are spread over the devices.
  */
 static void rebalance_wq_table(void)
 {
@@ -931,6 +978,9 @@ static void rebalance_wq_table(void)
 			if ((cpu % cpus_per_iaa) == 0)
 				iaa++;
 
+			if (wq_table_add_node_wqs(node, node_cpu))
+				continue;
+
 			if (WARN_ON(wq_table_add_wqs(iaa, node_cpu))) {
 				pr_debug("could not add any wqs for iaa %d to cpu %d!\n", iaa, cpu);
 				return;
@@ -1122,6 +1172,52 @@ static void iaa_desc_complete(struct idxd_desc *idxd_desc,
 	iaa_wq_put(idxd_desc->wq);
 }
 
+static struct iax_hw_desc *
+iaa_setup_compress_desc(struct idxd_desc *idxd_desc,
+			struct iaa_device_compression_mode *mode,
+			dma_addr_t src_addr, unsigned int slen,
+			dma_addr_t dst_addr, unsigned int dlen)
+{
+	struct iax_hw_desc *desc = idxd_desc->iax_hw;
+
+	desc->flags = IDXD_OP_FLAG_CRAV | IDXD_OP_FLAG_RCR |
+		IDXD_OP_FLAG_RD_SRC2_AECS | IDXD_OP_FLAG_CC;
+	desc->opcode = IAX_OPCODE_COMPRESS;
+	desc->compr_flags = IAA_COMP_FLAGS;
+	desc->priv = 0;
+
+	desc->src1_addr = (u64)src_addr;
+	desc->src1_size = slen;
+	desc->dst_addr = (u64)dst_addr;
+	desc->max_dst_size = dlen;
+	desc->src2_addr = mode->aecs_comp_table_dma_addr;
+	desc->src2_size = sizeof(struct aecs_comp_table_record);
+	desc->completion_addr = idxd_desc->compl_dma;
+
+	return desc;
+}
+
+static struct iax_hw_desc *
+iaa_setup_decompress_desc(struct idxd_desc *idxd_desc,
+			  dma_addr_t src_addr, unsigned int slen,
+			  dma_addr_t dst_addr, unsigned int dlen)
+{
+	struct iax_hw_desc *desc = idxd_desc->iax_hw;
+
+	desc->flags = IDXD_OP_FLAG_CRAV | IDXD_OP_FLAG_RCR | IDXD_OP_FLAG_CC;
+	desc->opcode = IAX_OPCODE_DECOMPRESS;
+	desc->decompr_flags = IAA_DECOMP_FLAGS;
+	desc->priv = 0;
+
+	desc->src1_addr = (u64)src_addr;
+	desc->dst_addr = (u64)dst_addr;
+	desc->max_dst_size = dlen;
+	desc->src1_size = slen;
+	desc->completion_addr = idxd_desc->compl_dma;
+
+	return desc;
+}
+
 static int iaa_compress(struct crypto_tfm *tfm,	struct acomp_req *req,
 			struct idxd_wq *wq,
 			dma_addr_t src_addr, unsigned int slen,
@@ -1154,21 +1250,8 @@ static int iaa_compress(struct crypto_tfm *tfm,	struct acomp_req *req,
 		dev_dbg(dev, "iaa compress failed: ret=%ld\n", PTR_ERR(idxd_desc));
 		return PTR_ERR(idxd_desc);
 	}
-	desc = idxd_desc->iax_hw;
-
-	desc->flags = IDXD_OP_FLAG_CRAV | IDXD_OP_FLAG_RCR |
-		IDXD_OP_FLAG_RD_SRC2_AECS | IDXD_OP_FLAG_CC;
-	desc->opcode = IAX_OPCODE_COMPRESS;
-	desc->compr_flags = IAA_COMP_FLAGS;
-	desc->priv = 0;
-
-	desc->src1_addr = (u64)src_addr;
-	desc->src1_size = slen;
-	desc->dst_addr = (u64)dst_addr;
-	desc->max_dst_size = *dlen;
-	desc->src2_addr = active_compression_mode->aecs_comp_table_dma_addr;
-	desc->src2_size = sizeof(struct aecs_comp_table_record);
-	desc->completion_addr = idxd_desc->compl_dma;
+	desc = iaa_setup_compress_desc(idxd_desc, active_compression_mode,
+				       src_addr, slen, dst_addr, *dlen);
 
 	if (ctx->use_irq && !disable_async) {
 		desc->flags |= IDXD_OP_FLAG_RCI;
@@ -1394,19 +1477,8 @@ static int iaa_decompress(struct crypto_tfm *tfm, struct acomp_req *req,
 			PTR_ERR(idxd_desc));
 		return PTR_ERR(idxd_desc);
 	}
-	desc = idxd_desc->iax_hw;
-
-	desc->flags = IDXD_OP_FLAG_CRAV | IDXD_OP_FLAG_RCR | IDXD_OP_FLAG_CC;
-	desc->opcode = IAX_OPCODE_DECOMPRESS;
-	desc->max_dst_size = PAGE_SIZE;
-	desc->decompr_flags = IAA_DECOMP_FLAGS;
-	desc->priv = 0;
-
-	desc->src1_addr = (u64)src_addr;
-	desc->dst_addr = (u64)dst_addr;
-	desc->max_dst_size = *dlen;
-	desc->src1_size = slen;
-	desc->completion_addr = idxd_desc->compl_dma;
+	desc = iaa_setup_decompress_desc(idxd_desc, src_addr, slen,
+					 dst_addr, *dlen);
 
 	if (ctx->use_irq && !disable_async) {
 		desc->flags |= IDXD_OP_FLAG_RCI;
@@ -1889,7 +1961,7 @@ static int iaa_crypto_probe(struct idxd_dev *idxd_dev)
 	mutex_lock(&iaa_devices_lock);
 
 	if (list_empty(&iaa_devices)) {
-		ret = alloc_wq_table(wq->idxd->max_wqs);
+		ret = alloc_wq_table(wq->idxd->max_wqs * IAA_WQ_TABLE_DEVICES);
 		if (ret)
 			goto err_alloc;
 		first_wq = true;
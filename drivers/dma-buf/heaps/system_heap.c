@@ -18,8 +18,10 @@
 #include <linux/mm.h>
 #include <linux/module.h>
 #include <linux/scatterlist.h>
+#include <linux/shrinker.h>
 #include <linux/slab.h>
 #include <linux/vmalloc.h>
+#include <linux/workqueue.h>
 
 static struct dma_heap *sys_heap;
 
@@ -54,6 +56,165 @@ static gfp_t order_flags[] = {HIGH_ORDER_GFP, HIGH_ORDER_GFP, LOW_ORDER_GFP};
 static const unsigned int orders[] = {8, 4, 0};
 #define NUM_ORDERS ARRAY_SIZE(orders)
 
+/*
+ * Pages of freed buffers are kept in a pool per order and zeroed in the
+ * background, so that allocations can mostly be served with pages that are
+ * already cleared instead of going to the page allocator and zeroing them.
+ */
+struct system_heap_pool {
+	spinlock_t lock;
+	struct list_head clean;
+	struct list_head dirty;
+};
+
+static struct system_heap_pool pools[NUM_ORDERS];
+static atomic_long_t pool_pages;
+static struct shrinker *pool_shrinker;
+
+static unsigned int pool_size_mb = 64;
+module_param(pool_size_mb, uint, 0644);
+MODULE_PARM_DESC(pool_size_mb, "Size limit in MiB of the pool of recycled pages (default 64)");
+
+static void system_heap_pool_zero_work(struct work_struct *work);
+static DECLARE_WORK(pool_zero_work, system_heap_pool_zero_work);
+
+static void system_heap_zero_page(struct page *page, unsigned int order)
+{
+	unsigned int i;
+
+	for (i = 0; i < 1U << order; i++)
+		clear_highpage(page + i);
+}
+
+static int system_heap_order_index(unsigned int order)
+{
+	int i;
+
+	for (i = 0; i < NUM_ORDERS; i++) {
+		if (orders[i] == order)
+			return i;
+	}
+	return -1;
+}
+
+/* Take a zeroed page of orders[i] from the pool, NULL if it is empty */
+static struct page *system_heap_pool_take(int i)
+{
+	struct system_heap_pool *pool = &pools[i];
+	bool dirty = false;
+	struct page *page;
+
+	spin_lock(&pool->lock);
+	page = list_first_entry_or_null(&pool->clean, struct page, lru);
+	if (!page) {
+		page = list_first_entry_or_null(&pool->dirty, struct page, lru);
+		dirty = true;
+	}
+	if (page) {
+		list_del(&page->lru);
+		atomic_long_sub(1 << orders[i], &pool_pages);
+	}
+	spin_unlock(&pool->lock);
+
+	if (page && dirty)
+		system_heap_zero_page(page, orders[i]);
+
+	return page;
+}
+
+/* Give the page of a released buffer back to the pool, or free it */
+static void system_heap_pool_give(struct page *page)
+{
+	unsigned int order = compound_order(page);
+	unsigned long limit = (unsigned long)READ_ONCE(pool_size_mb) <<
+			      (20 - PAGE_SHIFT);
+	int i = system_heap_order_index(order);
+
+	/* Reserve room first so that concurrent frees can't overshoot */
+	if (i < 0 ||
+	    atomic_long_add_return(1 << order, &pool_pages) > limit) {
+		if (i >= 0)
+			atomic_long_sub(1 << order, &pool_pages);
+		__free_pages(page, order);
+		return;
+	}
+
+	spin_lock(&pools[i].lock);
+	list_add_tail(&page->lru, &pools[i].dirty);
+	spin_unlock(&pools[i].lock);
+}
+
+static void system_heap_pool_zero_work(struct work_struct *work)
+{
+	struct page *page;
+	int i;
+
+	for (i = 0; i < NUM_ORDERS; i++) {
+		struct system_heap_pool *pool = &pools[i];
+
+		for (;;) {
+			spin_lock(&pool->lock);
+			page = list_first_entry_or_null(&pool->dirty,
+							struct page, lru);
+			if (page)
+				list_del(&page->lru);
+			spin_unlock(&pool->lock);
+			if (!page)
+				break;
+
+			system_heap_zero_page(page, orders[i]);
+
+			spin_lock(&pool->lock);
+			list_add(&page->lru, &pool->clean);
+			spin_unlock(&pool->lock);
+			cond_resched();
+		}
+	}
+}
+
+static unsigned long system_heap_pool_count(struct shrinker *shrinker,
+					    struct shrink_control *sc)
+{
+	unsigned long count = atomic_long_read(&pool_pages);
+
+	return count ? count : SHRINK_EMPTY;
+}
+
+/* Free dirty pages before zeroed ones and small orders before large ones */
+static unsigned long system_heap_pool_scan(struct shrinker *shrinker,
+					   struct shrink_control *sc)
+{
+	unsigned long freed = 0;
+	struct page *page;
+	int i, pass;
+
+	for (pass = 0; pass < 2; pass++) {
+		for (i = NUM_ORDERS - 1; i >= 0; i--) {
+			struct system_heap_pool *pool = &pools[i];
+			struct list_head *list = pass ? &pool->clean : &pool->dirty;
+
+			while (freed < sc->nr_to_scan) {
+				spin_lock(&pool->lock);
+				page = list_first_entry_or_null(list, struct page,
+								lru);
+				if (page) {
+					list_del(&page->lru);
+					atomic_long_sub(1 << orders[i],
+							&pool_pages);
+				}
+				spin_unlock(&pool->lock);
+				if (!page)
+					break;
+
+				__free_pages(page, orders[i]);
+				freed += 1 << orders[i];
+			}
+		}
+	}
+
+	return freed ? freed : SHRINK_STOP;
+}
+
 static struct sg_table *dup_sg_table(struct sg_table *table)
 {
 	struct sg_table *new_table;
@@ -289,13 +450,12 @@ static void system_heap_dma_buf_release(struct dma_buf *dmabuf)
 	int i;
 
 	table = &buffer->sg_table;
-	for_each_sgtable_sg(table, sg, i) {
-		struct page *page = sg_page(sg);
-
-		__free_pages(page, compound_order(page));
-	}
+	for_each_sgtable_sg(table, sg, i)
+		system_heap_pool_give(sg_page(sg));
 	sg_free_table(table);
 	kfree(buffer);
+
+	queue_work(system_unbound_wq, &pool_zero_work);
 }
 
 static const struct dma_buf_ops system_heap_buf_ops = {
@@ -323,6 +483,10 @@ static struct page *alloc_largest_available(unsigned long size,
 		if (max_order < orders[i])
 			continue;
 
+		page = system_heap_pool_take(i);
+		if (page)
+			return page;
+
 		page = alloc_pages(order_flags[i], orders[i]);
 		if (!page)
 			continue;
@@ -424,6 +588,23 @@ static const struct dma_heap_ops system_heap_ops = {
 static int system_heap_create(void)
 {
 	struct dma_heap_export_info exp_info;
+	int i;
+
+	for (i = 0; i < NUM_ORDERS; i++) {
+		spin_lock_init(&pools[i].lock);
+		INIT_LIST_HEAD(&pools[i].clean);
+		INIT_LIST_HEAD(&pools[i].dirty);
+	}
+
+	pool_shrinker = shrinker_alloc(0, "dmabuf-system-heap-pool");
+	if (pool_shrinker) {
+		pool_shrinker->count_objects = system_heap_pool_count;
+		pool_shrinker->scan_objects = system_heap_pool_scan;
+		shrinker_register(pool_shrinker);
+	} else {
+		/* Without a shrinker the pool must stay empty */
+		pool_size_mb = 0;
+	}
 
 	exp_info.name = "system";
 	exp_info.ops = &system_heap_ops;
@@ -96,9 +96,25 @@ int drm_sched_policy = DRM_SCHED_POLICY_FIFO;
  * DOC: sched_policy (int)
  * Used to override default entities scheduling policy in a run queue.
  */
-MODULE_PARM_DESC(sched_policy, "Specify the scheduling policy for entities on a run-queue, " __stringify(DRM_SCHED_POLICY_RR) " = Round Robin, " __stringify(DRM_SCHED_POLICY_FIFO) " = FIFO (default).");
+MODULE_PARM_DESC(sched_policy, "Specify the scheduling policy for entities on a run-queue, " __stringify(DRM_SCHED_POLICY_RR) " = Round Robin, " __stringify(DRM_SCHED_POLICY_FIFO) " = FIFO (default), " __stringify(DRM_SCHED_POLICY_DEADLINE) " = Earliest Deadline First.");
 module_param_named(sched_policy, drm_sched_policy, int, 0444);
 
+static unsigned int drm_sched_deadline_slack_ms = 100;
+
+/**
+ * DOC: sched_deadline_slack_ms (uint)
+ * Implicit deadline, relative to submission, given to jobs nobody has set a
+ * dma-fence deadline on when the EDF policy is in use.
+ */
+MODULE_PARM_DESC(sched_deadline_slack_ms, "Implicit deadline in ms after submission for jobs without a fence deadline under EDF (default 100)");
+module_param_named(sched_deadline_slack_ms, drm_sched_deadline_slack_ms, uint, 0644);
+
+/*
+ * Upper bound on the number of jobs pushed to run_job() before flush_jobs()
+ * is called, for backends which implement it.
+ */
+#define DRM_SCHED_RUN_JOB_BATCH	8
+
 static u32 drm_sched_available_credits(struct drm_gpu_scheduler *sched)
 {
 	u32 credits;
@@ -359,6 +375,88 @@ drm_sched_rq_select_entity_fifo(struct drm_gpu_scheduler *sched,
 	return rb ? rb_entry(rb, struct drm_sched_entity, rb_tree_node) : NULL;
 }
 
+/**
+ * drm_sched_job_deadline - effective deadline of a queued job
+ * @job: the job
+ *
+ * The deadline set on the job's finished fence through
+ * dma_fence_set_deadline() if there is one and it is earlier than the
+ * implicit one, which is the submission time plus the configured slack. The
+ * implicit deadline keeps jobs nobody waits on in FIFO order and stops them
+ * from being starved by a stream of jobs with deadlines.
+ */
+static ktime_t drm_sched_job_deadline(struct drm_sched_job *job)
+{
+	struct drm_sched_fence *s_fence = job->s_fence;
+	ktime_t deadline;
+	unsigned long flags;
+
+	deadline = ktime_add_ms(job->submit_ts,
+				READ_ONCE(drm_sched_deadline_slack_ms));
+
+	spin_lock_irqsave(&s_fence->lock, flags);
+	if (test_bit(DRM_SCHED_FENCE_FLAG_HAS_DEADLINE_BIT,
+		     &s_fence->finished.flags) &&
+	    ktime_before(s_fence->deadline, deadline))
+		deadline = s_fence->deadline;
+	spin_unlock_irqrestore(&s_fence->lock, flags);
+
+	return deadline;
+}
+
+/**
+ * drm_sched_rq_select_entity_deadline - Select the entity with the most
+ * urgent job
+ *
+ * @sched: the gpu scheduler
+ * @rq: scheduler run queue to check.
+ *
+ * Find the ready entity whose next job has the earliest effective deadline.
+ * Deadlines can be set on a fence at any time by a waiter, so they are
+ * evaluated here rather than cached in a sorted tree which would go stale.
+ *
+ * Return an entity if one is found; return an error-pointer (!NULL) if an
+ * entity was ready, but the scheduler had insufficient credits to accommodate
+ * its job; return NULL, if no ready entity was found.
+ */
+static struct drm_sched_entity *
+drm_sched_rq_select_entity_deadline(struct drm_gpu_scheduler *sched,
+				    struct drm_sched_rq *rq)
+{
+	struct drm_sched_entity *entity, *best = NULL;
+	ktime_t best_deadline = KTIME_MAX;
+
+	spin_lock(&rq->lock);
+	list_for_each_entry(entity, &rq->entities, list) {
+		struct spsc_node *node;
+		ktime_t deadline;
+
+		if (!drm_sched_entity_is_ready(entity))
+			continue;
+
+		node = spsc_queue_peek(&entity->job_queue);
+		deadline = drm_sched_job_deadline(to_drm_sched_job(node));
+		if (!best || ktime_before(deadline, best_deadline)) {
+			best = entity;
+			best_deadline = deadline;
+		}
+	}
+
+	if (best) {
+		/* Don't let a less urgent job overtake one that doesn't fit. */
+		if (!drm_sched_can_queue(sched, best)) {
+			spin_unlock(&rq->lock);
+			return ERR_PTR(-ENOSPC);
+		}
+
+		rq->current_entity = best;
+		reinit_completion(&best->entity_idle);
+	}
+	spin_unlock(&rq->lock);
+
+	return best;
+}
+
 /**
  * drm_sched_run_job_queue - enqueue run-job work
  * @sched: scheduler instance
@@ -764,6 +862,9 @@ void drm_sched_resubmit_jobs(struct drm_gpu_scheduler *sched)
 			dma_fence_put(fence);
 		}
 	}
+
+	if (sched->ops->flush_jobs)
+		sched->ops->flush_jobs(sched);
 }
 EXPORT_SYMBOL(drm_sched_resubmit_jobs);
 
@@ -1053,9 +1154,17 @@ drm_sched_select_entity(struct drm_gpu_scheduler *sched)
 	/* Start with the highest priority.
 	 */
 	for (i = DRM_SCHED_PRIORITY_KERNEL; i < sched->num_rqs; i++) {
-		entity = drm_sched_policy == DRM_SCHED_POLICY_FIFO ?
-			drm_sched_rq_select_entity_fifo(sched, sched->sched_rq[i]) :
-			drm_sched_rq_select_entity_rr(sched, sched->sched_rq[i]);
+		switch (drm_sched_policy) {
+		case DRM_SCHED_POLICY_FIFO:
+			entity = drm_sched_rq_select_entity_fifo(sched, sched->sched_rq[i]);
+			break;
+		case DRM_SCHED_POLICY_DEADLINE:
+			entity = drm_sched_rq_select_entity_deadline(sched, sched->sched_rq[i]);
+			break;
+		default:
+			entity = drm_sched_rq_select_entity_rr(sched, sched->sched_rq[i]);
+			break;
+		}
 		if (entity)
 			break;
 	}
@@ -1167,37 +1276,20 @@ static void drm_sched_free_job_work(struct work_struct *w)
 }
 
 /**
- * drm_sched_run_job_work - worker to call run_job
+ * drm_sched_run_one_job - hand a popped job to the backend
  *
- * @w: run job work
+ * @sched: scheduler instance
+ * @entity: the entity @sched_job was popped from
+ * @sched_job: the job to run
  */
-static void drm_sched_run_job_work(struct work_struct *w)
+static void drm_sched_run_one_job(struct drm_gpu_scheduler *sched,
+				  struct drm_sched_entity *entity,
+				  struct drm_sched_job *sched_job)
 {
-	struct drm_gpu_scheduler *sched =
-		container_of(w, struct drm_gpu_scheduler, work_run_job);
-	struct drm_sched_entity *entity;
+	struct drm_sched_fence *s_fence = sched_job->s_fence;
 	struct dma_fence *fence;
-	struct drm_sched_fence *s_fence;
-	struct drm_sched_job *sched_job;
 	int r;
 
-	if (READ_ONCE(sched->pause_submit))
-		return;
-
-	/* Find entity with a ready job */
-	entity = drm_sched_select_entity(sched);
-	if (!entity)
-		return;	/* No more work */
-
-	sched_job = drm_sched_entity_pop_job(entity);
-	if (!sched_job) {
-		complete_all(&entity->entity_idle);
-		drm_sched_run_job_queue(sched);
-		return;
-	}
-
-	s_fence = sched_job->s_fence;
-
 	atomic_add(sched_job->credits, &sched->credit_count);
 	drm_sched_job_begin(sched_job);
 
@@ -1220,9 +1312,56 @@ static void drm_sched_run_job_work(struct work_struct *w)
 		drm_sched_job_done(sched_job, IS_ERR(fence) ?
 				   PTR_ERR(fence) : 0);
 	}
+}
 
-	wake_up(&sched->job_scheduled);
-	drm_sched_run_job_queue(sched);
+/**
+ * drm_sched_run_job_work - worker to call run_job
+ *
+ * @w: run job work
+ *
+ * If the backend implements &drm_sched_backend_ops.flush_jobs, up to
+ * DRM_SCHED_RUN_JOB_BATCH ready jobs are passed to run_job() back to back and
+ * the hardware is kicked once for all of them through flush_jobs().
+ */
+static void drm_sched_run_job_work(struct work_struct *w)
+{
+	struct drm_gpu_scheduler *sched =
+		container_of(w, struct drm_gpu_scheduler, work_run_job);
+	unsigned int batch = sched->ops->flush_jobs ? DRM_SCHED_RUN_JOB_BATCH : 1;
+	struct drm_sched_entity *entity;
+	struct drm_sched_job *sched_job;
+	unsigned int count = 0;
+	bool requeue = false;
+
+	if (READ_ONCE(sched->pause_submit))
+		return;
+
+	while (count < batch) {
+		/* Find entity with a ready job */
+		entity = drm_sched_select_entity(sched);
+		if (!entity)
+			break;	/* No more work */
+
+		sched_job = drm_sched_entity_pop_job(entity);
+		if (!sched_job) {
+			complete_all(&entity->entity_idle);
+			requeue = true;
+			break;
+		}
+
+		drm_sched_run_one_job(sched, entity, sched_job);
+		count++;
+	}
+
+	if (count) {
+		if (sched->ops->flush_jobs)
+			sched->ops->flush_jobs(sched);
+		wake_up(&sched->job_scheduled);
+		requeue = true;
+	}
+
+	if (requeue)
+		drm_sched_run_job_queue(sched);
 }
 
 /**
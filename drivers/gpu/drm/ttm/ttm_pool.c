@@ -65,11 +65,15 @@ module_param(page_pool_size, ulong, 0644);
 
 static atomic_long_t allocated_pages;
 
-static struct ttm_pool_type global_write_combined[NR_PAGE_ORDERS];
-static struct ttm_pool_type global_uncached[NR_PAGE_ORDERS];
+/* The global pools are kept per NUMA node, indexed by [nid][order] */
+static struct ttm_pool_type (*global_write_combined)[NR_PAGE_ORDERS];
+static struct ttm_pool_type (*global_uncached)[NR_PAGE_ORDERS];
 
-static struct ttm_pool_type global_dma32_write_combined[NR_PAGE_ORDERS];
-static struct ttm_pool_type global_dma32_uncached[NR_PAGE_ORDERS];
+static struct ttm_pool_type (*global_dma32_write_combined)[NR_PAGE_ORDERS];
+static struct ttm_pool_type (*global_dma32_uncached)[NR_PAGE_ORDERS];
+
+/* Clears pages given back to the pools in the background */
+static struct workqueue_struct *ttm_pool_wq;
 
 static spinlock_t shrinker_lock;
 static struct list_head shrinker_list;
@@ -221,26 +225,32 @@ static void ttm_pool_unmap(struct ttm_pool *pool, dma_addr_t dma_addr,
 		       DMA_BIDIRECTIONAL);
 }
 
-/* Give pages into a specific pool_type */
-static void ttm_pool_type_give(struct ttm_pool_type *pt, struct page *p)
+/* Clear a single page, which might be highmem */
+static void ttm_pool_clear_page(struct page *p)
 {
-	unsigned int i, num_pages = 1 << pt->order;
-
-	for (i = 0; i < num_pages; ++i) {
-		if (PageHighMem(p))
-			clear_highpage(p + i);
-		else
-			clear_page(page_address(p + i));
-	}
+	if (PageHighMem(p))
+		clear_highpage(p);
+	else
+		clear_page(page_address(p));
+}
 
+/* Give pages into a specific pool_type, they are cleared in the background */
+static void ttm_pool_type_give(struct ttm_pool_type *pt, struct page *p)
+{
 	spin_lock(&pt->lock);
-	list_add(&p->lru, &pt->pages);
+	list_add_tail(&p->lru, &pt->pages);
+	pt->nr_dirty++;
 	spin_unlock(&pt->lock);
 	atomic_long_add(1 << pt->order, &allocated_pages);
+
+	queue_work_node(pt->nid, ttm_pool_wq, &pt->clear_work);
 }
 
-/* Take pages from a specific pool_type, return NULL when nothing available */
-static struct page *ttm_pool_type_take(struct ttm_pool_type *pt)
+/*
+ * Take pages from a specific pool_type without clearing them, return NULL
+ * when nothing available. @dirty is set if the page still needs clearing.
+ */
+static struct page *__ttm_pool_type_take(struct ttm_pool_type *pt, bool *dirty)
 {
 	struct page *p;
 
@@ -249,21 +259,92 @@ static struct page *ttm_pool_type_take(struct ttm_pool_type *pt)
 	if (p) {
 		atomic_long_sub(1 << pt->order, &allocated_pages);
 		list_del(&p->lru);
+		pt->taken++;
+
+		/* Cleared pages are at the head, so only take a dirty one
+		 * when there are no clean pages left.
+		 */
+		*dirty = !pt->nr_clean;
+		if (*dirty)
+			pt->nr_dirty--;
+		else
+			pt->nr_clean--;
 	}
 	spin_unlock(&pt->lock);
 
 	return p;
 }
 
+/* Take cleared pages from a specific pool_type, NULL when nothing available */
+static struct page *ttm_pool_type_take(struct ttm_pool_type *pt)
+{
+	unsigned int i;
+	struct page *p;
+	bool dirty;
+
+	p = __ttm_pool_type_take(pt, &dirty);
+	if (p && dirty) {
+		for (i = 0; i < 1 << pt->order; ++i)
+			ttm_pool_clear_page(p + i);
+	}
+
+	return p;
+}
+
+/*
+ * Clear the dirty pages of a pool_type in the background and move them to
+ * the head of the list.
+ *
+ * Only one page is cleared per lock hold to keep the latency for concurrent
+ * takers low. A page which is half way cleared stays on the list; should it
+ * be taken in the meantime (which @taken tells us) the taker clears it fully
+ * and we start over with the next one.
+ */
+static void ttm_pool_type_clear_work(struct work_struct *work)
+{
+	struct ttm_pool_type *pt = container_of(work, typeof(*pt), clear_work);
+	unsigned int i = 0, num_pages = 1 << pt->order;
+	unsigned long taken = 0;
+	struct page *p = NULL;
+
+	spin_lock(&pt->lock);
+	while (pt->nr_dirty) {
+		if (!p || pt->taken != taken) {
+			p = list_last_entry(&pt->pages, typeof(*p), lru);
+			taken = pt->taken;
+			i = 0;
+		}
+
+		ttm_pool_clear_page(p + i);
+		if (++i == num_pages) {
+			list_move(&p->lru, &pt->pages);
+			pt->nr_dirty--;
+			pt->nr_clean++;
+			p = NULL;
+		}
+
+		spin_unlock(&pt->lock);
+		cond_resched();
+		spin_lock(&pt->lock);
+	}
+	spin_unlock(&pt->lock);
+}
+
 /* Initialize and add a pool type to the global shrinker list */
 static void ttm_pool_type_init(struct ttm_pool_type *pt, struct ttm_pool *pool,
-			       enum ttm_caching caching, unsigned int order)
+			       enum ttm_caching caching, unsigned int order,
+			       int nid)
 {
 	pt->pool = pool;
 	pt->caching = caching;
 	pt->order = order;
+	pt->nid = nid;
 	spin_lock_init(&pt->lock);
 	INIT_LIST_HEAD(&pt->pages);
+	pt->nr_clean = 0;
+	pt->nr_dirty = 0;
+	pt->taken = 0;
+	INIT_WORK(&pt->clear_work, ttm_pool_type_clear_work);
 
 	spin_lock(&shrinker_lock);
 	list_add_tail(&pt->shrinker_list, &shrinker_list);
@@ -274,41 +355,49 @@ static void ttm_pool_type_init(struct ttm_pool_type *pt, struct ttm_pool *pool,
 static void ttm_pool_type_fini(struct ttm_pool_type *pt)
 {
 	struct page *p;
+	bool dirty;
 
 	spin_lock(&shrinker_lock);
 	list_del(&pt->shrinker_list);
 	spin_unlock(&shrinker_lock);
 
-	while ((p = ttm_pool_type_take(pt)))
+	cancel_work_sync(&pt->clear_work);
+	while ((p = __ttm_pool_type_take(pt, &dirty)))
 		ttm_pool_free_page(pt->pool, pt->caching, pt->order, p);
 }
 
-/* Return the pool_type to use for the given caching and order */
+/*
+ * Return the pool_type to use for the given caching and order. @nid selects
+ * between the per node global pools and is ignored for the pools of devices.
+ */
 static struct ttm_pool_type *ttm_pool_select_type(struct ttm_pool *pool,
 						  enum ttm_caching caching,
-						  unsigned int order)
+						  unsigned int order, int nid)
 {
 	if (pool->use_dma_alloc)
 		return &pool->caching[caching].orders[order];
 
 #ifdef CONFIG_X86
+	if (nid == NUMA_NO_NODE)
+		nid = numa_node_id();
+
 	switch (caching) {
 	case ttm_write_combined:
 		if (pool->nid != NUMA_NO_NODE)
 			return &pool->caching[caching].orders[order];
 
 		if (pool->use_dma32)
-			return &global_dma32_write_combined[order];
+			return &global_dma32_write_combined[nid][order];
 
-		return &global_write_combined[order];
+		return &global_write_combined[nid][order];
 	case ttm_uncached:
 		if (pool->nid != NUMA_NO_NODE)
 			return &pool->caching[caching].orders[order];
 
 		if (pool->use_dma32)
-			return &global_dma32_uncached[order];
+			return &global_dma32_uncached[nid][order];
 
-		return &global_uncached[order];
+		return &global_uncached[nid][order];
 	default:
 		break;
 	}
@@ -317,12 +406,39 @@ static struct ttm_pool_type *ttm_pool_select_type(struct ttm_pool *pool,
 	return NULL;
 }
 
+/*
+ * Return the pool_type to take pages from. For the global pools that is the
+ * one of the local node, or, if that is empty, the first other node which has
+ * pages: remote pages with the right caching are still a lot cheaper than
+ * changing the caching of fresh ones.
+ */
+static struct ttm_pool_type *ttm_pool_select_take_type(struct ttm_pool *pool,
+						       enum ttm_caching caching,
+						       unsigned int order)
+{
+	struct ttm_pool_type *pt, *other;
+	int nid;
+
+	pt = ttm_pool_select_type(pool, caching, order, NUMA_NO_NODE);
+	if (!pt || pt->pool || !list_empty(&pt->pages))
+		return pt;
+
+	for_each_node_state(nid, N_MEMORY) {
+		other = ttm_pool_select_type(pool, caching, order, nid);
+		if (!list_empty(&other->pages))
+			return other;
+	}
+
+	return pt;
+}
+
 /* Free pages using the global shrinker list */
 static unsigned int ttm_pool_shrink(void)
 {
 	struct ttm_pool_type *pt;
 	unsigned int num_pages;
 	struct page *p;
+	bool dirty;
 
 	down_read(&pool_shrink_rwsem);
 	spin_lock(&shrinker_lock);
@@ -330,7 +446,7 @@ static unsigned int ttm_pool_shrink(void)
 	list_move_tail(&pt->shrinker_list, &shrinker_list);
 	spin_unlock(&shrinker_lock);
 
-	p = ttm_pool_type_take(pt);
+	p = __ttm_pool_type_take(pt, &dirty);
 	if (p) {
 		ttm_pool_free_page(pt->pool, pt->caching, pt->order, p);
 		num_pages = 1 << pt->order;
@@ -405,7 +521,8 @@ static void ttm_pool_free_range(struct ttm_pool *pool, struct ttm_tt *tt,
 		if (tt->dma_address)
 			ttm_pool_unmap(pool, tt->dma_address[i], nr);
 
-		pt = ttm_pool_select_type(pool, caching, order);
+		pt = ttm_pool_select_type(pool, caching, order,
+					  page_to_nid(*pages));
 		if (pt)
 			ttm_pool_type_give(pt, *pages);
 		else
@@ -459,7 +576,7 @@ int ttm_pool_alloc(struct ttm_pool *pool, struct ttm_tt *tt,
 		struct ttm_pool_type *pt;
 
 		page_caching = tt->caching;
-		pt = ttm_pool_select_type(pool, tt->caching, order);
+		pt = ttm_pool_select_take_type(pool, tt->caching, order);
 		p = pt ? ttm_pool_type_take(pt) : NULL;
 		if (p) {
 			r = ttm_pool_apply_caching(caching, pages,
@@ -577,11 +694,11 @@ void ttm_pool_init(struct ttm_pool *pool, struct device *dev,
 			struct ttm_pool_type *pt;
 
 			/* Initialize only pool types which are actually used */
-			pt = ttm_pool_select_type(pool, i, j);
+			pt = ttm_pool_select_type(pool, i, j, nid);
 			if (pt != &pool->caching[i].orders[j])
 				continue;
 
-			ttm_pool_type_init(pt, pool, i, j);
+			ttm_pool_type_init(pt, pool, i, j, nid);
 		}
 	}
 }
@@ -615,7 +732,7 @@ void ttm_pool_fini(struct ttm_pool *pool)
 		for (j = 0; j < NR_PAGE_ORDERS; ++j) {
 			struct ttm_pool_type *pt;
 
-			pt = ttm_pool_select_type(pool, i, j);
+			pt = ttm_pool_select_type(pool, i, j, pool->nid);
 			if (pt != &pool->caching[i].orders[j])
 				continue;
 
@@ -700,17 +817,21 @@ static void ttm_pool_debugfs_footer(struct seq_file *m)
 /* Dump the information for the global pools */
 static int ttm_pool_debugfs_globals_show(struct seq_file *m, void *data)
 {
+	int nid;
+
 	ttm_pool_debugfs_header(m);
 
 	spin_lock(&shrinker_lock);
-	seq_puts(m, "wc\t:");
-	ttm_pool_debugfs_orders(global_write_combined, m);
-	seq_puts(m, "uc\t:");
-	ttm_pool_debugfs_orders(global_uncached, m);
-	seq_puts(m, "wc 32\t:");
-	ttm_pool_debugfs_orders(global_dma32_write_combined, m);
-	seq_puts(m, "uc 32\t:");
-	ttm_pool_debugfs_orders(global_dma32_uncached, m);
+	for_each_node_state(nid, N_MEMORY) {
+		seq_printf(m, "wc N%d\t:", nid);
+		ttm_pool_debugfs_orders(global_write_combined[nid], m);
+		seq_printf(m, "uc N%d\t:", nid);
+		ttm_pool_debugfs_orders(global_uncached[nid], m);
+		seq_printf(m, "wc32 N%d:", nid);
+		ttm_pool_debugfs_orders(global_dma32_write_combined[nid], m);
+		seq_printf(m, "uc32 N%d:", nid);
+		ttm_pool_debugfs_orders(global_dma32_uncached[nid], m);
+	}
 	spin_unlock(&shrinker_lock);
 
 	ttm_pool_debugfs_footer(m);
@@ -777,6 +898,29 @@ DEFINE_SHOW_ATTRIBUTE(ttm_pool_debugfs_shrink);
 
 #endif
 
+/* Free the pages in and the memory of the global pools */
+static void ttm_pool_mgr_fini_globals(void)
+{
+	unsigned int i;
+	int nid;
+
+	for_each_node(nid) {
+		for (i = 0; i < NR_PAGE_ORDERS; ++i) {
+			ttm_pool_type_fini(&global_write_combined[nid][i]);
+			ttm_pool_type_fini(&global_uncached[nid][i]);
+
+			ttm_pool_type_fini(&global_dma32_write_combined[nid][i]);
+			ttm_pool_type_fini(&global_dma32_uncached[nid][i]);
+		}
+	}
+
+	kfree(global_write_combined);
+	kfree(global_uncached);
+	kfree(global_dma32_write_combined);
+	kfree(global_dma32_uncached);
+	destroy_workqueue(ttm_pool_wq);
+}
+
 /**
  * ttm_pool_mgr_init - Initialize globals
  *
@@ -787,6 +931,7 @@ DEFINE_SHOW_ATTRIBUTE(ttm_pool_debugfs_shrink);
 int ttm_pool_mgr_init(unsigned long num_pages)
 {
 	unsigned int i;
+	int nid;
 
 	if (!page_pool_size)
 		page_pool_size = num_pages;
@@ -794,15 +939,37 @@ int ttm_pool_mgr_init(unsigned long num_pages)
 	spin_lock_init(&shrinker_lock);
 	INIT_LIST_HEAD(&shrinker_list);
 
-	for (i = 0; i < NR_PAGE_ORDERS; ++i) {
-		ttm_pool_type_init(&global_write_combined[i], NULL,
-				   ttm_write_combined, i);
-		ttm_pool_type_init(&global_uncached[i], NULL, ttm_uncached, i);
+	ttm_pool_wq = alloc_workqueue("ttm_pool", WQ_UNBOUND, 0);
+	if (!ttm_pool_wq)
+		return -ENOMEM;
+
+	global_write_combined = kcalloc(nr_node_ids,
+					sizeof(*global_write_combined),
+					GFP_KERNEL);
+	global_uncached = kcalloc(nr_node_ids, sizeof(*global_uncached),
+				  GFP_KERNEL);
+	global_dma32_write_combined =
+		kcalloc(nr_node_ids, sizeof(*global_dma32_write_combined),
+			GFP_KERNEL);
+	global_dma32_uncached = kcalloc(nr_node_ids,
+					sizeof(*global_dma32_uncached),
+					GFP_KERNEL);
+	if (!global_write_combined || !global_uncached ||
+	    !global_dma32_write_combined || !global_dma32_uncached)
+		goto error_free;
 
-		ttm_pool_type_init(&global_dma32_write_combined[i], NULL,
-				   ttm_write_combined, i);
-		ttm_pool_type_init(&global_dma32_uncached[i], NULL,
-				   ttm_uncached, i);
+	for_each_node(nid) {
+		for (i = 0; i < NR_PAGE_ORDERS; ++i) {
+			ttm_pool_type_init(&global_write_combined[nid][i], NULL,
+					   ttm_write_combined, i, nid);
+			ttm_pool_type_init(&global_uncached[nid][i], NULL,
+					   ttm_uncached, i, nid);
+
+			ttm_pool_type_init(&global_dma32_write_combined[nid][i],
+					   NULL, ttm_write_combined, i, nid);
+			ttm_pool_type_init(&global_dma32_uncached[nid][i], NULL,
+					   ttm_uncached, i, nid);
+		}
 	}
 
 #ifdef CONFIG_DEBUG_FS
@@ -813,8 +980,10 @@ int ttm_pool_mgr_init(unsigned long num_pages)
 #endif
 
 	mm_shrinker = shrinker_alloc(0, "drm-ttm_pool");
-	if (!mm_shrinker)
+	if (!mm_shrinker) {
+		ttm_pool_mgr_fini_globals();
 		return -ENOMEM;
+	}
 
 	mm_shrinker->count_objects = ttm_pool_shrinker_count;
 	mm_shrinker->scan_objects = ttm_pool_shrinker_scan;
@@ -823,6 +992,14 @@ int ttm_pool_mgr_init(unsigned long num_pages)
 	shrinker_register(mm_shrinker);
 
 	return 0;
+
+error_free:
+	kfree(global_write_combined);
+	kfree(global_uncached);
+	kfree(global_dma32_write_combined);
+	kfree(global_dma32_uncached);
+	destroy_workqueue(ttm_pool_wq);
+	return -ENOMEM;
 }
 
 /**
@@ -832,16 +1009,7 @@ int ttm_pool_mgr_init(unsigned long num_pages)
  */
 void ttm_pool_mgr_fini(void)
 {
-	unsigned int i;
-
-	for (i = 0; i < NR_PAGE_ORDERS; ++i) {
-		ttm_pool_type_fini(&global_write_combined[i]);
-		ttm_pool_type_fini(&global_uncached[i]);
-
-		ttm_pool_type_fini(&global_dma32_write_combined[i]);
-		ttm_pool_type_fini(&global_dma32_uncached[i]);
-	}
-
 	shrinker_free(mm_shrinker);
+	ttm_pool_mgr_fini_globals();
 	WARN_ON(!list_empty(&shrinker_list));
 }
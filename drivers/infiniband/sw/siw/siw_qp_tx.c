@@ -309,52 +309,57 @@ static int siw_tx_ctrl(struct siw_iwarp_tx *c_tx, struct socket *s,
  * 0copy TCP transmit interface: Use MSG_SPLICE_PAGES.
  *
  * Using sendpage to push page by page appears to be less efficient
- * than using sendmsg, even if data are copied.
+ * than using sendmsg, even if data are copied. All pages are hence
+ * handed to TCP as one bvec array under a single socket lock.
  *
  * A general performance limitation might be the extra four bytes
  * trailer checksum segment to be pushed after user data.
  */
+#define SIW_SENDPAGES_MAX ((0xffff / PAGE_SIZE) + 2)
+
 static int siw_tcp_sendpages(struct socket *s, struct page **page, int offset,
 			     size_t size)
 {
-	struct bio_vec bvec;
+	struct bio_vec bvec[SIW_SENDPAGES_MAX];
 	struct msghdr msg = {
-		.msg_flags = (MSG_MORE | MSG_DONTWAIT | MSG_SPLICE_PAGES),
+		.msg_flags = (MSG_DONTWAIT | MSG_SPLICE_PAGES),
 	};
 	struct sock *sk = s->sk;
 	int i = 0, rv = 0, sent = 0;
 
+	lock_sock(sk);
 	while (size) {
-		size_t bytes = min_t(size_t, PAGE_SIZE - offset, size);
-
-		if (size + offset <= PAGE_SIZE)
-			msg.msg_flags &= ~MSG_MORE;
-
-		tcp_rate_check_app_limited(sk);
-		bvec_set_page(&bvec, page[i], bytes, offset);
-		iov_iter_bvec(&msg.msg_iter, ITER_SOURCE, &bvec, 1, size);
+		size_t len = 0;
+		int nr = 0;
 
-try_page_again:
-		lock_sock(sk);
-		rv = tcp_sendmsg_locked(sk, &msg, size);
-		release_sock(sk);
+		while (size - len && nr < SIW_SENDPAGES_MAX) {
+			size_t bytes = min_t(size_t, PAGE_SIZE - offset,
+					     size - len);
 
-		if (rv > 0) {
+			bvec_set_page(&bvec[nr++], page[i++], bytes, offset);
+			len += bytes;
+			offset = 0;
+		}
+		msg.msg_flags &= ~MSG_MORE;
+		if (len < size)
+			msg.msg_flags |= MSG_MORE;
+		iov_iter_bvec(&msg.msg_iter, ITER_SOURCE, bvec, nr, len);
+
+		while (len) {
+			tcp_rate_check_app_limited(sk);
+			rv = tcp_sendmsg_locked(sk, &msg, len);
+			if (rv <= 0)
+				goto out;
+			len -= rv;
 			size -= rv;
 			sent += rv;
-			if (rv != bytes) {
-				offset += rv;
-				bytes -= rv;
-				goto try_page_again;
-			}
-			offset = 0;
-		} else {
-			if (rv == -EAGAIN || rv == 0)
-				break;
-			return rv;
 		}
-		i++;
 	}
+out:
+	release_sock(sk);
+
+	if (rv < 0 && rv != -EAGAIN)
+		return rv;
 	return sent;
 }
 
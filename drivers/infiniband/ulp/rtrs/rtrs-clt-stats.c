@@ -178,7 +178,7 @@ void rtrs_clt_update_all_stats(struct rtrs_clt_io_req *req, int dir)
 
 	len = req->usr_len + req->data_len;
 	rtrs_clt_update_rdma_stats(stats, len, dir);
-	if (req->mp_policy == MP_POLICY_MIN_INFLIGHT)
+	if (rtrs_clt_policy_counts_inflight(req->mp_policy))
 		atomic_inc(&stats->inflight);
 }
 
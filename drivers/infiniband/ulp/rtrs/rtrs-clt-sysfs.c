@@ -106,6 +106,9 @@ static ssize_t mpath_policy_show(struct device *dev,
 	case MP_POLICY_MIN_LATENCY:
 		return sysfs_emit(page, "min-latency (ML: %d)\n",
 				  clt->mp_policy);
+	case MP_POLICY_MIN_IO_LATENCY:
+		return sysfs_emit(page, "min-io-latency (MIL: %d)\n",
+				  clt->mp_policy);
 	default:
 		return sysfs_emit(page, "Unknown (%d)\n", clt->mp_policy);
 	}
@@ -126,7 +129,8 @@ static ssize_t mpath_policy_store(struct device *dev,
 	ret = kstrtoint(buf, 10, &value);
 	if (!ret && (value == MP_POLICY_RR ||
 		     value == MP_POLICY_MIN_INFLIGHT ||
-		     value == MP_POLICY_MIN_LATENCY)) {
+		     value == MP_POLICY_MIN_LATENCY ||
+		     value == MP_POLICY_MIN_IO_LATENCY)) {
 		clt->mp_policy = value;
 		return count;
 	}
@@ -145,6 +149,9 @@ static ssize_t mpath_policy_store(struct device *dev,
 	else if (!strncasecmp(buf, "min-latency", 11) ||
 		 (len == 2 && !strncasecmp(buf, "ml", 2)))
 		clt->mp_policy = MP_POLICY_MIN_LATENCY;
+	else if (!strncasecmp(buf, "min-io-latency", 14) ||
+		 (len == 3 && !strncasecmp(buf, "mil", 3)))
+		clt->mp_policy = MP_POLICY_MIN_IO_LATENCY;
 	else
 		return -EINVAL;
 
@@ -373,6 +380,21 @@ static ssize_t rtrs_clt_cur_latency_show(struct kobject *kobj,
 static struct kobj_attribute rtrs_clt_cur_latency_attr =
 	__ATTR(cur_latency, 0444, rtrs_clt_cur_latency_show, NULL);
 
+static ssize_t rtrs_clt_io_latency_show(struct kobject *kobj,
+					struct kobj_attribute *attr,
+					char *page)
+{
+	struct rtrs_clt_path *clt_path;
+
+	clt_path = container_of(kobj, struct rtrs_clt_path, kobj);
+
+	return sysfs_emit(page, "%llu ns\n",
+			  READ_ONCE(clt_path->io_latency_ns));
+}
+
+static struct kobj_attribute rtrs_clt_io_latency_attr =
+	__ATTR(io_latency, 0444, rtrs_clt_io_latency_show, NULL);
+
 static ssize_t rtrs_clt_src_addr_show(struct kobject *kobj,
 				       struct kobj_attribute *attr,
 				       char *page)
@@ -417,6 +439,7 @@ static struct attribute *rtrs_clt_path_attrs[] = {
 	&rtrs_clt_disconnect_attr.attr,
 	&rtrs_clt_remove_path_attr.attr,
 	&rtrs_clt_cur_latency_attr.attr,
+	&rtrs_clt_io_latency_attr.attr,
 	NULL,
 };
 
@@ -39,6 +39,11 @@
 MODULE_DESCRIPTION("RDMA Transport Client");
 MODULE_LICENSE("GPL");
 
+static bool inline_reads;
+module_param(inline_reads, bool, 0444);
+MODULE_PARM_DESC(inline_reads,
+		 "Receive reads of up to 4K into a buffer registered once per request, avoiding per IO memory registration and invalidation (default: false)");
+
 static const struct rtrs_rdma_dev_pd_ops dev_pd_ops;
 static struct rtrs_rdma_dev_pd dev_pd = {
 	.ops = &dev_pd_ops
@@ -377,6 +382,35 @@ static int rtrs_inv_rkey(struct rtrs_clt_io_req *req)
 	return ib_post_send(con->c.qp, &wr, NULL);
 }
 
+/*
+ * Same 1/8 gain as TCP's smoothed RTT, updated without locking: an
+ * occasionally lost sample doesn't matter for path selection.
+ */
+static void rtrs_clt_update_io_latency(struct rtrs_clt_path *clt_path,
+				       struct rtrs_clt_io_req *req)
+{
+	u64 sample = ktime_to_ns(ktime_sub(ktime_get(), req->start_time));
+	u64 srtt = READ_ONCE(clt_path->io_latency_ns);
+
+	if (srtt)
+		srtt = srtt - (srtt >> 3) + (sample >> 3);
+	else
+		srtt = sample;
+	WRITE_ONCE(clt_path->io_latency_ns, srtt);
+}
+
+static void rtrs_clt_inline_read_done(struct rtrs_clt_path *clt_path,
+				      struct rtrs_clt_io_req *req)
+{
+	struct rtrs_iu *iu = req->inline_iu;
+
+	ib_dma_sync_single_for_cpu(clt_path->s.dev->ib_dev, iu->dma_addr,
+				   req->data_len, DMA_FROM_DEVICE);
+	sg_copy_from_buffer(req->sglist, req->sg_cnt, iu->buf, req->data_len);
+	ib_dma_sync_single_for_device(clt_path->s.dev->ib_dev, iu->dma_addr,
+				      req->data_len, DMA_FROM_DEVICE);
+}
+
 static void complete_rdma_req(struct rtrs_clt_io_req *req, int errno,
 			      bool notify, bool can_wait)
 {
@@ -390,7 +424,10 @@ static void complete_rdma_req(struct rtrs_clt_io_req *req, int errno,
 		return;
 	clt_path = to_clt_path(con->c.path);
 
-	if (req->sg_cnt) {
+	if (req->inline_read) {
+		if (!errno)
+			rtrs_clt_inline_read_done(clt_path, req);
+	} else if (req->sg_cnt) {
 		if (req->dir == DMA_FROM_DEVICE && req->need_inv) {
 			/*
 			 * We are here to invalidate read requests
@@ -439,8 +476,10 @@ static void complete_rdma_req(struct rtrs_clt_io_req *req, int errno,
 	}
 	if (!refcount_dec_and_test(&req->ref))
 		return;
-	if (req->mp_policy == MP_POLICY_MIN_INFLIGHT)
+	if (rtrs_clt_policy_counts_inflight(req->mp_policy))
 		atomic_dec(&clt_path->stats->inflight);
+	if (req->mp_policy == MP_POLICY_MIN_IO_LATENCY && !errno)
+		rtrs_clt_update_io_latency(clt_path, req);
 
 	req->in_use = false;
 	req->con = NULL;
@@ -902,6 +941,56 @@ static struct rtrs_clt_path *get_next_path_min_latency(struct path_it *it)
 	return min_path;
 }
 
+/**
+ * get_next_path_min_io_latency() - Returns path with the lowest expected
+ * IO completion time.
+ * @it:	the path pointer
+ *
+ * The expected completion time is the smoothed IO latency of a path
+ * scaled by the number of requests already queued on it, so a fast path
+ * is preferred until its backlog makes a slower one the better choice.
+ *
+ * Locks:
+ *    rcu_read_lock() must be hold.
+ *
+ * Related to @MP_POLICY_MIN_IO_LATENCY
+ *
+ * This DOES skip an already-tried path, like get_next_path_min_latency().
+ */
+static struct rtrs_clt_path *get_next_path_min_io_latency(struct path_it *it)
+{
+	struct rtrs_clt_path *min_path = NULL;
+	struct rtrs_clt_sess *clt = it->clt;
+	struct rtrs_clt_path *clt_path;
+	u64 min_cost = U64_MAX;
+	u64 cost;
+
+	list_for_each_entry_rcu(clt_path, &clt->paths_list, s.entry) {
+		if (READ_ONCE(clt_path->state) != RTRS_CLT_CONNECTED)
+			continue;
+
+		if (!list_empty(raw_cpu_ptr(clt_path->mp_skip_entry)))
+			continue;
+
+		cost = READ_ONCE(clt_path->io_latency_ns) *
+		       (atomic_read(&clt_path->stats->inflight) + 1);
+
+		if (cost < min_cost) {
+			min_cost = cost;
+			min_path = clt_path;
+		}
+	}
+
+	/*
+	 * add the path to the skip list, so that next time we can get
+	 * a different one
+	 */
+	if (min_path)
+		list_add(raw_cpu_ptr(min_path->mp_skip_entry), &it->skip_list);
+
+	return min_path;
+}
+
 static inline void path_it_init(struct path_it *it, struct rtrs_clt_sess *clt)
 {
 	INIT_LIST_HEAD(&it->skip_list);
@@ -912,6 +1001,8 @@ static inline void path_it_init(struct path_it *it, struct rtrs_clt_sess *clt)
 		it->next_path = get_next_path_rr;
 	else if (clt->mp_policy == MP_POLICY_MIN_INFLIGHT)
 		it->next_path = get_next_path_min_inflight;
+	else if (clt->mp_policy == MP_POLICY_MIN_IO_LATENCY)
+		it->next_path = get_next_path_min_io_latency;
 	else
 		it->next_path = get_next_path_min_latency;
 }
@@ -920,7 +1011,8 @@ static inline void path_it_deinit(struct path_it *it)
 {
 	struct list_head *skip, *tmp;
 	/*
-	 * The skip_list is used only for the MIN_INFLIGHT and MIN_LATENCY policies.
+	 * The skip_list is used only for the MIN_INFLIGHT, MIN_LATENCY and
+	 * MIN_IO_LATENCY policies.
 	 * We need to remove paths from it, so that next IO can insert
 	 * paths (->mp_skip_entry) into a skip_list again.
 	 */
@@ -972,6 +1064,9 @@ static void rtrs_clt_init_req(struct rtrs_clt_io_req *req,
 	req->inv_errno = 0;
 	refcount_set(&req->ref, 1);
 	req->mp_policy = clt_path->clt->mp_policy;
+	req->inline_read = false;
+	if (req->mp_policy == MP_POLICY_MIN_IO_LATENCY)
+		req->start_time = ktime_get();
 
 	iov_iter_kvec(&iter, ITER_SOURCE, vec, 1, usr_len);
 	len = _copy_from_iter(req->iu->buf, usr_len, &iter);
@@ -1078,6 +1173,25 @@ static int rtrs_map_sg_fr(struct rtrs_clt_io_req *req, size_t count)
 	return nr;
 }
 
+static int rtrs_map_inline_mr(struct rtrs_clt_io_req *req)
+{
+	struct rtrs_iu *iu = req->inline_iu;
+	struct scatterlist sg;
+	int nr;
+
+	sg_init_table(&sg, 1);
+	sg_dma_address(&sg) = iu->dma_addr;
+	sg_dma_len(&sg) = iu->size;
+
+	nr = ib_map_mr_sg(req->inline_mr, &sg, 1, NULL, SZ_4K);
+	if (nr != 1)
+		return nr < 0 ? nr : -EINVAL;
+	ib_update_fast_reg_key(req->inline_mr,
+			       ib_inc_rkey(req->inline_mr->rkey));
+
+	return nr;
+}
+
 static int rtrs_clt_write_req(struct rtrs_clt_io_req *req)
 {
 	struct rtrs_clt_con *con = req->con;
@@ -1162,7 +1276,7 @@ static int rtrs_clt_write_req(struct rtrs_clt_io_req *req)
 			    "Write request failed: error=%d path=%s [%s:%u]\n",
 			    ret, kobject_name(&clt_path->kobj), clt_path->hca_name,
 			    clt_path->hca_port);
-		if (req->mp_policy == MP_POLICY_MIN_INFLIGHT)
+		if (rtrs_clt_policy_counts_inflight(req->mp_policy))
 			atomic_dec(&clt_path->stats->inflight);
 		if (req->sg_cnt)
 			ib_dma_unmap_sg(clt_path->s.dev->ib_dev, req->sglist,
@@ -1184,6 +1298,7 @@ static int rtrs_clt_read_req(struct rtrs_clt_io_req *req)
 	struct ib_send_wr *wr = NULL;
 
 	int ret, count = 0;
+	bool reg_inline = false;
 	u32 imm, buf_id;
 
 	const size_t tsize = sizeof(*msg) + req->data_len + req->usr_len;
@@ -1195,7 +1310,10 @@ static int rtrs_clt_read_req(struct rtrs_clt_io_req *req)
 		return -EMSGSIZE;
 	}
 
-	if (req->sg_cnt) {
+	req->inline_read = req->sg_cnt && req->inline_iu &&
+			   req->data_len <= RTRS_INLINE_READ_SIZE;
+
+	if (req->sg_cnt && !req->inline_read) {
 		count = ib_dma_map_sg(dev->ib_dev, req->sglist, req->sg_cnt,
 				      req->dir);
 		if (!count) {
@@ -1209,7 +1327,40 @@ static int rtrs_clt_read_req(struct rtrs_clt_io_req *req)
 	msg->type = cpu_to_le16(RTRS_MSG_READ);
 	msg->usr_len = cpu_to_le16(req->usr_len);
 
-	if (count) {
+	if (req->inline_read) {
+		/*
+		 * The server writes straight into the inline buffer.  Its MR
+		 * is registered with the first read that uses it and stays
+		 * valid for the lifetime of the connection, so neither a
+		 * REG_MR nor an invalidation is needed afterwards.
+		 */
+		if (!req->inline_mr_valid) {
+			ret = rtrs_map_inline_mr(req);
+			if (ret < 0) {
+				rtrs_err_rl(s,
+					     "Read request failed, failed to map inline buffer, err: %d\n",
+					     ret);
+				return ret;
+			}
+			rwr = (struct ib_reg_wr) {
+				.wr.opcode = IB_WR_REG_MR,
+				.wr.wr_cqe = &fast_reg_cqe,
+				.mr = req->inline_mr,
+				.key = req->inline_mr->rkey,
+				.access = (IB_ACCESS_LOCAL_WRITE |
+					   IB_ACCESS_REMOTE_WRITE),
+			};
+			wr = &rwr.wr;
+			reg_inline = true;
+		}
+
+		msg->sg_cnt = cpu_to_le16(1);
+		msg->flags = 0;
+
+		msg->desc[0].addr = cpu_to_le64(req->inline_mr->iova);
+		msg->desc[0].key = cpu_to_le32(req->inline_mr->rkey);
+		msg->desc[0].len = cpu_to_le32(req->data_len);
+	} else if (count) {
 		ret = rtrs_map_sg_fr(req, count);
 		if (ret < 0) {
 			rtrs_err_rl(s,
@@ -1268,12 +1419,14 @@ static int rtrs_clt_read_req(struct rtrs_clt_io_req *req)
 			    "Read request failed: error=%d path=%s [%s:%u]\n",
 			    ret, kobject_name(&clt_path->kobj), clt_path->hca_name,
 			    clt_path->hca_port);
-		if (req->mp_policy == MP_POLICY_MIN_INFLIGHT)
+		if (rtrs_clt_policy_counts_inflight(req->mp_policy))
 			atomic_dec(&clt_path->stats->inflight);
 		req->need_inv = false;
-		if (req->sg_cnt)
+		if (count)
 			ib_dma_unmap_sg(dev->ib_dev, req->sglist,
 					req->sg_cnt, req->dir);
+	} else if (reg_inline) {
+		req->inline_mr_valid = true;
 	}
 
 	return ret;
@@ -1355,6 +1508,10 @@ static void free_path_reqs(struct rtrs_clt_path *clt_path)
 		req = &clt_path->reqs[i];
 		if (req->mr)
 			ib_dereg_mr(req->mr);
+		if (req->inline_mr)
+			ib_dereg_mr(req->inline_mr);
+		if (req->inline_iu)
+			rtrs_iu_free(req->inline_iu, clt_path->s.dev->ib_dev, 1);
 		kfree(req->sge);
 		rtrs_iu_free(req->iu, clt_path->s.dev->ib_dev, 1);
 	}
@@ -1398,6 +1555,25 @@ static int alloc_path_reqs(struct rtrs_clt_path *clt_path)
 		}
 
 		init_completion(&req->inv_comp);
+
+		if (!inline_reads)
+			continue;
+
+		req->inline_iu = rtrs_iu_alloc(1, RTRS_INLINE_READ_SIZE,
+					       GFP_KERNEL,
+					       clt_path->s.dev->ib_dev,
+					       DMA_FROM_DEVICE, NULL);
+		if (!req->inline_iu)
+			goto out;
+
+		req->inline_mr = ib_alloc_mr(clt_path->s.dev->ib_pd,
+					     IB_MR_TYPE_MEM_REG,
+					     RTRS_INLINE_READ_SIZE / SZ_4K);
+		if (IS_ERR(req->inline_mr)) {
+			err = PTR_ERR(req->inline_mr);
+			req->inline_mr = NULL;
+			goto out;
+		}
 	}
 
 	return 0;
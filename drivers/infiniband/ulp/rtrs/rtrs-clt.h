@@ -30,8 +30,12 @@ enum rtrs_mp_policy {
 	MP_POLICY_RR,
 	MP_POLICY_MIN_INFLIGHT,
 	MP_POLICY_MIN_LATENCY,
+	MP_POLICY_MIN_IO_LATENCY,
 };
 
+/* Reads up to this size can go through the per-request inline buffer */
+#define RTRS_INLINE_READ_SIZE	SZ_4K
+
 /* see Documentation/ABI/testing/sysfs-class-rtrs-client for details */
 struct rtrs_clt_stats_reconnects {
 	int successful_cnt;
@@ -117,6 +121,13 @@ struct rtrs_clt_io_req {
 	bool			need_inv_comp;
 	bool			need_inv;
 	refcount_t		ref;
+
+	/* preregistered buffer for small reads, see inline_reads */
+	struct rtrs_iu		*inline_iu;
+	struct ib_mr		*inline_mr;
+	bool			inline_mr_valid;
+	bool			inline_read;
+	ktime_t			start_time;
 };
 
 struct rtrs_rbuf {
@@ -147,6 +158,8 @@ struct rtrs_clt_path {
 	struct kobject		kobj;
 	u8			for_new_clt;
 	struct rtrs_clt_stats	*stats;
+	/* smoothed IO completion time, for MP_POLICY_MIN_IO_LATENCY */
+	u64			io_latency_ns;
 	/* cache hca_port and hca_name to display in sysfs */
 	u8			hca_port;
 	char                    hca_name[IB_DEVICE_NAME_MAX];
@@ -182,6 +195,12 @@ struct rtrs_clt_sess {
 	enum rtrs_mp_policy	mp_policy;
 };
 
+static inline bool rtrs_clt_policy_counts_inflight(enum rtrs_mp_policy policy)
+{
+	return policy == MP_POLICY_MIN_INFLIGHT ||
+	       policy == MP_POLICY_MIN_IO_LATENCY;
+}
+
 static inline struct rtrs_clt_con *to_clt_con(struct rtrs_con *c)
 {
 	return container_of(c, struct rtrs_clt_con, c);
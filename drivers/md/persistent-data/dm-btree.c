@@ -194,13 +194,23 @@ static int unprocessed_frames(struct del_stack *s)
 	return s->top >= 0;
 }
 
-static void prefetch_children(struct del_stack *s, struct frame *f)
+/*
+ * Issue reads for all children of an internal node so they come in
+ * parallel from the device rather than one at a time as they are visited.
+ */
+static void prefetch_node_children(struct dm_transaction_manager *tm,
+				   struct btree_node *n)
 {
-	unsigned int i;
-	struct dm_block_manager *bm = dm_tm_get_bm(s->tm);
+	unsigned int i, nr = le32_to_cpu(n->header.nr_entries);
+	struct dm_block_manager *bm = dm_tm_get_bm(tm);
 
-	for (i = 0; i < f->nr_children; i++)
-		dm_bm_prefetch(bm, value64(f->n, i));
+	for (i = 0; i < nr; i++)
+		dm_bm_prefetch(bm, value64(n, i));
+}
+
+static void prefetch_children(struct del_stack *s, struct frame *f)
+{
+	prefetch_node_children(s->tm, f->n);
 }
 
 static bool is_internal_level(struct dm_btree_info *info, struct frame *f)
@@ -446,6 +456,10 @@ static int dm_btree_lookup_next_single(struct dm_btree_info *info, dm_block_t ro
 			goto out;
 		}
 
+		/* Have the sibling on its way in case the key isn't in child i. */
+		if (i < (nr_entries - 1))
+			dm_bm_prefetch(dm_tm_get_bm(info->tm), value64(n, i + 1));
+
 		r = dm_btree_lookup_next_single(info, value64(n, i), key, rkey, value_le);
 		if (r == -ENODATA && i < (nr_entries - 1)) {
 			i++;
@@ -1231,64 +1245,72 @@ static bool need_insert(struct btree_node *node, uint64_t *keys,
 		(le64_to_cpu(node->keys[index]) != keys[level]));
 }
 
-static int insert(struct dm_btree_info *info, dm_block_t root,
-		  uint64_t *keys, void *value, dm_block_t *new_root,
-		  int *inserted)
-		  __dm_written_to_disk(value)
+/*
+ * Walks the spine for an insert of the given keys, creating any missing
+ * sub trees.  On success the bottom level leaf that 'key' belongs in is
+ * the current node of the spine and *index is the slot for it.
+ */
+static int btree_insert_spine(struct shadow_spine *spine,
+			      struct dm_btree_info *info, dm_block_t root,
+			      uint64_t *keys, uint64_t key, unsigned int *index)
 {
 	int r;
-	unsigned int level, index = -1, last_level = info->levels - 1;
+	unsigned int level, last_level = info->levels - 1;
 	dm_block_t block = root;
-	struct shadow_spine spine;
 	struct btree_node *n;
 	struct dm_btree_value_type le64_type;
 
 	init_le64_type(info->tm, &le64_type);
-	init_shadow_spine(&spine, info);
+	*index = -1;
 
-	for (level = 0; level < (info->levels - 1); level++) {
-		r = btree_insert_raw(&spine, block, &le64_type, keys[level], &index);
+	for (level = 0; level < last_level; level++) {
+		r = btree_insert_raw(spine, block, &le64_type, keys[level], index);
 		if (r < 0)
-			goto bad;
+			return r;
 
-		n = dm_block_data(shadow_current(&spine));
+		n = dm_block_data(shadow_current(spine));
 
-		if (need_insert(n, keys, level, index)) {
+		if (need_insert(n, keys, level, *index)) {
 			dm_block_t new_tree;
 			__le64 new_le;
 
 			r = dm_btree_empty(info, &new_tree);
 			if (r < 0)
-				goto bad;
+				return r;
 
 			new_le = cpu_to_le64(new_tree);
 			__dm_bless_for_disk(&new_le);
 
-			r = insert_at(sizeof(uint64_t), n, index,
+			r = insert_at(sizeof(uint64_t), n, *index,
 				      keys[level], &new_le);
 			if (r)
-				goto bad;
+				return r;
 		}
 
-		if (level < last_level)
-			block = value64(n, index);
+		block = value64(n, *index);
 	}
 
-	r = btree_insert_raw(&spine, block, &info->value_type,
-			     keys[level], &index);
-	if (r < 0)
-		goto bad;
+	return btree_insert_raw(spine, block, &info->value_type, key, index);
+}
 
-	n = dm_block_data(shadow_current(&spine));
+/*
+ * Puts a value into slot 'index' of a leaf returned by
+ * btree_insert_spine(), overwriting any existing value for the key.
+ */
+static int insert_value(struct dm_btree_info *info, struct btree_node *n,
+			unsigned int index, uint64_t key, void *value,
+			int *inserted)
+	__dm_written_to_disk(value)
+{
+	int r;
 
-	if (need_insert(n, keys, level, index)) {
+	if (need_insert(n, &key, 0, index)) {
 		if (inserted)
 			*inserted = 1;
 
-		r = insert_at(info->value_type.size, n, index,
-			      keys[level], value);
+		r = insert_at(info->value_type.size, n, index, key, value);
 		if (r)
-			goto bad_unblessed;
+			return r;
 	} else {
 		if (inserted)
 			*inserted = 0;
@@ -1306,6 +1328,30 @@ static int insert(struct dm_btree_info *info, dm_block_t root,
 			    value, info->value_type.size);
 	}
 
+	return 0;
+}
+
+static int insert(struct dm_btree_info *info, dm_block_t root,
+		  uint64_t *keys, void *value, dm_block_t *new_root,
+		  int *inserted)
+		  __dm_written_to_disk(value)
+{
+	int r;
+	unsigned int index;
+	struct shadow_spine spine;
+
+	init_shadow_spine(&spine, info);
+
+	r = btree_insert_spine(&spine, info, root, keys,
+			       keys[info->levels - 1], &index);
+	if (r < 0)
+		goto bad;
+
+	r = insert_value(info, dm_block_data(shadow_current(&spine)), index,
+			 keys[info->levels - 1], value, inserted);
+	if (r)
+		goto bad_unblessed;
+
 	*new_root = shadow_root(&spine);
 	exit_shadow_spine(&spine);
 
@@ -1335,6 +1381,202 @@ int dm_btree_insert_notify(struct dm_btree_info *info, dm_block_t root,
 }
 EXPORT_SYMBOL_GPL(dm_btree_insert_notify);
 
+/*
+ * After an insert the leaf it went into is still write locked at the top
+ * of the spine.  A following, larger key can go straight into that leaf,
+ * without walking down from the root again, if there's room for it and
+ * it is known to route to the same leaf.
+ */
+static bool leaf_takes_key(struct shadow_spine *s, uint64_t key)
+{
+	struct btree_node *leaf = dm_block_data(shadow_current(s));
+	uint32_t nr_entries = le32_to_cpu(leaf->header.nr_entries);
+	struct btree_node *parent;
+	int i;
+
+	if (!has_space_for_insert(leaf, key))
+		return false;
+
+	if (nr_entries && key <= le64_to_cpu(leaf->keys[nr_entries - 1]))
+		return true;
+
+	/* The leaf is the root of the bottom level tree. */
+	if (!shadow_has_parent(s))
+		return true;
+
+	parent = dm_block_data(shadow_parent(s));
+	if (le32_to_cpu(parent->header.flags) & LEAF_NODE)
+		return true;
+
+	/*
+	 * For the last child of the parent we don't know the upper bound
+	 * of the key range, so leave it to a full walk.
+	 */
+	i = lower_bound(parent, key);
+	return i >= 0 && i + 1 < le32_to_cpu(parent->header.nr_entries) &&
+		value64(parent, i) == dm_block_location(shadow_current(s));
+}
+
+static bool keys_ascending(uint64_t *keys, unsigned int count)
+{
+	unsigned int i;
+
+	for (i = 1; i < count; i++)
+		if (keys[i] <= keys[i - 1])
+			return false;
+
+	return true;
+}
+
+int dm_btree_insert_batch(struct dm_btree_info *info, dm_block_t root,
+			  uint64_t *keys, uint64_t *bottom_keys, void *values,
+			  unsigned int count, dm_block_t *new_root,
+			  unsigned int *nr_inserted)
+	__dm_written_to_disk(values)
+{
+	int r = 0, inserted, slot;
+	unsigned int i = 0, index;
+	size_t value_size = info->value_type.size;
+	struct shadow_spine spine;
+	struct btree_node *n;
+
+	if (!keys_ascending(bottom_keys, count))
+		return -EINVAL;
+
+	if (nr_inserted)
+		*nr_inserted = 0;
+
+	while (i < count) {
+		init_shadow_spine(&spine, info);
+
+		r = btree_insert_spine(&spine, info, root, keys,
+				       bottom_keys[i], &index);
+		if (r < 0) {
+			exit_shadow_spine(&spine);
+			break;
+		}
+
+		for (;;) {
+			n = dm_block_data(shadow_current(&spine));
+			r = insert_value(info, n, index, bottom_keys[i],
+					 values + i * value_size, &inserted);
+			if (r)
+				break;
+
+			if (nr_inserted)
+				*nr_inserted += inserted;
+
+			if (++i == count || !leaf_takes_key(&spine, bottom_keys[i]))
+				break;
+
+			slot = lower_bound(n, bottom_keys[i]);
+			if (slot < 0 || le64_to_cpu(n->keys[slot]) != bottom_keys[i])
+				slot++;
+			index = slot;
+		}
+
+		root = shadow_root(&spine);
+		exit_shadow_spine(&spine);
+		if (r)
+			break;
+	}
+
+	/*
+	 * The values already inserted are owned by the tree now, so the
+	 * new root is valid even on failure.
+	 */
+	*new_root = root;
+	return r;
+}
+EXPORT_SYMBOL_GPL(dm_btree_insert_batch);
+
+/*
+ * Fills one level of a bulk loaded tree.  Entries are spread evenly over
+ * as few nodes as possible, and the first key and location of each new
+ * node is written back over the start of 'keys' and 'blocks' so the
+ * caller can build the level above from them.
+ */
+static int bulk_load_level(struct dm_btree_info *info, uint32_t flags,
+			   uint64_t *keys, void *values, size_t value_size,
+			   __le64 *blocks, unsigned int *count)
+{
+	int r;
+	unsigned int i, nr_nodes, node, nr, done = 0;
+	size_t block_size = dm_bm_block_size(dm_tm_get_bm(info->tm));
+	uint32_t max_entries = calc_max_entries(value_size, block_size);
+	struct dm_block *b;
+	struct btree_node *n;
+
+	nr_nodes = DIV_ROUND_UP(*count, max_entries);
+
+	for (node = 0; node < nr_nodes; node++) {
+		nr = *count / nr_nodes + (node < *count % nr_nodes);
+
+		r = new_block(info, &b);
+		if (r < 0)
+			return r;
+
+		n = dm_block_data(b);
+		memset(n, 0, block_size);
+		n->header.flags = cpu_to_le32(flags);
+		n->header.nr_entries = cpu_to_le32(nr);
+		n->header.max_entries = cpu_to_le32(max_entries);
+		n->header.value_size = cpu_to_le32(value_size);
+
+		for (i = 0; i < nr; i++)
+			n->keys[i] = cpu_to_le64(keys[done + i]);
+		memcpy(value_base(n), values + done * value_size,
+		       nr * value_size);
+
+		keys[node] = keys[done];
+		blocks[node] = cpu_to_le64(dm_block_location(b));
+		unlock_block(info, b);
+
+		done += nr;
+	}
+
+	*count = nr_nodes;
+	return 0;
+}
+
+int dm_btree_bulk_load(struct dm_btree_info *info, uint64_t *keys,
+		       void *values, unsigned int count, dm_block_t *root)
+	__dm_written_to_disk(values)
+{
+	int r;
+	uint64_t *level_keys;
+	__le64 *blocks;
+
+	if (info->levels != 1 || !keys_ascending(keys, count))
+		return -EINVAL;
+
+	if (!count)
+		return dm_btree_empty(info, root);
+
+	level_keys = kvmalloc_array(count, sizeof(*level_keys), GFP_NOFS);
+	blocks = kvmalloc_array(count, sizeof(*blocks), GFP_NOFS);
+	if (!level_keys || !blocks) {
+		r = -ENOMEM;
+		goto out;
+	}
+	memcpy(level_keys, keys, count * sizeof(*level_keys));
+
+	r = bulk_load_level(info, LEAF_NODE, level_keys, values,
+			    info->value_type.size, blocks, &count);
+
+	while (!r && count > 1)
+		r = bulk_load_level(info, INTERNAL_NODE, level_keys, blocks,
+				    sizeof(__le64), blocks, &count);
+
+	if (!r)
+		*root = le64_to_cpu(blocks[0]);
+out:
+	kvfree(blocks);
+	kvfree(level_keys);
+	return r;
+}
+EXPORT_SYMBOL_GPL(dm_btree_bulk_load);
+
 /*----------------------------------------------------------------*/
 
 static int find_key(struct ro_spine *s, dm_block_t block, bool find_highest,
@@ -1434,6 +1676,9 @@ static int walk_node(struct dm_btree_info *info, dm_block_t block,
 
 	n = dm_block_data(node);
 
+	if (le32_to_cpu(n->header.flags) & INTERNAL_NODE)
+		prefetch_node_children(info->tm, n);
+
 	nr = le32_to_cpu(n->header.nr_entries);
 	for (i = 0; i < nr; i++) {
 		if (le32_to_cpu(n->header.flags) & INTERNAL_NODE) {
@@ -134,6 +134,30 @@ int dm_btree_insert_notify(struct dm_btree_info *info, dm_block_t root,
 			   int *inserted)
 			   __dm_written_to_disk(value);
 
+/*
+ * Insert (or overwrite) a batch of values that share all but the bottom
+ * level key.  'keys' holds the info->levels - 1 shared keys, 'bottom_keys'
+ * the bottom level keys in strictly increasing order (-EINVAL otherwise),
+ * and 'values' 'count' packed values.  Runs of keys that land in the
+ * same leaf are inserted without walking the spine again.  On error
+ * *new_root still reflects the values inserted so far.  'nr_inserted',
+ * if not NULL, is set to the number of new (not overwritten) entries.
+ */
+int dm_btree_insert_batch(struct dm_btree_info *info, dm_block_t root,
+			  uint64_t *keys, uint64_t *bottom_keys, void *values,
+			  unsigned int count, dm_block_t *new_root,
+			  unsigned int *nr_inserted)
+			  __dm_written_to_disk(values);
+
+/*
+ * Build a new single level tree bottom up from 'count' values with
+ * strictly increasing keys.  Much cheaper than inserting one at a time
+ * when the tree is being recreated from scratch.  O(n)
+ */
+int dm_btree_bulk_load(struct dm_btree_info *info, uint64_t *keys,
+		       void *values, unsigned int count, dm_block_t *root)
+		       __dm_written_to_disk(values);
+
 /*
  * Remove a key if present.  This doesn't remove empty sub trees.  Normally
  * subtrees represent a separate entity, like a snapshot map, so this is
@@ -334,6 +334,32 @@ int sm_ll_lookup(struct ll_disk *ll, dm_block_t b, uint32_t *result)
 	return sm_ll_lookup_big_ref_count(ll, b, result);
 }
 
+/*
+ * Number of bitmaps whose reads are kept in flight ahead of a scan.
+ */
+#define SM_BITMAP_PREFETCH 16
+
+/*
+ * Start reading the bitmaps of the index entries in [index, index_end) that
+ * have free blocks, so a scan over a cold cache doesn't wait on each bitmap
+ * in turn.
+ */
+static void prefetch_bitmaps(struct ll_disk *ll, dm_block_t index,
+			     dm_block_t index_end)
+{
+	struct disk_index_entry ie_disk;
+	struct dm_block_manager *bm = dm_tm_get_bm(ll->tm);
+	dm_block_t i;
+
+	for (i = index; i < index_end; i++) {
+		if (ll->load_ie(ll, i, &ie_disk) < 0)
+			break;
+
+		if (le32_to_cpu(ie_disk.nr_free))
+			dm_bm_prefetch(bm, le64_to_cpu(ie_disk.blocknr));
+	}
+}
+
 int sm_ll_find_free_block(struct ll_disk *ll, dm_block_t begin,
 			  dm_block_t end, dm_block_t *result)
 {
@@ -355,6 +381,19 @@ int sm_ll_find_free_block(struct ll_disk *ll, dm_block_t begin,
 		unsigned int position;
 		uint32_t bit_end;
 
+		/*
+		 * Most calls find a free block in the first bitmap.  Once
+		 * the scan moves past it, start reads for the next
+		 * SM_BITMAP_PREFETCH bitmaps and then keep the window full
+		 * by adding one bitmap per step.
+		 */
+		if (i == index_begin + 1)
+			prefetch_bitmaps(ll, i + 1,
+					 min(i + 1 + SM_BITMAP_PREFETCH, index_end));
+		else if (i > index_begin + 1 && i + SM_BITMAP_PREFETCH < index_end)
+			prefetch_bitmaps(ll, i + SM_BITMAP_PREFETCH,
+					 i + SM_BITMAP_PREFETCH + 1);
+
 		r = ll->load_ie(ll, i, &ie_disk);
 		if (r < 0)
 			return r;
@@ -1333,12 +1333,18 @@ static int ena_clean_rx_irq(struct ena_ring *rx_ring, struct napi_struct *napi,
 	if (refill_required > refill_threshold)
 		ena_refill_rx_bufs(rx_ring, refill_required);
 
+	if (xdp_flags & ENA_XDP_TX)
+		ena_xdp_tx_flush(rx_ring);
+
 	if (xdp_flags & ENA_XDP_REDIRECT)
 		xdp_do_flush();
 
 	return work_done;
 
 error:
+	if (xdp_flags & ENA_XDP_TX)
+		ena_xdp_tx_flush(rx_ring);
+
 	if (xdp_flags & ENA_XDP_REDIRECT)
 		xdp_do_flush();
 
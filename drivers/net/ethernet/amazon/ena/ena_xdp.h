@@ -107,8 +107,10 @@ static inline int ena_xdp_execute(struct ena_ring *rx_ring, struct xdp_buff *xdp
 		/* The XDP queues are shared between XDP_TX and XDP_REDIRECT */
 		spin_lock(&xdp_ring->xdp_tx_lock);
 
-		if (ena_xdp_xmit_frame(xdp_ring, rx_ring->adapter, xdpf,
-				       XDP_XMIT_FLUSH))
+		/* The doorbell is rung once per NAPI poll, see
+		 * ena_xdp_tx_flush().
+		 */
+		if (ena_xdp_xmit_frame(xdp_ring, rx_ring->adapter, xdpf, 0))
 			xdp_return_frame(xdpf);
 
 		spin_unlock(&xdp_ring->xdp_tx_lock);
@@ -148,4 +150,14 @@ static inline int ena_xdp_execute(struct ena_ring *rx_ring, struct xdp_buff *xdp
 
 	return verdict;
 }
+
+/* Make the device aware of all XDP_TX frames queued during an RX poll */
+static inline void ena_xdp_tx_flush(struct ena_ring *rx_ring)
+{
+	struct ena_ring *xdp_ring = rx_ring->xdp_ring;
+
+	spin_lock(&xdp_ring->xdp_tx_lock);
+	ena_ring_tx_doorbell(xdp_ring);
+	spin_unlock(&xdp_ring->xdp_tx_lock);
+}
 #endif /* ENA_XDP_H */
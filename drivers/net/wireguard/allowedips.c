@@ -6,10 +6,42 @@
 #include "allowedips.h"
 #include "peer.h"
 
+#include <linux/jhash.h>
+
 enum { MAX_ALLOWEDIPS_DEPTH = 129 };
 
 static struct kmem_cache *node_cache;
 
+/* Small per-CPU cache of recent address to peer results, so that a burst of
+ * packets to the same destination doesn't walk the trie each time. Entries
+ * are tagged with cache_gen, which is bumped after every change to any
+ * table, so a hit never outlives the trie state it was computed from. The
+ * generation is 64-bit so that it cannot wrap around to the tag of a stale
+ * entry, whose peer may long be freed.
+ */
+enum { ALLOWEDIPS_CACHE_SIZE = 64 };
+
+struct allowedips_cache_entry {
+	const struct allowedips *table;
+	struct wg_peer *peer;
+	u64 gen;
+	u8 bits;
+	u8 ip[16] __aligned(__alignof(u64));
+};
+
+static DEFINE_PER_CPU(struct allowedips_cache_entry[ALLOWEDIPS_CACHE_SIZE],
+		      allowedips_cache);
+static atomic64_t cache_gen = ATOMIC64_INIT(1);
+
+static void cache_invalidate(void)
+{
+	/* Order the trie updates before the new generation, paired with the
+	 * atomic64_read_acquire() in cached_lookup().
+	 */
+	smp_mb__before_atomic();
+	atomic64_inc(&cache_gen);
+}
+
 static void swap_endian(u8 *dst, const u8 *src, u8 bits)
 {
 	if (bits == 32) {
@@ -146,6 +178,46 @@ static struct wg_peer *lookup(struct allowedips_node __rcu *root, u8 bits,
 	return peer;
 }
 
+/* Returns a strong reference to a peer */
+static struct wg_peer *cached_lookup(const struct allowedips *table, u8 bits,
+				     const void *be_ip)
+{
+	struct allowedips_cache_entry *entry;
+	unsigned int hash;
+	struct wg_peer *peer;
+	u64 gen;
+
+	if (bits == 32)
+		hash = jhash_1word(*(const u32 *)be_ip, (unsigned long)table);
+	else
+		hash = jhash2(be_ip, 4, (unsigned long)table);
+
+	rcu_read_lock_bh();
+	gen = atomic64_read_acquire(&cache_gen);
+	entry = this_cpu_ptr(&allowedips_cache[hash & (ALLOWEDIPS_CACHE_SIZE - 1)]);
+
+	if (entry->gen == gen && entry->table == table && entry->bits == bits &&
+	    !memcmp(entry->ip, be_ip, bits / 8U)) {
+		peer = entry->peer;
+		if (!peer || wg_peer_get_maybe_zero(peer)) {
+			rcu_read_unlock_bh();
+			return peer;
+		}
+	}
+
+	/* Sample the root only after the generation, so that the result
+	 * stored below is never older than the tag it is stored with.
+	 */
+	peer = lookup(bits == 32 ? table->root4 : table->root6, bits, be_ip);
+	entry->table = table;
+	entry->peer = peer;
+	entry->gen = gen;
+	entry->bits = bits;
+	memcpy(entry->ip, be_ip, bits / 8U);
+	rcu_read_unlock_bh();
+	return peer;
+}
+
 static bool node_placement(struct allowedips_node __rcu *trie, const u8 *key,
 			   u8 cidr, u8 bits, struct allowedips_node **rnode,
 			   struct mutex *lock)
@@ -276,6 +348,7 @@ void wg_allowedips_free(struct allowedips *table, struct mutex *lock)
 		root_remove_peer_lists(node);
 		call_rcu(&node->rcu, root_free_rcu);
 	}
+	cache_invalidate();
 }
 
 int wg_allowedips_insert_v4(struct allowedips *table, const struct in_addr *ip,
@@ -283,10 +356,13 @@ int wg_allowedips_insert_v4(struct allowedips *table, const struct in_addr *ip,
 {
 	/* Aligned so it can be passed to fls */
 	u8 key[4] __aligned(__alignof(u32));
+	int ret;
 
 	++table->seq;
 	swap_endian(key, (const u8 *)ip, 32);
-	return add(&table->root4, 32, key, cidr, peer, lock);
+	ret = add(&table->root4, 32, key, cidr, peer, lock);
+	cache_invalidate();
+	return ret;
 }
 
 int wg_allowedips_insert_v6(struct allowedips *table, const struct in6_addr *ip,
@@ -294,10 +370,13 @@ int wg_allowedips_insert_v6(struct allowedips *table, const struct in6_addr *ip,
 {
 	/* Aligned so it can be passed to fls64 */
 	u8 key[16] __aligned(__alignof(u64));
+	int ret;
 
 	++table->seq;
 	swap_endian(key, (const u8 *)ip, 128);
-	return add(&table->root6, 128, key, cidr, peer, lock);
+	ret = add(&table->root6, 128, key, cidr, peer, lock);
+	cache_invalidate();
+	return ret;
 }
 
 void wg_allowedips_remove_by_peer(struct allowedips *table,
@@ -338,6 +417,7 @@ void wg_allowedips_remove_by_peer(struct allowedips *table,
 		*(struct allowedips_node **)(parent->parent_bit_packed & ~3UL) = child;
 		call_rcu(&parent->rcu, node_free_rcu);
 	}
+	cache_invalidate();
 }
 
 int wg_allowedips_read_node(struct allowedips_node *node, u8 ip[16], u8 *cidr)
@@ -357,9 +437,9 @@ struct wg_peer *wg_allowedips_lookup_dst(struct allowedips *table,
 					 struct sk_buff *skb)
 {
 	if (skb->protocol == htons(ETH_P_IP))
-		return lookup(table->root4, 32, &ip_hdr(skb)->daddr);
+		return cached_lookup(table, 32, &ip_hdr(skb)->daddr);
 	else if (skb->protocol == htons(ETH_P_IPV6))
-		return lookup(table->root6, 128, &ipv6_hdr(skb)->daddr);
+		return cached_lookup(table, 128, &ipv6_hdr(skb)->daddr);
 	return NULL;
 }
 
@@ -368,9 +448,9 @@ struct wg_peer *wg_allowedips_lookup_src(struct allowedips *table,
 					 struct sk_buff *skb)
 {
 	if (skb->protocol == htons(ETH_P_IP))
-		return lookup(table->root4, 32, &ip_hdr(skb)->saddr);
+		return cached_lookup(table, 32, &ip_hdr(skb)->saddr);
 	else if (skb->protocol == htons(ETH_P_IPV6))
-		return lookup(table->root6, 128, &ipv6_hdr(skb)->saddr);
+		return cached_lookup(table, 128, &ipv6_hdr(skb)->saddr);
 	return NULL;
 }
 
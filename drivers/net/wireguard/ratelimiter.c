@@ -51,6 +51,15 @@ static void entry_uninit(struct ratelimiter_entry *entry)
 	call_rcu(&entry->rcu, entry_free);
 }
 
+static bool buckets_empty(unsigned int i)
+{
+#if IS_ENABLED(CONFIG_IPV6)
+	if (!hlist_empty(&table_v6[i]))
+		return false;
+#endif
+	return hlist_empty(&table_v4[i]);
+}
+
 /* Calling this function with a NULL work uninits all entries. */
 static void wg_ratelimiter_gc_entries(struct work_struct *work)
 {
@@ -60,6 +69,12 @@ static void wg_ratelimiter_gc_entries(struct work_struct *work)
 	unsigned int i;
 
 	for (i = 0; i < table_size; ++i) {
+		/* Most buckets are empty most of the time, so don't bounce
+		 * table_lock against concurrent inserts just to find that out.
+		 * An entry racing in here is fresh and won't be due anyway.
+		 */
+		if (buckets_empty(i))
+			goto next;
 		spin_lock(&table_lock);
 		hlist_for_each_entry_safe(entry, temp, &table_v4[i], hash) {
 			if (unlikely(!work) ||
@@ -74,6 +89,7 @@ static void wg_ratelimiter_gc_entries(struct work_struct *work)
 		}
 #endif
 		spin_unlock(&table_lock);
+next:
 		if (likely(work))
 			cond_resched();
 	}
@@ -15,6 +15,7 @@
 #include <linux/delay.h>
 #include <scsi/scsi_cmnd.h>
 #include <linux/bitfield.h>
+#include <linux/interrupt.h>
 #include <linux/iopoll.h>
 
 #define MAX_QUEUE_SUP GENMASK(7, 0)
@@ -22,6 +23,9 @@
 #define UFS_MCQ_MIN_RW_QUEUES 2
 #define UFS_MCQ_MIN_READ_QUEUES 0
 #define UFS_MCQ_MIN_POLL_QUEUES 0
+#define UFS_MCQ_MAX_INTR_AGGR_COUNT 31
+#define UFS_MCQ_MIN_INTR_AGGR_TIMEOUT 1
+#define UFS_MCQ_MAX_INTR_AGGR_TIMEOUT 255
 #define QUEUE_EN_OFFSET 31
 #define QUEUE_ID_OFFSET 16
 
@@ -80,6 +84,37 @@ module_param_cb(poll_queues, &poll_queue_count_ops, &poll_queues, 0644);
 MODULE_PARM_DESC(poll_queues,
 		 "Number of poll queues used for r/w. Default value is 1");
 
+static int intr_aggr_count_set(const char *val, const struct kernel_param *kp)
+{
+	return param_set_uint_minmax(val, kp, 0, UFS_MCQ_MAX_INTR_AGGR_COUNT);
+}
+
+static const struct kernel_param_ops intr_aggr_count_ops = {
+	.set = intr_aggr_count_set,
+	.get = param_get_uint,
+};
+
+static unsigned int intr_aggr_count;
+module_param_cb(intr_aggr_count, &intr_aggr_count_ops, &intr_aggr_count, 0644);
+MODULE_PARM_DESC(intr_aggr_count,
+		 "Number of completions coalesced into one CQ interrupt, 0 disables. Default value is 0");
+
+static int intr_aggr_timeout_set(const char *val, const struct kernel_param *kp)
+{
+	return param_set_uint_minmax(val, kp, UFS_MCQ_MIN_INTR_AGGR_TIMEOUT,
+				     UFS_MCQ_MAX_INTR_AGGR_TIMEOUT);
+}
+
+static const struct kernel_param_ops intr_aggr_timeout_ops = {
+	.set = intr_aggr_timeout_set,
+	.get = param_get_uint,
+};
+
+static unsigned int intr_aggr_timeout = 2;
+module_param_cb(intr_aggr_timeout, &intr_aggr_timeout_ops, &intr_aggr_timeout, 0644);
+MODULE_PARM_DESC(intr_aggr_timeout,
+		 "Longest delay of a coalesced CQ interrupt, in 40us units. Default value is 2");
+
 /**
  * ufshcd_mcq_config_mac - Set the #Max Activ Cmds.
  * @hba: per adapter instance
@@ -330,6 +365,13 @@ void ufshcd_mcq_compl_all_cqes_lock(struct ufs_hba *hba,
 	spin_unlock_irqrestore(&hwq->cq_lock, flags);
 }
 
+static void ufshcd_mcq_reset_intr_aggr(struct ufs_hba *hba,
+				       struct ufs_hw_queue *hwq)
+{
+	writel(INT_AGGR_ENABLE | INT_AGGR_COUNTER_AND_TIMER_RESET,
+	       mcq_opr_base(hba, OPR_CQIS, hwq->id) + REG_CQIACR);
+}
+
 unsigned long ufshcd_mcq_poll_cqe_lock(struct ufs_hba *hba,
 				       struct ufs_hw_queue *hwq)
 {
@@ -337,6 +379,12 @@ unsigned long ufshcd_mcq_poll_cqe_lock(struct ufs_hba *hba,
 	unsigned long flags;
 
 	spin_lock_irqsave(&hwq->cq_lock, flags);
+	/*
+	 * Resetting the aggregation counter and timer before reading the CQ
+	 * tail makes sure any entry posted after that raises a new interrupt.
+	 */
+	if (hwq->intr_aggr)
+		ufshcd_mcq_reset_intr_aggr(hba, hwq);
 	ufshcd_mcq_update_cq_tail_slot(hwq);
 	while (!ufshcd_mcq_is_cq_empty(hwq)) {
 		ufshcd_mcq_process_cqe(hba, hwq);
@@ -352,6 +400,24 @@ unsigned long ufshcd_mcq_poll_cqe_lock(struct ufs_hba *hba,
 }
 EXPORT_SYMBOL_GPL(ufshcd_mcq_poll_cqe_lock);
 
+/*
+ * Coalesce up to intr_aggr_count completions, or as many as arrive within
+ * intr_aggr_timeout * 40us of the first one, into a single Tail Entry Push
+ * Status interrupt of @hwq.
+ */
+static void ufshcd_mcq_config_intr_aggr(struct ufs_hba *hba,
+					struct ufs_hw_queue *hwq)
+{
+	hwq->intr_aggr = intr_aggr_count && ufshcd_is_intr_aggr_allowed(hba);
+	if (!hwq->intr_aggr)
+		return;
+
+	writel(INT_AGGR_ENABLE | INT_AGGR_PARAM_WRITE |
+	       INT_AGGR_COUNTER_THLD_VAL(intr_aggr_count) |
+	       INT_AGGR_TIMEOUT_VAL(intr_aggr_timeout),
+	       mcq_opr_base(hba, OPR_CQIS, hwq->id) + REG_CQIACR);
+}
+
 void ufshcd_mcq_make_queues_operational(struct ufs_hba *hba)
 {
 	struct ufs_hw_queue *hwq;
@@ -399,8 +465,11 @@ void ufshcd_mcq_make_queues_operational(struct ufs_hba *hba)
 		hwq->sq_tail_slot = hwq->cq_tail_slot = hwq->cq_head_slot = 0;
 
 		/* Enable Tail Entry Push Status interrupt only for non-poll queues */
-		if (i < hba->nr_hw_queues - hba->nr_queues[HCTX_TYPE_POLL])
+		hwq->intr_aggr = false;
+		if (i < hba->nr_hw_queues - hba->nr_queues[HCTX_TYPE_POLL]) {
+			ufshcd_mcq_config_intr_aggr(hba, hwq);
 			writel(1, mcq_opr_base(hba, OPR_CQIS, i) + REG_CQIE);
+		}
 
 		/* Completion Queue Enable|Size to Completion Queue Attribute */
 		ufsmcq_writel(hba, (1 << QUEUE_EN_OFFSET) | qsize,
@@ -444,6 +513,47 @@ void ufshcd_mcq_config_esi(struct ufs_hba *hba, struct msi_msg *msg)
 }
 EXPORT_SYMBOL_GPL(ufshcd_mcq_config_esi);
 
+/**
+ * ufshcd_mcq_set_esi_affinity - Steer each ESI vector to the CPUs its
+ * hardware queue is mapped to
+ * @hba: per adapter instance
+ *
+ * With the default of one rw queue per CPU, every SQ/CQ pair is then owned
+ * by a single CPU: its requests are submitted and completed there, so the
+ * queue locks are never contended and the CQ stays in that CPU's cache.
+ */
+void ufshcd_mcq_set_esi_affinity(struct ufs_hba *hba)
+{
+	struct blk_mq_tag_set *set = &hba->host->tag_set;
+	struct ufs_hw_queue *hwq;
+	cpumask_var_t mask;
+	unsigned int cpu, i, m;
+
+	if (!zalloc_cpumask_var(&mask, GFP_KERNEL))
+		return;
+
+	for (i = 0; i < hba->nr_hw_queues; i++) {
+		hwq = &hba->uhq[i];
+		if (!hwq->esi_irq)
+			continue;
+
+		cpumask_clear(mask);
+		for (m = 0; m < set->nr_maps; m++) {
+			if (m == HCTX_TYPE_POLL || !set->map[m].nr_queues)
+				continue;
+			for_each_possible_cpu(cpu)
+				if (set->map[m].mq_map[cpu] == i)
+					cpumask_set_cpu(cpu, mask);
+		}
+
+		if (!cpumask_empty(mask))
+			irq_set_affinity(hwq->esi_irq, mask);
+	}
+
+	free_cpumask_var(mask);
+}
+EXPORT_SYMBOL_GPL(ufshcd_mcq_set_esi_affinity);
+
 int ufshcd_mcq_init(struct ufs_hba *hba)
 {
 	struct Scsi_Host *host = hba->host;
@@ -2907,6 +2907,9 @@ static void ufshcd_map_queues(struct Scsi_Host *shost)
 		blk_mq_map_queues(map);
 		queue_offset += map->nr_queues;
 	}
+
+	if (hba->mcq_enabled)
+		ufshcd_mcq_set_esi_affinity(hba);
 }
 
 static void ufshcd_init_lrb(struct ufs_hba *hba, struct ufshcd_lrb *lrb, int i)
@@ -1755,6 +1755,7 @@ static int ufs_qcom_config_esi(struct ufs_hba *hba)
 			failed_desc = desc;
 			break;
 		}
+		hba->uhq[desc->msi_index].esi_irq = desc->irq;
 	}
 	msi_unlock_descs(hba->dev);
 
@@ -1765,6 +1766,7 @@ static int ufs_qcom_config_esi(struct ufs_hba *hba)
 			if (desc == failed_desc)
 				break;
 			devm_free_irq(hba->dev, desc->irq, hba);
+			hba->uhq[desc->msi_index].esi_irq = 0;
 		}
 		msi_unlock_descs(hba->dev);
 		platform_device_msi_free_irqs_all(hba->dev);
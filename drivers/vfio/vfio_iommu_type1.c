@@ -338,6 +338,21 @@ static struct vfio_pfn *vfio_find_vpfn(struct vfio_dma *dma, dma_addr_t iova)
 	return NULL;
 }
 
+/* Count the externally pinned pages in [iova, iova + npage * PAGE_SIZE). */
+static long vfio_count_vpfns(struct vfio_dma *dma, dma_addr_t iova, long npage)
+{
+	long i, count = 0;
+
+	if (RB_EMPTY_ROOT(&dma->pfn_list))
+		return 0;
+
+	for (i = 0; i < npage; i++, iova += PAGE_SIZE)
+		if (vfio_find_vpfn(dma, iova))
+			count++;
+
+	return count;
+}
+
 static void vfio_link_pfn(struct vfio_dma *dma,
 			  struct vfio_pfn *new)
 {
@@ -649,32 +664,50 @@ static long vfio_pin_pages_remote(struct vfio_dma *dma, unsigned long vaddr,
 		 * !VM_PFNMAP vma.
 		 */
 		while (true) {
+			long nr_pages;
+
 			if (pfn != *pfn_base + pinned ||
 			    rsvd != is_invalid_reserved_pfn(pfn))
 				goto out;
 
+			/*
+			 * Consume the whole run of consecutive pfns at the
+			 * head of the batch at once, e.g. all the pages of a
+			 * huge folio.
+			 */
+			for (nr_pages = 1; nr_pages < batch->size; nr_pages++) {
+				unsigned long next;
+
+				next = page_to_pfn(batch->pages[batch->offset + nr_pages]);
+				if (next != pfn + nr_pages ||
+				    rsvd != is_invalid_reserved_pfn(next))
+					break;
+			}
+
 			/*
 			 * Reserved pages aren't counted against the user,
 			 * externally pinned pages are already counted against
 			 * the user.
 			 */
-			if (!rsvd && !vfio_find_vpfn(dma, iova)) {
+			if (!rsvd) {
+				long acct = nr_pages - vfio_count_vpfns(dma, iova, nr_pages);
+
 				if (!dma->lock_cap &&
-				    mm->locked_vm + lock_acct + 1 > limit) {
+				    mm->locked_vm + lock_acct + acct > limit) {
 					pr_warn("%s: RLIMIT_MEMLOCK (%ld) exceeded\n",
 						__func__, limit << PAGE_SHIFT);
 					ret = -ENOMEM;
 					goto unpin_out;
 				}
-				lock_acct++;
+				lock_acct += acct;
 			}
 
-			pinned++;
-			npage--;
-			vaddr += PAGE_SIZE;
-			iova += PAGE_SIZE;
-			batch->offset++;
-			batch->size--;
+			pinned += nr_pages;
+			npage -= nr_pages;
+			vaddr += nr_pages << PAGE_SHIFT;
+			iova += nr_pages << PAGE_SHIFT;
+			batch->offset += nr_pages;
+			batch->size -= nr_pages;
 
 			if (!batch->size)
 				break;
@@ -714,14 +747,22 @@ static long vfio_unpin_pages_remote(struct vfio_dma *dma, dma_addr_t iova,
 				    bool do_accounting)
 {
 	long unlocked = 0, locked = 0;
-	long i;
+	long i, nr;
 
-	for (i = 0; i < npage; i++, iova += PAGE_SIZE) {
-		if (put_pfn(pfn++, dma->prot)) {
-			unlocked++;
-			if (vfio_find_vpfn(dma, iova))
-				locked++;
-		}
+	for (i = 0; i < npage; i += nr) {
+		bool rsvd = is_invalid_reserved_pfn(pfn + i);
+
+		for (nr = 1; i + nr < npage; nr++)
+			if (is_invalid_reserved_pfn(pfn + i + nr) != rsvd)
+				break;
+
+		if (rsvd)
+			continue;
+
+		unpin_user_page_range_dirty_lock(pfn_to_page(pfn + i), nr,
+						 dma->prot & IOMMU_WRITE);
+		unlocked += nr;
+		locked += vfio_count_vpfns(dma, iova + (i << PAGE_SHIFT), nr);
 	}
 
 	if (do_accounting)
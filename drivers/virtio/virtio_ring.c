@@ -213,6 +213,14 @@ struct vring_virtqueue {
 	/* Device used for doing DMA */
 	struct device *dma_dev;
 
+	/*
+	 * Preallocated indirect tables, one of indir_pool_sg descriptors
+	 * per descriptor id, see virtqueue_set_indirect_pool().
+	 */
+	void *indir_pool;
+	unsigned int indir_pool_sg;
+	size_t indir_pool_size;
+
 #ifdef DEBUG
 	/* They're supposed to lock for us. */
 	unsigned int in_use;
@@ -489,23 +497,89 @@ static unsigned int vring_unmap_one_split(const struct vring_virtqueue *vq,
 	return extra[i].next;
 }
 
+/*
+ * The descriptor id of an in-flight buffer is owned by that buffer until it
+ * is detached, so the pool slot for that id can be used without locking.
+ */
+static void *vring_indirect_from_pool(struct vring_virtqueue *vq,
+				      unsigned int id, unsigned int total_sg,
+				      size_t desc_size)
+{
+	if (!vq->indir_pool || total_sg > vq->indir_pool_sg)
+		return NULL;
+
+	return vq->indir_pool + (size_t)id * vq->indir_pool_sg * desc_size;
+}
+
+static void vring_free_indirect(struct vring_virtqueue *vq, void *desc)
+{
+	if (vq->indir_pool && desc >= vq->indir_pool &&
+	    desc < vq->indir_pool + vq->indir_pool_size)
+		return;
+
+	kfree(desc);
+}
+
+static int vring_alloc_indirect_pool(struct vring_virtqueue *vq,
+				     unsigned int nr_sg)
+{
+	size_t desc_size;
+	u32 num;
+	void *pool;
+
+	if (vq->packed_ring) {
+		num = vq->packed.vring.num;
+		desc_size = sizeof(struct vring_packed_desc);
+	} else {
+		num = vq->split.vring.num;
+		desc_size = sizeof(struct vring_desc);
+	}
+
+	/* Lowmem only, the tables are mapped with vring_map_single(). */
+	pool = kcalloc(array_size(num, nr_sg), desc_size,
+		       GFP_KERNEL | __GFP_NOWARN);
+	if (!pool)
+		return -ENOMEM;
+
+	kfree(vq->indir_pool);
+	vq->indir_pool = pool;
+	vq->indir_pool_sg = nr_sg;
+	vq->indir_pool_size = array3_size(num, nr_sg, desc_size);
+
+	return 0;
+}
+
+static void vring_free_indirect_pool(struct vring_virtqueue *vq)
+{
+	kfree(vq->indir_pool);
+	vq->indir_pool = NULL;
+	vq->indir_pool_sg = 0;
+	vq->indir_pool_size = 0;
+}
+
 static struct vring_desc *alloc_indirect_split(struct virtqueue *_vq,
+					       unsigned int head,
 					       unsigned int total_sg,
 					       gfp_t gfp)
 {
+	struct vring_virtqueue *vq = to_vvq(_vq);
 	struct vring_desc *desc;
 	unsigned int i;
 
-	/*
-	 * We require lowmem mappings for the descriptors because
-	 * otherwise virt_to_phys will give us bogus addresses in the
-	 * virtqueue.
-	 */
-	gfp &= ~__GFP_HIGHMEM;
+	desc = vring_indirect_from_pool(vq, head, total_sg,
+					sizeof(struct vring_desc));
+	if (!desc) {
+		/*
+		 * We require lowmem mappings for the descriptors because
+		 * otherwise virt_to_phys will give us bogus addresses in the
+		 * virtqueue.
+		 */
+		gfp &= ~__GFP_HIGHMEM;
 
-	desc = kmalloc_array(total_sg, sizeof(struct vring_desc), gfp);
-	if (!desc)
-		return NULL;
+		desc = kmalloc_array(total_sg, sizeof(struct vring_desc), gfp);
+		if (!desc)
+			return NULL;
+	}
 
 	for (i = 0; i < total_sg; i++)
 		desc[i].next = cpu_to_virtio16(_vq->vdev, i + 1);
@@ -574,7 +648,7 @@ static inline int virtqueue_add_split(struct virtqueue *_vq,
 	head = vq->free_head;
 
 	if (virtqueue_use_indirect(vq, total_sg))
-		desc = alloc_indirect_split(_vq, total_sg, gfp);
+		desc = alloc_indirect_split(_vq, head, total_sg, gfp);
 	else {
 		desc = NULL;
 		WARN_ON_ONCE(total_sg > vq->split.vring.num && !vq->indirect);
@@ -602,7 +676,7 @@ static inline int virtqueue_add_split(struct virtqueue *_vq,
 		if (out_sgs)
 			vq->notify(&vq->vq);
 		if (indirect)
-			kfree(desc);
+			vring_free_indirect(vq, desc);
 		END_USE(vq);
 		return -ENOSPC;
 	}
@@ -725,7 +799,7 @@ static inline int virtqueue_add_split(struct virtqueue *_vq,
 
 free_indirect:
 	if (indirect)
-		kfree(desc);
+		vring_free_indirect(vq, desc);
 
 	END_USE(vq);
 	return -ENOMEM;
@@ -807,7 +881,7 @@ static void detach_buf_split(struct vring_virtqueue *vq, unsigned int head,
 				vring_unmap_one_split_indirect(vq, &indir_desc[j]);
 		}
 
-		kfree(indir_desc);
+		vring_free_indirect(vq, indir_desc);
 		vq->split.desc_state[head].indir_desc = NULL;
 	} else if (ctx) {
 		*ctx = vq->split.desc_state[head].indir_desc;
@@ -1263,11 +1337,18 @@ static void vring_unmap_desc_packed(const struct vring_virtqueue *vq,
 		       DMA_FROM_DEVICE : DMA_TO_DEVICE);
 }
 
-static struct vring_packed_desc *alloc_indirect_packed(unsigned int total_sg,
+static struct vring_packed_desc *alloc_indirect_packed(struct vring_virtqueue *vq,
+						       unsigned int id,
+						       unsigned int total_sg,
 						       gfp_t gfp)
 {
 	struct vring_packed_desc *desc;
 
+	desc = vring_indirect_from_pool(vq, id, total_sg,
+					sizeof(struct vring_packed_desc));
+	if (desc)
+		return desc;
+
 	/*
 	 * We require lowmem mappings for the descriptors because
 	 * otherwise virt_to_phys will give us bogus addresses in the
@@ -1295,13 +1376,9 @@ static int virtqueue_add_indirect_packed(struct vring_virtqueue *vq,
 	dma_addr_t addr;
 
 	head = vq->packed.next_avail_idx;
-	desc = alloc_indirect_packed(total_sg, gfp);
-	if (!desc)
-		return -ENOMEM;
 
 	if (unlikely(vq->vq.num_free < 1)) {
 		pr_debug("Can't add buf len 1 - avail = 0\n");
-		kfree(desc);
 		END_USE(vq);
 		return -ENOSPC;
 	}
@@ -1310,6 +1387,10 @@ static int virtqueue_add_indirect_packed(struct vring_virtqueue *vq,
 	id = vq->free_head;
 	BUG_ON(id == vq->packed.vring.num);
 
+	desc = alloc_indirect_packed(vq, id, total_sg, gfp);
+	if (!desc)
+		return -ENOMEM;
+
 	for (n = 0; n < out_sgs + in_sgs; n++) {
 		for (sg = sgs[n]; sg; sg = sg_next(sg)) {
 			if (vring_map_one_sg(vq, sg, n < out_sgs ?
@@ -1392,7 +1473,7 @@ static int virtqueue_add_indirect_packed(struct vring_virtqueue *vq,
 		vring_unmap_desc_packed(vq, &desc[i]);
 
 free_desc:
-	kfree(desc);
+	vring_free_indirect(vq, desc);
 
 	END_USE(vq);
 	return -ENOMEM;
@@ -1638,7 +1719,7 @@ static void detach_buf_packed(struct vring_virtqueue *vq,
 					i++)
 				vring_unmap_desc_packed(vq, &desc[i]);
 		}
-		kfree(desc);
+		vring_free_indirect(vq, desc);
 		state->indir_desc = NULL;
 	} else if (ctx) {
 		*ctx = state->indir_desc;
@@ -2091,6 +2172,9 @@ static struct virtqueue *vring_create_virtqueue_packed(
 	vq->dma_dev = dma_dev;
 	vq->use_dma_api = vring_use_dma_api(vdev);
 	vq->premapped = false;
+	vq->indir_pool = NULL;
+	vq->indir_pool_sg = 0;
+	vq->indir_pool_size = 0;
 	vq->do_unmap = vq->use_dma_api;
 
 	vq->indirect = virtio_has_feature(vdev, VIRTIO_RING_F_INDIRECT_DESC) &&
@@ -2636,6 +2720,9 @@ static struct virtqueue *__vring_new_virtqueue(unsigned int index,
 	vq->dma_dev = dma_dev;
 	vq->use_dma_api = vring_use_dma_api(vdev);
 	vq->premapped = false;
+	vq->indir_pool = NULL;
+	vq->indir_pool_sg = 0;
+	vq->indir_pool_size = 0;
 	vq->do_unmap = vq->use_dma_api;
 
 	vq->indirect = virtio_has_feature(vdev, VIRTIO_RING_F_INDIRECT_DESC) &&
@@ -2759,10 +2846,65 @@ int virtqueue_resize(struct virtqueue *_vq, u32 num,
 	else
 		err = virtqueue_resize_split(_vq, num);
 
+	/* The pool is indexed by descriptor id, so it follows the ring size. */
+	if (!err && vq->indir_pool_sg &&
+	    vring_alloc_indirect_pool(vq, vq->indir_pool_sg))
+		vring_free_indirect_pool(vq);
+
 	return virtqueue_enable_after_reset(_vq);
 }
 EXPORT_SYMBOL_GPL(virtqueue_resize);
 
+/**
+ * virtqueue_set_indirect_pool - preallocate indirect descriptor tables
+ * @_vq: the struct virtqueue we're talking about.
+ * @nr_sg: number of descriptors in each table, 0 to release the pool.
+ *
+ * Reserve an indirect descriptor table of @nr_sg entries for every
+ * descriptor id of the ring. Buffers of up to @nr_sg entries added through
+ * the indirect path then use that table instead of allocating one, larger
+ * buffers still allocate. The pool is resized along with the ring by
+ * virtqueue_resize().
+ *
+ * This function must be called immediately after creating the vq, or after vq
+ * reset, and before adding any buffers to it.
+ *
+ * Caller must ensure we don't call this with other virtqueue operations
+ * at the same time (except where noted).
+ *
+ * Returns zero or a negative error.
+ * 0: success.
+ * -EOPNOTSUPP: indirect descriptors were not negotiated.
+ * -EINVAL: the vq already contains buffers.
+ * -ENOMEM: failed to allocate the pool, the vq keeps allocating tables.
+ */
+int virtqueue_set_indirect_pool(struct virtqueue *_vq, unsigned int nr_sg)
+{
+	struct vring_virtqueue *vq = to_vvq(_vq);
+	u32 num;
+	int err;
+
+	if (!vq->indirect)
+		return -EOPNOTSUPP;
+
+	START_USE(vq);
+
+	num = vq->packed_ring ? vq->packed.vring.num : vq->split.vring.num;
+
+	if (num != vq->vq.num_free) {
+		END_USE(vq);
+		return -EINVAL;
+	}
+
+	vring_free_indirect_pool(vq);
+	err = nr_sg ? vring_alloc_indirect_pool(vq, nr_sg) : 0;
+
+	END_USE(vq);
+
+	return err;
+}
+EXPORT_SYMBOL_GPL(virtqueue_set_indirect_pool);
+
 /**
  * virtqueue_set_dma_premapped - set the vring premapped mode
  * @_vq: the struct virtqueue we're talking about.
@@ -2902,6 +3044,7 @@ static void vring_free(struct virtqueue *_vq)
 		kfree(vq->split.desc_state);
 		kfree(vq->split.desc_extra);
 	}
+	vring_free_indirect_pool(vq);
 }
 
 void vring_del_virtqueue(struct virtqueue *_vq)
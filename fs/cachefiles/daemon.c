@@ -158,7 +158,7 @@ void cachefiles_flush_reqs(struct cachefiles_cache *cache)
 	xa_lock(xa);
 	xa_for_each(xa, index, req) {
 		req->error = -EIO;
-		complete(&req->done);
+		complete_all(&req->done);
 		__xa_erase(xa, index);
 	}
 	xa_unlock(xa);
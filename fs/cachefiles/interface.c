@@ -242,9 +242,11 @@ static bool cachefiles_shorten_object(struct cachefiles_object *object,
 
 	trace_cachefiles_trunc(object, inode, i_size, dio_size,
 			       cachefiles_trunc_shrink);
+	cachefiles_forget_data_extent(object);
 	ret = cachefiles_inject_remove_error();
 	if (ret == 0)
 		ret = vfs_truncate(&file->f_path, dio_size);
+	cachefiles_forget_data_extent(object);
 	if (ret < 0) {
 		trace_cachefiles_io_error(object, file_inode(file), ret,
 					  cachefiles_trace_trunc_error);
@@ -409,6 +411,9 @@ static bool cachefiles_invalidate_cookie(struct fscache_cookie *cookie)
 	old_file = object->file;
 	object->file = new_file;
 	object->content_info = CACHEFILES_CONTENT_NO_DATA;
+	object->data_gen++;
+	object->data_start = 0;
+	object->data_end = 0;
 	set_bit(CACHEFILES_OBJECT_USING_TMPFILE, &object->flags);
 	set_bit(FSCACHE_COOKIE_NEEDS_UPDATE, &object->cookie->flags);
 
@@ -73,6 +73,9 @@ struct cachefiles_object {
 	refcount_t			ref;
 	u8				d_name_len;	/* Length of filename */
 	enum cachefiles_content		content_info:8;	/* Info about content presence */
+	unsigned int			data_gen;	/* Bumped when data is discarded */
+	loff_t				data_start;	/* Last data extent found in file */
+	loff_t				data_end;
 	unsigned long			flags;
 #define CACHEFILES_OBJECT_USING_TMPFILE	0		/* Have an unlinked tmpfile */
 #ifdef CONFIG_CACHEFILES_ONDEMAND
@@ -143,6 +146,7 @@ struct cachefiles_req {
 	struct completion done;
 	refcount_t ref;
 	int error;
+	int waiters;		/* tasks waiting on @done, under xa_lock */
 	struct cachefiles_msg msg;
 };
 
@@ -259,6 +263,7 @@ extern int __cachefiles_write(struct cachefiles_object *object,
 			      struct iov_iter *iter,
 			      netfs_io_terminated_t term_func,
 			      void *term_func_priv);
+extern void cachefiles_forget_data_extent(struct cachefiles_object *object);
 
 /*
  * key.c
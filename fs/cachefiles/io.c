@@ -375,6 +375,50 @@ static int cachefiles_write(struct netfs_cache_resources *cres,
 				  term_func, term_func_priv);
 }
 
+/*
+ * Remember the data extent found by the last SEEK_DATA/SEEK_HOLE pair, so that
+ * reads from a well-populated backing file don't have to seek again for every
+ * subrequest.  Writes only ever add data, so the extent stays valid until data
+ * is discarded by truncation, hole punching or invalidation, which must call
+ * cachefiles_forget_data_extent() both before and after the discard.  @gen is
+ * the data_gen sampled before seeking; the extent isn't recorded if data was
+ * discarded in the meantime.  The second call catches a seek that sampled the
+ * generation after the first one but still saw the data about to go away.
+ */
+static void cachefiles_note_data_extent(struct cachefiles_object *object,
+					unsigned int gen, loff_t start, loff_t end)
+{
+	spin_lock(&object->lock);
+	if (object->data_gen == gen) {
+		object->data_start = start;
+		object->data_end = end;
+	}
+	spin_unlock(&object->lock);
+}
+
+static bool cachefiles_data_extent_covers(struct cachefiles_object *object,
+					  loff_t start, size_t len,
+					  unsigned int *_gen)
+{
+	bool covers;
+
+	spin_lock(&object->lock);
+	covers = start >= object->data_start &&
+		 start + len <= object->data_end;
+	*_gen = object->data_gen;
+	spin_unlock(&object->lock);
+	return covers;
+}
+
+void cachefiles_forget_data_extent(struct cachefiles_object *object)
+{
+	spin_lock(&object->lock);
+	object->data_gen++;
+	object->data_start = 0;
+	object->data_end = 0;
+	spin_unlock(&object->lock);
+}
+
 static inline enum netfs_io_source
 cachefiles_do_prepare_read(struct netfs_cache_resources *cres,
 			   loff_t start, size_t *_len, loff_t i_size,
@@ -390,6 +434,7 @@ cachefiles_do_prepare_read(struct netfs_cache_resources *cres,
 	size_t len = *_len;
 	loff_t off, to;
 	ino_t ino = file ? file_inode(file)->i_ino : 0;
+	unsigned int gen;
 	int rc;
 
 	_enter("%zx @%llx/%llx", len, start, i_size);
@@ -420,6 +465,13 @@ cachefiles_do_prepare_read(struct netfs_cache_resources *cres,
 
 	object = cachefiles_cres_object(cres);
 	cache = object->volume->cache;
+
+	if (cachefiles_data_extent_covers(object, start, len, &gen)) {
+		why = cachefiles_trace_read_have_data;
+		ret = NETFS_READ_FROM_CACHE;
+		goto out_no_object;
+	}
+
 	cachefiles_begin_secure(cache, &saved_cred);
 retry:
 	off = cachefiles_inject_read_error();
@@ -459,6 +511,8 @@ cachefiles_do_prepare_read(struct netfs_cache_resources *cres,
 		goto out;
 	}
 
+	cachefiles_note_data_extent(object, gen, start, to);
+
 	if (to < start + len) {
 		if (start + len >= i_size)
 			to = round_up(to, cache->bsize);
@@ -580,10 +634,12 @@ int __cachefiles_prepare_write(struct cachefiles_object *object,
 
 	/* Partially allocated, but insufficient space: cull. */
 	fscache_count_no_write_space();
+	cachefiles_forget_data_extent(object);
 	ret = cachefiles_inject_remove_error();
 	if (ret == 0)
 		ret = vfs_fallocate(file, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
 				    start, *_len);
+	cachefiles_forget_data_extent(object);
 	if (ret < 0) {
 		trace_cachefiles_io_error(object, file_inode(file), ret,
 					  cachefiles_trace_fallocate_error);
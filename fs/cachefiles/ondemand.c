@@ -120,7 +120,7 @@ static long cachefiles_ondemand_fd_ioctl(struct file *filp, unsigned int ioctl,
 	xa_unlock(&cache->reqs);
 
 	trace_cachefiles_ondemand_cread(object, id);
-	complete(&req->done);
+	complete_all(&req->done);
 	return 0;
 }
 
@@ -389,7 +389,7 @@ static inline bool cachefiles_ondemand_finish_req(struct cachefiles_req *req,
 		return false;
 
 	req->error = err;
-	complete(&req->done);
+	complete_all(&req->done);
 	return true;
 }
 
@@ -464,6 +464,51 @@ ssize_t cachefiles_ondemand_daemon_read(struct cachefiles_cache *cache,
 
 typedef int (*init_req_fn)(struct cachefiles_req *req, void *private);
 
+struct cachefiles_read_ctx {
+	loff_t off;
+	size_t len;
+};
+
+/*
+ * Fold a read into a READ request of the same object that the daemon hasn't
+ * picked up yet if the two ranges overlap or are adjacent.  Readahead of
+ * contiguous chunks then costs the daemon a single round trip, and it gets
+ * to fetch the whole range at once.
+ */
+static struct cachefiles_req *
+cachefiles_ondemand_merge_read(struct cachefiles_object *object,
+			       struct xa_state *xas,
+			       struct cachefiles_read_ctx *read_ctx)
+{
+	loff_t pos = read_ctx->off, end = pos + read_ctx->len;
+	struct cachefiles_read *load;
+	struct cachefiles_req *req;
+
+	xas_lock(xas);
+	if (cachefiles_ondemand_object_is_dropping(object))
+		goto out;
+	xas_for_each_marked(xas, req, ULONG_MAX, CACHEFILES_REQ_NEW) {
+		if (req->object != object ||
+		    req->msg.opcode != CACHEFILES_OP_READ)
+			continue;
+		load = (void *)req->msg.data;
+		if (pos > load->off + load->len || load->off > end)
+			continue;
+
+		end = max_t(loff_t, end, load->off + load->len);
+		load->off = min_t(loff_t, load->off, pos);
+		load->len = end - load->off;
+		trace_cachefiles_ondemand_read(object, &req->msg, load);
+		refcount_inc(&req->ref);
+		req->waiters++;
+		xas_unlock(xas);
+		return req;
+	}
+out:
+	xas_unlock(xas);
+	return NULL;
+}
+
 static int cachefiles_ondemand_send_req(struct cachefiles_object *object,
 					enum cachefiles_opcode opcode,
 					size_t data_len,
@@ -483,6 +528,12 @@ static int cachefiles_ondemand_send_req(struct cachefiles_object *object,
 		goto out;
 	}
 
+	if (opcode == CACHEFILES_OP_READ) {
+		req = cachefiles_ondemand_merge_read(object, &xas, private);
+		if (req)
+			goto wait;
+	}
+
 	req = kzalloc(sizeof(*req) + data_len, GFP_KERNEL);
 	if (!req) {
 		ret = -ENOMEM;
@@ -490,6 +541,7 @@ static int cachefiles_ondemand_send_req(struct cachefiles_object *object,
 	}
 
 	refcount_set(&req->ref, 1);
+	req->waiters = 1;
 	req->object = object;
 	init_completion(&req->done);
 	req->msg.opcode = opcode;
@@ -567,12 +619,29 @@ static int cachefiles_ondemand_send_req(struct cachefiles_object *object,
 	if (!ret) {
 		ret = req->error;
 	} else {
+		bool last;
+
 		ret = -EINTR;
-		if (!cachefiles_ondemand_finish_req(req, &xas, ret)) {
+		/*
+		 * Leave a merged request to the remaining waiters.  The last
+		 * one cancels it within the same xa_lock hold, so that no read
+		 * can be merged into it once the waiter count dropped to zero.
+		 */
+		xas_lock(&xas);
+		last = !--req->waiters;
+		if (last &&
+		    __xa_cmpxchg(xas.xa, xas.xa_index, req, NULL, 0) != req) {
 			/* Someone will complete it soon. */
+			req->waiters++;
+			xas_unlock(&xas);
 			cpu_relax();
 			goto wait;
 		}
+		if (last) {
+			req->error = ret;
+			complete_all(&req->done);
+		}
+		xas_unlock(&xas);
 	}
 	cachefiles_req_put(req);
 	return ret;
@@ -634,11 +703,6 @@ static int cachefiles_ondemand_init_close_req(struct cachefiles_req *req,
 	return 0;
 }
 
-struct cachefiles_read_ctx {
-	loff_t off;
-	size_t len;
-};
-
 static int cachefiles_ondemand_init_read_req(struct cachefiles_req *req,
 					     void *private)
 {
@@ -701,7 +765,7 @@ void cachefiles_ondemand_clean_object(struct cachefiles_object *object)
 	xa_for_each(&cache->reqs, index, req) {
 		if (req->object == object) {
 			req->error = -EIO;
-			complete(&req->done);
+			complete_all(&req->done);
 			__xa_erase(&cache->reqs, index);
 		}
 	}
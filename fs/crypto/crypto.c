@@ -104,18 +104,20 @@ void fscrypt_generate_iv(union fscrypt_iv *iv, u64 index,
 	iv->index = cpu_to_le64(index);
 }
 
-/* Encrypt or decrypt a single "data unit" of file contents. */
-int fscrypt_crypt_data_unit(const struct fscrypt_inode_info *ci,
-			    fscrypt_direction_t rw, u64 index,
-			    struct page *src_page, struct page *dest_page,
-			    unsigned int len, unsigned int offs,
-			    gfp_t gfp_flags)
+/*
+ * Encrypt or decrypt a single "data unit" of file contents using @req, which
+ * the caller may reuse for all data units of a page or folio.
+ */
+static int __fscrypt_crypt_data_unit(const struct fscrypt_inode_info *ci,
+				     struct skcipher_request *req,
+				     fscrypt_direction_t rw, u64 index,
+				     struct page *src_page,
+				     struct page *dest_page,
+				     unsigned int len, unsigned int offs)
 {
 	union fscrypt_iv iv;
-	struct skcipher_request *req = NULL;
 	DECLARE_CRYPTO_WAIT(wait);
 	struct scatterlist dst, src;
-	struct crypto_skcipher *tfm = ci->ci_enc_key.tfm;
 	int res = 0;
 
 	if (WARN_ON_ONCE(len <= 0))
@@ -125,10 +127,6 @@ int fscrypt_crypt_data_unit(const struct fscrypt_inode_info *ci,
 
 	fscrypt_generate_iv(&iv, index, ci);
 
-	req = skcipher_request_alloc(tfm, gfp_flags);
-	if (!req)
-		return -ENOMEM;
-
 	skcipher_request_set_callback(
 		req, CRYPTO_TFM_REQ_MAY_BACKLOG | CRYPTO_TFM_REQ_MAY_SLEEP,
 		crypto_req_done, &wait);
@@ -142,7 +140,6 @@ int fscrypt_crypt_data_unit(const struct fscrypt_inode_info *ci,
 		res = crypto_wait_req(crypto_skcipher_decrypt(req), &wait);
 	else
 		res = crypto_wait_req(crypto_skcipher_encrypt(req), &wait);
-	skcipher_request_free(req);
 	if (res) {
 		fscrypt_err(ci->ci_inode,
 			    "%scryption failed for data unit %llu: %d",
@@ -152,6 +149,25 @@ int fscrypt_crypt_data_unit(const struct fscrypt_inode_info *ci,
 	return 0;
 }
 
+/* Encrypt or decrypt a single "data unit" of file contents. */
+int fscrypt_crypt_data_unit(const struct fscrypt_inode_info *ci,
+			    fscrypt_direction_t rw, u64 index,
+			    struct page *src_page, struct page *dest_page,
+			    unsigned int len, unsigned int offs,
+			    gfp_t gfp_flags)
+{
+	struct skcipher_request *req;
+	int res;
+
+	req = skcipher_request_alloc(ci->ci_enc_key.tfm, gfp_flags);
+	if (!req)
+		return -ENOMEM;
+	res = __fscrypt_crypt_data_unit(ci, req, rw, index, src_page,
+					dest_page, len, offs);
+	skcipher_request_free(req);
+	return res;
+}
+
 /**
  * fscrypt_encrypt_pagecache_blocks() - Encrypt data from a pagecache page
  * @page: the locked pagecache page containing the data to encrypt
@@ -188,10 +204,11 @@ struct page *fscrypt_encrypt_pagecache_blocks(struct page *page,
 	const unsigned int du_bits = ci->ci_data_unit_bits;
 	const unsigned int du_size = 1U << du_bits;
 	struct page *ciphertext_page;
+	struct skcipher_request *req;
 	u64 index = ((u64)page->index << (PAGE_SHIFT - du_bits)) +
 		    (offs >> du_bits);
 	unsigned int i;
-	int err;
+	int err = 0;
 
 	if (WARN_ON_ONCE(!PageLocked(page)))
 		return ERR_PTR(-EINVAL);
@@ -203,14 +220,19 @@ struct page *fscrypt_encrypt_pagecache_blocks(struct page *page,
 	if (!ciphertext_page)
 		return ERR_PTR(-ENOMEM);
 
-	for (i = offs; i < offs + len; i += du_size, index++) {
-		err = fscrypt_crypt_data_unit(ci, FS_ENCRYPT, index,
-					      page, ciphertext_page,
-					      du_size, i, gfp_flags);
-		if (err) {
-			fscrypt_free_bounce_page(ciphertext_page);
-			return ERR_PTR(err);
-		}
+	req = skcipher_request_alloc(ci->ci_enc_key.tfm, gfp_flags);
+	if (!req) {
+		fscrypt_free_bounce_page(ciphertext_page);
+		return ERR_PTR(-ENOMEM);
+	}
+	for (i = offs; i < offs + len && !err; i += du_size, index++)
+		err = __fscrypt_crypt_data_unit(ci, req, FS_ENCRYPT, index,
+						page, ciphertext_page,
+						du_size, i);
+	skcipher_request_free(req);
+	if (err) {
+		fscrypt_free_bounce_page(ciphertext_page);
+		return ERR_PTR(err);
 	}
 	SetPagePrivate(ciphertext_page);
 	set_page_private(ciphertext_page, (unsigned long)page);
@@ -272,8 +294,9 @@ int fscrypt_decrypt_pagecache_blocks(struct folio *folio, size_t len,
 	const unsigned int du_size = 1U << du_bits;
 	u64 index = ((u64)folio->index << (PAGE_SHIFT - du_bits)) +
 		    (offs >> du_bits);
+	struct skcipher_request *req;
 	size_t i;
-	int err;
+	int err = 0;
 
 	if (WARN_ON_ONCE(!folio_test_locked(folio)))
 		return -EINVAL;
@@ -281,16 +304,18 @@ int fscrypt_decrypt_pagecache_blocks(struct folio *folio, size_t len,
 	if (WARN_ON_ONCE(len <= 0 || !IS_ALIGNED(len | offs, du_size)))
 		return -EINVAL;
 
-	for (i = offs; i < offs + len; i += du_size, index++) {
+	req = skcipher_request_alloc(ci->ci_enc_key.tfm, GFP_NOFS);
+	if (!req)
+		return -ENOMEM;
+	for (i = offs; i < offs + len && !err; i += du_size, index++) {
 		struct page *page = folio_page(folio, i >> PAGE_SHIFT);
 
-		err = fscrypt_crypt_data_unit(ci, FS_DECRYPT, index, page,
-					      page, du_size, i & ~PAGE_MASK,
-					      GFP_NOFS);
-		if (err)
-			return err;
+		err = __fscrypt_crypt_data_unit(ci, req, FS_DECRYPT, index,
+						page, page, du_size,
+						i & ~PAGE_MASK);
 	}
-	return 0;
+	skcipher_request_free(req);
+	return err;
 }
 EXPORT_SYMBOL(fscrypt_decrypt_pagecache_blocks);
 
@@ -288,6 +288,14 @@ struct erofs_inode {
 		};
 #endif	/* CONFIG_EROFS_FS_ZIP */
 	};
+#ifdef CONFIG_EROFS_FS_ZIP
+	/* the last compressed extent mapped, see z_erofs_map_blocks_iter() */
+	seqlock_t z_extent_lock;
+	erofs_off_t z_extent_la, z_extent_pa;
+	u64 z_extent_llen, z_extent_plen;
+	unsigned int z_extent_flags;
+	char z_extent_algorithmformat;
+#endif
 	/* the corresponding vfs inode */
 	struct inode vfs_inode;
 };
@@ -104,6 +104,8 @@ struct z_erofs_decompressqueue {
 		struct kthread_work kthread_work;
 	} u;
 	bool eio, sync;
+	/* split off by z_erofs_decompress_fanout(), never split again */
+	bool split;
 };
 
 static inline bool z_erofs_is_inline_pcluster(struct z_erofs_pcluster *pcl)
@@ -1358,6 +1360,96 @@ static void z_erofs_decompress_queue(const struct z_erofs_decompressqueue *io,
 	}
 }
 
+static void z_erofs_decompressqueue_work(struct work_struct *work);
+#ifdef CONFIG_EROFS_FS_PCPU_KTHREAD
+static void z_erofs_decompressqueue_kthread_work(struct kthread_work *work);
+#endif
+
+/* minimal number of pclusters handed to each extra decompression worker */
+static unsigned int z_erofs_fanout_pclusters = 8;
+module_param_named(fanout_pclusters, z_erofs_fanout_pclusters, uint, 0444);
+MODULE_PARM_DESC(fanout_pclusters, "Minimal number of pclusters handed to each extra decompression worker");
+
+/*
+ * Queue a split-off part of a pcluster chain.  The unbound erofs_worker
+ * already keeps work close to the submitting CPU; per-CPU kthreads are
+ * picked round-robin among the CPUs of the local node instead.
+ */
+static void z_erofs_queue_split(struct z_erofs_decompressqueue *q,
+				unsigned int nth)
+{
+#ifdef CONFIG_EROFS_FS_PCPU_KTHREAD
+	const struct cpumask *mask = cpumask_of_node(numa_node_id());
+	struct kthread_worker *worker = NULL;
+	unsigned int cpu;
+
+	rcu_read_lock();
+	cpu = cpumask_nth(nth % cpumask_weight(mask), mask);
+	if (cpu < nr_cpu_ids)
+		worker = rcu_dereference(z_erofs_pcpu_workers[cpu]);
+	if (worker) {
+		kthread_init_work(&q->u.kthread_work,
+				  z_erofs_decompressqueue_kthread_work);
+		kthread_queue_work(worker, &q->u.kthread_work);
+		rcu_read_unlock();
+		return;
+	}
+	rcu_read_unlock();
+#endif
+	INIT_WORK(&q->u.work, z_erofs_decompressqueue_work);
+	queue_work(z_erofs_workqueue, &q->u.work);
+}
+
+/*
+ * pclusters of one chain are independent of each other (folios shared by
+ * two pclusters are completed by z_erofs_onlinefolio_end()), so split long
+ * chains and let other workers decompress the tail parts concurrently.
+ */
+static void z_erofs_decompress_fanout(struct z_erofs_decompressqueue *io)
+{
+	unsigned int cpus = num_online_cpus(), batch = z_erofs_fanout_pclusters;
+	struct z_erofs_decompressqueue *q = NULL, *nq;
+	z_erofs_next_pcluster_t owned = io->head;
+	struct z_erofs_pcluster *pcl;
+	unsigned int n = 0, parts = 0;
+
+	if (io->split || !batch || cpus < 2)
+		return;
+
+	while (owned != Z_EROFS_PCLUSTER_TAIL) {
+		owned = READ_ONCE(container_of(owned,
+				struct z_erofs_pcluster, next)->next);
+		++n;
+	}
+	if (n < 2 * batch)
+		return;
+	batch = max(batch, DIV_ROUND_UP(n, cpus));
+
+	n = 0;
+	owned = io->head;
+	while (owned != Z_EROFS_PCLUSTER_TAIL) {
+		pcl = container_of(owned, struct z_erofs_pcluster, next);
+		owned = READ_ONCE(pcl->next);
+		if (++n % batch || owned == Z_EROFS_PCLUSTER_TAIL)
+			continue;
+
+		nq = kvzalloc(sizeof(*nq), GFP_NOIO | __GFP_NOWARN);
+		if (!nq)
+			break;
+		/* terminate the previous part, the chain is exclusively ours */
+		WRITE_ONCE(pcl->next, Z_EROFS_PCLUSTER_TAIL);
+		if (q)
+			z_erofs_queue_split(q, parts++);
+		nq->sb = io->sb;
+		nq->eio = io->eio;
+		nq->split = true;
+		nq->head = owned;
+		q = nq;
+	}
+	if (q)
+		z_erofs_queue_split(q, parts);
+}
+
 static void z_erofs_decompressqueue_work(struct work_struct *work)
 {
 	struct z_erofs_decompressqueue *bgq =
@@ -1365,6 +1457,7 @@ static void z_erofs_decompressqueue_work(struct work_struct *work)
 	struct page *pagepool = NULL;
 
 	DBG_BUGON(bgq->head == Z_EROFS_PCLUSTER_TAIL);
+	z_erofs_decompress_fanout(bgq);
 	z_erofs_decompress_queue(bgq, &pagepool);
 	erofs_release_pages(&pagepool);
 	kvfree(bgq);
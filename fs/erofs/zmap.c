@@ -587,6 +587,7 @@ static int z_erofs_fill_inode_lazy(struct inode *inode)
 	err = 0;
 	if (test_bit(EROFS_I_Z_INITED_BIT, &vi->flags))
 		goto out_unlock;
+	seqlock_init(&vi->z_extent_lock);
 
 	pos = ALIGN(erofs_iloc(inode) + vi->inode_isize + vi->xattr_isize, 8);
 	h = erofs_read_metabuf(&buf, sb, pos, EROFS_KMAP);
@@ -680,6 +681,56 @@ static int z_erofs_fill_inode_lazy(struct inode *inode)
 	return err;
 }
 
+/*
+ * Reading a pcluster maps it once per folio, and every lookup used to decode
+ * (and look back through) the on-disk lcluster indexes again.  Remember the
+ * last extent per inode so that lookups landing in it are served from memory
+ * instead; the image is read-only, so a cached extent never goes stale.
+ */
+static bool z_erofs_map_cached_extent(struct erofs_inode *vi,
+				      struct erofs_map_blocks *map, int flags)
+{
+	erofs_off_t la, pa;
+	u64 llen, plen;
+	unsigned int seq, mflags;
+	char alg;
+
+	do {
+		seq = read_seqbegin(&vi->z_extent_lock);
+		la = vi->z_extent_la;
+		pa = vi->z_extent_pa;
+		llen = vi->z_extent_llen;
+		plen = vi->z_extent_plen;
+		mflags = vi->z_extent_flags;
+		alg = vi->z_extent_algorithmformat;
+	} while (read_seqretry(&vi->z_extent_lock, seq));
+
+	if (!llen || map->m_la < la || map->m_la - la >= llen ||
+	    (flags && !(mflags & EROFS_MAP_FULL_MAPPED)))
+		return false;
+
+	map->m_la = la;
+	map->m_llen = llen;
+	map->m_pa = pa;
+	map->m_plen = plen;
+	map->m_flags = mflags;
+	map->m_algorithmformat = alg;
+	return true;
+}
+
+static void z_erofs_cache_extent(struct erofs_inode *vi,
+				 struct erofs_map_blocks *map)
+{
+	write_seqlock(&vi->z_extent_lock);
+	vi->z_extent_la = map->m_la;
+	vi->z_extent_llen = map->m_llen;
+	vi->z_extent_pa = map->m_pa;
+	vi->z_extent_plen = map->m_plen;
+	vi->z_extent_flags = map->m_flags;
+	vi->z_extent_algorithmformat = map->m_algorithmformat;
+	write_sequnlock(&vi->z_extent_lock);
+}
+
 int z_erofs_map_blocks_iter(struct inode *inode, struct erofs_map_blocks *map,
 			    int flags)
 {
@@ -709,7 +760,12 @@ int z_erofs_map_blocks_iter(struct inode *inode, struct erofs_map_blocks *map,
 		goto out;
 	}
 
+	if (z_erofs_map_cached_extent(vi, map, flags))
+		goto out;
+
 	err = z_erofs_do_map_blocks(inode, map, flags);
+	if (!err)
+		z_erofs_cache_extent(vi, map);
 out:
 	if (err)
 		map->m_llen = 0;
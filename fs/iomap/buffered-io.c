@@ -8,6 +8,7 @@
 #include <linux/fs.h>
 #include <linux/iomap.h>
 #include <linux/pagemap.h>
+#include <linux/backing-dev.h>
 #include <linux/uio.h>
 #include <linux/buffer_head.h>
 #include <linux/dax.h>
@@ -156,7 +157,7 @@ static void iomap_clear_range_dirty(struct folio *folio, size_t off, size_t len)
 		ifs_clear_range_dirty(folio, ifs, off, len);
 }
 
-static void ifs_set_range_dirty(struct folio *folio,
+static void __ifs_set_range_dirty(struct folio *folio,
 		struct iomap_folio_state *ifs, size_t off, size_t len)
 {
 	struct inode *inode = folio->mapping->host;
@@ -164,10 +165,17 @@ static void ifs_set_range_dirty(struct folio *folio,
 	unsigned int first_blk = (off >> inode->i_blkbits);
 	unsigned int last_blk = (off + len - 1) >> inode->i_blkbits;
 	unsigned int nr_blks = last_blk - first_blk + 1;
+
+	bitmap_set(ifs->state, first_blk + blks_per_folio, nr_blks);
+}
+
+static void ifs_set_range_dirty(struct folio *folio,
+		struct iomap_folio_state *ifs, size_t off, size_t len)
+{
 	unsigned long flags;
 
 	spin_lock_irqsave(&ifs->state_lock, flags);
-	bitmap_set(ifs->state, first_blk + blks_per_folio, nr_blks);
+	__ifs_set_range_dirty(folio, ifs, off, len);
 	spin_unlock_irqrestore(&ifs->state_lock, flags);
 }
 
@@ -179,6 +187,36 @@ static void iomap_set_range_dirty(struct folio *folio, size_t off, size_t len)
 		ifs_set_range_dirty(folio, ifs, off, len);
 }
 
+/*
+ * Mark @len bytes at @off uptodate and the @copied bytes of them that were
+ * written dirty.  Both bitmaps are updated under a single state_lock
+ * acquisition, and the uptodate bitmap is left alone if the folio is uptodate
+ * already, which is the common case for overwrites and streaming writes into
+ * large folios.
+ */
+static void iomap_set_range_written(struct folio *folio, size_t off,
+		size_t len, size_t copied)
+{
+	struct iomap_folio_state *ifs = folio->private;
+	bool was_uptodate = folio_test_uptodate(folio);
+	bool uptodate = was_uptodate;
+	unsigned long flags;
+
+	if (ifs) {
+		spin_lock_irqsave(&ifs->state_lock, flags);
+		if (!was_uptodate)
+			uptodate = ifs_set_range_uptodate(folio, ifs, off, len);
+		if (copied)
+			__ifs_set_range_dirty(folio, ifs, off, copied);
+		spin_unlock_irqrestore(&ifs->state_lock, flags);
+	} else {
+		uptodate = true;
+	}
+
+	if (uptodate && !was_uptodate)
+		folio_mark_uptodate(folio);
+}
+
 static struct iomap_folio_state *ifs_alloc(struct inode *inode,
 		struct folio *folio, unsigned int flags)
 {
@@ -519,6 +557,48 @@ static loff_t iomap_readahead_iter(const struct iomap_iter *iter,
 	return done;
 }
 
+/*
+ * If the filesystem returned a mapping that extends beyond the end of the
+ * readahead request, grow the request to cover more of it, up to the largest
+ * I/O the device takes and the file's readahead size.  This allows reads of
+ * large extents to be issued as a few large bios, no matter how small the
+ * readahead window was.  Readahead that was disabled or that the file asked
+ * to avoid (random access) is never expanded.
+ */
+static void iomap_readahead_expand(struct iomap_iter *iter,
+		struct iomap_readpage_ctx *ctx)
+{
+	struct readahead_control *rac = ctx->rac;
+	struct file_ra_state *ra = rac->ra;
+	struct inode *inode = iter->inode;
+	loff_t map_end = iter->iomap.offset + iter->iomap.length;
+	loff_t ra_pos = readahead_pos(rac);
+	loff_t ra_end = ra_pos + readahead_length(rac);
+	loff_t max_len, new_end;
+
+	if (!ra || !ra->ra_pages)
+		return;
+	if (rac->file && (rac->file->f_mode & FMODE_RANDOM))
+		return;
+	if (iter->iomap.type != IOMAP_MAPPED ||
+	    (iter->iomap.flags & IOMAP_F_NEW))
+		return;
+
+	max_len = min_t(unsigned long, inode_to_bdi(inode)->io_pages,
+			ra->ra_pages);
+	max_len <<= PAGE_SHIFT;
+	if (map_end <= ra_end || readahead_length(rac) >= max_len)
+		return;
+
+	new_end = min3(map_end, ra_pos + max_len,
+		       round_up(i_size_read(inode), PAGE_SIZE));
+	if (new_end <= ra_end)
+		return;
+
+	readahead_expand(rac, ra_pos, new_end - ra_pos);
+	iter->len += readahead_pos(rac) + readahead_length(rac) - ra_end;
+}
+
 /**
  * iomap_readahead - Attempt to read pages from a file.
  * @rac: Describes the pages to be read.
@@ -547,8 +627,10 @@ void iomap_readahead(struct readahead_control *rac, const struct iomap_ops *ops)
 
 	trace_iomap_readahead(rac->mapping->host, readahead_count(rac));
 
-	while (iomap_iter(&iter, ops) > 0)
+	while (iomap_iter(&iter, ops) > 0) {
+		iomap_readahead_expand(&iter, &ctx);
 		iter.processed = iomap_readahead_iter(&iter, &ctx);
+	}
 
 	if (ctx.bio)
 		submit_bio(ctx.bio);
@@ -859,8 +941,7 @@ static bool __iomap_write_end(struct inode *inode, loff_t pos, size_t len,
 	 */
 	if (unlikely(copied < len && !folio_test_uptodate(folio)))
 		return false;
-	iomap_set_range_uptodate(folio, offset_in_folio(folio, pos), len);
-	iomap_set_range_dirty(folio, offset_in_folio(folio, pos), copied);
+	iomap_set_range_written(folio, offset_in_folio(folio, pos), len, copied);
 	filemap_dirty_folio(inode->i_mapping, folio);
 	return true;
 }
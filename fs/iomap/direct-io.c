@@ -20,6 +20,7 @@
  * Private flags for iomap_dio, must not overlap with the public ones in
  * iomap.h:
  */
+#define IOMAP_DIO_NO_INVALIDATE	(1U << 25)
 #define IOMAP_DIO_CALLER_COMP	(1U << 26)
 #define IOMAP_DIO_INLINE_COMP	(1U << 27)
 #define IOMAP_DIO_WRITE_THROUGH	(1U << 28)
@@ -110,7 +111,8 @@ ssize_t iomap_dio_complete(struct iomap_dio *dio)
 	 * ->end_io() when necessary, otherwise a racing buffer read would cache
 	 * zeros from unwritten extents.
 	 */
-	if (!dio->error && dio->size && (dio->flags & IOMAP_DIO_WRITE))
+	if (!dio->error && dio->size && (dio->flags & IOMAP_DIO_WRITE) &&
+	    !(dio->flags & IOMAP_DIO_NO_INVALIDATE))
 		kiocb_invalidate_post_direct_write(iocb, dio->size);
 
 	inode_dio_end(file_inode(iocb->ki_filp));
@@ -180,9 +182,18 @@ void iomap_dio_bio_end_io(struct bio *bio)
 	}
 
 	/*
-	 * Flagged with IOMAP_DIO_INLINE_COMP, we can complete it inline
+	 * Flagged with IOMAP_DIO_INLINE_COMP, we can complete it inline.
+	 *
+	 * For writes that only holds as long as there is no page cache to
+	 * invalidate, as that might sleep.  Pages instantiated after the check
+	 * raced with the write, and that is not supported 100% anyway (see
+	 * iomap_dio_complete()), so don't bother trying to invalidate them.
 	 */
-	if (dio->flags & IOMAP_DIO_INLINE_COMP) {
+	if ((dio->flags & IOMAP_DIO_INLINE_COMP) &&
+	    (!(dio->flags & IOMAP_DIO_WRITE) ||
+	     !iocb->ki_filp->f_mapping->nrpages)) {
+		if (dio->flags & IOMAP_DIO_WRITE)
+			dio->flags |= IOMAP_DIO_NO_INVALIDATE;
 		WRITE_ONCE(iocb->private, NULL);
 		iomap_dio_complete_work(&dio->aio.work);
 		goto release_bio;
@@ -342,8 +353,11 @@ static loff_t iomap_dio_bio_iter(const struct iomap_iter *iter,
 	 */
 	if (need_zeroout ||
 	    ((dio->flags & IOMAP_DIO_NEED_SYNC) && !use_fua) ||
-	    ((dio->flags & IOMAP_DIO_WRITE) && pos >= i_size_read(inode)))
+	    ((dio->flags & IOMAP_DIO_WRITE) && pos >= i_size_read(inode))) {
 		dio->flags &= ~IOMAP_DIO_CALLER_COMP;
+		if (dio->flags & IOMAP_DIO_WRITE)
+			dio->flags &= ~IOMAP_DIO_INLINE_COMP;
+	}
 
 	/*
 	 * The rules for polled IO completions follow the guidelines as the
@@ -606,6 +620,16 @@ __iomap_dio_rw(struct kiocb *iocb, struct iov_iter *iter,
 		if (iocb->ki_flags & IOCB_DIO_CALLER_COMP)
 			dio->flags |= IOMAP_DIO_CALLER_COMP;
 
+		/*
+		 * Without filesystem completion work, pure overwrites can also
+		 * be completed inline from the bio completion handler, which
+		 * also keeps them eligible for polling.  The same rules as for
+		 * deferred completions apply, so this flag gets cleared again
+		 * for any extent that needs more work.
+		 */
+		if (!dops || !dops->end_io)
+			dio->flags |= IOMAP_DIO_INLINE_COMP;
+
 		if (dio_flags & IOMAP_DIO_OVERWRITE_ONLY) {
 			ret = -EAGAIN;
 			if (iomi.pos >= dio->i_size ||
@@ -20,8 +20,17 @@
 #include <linux/errno.h>
 #include <linux/slab.h>
 #include <linux/blkdev.h>
+#include <linux/moduleparam.h>
+#include <linux/workqueue.h>
 #include <trace/events/jbd2.h>
 
+/*
+ * Percentage of the log in use from which old transactions are checkpointed
+ * in the background, 0 disables background checkpointing.
+ */
+static unsigned int jbd2_checkpoint_threshold = 50;
+module_param_named(checkpoint_threshold, jbd2_checkpoint_threshold, uint, 0644);
+
 /*
  * Unlink a buffer from a transaction checkpoint list.
  *
@@ -117,6 +126,47 @@ __releases(&journal->j_state_lock)
 	}
 }
 
+static bool jbd2_log_over_threshold(journal_t *journal, unsigned int pct)
+{
+	unsigned long len = journal->j_last - journal->j_first;
+	unsigned long used = len - READ_ONCE(journal->j_free);
+
+	return pct && used * 100 >= len * pct;
+}
+
+/*
+ * Kick off background checkpointing when the log is filling up, so that
+ * __jbd2_log_wait_for_space() rarely has to checkpoint while new handles
+ * are waiting for log space.  Called after each commit.
+ */
+void jbd2_log_start_checkpoint(journal_t *journal)
+{
+	unsigned int pct = READ_ONCE(jbd2_checkpoint_threshold);
+
+	if (is_journal_aborted(journal) ||
+	    !READ_ONCE(journal->j_checkpoint_transactions) ||
+	    !jbd2_log_over_threshold(journal, min(pct, 100U)))
+		return;
+	queue_work(system_unbound_wq, &journal->j_checkpoint_work);
+}
+
+void jbd2_checkpoint_work(struct work_struct *work)
+{
+	journal_t *journal = container_of(work, journal_t, j_checkpoint_work);
+	unsigned int pct = min(READ_ONCE(jbd2_checkpoint_threshold), 100U);
+
+	mutex_lock_io(&journal->j_checkpoint_mutex);
+	/* keep going down to half the threshold so we are not kicked again */
+	while (!is_journal_aborted(journal) &&
+	       READ_ONCE(journal->j_checkpoint_transactions) &&
+	       jbd2_log_over_threshold(journal, pct / 2)) {
+		if (jbd2_log_do_checkpoint(journal))
+			break;
+		cond_resched();
+	}
+	mutex_unlock(&journal->j_checkpoint_mutex);
+}
+
 static void
 __flush_batch(journal_t *journal, int *batch_count)
 {
@@ -24,6 +24,7 @@
 #include <linux/bio.h>
 #include <linux/blkdev.h>
 #include <linux/bitops.h>
+#include <linux/workqueue.h>
 #include <trace/events/jbd2.h>
 
 /*
@@ -339,6 +340,100 @@ static void jbd2_block_tag_csum_set(journal_t *j, journal_block_tag_t *tag,
 	else
 		tag->t_checksum = cpu_to_be16(csum32);
 }
+/*
+ * Checksumming the data blocks of a full descriptor is the bulk of the CPU
+ * time kjournald2 spends on metadata-heavy commits with csum v2/v3, so large
+ * batches are split into stripes checksummed on other CPUs.
+ */
+#define JBD2_CSUM_STRIPE_MIN	32
+#define JBD2_CSUM_MAX_STRIPES	4
+
+/*
+ * The commit thread waits for the stripes, and commits can be needed to make
+ * progress on reclaim, so they get a rescuer rather than system_unbound_wq.
+ */
+static struct workqueue_struct *jbd2_csum_wq;
+
+int __init jbd2_journal_init_csum_wq(void)
+{
+	jbd2_csum_wq = alloc_workqueue("jbd2-csum",
+				       WQ_UNBOUND | WQ_MEM_RECLAIM, 0);
+	if (!jbd2_csum_wq) {
+		pr_emerg("JBD2: failed to create checksum workqueue\n");
+		return -ENOMEM;
+	}
+	return 0;
+}
+
+void jbd2_journal_destroy_csum_wq(void)
+{
+	if (jbd2_csum_wq)
+		destroy_workqueue(jbd2_csum_wq);
+	jbd2_csum_wq = NULL;
+}
+
+struct jbd2_csum_stripe {
+	struct work_struct work;
+	journal_t *journal;
+	struct buffer_head **bhs;
+	journal_block_tag_t **tags;
+	int nr;
+	tid_t tid;
+};
+
+static void jbd2_csum_stripe(struct jbd2_csum_stripe *s)
+{
+	int i;
+
+	for (i = 0; i < s->nr; i++)
+		if (s->tags[i])
+			jbd2_block_tag_csum_set(s->journal, s->tags[i],
+						s->bhs[i], s->tid);
+}
+
+static void jbd2_csum_stripe_work(struct work_struct *work)
+{
+	jbd2_csum_stripe(container_of(work, struct jbd2_csum_stripe, work));
+}
+
+static void jbd2_block_tags_csum_set(journal_t *journal,
+				     struct buffer_head **bhs,
+				     journal_block_tag_t **tags, int nr,
+				     tid_t tid)
+{
+	struct jbd2_csum_stripe stripes[JBD2_CSUM_MAX_STRIPES];
+	int n, i, per;
+
+	if (!jbd2_journal_has_csum_v2or3(journal))
+		return;
+
+	n = min3(nr / JBD2_CSUM_STRIPE_MIN, (int)num_online_cpus(),
+		 JBD2_CSUM_MAX_STRIPES);
+	n = max(n, 1);
+	per = DIV_ROUND_UP(nr, n);
+
+	for (i = 0; i < n; i++) {
+		struct jbd2_csum_stripe *s = &stripes[i];
+
+		s->journal = journal;
+		s->bhs = bhs + i * per;
+		s->tags = tags + i * per;
+		s->nr = min(per, nr - i * per);
+		s->tid = tid;
+		/* the last stripe is checksummed by the commit thread itself */
+		if (i == n - 1)
+			break;
+		INIT_WORK_ONSTACK(&s->work, jbd2_csum_stripe_work);
+		queue_work(jbd2_csum_wq, &s->work);
+	}
+
+	jbd2_csum_stripe(&stripes[n - 1]);
+	for (i = 0; i < n - 1; i++) {
+		flush_work(&stripes[i].work);
+		destroy_work_on_stack(&stripes[i].work);
+	}
+}
+
 /*
  * jbd2_journal_commit_transaction
  *
@@ -352,6 +447,7 @@ void jbd2_journal_commit_transaction(journal_t *journal)
 	struct journal_head *jh;
 	struct buffer_head *descriptor;
 	struct buffer_head **wbuf = journal->j_wbuf;
+	journal_block_tag_t **wtag = journal->j_wtag;
 	int bufs;
 	int escape;
 	int err;
@@ -624,6 +720,7 @@ void jbd2_journal_commit_transaction(journal_t *journal)
 			first_tag = 1;
 			set_buffer_jwrite(descriptor);
 			set_buffer_dirty(descriptor);
+			wtag[bufs] = NULL;
 			wbuf[bufs++] = descriptor;
 
 			/* Record it so that we can wait for IO
@@ -680,8 +777,7 @@ void jbd2_journal_commit_transaction(journal_t *journal)
 		tag = (journal_block_tag_t *) tagp;
 		write_tag_block(journal, tag, jh2bh(jh)->b_blocknr);
 		tag->t_flags = cpu_to_be16(tag_flag);
-		jbd2_block_tag_csum_set(journal, tag, wbuf[bufs],
-					commit_transaction->t_tid);
+		wtag[bufs] = tag;
 		tagp += tag_bytes;
 		space_left -= tag_bytes;
 		bufs++;
@@ -708,6 +804,8 @@ void jbd2_journal_commit_transaction(journal_t *journal)
 
 			tag->t_flags |= cpu_to_be16(JBD2_FLAG_LAST_TAG);
 start_journal_io:
+			jbd2_block_tags_csum_set(journal, wbuf, wtag, bufs,
+						 commit_transaction->t_tid);
 			if (descriptor)
 				jbd2_descriptor_block_csum_set(journal,
 							descriptor);
@@ -1146,6 +1244,7 @@ void jbd2_journal_commit_transaction(journal_t *journal)
 	write_unlock(&journal->j_state_lock);
 	wake_up(&journal->j_wait_done_commit);
 	wake_up(&journal->j_fc_wait);
+	jbd2_log_start_checkpoint(journal);
 
 	/*
 	 * Calculate overall stats
@@ -1567,6 +1567,7 @@ static journal_t *journal_init_common(struct block_device *bdev,
 	mutex_init(&journal->j_abort_mutex);
 	mutex_init(&journal->j_barrier);
 	mutex_init(&journal->j_checkpoint_mutex);
+	INIT_WORK(&journal->j_checkpoint_work, jbd2_checkpoint_work);
 	spin_lock_init(&journal->j_revoke_lock);
 	spin_lock_init(&journal->j_list_lock);
 	spin_lock_init(&journal->j_history_lock);
@@ -1599,6 +1600,10 @@ static journal_t *journal_init_common(struct block_device *bdev,
 					GFP_KERNEL);
 	if (!journal->j_wbuf)
 		goto err_cleanup;
+	journal->j_wtag = kmalloc_array(n, sizeof(journal_block_tag_t *),
+					GFP_KERNEL);
+	if (!journal->j_wtag)
+		goto err_cleanup;
 
 	err = percpu_counter_init(&journal->j_checkpoint_jh_count, 0,
 				  GFP_KERNEL);
@@ -1627,6 +1632,7 @@ static journal_t *journal_init_common(struct block_device *bdev,
 	percpu_counter_destroy(&journal->j_checkpoint_jh_count);
 	if (journal->j_chksum_driver)
 		crypto_free_shash(journal->j_chksum_driver);
+	kfree(journal->j_wtag);
 	kfree(journal->j_wbuf);
 	jbd2_journal_destroy_revoke(journal);
 	journal_fail_superblock(journal);
@@ -2147,6 +2153,9 @@ int jbd2_journal_destroy(journal_t *journal)
 	if (journal->j_running_transaction)
 		jbd2_journal_commit_transaction(journal);
 
+	/* No more commits, so background checkpointing can't restart */
+	cancel_work_sync(&journal->j_checkpoint_work);
+
 	/* Force any old transactions to disk */
 
 	/* Totally anal locking here... */
@@ -2211,6 +2220,7 @@ int jbd2_journal_destroy(journal_t *journal)
 	if (journal->j_chksum_driver)
 		crypto_free_shash(journal->j_chksum_driver);
 	kfree(journal->j_fc_wbuf);
+	kfree(journal->j_wtag);
 	kfree(journal->j_wbuf);
 	kfree(journal);
 
@@ -3152,6 +3162,8 @@ static int __init journal_init_caches(void)
 		ret = jbd2_journal_init_inode_cache();
 	if (ret == 0)
 		ret = jbd2_journal_init_transaction_cache();
+	if (ret == 0)
+		ret = jbd2_journal_init_csum_wq();
 	return ret;
 }
 
@@ -3163,6 +3175,7 @@ static void jbd2_journal_destroy_caches(void)
 	jbd2_journal_destroy_handle_cache();
 	jbd2_journal_destroy_inode_cache();
 	jbd2_journal_destroy_transaction_cache();
+	jbd2_journal_destroy_csum_wq();
 	jbd2_journal_destroy_slabs();
 }
 
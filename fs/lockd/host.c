@@ -18,6 +18,7 @@
 #include <linux/sunrpc/svc.h>
 #include <linux/lockd/lockd.h>
 #include <linux/mutex.h>
+#include <linux/rculist.h>
 
 #include <linux/sunrpc/svc_xprt.h>
 
@@ -181,7 +182,7 @@ static void nlm_destroy_host_locked(struct nlm_host *host)
 
 	dprintk("lockd: destroy host %s\n", host->h_name);
 
-	hlist_del_init(&host->h_hash);
+	hlist_del_init_rcu(&host->h_hash);
 
 	nsm_unmonitor(host);
 	nsm_release(host->h_nsmhandle);
@@ -190,7 +191,7 @@ static void nlm_destroy_host_locked(struct nlm_host *host)
 	if (clnt != NULL)
 		rpc_shutdown_client(clnt);
 	put_cred(host->h_cred);
-	kfree(host);
+	kfree_rcu(host, h_rcu);
 
 	ln->nrhosts--;
 	nrhosts--;
@@ -270,7 +271,7 @@ struct nlm_host *nlmclnt_lookup_host(const struct sockaddr *sap,
 	if (unlikely(host == NULL))
 		goto out;
 
-	hlist_add_head(&host->h_hash, chain);
+	hlist_add_head_rcu(&host->h_hash, chain);
 	ln->nrhosts++;
 	nrhosts++;
 
@@ -306,6 +307,43 @@ void nlmclnt_release_host(struct nlm_host *host)
 	}
 }
 
+/*
+ * Look up an existing server host without taking nlm_host_mutex.
+ *
+ * Hashed server hosts hold a reference until nlm_gc_hosts() drops it
+ * with refcount_dec_if_one(), so a host whose count has already reached
+ * zero is about to be destroyed and must be looked up again under the
+ * mutex.  Hosts are freed after an RCU grace period.
+ */
+static struct nlm_host *nlmsvc_lookup_host_rcu(struct hlist_head *chain,
+					const struct nlm_lookup_host_info *ni,
+					const struct sockaddr *src_sap)
+{
+	struct nlm_host	*host;
+
+	rcu_read_lock();
+	hlist_for_each_entry_rcu(host, chain, h_hash) {
+		if (host->net != ni->net)
+			continue;
+		if (!rpc_cmp_addr(nlm_addr(host), ni->sap))
+			continue;
+		if (host->h_proto != ni->protocol)
+			continue;
+		if (host->h_version != ni->version)
+			continue;
+		if (!rpc_cmp_addr(nlm_srcaddr(host), src_sap))
+			continue;
+
+		if (!refcount_inc_not_zero(&host->h_count))
+			break;
+		host->h_expires = jiffies + NLM_HOST_EXPIRE;
+		rcu_read_unlock();
+		return host;
+	}
+	rcu_read_unlock();
+	return NULL;
+}
+
 /**
  * nlmsvc_lookup_host - Find an NLM host handle matching a remote client
  * @rqstp: incoming NLM request
@@ -350,12 +388,22 @@ struct nlm_host *nlmsvc_lookup_host(const struct svc_rqst *rqstp,
 			(int)hostname_len, hostname, rqstp->rq_vers,
 			(rqstp->rq_prot == IPPROTO_UDP ? "udp" : "tcp"));
 
+	chain = &nlm_server_hosts[nlm_hash_address(ni.sap)];
+
+	if (time_before(jiffies, READ_ONCE(ln->next_gc))) {
+		host = nlmsvc_lookup_host_rcu(chain, &ni, src_sap);
+		if (host) {
+			dprintk("lockd: %s found host %s (%s)\n",
+				__func__, host->h_name, host->h_addrbuf);
+			return host;
+		}
+	}
+
 	mutex_lock(&nlm_host_mutex);
 
 	if (time_after_eq(jiffies, ln->next_gc))
 		nlm_gc_hosts(net);
 
-	chain = &nlm_server_hosts[nlm_hash_address(ni.sap)];
 	hlist_for_each_entry(host, chain, h_hash) {
 		if (host->net != net)
 			continue;
@@ -374,8 +422,8 @@ struct nlm_host *nlmsvc_lookup_host(const struct svc_rqst *rqstp,
 			continue;
 
 		/* Move to head of hash chain. */
-		hlist_del(&host->h_hash);
-		hlist_add_head(&host->h_hash, chain);
+		hlist_del_rcu(&host->h_hash);
+		hlist_add_head_rcu(&host->h_hash, chain);
 
 		nlm_get_host(host);
 		dprintk("lockd: %s found host %s (%s)\n",
@@ -389,7 +437,7 @@ struct nlm_host *nlmsvc_lookup_host(const struct svc_rqst *rqstp,
 
 	memcpy(nlm_srcaddr(host), src_sap, src_len);
 	host->h_srcaddrlen = src_len;
-	hlist_add_head(&host->h_hash, chain);
+	hlist_add_head_rcu(&host->h_hash, chain);
 	ln->nrhosts++;
 	nrhosts++;
 
@@ -689,6 +737,6 @@ nlm_gc_hosts(struct net *net)
 	if (net) {
 		struct lockd_net *ln = net_generic(net, lockd_net_id);
 
-		ln->next_gc = jiffies + NLM_HOST_COLLECT;
+		WRITE_ONCE(ln->next_gc, jiffies + NLM_HOST_COLLECT);
 	}
 }
@@ -589,6 +589,8 @@ static int __init init_nlm(void)
 {
 	int err;
 
+	nlm_files_init();
+
 #ifdef CONFIG_SYSCTL
 	err = -ENOMEM;
 	nlm_sysctl_table = register_sysctl("fs/nfs", nlm_sysctls);
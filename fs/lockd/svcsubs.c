@@ -13,6 +13,7 @@
 #include <linux/in.h>
 #include <linux/slab.h>
 #include <linux/mutex.h>
+#include <linux/jhash.h>
 #include <linux/sunrpc/svc.h>
 #include <linux/sunrpc/addr.h>
 #include <linux/lockd/lockd.h>
@@ -25,12 +26,19 @@
 
 
 /*
- * Global file hash table
+ * Global file hash table.  Each bucket has its own mutex, so that lookups
+ * and releases of unrelated files (and the possibly slow fopen of a new
+ * one) do not serialize all NLM requests of all clients.  The bucket mutex
+ * protects the chain and the f_count of the files on it.
  */
-#define FILE_HASH_BITS		7
+#define FILE_HASH_BITS		9
 #define FILE_NRHASH		(1<<FILE_HASH_BITS)
-static struct hlist_head	nlm_files[FILE_NRHASH];
-static DEFINE_MUTEX(nlm_file_mutex);
+
+struct nlm_file_bucket {
+	struct hlist_head	files;
+	struct mutex		lock;
+};
+static struct nlm_file_bucket	nlm_files[FILE_NRHASH];
 
 #ifdef CONFIG_SUNRPC_DEBUG
 static inline void nlm_debug_print_fh(char *msg, struct nfs_fh *f)
@@ -62,13 +70,23 @@ static inline void nlm_debug_print_file(char *msg, struct nlm_file *file)
 }
 #endif
 
-static inline unsigned int file_hash(struct nfs_fh *f)
+/*
+ * File handles of one export share most of their bytes, summing them
+ * up leaves most buckets empty.
+ */
+static inline struct nlm_file_bucket *file_bucket(struct nfs_fh *f)
+{
+	return &nlm_files[jhash(f->data, NFS2_FHSIZE, 0) & (FILE_NRHASH - 1)];
+}
+
+void __init nlm_files_init(void)
 {
-	unsigned int tmp=0;
 	int i;
-	for (i=0; i<NFS2_FHSIZE;i++)
-		tmp += f->data[i];
-	return tmp & (FILE_NRHASH - 1);
+
+	for (i = 0; i < FILE_NRHASH; i++) {
+		INIT_HLIST_HEAD(&nlm_files[i].files);
+		mutex_init(&nlm_files[i].lock);
+	}
 }
 
 int lock_to_openmode(struct file_lock *lock)
@@ -105,20 +123,20 @@ __be32
 nlm_lookup_file(struct svc_rqst *rqstp, struct nlm_file **result,
 					struct nlm_lock *lock)
 {
+	struct nlm_file_bucket *bucket;
 	struct nlm_file	*file;
-	unsigned int	hash;
 	__be32		nfserr;
 	int		mode;
 
 	nlm_debug_print_fh("nlm_lookup_file", &lock->fh);
 
-	hash = file_hash(&lock->fh);
+	bucket = file_bucket(&lock->fh);
 	mode = lock_to_openmode(&lock->fl);
 
-	/* Lock file table */
-	mutex_lock(&nlm_file_mutex);
+	/* Lock file table bucket */
+	mutex_lock(&bucket->lock);
 
-	hlist_for_each_entry(file, &nlm_files[hash], f_list)
+	hlist_for_each_entry(file, &bucket->files, f_list)
 		if (!nfs_compare_fh(&file->f_handle, &lock->fh)) {
 			mutex_lock(&file->f_mutex);
 			nfserr = nlm_do_fopen(rqstp, file, mode);
@@ -141,7 +159,7 @@ nlm_lookup_file(struct svc_rqst *rqstp, struct nlm_file **result,
 	if (nfserr)
 		goto out_unlock;
 
-	hlist_add_head(&file->f_list, &nlm_files[hash]);
+	hlist_add_head(&file->f_list, &bucket->files);
 
 found:
 	dprintk("lockd: found file %p (count %d)\n", file, file->f_count);
@@ -149,7 +167,7 @@ nlm_lookup_file(struct svc_rqst *rqstp, struct nlm_file **result,
 	file->f_count++;
 
 out_unlock:
-	mutex_unlock(&nlm_file_mutex);
+	mutex_unlock(&bucket->lock);
 	return nfserr;
 
 out_free:
@@ -303,20 +321,22 @@ nlm_traverse_files(void *data, nlm_host_match_fn_t match,
 	struct nlm_file	*file;
 	int i, ret = 0;
 
-	mutex_lock(&nlm_file_mutex);
 	for (i = 0; i < FILE_NRHASH; i++) {
-		hlist_for_each_entry_safe(file, next, &nlm_files[i], f_list) {
+		struct nlm_file_bucket *bucket = &nlm_files[i];
+
+		mutex_lock(&bucket->lock);
+		hlist_for_each_entry_safe(file, next, &bucket->files, f_list) {
 			if (is_failover_file && !is_failover_file(data, file))
 				continue;
 			file->f_count++;
-			mutex_unlock(&nlm_file_mutex);
+			mutex_unlock(&bucket->lock);
 
 			/* Traverse locks, blocks and shares of this file
 			 * and update file->f_locks count */
 			if (nlm_inspect_file(data, file, match))
 				ret = 1;
 
-			mutex_lock(&nlm_file_mutex);
+			mutex_lock(&bucket->lock);
 			file->f_count--;
 			/* No more references to this file. Let go of it. */
 			if (list_empty(&file->f_blocks) && !file->f_locks
@@ -326,8 +346,8 @@ nlm_traverse_files(void *data, nlm_host_match_fn_t match,
 				kfree(file);
 			}
 		}
+		mutex_unlock(&bucket->lock);
 	}
-	mutex_unlock(&nlm_file_mutex);
 	return ret;
 }
 
@@ -343,17 +363,19 @@ nlm_traverse_files(void *data, nlm_host_match_fn_t match,
 void
 nlm_release_file(struct nlm_file *file)
 {
+	struct nlm_file_bucket *bucket = file_bucket(&file->f_handle);
+
 	dprintk("lockd: nlm_release_file(%p, ct = %d)\n",
 				file, file->f_count);
 
-	/* Lock file table */
-	mutex_lock(&nlm_file_mutex);
+	/* Lock file table bucket */
+	mutex_lock(&bucket->lock);
 
 	/* If there are no more locks etc, delete the file */
 	if (--file->f_count == 0 && !nlm_file_inuse(file))
 		nlm_delete_file(file);
 
-	mutex_unlock(&nlm_file_mutex);
+	mutex_unlock(&bucket->lock);
 }
 
 /*
@@ -154,6 +154,22 @@ static void netfs_rreq_expand(struct netfs_io_request *rreq,
 	if (rreq->netfs_ops->expand_readahead)
 		rreq->netfs_ops->expand_readahead(rreq);
 
+	/* If the data is going to be cached, prefetch up to
+	 * netfs_cache_prefetch_kb from the start of the request in one go, so
+	 * that a sequential reader populates the cache with a few large reads
+	 * rather than one per readahead window.
+	 */
+	if (netfs_cache_prefetch_kb &&
+	    fscache_resources_valid(&rreq->cache_resources)) {
+		unsigned long long prefetch = (unsigned long long)netfs_cache_prefetch_kb * 1024;
+		unsigned long long end = min_t(unsigned long long,
+					       rreq->start + prefetch,
+					       round_up(rreq->i_size, PAGE_SIZE));
+
+		if (end > rreq->start + rreq->len)
+			rreq->len = end - rreq->start;
+	}
+
 	/* Expand the request if the cache wants it to start earlier.  Note
 	 * that the expansion may get further extended if the VM wishes to
 	 * insert THPs and the preferred start and/or end wind up in the middle
@@ -24,6 +24,10 @@ unsigned netfs_debug;
 module_param_named(debug, netfs_debug, uint, S_IWUSR | S_IRUGO);
 MODULE_PARM_DESC(netfs_debug, "Netfs support debugging mask");
 
+unsigned int netfs_cache_prefetch_kb;
+module_param_named(cache_prefetch_kb, netfs_cache_prefetch_kb, uint, 0644);
+MODULE_PARM_DESC(cache_prefetch_kb, "Amount to read ahead into the cache, in KiB");
+
 static struct kmem_cache *netfs_request_slab;
 static struct kmem_cache *netfs_subrequest_slab;
 mempool_t netfs_request_pool;
@@ -36,6 +36,8 @@ enum nfs4_ff_op_type {
 };
 
 static unsigned short io_maxretrans;
+static unsigned int read_stripe_size;
+static bool read_fastest_mirror;
 
 static const struct pnfs_commit_ops ff_layout_commit_ops;
 static void ff_layout_read_record_layoutstats_done(struct rpc_task *task,
@@ -738,6 +740,25 @@ ff_layout_mark_ds_reachable(struct pnfs_layout_segment *lseg, u32 idx)
 		nfs4_mark_deviceid_available(devid);
 }
 
+static void
+ff_layout_mark_mirror_read_err(struct nfs4_ff_layout_mirror *mirror)
+{
+	/* 0 means no error, jiffies may happen to be 0 */
+	WRITE_ONCE(mirror->read_err_time, jiffies | 1);
+}
+
+static bool
+ff_layout_mirror_read_err_recent(struct nfs4_ff_layout_mirror *mirror)
+{
+	unsigned long t = READ_ONCE(mirror->read_err_time);
+
+	return t && time_before(jiffies, t + FF_LAYOUT_READ_ERR_HOLDOFF);
+}
+
+/*
+ * With @check_device, mirrors whose device is unavailable or that recently
+ * failed a read are skipped.
+ */
 static struct nfs4_pnfs_ds *
 ff_layout_choose_ds_for_read(struct pnfs_layout_segment *lseg,
 			     u32 start_idx, u32 *best_idx,
@@ -756,7 +777,8 @@ ff_layout_choose_ds_for_read(struct pnfs_layout_segment *lseg,
 			continue;
 
 		if (check_device &&
-		    nfs4_test_deviceid_unavailable(&mirror->mirror_ds->id_node))
+		    (nfs4_test_deviceid_unavailable(&mirror->mirror_ds->id_node) ||
+		     ff_layout_mirror_read_err_recent(mirror)))
 			continue;
 
 		*best_idx = idx;
@@ -792,6 +814,67 @@ ff_layout_choose_best_ds_for_read(struct pnfs_layout_segment *lseg,
 	return ff_layout_choose_any_ds_for_read(lseg, start_idx, best_idx);
 }
 
+/*
+ * Size of the chunks a read is striped in over the mirrors of @lseg,
+ * or 0 if reads of @lseg are not striped.
+ */
+static u32
+ff_layout_read_stripe_unit(struct pnfs_layout_segment *lseg)
+{
+	if (FF_LAYOUT_MIRROR_COUNT(lseg) < 2)
+		return 0;
+	return READ_ONCE(read_stripe_size);
+}
+
+/*
+ * Average completion time of the reads sent to a mirror, in nanoseconds.
+ * A mirror that has not completed any read yet reports 0, so that it gets
+ * tried and measured. Mirrors that recently failed a read are not
+ * considered at all.
+ */
+static u64
+ff_layout_mirror_read_latency(struct nfs4_ff_layout_mirror *mirror)
+{
+	u64 ops, total;
+
+	spin_lock(&mirror->lock);
+	ops = mirror->read_stat.io_stat.ops_completed;
+	total = ktime_to_ns(mirror->read_stat.io_stat.aggregate_completion_time);
+	spin_unlock(&mirror->lock);
+
+	return ops ? div64_u64(total, ops) : 0;
+}
+
+static struct nfs4_pnfs_ds *
+ff_layout_choose_fastest_ds_for_read(struct pnfs_layout_segment *lseg,
+				     u32 *best_idx)
+{
+	struct nfs4_ff_layout_segment *fls = FF_LAYOUT_LSEG(lseg);
+	struct nfs4_ff_layout_mirror *mirror;
+	struct nfs4_pnfs_ds *ds, *best = NULL;
+	u64 latency, best_latency = U64_MAX;
+	u32 idx;
+
+	for (idx = 0; idx < fls->mirror_array_cnt; idx++) {
+		mirror = FF_LAYOUT_COMP(lseg, idx);
+		ds = nfs4_ff_layout_prepare_ds(lseg, mirror, false);
+		if (!ds)
+			continue;
+		if (nfs4_test_deviceid_unavailable(&mirror->mirror_ds->id_node) ||
+		    ff_layout_mirror_read_err_recent(mirror))
+			continue;
+
+		latency = ff_layout_mirror_read_latency(mirror);
+		if (latency < best_latency) {
+			best_latency = latency;
+			best = ds;
+			*best_idx = idx;
+		}
+	}
+
+	return best;
+}
+
 static struct nfs4_pnfs_ds *
 ff_layout_get_ds_for_read(struct nfs_pageio_descriptor *pgio,
 			  u32 *best_idx)
@@ -799,6 +882,13 @@ ff_layout_get_ds_for_read(struct nfs_pageio_descriptor *pgio,
 	struct pnfs_layout_segment *lseg = pgio->pg_lseg;
 	struct nfs4_pnfs_ds *ds;
 
+	if (READ_ONCE(read_fastest_mirror) && FF_LAYOUT_MIRROR_COUNT(lseg) > 1 &&
+	    !ff_layout_read_stripe_unit(lseg)) {
+		ds = ff_layout_choose_fastest_ds_for_read(lseg, best_idx);
+		if (ds)
+			return ds;
+	}
+
 	ds = ff_layout_choose_best_ds_for_read(lseg, pgio->pg_mirror_idx,
 					       best_idx);
 	if (ds || !pgio->pg_mirror_idx)
@@ -822,6 +912,21 @@ ff_layout_pg_get_read(struct nfs_pageio_descriptor *pgio,
 	}
 }
 
+/*
+ * With read striping, consecutive stripes of a segment start their data
+ * server search at consecutive mirrors, so that a large read keeps all
+ * mirrors busy.
+ */
+static u32
+ff_layout_read_stripe_mirror(struct pnfs_layout_segment *lseg,
+			     struct nfs_page *req, u32 stripe_unit)
+{
+	u64 stripe = req_offset(req) - lseg->pls_range.offset;
+
+	stripe = div_u64(stripe, stripe_unit);
+	return do_div(stripe, FF_LAYOUT_MIRROR_COUNT(lseg));
+}
+
 static void
 ff_layout_pg_init_read(struct nfs_pageio_descriptor *pgio,
 			struct nfs_page *req)
@@ -829,6 +934,7 @@ ff_layout_pg_init_read(struct nfs_pageio_descriptor *pgio,
 	struct nfs_pgio_mirror *pgm;
 	struct nfs4_ff_layout_mirror *mirror;
 	struct nfs4_pnfs_ds *ds;
+	u32 stripe_unit;
 	u32 ds_idx;
 
 retry:
@@ -845,6 +951,12 @@ ff_layout_pg_init_read(struct nfs_pageio_descriptor *pgio,
 			goto out_nolseg;
 	}
 
+	stripe_unit = ff_layout_read_stripe_unit(pgio->pg_lseg);
+	if (stripe_unit)
+		pgio->pg_mirror_idx = ff_layout_read_stripe_mirror(pgio->pg_lseg,
+								   req,
+								   stripe_unit);
+
 	ds = ff_layout_get_ds_for_read(pgio, &ds_idx);
 	if (!ds) {
 		if (!ff_layout_no_fallback_to_mds(pgio->pg_lseg))
@@ -983,9 +1095,46 @@ ff_layout_pg_get_mirror_write(struct nfs_pageio_descriptor *desc, u32 idx)
 	return &desc->pg_mirrors[idx];
 }
 
+/*
+ * Don't let a read RPC cross a stripe boundary when reads are striped
+ * over the mirrors, each stripe is sent to its own data server.
+ */
+static size_t
+ff_layout_pg_test_read(struct nfs_pageio_descriptor *pgio,
+		       struct nfs_page *prev, struct nfs_page *req)
+{
+	u64 p_stripe, r_stripe, segment_offset;
+	u32 stripe_unit, stripe_offset;
+	size_t size;
+
+	size = pnfs_generic_pg_test(pgio, prev, req);
+	if (!size || !pgio->pg_lseg)
+		return size;
+	stripe_unit = ff_layout_read_stripe_unit(pgio->pg_lseg);
+	if (!stripe_unit)
+		return size;
+
+	segment_offset = pgio->pg_lseg->pls_range.offset;
+
+	/* see if req and prev are in the same stripe */
+	if (prev) {
+		p_stripe = div_u64(req_offset(prev) - segment_offset,
+				   stripe_unit);
+		r_stripe = div_u64(req_offset(req) - segment_offset,
+				   stripe_unit);
+		if (p_stripe != r_stripe)
+			return 0;
+	}
+
+	/* calculate remaining bytes in the current stripe */
+	div_u64_rem(req_offset(req) - segment_offset, stripe_unit,
+		    &stripe_offset);
+	return min_t(size_t, stripe_unit - stripe_offset, size);
+}
+
 static const struct nfs_pageio_ops ff_layout_pg_read_ops = {
 	.pg_init = ff_layout_pg_init_read,
-	.pg_test = pnfs_generic_pg_test,
+	.pg_test = ff_layout_pg_test_read,
 	.pg_doio = pnfs_generic_pg_readpages,
 	.pg_cleanup = pnfs_generic_pg_cleanup,
 };
@@ -1038,9 +1187,18 @@ static void ff_layout_reset_write(struct nfs_pgio_header *hdr, bool retry_pnfs)
 
 static void ff_layout_resend_pnfs_read(struct nfs_pgio_header *hdr)
 {
+	struct nfs4_ff_layout_mirror *mirror;
 	u32 idx = hdr->pgio_mirror_idx + 1;
 	u32 new_idx = 0;
 
+	/*
+	 * Keep the failed mirror out of read selection for a while, striping
+	 * and fastest mirror selection would otherwise pick it again instead
+	 * of new_idx.
+	 */
+	mirror = FF_LAYOUT_COMP(hdr->lseg, hdr->pgio_mirror_idx);
+	if (mirror)
+		ff_layout_mark_mirror_read_err(mirror);
 	if (ff_layout_choose_any_ds_for_read(hdr->lseg, idx, &new_idx))
 		ff_layout_send_layouterror(hdr->lseg);
 	else
@@ -2613,3 +2771,9 @@ module_exit(nfs4flexfilelayout_exit);
 module_param(io_maxretrans, ushort, 0644);
 MODULE_PARM_DESC(io_maxretrans, "The  number of times the NFSv4.1 client "
 			"retries an I/O request before returning an error. ");
+module_param(read_stripe_size, uint, 0644);
+MODULE_PARM_DESC(read_stripe_size, "Split reads into chunks of this many "
+			"bytes and spread them over all mirrors (0 = off)");
+module_param(read_fastest_mirror, bool, 0644);
+MODULE_PARM_DESC(read_fastest_mirror, "Read from the mirror with the lowest "
+			"average read latency");
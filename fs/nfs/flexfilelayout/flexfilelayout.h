@@ -90,10 +90,14 @@ struct nfs4_ff_layout_mirror {
 	struct nfs4_ff_layoutstat	write_stat;
 	ktime_t				start_time;
 	u32				report_interval;
+	unsigned long			read_err_time;
 };
 
 #define NFS4_FF_MIRROR_STAT_AVAIL	(0)
 
+/* How long a mirror that failed a read is passed over by read selection */
+#define FF_LAYOUT_READ_ERR_HOLDOFF	(5 * HZ)
+
 struct nfs4_ff_layout_segment {
 	struct pnfs_layout_segment	generic_hdr;
 	u64				stripe_unit;
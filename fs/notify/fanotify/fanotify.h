@@ -467,11 +467,13 @@ static inline const struct path *fanotify_event_path(struct fanotify_event *even
 }
 
 /*
- * Use 128 size hash table to speed up events merge.
+ * Use a hash table of 128 to 4096 buckets, sized for the group's queue
+ * length, to speed up events merge.
  */
 #define FANOTIFY_HTABLE_BITS	(7)
-#define FANOTIFY_HTABLE_SIZE	(1 << FANOTIFY_HTABLE_BITS)
-#define FANOTIFY_HTABLE_MASK	(FANOTIFY_HTABLE_SIZE - 1)
+#define FANOTIFY_HTABLE_MAX_BITS	(12)
+/* Expected number of queued events per bucket with a full queue */
+#define FANOTIFY_HTABLE_LOAD	(32)
 
 /*
  * Permission events and overflow event do not get merged - don't hash them.
@@ -486,7 +488,7 @@ static inline unsigned int fanotify_event_hash_bucket(
 						struct fsnotify_group *group,
 						struct fanotify_event *event)
 {
-	return event->hash & FANOTIFY_HTABLE_MASK;
+	return event->hash & ((1U << group->fanotify_data.merge_hash_bits) - 1);
 }
 
 struct fanotify_mark {
@@ -1382,16 +1382,22 @@ static struct fsnotify_event *fanotify_alloc_overflow_event(void)
 	return &oevent->fse;
 }
 
-static struct hlist_head *fanotify_alloc_merge_hash(void)
+static struct hlist_head *fanotify_alloc_merge_hash(struct fsnotify_group *group)
 {
+	unsigned int bits = FANOTIFY_HTABLE_BITS;
 	struct hlist_head *hash;
 
-	hash = kmalloc(sizeof(struct hlist_head) << FANOTIFY_HTABLE_BITS,
-		       GFP_KERNEL_ACCOUNT);
+	if (group->max_events / FANOTIFY_HTABLE_LOAD > 1)
+		bits = clamp_t(unsigned int,
+			       ilog2(group->max_events / FANOTIFY_HTABLE_LOAD),
+			       FANOTIFY_HTABLE_BITS, FANOTIFY_HTABLE_MAX_BITS);
+
+	hash = kvmalloc(sizeof(struct hlist_head) << bits, GFP_KERNEL_ACCOUNT);
 	if (!hash)
 		return NULL;
 
-	__hash_init(hash, FANOTIFY_HTABLE_SIZE);
+	__hash_init(hash, 1U << bits);
+	group->fanotify_data.merge_hash_bits = bits;
 
 	return hash;
 }
@@ -1497,12 +1503,6 @@ SYSCALL_DEFINE2(fanotify_init, unsigned int, flags, unsigned int, event_f_flags)
 	group->fanotify_data.flags = flags | internal_flags;
 	group->memcg = get_mem_cgroup_from_mm(current->mm);
 
-	group->fanotify_data.merge_hash = fanotify_alloc_merge_hash();
-	if (!group->fanotify_data.merge_hash) {
-		fd = -ENOMEM;
-		goto out_destroy_group;
-	}
-
 	group->overflow_event = fanotify_alloc_overflow_event();
 	if (unlikely(!group->overflow_event)) {
 		fd = -ENOMEM;
@@ -1538,6 +1538,12 @@ SYSCALL_DEFINE2(fanotify_init, unsigned int, flags, unsigned int, event_f_flags)
 		group->max_events = fanotify_max_queued_events;
 	}
 
+	group->fanotify_data.merge_hash = fanotify_alloc_merge_hash(group);
+	if (!group->fanotify_data.merge_hash) {
+		fd = -ENOMEM;
+		goto out_destroy_group;
+	}
+
 	if (flags & FAN_UNLIMITED_MARKS) {
 		fd = -EPERM;
 		if (!capable(CAP_SYS_ADMIN))
@@ -121,7 +121,7 @@ void __dlm_queue_ast(struct dlm_ctxt *dlm, struct dlm_lock *lock)
 		 * taken here */
 		dlm_lockres_release_ast(dlm, res);
 	}
-	list_add_tail(&lock->ast_list, &dlm->pending_asts);
+	list_add_tail(&lock->ast_list, &dlm_ast_shard(dlm, res)->pending_asts);
 	lock->ast_pending = 1;
 	spin_unlock(&lock->spinlock);
 }
@@ -158,7 +158,8 @@ void __dlm_queue_bast(struct dlm_ctxt *dlm, struct dlm_lock *lock)
 	/* putting lock on list, add a ref */
 	dlm_lock_get(lock);
 	spin_lock(&lock->spinlock);
-	list_add_tail(&lock->bast_list, &dlm->pending_basts);
+	list_add_tail(&lock->bast_list,
+		      &dlm_ast_shard(dlm, res)->pending_basts);
 	lock->bast_pending = 1;
 	spin_unlock(&lock->spinlock);
 }
@@ -9,6 +9,7 @@
 #define DLMCOMMON_H
 
 #include <linux/kref.h>
+#include <linux/hash.h>
 
 #define DLM_HB_NODE_DOWN_PRI     (0xf000000)
 #define DLM_HB_NODE_UP_PRI       (0x8000000)
@@ -29,6 +30,9 @@
 /* Intended to make it easier for us to switch out hash functions */
 #define dlm_lockid_hash(_n, _l) full_name_hash(NULL, _n, _l)
 
+/* Upper bound on the number of workers delivering ASTs/BASTs per domain */
+#define DLM_AST_SHARDS		8
+
 enum dlm_mle_type {
 	DLM_MLE_BLOCK = 0,
 	DLM_MLE_MASTER = 1,
@@ -96,6 +100,22 @@ struct dlm_recovery_ctxt
 	wait_queue_head_t event;
 };
 
+struct dlm_ctxt;
+
+/*
+ * Pending ASTs and BASTs are spread over a few shards by lock resource.
+ * Each shard is drained by one worker at a time, so all callbacks for a
+ * given lockres are still delivered in queueing order, while callbacks for
+ * unrelated lockres (and the network messages of the remote ones) proceed
+ * in parallel.  Protected by dlm->ast_lock.
+ */
+struct dlm_ast_shard {
+	struct list_head pending_asts;
+	struct list_head pending_basts;
+	struct work_struct work;
+	struct dlm_ctxt *dlm;
+};
+
 enum dlm_ctxt_state {
 	DLM_CTXT_NEW = 0,
 	DLM_CTXT_JOINED = 1,
@@ -109,8 +129,8 @@ struct dlm_ctxt
 	struct hlist_head **lockres_hash;
 	struct list_head dirty_list;
 	struct list_head purge_list;
-	struct list_head pending_asts;
-	struct list_head pending_basts;
+	struct dlm_ast_shard ast_shards[DLM_AST_SHARDS];
+	unsigned int num_ast_shards;
 	struct list_head tracking_list;
 	unsigned int purge_count;
 	spinlock_t spinlock;
@@ -149,6 +169,7 @@ struct dlm_ctxt
 	struct task_struct *dlm_thread_task;
 	struct task_struct *dlm_reco_thread_task;
 	struct workqueue_struct *dlm_worker;
+	struct workqueue_struct *dlm_ast_worker;
 	wait_queue_head_t dlm_thread_wq;
 	wait_queue_head_t dlm_reco_thread_wq;
 	wait_queue_head_t ast_wq;
@@ -172,6 +193,12 @@ static inline struct hlist_head *dlm_lockres_hash(struct dlm_ctxt *dlm, unsigned
 	return dlm->lockres_hash[(i / DLM_BUCKETS_PER_PAGE) % DLM_HASH_PAGES] + (i % DLM_BUCKETS_PER_PAGE);
 }
 
+static inline struct dlm_ast_shard *
+dlm_ast_shard(struct dlm_ctxt *dlm, struct dlm_lock_resource *res)
+{
+	return &dlm->ast_shards[hash_ptr(res, 32) % dlm->num_ast_shards];
+}
+
 static inline struct hlist_head *dlm_master_hash(struct dlm_ctxt *dlm,
 						 unsigned i)
 {
@@ -836,6 +863,7 @@ void dlm_commit_pending_unlock(struct dlm_lock_resource *res,
 
 int dlm_launch_thread(struct dlm_ctxt *dlm);
 void dlm_complete_thread(struct dlm_ctxt *dlm);
+void dlm_ast_shard_work(struct work_struct *work);
 int dlm_launch_recovery_thread(struct dlm_ctxt *dlm);
 void dlm_complete_recovery_thread(struct dlm_ctxt *dlm);
 void dlm_wait_for_recovery(struct dlm_ctxt *dlm);
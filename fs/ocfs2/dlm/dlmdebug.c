@@ -663,10 +663,18 @@ static int debug_state_print(struct dlm_ctxt *dlm, char *buf, int len)
 	struct dlm_reco_node_data *node;
 	char *state;
 	int cur_mles = 0, tot_mles = 0;
+	bool pending_asts = false, pending_basts = false;
 	int i;
 
 	spin_lock(&dlm->spinlock);
 
+	for (i = 0; i < dlm->num_ast_shards; i++) {
+		if (!list_empty(&dlm->ast_shards[i].pending_asts))
+			pending_asts = true;
+		if (!list_empty(&dlm->ast_shards[i].pending_basts))
+			pending_basts = true;
+	}
+
 	switch (dlm->dlm_state) {
 	case DLM_CTXT_NEW:
 		state = "NEW"; break;
@@ -754,8 +762,8 @@ static int debug_state_print(struct dlm_ctxt *dlm, char *buf, int len)
 			"PendingBASTs=%s\n",
 			(list_empty(&dlm->dirty_list) ? "Empty" : "InUse"),
 			(list_empty(&dlm->purge_list) ? "Empty" : "InUse"),
-			(list_empty(&dlm->pending_asts) ? "Empty" : "InUse"),
-			(list_empty(&dlm->pending_basts) ? "Empty" : "InUse"));
+			(pending_asts ? "InUse" : "Empty"),
+			(pending_basts ? "InUse" : "Empty"));
 
 	/* Purge Count: xxx  Refs: xxx */
 	out += scnprintf(buf + out, len - out,
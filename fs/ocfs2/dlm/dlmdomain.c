@@ -380,6 +380,10 @@ static void dlm_destroy_dlm_worker(struct dlm_ctxt *dlm)
 		destroy_workqueue(dlm->dlm_worker);
 		dlm->dlm_worker = NULL;
 	}
+	if (dlm->dlm_ast_worker) {
+		destroy_workqueue(dlm->dlm_ast_worker);
+		dlm->dlm_ast_worker = NULL;
+	}
 }
 
 static void dlm_complete_dlm_shutdown(struct dlm_ctxt *dlm)
@@ -1883,6 +1887,18 @@ static int dlm_join_domain(struct dlm_ctxt *dlm)
 		goto bail;
 	}
 
+	if (dlm->num_ast_shards > 1) {
+		snprintf(wq_name, O2NM_MAX_NAME_LEN, "dlm_ast-%s", dlm->name);
+		dlm->dlm_ast_worker = alloc_workqueue(wq_name,
+					WQ_MEM_RECLAIM | WQ_UNBOUND,
+					dlm->num_ast_shards - 1);
+		if (!dlm->dlm_ast_worker) {
+			status = -ENOMEM;
+			mlog_errno(status);
+			goto bail;
+		}
+	}
+
 	do {
 		status = dlm_try_to_join_domain(dlm);
 
@@ -1998,8 +2014,16 @@ static struct dlm_ctxt *dlm_alloc_ctxt(const char *domain,
 	INIT_LIST_HEAD(&dlm->tracking_list);
 	dlm->reco.state = 0;
 
-	INIT_LIST_HEAD(&dlm->pending_asts);
-	INIT_LIST_HEAD(&dlm->pending_basts);
+	dlm->num_ast_shards = clamp_t(unsigned int, num_online_cpus(), 1,
+				      DLM_AST_SHARDS);
+	for (i = 0; i < DLM_AST_SHARDS; i++) {
+		struct dlm_ast_shard *shard = &dlm->ast_shards[i];
+
+		INIT_LIST_HEAD(&shard->pending_asts);
+		INIT_LIST_HEAD(&shard->pending_basts);
+		INIT_WORK(&shard->work, dlm_ast_shard_work);
+		shard->dlm = dlm;
+	}
 
 	mlog(0, "dlm->recovery_map=%p, &(dlm->recovery_map[0])=%p\n",
 		  dlm->recovery_map, &(dlm->recovery_map[0]));
@@ -2011,6 +2035,7 @@ static struct dlm_ctxt *dlm_alloc_ctxt(const char *domain,
 	dlm->dlm_thread_task = NULL;
 	dlm->dlm_reco_thread_task = NULL;
 	dlm->dlm_worker = NULL;
+	dlm->dlm_ast_worker = NULL;
 	init_waitqueue_head(&dlm->dlm_thread_wq);
 	init_waitqueue_head(&dlm->dlm_reco_thread_wq);
 	init_waitqueue_head(&dlm->reco.event);
@@ -566,7 +566,8 @@ static int dlm_dirty_list_empty(struct dlm_ctxt *dlm)
 	return empty;
 }
 
-static void dlm_flush_asts(struct dlm_ctxt *dlm)
+static void dlm_flush_shard_asts(struct dlm_ctxt *dlm,
+				 struct dlm_ast_shard *shard)
 {
 	int ret;
 	struct dlm_lock *lock;
@@ -574,8 +575,8 @@ static void dlm_flush_asts(struct dlm_ctxt *dlm)
 	u8 hi;
 
 	spin_lock(&dlm->ast_lock);
-	while (!list_empty(&dlm->pending_asts)) {
-		lock = list_entry(dlm->pending_asts.next,
+	while (!list_empty(&shard->pending_asts)) {
+		lock = list_entry(shard->pending_asts.next,
 				  struct dlm_lock, ast_list);
 		/* get an extra ref on lock */
 		dlm_lock_get(lock);
@@ -618,8 +619,8 @@ static void dlm_flush_asts(struct dlm_ctxt *dlm)
 		dlm_lockres_release_ast(dlm, res);
 	}
 
-	while (!list_empty(&dlm->pending_basts)) {
-		lock = list_entry(dlm->pending_basts.next,
+	while (!list_empty(&shard->pending_basts)) {
+		lock = list_entry(shard->pending_basts.next,
 				  struct dlm_lock, bast_list);
 		/* get an extra ref on lock */
 		dlm_lock_get(lock);
@@ -673,6 +674,52 @@ static void dlm_flush_asts(struct dlm_ctxt *dlm)
 	spin_unlock(&dlm->ast_lock);
 }
 
+void dlm_ast_shard_work(struct work_struct *work)
+{
+	struct dlm_ast_shard *shard =
+		container_of(work, struct dlm_ast_shard, work);
+
+	dlm_flush_shard_asts(shard->dlm, shard);
+}
+
+static void dlm_flush_asts(struct dlm_ctxt *dlm)
+{
+	struct dlm_ast_shard *shard;
+	unsigned long busy = 0;
+	unsigned int i;
+
+	spin_lock(&dlm->ast_lock);
+	for (i = 0; i < dlm->num_ast_shards; i++) {
+		shard = &dlm->ast_shards[i];
+		if (!list_empty(&shard->pending_asts) ||
+		    !list_empty(&shard->pending_basts))
+			__set_bit(i, &busy);
+	}
+	spin_unlock(&dlm->ast_lock);
+
+	/* The worker is only around once the domain is being joined */
+	if (!dlm->dlm_ast_worker) {
+		for_each_set_bit(i, &busy, dlm->num_ast_shards)
+			dlm_flush_shard_asts(dlm, &dlm->ast_shards[i]);
+		return;
+	}
+
+	/*
+	 * Deliver the first busy shard from here and the others from the
+	 * workers, then wait for all of them so that the next pass over the
+	 * dirty list starts with no callbacks in flight, like before.
+	 */
+	for_each_set_bit(i, &busy, dlm->num_ast_shards) {
+		if (i != __ffs(busy))
+			queue_work(dlm->dlm_ast_worker,
+				   &dlm->ast_shards[i].work);
+	}
+	if (busy)
+		dlm_flush_shard_asts(dlm, &dlm->ast_shards[__ffs(busy)]);
+	for_each_set_bit(i, &busy, dlm->num_ast_shards)
+		flush_work(&dlm->ast_shards[i].work);
+}
+
 
 #define DLM_THREAD_TIMEOUT_MS (4 * 1000)
 #define DLM_THREAD_MAX_DIRTY  100
@@ -19,6 +19,7 @@
 #include <linux/delay.h>
 #include <linux/quotaops.h>
 #include <linux/sched/signal.h>
+#include <linux/moduleparam.h>
 
 #define MLOG_MASK_PREFIX ML_DLM_GLUE
 #include <cluster/masklog.h>
@@ -55,6 +56,15 @@ struct ocfs2_mask_waiter {
 #endif
 };
 
+/*
+ * Minimum time in milliseconds a node keeps a cluster lock after it was
+ * granted before honouring a downconvert request, so that nodes alternating
+ * on a resource get some local work done per lock round-trip.  0 disables
+ * it.
+ */
+static unsigned int ocfs2_dc_hold_ms;
+module_param_named(dc_hold_ms, ocfs2_dc_hold_ms, uint, 0644);
+
 static struct ocfs2_super *ocfs2_get_dentry_osb(struct ocfs2_lock_res *lockres);
 static struct ocfs2_super *ocfs2_get_inode_osb(struct ocfs2_lock_res *lockres);
 static struct ocfs2_super *ocfs2_get_file_osb(struct ocfs2_lock_res *lockres);
@@ -944,6 +954,7 @@ static inline void ocfs2_generic_handle_convert_action(struct ocfs2_lock_res *lo
 		lockres_or_flags(lockres, OCFS2_LOCK_NEEDS_REFRESH);
 
 	lockres->l_level = lockres->l_requested;
+	lockres->l_granted = jiffies;
 
 	/*
 	 * We set the OCFS2_LOCK_UPCONVERT_FINISHING flag before clearing
@@ -971,6 +982,7 @@ static inline void ocfs2_generic_handle_attach_action(struct ocfs2_lock_res *loc
 		lockres_or_flags(lockres, OCFS2_LOCK_NEEDS_REFRESH);
 
 	lockres->l_level = lockres->l_requested;
+	lockres->l_granted = jiffies;
 	lockres_or_flags(lockres, OCFS2_LOCK_ATTACHED);
 	lockres_clear_flags(lockres, OCFS2_LOCK_BUSY);
 }
@@ -3811,6 +3823,18 @@ static int ocfs2_unblock_lock(struct ocfs2_super *osb,
 	if (lockres->l_flags & OCFS2_LOCK_UPCONVERT_FINISHING)
 		goto leave_requeue;
 
+	/*
+	 * Hold on to a recently granted lock for a little while (see
+	 * dc_hold_ms), the downconvert thread comes back to it once the
+	 * hold time is over.
+	 */
+	if (ocfs2_dc_hold_ms && lockres->l_level > DLM_LOCK_NL &&
+	    time_before(jiffies, lockres->l_granted +
+			msecs_to_jiffies(ocfs2_dc_hold_ms))) {
+		mlog(ML_BASTS, "lockres %s, ReQ: Held\n", lockres->l_name);
+		goto leave_requeue;
+	}
+
 	/*
 	 * How can we block and yet be at NL?  We were trying to upconvert
 	 * from NL and got canceled.  The code comes back here, and now
@@ -4445,10 +4469,16 @@ static int ocfs2_downconvert_thread(void *arg)
 	 * work available */
 	while (!(kthread_should_stop() &&
 		ocfs2_downconvert_thread_lists_empty(osb))) {
+		unsigned int hold_ms = READ_ONCE(ocfs2_dc_hold_ms);
+		long timeout = MAX_SCHEDULE_TIMEOUT;
+
+		/* revisit locks requeued because they are still held */
+		if (hold_ms && !ocfs2_downconvert_thread_lists_empty(osb))
+			timeout = msecs_to_jiffies(hold_ms);
 
-		wait_event_interruptible(osb->dc_event,
+		wait_event_interruptible_timeout(osb->dc_event,
 					 ocfs2_downconvert_thread_should_wake(osb) ||
-					 kthread_should_stop());
+					 kthread_should_stop(), timeout);
 
 		mlog(0, "downconvert_thread: awoken\n");
 
@@ -178,6 +178,8 @@ struct ocfs2_lock_res {
 	/* Data packed - enum type ocfs2_unlock_action */
 	unsigned char            l_unlock_action;
 	unsigned int             l_pending_gen;
+	/* jiffies of the last upconvert grant, see ocfs2_unblock_lock() */
+	unsigned long            l_granted;
 
 	spinlock_t               l_lock;
 
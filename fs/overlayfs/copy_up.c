@@ -254,6 +254,7 @@ static int ovl_copy_up_file(struct ovl_fs *ofs, struct dentry *dentry,
 	loff_t data_pos = -1;
 	loff_t hole_len;
 	bool skip_hole = false;
+	bool copy_range = true;
 	int error = 0;
 
 	ovl_path_lowerdata(dentry, &datapath);
@@ -331,6 +332,29 @@ static int ovl_copy_up_file(struct ovl_fs *ofs, struct dentry *dentry,
 		if (error)
 			break;
 
+		/*
+		 * Let the filesystem copy the chunk itself if it can (e.g.
+		 * server side copy), which is a lot cheaper for large files
+		 * than moving every page through a pipe.
+		 */
+		if (copy_range) {
+			bytes = vfs_copy_file_range(old_file, old_pos,
+						    new_file, new_pos,
+						    this_len, 0);
+			if (bytes > 0) {
+				old_pos += bytes;
+				new_pos += bytes;
+				len -= bytes;
+				continue;
+			}
+			if (bytes < 0 && bytes != -EOPNOTSUPP &&
+			    bytes != -EXDEV && bytes != -EINVAL) {
+				error = bytes;
+				break;
+			}
+			copy_range = false;
+		}
+
 		bytes = do_splice_direct(old_file, &old_pos,
 					 new_file, &new_pos,
 					 this_len, SPLICE_F_MOVE);
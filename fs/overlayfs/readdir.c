@@ -31,6 +31,7 @@ struct ovl_cache_entry {
 
 struct ovl_dir_cache {
 	long refcount;
+	bool pinned;	/* the inode holds a reference, see ovl_cache_get() */
 	u64 version;
 	struct list_head entries;
 	struct rb_root root;
@@ -239,10 +240,8 @@ void ovl_dir_cache_free(struct inode *inode)
 	}
 }
 
-static void ovl_cache_put(struct ovl_dir_file *od, struct inode *inode)
+static void __ovl_cache_put(struct ovl_dir_cache *cache, struct inode *inode)
 {
-	struct ovl_dir_cache *cache = od->cache;
-
 	WARN_ON(cache->refcount <= 0);
 	cache->refcount--;
 	if (!cache->refcount) {
@@ -254,6 +253,11 @@ static void ovl_cache_put(struct ovl_dir_file *od, struct inode *inode)
 	}
 }
 
+static void ovl_cache_put(struct ovl_dir_file *od, struct inode *inode)
+{
+	__ovl_cache_put(od->cache, inode);
+}
+
 static bool ovl_fill_merge(struct dir_context *ctx, const char *name,
 			  int namelen, loff_t offset, u64 ino,
 			  unsigned int d_type)
@@ -409,6 +413,10 @@ static struct ovl_dir_cache *ovl_cache_get(struct dentry *dentry)
 		cache->refcount++;
 		return cache;
 	}
+	if (cache && cache->pinned) {
+		cache->pinned = false;
+		__ovl_cache_put(cache, inode);
+	}
 	ovl_set_dir_cache(d_inode(dentry), NULL);
 
 	cache = kzalloc(sizeof(struct ovl_dir_cache), GFP_KERNEL);
@@ -426,6 +434,16 @@ static struct ovl_dir_cache *ovl_cache_get(struct dentry *dentry)
 		return ERR_PTR(res);
 	}
 
+	/*
+	 * Lower layers don't change, so as long as there is no upper dir the
+	 * merged entries stay valid after the last close.  Keep them on the
+	 * inode so that reopening a big merged dir doesn't read and merge
+	 * all layers again; the cache goes away with the inode.
+	 */
+	if (!ovl_dentry_upper(dentry)) {
+		cache->refcount++;
+		cache->pinned = true;
+	}
 	cache->version = ovl_inode_version_get(inode);
 	ovl_set_dir_cache(inode, cache);
 
@@ -19,6 +19,11 @@
  * To avoid out of memory and fragmentation issues with vmalloc the cache
  * uses sequences of kmalloced PAGE_SIZE buffers.
  *
+ * A cache starts out with its minimum number of entries and grows on misses
+ * up to its maximum, so that workloads touching many fragments (e.g. lots of
+ * small files) stop re-reading and re-decompressing the same blocks.  Unused
+ * entries above the minimum are given back through a shrinker.
+ *
  * It should be noted that the cache is not used for file datablocks, these
  * are decompressed and cached in the page-cache in the normal way.  The
  * cache is only used to temporarily cache fragment and metadata blocks
@@ -39,12 +44,128 @@
 #include <linux/spinlock.h>
 #include <linux/wait.h>
 #include <linux/pagemap.h>
+#include <linux/shrinker.h>
 
 #include "squashfs_fs.h"
 #include "squashfs_fs_sb.h"
 #include "squashfs.h"
 #include "page_actor.h"
 
+static void squashfs_cache_entry_free(struct squashfs_cache *cache,
+	struct squashfs_cache_entry *entry)
+{
+	int j;
+
+	if (entry->data) {
+		for (j = 0; j < cache->pages; j++)
+			kfree(entry->data[j]);
+		kfree(entry->data);
+		entry->data = NULL;
+	}
+	kfree(entry->actor);
+	entry->actor = NULL;
+}
+
+static int squashfs_cache_entry_alloc(struct squashfs_cache *cache,
+	struct squashfs_cache_entry *entry, gfp_t gfp)
+{
+	int j;
+
+	init_waitqueue_head(&entry->wait_queue);
+	entry->cache = cache;
+	entry->block = SQUASHFS_INVALID_BLK;
+	entry->refcount = 0;
+	entry->data = kcalloc(cache->pages, sizeof(void *), gfp);
+	if (entry->data == NULL)
+		return -ENOMEM;
+
+	for (j = 0; j < cache->pages; j++) {
+		entry->data[j] = kmalloc(PAGE_SIZE, gfp);
+		if (entry->data[j] == NULL)
+			return -ENOMEM;
+	}
+
+	entry->actor = squashfs_page_actor_init(entry->data, cache->pages, 0);
+	if (entry->actor == NULL)
+		return -ENOMEM;
+	return 0;
+}
+
+/*
+ * Add one more entry to the cache.  Called with the cache lock held, which
+ * is dropped while allocating.  Only one task grows the cache at a time, and
+ * the shrinker leaves the cache alone meanwhile, so the slot past the last
+ * entry is ours.
+ *
+ * Growing is opportunistic, so the allocation doesn't try hard.  If it fails
+ * the cache isn't grown again for a second, rather than for good.
+ */
+static void squashfs_cache_grow(struct squashfs_cache *cache)
+{
+	struct squashfs_cache_entry *entry = &cache->entry[cache->entries];
+	int err;
+
+	cache->growing = 1;
+	spin_unlock(&cache->lock);
+	err = squashfs_cache_entry_alloc(cache, entry,
+		GFP_KERNEL | __GFP_NORETRY | __GFP_NOWARN);
+	if (err)
+		squashfs_cache_entry_free(cache, entry);
+	spin_lock(&cache->lock);
+	cache->growing = 0;
+
+	if (err) {
+		cache->grow_after = jiffies + HZ;
+		return;
+	}
+
+	/* make the new entry the next one to be filled */
+	cache->next_blk = cache->entries++;
+	cache->unused++;
+	if (cache->num_waiters)
+		wake_up(&cache->wait_queue);
+}
+
+static unsigned long squashfs_cache_count(struct shrinker *shrink,
+	struct shrink_control *sc)
+{
+	struct squashfs_cache *cache = shrink->private_data;
+
+	return READ_ONCE(cache->entries) - cache->min_entries;
+}
+
+/*
+ * Free unused entries from the end of the cache, never going below the
+ * minimum number of entries the cache was created with.
+ */
+static unsigned long squashfs_cache_scan(struct shrinker *shrink,
+	struct shrink_control *sc)
+{
+	struct squashfs_cache *cache = shrink->private_data;
+	unsigned long freed = 0;
+
+	spin_lock(&cache->lock);
+	while (freed < sc->nr_to_scan && !cache->growing &&
+	       cache->entries > cache->min_entries) {
+		struct squashfs_cache_entry *entry =
+			&cache->entry[cache->entries - 1];
+
+		if (entry->refcount)
+			break;
+		squashfs_cache_entry_free(cache, entry);
+		cache->entries--;
+		cache->unused--;
+		freed++;
+	}
+	if (cache->curr_blk >= cache->entries)
+		cache->curr_blk = 0;
+	if (cache->next_blk >= cache->entries)
+		cache->next_blk = 0;
+	spin_unlock(&cache->lock);
+
+	return freed ? freed : SHRINK_STOP;
+}
+
 /*
  * Look-up block in cache, and increment usage count.  If not in cache, read
  * and decompress it from disk.
@@ -54,6 +175,7 @@ struct squashfs_cache_entry *squashfs_cache_get(struct super_block *sb,
 {
 	int i, n;
 	struct squashfs_cache_entry *entry;
+	bool grown = false;
 
 	spin_lock(&cache->lock);
 
@@ -68,8 +190,24 @@ struct squashfs_cache_entry *squashfs_cache_get(struct super_block *sb,
 
 		if (n == cache->entries) {
 			/*
-			 * Block not in cache, if all cache entries are used
-			 * go to sleep waiting for one to become available.
+			 * Block not in cache, grow the cache rather than
+			 * evicting a block that may be wanted again soon.
+			 * At most one entry is added per miss.  The lock was
+			 * dropped while growing, so look again in case the
+			 * block was read meanwhile; if not, the round-robin
+			 * below picks the new entry, which next_blk points at.
+			 */
+			if (!grown && cache->entries < cache->max_entries &&
+			    !cache->growing &&
+			    time_after_eq(jiffies, cache->grow_after)) {
+				squashfs_cache_grow(cache);
+				grown = true;
+				continue;
+			}
+
+			/*
+			 * If all cache entries are used go to sleep waiting
+			 * for one to become available.
 			 */
 			if (cache->unused == 0) {
 				cache->num_waiters++;
@@ -196,19 +334,14 @@ void squashfs_cache_put(struct squashfs_cache_entry *entry)
  */
 void squashfs_cache_delete(struct squashfs_cache *cache)
 {
-	int i, j;
+	int i;
 
 	if (cache == NULL)
 		return;
 
-	for (i = 0; i < cache->entries; i++) {
-		if (cache->entry[i].data) {
-			for (j = 0; j < cache->pages; j++)
-				kfree(cache->entry[i].data[j]);
-			kfree(cache->entry[i].data);
-		}
-		kfree(cache->entry[i].actor);
-	}
+	shrinker_free(cache->shrinker);
+	for (i = 0; i < cache->max_entries; i++)
+		squashfs_cache_entry_free(cache, &cache->entry[i]);
 
 	kfree(cache->entry);
 	kfree(cache);
@@ -217,13 +350,14 @@ void squashfs_cache_delete(struct squashfs_cache *cache)
 
 /*
  * Initialise cache allocating the specified number of entries, each of
- * size block_size.  To avoid vmalloc fragmentation issues each entry
- * is allocated as a sequence of kmalloced PAGE_SIZE buffers.
+ * size block_size.  The cache may later grow up to max_entries entries.
+ * To avoid vmalloc fragmentation issues each entry is allocated as a
+ * sequence of kmalloced PAGE_SIZE buffers.
  */
 struct squashfs_cache *squashfs_cache_init(char *name, int entries,
-	int block_size)
+	int max_entries, int block_size)
 {
-	int i, j;
+	int i;
 	struct squashfs_cache *cache = kzalloc(sizeof(*cache), GFP_KERNEL);
 
 	if (cache == NULL) {
@@ -231,7 +365,8 @@ struct squashfs_cache *squashfs_cache_init(char *name, int entries,
 		return NULL;
 	}
 
-	cache->entry = kcalloc(entries, sizeof(*(cache->entry)), GFP_KERNEL);
+	max_entries = max(entries, max_entries);
+	cache->entry = kcalloc(max_entries, sizeof(*(cache->entry)), GFP_KERNEL);
 	if (cache->entry == NULL) {
 		ERROR("Failed to allocate %s cache\n", name);
 		goto cleanup;
@@ -241,6 +376,9 @@ struct squashfs_cache *squashfs_cache_init(char *name, int entries,
 	cache->next_blk = 0;
 	cache->unused = entries;
 	cache->entries = entries;
+	cache->min_entries = entries;
+	cache->max_entries = max_entries;
+	cache->grow_after = jiffies;
 	cache->block_size = block_size;
 	cache->pages = block_size >> PAGE_SHIFT;
 	cache->pages = cache->pages ? cache->pages : 1;
@@ -249,31 +387,23 @@ struct squashfs_cache *squashfs_cache_init(char *name, int entries,
 	spin_lock_init(&cache->lock);
 	init_waitqueue_head(&cache->wait_queue);
 
-	for (i = 0; i < entries; i++) {
-		struct squashfs_cache_entry *entry = &cache->entry[i];
-
-		init_waitqueue_head(&cache->entry[i].wait_queue);
-		entry->cache = cache;
-		entry->block = SQUASHFS_INVALID_BLK;
-		entry->data = kcalloc(cache->pages, sizeof(void *), GFP_KERNEL);
-		if (entry->data == NULL) {
+	for (i = 0; i < entries; i++)
+		if (squashfs_cache_entry_alloc(cache, &cache->entry[i],
+					       GFP_KERNEL)) {
 			ERROR("Failed to allocate %s cache entry\n", name);
 			goto cleanup;
 		}
 
-		for (j = 0; j < cache->pages; j++) {
-			entry->data[j] = kmalloc(PAGE_SIZE, GFP_KERNEL);
-			if (entry->data[j] == NULL) {
-				ERROR("Failed to allocate %s buffer\n", name);
-				goto cleanup;
-			}
-		}
-
-		entry->actor = squashfs_page_actor_init(entry->data,
-						cache->pages, 0);
-		if (entry->actor == NULL) {
-			ERROR("Failed to allocate %s cache entry\n", name);
-			goto cleanup;
+	if (max_entries > entries) {
+		cache->shrinker = shrinker_alloc(0, "squashfs-%s", name);
+		if (cache->shrinker) {
+			cache->shrinker->count_objects = squashfs_cache_count;
+			cache->shrinker->scan_objects = squashfs_cache_scan;
+			cache->shrinker->private_data = cache;
+			shrinker_register(cache->shrinker);
+		} else {
+			/* not fatal, just don't grow */
+			cache->max_entries = entries;
 		}
 	}
 
@@ -33,6 +33,7 @@
 #include <linux/slab.h>
 #include <linux/string.h>
 #include <linux/pagemap.h>
+#include <linux/workqueue.h>
 #include <linux/mutex.h>
 
 #include "squashfs_fs.h"
@@ -529,6 +530,98 @@ static int squashfs_readahead_fragment(struct page **page,
 	return error;
 }
 
+/*
+ * Decompress one datablock straight into its page cache pages, then unlock
+ * and release them.  The pages pin the inode until they are unlocked.
+ */
+static int squashfs_readahead_block(struct inode *inode, struct page **pages,
+	unsigned int nr_pages, u64 block, int bsize, unsigned int expected)
+{
+	struct squashfs_sb_info *msblk = inode->i_sb->s_fs_info;
+	struct squashfs_page_actor *actor;
+	struct page *last_page;
+	int i, res = -ENOMEM;
+
+	actor = squashfs_page_actor_init_special(msblk, pages, nr_pages,
+						 expected);
+	if (!actor)
+		goto out;
+
+	res = squashfs_read_data(inode->i_sb, block, bsize, NULL, actor);
+
+	last_page = squashfs_page_actor_free(actor);
+
+	if (res == expected) {
+		int bytes;
+
+		/*
+		 * Last page (if present) may have trailing bytes not filled,
+		 * only the last block of a file can be short of a page.
+		 */
+		bytes = res % PAGE_SIZE;
+		if (bytes && last_page)
+			memzero_page(last_page, bytes, PAGE_SIZE - bytes);
+
+		for (i = 0; i < nr_pages; i++) {
+			flush_dcache_page(pages[i]);
+			SetPageUptodate(pages[i]);
+		}
+	}
+	res = 0;
+out:
+	for (i = 0; i < nr_pages; i++) {
+		unlock_page(pages[i]);
+		put_page(pages[i]);
+	}
+	return res;
+}
+
+struct squashfs_readahead_work {
+	struct work_struct work;
+	struct inode *inode;
+	u64 block;
+	int bsize;
+	unsigned int expected;
+	unsigned int nr_pages;
+	struct page *pages[];
+};
+
+static void squashfs_readahead_workfn(struct work_struct *work)
+{
+	struct squashfs_readahead_work *ra =
+		container_of(work, struct squashfs_readahead_work, work);
+
+	squashfs_readahead_block(ra->inode, ra->pages, ra->nr_pages,
+				 ra->block, ra->bsize, ra->expected);
+	kfree(ra);
+}
+
+/*
+ * Queue a datablock of the readahead window for decompression on another
+ * CPU, so that the per-CPU (or multi) decompressors work on several blocks
+ * of a large file at once.  Returns -ENOMEM if the caller should decompress
+ * the block itself.
+ */
+static int squashfs_readahead_async(struct inode *inode, struct page **pages,
+	unsigned int nr_pages, u64 block, int bsize, unsigned int expected)
+{
+	struct squashfs_readahead_work *ra;
+
+	ra = kmalloc(struct_size(ra, pages, nr_pages), GFP_NOFS | __GFP_NOWARN);
+	if (!ra)
+		return -ENOMEM;
+
+	INIT_WORK(&ra->work, squashfs_readahead_workfn);
+	ra->inode = inode;
+	ra->block = block;
+	ra->bsize = bsize;
+	ra->expected = expected;
+	ra->nr_pages = nr_pages;
+	memcpy(ra->pages, pages, nr_pages * sizeof(*pages));
+	queue_work(system_unbound_wq, &ra->work);
+	return 0;
+}
+
 static void squashfs_readahead(struct readahead_control *ractl)
 {
 	struct inode *inode = ractl->mapping->host;
@@ -537,7 +630,6 @@ static void squashfs_readahead(struct readahead_control *ractl)
 	unsigned short shift = msblk->block_log - PAGE_SHIFT;
 	loff_t start = readahead_pos(ractl) & ~mask;
 	size_t len = readahead_length(ractl) + readahead_pos(ractl) - start;
-	struct squashfs_page_actor *actor;
 	unsigned int nr_pages = 0;
 	struct page **pages;
 	int i;
@@ -555,7 +647,6 @@ static void squashfs_readahead(struct readahead_control *ractl)
 		int res, bsize;
 		u64 block = 0;
 		unsigned int expected;
-		struct page *last_page;
 
 		expected = start >> msblk->block_log == file_end ?
 			   (i_size_read(inode) & (msblk->block_size - 1)) :
@@ -588,34 +679,18 @@ static void squashfs_readahead(struct readahead_control *ractl)
 		if (bsize == 0)
 			goto skip_pages;
 
-		actor = squashfs_page_actor_init_special(msblk, pages, nr_pages,
-							 expected);
-		if (!actor)
-			goto skip_pages;
-
-		res = squashfs_read_data(inode->i_sb, block, bsize, NULL, actor);
-
-		last_page = squashfs_page_actor_free(actor);
-
-		if (res == expected) {
-			int bytes;
-
-			/* Last page (if present) may have trailing bytes not filled */
-			bytes = res % PAGE_SIZE;
-			if (index == file_end && bytes && last_page)
-				memzero_page(last_page, bytes,
-					     PAGE_SIZE - bytes);
-
-			for (i = 0; i < nr_pages; i++) {
-				flush_dcache_page(pages[i]);
-				SetPageUptodate(pages[i]);
-			}
-		}
+		/*
+		 * Hand all but the last block of the window to other CPUs'
+		 * decompressors and decompress the last one ourselves.
+		 */
+		if (msblk->max_thread_num > 1 && readahead_count(ractl) &&
+		    !squashfs_readahead_async(inode, pages, nr_pages, block,
+					      bsize, expected))
+			continue;
 
-		for (i = 0; i < nr_pages; i++) {
-			unlock_page(pages[i]);
-			put_page(pages[i]);
-		}
+		if (squashfs_readahead_block(inode, pages, nr_pages, block,
+					     bsize, expected))
+			break;
 	}
 
 	kfree(pages);
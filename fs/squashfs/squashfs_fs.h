@@ -11,6 +11,7 @@
  */
 
 #define SQUASHFS_CACHED_FRAGMENTS	CONFIG_SQUASHFS_FRAGMENT_CACHE_SIZE
+#define SQUASHFS_MAX_CACHED_FRAGMENTS	32
 #define SQUASHFS_MAJOR			4
 #define SQUASHFS_MINOR			0
 #define SQUASHFS_START			0
@@ -203,6 +204,7 @@ static inline int squashfs_block_size(__le32 raw)
 
 /* cached data constants for filesystem */
 #define SQUASHFS_CACHED_BLKS		8
+#define SQUASHFS_MAX_CACHED_BLKS	64
 
 /* meta index cache */
 #define SQUASHFS_META_INDEXES	(SQUASHFS_METADATA_SIZE / sizeof(unsigned int))
@@ -15,6 +15,10 @@
 struct squashfs_cache {
 	char			*name;
 	int			entries;
+	int			min_entries;
+	int			max_entries;
+	int			growing;
+	unsigned long		grow_after;
 	int			curr_blk;
 	int			next_blk;
 	int			num_waiters;
@@ -24,6 +28,7 @@ struct squashfs_cache {
 	spinlock_t		lock;
 	wait_queue_head_t	wait_queue;
 	struct squashfs_cache_entry *entry;
+	struct shrinker		*shrinker;
 };
 
 struct squashfs_cache_entry {
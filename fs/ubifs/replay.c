@@ -22,8 +22,12 @@
 
 #include "ubifs.h"
 #include <linux/list_sort.h>
+#include <linux/workqueue.h>
 #include <crypto/hash.h>
 
+/* Maximum number of buds scanned ahead of the bud being replayed */
+#define REPLAY_SCAN_AHEAD 8
+
 /**
  * struct replay_entry - replay list entry.
  * @lnum: logical eraseblock number of the node
@@ -76,6 +80,26 @@ struct bud_entry {
 	int dirty;
 };
 
+/**
+ * struct bud_scan - scan of a bud done ahead of its replay.
+ * @work: work item which scans the bud
+ * @done: completed once @sleb is set
+ * @list: links the free scan slots
+ * @c: UBIFS file-system description object
+ * @b: bud being scanned, %NULL if the slot is free
+ * @buf: LEB-sized buffer the scanned nodes point into
+ * @sleb: result of the scan, may be an error pointer
+ */
+struct bud_scan {
+	struct work_struct work;
+	struct completion done;
+	struct list_head list;
+	const struct ubifs_info *c;
+	struct bud_entry *b;
+	void *buf;
+	struct ubifs_scan_leb *sleb;
+};
+
 /**
  * set_bud_lprops - set free and dirty space used by a bud.
  * @c: UBIFS file-system description object
@@ -660,23 +684,27 @@ static int authenticate_sleb(struct ubifs_info *c, struct ubifs_scan_leb *sleb,
  * replay_bud - replay a bud logical eraseblock.
  * @c: UBIFS file-system description object
  * @b: bud entry which describes the bud
+ * @sleb: result of scanning the bud ahead of time, or %NULL
  *
  * This function replays bud @bud, recovers it if needed, and adds all nodes
- * from this bud to the replay list. Returns zero in case of success and a
- * negative error code in case of failure.
+ * from this bud to the replay list. If @sleb is not %NULL, the bud has
+ * already been scanned and @sleb is consumed. Returns zero in case of success
+ * and a negative error code in case of failure.
  */
-static int replay_bud(struct ubifs_info *c, struct bud_entry *b)
+static int replay_bud(struct ubifs_info *c, struct bud_entry *b,
+		      struct ubifs_scan_leb *sleb)
 {
 	int is_last = is_last_bud(c, b->bud);
 	int err = 0, used = 0, lnum = b->bud->lnum, offs = b->bud->start;
 	int n_nodes, n = 0;
-	struct ubifs_scan_leb *sleb;
 	struct ubifs_scan_node *snod;
 
 	dbg_mnt("replay bud LEB %d, head %d, offs %d, is_last %d",
 		lnum, b->bud->jhead, offs, is_last);
 
-	if (c->need_recovery && is_last)
+	if (sleb)
+		ubifs_assert(c, !c->need_recovery || !is_last);
+	else if (c->need_recovery && is_last)
 		/*
 		 * Recover only last LEBs in the journal heads, because power
 		 * cuts may cause corruptions only in these LEBs, because only
@@ -837,29 +865,144 @@ static int replay_bud(struct ubifs_info *c, struct bud_entry *b)
 	return -EINVAL;
 }
 
+static void bud_scan_work(struct work_struct *work)
+{
+	struct bud_scan *scan = container_of(work, struct bud_scan, work);
+	struct ubifs_bud *bud = scan->b->bud;
+
+	scan->sleb = ubifs_scan(scan->c, bud->lnum, bud->start, scan->buf, 0);
+	complete(&scan->done);
+}
+
+/**
+ * alloc_bud_scans - allocate slots for scanning buds ahead of replay.
+ * @c: UBIFS file-system description object
+ * @free: list the allocated slots are added to
+ *
+ * Scanning a bud means reading it and checking the CRC of every node, which
+ * is most of the cost of replay. Building the replay list has to be done in
+ * order, but the buds can be read and checked in parallel. Returns the array
+ * of slots, or %NULL if buds are to be scanned by the replay itself.
+ */
+static struct bud_scan *alloc_bud_scans(struct ubifs_info *c,
+					struct list_head *free)
+{
+	int i, cnt = min_t(int, num_online_cpus(), REPLAY_SCAN_AHEAD);
+	struct bud_scan *scans;
+
+	if (cnt < 2)
+		return NULL;
+
+	scans = kcalloc(cnt + 1, sizeof(struct bud_scan), GFP_KERNEL);
+	if (!scans)
+		return NULL;
+
+	for (i = 0; i < cnt; i++) {
+		scans[i].buf = vmalloc(c->leb_size);
+		if (!scans[i].buf)
+			break;
+		scans[i].c = c;
+		INIT_WORK(&scans[i].work, bud_scan_work);
+		list_add_tail(&scans[i].list, free);
+	}
+
+	if (i < 2) {
+		/* A single slot would not scan anything in parallel */
+		vfree(scans[0].buf);
+		kfree(scans);
+		INIT_LIST_HEAD(free);
+		return NULL;
+	}
+
+	return scans;
+}
+
+/**
+ * free_bud_scans - wait for and free the scans ahead of replay.
+ * @scans: array of slots returned by 'alloc_bud_scans()'
+ */
+static void free_bud_scans(struct bud_scan *scans)
+{
+	struct bud_scan *scan;
+
+	for (scan = scans; scan->buf; scan++) {
+		if (scan->b) {
+			wait_for_completion(&scan->done);
+			if (!IS_ERR(scan->sleb))
+				ubifs_scan_destroy(scan->sleb);
+		}
+		vfree(scan->buf);
+	}
+	kfree(scans);
+}
+
 /**
  * replay_buds - replay all buds.
  * @c: UBIFS file-system description object
  *
+ * Up to %REPLAY_SCAN_AHEAD buds following the one being replayed are scanned
+ * in parallel on an unbound workqueue. The last buds of the journal heads
+ * are not, because they may need recovery, which writes to the flash.
+ *
  * This function returns zero in case of success and a negative error code in
  * case of failure.
  */
 static int replay_buds(struct ubifs_info *c)
 {
-	struct bud_entry *b;
-	int err;
+	struct bud_entry *b, *ahead;
+	struct bud_scan *scans, *scan;
+	struct ubifs_scan_leb *sleb;
+	LIST_HEAD(free);
+	int err = 0;
 	unsigned long long prev_sqnum = 0;
 
+	scans = alloc_bud_scans(c, &free);
+	ahead = list_first_entry(&c->replay_buds, struct bud_entry, list);
+
 	list_for_each_entry(b, &c->replay_buds, list) {
-		err = replay_bud(c, b);
+		/* Start scanning the next buds in the free slots */
+		while (!list_empty(&free) &&
+		       !list_entry_is_head(ahead, &c->replay_buds, list)) {
+			if (!c->need_recovery || !is_last_bud(c, ahead->bud)) {
+				scan = list_first_entry(&free, struct bud_scan,
+							list);
+				list_del(&scan->list);
+				scan->b = ahead;
+				init_completion(&scan->done);
+				queue_work(system_unbound_wq, &scan->work);
+			}
+			ahead = list_next_entry(ahead, list);
+		}
+
+		sleb = NULL;
+		scan = NULL;
+		if (scans) {
+			for (scan = scans; scan->buf; scan++)
+				if (scan->b == b)
+					break;
+			if (scan->buf) {
+				wait_for_completion(&scan->done);
+				sleb = scan->sleb;
+			} else {
+				scan = NULL;
+			}
+		}
+
+		err = replay_bud(c, b, sleb);
+		if (scan) {
+			scan->b = NULL;
+			list_add_tail(&scan->list, &free);
+		}
 		if (err)
-			return err;
+			break;
 
 		ubifs_assert(c, b->sqnum > prev_sqnum);
 		prev_sqnum = b->sqnum;
 	}
 
-	return 0;
+	if (scans)
+		free_bud_scans(scans);
+	return err;
 }
 
 /**
@@ -242,14 +242,90 @@ verify_data_block(struct inode *inode, struct fsverity_info *vi,
 	return false;
 }
 
+/*
+ * A verified level 0 hash block kept mapped while verifying the following
+ * data blocks of a folio, which mostly share it (a 4K SHA-256 hash block
+ * covers 128 data blocks).
+ */
+struct verified_leaf {
+	struct page *page;
+	const void *addr;
+	unsigned long index;
+};
+
+static unsigned long leaf_hblock_idx(const struct merkle_tree_params *params,
+				     u64 data_pos)
+{
+	return params->level_start[0] +
+		((data_pos >> params->log_blocksize) >> params->log_arity);
+}
+
+static void put_verified_leaf(struct verified_leaf *leaf)
+{
+	if (leaf->page) {
+		kunmap_local(leaf->addr);
+		put_page(leaf->page);
+		leaf->page = NULL;
+	}
+}
+
+/* Grab the level 0 hash block of @data_pos if it is (still) verified. */
+static void get_verified_leaf(struct inode *inode, struct fsverity_info *vi,
+			      u64 data_pos, struct verified_leaf *leaf)
+{
+	const struct merkle_tree_params *params = &vi->tree_params;
+	unsigned long hblock_idx = leaf_hblock_idx(params, data_pos);
+	struct page *hpage;
+
+	hpage = inode->i_sb->s_vop->read_merkle_tree_page(inode,
+			hblock_idx >> params->log_blocks_per_page, 0);
+	if (IS_ERR(hpage))
+		return;
+	if (!is_hash_block_verified(vi, hpage, hblock_idx)) {
+		put_page(hpage);
+		return;
+	}
+	leaf->page = hpage;
+	leaf->addr = kmap_local_page(hpage) +
+		((hblock_idx << params->log_blocksize) & ~PAGE_MASK);
+	leaf->index = hblock_idx;
+}
+
+/* Verify a data block against its hash in the already verified @leaf. */
+static bool verify_data_block_leaf(struct inode *inode,
+				   struct fsverity_info *vi,
+				   const struct verified_leaf *leaf,
+				   const void *data, u64 data_pos)
+{
+	const struct merkle_tree_params *params = &vi->tree_params;
+	const unsigned int hsize = params->digest_size;
+	const u8 *want_hash = leaf->addr +
+		(((data_pos >> params->log_blocksize) << params->log_digestsize) &
+		 (params->block_size - 1));
+	u8 real_hash[FS_VERITY_MAX_DIGEST_SIZE];
+
+	if (fsverity_hash_block(params, inode, data, real_hash) != 0)
+		return false;
+	if (memcmp(want_hash, real_hash, hsize) != 0) {
+		fsverity_err(inode,
+			     "FILE CORRUPTED! pos=%llu, level=-1, want_hash=%s:%*phN, real_hash=%s:%*phN",
+			     data_pos, params->hash_alg->name, hsize, want_hash,
+			     params->hash_alg->name, hsize, real_hash);
+		return false;
+	}
+	return true;
+}
+
 static bool
 verify_data_blocks(struct folio *data_folio, size_t len, size_t offset,
 		   unsigned long max_ra_pages)
 {
 	struct inode *inode = data_folio->mapping->host;
 	struct fsverity_info *vi = inode->i_verity_info;
-	const unsigned int block_size = vi->tree_params.block_size;
+	const struct merkle_tree_params *params = &vi->tree_params;
+	const unsigned int block_size = params->block_size;
 	u64 pos = (u64)data_folio->index << PAGE_SHIFT;
+	struct verified_leaf leaf = {};
 
 	if (WARN_ON_ONCE(len <= 0 || !IS_ALIGNED(len | offset, block_size)))
 		return false;
@@ -257,18 +333,39 @@ verify_data_blocks(struct folio *data_folio, size_t len, size_t offset,
 			 folio_test_uptodate(data_folio)))
 		return false;
 	do {
+		u64 data_pos = pos + offset;
 		void *data;
 		bool valid;
 
-		data = kmap_local_folio(data_folio, offset);
-		valid = verify_data_block(inode, vi, data, pos + offset,
-					  max_ra_pages);
-		kunmap_local(data);
-		if (!valid)
+		if (params->num_levels && data_pos < inode->i_size &&
+		    leaf.page &&
+		    leaf.index == leaf_hblock_idx(params, data_pos)) {
+			data = kmap_local_folio(data_folio, offset);
+			valid = verify_data_block_leaf(inode, vi, &leaf, data,
+						       data_pos);
+			kunmap_local(data);
+		} else {
+			put_verified_leaf(&leaf);
+			data = kmap_local_folio(data_folio, offset);
+			valid = verify_data_block(inode, vi, data, data_pos,
+						  max_ra_pages);
+			kunmap_local(data);
+			/*
+			 * The next data block likely has its hash in the same,
+			 * now verified, hash block; keep that one at hand.
+			 */
+			if (valid && params->num_levels && len > block_size &&
+			    data_pos + block_size < inode->i_size)
+				get_verified_leaf(inode, vi, data_pos, &leaf);
+		}
+		if (!valid) {
+			put_verified_leaf(&leaf);
 			return false;
+		}
 		offset += block_size;
 		len -= block_size;
 	} while (len);
+	put_verified_leaf(&leaf);
 	return true;
 }
 
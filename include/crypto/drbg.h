@@ -142,6 +142,10 @@ struct drbg_state {
 	const struct drbg_state_ops *d_ops;
 	const struct drbg_core *core;
 	struct drbg_string test_data;
+
+	/* Per-CPU child instances, only set on the kcapi tfm state */
+	struct drbg_state * __percpu *pcpu;
+	unsigned int seed_gen;	/* bumped on every reseed of the parent */
 };
 
 static inline __u8 drbg_statelen(struct drbg_state *drbg)
@@ -20,10 +20,14 @@ struct device;
 /*
  * struct crypto_engine_op - crypto hardware engine operations
  * @do_one_request: do encryption for current request
+ * @do_requests: optional, start @nr consecutive requests for this
+ * algorithm at once.  On error none of them may have been started.
  */
 struct crypto_engine_op {
 	int (*do_one_request)(struct crypto_engine *engine,
 			      void *areq);
+	int (*do_requests)(struct crypto_engine *engine,
+			   void **areqs, unsigned int nr);
 };
 
 struct aead_engine_alg {
@@ -78,6 +82,9 @@ struct crypto_engine *crypto_engine_alloc_init_and_set(struct device *dev,
 						       bool retry_support,
 						       int (*cbk_do_batch)(struct crypto_engine *engine),
 						       bool rt, int qlen);
+int crypto_engine_set_parallel(struct crypto_engine *engine,
+			       unsigned int max_inflight,
+			       unsigned int max_batch);
 void crypto_engine_exit(struct crypto_engine *engine);
 
 int crypto_engine_register_aead(struct aead_engine_alg *alg);
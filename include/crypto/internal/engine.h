@@ -42,7 +42,10 @@ struct device;
  * @kworker: kthread worker struct for request pump
  * @pump_requests: work struct for scheduling work to the request pump
  * @priv_data: the engine private data
- * @cur_req: the current request which is on processing
+ * @cur_req: the last request handed to the driver
+ * @inflight: number of requests handed to the driver and not finalized
+ * @max_inflight: most requests the hardware can work on at once
+ * @max_batch: most requests passed to do_requests() in one call
  */
 struct crypto_engine {
 	char			name[ENGINE_NAME_LEN];
@@ -69,6 +72,10 @@ struct crypto_engine {
 
 	void				*priv_data;
 	struct crypto_async_request	*cur_req;
+
+	unsigned int			inflight;
+	unsigned int			max_inflight;
+	unsigned int			max_batch;
 };
 
 #endif
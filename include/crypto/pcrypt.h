@@ -12,10 +12,18 @@
 #include <linux/container_of.h>
 #include <linux/crypto.h>
 #include <linux/padata.h>
+#include <linux/workqueue_types.h>
+
+struct crypto_aead;
 
 struct pcrypt_request {
-	struct padata_priv	padata;
+	union {
+		struct padata_priv	padata;
+		/* Used instead of padata by unordered tfms */
+		struct work_struct	work;
+	};
 	void			*data;
+	bool			encrypt;
 	void			*__ctx[] CRYPTO_MINALIGN_ATTR;
 };
 
@@ -36,4 +44,6 @@ struct pcrypt_request *pcrypt_padata_request(struct padata_priv *padata)
 	return container_of(padata, struct pcrypt_request, padata);
 }
 
+int pcrypt_aead_set_unordered(struct crypto_aead *tfm, bool unordered);
+
 #endif
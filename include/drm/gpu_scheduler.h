@@ -71,11 +71,12 @@ enum drm_sched_priority {
 	DRM_SCHED_PRIORITY_COUNT
 };
 
-/* Used to chose between FIFO and RR jobs scheduling */
+/* Used to chose between FIFO, RR and EDF jobs scheduling */
 extern int drm_sched_policy;
 
-#define DRM_SCHED_POLICY_RR    0
-#define DRM_SCHED_POLICY_FIFO  1
+#define DRM_SCHED_POLICY_RR       0
+#define DRM_SCHED_POLICY_FIFO     1
+#define DRM_SCHED_POLICY_DEADLINE 2
 
 /**
  * struct drm_sched_entity - A wrapper around a job queue (typically
@@ -478,6 +479,20 @@ struct drm_sched_backend_ops {
 	 * This callback is optional.
 	 */
 	u32 (*update_job_credits)(struct drm_sched_job *sched_job);
+
+	/**
+	 * @flush_jobs: Called after one or more run_job() calls to make the
+	 * hardware start on the jobs just queued.
+	 *
+	 * When this is implemented, run_job() is expected to only write the
+	 * job to the ring and leave ringing the doorbell to flush_jobs(). The
+	 * scheduler then passes several ready jobs to run_job() back to back
+	 * and calls flush_jobs() once for the whole batch, including after
+	 * drm_sched_resubmit_jobs().
+	 *
+	 * This callback is optional.
+	 */
+	void (*flush_jobs)(struct drm_gpu_scheduler *sched);
 };
 
 /**
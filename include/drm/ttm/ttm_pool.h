@@ -29,6 +29,7 @@
 #include <linux/mmzone.h>
 #include <linux/llist.h>
 #include <linux/spinlock.h>
+#include <linux/workqueue.h>
 #include <drm/ttm/ttm_caching.h>
 
 struct device;
@@ -43,19 +44,29 @@ struct ttm_tt;
  * @pool: the pool we belong to, might be NULL for the global ones
  * @order: the allocation order our pages have
  * @caching: the caching type our pages have
+ * @nid: the NUMA node our pages come from, NUMA_NO_NODE if mixed
  * @shrinker_list: our place on the global shrinker list
- * @lock: protection of the page list
- * @pages: the list of pages in the pool
+ * @lock: protection of the page list and counters
+ * @pages: the list of pages in the pool, cleared ones first
+ * @nr_clean: number of already cleared pages at the head of @pages
+ * @nr_dirty: number of not yet cleared pages at the tail of @pages
+ * @taken: incremented each time a page is removed from @pages
+ * @clear_work: background work clearing the dirty pages
  */
 struct ttm_pool_type {
 	struct ttm_pool *pool;
 	unsigned int order;
 	enum ttm_caching caching;
+	int nid;
 
 	struct list_head shrinker_list;
 
 	spinlock_t lock;
 	struct list_head pages;
+	unsigned int nr_clean;
+	unsigned int nr_dirty;
+	unsigned long taken;
+	struct work_struct clear_work;
 };
 
 /**
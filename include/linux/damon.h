@@ -434,12 +434,15 @@ struct damos {
  * @DAMON_OPS_FVADDR:	Monitoring operations for only fixed ranges of virtual
  *			address spaces
  * @DAMON_OPS_PADDR:	Monitoring operations for the physical address space
+ * @DAMON_OPS_PADDR_SAMPLED:	Monitoring operations for the physical address
+ *			space using hardware memory access sampling
  * @NR_DAMON_OPS:	Number of monitoring operations implementations
  */
 enum damon_ops_id {
 	DAMON_OPS_VADDR,
 	DAMON_OPS_FVADDR,
 	DAMON_OPS_PADDR,
+	DAMON_OPS_PADDR_SAMPLED,
 	NR_DAMON_OPS,
 };
 
@@ -472,7 +475,8 @@ struct damon_ctx;
  * via damon_register_ops() and selected by damon_select_ops() later.
  * @init should initialize operations-related data structures.  For example,
  * this could be used to construct proper monitoring target regions and link
- * those to @damon_ctx.adaptive_targets.
+ * those to @damon_ctx.adaptive_targets.  It returns zero on success, or a
+ * negative error code to make &damon_ctx.kdamond terminate without monitoring.
  * @update should update the operations-related data structures.  For example,
  * this could be used to update monitoring target regions for current status.
  * @prepare_access_checks should manipulate the monitoring regions to be
@@ -495,7 +499,7 @@ struct damon_ctx;
  */
 struct damon_operations {
 	enum damon_ops_id id;
-	void (*init)(struct damon_ctx *context);
+	int (*init)(struct damon_ctx *context);
 	void (*update)(struct damon_ctx *context);
 	void (*prepare_access_checks)(struct damon_ctx *context);
 	unsigned int (*check_accesses)(struct damon_ctx *context);
@@ -865,6 +865,14 @@ struct journal_s
 	 */
 	struct mutex		j_checkpoint_mutex;
 
+	/**
+	 * @j_checkpoint_work:
+	 *
+	 * Background checkpointing once the log fills up, see
+	 * jbd2_log_start_checkpoint().
+	 */
+	struct work_struct	j_checkpoint_work;
+
 	/**
 	 * @j_chkpt_bhs:
 	 *
@@ -1127,6 +1135,12 @@ struct journal_s
 	 */
 	struct buffer_head	**j_wbuf;
 
+	/**
+	 * @j_wtag: Descriptor tags of the @j_wbuf buffers, whose checksums
+	 * jbd2_journal_commit_transaction() sets right before submission.
+	 */
+	journal_block_tag_t	**j_wtag;
+
 	/**
 	 * @j_fc_wbuf: Array of fast commit bhs for fast commit. Accessed only
 	 * during a fast commit. Currently only process can do fast commit, so
@@ -1439,6 +1453,8 @@ void jbd2_update_log_tail(journal_t *journal, tid_t tid, unsigned long block);
 
 /* Commit management */
 extern void jbd2_journal_commit_transaction(journal_t *);
+extern int __init jbd2_journal_init_csum_wq(void);
+extern void jbd2_journal_destroy_csum_wq(void);
 
 /* Checkpoint list management */
 enum jbd2_shrink_type {JBD2_SHRINK_DESTROY, JBD2_SHRINK_BUSY_STOP, JBD2_SHRINK_BUSY_SKIP};
@@ -1661,6 +1677,8 @@ int jbd2_log_wait_commit(journal_t *journal, tid_t tid);
 int jbd2_transaction_committed(journal_t *journal, tid_t tid);
 int jbd2_complete_transaction(journal_t *journal, tid_t tid);
 int jbd2_log_do_checkpoint(journal_t *journal);
+void jbd2_log_start_checkpoint(journal_t *journal);
+void jbd2_checkpoint_work(struct work_struct *work);
 int jbd2_trans_will_send_data_barrier(journal_t *journal, tid_t tid);
 
 void __jbd2_log_wait_for_space(journal_t *journal);
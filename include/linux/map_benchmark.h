@@ -15,6 +15,14 @@
 #define DMA_MAP_TO_DEVICE       1
 #define DMA_MAP_FROM_DEVICE     2
 
+#define DMA_MAP_SINGLE_MODE     0 /* dma_map_single() of one buffer */
+#define DMA_MAP_SG_MODE         1 /* dma_map_sg() of granule pages */
+
+#define DMA_MAP_ATTR_SKIP_CPU_SYNC	(1U << 0)
+
+/* bucket i counts latencies in [2^i, 2^(i+1)) ns */
+#define DMA_MAP_HIST_BUCKETS    32
+
 struct map_benchmark {
 	__u64 avg_map_100ns; /* average map latency in 100ns */
 	__u64 map_stddev; /* standard deviation of map latency */
@@ -27,5 +35,10 @@ struct map_benchmark {
 	__u32 dma_dir; /* DMA data direction */
 	__u32 dma_trans_ns; /* time for DMA transmission in ns */
 	__u32 granule;  /* how many PAGE_SIZE will do map/unmap once a time */
+	__u32 map_mode; /* DMA_MAP_SINGLE_MODE or DMA_MAP_SG_MODE */
+	__u32 dma_attrs; /* DMA_MAP_ATTR_* */
+	__u32 reserved;
+	__u64 map_hist[DMA_MAP_HIST_BUCKETS]; /* map latency histogram */
+	__u64 unmap_hist[DMA_MAP_HIST_BUCKETS]; /* as above */
 };
 #endif /* _KERNEL_DMA_BENCHMARK_H */
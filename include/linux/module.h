@@ -386,6 +386,10 @@ struct mod_kallsyms {
 	unsigned int num_symtab;
 	char *strtab;
 	char *typetab;
+	/* Optional lookup indices into symtab, see add_kallsyms() */
+	unsigned int *name_idx;
+	unsigned int *addr_idx;
+	unsigned int num_addr_idx;
 };
 
 #ifdef CONFIG_LIVEPATCH
@@ -76,6 +76,8 @@ struct ebt_chainstack {
 	unsigned int n; /* n'th entry */
 };
 
+struct ebt_macidx;
+
 struct ebt_table_info {
 	/* total size of the entries */
 	unsigned int entries_size;
@@ -84,6 +86,8 @@ struct ebt_table_info {
 	struct ebt_entries *hook_entry[NF_BR_NUMHOOKS];
 	/* room to maintain the stack used for jumping from and into udc */
 	struct ebt_chainstack **chainstack;
+	/* MAC dispatch index for runs of per-address rules, or NULL */
+	struct ebt_macidx *macidx;
 	char *entries;
 	struct ebt_counter counters[] ____cacheline_aligned;
 };
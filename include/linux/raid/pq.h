@@ -60,6 +60,8 @@ extern const char raid6_empty_zero_page[PAGE_SIZE];
 #define EXPORT_SYMBOL_GPL(sym)
 #define MODULE_LICENSE(licence)
 #define MODULE_DESCRIPTION(desc)
+#define module_param_named(name, value, type, perm)
+#define MODULE_PARM_DESC(name, desc)
 #define subsys_initcall(x)
 #define module_exit(x)
 
@@ -101,6 +103,9 @@ extern const struct raid6_calls raid6_avx2x4;
 extern const struct raid6_calls raid6_avx512x1;
 extern const struct raid6_calls raid6_avx512x2;
 extern const struct raid6_calls raid6_avx512x4;
+extern const struct raid6_calls raid6_gfnix1;
+extern const struct raid6_calls raid6_gfnix2;
+extern const struct raid6_calls raid6_gfnix4;
 extern const struct raid6_calls raid6_s390vx8;
 extern const struct raid6_calls raid6_vpermxor1;
 extern const struct raid6_calls raid6_vpermxor2;
@@ -121,6 +126,7 @@ extern const struct raid6_recov_calls raid6_recov_intx1;
 extern const struct raid6_recov_calls raid6_recov_ssse3;
 extern const struct raid6_recov_calls raid6_recov_avx2;
 extern const struct raid6_recov_calls raid6_recov_avx512;
+extern const struct raid6_recov_calls raid6_recov_gfni;
 extern const struct raid6_recov_calls raid6_recov_s390xc;
 extern const struct raid6_recov_calls raid6_recov_neon;
 extern const struct raid6_recov_calls raid6_recov_lsx;
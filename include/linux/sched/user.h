@@ -16,7 +16,7 @@ struct user_struct {
 #ifdef CONFIG_EPOLL
 	struct percpu_counter epoll_watches; /* The number of file descriptors currently watched */
 #endif
-	unsigned long unix_inflight;	/* How many files in flight in unix sockets */
+	atomic_long_t unix_inflight;	/* How many files in flight in unix sockets */
 	atomic_long_t pipe_bufs;  /* how many pages are allocated in pipe buffers */
 
 	/* Hash table maintenance information */
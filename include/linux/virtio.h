@@ -84,6 +84,8 @@ unsigned virtqueue_enable_cb_prepare(struct virtqueue *vq);
 
 int virtqueue_set_dma_premapped(struct virtqueue *_vq);
 
+int virtqueue_set_indirect_pool(struct virtqueue *_vq, unsigned int nr_sg);
+
 bool virtqueue_poll(struct virtqueue *vq, unsigned);
 
 bool virtqueue_enable_cb_delayed(struct virtqueue *vq);
@@ -220,6 +220,71 @@ zstd_dctx *zstd_init_dctx(void *workspace, size_t workspace_size);
 size_t zstd_decompress_dctx(zstd_dctx *dctx, void *dst, size_t dst_capacity,
 	const void *src, size_t src_size);
 
+/* ======   Parallel Multi-frame Compression   ====== */
+
+/**
+ * zstd_compress_frames_bound() - dst size needed by zstd_compress_frames()
+ * @src_size:   The size of the data to compress.
+ * @frame_size: The amount of data compressed into each frame.
+ *
+ * Return:      The size of the destination buffer zstd_compress_frames()
+ *              requires. It is larger than zstd_compress_bound(src_size),
+ *              because every frame is first compressed into a slot of its own.
+ */
+size_t zstd_compress_frames_bound(size_t src_size, size_t frame_size);
+
+/**
+ * zstd_compress_frames() - compress src into independent frames in parallel
+ * @cctxs:        Compression contexts, one for each frame compressed at the
+ *                same time. Each must have been initialized with
+ *                zstd_init_cctx() for @parameters.
+ * @nr_cctxs:     The number of contexts in @cctxs.
+ * @dst:          The buffer to compress src into.
+ * @dst_capacity: The size of the destination buffer. Must be at least
+ *                zstd_compress_frames_bound(src_size, frame_size).
+ * @src:          The data to compress.
+ * @src_size:     The size of the data to compress.
+ * @frame_size:   The amount of data compressed into each frame. Frames don't
+ *                reference each other, so smaller frames compress worse.
+ * @parameters:   The compression parameters to be used. The content size is
+ *                always written into the frame headers.
+ *
+ * Splits @src into frames of @frame_size bytes and compresses them with up to
+ * @nr_cctxs contexts at a time, on the calling thread and on system_unbound_wq.
+ * The result is a standard stream of concatenated frames, which any zstd
+ * decompressor can decompress. Must be called from process context.
+ *
+ * Return:        The compressed size or an error, which can be checked using
+ *                zstd_is_error().
+ */
+size_t zstd_compress_frames(zstd_cctx **cctxs, unsigned int nr_cctxs,
+	void *dst, size_t dst_capacity, const void *src, size_t src_size,
+	size_t frame_size, const zstd_parameters *parameters);
+
+/**
+ * zstd_decompress_frames() - decompress the frames of src in parallel
+ * @dctxs:        Decompression contexts, one for each frame decompressed at
+ *                the same time.
+ * @nr_dctxs:     The number of contexts in @dctxs.
+ * @dst:          The buffer to decompress src into.
+ * @dst_capacity: The size of the destination buffer. Must be at least as large
+ *                as the decompressed size.
+ * @src:          The zstd compressed data to decompress. Multiple concatenated
+ *                frames and skippable frames are allowed.
+ * @src_size:     The exact size of the data to decompress.
+ *
+ * If every frame of @src records its content size, as the frames written by
+ * zstd_compress_frames() do, the frames are decompressed with up to @nr_dctxs
+ * contexts at a time, on the calling thread and on system_unbound_wq.
+ * Otherwise this is equivalent to zstd_decompress_dctx() with @dctxs[0].
+ * Must be called from process context.
+ *
+ * Return:        The decompressed size or an error, which can be checked using
+ *                zstd_is_error().
+ */
+size_t zstd_decompress_frames(zstd_dctx **dctxs, unsigned int nr_dctxs,
+	void *dst, size_t dst_capacity, const void *src, size_t src_size);
+
 /* ======   Streaming Buffers   ====== */
 
 /**
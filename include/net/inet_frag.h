@@ -7,6 +7,7 @@
 #include <linux/in6.h>
 #include <linux/rbtree_types.h>
 #include <linux/refcount.h>
+#include <linux/percpu_counter.h>
 #include <net/dropreason-core.h>
 
 /* Per netns frag queues directory */
@@ -22,8 +23,8 @@ struct fqdir {
 
 	struct rhashtable       rhashtable ____cacheline_aligned_in_smp;
 
-	/* Keep atomic mem on separate cachelines in structs that include it */
-	atomic_long_t		mem ____cacheline_aligned_in_smp;
+	/* Keep mem on separate cachelines in structs that include it */
+	struct percpu_counter	mem ____cacheline_aligned_in_smp;
 	struct work_struct	destroy_work;
 	struct llist_node	free_list;
 };
@@ -151,21 +152,36 @@ static inline void inet_frag_put(struct inet_frag_queue *q)
 		inet_frag_destroy(q);
 }
 
-/* Memory Tracking Functions. */
+/* Memory Tracking Functions.
+ *
+ * Every fragment is charged on arrival and uncharged on reassembly, from
+ * whatever cpu it lands on.  Keep the charges per cpu and only fold them
+ * into the shared count once they exceed INET_FRAG_MEM_BATCH, well above
+ * the truesize of a fragment.  The folded count can lag the real one by
+ * up to that batch per cpu, so close to high_thresh the limit check sums
+ * the per cpu charges instead of trusting it.
+ */
+#define INET_FRAG_MEM_BATCH	(32 * 1024)
+
+static inline long frag_mem_limit(struct fqdir *fqdir)
+{
+	return percpu_counter_sum_positive(&fqdir->mem);
+}
 
-static inline long frag_mem_limit(const struct fqdir *fqdir)
+static inline bool frag_mem_over_limit(struct fqdir *fqdir, long limit)
 {
-	return atomic_long_read(&fqdir->mem);
+	return __percpu_counter_compare(&fqdir->mem, limit,
+					INET_FRAG_MEM_BATCH) > 0;
 }
 
 static inline void sub_frag_mem_limit(struct fqdir *fqdir, long val)
 {
-	atomic_long_sub(val, &fqdir->mem);
+	percpu_counter_add_batch(&fqdir->mem, -val, INET_FRAG_MEM_BATCH);
 }
 
 static inline void add_frag_mem_limit(struct fqdir *fqdir, long val)
 {
-	atomic_long_add(val, &fqdir->mem);
+	percpu_counter_add_batch(&fqdir->mem, val, INET_FRAG_MEM_BATCH);
 }
 
 /* RFC 3168 support :
@@ -152,6 +152,8 @@ struct inet_hashinfo {
 	spinlock_t			*ehash_locks;
 	unsigned int			ehash_mask;
 	unsigned int			ehash_locks_mask;
+	/* log2 of the distance between two ehash locks, in spinlocks */
+	unsigned int			ehash_locks_shift;
 
 	/* Ok, let's try this, I give up, we do need a local binding
 	 * TCP hash as well as the others for fast bind/connect.
@@ -201,7 +203,8 @@ static inline spinlock_t *inet_ehash_lockp(
 	struct inet_hashinfo *hashinfo,
 	unsigned int hash)
 {
-	return &hashinfo->ehash_locks[hash & hashinfo->ehash_locks_mask];
+	return &hashinfo->ehash_locks[(hash & hashinfo->ehash_locks_mask) <<
+				      hashinfo->ehash_locks_shift];
 }
 
 int inet_ehash_locks_alloc(struct inet_hashinfo *hashinfo);
@@ -98,6 +98,10 @@ static inline struct in6_addr *inetpeer_get_addr_v6(struct inetpeer_addr *iaddr)
 struct inet_peer *inet_getpeer(struct inet_peer_base *base,
 			       const struct inetpeer_addr *daddr,
 			       int create);
+/* must be called under rcu_read_lock(), does not take a reference */
+struct inet_peer *inet_getpeer_rcu(struct inet_peer_base *base,
+				   const struct inetpeer_addr *daddr,
+				   int create);
 
 static inline struct inet_peer *inet_getpeer_v4(struct inet_peer_base *base,
 						__be32 v4daddr,
@@ -111,6 +115,18 @@ static inline struct inet_peer *inet_getpeer_v4(struct inet_peer_base *base,
 	return inet_getpeer(base, &daddr, create);
 }
 
+static inline struct inet_peer *inet_getpeer_v4_rcu(struct inet_peer_base *base,
+						    __be32 v4daddr,
+						    int vif, int create)
+{
+	struct inetpeer_addr daddr;
+
+	daddr.a4.addr = v4daddr;
+	daddr.a4.vif = vif;
+	daddr.family = AF_INET;
+	return inet_getpeer_rcu(base, &daddr, create);
+}
+
 static inline struct inet_peer *inet_getpeer_v6(struct inet_peer_base *base,
 						const struct in6_addr *v6daddr,
 						int create)
@@ -200,6 +200,7 @@ struct netns_ipv4 {
 	int sysctl_tcp_invalid_ratelimit;
 	int sysctl_tcp_pacing_ss_ratio;
 	int sysctl_tcp_pacing_ca_ratio;
+	unsigned int sysctl_tcp_pacing_train_us;
 	unsigned int sysctl_tcp_child_ehash_entries;
 	unsigned long sysctl_tcp_comp_sack_delay_ns;
 	unsigned long sysctl_tcp_comp_sack_slack_ns;
@@ -208,6 +209,7 @@ struct netns_ipv4 {
 	const struct tcp_congestion_ops __rcu  *tcp_congestion_control;
 	struct tcp_fastopen_context __rcu *tcp_fastopen_ctx;
 	unsigned int sysctl_tcp_fastopen_blackhole_timeout;
+	unsigned int sysctl_tcp_fastopen_key_rotate_secs;
 	atomic_t tfo_active_disable_times;
 	unsigned long tfo_active_disable_stamp;
 	u32 tcp_challenge_timestamp;
@@ -1929,6 +1929,7 @@ bool tcp_fastopen_defer_connect(struct sock *sk, int *err);
 struct tcp_fastopen_context {
 	siphash_key_t	key[TCP_FASTOPEN_KEY_MAX];
 	int		num;
+	unsigned long	stamp;	/* jiffies when key[0] became primary */
 	struct rcu_head	rcu;
 };
 
@@ -30,10 +30,17 @@ static inline char *format_react_msg_##name(type curr_state, type event)			\
 	return REACT_MSG_##name;								\
 }												\
 												\
-static void cond_react_##name(char *msg)							\
+/*												\
+ * cond_react_##name - react to the exception on the given state and event			\
+ *												\
+ * The message is only formatted if a reactor is set. The nop reactor leaves			\
+ * ->react unset, so monitors that are only consumed through their error			\
+ * tracepoints do not pay for it.								\
+ */												\
+static void cond_react_##name(type curr_state, type event)					\
 {												\
 	if (rv_##name.react)									\
-		rv_##name.react(msg);								\
+		rv_##name.react(format_react_msg_##name(curr_state, event));			\
 }												\
 												\
 static bool rv_reacting_on_##name(void)								\
@@ -49,7 +56,7 @@ static inline char *format_react_msg_##name(type curr_state, type event)			\
 	return NULL;										\
 }												\
 												\
-static void cond_react_##name(char *msg)							\
+static void cond_react_##name(type curr_state, type event)					\
 {												\
 	return;											\
 }												\
@@ -170,7 +177,7 @@ da_event_##name(struct da_monitor *da_mon, enum events_##name event)				\
 	}											\
 												\
 	if (rv_reacting_on_##name())								\
-		cond_react_##name(format_react_msg_##name(curr_state, event));			\
+		cond_react_##name(curr_state, event);						\
 												\
 	trace_error_##name(model_get_state_name_##name(curr_state),				\
 			   model_get_event_name_##name(event));					\
@@ -202,7 +209,7 @@ static inline bool da_event_##name(struct da_monitor *da_mon, struct task_struct
 	}											\
 												\
 	if (rv_reacting_on_##name())								\
-		cond_react_##name(format_react_msg_##name(curr_state, event));			\
+		cond_react_##name(curr_state, event);						\
 												\
 	trace_error_##name(tsk->pid,								\
 			   model_get_state_name_##name(curr_state),				\
@@ -51,6 +51,8 @@
 	_IOR('u', 0x13, struct ublksrv_ctrl_cmd)
 #define UBLK_U_CMD_DEL_DEV_ASYNC	\
 	_IOR('u', 0x14, struct ublksrv_ctrl_cmd)
+#define UBLK_U_CMD_GET_QUEUE_MAP	\
+	_IOR('u', 0x15, struct ublksrv_ctrl_cmd)
 
 /*
  * 64bits are enough now, and it should be easy to extend in case of
@@ -86,6 +88,7 @@
 #define	UBLK_IO_FETCH_REQ		0x20
 #define	UBLK_IO_COMMIT_AND_FETCH_REQ	0x21
 #define	UBLK_IO_NEED_GET_DATA	0x22
+#define	UBLK_IO_COMMIT_AND_FETCH_BATCH	0x23
 
 /* Any new IO command should encode by __IOWR() */
 #define	UBLK_U_IO_FETCH_REQ		\
@@ -94,6 +97,8 @@
 	_IOWR('u', UBLK_IO_COMMIT_AND_FETCH_REQ, struct ublksrv_io_cmd)
 #define	UBLK_U_IO_NEED_GET_DATA		\
 	_IOWR('u', UBLK_IO_NEED_GET_DATA, struct ublksrv_io_cmd)
+#define	UBLK_U_IO_COMMIT_AND_FETCH_BATCH	\
+	_IOWR('u', UBLK_IO_COMMIT_AND_FETCH_BATCH, struct ublksrv_io_cmd)
 
 /* only ABORT means that no re-fetch */
 #define UBLK_IO_RES_OK			0
@@ -101,6 +106,7 @@
 #define UBLK_IO_RES_ABORT		(-ENODEV)
 
 #define UBLKSRV_CMD_BUF_OFFSET	0
+#define UBLKSRV_BATCH_BUF_OFFSET	0x40000000
 #define UBLKSRV_IO_BUF_OFFSET	0x80000000
 
 /* tag bit is 16bit, so far limit at most 4096 IOs for each queue */
@@ -127,8 +133,14 @@
 #define UBLKSRV_IO_BUF_TOTAL_SIZE	(1ULL << UBLKSRV_IO_BUF_TOTAL_BITS)
 
 /*
- * zero copy requires 4k block size, and can remap ublk driver's io
- * request into ublksrv's vm space
+ * Zero copy of io request data by splice(2) on /dev/ublkcN, at the
+ * offsets used by UBLK_F_USER_COPY, which this flag implies: splicing
+ * from the char device moves the pages of a WRITE request into a pipe,
+ * and data for a READ request can be spliced in from a pipe, so it is
+ * never copied through an ublksrv buffer. Both work with IORING_OP_SPLICE.
+ *
+ * A request isn't completed before all of its pages spliced into pipes
+ * have been consumed.
  */
 #define UBLK_F_SUPPORT_ZERO_COPY	(1ULL << 0)
 
@@ -184,6 +196,35 @@
  */
 #define UBLK_F_ZONED (1ULL << 8)
 
+/*
+ * One io command per queue instead of per tag. Each queue has an array of
+ * struct ublk_batch_elem, mapped writable by ublksrv at
+ * UBLKSRV_BATCH_BUF_OFFSET + q_id * UBLK_MAX_QUEUE_DEPTH *
+ * sizeof(struct ublk_batch_elem).
+ *
+ * UBLK_U_IO_COMMIT_AND_FETCH_BATCH commits the first ublksrv_io_cmd.result
+ * elements of the array and then waits for new requests. Its cqe result
+ * is the number of new requests, whose tags have been written to the
+ * array, and which may be zero. There can only be one such command per
+ * queue in flight, and the array must not be touched while it is.
+ *
+ * The first command of a queue must commit nothing, and readies all of
+ * the queue's tags, so UBLK_IO_FETCH_REQ isn't used. Processing stops at
+ * the first invalid element, failing the command with -EINVAL; elements
+ * before it have been committed.
+ *
+ * Requires UBLK_F_USER_COPY, since no buffer addresses are passed.
+ */
+#define UBLK_F_BATCH_IO (1ULL << 9)
+
+/*
+ * Allocate the io descriptor buffer and the UBLK_F_BATCH_IO array of a
+ * queue on the NUMA node of the ublksrv thread which first maps them or
+ * issues an io command on the queue, instead of when the device is added.
+ * UBLK_U_CMD_GET_QUEUE_MAP reports where they ended up.
+ */
+#define UBLK_F_QUEUE_NUMA (1ULL << 10)
+
 /* device state */
 #define UBLK_S_DEV_DEAD	0
 #define UBLK_S_DEV_LIVE	1
@@ -330,6 +371,46 @@ struct ublksrv_io_cmd {
 	};
 };
 
+/*
+ * UBLK_U_CMD_GET_QUEUE_MAP fills the buffer of the command with this
+ * header, followed by nr_hw_queues struct ublk_queue_map_entry and then
+ * nr_cpus __u16 with the queue of each CPU id. If the buffer is too small
+ * for all of it, only the header is filled and -EOVERFLOW returned.
+ */
+struct ublk_queue_map {
+	__u16	nr_hw_queues;
+	__u16	reserved0;
+	__u32	nr_cpus;
+};
+
+struct ublk_queue_map_entry {
+	__u16	q_id;
+	/* blk-mq hardware queue the ublk queue serves */
+	__u16	hctx;
+	/* number of CPUs mapped to the queue */
+	__u32	nr_cpus;
+	/* NUMA node of the first CPU mapped to the queue, -1 for none */
+	__s32	hctx_node;
+	/* NUMA node of the io descriptors, -1 if not allocated yet */
+	__s32	buf_node;
+	/* pid, as seen by the caller, and CPU of the queue's ublksrv thread */
+	__s32	daemon_tid;
+	__s32	daemon_cpu;
+	__u64	reserved1;
+};
+
+/* element of the UBLK_F_BATCH_IO array */
+struct ublk_batch_elem {
+	__u16	tag;
+	__u16	reserved;
+
+	/* io result, set by ublksrv for commit */
+	__s32	result;
+
+	/* allocated LBA of UBLK_IO_OP_ZONE_APPEND, set for commit */
+	__u64	zone_append_lba;
+};
+
 struct ublk_param_basic {
 #define UBLK_ATTR_READ_ONLY            (1 << 0)
 #define UBLK_ATTR_ROTATIONAL           (1 << 1)
@@ -1140,6 +1140,8 @@ struct ufs_hba {
  * @cq_head_slot: current slot to which CQ head pointer is pointing
  * @cq_lock: Synchronize between multiple polling instances
  * @sq_mutex: prevent submission queue concurrent access
+ * @esi_irq: ESI vector of this queue, set by the host driver, 0 if none
+ * @intr_aggr: CQ interrupt aggregation is enabled on this queue
  */
 struct ufs_hw_queue {
 	void __iomem *mcq_sq_head;
@@ -1160,6 +1162,8 @@ struct ufs_hw_queue {
 	spinlock_t cq_lock;
 	/* prevent concurrent access to submission queue */
 	struct mutex sq_mutex;
+	int esi_irq;
+	bool intr_aggr;
 };
 
 #define MCQ_QCFG_SIZE		0x40
@@ -1314,6 +1318,7 @@ void ufshcd_mcq_make_queues_operational(struct ufs_hba *hba);
 void ufshcd_mcq_enable_esi(struct ufs_hba *hba);
 void ufshcd_mcq_enable(struct ufs_hba *hba);
 void ufshcd_mcq_config_esi(struct ufs_hba *hba, struct msi_msg *msg);
+void ufshcd_mcq_set_esi_affinity(struct ufs_hba *hba);
 
 int ufshcd_opp_config_clks(struct device *dev, struct opp_table *opp_table,
 			   struct dev_pm_opp *opp, void *data,
@@ -116,6 +116,7 @@ enum {
 enum {
 	REG_CQIS		= 0x0,
 	REG_CQIE		= 0x4,
+	REG_CQIACR		= 0x8,
 };
 
 enum {
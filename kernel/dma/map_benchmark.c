@@ -16,6 +16,7 @@
 #include <linux/module.h>
 #include <linux/pci.h>
 #include <linux/platform_device.h>
+#include <linux/scatterlist.h>
 #include <linux/slab.h>
 #include <linux/timekeeping.h>
 
@@ -24,46 +25,162 @@ struct map_benchmark_data {
 	struct device *dev;
 	struct dentry  *debugfs;
 	enum dma_data_direction dir;
+	unsigned long attrs;
 	atomic64_t sum_map_100ns;
 	atomic64_t sum_unmap_100ns;
 	atomic64_t sum_sq_map;
 	atomic64_t sum_sq_unmap;
 	atomic64_t loops;
+	atomic64_t map_hist[DMA_MAP_HIST_BUCKETS];
+	atomic64_t unmap_hist[DMA_MAP_HIST_BUCKETS];
 };
 
-static int map_benchmark_thread(void *data)
-{
+/* Per-thread state, the buffer is either one chunk or a list of pages */
+struct map_benchmark_buf {
 	void *buf;
 	dma_addr_t dma_addr;
-	struct map_benchmark_data *map = data;
+	struct sg_table sgt;
+	u64 map_hist[DMA_MAP_HIST_BUCKETS];
+	u64 unmap_hist[DMA_MAP_HIST_BUCKETS];
+};
+
+static bool map_benchmark_sg_mode(struct map_benchmark_data *map)
+{
+	return map->bparam.map_mode == DMA_MAP_SG_MODE;
+}
+
+static void map_benchmark_free_buf(struct map_benchmark_data *map,
+				   struct map_benchmark_buf *mb)
+{
+	struct scatterlist *sg;
+	int i;
+
+	if (!map_benchmark_sg_mode(map)) {
+		free_pages_exact(mb->buf, map->bparam.granule * PAGE_SIZE);
+		return;
+	}
+
+	for_each_sgtable_sg(&mb->sgt, sg, i)
+		if (sg_page(sg))
+			__free_page(sg_page(sg));
+	sg_free_table(&mb->sgt);
+}
+
+static int map_benchmark_alloc_buf(struct map_benchmark_data *map,
+				   struct map_benchmark_buf *mb)
+{
 	int npages = map->bparam.granule;
-	u64 size = npages * PAGE_SIZE;
+	struct scatterlist *sg;
+	int i;
+
+	if (!map_benchmark_sg_mode(map)) {
+		mb->buf = alloc_pages_exact(npages * PAGE_SIZE, GFP_KERNEL);
+		return mb->buf ? 0 : -ENOMEM;
+	}
+
+	/* use separate pages so that each entry is its own segment */
+	if (sg_alloc_table(&mb->sgt, npages, GFP_KERNEL))
+		return -ENOMEM;
+
+	for_each_sgtable_sg(&mb->sgt, sg, i) {
+		struct page *page = alloc_page(GFP_KERNEL);
+
+		if (!page) {
+			map_benchmark_free_buf(map, mb);
+			return -ENOMEM;
+		}
+		sg_set_page(sg, page, PAGE_SIZE, 0);
+	}
+
+	return 0;
+}
+
+static void map_benchmark_stain_buf(struct map_benchmark_data *map,
+				    struct map_benchmark_buf *mb)
+{
+	struct scatterlist *sg;
+	int i;
+
+	/*
+	 * for a non-coherent device, if we don't stain them in the
+	 * cache, this will give an underestimate of the real-world
+	 * overhead of BIDIRECTIONAL or TO_DEVICE mappings;
+	 * 66 means evertything goes well! 66 is lucky.
+	 */
+	if (map->dir == DMA_FROM_DEVICE)
+		return;
+
+	if (!map_benchmark_sg_mode(map)) {
+		memset(mb->buf, 0x66, map->bparam.granule * PAGE_SIZE);
+		return;
+	}
+
+	for_each_sgtable_sg(&mb->sgt, sg, i)
+		memset(sg_virt(sg), 0x66, sg->length);
+}
+
+static int map_benchmark_map(struct map_benchmark_data *map,
+			     struct map_benchmark_buf *mb)
+{
+	if (map_benchmark_sg_mode(map))
+		return dma_map_sgtable(map->dev, &mb->sgt, map->dir, map->attrs);
+
+	mb->dma_addr = dma_map_single_attrs(map->dev, mb->buf,
+					    map->bparam.granule * PAGE_SIZE,
+					    map->dir, map->attrs);
+	if (unlikely(dma_mapping_error(map->dev, mb->dma_addr)))
+		return -ENOMEM;
+	return 0;
+}
+
+static void map_benchmark_unmap(struct map_benchmark_data *map,
+				struct map_benchmark_buf *mb)
+{
+	if (map_benchmark_sg_mode(map))
+		dma_unmap_sgtable(map->dev, &mb->sgt, map->dir, map->attrs);
+	else
+		dma_unmap_single_attrs(map->dev, mb->dma_addr,
+				       map->bparam.granule * PAGE_SIZE,
+				       map->dir, map->attrs);
+}
+
+static unsigned int map_benchmark_hist_bucket(ktime_t delta)
+{
+	u64 ns = ktime_to_ns(delta);
+
+	if (!ns)
+		return 0;
+	return min_t(unsigned int, ilog2(ns), DMA_MAP_HIST_BUCKETS - 1);
+}
+
+static int map_benchmark_thread(void *data)
+{
+	struct map_benchmark_data *map = data;
+	struct map_benchmark_buf *mb;
 	int ret = 0;
+	int i;
 
-	buf = alloc_pages_exact(size, GFP_KERNEL);
-	if (!buf)
+	mb = kzalloc(sizeof(*mb), GFP_KERNEL);
+	if (!mb)
 		return -ENOMEM;
 
+	ret = map_benchmark_alloc_buf(map, mb);
+	if (ret)
+		goto out_free;
+
 	while (!kthread_should_stop())  {
 		u64 map_100ns, unmap_100ns, map_sq, unmap_sq;
 		ktime_t map_stime, map_etime, unmap_stime, unmap_etime;
 		ktime_t map_delta, unmap_delta;
 
-		/*
-		 * for a non-coherent device, if we don't stain them in the
-		 * cache, this will give an underestimate of the real-world
-		 * overhead of BIDIRECTIONAL or TO_DEVICE mappings;
-		 * 66 means evertything goes well! 66 is lucky.
-		 */
-		if (map->dir != DMA_FROM_DEVICE)
-			memset(buf, 0x66, size);
+		map_benchmark_stain_buf(map, mb);
 
 		map_stime = ktime_get();
-		dma_addr = dma_map_single(map->dev, buf, size, map->dir);
-		if (unlikely(dma_mapping_error(map->dev, dma_addr))) {
-			pr_err("dma_map_single failed on %s\n",
+		ret = map_benchmark_map(map, mb);
+		if (unlikely(ret)) {
+			pr_err("dma_map_%s failed on %s\n",
+				map_benchmark_sg_mode(map) ? "sg" : "single",
 				dev_name(map->dev));
-			ret = -ENOMEM;
 			goto out;
 		}
 		map_etime = ktime_get();
@@ -73,7 +190,7 @@ static int map_benchmark_thread(void *data)
 		ndelay(map->bparam.dma_trans_ns);
 
 		unmap_stime = ktime_get();
-		dma_unmap_single(map->dev, dma_addr, size, map->dir);
+		map_benchmark_unmap(map, mb);
 		unmap_etime = ktime_get();
 		unmap_delta = ktime_sub(unmap_etime, unmap_stime);
 
@@ -90,6 +207,10 @@ static int map_benchmark_thread(void *data)
 		atomic64_add(unmap_sq, &map->sum_sq_unmap);
 		atomic64_inc(&map->loops);
 
+		/* histograms are per thread and only summed up at the end */
+		mb->map_hist[map_benchmark_hist_bucket(map_delta)]++;
+		mb->unmap_hist[map_benchmark_hist_bucket(unmap_delta)]++;
+
 		/*
 		 * We may test for a long time so periodically check whether
 		 * we need to schedule to avoid starving the others. Otherwise
@@ -107,8 +228,15 @@ static int map_benchmark_thread(void *data)
 		cond_resched();
 	}
 
+	for (i = 0; i < DMA_MAP_HIST_BUCKETS; i++) {
+		atomic64_add(mb->map_hist[i], &map->map_hist[i]);
+		atomic64_add(mb->unmap_hist[i], &map->unmap_hist[i]);
+	}
+
 out:
-	free_pages_exact(buf, size);
+	map_benchmark_free_buf(map, mb);
+out_free:
+	kfree(mb);
 	return ret;
 }
 
@@ -148,6 +276,10 @@ static int do_map_benchmark(struct map_benchmark_data *map)
 	atomic64_set(&map->sum_sq_map, 0);
 	atomic64_set(&map->sum_sq_unmap, 0);
 	atomic64_set(&map->loops, 0);
+	for (i = 0; i < DMA_MAP_HIST_BUCKETS; i++) {
+		atomic64_set(&map->map_hist[i], 0);
+		atomic64_set(&map->unmap_hist[i], 0);
+	}
 
 	for (i = 0; i < threads; i++) {
 		get_task_struct(tsk[i]);
@@ -190,6 +322,11 @@ static int do_map_benchmark(struct map_benchmark_data *map)
 		map->bparam.unmap_stddev = int_sqrt64(unmap_variance);
 	}
 
+	for (i = 0; i < DMA_MAP_HIST_BUCKETS; i++) {
+		map->bparam.map_hist[i] = atomic64_read(&map->map_hist[i]);
+		map->bparam.unmap_hist[i] = atomic64_read(&map->unmap_hist[i]);
+	}
+
 out:
 	put_device(map->dev);
 	kfree(tsk);
@@ -238,6 +375,23 @@ static long map_benchmark_ioctl(struct file *file, unsigned int cmd,
 			return -EINVAL;
 		}
 
+		switch (map->bparam.map_mode) {
+		case DMA_MAP_SINGLE_MODE:
+		case DMA_MAP_SG_MODE:
+			break;
+		default:
+			pr_err("invalid map mode\n");
+			return -EINVAL;
+		}
+
+		if (map->bparam.dma_attrs & ~DMA_MAP_ATTR_SKIP_CPU_SYNC) {
+			pr_err("invalid DMA attributes\n");
+			return -EINVAL;
+		}
+		map->attrs = 0;
+		if (map->bparam.dma_attrs & DMA_MAP_ATTR_SKIP_CPU_SYNC)
+			map->attrs |= DMA_ATTR_SKIP_CPU_SYNC;
+
 		switch (map->bparam.dma_dir) {
 		case DMA_MAP_BIDIRECTIONAL:
 			map->dir = DMA_BIDIRECTIONAL;
@@ -26,6 +26,11 @@ static size_t atomic_pool_size;
 /* Dynamic background expansion when the atomic pool is near capacity */
 static struct work_struct atomic_pool_work;
 
+/* Largest request that failed in each pool since its last expansion */
+static size_t failed_size_dma;
+static size_t failed_size_dma32;
+static size_t failed_size_kernel;
+
 static int __init early_coherent_pool(char *p)
 {
 	atomic_pool_size = memparse(p, &p);
@@ -53,6 +58,15 @@ static void dma_atomic_pool_size_add(gfp_t gfp, size_t size)
 		pool_size_kernel += size;
 }
 
+static size_t *atomic_pool_failed_size(struct gen_pool *pool)
+{
+	if (pool == atomic_pool_dma)
+		return &failed_size_dma;
+	if (pool == atomic_pool_dma32)
+		return &failed_size_dma32;
+	return &failed_size_kernel;
+}
+
 static bool cma_in_zone(gfp_t gfp)
 {
 	unsigned long size;
@@ -144,8 +158,15 @@ static int atomic_pool_expand(struct gen_pool *pool, size_t pool_size,
 
 static void atomic_pool_resize(struct gen_pool *pool, gfp_t gfp)
 {
-	if (pool && gen_pool_avail(pool) < atomic_pool_size)
-		atomic_pool_expand(pool, gen_pool_size(pool), gfp);
+	size_t failed_size;
+
+	if (!pool)
+		return;
+
+	failed_size = xchg(atomic_pool_failed_size(pool), 0);
+	if (gen_pool_avail(pool) < atomic_pool_size + failed_size)
+		atomic_pool_expand(pool, max(gen_pool_size(pool), failed_size),
+				   gfp);
 }
 
 static void atomic_pool_work_fn(struct work_struct *work)
@@ -245,8 +266,23 @@ static struct page *__dma_alloc_from_pool(struct device *dev, size_t size,
 	phys_addr_t phys;
 
 	addr = gen_pool_alloc(pool, size);
-	if (!addr)
+	if (!addr) {
+		size_t *failed_size = atomic_pool_failed_size(pool);
+
+		/*
+		 * The pool may be above the watermark and still not have a
+		 * large enough free range, make sure its next expansion can
+		 * satisfy this size as well.  An allocation never spans two
+		 * chunks, and a chunk is at most MAX_PAGE_ORDER, so larger
+		 * requests can't be helped.  Racing updates only need to
+		 * leave some recent failed size behind.
+		 */
+		if (size <= (PAGE_SIZE << MAX_PAGE_ORDER) &&
+		    READ_ONCE(*failed_size) < size)
+			WRITE_ONCE(*failed_size, size);
+		schedule_work(&atomic_pool_work);
 		return NULL;
+	}
 
 	phys = gen_pool_virt_to_phys(pool, addr);
 	if (phys_addr_ok && !phys_addr_ok(dev, phys, size)) {
@@ -1066,6 +1066,7 @@ static int swiotlb_search_pool_area(struct device *dev, struct io_tlb_pool *pool
 	index = area->index;
 
 	for (slots_checked = 0; slots_checked < pool->area_nslabs; ) {
+		unsigned int skip = stride;
 		phys_addr_t tlb_addr;
 
 		slot_index = slot_base + index;
@@ -1082,11 +1083,22 @@ static int swiotlb_search_pool_area(struct device *dev, struct io_tlb_pool *pool
 		if (!iommu_is_span_boundary(slot_index, nslots,
 					    nr_slots(tbl_dma_addr),
 					    max_slots)) {
-			if (pool->slots[slot_index].list >= nslots)
+			unsigned int free = pool->slots[slot_index].list;
+
+			if (free >= nslots)
 				goto found;
+
+			/*
+			 * A free run ends at an allocated slot or a segment
+			 * boundary, so no slot within a run that is too short
+			 * can start a long enough one either.  Skip past it
+			 * instead of testing each slot in turn.
+			 */
+			if (free)
+				skip = round_up(free, stride);
 		}
-		index = wrap_area_index(pool, index + stride);
-		slots_checked += stride;
+		index = wrap_area_index(pool, index + skip);
+		slots_checked += skip;
 	}
 
 not_found:
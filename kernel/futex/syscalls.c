@@ -354,6 +354,46 @@ SYSCALL_DEFINE4(futex_wake,
 	return futex_wake(uaddr, FLAGS_STRICT | flags, nr, mask);
 }
 
+/*
+ * sys_futex_wakev - Wake a number of waiters on a list of futexes
+ * @wakers:	List of futexes to wake
+ * @nr_futexes:	Length of @wakers
+ * @flags:	unused
+ *
+ * Given an array of `struct futex_waitv`, wake up to val waiters on each
+ * uaddr, as futex_wake() with a FUTEX_BITSET_MATCH_ANY mask would do. Each
+ * entry has individual flags. The hash bucket shared by several entries is
+ * only locked once.
+ *
+ * Returns the total number of woken waiters.
+ */
+SYSCALL_DEFINE3(futex_wakev,
+		struct futex_waitv __user *, wakers,
+		unsigned int, nr_futexes,
+		unsigned int, flags)
+{
+	struct futex_vector *futexv;
+	int ret;
+
+	if (flags)
+		return -EINVAL;
+
+	if (!nr_futexes || nr_futexes > FUTEX_WAITV_MAX || !wakers)
+		return -EINVAL;
+
+	futexv = kcalloc(nr_futexes, sizeof(*futexv), GFP_KERNEL);
+	if (!futexv)
+		return -ENOMEM;
+
+	ret = futex_parse_waitv(futexv, wakers, nr_futexes, futex_wake_mark,
+				NULL);
+	if (!ret)
+		ret = futex_wake_multiple(futexv, nr_futexes);
+
+	kfree(futexv);
+	return ret;
+}
+
 /*
  * sys_futex_wait - Wait on a futex
  * @uaddr:	Address of the futex to wait on
@@ -4,6 +4,7 @@
 #include <linux/sched/task.h>
 #include <linux/sched/signal.h>
 #include <linux/freezer.h>
+#include <linux/sort.h>
 
 #include "futex.h"
 
@@ -200,6 +201,93 @@ int futex_wake(u32 __user *uaddr, unsigned int flags, int nr_wake, u32 bitset)
 	return ret;
 }
 
+static int futex_vector_cmp(const void *a, const void *b)
+{
+	const struct futex_vector *va = a, *vb = b;
+
+	if (va->q.lock_ptr == vb->q.lock_ptr)
+		return 0;
+	return va->q.lock_ptr < vb->q.lock_ptr ? -1 : 1;
+}
+
+/**
+ * futex_wake_multiple - Wake waiters on a list of futexes
+ * @vs:		The futex list to wake, @vs[i].w.val is the number to wake
+ * @count:	The number of entries in @vs
+ *
+ * Equivalent to futex_wake() with FUTEX_BITSET_MATCH_ANY on each entry, but
+ * the entries are visited in hash bucket order so that each bucket lock is
+ * taken only once, and all waiters are woken after the last bucket lock is
+ * dropped. @vs is reordered.
+ *
+ * Return: the total number of woken waiters, or a negative error code.
+ */
+int futex_wake_multiple(struct futex_vector *vs, unsigned int count)
+{
+	struct futex_hash_bucket *hb, *locked = NULL;
+	struct futex_q *this, *next;
+	DEFINE_WAKE_Q(wake_q);
+	unsigned int i;
+	int ret;
+
+	for (i = 0; i < count; i++) {
+		struct futex_vector *v = &vs[i];
+
+		ret = get_futex_key(u64_to_user_ptr(v->w.uaddr), v->w.flags,
+				    &v->q.key, FUTEX_READ);
+		if (unlikely(ret))
+			return ret;
+
+		/* Only used to order and find the buckets below */
+		v->q.lock_ptr = &futex_hash(&v->q.key)->lock;
+	}
+
+	sort(vs, count, sizeof(*vs), futex_vector_cmp, NULL);
+
+	for (i = 0; i < count; i++) {
+		struct futex_vector *v = &vs[i];
+		u64 woken = 0;
+
+		if (!v->w.val)
+			continue;
+
+		hb = container_of(v->q.lock_ptr, struct futex_hash_bucket, lock);
+		if (hb != locked) {
+			if (locked)
+				spin_unlock(&locked->lock);
+			locked = NULL;
+
+			/* Make sure we really have tasks to wakeup */
+			if (!futex_hb_waiters_pending(hb))
+				continue;
+
+			spin_lock(&hb->lock);
+			locked = hb;
+		}
+
+		plist_for_each_entry_safe(this, next, &hb->chain, list) {
+			if (!futex_match(&this->key, &v->q.key))
+				continue;
+
+			if (this->pi_state || this->rt_waiter) {
+				ret = -EINVAL;
+				goto out_unlock;
+			}
+
+			this->wake(&wake_q, this);
+			ret++;
+			if (++woken >= v->w.val)
+				break;
+		}
+	}
+
+out_unlock:
+	if (locked)
+		spin_unlock(&locked->lock);
+	wake_up_q(&wake_q);
+	return ret;
+}
+
 static int futex_atomic_op_inuser(unsigned int encoded_op, u32 __user *uaddr)
 {
 	unsigned int op =	  (encoded_op & 0x70000000) >> 28;
@@ -8,6 +8,7 @@
 #define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
 
 #include <linux/cpu.h>
+#include <linux/sched/stat.h>
 #include <linux/stacktrace.h>
 #include <linux/static_call.h>
 #include "core.h"
@@ -21,6 +22,9 @@ static DEFINE_PER_CPU(unsigned long[MAX_STACK_ENTRIES], klp_stack_entries);
 
 #define SIGNALS_TIMEOUT 15
 
+/* Check the stacks on all CPUs in parallel from this many threads on */
+#define KLP_PARALLEL_SWITCH_TASKS 4096
+
 struct klp_patch *klp_transition_patch;
 
 static int klp_target_state = KLP_TRANSITION_IDLE;
@@ -440,6 +444,23 @@ static void klp_send_signals(void)
 	read_unlock(&tasklist_lock);
 }
 
+/*
+ * Try to switch this CPU's share of the tasks, those whose pid modulo
+ * nr_cpu_ids is the CPU number.
+ */
+static void klp_try_switch_tasks_fn(struct work_struct *work)
+{
+	unsigned int cpu = raw_smp_processor_id();
+	struct task_struct *g, *task;
+
+	read_lock(&tasklist_lock);
+	for_each_process_thread(g, task) {
+		if (task->pid % nr_cpu_ids == cpu)
+			klp_try_switch_task(task);
+	}
+	read_unlock(&tasklist_lock);
+}
+
 /*
  * Try to switch all remaining tasks to the target patch state by walking the
  * stacks of sleeping tasks and looking for any to-be-patched or
@@ -465,7 +486,16 @@ void klp_try_complete_transition(void)
 	 *
 	 * Usually this will transition most (or all) of the tasks on a system
 	 * unless the patch includes changes to a very common function.
+	 *
+	 * With many tasks, do the stack walks on all CPUs in parallel first.
+	 * That pass is only an accelerator: it may miss tasks due to CPU
+	 * hotplug, and the workers can't switch each other while they run.
+	 * The serial pass below is what decides completion, and it is cheap
+	 * for tasks which have already switched.
 	 */
+	if (nr_threads >= KLP_PARALLEL_SWITCH_TASKS && num_online_cpus() > 1)
+		schedule_on_each_cpu(klp_try_switch_tasks_fn);
+
 	read_lock(&tasklist_lock);
 	for_each_process_thread(g, task)
 		if (!klp_try_switch_task(task))
@@ -11,6 +11,7 @@
 
 #define pr_fmt(fmt) fmt
 
+#include <linux/debugfs.h>
 #include <linux/kernel.h>
 #include <linux/module.h>
 #include <linux/kthread.h>
@@ -29,14 +30,18 @@
 #include <linux/slab.h>
 #include <linux/torture.h>
 #include <linux/reboot.h>
+#include <linux/seq_file.h>
 
 MODULE_DESCRIPTION("torture test facility for locking");
 MODULE_LICENSE("GPL");
 MODULE_AUTHOR("Paul E. McKenney <paulmck@linux.ibm.com>");
 
 torture_param(int, acq_writer_lim, 0, "Write_acquisition time limit (jiffies).");
+torture_param(bool, acq_lat_hist, false, "Record lock-acquisition latency histograms");
 torture_param(int, call_rcu_chains, 0, "Self-propagate call_rcu() chains during test (0=disable).");
+torture_param(int, cs_ns, 0, "Critical-section length (ns), 0=use lock type's own delays");
 torture_param(int, long_hold, 100, "Do occasional long hold of lock (ms), 0=disable");
+torture_param(int, ncs_ns, 0, "Delay between lock acquisitions (ns), 0=disable");
 torture_param(int, nested_locks, 0, "Number of nested locks (max = 8)");
 torture_param(int, nreaders_stress, -1, "Number of read-locking stress-test threads");
 torture_param(int, nwriters_stress, -1, "Number of write-locking stress-test threads");
@@ -109,6 +114,7 @@ module_param_cb(bind_writers, &lt_bind_ops, &bind_writers, 0644);
 long torture_sched_setaffinity(pid_t pid, const struct cpumask *in_mask);
 
 static struct task_struct *stats_task;
+static struct dentry *lock_torture_debugfs;
 static struct task_struct **writer_tasks;
 static struct task_struct **reader_tasks;
 
@@ -116,9 +122,13 @@ static bool lock_is_write_held;
 static atomic_t lock_is_read_held;
 static unsigned long last_lock_release;
 
+/* Bucket i counts acquisitions that took [2^i, 2^(i+1)) nanoseconds. */
+#define LOCK_TORTURE_LAT_BUCKETS 32
+
 struct lock_stress_stats {
 	long n_lock_fail;
 	long n_lock_acquired;
+	long acq_lat_hist[LOCK_TORTURE_LAT_BUCKETS];
 };
 
 struct call_rcu_chain {
@@ -836,6 +846,32 @@ static struct lock_torture_ops percpu_rwsem_lock_ops = {
 	.name		= "percpu_rwsem_lock"
 };
 
+/*
+ * Account one lock acquisition that started at @start (ns) in the
+ * latency histogram of @lsp.
+ */
+static void lock_torture_acq_lat(struct lock_stress_stats *lsp, u64 start)
+{
+	u64 delta = ktime_get_ns() - start;
+	int b = delta ? min_t(int, ilog2(delta), LOCK_TORTURE_LAT_BUCKETS - 1) : 0;
+
+	lsp->acq_lat_hist[b]++;
+}
+
+/*
+ * Replace the lock type's randomized hold time with a fixed critical
+ * section when cs_ns is specified, which is what throughput and fairness
+ * comparisons between lock implementations want.
+ */
+static void lock_torture_cs_delay(void (*delay)(struct torture_random_state *trsp),
+				  struct torture_random_state *trsp)
+{
+	if (cs_ns > 0)
+		ndelay(cs_ns);
+	else
+		delay(trsp);
+}
+
 /*
  * Lock torture writer kthread.  Repeatedly acquires and releases
  * the lock, checking for duplicate acquisitions.
@@ -844,6 +880,7 @@ static int lock_torture_writer(void *arg)
 {
 	unsigned long j;
 	unsigned long j1;
+	u64 t0 = 0;
 	u32 lockset_mask;
 	struct lock_stress_stats *lwsp = arg;
 	DEFINE_TORTURE_RANDOM(rand);
@@ -877,6 +914,8 @@ static int lock_torture_writer(void *arg)
 		if (!skip_main_lock) {
 			if (acq_writer_lim > 0)
 				j = jiffies;
+			if (acq_lat_hist)
+				t0 = ktime_get_ns();
 			cxt.cur_ops->writelock(tid);
 			if (WARN_ON_ONCE(lock_is_write_held))
 				lwsp->n_lock_fail++;
@@ -890,8 +929,10 @@ static int lock_torture_writer(void *arg)
 					  __func__, j1 - j);
 			}
 			lwsp->n_lock_acquired++;
+			if (acq_lat_hist)
+				lock_torture_acq_lat(lwsp, t0);
 
-			cxt.cur_ops->write_delay(&rand);
+			lock_torture_cs_delay(cxt.cur_ops->write_delay, &rand);
 
 			lock_is_write_held = false;
 			WRITE_ONCE(last_lock_release, jiffies);
@@ -899,6 +940,8 @@ static int lock_torture_writer(void *arg)
 		}
 		if (cxt.cur_ops->nested_unlock)
 			cxt.cur_ops->nested_unlock(tid, lockset_mask);
+		if (ncs_ns > 0)
+			ndelay(ncs_ns);
 
 		stutter_wait("lock_torture_writer");
 	} while (!torture_must_stop());
@@ -917,6 +960,7 @@ static int lock_torture_reader(void *arg)
 	struct lock_stress_stats *lrsp = arg;
 	int tid = lrsp - cxt.lrsa;
 	DEFINE_TORTURE_RANDOM(rand);
+	u64 t0 = 0;
 
 	VERBOSE_TOROUT_STRING("lock_torture_reader task started");
 	set_user_nice(current, MAX_NICE);
@@ -925,15 +969,21 @@ static int lock_torture_reader(void *arg)
 		if ((torture_random(&rand) & 0xfffff) == 0)
 			schedule_timeout_uninterruptible(1);
 
+		if (acq_lat_hist)
+			t0 = ktime_get_ns();
 		cxt.cur_ops->readlock(tid);
 		atomic_inc(&lock_is_read_held);
 		if (WARN_ON_ONCE(lock_is_write_held))
 			lrsp->n_lock_fail++; /* rare, but... */
 
 		lrsp->n_lock_acquired++;
-		cxt.cur_ops->read_delay(&rand);
+		if (acq_lat_hist)
+			lock_torture_acq_lat(lrsp, t0);
+		lock_torture_cs_delay(cxt.cur_ops->read_delay, &rand);
 		atomic_dec(&lock_is_read_held);
 		cxt.cur_ops->readunlock(tid);
+		if (ncs_ns > 0)
+			ndelay(ncs_ns);
 
 		stutter_wait("lock_torture_reader");
 	} while (!torture_must_stop());
@@ -941,6 +991,34 @@ static int lock_torture_reader(void *arg)
 	return 0;
 }
 
+/*
+ * Print the upper bounds of the buckets holding the 50th, 90th, 99th and
+ * 99.9th percentile and the largest acquisition latency, all in ns.
+ */
+static void __torture_print_lat(char *page, struct lock_stress_stats *statp,
+				int n_stress, long long sum)
+{
+	static const int pct[] = { 500, 900, 990, 999 };
+	long long hist[LOCK_TORTURE_LAT_BUCKETS] = { };
+	long long cum = 0;
+	int b, i, p = 0, maxb = 0;
+
+	for (i = 0; i < n_stress; i++)
+		for (b = 0; b < LOCK_TORTURE_LAT_BUCKETS; b++)
+			hist[b] += data_race(statp[i].acq_lat_hist[b]);
+	page += sprintf(page, "        Acquire latency (ns) <=");
+	for (b = 0; b < LOCK_TORTURE_LAT_BUCKETS; b++) {
+		if (!hist[b])
+			continue;
+		maxb = b;
+		cum += hist[b];
+		for (; p < ARRAY_SIZE(pct) && cum * 1000 >= sum * pct[p]; p++)
+			page += sprintf(page, " p%d.%d: %llu", pct[p] / 10,
+					pct[p] % 10, (2ULL << b) - 1);
+	}
+	sprintf(page, " max: %llu\n", (2ULL << maxb) - 1);
+}
+
 /*
  * Create an lock-torture-statistics message in the specified buffer.
  */
@@ -972,6 +1050,8 @@ static void __torture_print_stats(char *page,
 			fail, fail ? "!!!" : "");
 	if (fail)
 		atomic_inc(&cxt.n_lock_torture_errors);
+	if (acq_lat_hist && sum)
+		__torture_print_lat(page, statp, n_stress, sum);
 }
 
 /*
@@ -1015,6 +1095,46 @@ static void lock_torture_stats_print(void)
 	}
 }
 
+static void lock_torture_show_stats(struct seq_file *m, const char *name,
+				    struct lock_stress_stats *statp, int n_stress)
+{
+	long long hist[LOCK_TORTURE_LAT_BUCKETS] = { };
+	long long acquired = 0, fail = 0;
+	int b, i;
+
+	for (i = 0; i < n_stress; i++) {
+		acquired += data_race(statp[i].n_lock_acquired);
+		fail += data_race(statp[i].n_lock_fail);
+		for (b = 0; b < LOCK_TORTURE_LAT_BUCKETS; b++)
+			hist[b] += data_race(statp[i].acq_lat_hist[b]);
+	}
+
+	seq_printf(m, "%s_threads: %d\n", name, n_stress);
+	seq_printf(m, "%s_acquired: %lld\n", name, acquired);
+	seq_printf(m, "%s_fail: %lld\n", name, fail);
+	seq_printf(m, "%s_lat_ns:", name);
+	for (b = 0; b < LOCK_TORTURE_LAT_BUCKETS; b++)
+		seq_printf(m, " %lld", hist[b]);
+	seq_putc(m, '\n');
+}
+
+/*
+ * Raw counters for tools such as "perf bench kernel-lock", one "key: value"
+ * pair per line.  The *_lat_ns lines hold the acquire latency histogram,
+ * which stays all zero unless acq_lat_hist is set.  Unlike the printk()
+ * statistics this does not account failures, so any number of readers may
+ * run concurrently with the stats kthread.
+ */
+static int lock_torture_raw_stats_show(struct seq_file *m, void *unused)
+{
+	seq_printf(m, "type: %s\n", cxt.cur_ops->name);
+	lock_torture_show_stats(m, "write", cxt.lwsa, cxt.nrealwriters_stress);
+	if (cxt.cur_ops->readlock)
+		lock_torture_show_stats(m, "read", cxt.lrsa, cxt.nrealreaders_stress);
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(lock_torture_raw_stats);
+
 /*
  * Periodically prints torture statistics, if periodic statistics printing
  * was specified via the stat_interval module parameter.
@@ -1045,10 +1165,11 @@ lock_torture_print_module_parms(struct lock_torture_ops *cur_ops,
 
 	cpumask_setall(&cpumask_all);
 	pr_alert("%s" TORTURE_FLAG
-		 "--- %s%s: acq_writer_lim=%d bind_readers=%*pbl bind_writers=%*pbl call_rcu_chains=%d long_hold=%d nested_locks=%d nreaders_stress=%d nwriters_stress=%d onoff_holdoff=%d onoff_interval=%d rt_boost=%d rt_boost_factor=%d shuffle_interval=%d shutdown_secs=%d stat_interval=%d stutter=%d verbose=%d writer_fifo=%d\n",
+		 "--- %s%s: acq_lat_hist=%d acq_writer_lim=%d bind_readers=%*pbl bind_writers=%*pbl call_rcu_chains=%d cs_ns=%d long_hold=%d ncs_ns=%d nested_locks=%d nreaders_stress=%d nwriters_stress=%d onoff_holdoff=%d onoff_interval=%d rt_boost=%d rt_boost_factor=%d shuffle_interval=%d shutdown_secs=%d stat_interval=%d stutter=%d verbose=%d writer_fifo=%d\n",
 		 torture_type, tag, cxt.debug_lock ? " [debug]": "",
-		 acq_writer_lim, cpumask_pr_args(rcmp), cpumask_pr_args(wcmp),
-		 call_rcu_chains, long_hold, nested_locks, cxt.nrealreaders_stress,
+		 acq_lat_hist, acq_writer_lim, cpumask_pr_args(rcmp),
+		 cpumask_pr_args(wcmp), call_rcu_chains, cs_ns, long_hold, ncs_ns,
+		 nested_locks, cxt.nrealreaders_stress,
 		 cxt.nrealwriters_stress, onoff_holdoff, onoff_interval, rt_boost,
 		 rt_boost_factor, shuffle_interval, shutdown_secs, stat_interval, stutter,
 		 verbose, writer_fifo);
@@ -1116,6 +1237,10 @@ static void lock_torture_cleanup(void)
 	if (!cxt.lwsa && !cxt.lrsa)
 		goto end;
 
+	/* Waits for readers, so the statistics can be freed below. */
+	debugfs_remove_recursive(lock_torture_debugfs);
+	lock_torture_debugfs = NULL;
+
 	if (writer_tasks) {
 		for (i = 0; i < cxt.nrealwriters_stress; i++)
 			torture_stop_kthread(lock_torture_writer, writer_tasks[i]);
@@ -1232,9 +1357,8 @@ static int __init lock_torture_init(void)
 	/* Initialize the statistics so that each run gets its own numbers. */
 	if (nwriters_stress) {
 		lock_is_write_held = false;
-		cxt.lwsa = kmalloc_array(cxt.nrealwriters_stress,
-					 sizeof(*cxt.lwsa),
-					 GFP_KERNEL);
+		cxt.lwsa = kcalloc(cxt.nrealwriters_stress, sizeof(*cxt.lwsa),
+				   GFP_KERNEL);
 		if (cxt.lwsa == NULL) {
 			VERBOSE_TOROUT_STRING("cxt.lwsa: Out of memory");
 			firsterr = -ENOMEM;
@@ -1262,9 +1386,8 @@ static int __init lock_torture_init(void)
 		}
 
 		if (nreaders_stress) {
-			cxt.lrsa = kmalloc_array(cxt.nrealreaders_stress,
-						 sizeof(*cxt.lrsa),
-						 GFP_KERNEL);
+			cxt.lrsa = kcalloc(cxt.nrealreaders_stress, sizeof(*cxt.lrsa),
+					   GFP_KERNEL);
 			if (cxt.lrsa == NULL) {
 				VERBOSE_TOROUT_STRING("cxt.lrsa: Out of memory");
 				firsterr = -ENOMEM;
@@ -1377,6 +1500,9 @@ static int __init lock_torture_init(void)
 		if (torture_init_error(firsterr))
 			goto unwind;
 	}
+	lock_torture_debugfs = debugfs_create_dir("locktorture", NULL);
+	debugfs_create_file("stats", 0444, lock_torture_debugfs, NULL,
+			    &lock_torture_raw_stats_fops);
 	torture_init_end();
 	return 0;
 
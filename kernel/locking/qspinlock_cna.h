@@ -0,0 +1,312 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _GEN_CNA_LOCK_SLOWPATH
+#error "do not include this file"
+#endif
+
+#include <linux/topology.h>
+#include <linux/sched/clock.h>
+
+/*
+ * Implement a NUMA-aware version of MCS (aka CNA, or compact NUMA-aware lock).
+ *
+ * In CNA, spinning threads are organized in two queues, a primary queue for
+ * threads running on the same NUMA node as the current lock holder, and a
+ * secondary queue for threads running on other nodes. Schematically, it
+ * looks like this:
+ *
+ *    cna_node
+ *   +----------+     +--------+         +--------+
+ *   |mcs:next  | --> |mcs:next| --> ... |mcs:next| --> NULL  [Primary queue]
+ *   |mcs:locked| -.  +--------+         +--------+
+ *   +----------+  |
+ *                 `----------------------.
+ *                                        v
+ *                 +--------+         +--------+
+ *                 |mcs:next| --> ... |mcs:next|            [Secondary queue]
+ *                 +--------+         +--------+
+ *                     ^                    |
+ *                     `--------------------'
+ *
+ * N.B. locked := 1 if secondary queue is absent. Otherwise, it contains the
+ * encoded pointer to the tail of the secondary queue, which is organized as a
+ * circular list.
+ *
+ * After acquiring the MCS lock and before acquiring the spinlock, the MCS lock
+ * holder checks whether the next waiter in the primary queue (if exists) is
+ * running on the same NUMA node. If it is not, that waiter is detached from
+ * the main queue and moved into the tail of the secondary queue. This way, we
+ * gradually filter the primary queue, leaving only waiters running on the same
+ * preferred NUMA node.
+ *
+ * We change the NUMA node preference after a waiter at the head of the
+ * secondary queue spins for a certain amount of time (1ms by default, see
+ * numa_spinlock_threshold=). We do that by flushing the secondary queue into
+ * the head of the primary queue, effectively changing the preference to the
+ * NUMA node of the waiter at the head of the secondary queue at the time of
+ * the flush.
+ *
+ * Waiters from non-task contexts are never moved to the secondary queue, so
+ * that interrupt handlers don't see the extra latency.
+ *
+ * For more details, see "Compact NUMA-aware Locks" by Dave Dice and Alex
+ * Kogan, EuroSys 2019.
+ */
+
+#define FLUSH_SECONDARY_QUEUE	1
+
+#define CNA_PRIORITY_NODE	0xffff
+
+struct cna_node {
+	struct mcs_spinlock	mcs;
+	u16			numa_node;
+	u16			real_numa_node;
+	u32			encoded_tail;	/* self */
+	u64			start_time;
+};
+
+static ulong numa_spinlock_threshold_ns __ro_after_init = NSEC_PER_MSEC;
+
+static bool numa_spinlock __initdata;
+
+static int __init numa_spinlock_setup(char *str)
+{
+	if (!strcmp(str, "on")) {
+		numa_spinlock = true;
+		return 1;
+	}
+	if (!strcmp(str, "off")) {
+		numa_spinlock = false;
+		return 1;
+	}
+	return 0;
+}
+__setup("numa_spinlock=", numa_spinlock_setup);
+
+static int __init numa_spinlock_threshold_setup(char *str)
+{
+	unsigned int ms;
+
+	if (kstrtouint(str, 0, &ms) || !ms)
+		return 0;
+
+	numa_spinlock_threshold_ns = (ulong)ms * NSEC_PER_MSEC;
+	return 1;
+}
+__setup("numa_spinlock_threshold=", numa_spinlock_threshold_setup);
+
+static void __init cna_init_nodes_per_cpu(unsigned int cpu)
+{
+	struct mcs_spinlock *base = per_cpu_ptr(&qnodes[0].mcs, cpu);
+	int numa_node = cpu_to_node(cpu);
+	int i;
+
+	for (i = 0; i < MAX_NODES; i++) {
+		struct cna_node *cn = (struct cna_node *)grab_mcs_node(base, i);
+
+		cn->real_numa_node = numa_node;
+		cn->encoded_tail = encode_tail(cpu, i);
+		/*
+		 * make sure @encoded_tail is not confused with other valid
+		 * values for @locked (0 or 1)
+		 */
+		WARN_ON(cn->encoded_tail <= 1);
+	}
+}
+
+static void __init cna_init_nodes(void)
+{
+	unsigned int cpu;
+
+	/* struct cna_node lives in the PV padding of struct qnode */
+	BUILD_BUG_ON(sizeof(struct cna_node) > sizeof(struct qnode));
+	/* we store an encoded tail word in the node's @locked field */
+	BUILD_BUG_ON(sizeof(u32) > sizeof(int));
+
+	for_each_possible_cpu(cpu)
+		cna_init_nodes_per_cpu(cpu);
+}
+
+static __always_inline void cna_init_node(struct mcs_spinlock *node)
+{
+	struct cna_node *cn = (struct cna_node *)node;
+
+	cn->numa_node = in_task() ? cn->real_numa_node : CNA_PRIORITY_NODE;
+	cn->start_time = 0;
+}
+
+static inline bool intra_node_threshold_reached(struct cna_node *cn)
+{
+	u64 current_time = local_clock();
+	u64 threshold = cn->start_time + numa_spinlock_threshold_ns;
+
+	return current_time > threshold;
+}
+
+/*
+ * cna_splice_next -- splice the next node from the primary queue onto
+ * the secondary queue.
+ */
+static void cna_splice_next(struct mcs_spinlock *node,
+			    struct mcs_spinlock *next,
+			    struct mcs_spinlock *nnext)
+{
+	struct cna_node *cn = (struct cna_node *)node;
+
+	/* remove 'next' from the main queue */
+	node->next = nnext;
+
+	/* stick `next` on the secondary queue tail */
+	if (node->locked <= 1) { /* if secondary queue is empty */
+		/* start the fairness clock for the current node */
+		cn->start_time = max_t(u64, local_clock(),
+				       FLUSH_SECONDARY_QUEUE + 1);
+
+		/* create secondary queue */
+		next->next = next;
+	} else {
+		/* add to the tail of the secondary queue */
+		struct mcs_spinlock *tail_2nd = decode_tail(node->locked);
+		struct mcs_spinlock *head_2nd = tail_2nd->next;
+
+		tail_2nd->next = next;
+		next->next = head_2nd;
+	}
+
+	node->locked = ((struct cna_node *)next)->encoded_tail;
+}
+
+/*
+ * cna_order_queue - check whether the next waiter in the main queue is on
+ * the same NUMA node as the lock holder; if not, and it has a waiter behind
+ * it in the main queue, move the former onto the secondary queue.
+ * Returns true if the next waiter runs on the same NUMA node; false otherwise.
+ */
+static bool cna_order_queue(struct mcs_spinlock *node)
+{
+	struct mcs_spinlock *next = READ_ONCE(node->next);
+	struct cna_node *cn = (struct cna_node *)node;
+	int numa_node, next_numa_node;
+
+	if (!next)
+		return false;
+
+	numa_node = cn->numa_node;
+	next_numa_node = ((struct cna_node *)next)->numa_node;
+
+	if (next_numa_node != numa_node && next_numa_node != CNA_PRIORITY_NODE) {
+		struct mcs_spinlock *nnext = READ_ONCE(next->next);
+
+		if (nnext)
+			cna_splice_next(node, next, nnext);
+
+		return false;
+	}
+	return true;
+}
+
+#define LOCK_IS_BUSY(lock) (atomic_read(&(lock)->val) & _Q_LOCKED_PENDING_MASK)
+
+/* Abuse the pv_wait_head_or_lock() hook to get some work done */
+static __always_inline u32 cna_wait_head_or_lock(struct qspinlock *lock,
+						 struct mcs_spinlock *node)
+{
+	struct cna_node *cn = (struct cna_node *)node;
+
+	if (!cn->start_time || !intra_node_threshold_reached(cn)) {
+		/*
+		 * We are at the head of the wait queue, no need to use
+		 * the fake NUMA node ID.
+		 */
+		if (cn->numa_node == CNA_PRIORITY_NODE)
+			cn->numa_node = cn->real_numa_node;
+
+		/*
+		 * Try and put the time otherwise spent spin waiting on
+		 * _Q_LOCKED_PENDING_MASK to use by sorting our lists.
+		 */
+		while (LOCK_IS_BUSY(lock) && !cna_order_queue(node))
+			cpu_relax();
+	} else {
+		cn->start_time = FLUSH_SECONDARY_QUEUE;
+	}
+
+	return 0; /* we lock the lock in regular post-lock code */
+}
+
+static __always_inline bool cna_try_clear_tail(struct qspinlock *lock,
+					       u32 val,
+					       struct mcs_spinlock *node)
+{
+	struct mcs_spinlock *head_2nd, *tail_2nd;
+	u32 new;
+
+	/* If the secondary queue is empty, do what MCS does. */
+	if (node->locked <= 1)
+		return __try_clear_tail(lock, val, node);
+
+	/*
+	 * Try to update the tail value to the last node in the secondary queue.
+	 * If successful, pass the lock to the first thread in the secondary
+	 * queue. Doing those two actions effectively moves all nodes from the
+	 * secondary queue into the main one.
+	 */
+	tail_2nd = decode_tail(node->locked);
+	head_2nd = tail_2nd->next;
+	new = ((struct cna_node *)tail_2nd)->encoded_tail + _Q_LOCKED_VAL;
+
+	/*
+	 * Terminate the secondary queue before it becomes the primary one;
+	 * the release below orders this against a new waiter linking itself
+	 * behind @tail_2nd.
+	 */
+	tail_2nd->next = NULL;
+	if (atomic_try_cmpxchg_release(&lock->val, &val, new)) {
+		arch_mcs_spin_unlock_contended(&head_2nd->locked);
+		return true;
+	}
+
+	/* Somebody queued behind us, restore the secondary queue. */
+	tail_2nd->next = head_2nd;
+	return false;
+}
+
+static __always_inline void cna_lock_handoff(struct mcs_spinlock *node,
+					     struct mcs_spinlock *next)
+{
+	struct cna_node *cn = (struct cna_node *)node;
+	u32 val = 1;
+
+	/*
+	 * cna_order_queue() may have moved the successor observed by the
+	 * caller onto the secondary queue, @node->next is the current one.
+	 */
+	next = READ_ONCE(node->next);
+
+	if (node->locked > 1) {
+		if (cn->start_time != FLUSH_SECONDARY_QUEUE) {
+			struct cna_node *cn_next = (struct cna_node *)next;
+
+			val = node->locked;	/* preserve secondary queue */
+
+			/*
+			 * Let the successor inherit the NUMA node preference
+			 * and the fairness clock along with the secondary
+			 * queue.
+			 */
+			cn_next->numa_node = cn->numa_node;
+			cn_next->start_time = cn->start_time;
+		} else {
+			/*
+			 * The fairness threshold was reached, flush the
+			 * secondary queue into the head of the main queue.
+			 */
+			struct mcs_spinlock *tail_2nd = decode_tail(node->locked);
+			struct mcs_spinlock *head_2nd = tail_2nd->next;
+
+			tail_2nd->next = next;
+			next = head_2nd;
+		}
+	}
+
+	smp_store_release(&next->locked, val);
+}
@@ -204,6 +204,61 @@ static ssize_t module_xz_decompress(struct load_info *info,
 #define MODULE_COMPRESSION	zstd
 #define MODULE_DECOMPRESS_FN	module_zstd_decompress
 
+/*
+ * Decompress a single frame with a known content size in one shot, straight
+ * into the final mapping of the module image. Unlike streaming, this needs
+ * no window-sized workspace and does not copy the output through the window
+ * buffer page by page.
+ */
+static ssize_t module_zstd_decompress_frame(struct load_info *info,
+					    const void *buf, size_t size,
+					    size_t content_size)
+{
+	unsigned int i, n_pages = DIV_ROUND_UP(content_size, PAGE_SIZE);
+	size_t wksp_size;
+	zstd_dctx *dctx;
+	void *wksp;
+	size_t ret;
+	ssize_t retval;
+
+	for (i = 0; i < n_pages; i++) {
+		struct page *page = module_get_next_page(info);
+
+		if (IS_ERR(page))
+			return PTR_ERR(page);
+	}
+
+	info->hdr = vmap(info->pages, info->used_pages, VM_MAP, PAGE_KERNEL);
+	if (!info->hdr)
+		return -ENOMEM;
+
+	wksp_size = zstd_dctx_workspace_bound();
+	wksp = kvmalloc(wksp_size, GFP_KERNEL);
+	if (!wksp)
+		return -ENOMEM;
+
+	dctx = zstd_init_dctx(wksp, wksp_size);
+	if (!dctx) {
+		pr_err("Can't initialize ZSTD context\n");
+		retval = -ENOMEM;
+		goto out;
+	}
+
+	ret = zstd_decompress_dctx(dctx, info->hdr, content_size, buf, size);
+	if (zstd_is_error(ret)) {
+		pr_err("ZSTD-decompression failed with status %d\n",
+		       zstd_get_error_code(ret));
+		retval = -EINVAL;
+		goto out;
+	}
+
+	retval = ret;
+
+ out:
+	kvfree(wksp);
+	return retval;
+}
+
 static ssize_t module_zstd_decompress(struct load_info *info,
 				    const void *buf, size_t size)
 {
@@ -240,6 +295,13 @@ static ssize_t module_zstd_decompress(struct load_info *info,
 		goto out;
 	}
 
+	if (header.frameType == ZSTD_frame &&
+	    header.frameContentSize != ZSTD_CONTENTSIZE_UNKNOWN &&
+	    header.frameContentSize <= INT_MAX &&
+	    zstd_find_frame_compressed_size(buf, size) == size)
+		return module_zstd_decompress_frame(info, buf, size,
+						    header.frameContentSize);
+
 	wksp_size = zstd_dstream_workspace_bound(header.windowSize);
 	wksp = kvmalloc(wksp_size, GFP_KERNEL);
 	if (!wksp) {
@@ -314,7 +376,10 @@ int module_decompress(struct load_info *info, const void *buf, size_t size)
 		goto err;
 	}
 
-	info->hdr = vmap(info->pages, info->used_pages, VM_MAP, PAGE_KERNEL);
+	/* The decompressor may already have mapped the image */
+	if (!info->hdr)
+		info->hdr = vmap(info->pages, info->used_pages, VM_MAP,
+				 PAGE_KERNEL);
 	if (!info->hdr) {
 		error = -ENOMEM;
 		goto err;
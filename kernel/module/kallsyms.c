@@ -10,6 +10,7 @@
 #include <linux/kallsyms.h>
 #include <linux/buildid.h>
 #include <linux/bsearch.h>
+#include <linux/sort.h>
 #include "internal.h"
 
 /* Lookup exported symbol in given range of kernel_symbols */
@@ -145,6 +146,9 @@ void layout_symtab(struct module *mod, struct load_info *info)
 	/* Note add_kallsyms() computes strtab_size as core_typeoffs - stroffs */
 	info->core_typeoffs = mod_mem_data->size;
 	mod_mem_data->size += ndst * sizeof(char);
+	/* Name and address lookup indices, see mod_kallsyms_build_index() */
+	info->core_idxoffs = ALIGN(mod_mem_data->size, __alignof__(unsigned int));
+	mod_mem_data->size = info->core_idxoffs + 2 * ndst * sizeof(unsigned int);
 
 	/* Put string table section at end of init part of module. */
 	strsect->sh_flags |= SHF_ALLOC;
@@ -162,6 +166,80 @@ void layout_symtab(struct module *mod, struct load_info *info)
 	mod_mem_init_data->size += nsrc * sizeof(char);
 }
 
+static const char *kallsyms_symbol_name(struct mod_kallsyms *kallsyms, unsigned int symnum)
+{
+	return kallsyms->strtab + kallsyms->symtab[symnum].st_name;
+}
+
+/* Unnamed symbols and mapping symbols never resolve an address. */
+static bool kallsyms_symbol_addressable(struct mod_kallsyms *kallsyms,
+					unsigned int symnum)
+{
+	const char *name = kallsyms_symbol_name(kallsyms, symnum);
+
+	return kallsyms->symtab[symnum].st_shndx != SHN_UNDEF &&
+	       *name != '\0' && !is_mapping_symbol(name);
+}
+
+static int cmp_name_idx(const void *a, const void *b, const void *priv)
+{
+	struct mod_kallsyms *kallsyms = (struct mod_kallsyms *)priv;
+	unsigned int ia = *(const unsigned int *)a, ib = *(const unsigned int *)b;
+	int ret;
+
+	ret = strcmp(kallsyms_symbol_name(kallsyms, ia),
+		     kallsyms_symbol_name(kallsyms, ib));
+	if (ret)
+		return ret;
+	return ia < ib ? -1 : ia > ib;
+}
+
+static int cmp_addr_idx(const void *a, const void *b, const void *priv)
+{
+	const struct mod_kallsyms *kallsyms = priv;
+	unsigned int ia = *(const unsigned int *)a, ib = *(const unsigned int *)b;
+	unsigned long va = kallsyms_symbol_value(&kallsyms->symtab[ia]);
+	unsigned long vb = kallsyms_symbol_value(&kallsyms->symtab[ib]);
+
+	if (va != vb)
+		return va < vb ? -1 : 1;
+	return ia < ib ? -1 : ia > ib;
+}
+
+/*
+ * Build the sorted indices of the core symbols, so that name and address
+ * lookups don't have to scan the whole symtab. Ties are broken by symbol
+ * number so that the lookups return the same symbol as a linear scan.
+ *
+ * Livepatch modules get no address index: klp_resolve_symbols() rewrites
+ * the values of their SHN_LIVEPATCH symbols after load.
+ */
+static void mod_kallsyms_build_index(struct module *mod,
+				     struct mod_kallsyms *kallsyms,
+				     unsigned int *idx)
+{
+	unsigned int i, n = 0;
+
+	kallsyms->name_idx = idx;
+	for (i = 0; i < kallsyms->num_symtab; i++)
+		kallsyms->name_idx[i] = i;
+	sort_r(kallsyms->name_idx, kallsyms->num_symtab, sizeof(*idx),
+	       cmp_name_idx, NULL, kallsyms);
+
+	if (is_livepatch_module(mod))
+		return;
+
+	/* ELF starts real symbols at 1 */
+	kallsyms->addr_idx = idx + kallsyms->num_symtab;
+	for (i = 1; i < kallsyms->num_symtab; i++) {
+		if (kallsyms_symbol_addressable(kallsyms, i))
+			kallsyms->addr_idx[n++] = i;
+	}
+	kallsyms->num_addr_idx = n;
+	sort_r(kallsyms->addr_idx, n, sizeof(*idx), cmp_addr_idx, NULL,
+	       kallsyms);
+}
+
 /*
  * We use the full symtab and strtab which layout_symtab arranged to
  * be appended to the init section.  Later we switch to the cut-down
@@ -190,6 +268,8 @@ void add_kallsyms(struct module *mod, const struct load_info *info)
 	rcu_dereference(mod->kallsyms)->strtab =
 		(void *)info->sechdrs[info->index.str].sh_addr;
 	rcu_dereference(mod->kallsyms)->typetab = init_data_base + info->init_typeoffs;
+	rcu_dereference(mod->kallsyms)->name_idx = NULL;
+	rcu_dereference(mod->kallsyms)->addr_idx = NULL;
 
 	/*
 	 * Now populate the cut down core kallsyms for after init
@@ -222,6 +302,8 @@ void add_kallsyms(struct module *mod, const struct load_info *info)
 	}
 	rcu_read_unlock();
 	mod->core_kallsyms.num_symtab = ndst;
+	mod_kallsyms_build_index(mod, &mod->core_kallsyms,
+				 data_base + info->core_idxoffs);
 }
 
 #if IS_ENABLED(CONFIG_STACKTRACE_BUILD_ID)
@@ -244,9 +326,46 @@ void init_build_id(struct module *mod, const struct load_info *info)
 }
 #endif
 
-static const char *kallsyms_symbol_name(struct mod_kallsyms *kallsyms, unsigned int symnum)
+/*
+ * Find the closest preceding symbol of @addr and the value of the next symbol
+ * after it in the address index. Returns 0 if there is none.
+ */
+static unsigned int find_kallsyms_symbol_idx(struct mod_kallsyms *kallsyms,
+					     unsigned long addr,
+					     unsigned long *bestval,
+					     unsigned long *nextval)
 {
-	return kallsyms->strtab + kallsyms->symtab[symnum].st_name;
+	unsigned int lo = 0, hi = kallsyms->num_addr_idx, mid;
+	unsigned long val;
+
+	/* First entry above @addr */
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (kallsyms_symbol_value(&kallsyms->symtab[kallsyms->addr_idx[mid]]) <= addr)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	if (lo < kallsyms->num_addr_idx) {
+		val = kallsyms_symbol_value(&kallsyms->symtab[kallsyms->addr_idx[lo]]);
+		if (val < *nextval)
+			*nextval = val;
+	}
+
+	if (!lo)
+		return 0;
+
+	/* Of several symbols at the same address, the first one wins */
+	val = kallsyms_symbol_value(&kallsyms->symtab[kallsyms->addr_idx[--lo]]);
+	while (lo && kallsyms_symbol_value(&kallsyms->symtab[kallsyms->addr_idx[lo - 1]]) == val)
+		lo--;
+
+	if (val <= *bestval)
+		return 0;
+
+	*bestval = val;
+	return kallsyms->addr_idx[lo];
 }
 
 /*
@@ -273,6 +392,11 @@ static const char *find_kallsyms_symbol(struct module *mod,
 
 	bestval = kallsyms_symbol_value(&kallsyms->symtab[best]);
 
+	if (kallsyms->addr_idx) {
+		best = find_kallsyms_symbol_idx(kallsyms, addr, &bestval, &nextval);
+		goto found;
+	}
+
 	/*
 	 * Scan for closest preceding symbol, and next symbol. (ELF
 	 * starts real symbols at 1).
@@ -281,15 +405,11 @@ static const char *find_kallsyms_symbol(struct module *mod,
 		const Elf_Sym *sym = &kallsyms->symtab[i];
 		unsigned long thisval = kallsyms_symbol_value(sym);
 
-		if (sym->st_shndx == SHN_UNDEF)
-			continue;
-
 		/*
 		 * We ignore unnamed symbols: they're uninformative
 		 * and inserted at a whim.
 		 */
-		if (*kallsyms_symbol_name(kallsyms, i) == '\0' ||
-		    is_mapping_symbol(kallsyms_symbol_name(kallsyms, i)))
+		if (!kallsyms_symbol_addressable(kallsyms, i))
 			continue;
 
 		if (thisval <= addr && thisval > bestval) {
@@ -300,6 +420,7 @@ static const char *find_kallsyms_symbol(struct module *mod,
 			nextval = thisval;
 	}
 
+found:
 	if (!best)
 		return NULL;
 
@@ -409,12 +530,39 @@ int module_get_kallsym(unsigned int symnum, unsigned long *value, char *type,
 	return -ERANGE;
 }
 
+static unsigned long __find_kallsyms_symbol_value_idx(struct mod_kallsyms *kallsyms,
+						      const char *name)
+{
+	unsigned int lo = 0, hi = kallsyms->num_symtab, mid;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (strcmp(kallsyms_symbol_name(kallsyms, kallsyms->name_idx[mid]), name) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	for (; lo < kallsyms->num_symtab; lo++) {
+		const Elf_Sym *sym = &kallsyms->symtab[kallsyms->name_idx[lo]];
+
+		if (strcmp(name, kallsyms_symbol_name(kallsyms, kallsyms->name_idx[lo])))
+			break;
+		if (sym->st_shndx != SHN_UNDEF)
+			return kallsyms_symbol_value(sym);
+	}
+	return 0;
+}
+
 /* Given a module and name of symbol, find and return the symbol's value */
 static unsigned long __find_kallsyms_symbol_value(struct module *mod, const char *name)
 {
 	unsigned int i;
 	struct mod_kallsyms *kallsyms = rcu_dereference_sched(mod->kallsyms);
 
+	if (kallsyms->name_idx)
+		return __find_kallsyms_symbol_value_idx(kallsyms, name);
+
 	for (i = 0; i < kallsyms->num_symtab; i++) {
 		const Elf_Sym *sym = &kallsyms->symtab[i];
 
@@ -177,7 +177,8 @@ static void monitor_swap_reactors(struct rv_monitor_def *mdef, struct rv_reactor
 
 	mdef->rdef = rdef;
 	mdef->reacting = reacting;
-	mdef->monitor->react = rdef->reactor->react;
+	/* The nop reactor does not need the exception message to be formatted. */
+	mdef->monitor->react = reacting ? rdef->reactor->react : NULL;
 
 	if (monitor_enabled)
 		rv_enable_monitor(mdef);
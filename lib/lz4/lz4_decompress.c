@@ -403,6 +403,18 @@ static FORCE_INLINE int LZ4_decompress_generic(
 		}
 
 		if (unlikely(offset < 8)) {
+			/*
+			 * Runs of one byte and short repeating patterns are
+			 * common (zeroed memory), fill them without going
+			 * through the overlapping match byte by byte.
+			 */
+			if ((offset == 1 || offset == 2 || offset == 4) &&
+			    likely(cpy <= oend - MATCH_SAFEGUARD_DISTANCE)) {
+				LZ4_patternCopy(op, match, cpy, offset);
+				op = cpy;
+				continue;
+			}
+
 			op[0] = match[0];
 			op[1] = match[1];
 			op[2] = match[2];
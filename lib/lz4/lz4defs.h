@@ -183,6 +183,36 @@ static FORCE_INLINE void LZ4_wildCopy(void *dstPtr,
 	} while (d < e);
 }
 
+/*
+ * copy a match with an offset of 1, 2 or 4 by storing its repeating
+ * pattern 8 bytes at a time, which can overwrite up to 7 bytes beyond dstEnd
+ */
+static FORCE_INLINE void LZ4_patternCopy(BYTE *dstPtr,
+	const BYTE *srcPtr, BYTE *dstEnd, size_t offset)
+{
+	BYTE v[8];
+
+	switch (offset) {
+	case 1:
+		__builtin_memset(v, *srcPtr, 8);
+		break;
+	case 2:
+		LZ4_memcpy(v, srcPtr, 2);
+		LZ4_memcpy(&v[2], srcPtr, 2);
+		LZ4_memcpy(&v[4], v, 4);
+		break;
+	default:
+		LZ4_memcpy(v, srcPtr, 4);
+		LZ4_memcpy(&v[4], srcPtr, 4);
+		break;
+	}
+
+	do {
+		LZ4_memcpy(dstPtr, v, 8);
+		dstPtr += 8;
+	} while (dstPtr < dstEnd);
+}
+
 static FORCE_INLINE unsigned int LZ4_NbCommonBytes(register size_t val)
 {
 #if LZ4_LITTLE_ENDIAN
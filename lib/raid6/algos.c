@@ -26,8 +26,16 @@ EXPORT_SYMBOL(raid6_empty_zero_page);
 struct raid6_calls raid6_call;
 EXPORT_SYMBOL_GPL(raid6_call);
 
+static char *raid6_force_algo;
+module_param_named(algo, raid6_force_algo, charp, 0444);
+MODULE_PARM_DESC(algo, "Use this gen/xor algorithm and skip the benchmark");
+
 const struct raid6_calls * const raid6_algos[] = {
 #if defined(__i386__) && !defined(__arch_um__)
+#ifdef CONFIG_AS_GFNI
+	&raid6_gfnix2,
+	&raid6_gfnix1,
+#endif
 #ifdef CONFIG_AS_AVX512
 	&raid6_avx512x2,
 	&raid6_avx512x1,
@@ -42,6 +50,11 @@ const struct raid6_calls * const raid6_algos[] = {
 	&raid6_mmxx1,
 #endif
 #if defined(__x86_64__) && !defined(__arch_um__)
+#ifdef CONFIG_AS_GFNI
+	&raid6_gfnix4,
+	&raid6_gfnix2,
+	&raid6_gfnix1,
+#endif
 #ifdef CONFIG_AS_AVX512
 	&raid6_avx512x4,
 	&raid6_avx512x2,
@@ -96,6 +109,9 @@ EXPORT_SYMBOL_GPL(raid6_datap_recov);
 
 const struct raid6_recov_calls *const raid6_recov_algos[] = {
 #ifdef CONFIG_X86
+#ifdef CONFIG_AS_GFNI
+	&raid6_recov_gfni,
+#endif
 #ifdef CONFIG_AS_AVX512
 	&raid6_recov_avx512,
 #endif
@@ -160,6 +176,21 @@ static inline const struct raid6_calls *raid6_choose_gen(
 	const struct raid6_calls *const *algo;
 	const struct raid6_calls *best;
 
+	if (raid6_force_algo && *raid6_force_algo) {
+		for (algo = raid6_algos; *algo; algo++) {
+			if (strcmp((*algo)->name, raid6_force_algo))
+				continue;
+			if ((*algo)->valid && !(*algo)->valid())
+				break;
+			raid6_call = **algo;
+			pr_info("raid6: skipped pq benchmark and selected %s\n",
+				(*algo)->name);
+			return *algo;
+		}
+		pr_err("raid6: algorithm %s not available, benchmarking\n",
+		       raid6_force_algo);
+	}
+
 	for (bestgenperf = 0, best = NULL, algo = raid6_algos; *algo; algo++) {
 		if (!best || (*algo)->priority >= best->priority) {
 			if ((*algo)->valid && !(*algo)->valid())
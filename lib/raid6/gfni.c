@@ -0,0 +1,441 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/* -*- linux-c -*- --------------------------------------------------------
+ *
+ *   Based on avx512.c: Copyright (C) 2016 Intel Corporation
+ *
+ * -----------------------------------------------------------------------
+ */
+
+/*
+ * AVX512 + GFNI implementation of RAID-6 syndrome functions
+ *
+ * Multiplying by a constant in GF(2^8) is linear over GF(2), so it can be
+ * done with a single vgf2p8affineqb by the 8x8 bit matrix of the constant
+ * (see raid6_gfni_matrix()).  vgf2p8mulb can't be used, it reduces by the
+ * AES polynomial 0x11b instead of the RAID-6 polynomial 0x11d.
+ */
+
+#ifdef CONFIG_AS_GFNI
+
+#include <linux/raid/pq.h>
+#include "x86.h"
+
+/* raid6_gfni_matrix(2) */
+static const u64 raid6_gfni_mul2 = 0x8001828488102040ULL;
+
+static int raid6_have_gfni(void)
+{
+	return boot_cpu_has(X86_FEATURE_AVX2) &&
+		boot_cpu_has(X86_FEATURE_AVX) &&
+		boot_cpu_has(X86_FEATURE_AVX512F) &&
+		boot_cpu_has(X86_FEATURE_AVX512BW) &&
+		boot_cpu_has(X86_FEATURE_AVX512VL) &&
+		boot_cpu_has(X86_FEATURE_AVX512DQ) &&
+		boot_cpu_has(X86_FEATURE_GFNI);
+}
+
+static void raid6_gfni1_gen_syndrome(int disks, size_t bytes, void **ptrs)
+{
+	u8 **dptr = (u8 **)ptrs;
+	u8 *p, *q;
+	int d, z, z0;
+
+	z0 = disks - 3;		/* Highest data disk */
+	p = dptr[z0+1];		/* XOR parity */
+	q = dptr[z0+2];		/* RS syndrome */
+
+	kernel_fpu_begin();
+
+	asm volatile("vpbroadcastq %0,%%zmm0" : : "m" (raid6_gfni_mul2));
+
+	for (d = 0; d < bytes; d += 64) {
+		asm volatile("prefetchnta %0\n\t"
+			     "vmovdqa64 %0,%%zmm2\n\t"		/* P[0] */
+			     "vmovdqa64 %%zmm2,%%zmm4"		/* Q[0] */
+			     :
+			     : "m" (dptr[z0][d]));
+		for (z = z0-1; z >= 0; z--) {
+			asm volatile("prefetchnta %0\n\t"
+				     "vgf2p8affineqb $0,%%zmm0,%%zmm4,%%zmm4\n\t"
+				     "vmovdqa64 %0,%%zmm5\n\t"
+				     "vpxorq %%zmm5,%%zmm2,%%zmm2\n\t"
+				     "vpxorq %%zmm5,%%zmm4,%%zmm4"
+				     :
+				     : "m" (dptr[z][d]));
+		}
+		asm volatile("vmovntdq %%zmm2,%0\n\t"
+			     "vmovntdq %%zmm4,%1"
+			     :
+			     : "m" (p[d]), "m" (q[d]));
+	}
+
+	asm volatile("sfence" : : : "memory");
+	kernel_fpu_end();
+}
+
+static void raid6_gfni1_xor_syndrome(int disks, int start, int stop,
+				     size_t bytes, void **ptrs)
+{
+	u8 **dptr = (u8 **)ptrs;
+	u64 mulstart = raid6_gfni_matrix(raid6_gfexp[start]);
+	u8 *p, *q;
+	int d, z, z0;
+
+	z0 = stop;		/* P/Q right side optimization */
+	p = dptr[disks-2];	/* XOR parity */
+	q = dptr[disks-1];	/* RS syndrome */
+
+	kernel_fpu_begin();
+
+	asm volatile("vpbroadcastq %0,%%zmm0\n\t"
+		     "vpbroadcastq %1,%%zmm1"
+		     :
+		     : "m" (raid6_gfni_mul2), "m" (mulstart));
+
+	for (d = 0 ; d < bytes ; d += 64) {
+		asm volatile("vmovdqa64 %0,%%zmm4\n\t"
+			     "vmovdqa64 %1,%%zmm2\n\t"
+			     "vpxorq %%zmm4,%%zmm2,%%zmm2"
+			     :
+			     : "m" (dptr[z0][d]),  "m" (p[d]));
+		/* P/Q data pages */
+		for (z = z0-1 ; z >= start ; z--) {
+			asm volatile("vgf2p8affineqb $0,%%zmm0,%%zmm4,%%zmm4\n\t"
+				     "vmovdqa64 %0,%%zmm5\n\t"
+				     "vpxorq %%zmm5,%%zmm2,%%zmm2\n\t"
+				     "vpxorq %%zmm5,%%zmm4,%%zmm4"
+				     :
+				     : "m" (dptr[z][d]));
+		}
+		/* P/Q left side optimization: multiply by 2^start at once */
+		if (start)
+			asm volatile("vgf2p8affineqb $0,%%zmm1,%%zmm4,%%zmm4"
+				     : : );
+		asm volatile("vpxorq %0,%%zmm4,%%zmm4\n\t"
+		/* Don't use movntdq for r/w memory area < cache line */
+			     "vmovdqa64 %%zmm4,%0\n\t"
+			     "vmovdqa64 %%zmm2,%1"
+			     :
+			     : "m" (q[d]), "m" (p[d]));
+	}
+
+	asm volatile("sfence" : : : "memory");
+	kernel_fpu_end();
+}
+
+const struct raid6_calls raid6_gfnix1 = {
+	raid6_gfni1_gen_syndrome,
+	raid6_gfni1_xor_syndrome,
+	raid6_have_gfni,
+	"gfnix1",
+	.priority = 3		/* Prefer GFNI over plain AVX512 */
+};
+
+/*
+ * Unrolled-by-2 AVX512 + GFNI implementation
+ */
+static void raid6_gfni2_gen_syndrome(int disks, size_t bytes, void **ptrs)
+{
+	u8 **dptr = (u8 **)ptrs;
+	u8 *p, *q;
+	int d, z, z0;
+
+	z0 = disks - 3;		/* Highest data disk */
+	p = dptr[z0+1];		/* XOR parity */
+	q = dptr[z0+2];		/* RS syndrome */
+
+	kernel_fpu_begin();
+
+	asm volatile("vpbroadcastq %0,%%zmm0" : : "m" (raid6_gfni_mul2));
+
+	/* We uniformly assume a single prefetch covers at least 64 bytes */
+	for (d = 0; d < bytes; d += 128) {
+		asm volatile("prefetchnta %0\n\t"
+			     "prefetchnta %1\n\t"
+			     "vmovdqa64 %0,%%zmm2\n\t"		/* P[0] */
+			     "vmovdqa64 %1,%%zmm3\n\t"		/* P[1] */
+			     "vmovdqa64 %%zmm2,%%zmm4\n\t"	/* Q[0] */
+			     "vmovdqa64 %%zmm3,%%zmm6"		/* Q[1] */
+			     :
+			     : "m" (dptr[z0][d]), "m" (dptr[z0][d+64]));
+		for (z = z0-1; z >= 0; z--) {
+			asm volatile("prefetchnta %0\n\t"
+				     "prefetchnta %1\n\t"
+				     "vgf2p8affineqb $0,%%zmm0,%%zmm4,%%zmm4\n\t"
+				     "vgf2p8affineqb $0,%%zmm0,%%zmm6,%%zmm6\n\t"
+				     "vmovdqa64 %0,%%zmm5\n\t"
+				     "vmovdqa64 %1,%%zmm7\n\t"
+				     "vpxorq %%zmm5,%%zmm2,%%zmm2\n\t"
+				     "vpxorq %%zmm7,%%zmm3,%%zmm3\n\t"
+				     "vpxorq %%zmm5,%%zmm4,%%zmm4\n\t"
+				     "vpxorq %%zmm7,%%zmm6,%%zmm6"
+				     :
+				     : "m" (dptr[z][d]), "m" (dptr[z][d+64]));
+		}
+		asm volatile("vmovntdq %%zmm2,%0\n\t"
+			     "vmovntdq %%zmm3,%1\n\t"
+			     "vmovntdq %%zmm4,%2\n\t"
+			     "vmovntdq %%zmm6,%3"
+			     :
+			     : "m" (p[d]), "m" (p[d+64]), "m" (q[d]),
+			       "m" (q[d+64]));
+	}
+
+	asm volatile("sfence" : : : "memory");
+	kernel_fpu_end();
+}
+
+static void raid6_gfni2_xor_syndrome(int disks, int start, int stop,
+				     size_t bytes, void **ptrs)
+{
+	u8 **dptr = (u8 **)ptrs;
+	u64 mulstart = raid6_gfni_matrix(raid6_gfexp[start]);
+	u8 *p, *q;
+	int d, z, z0;
+
+	z0 = stop;		/* P/Q right side optimization */
+	p = dptr[disks-2];	/* XOR parity */
+	q = dptr[disks-1];	/* RS syndrome */
+
+	kernel_fpu_begin();
+
+	asm volatile("vpbroadcastq %0,%%zmm0\n\t"
+		     "vpbroadcastq %1,%%zmm1"
+		     :
+		     : "m" (raid6_gfni_mul2), "m" (mulstart));
+
+	for (d = 0 ; d < bytes ; d += 128) {
+		asm volatile("vmovdqa64 %0,%%zmm4\n\t"
+			     "vmovdqa64 %1,%%zmm6\n\t"
+			     "vmovdqa64 %2,%%zmm2\n\t"
+			     "vmovdqa64 %3,%%zmm3\n\t"
+			     "vpxorq %%zmm4,%%zmm2,%%zmm2\n\t"
+			     "vpxorq %%zmm6,%%zmm3,%%zmm3"
+			     :
+			     : "m" (dptr[z0][d]), "m" (dptr[z0][d+64]),
+			       "m" (p[d]), "m" (p[d+64]));
+		/* P/Q data pages */
+		for (z = z0-1 ; z >= start ; z--) {
+			asm volatile("vgf2p8affineqb $0,%%zmm0,%%zmm4,%%zmm4\n\t"
+				     "vgf2p8affineqb $0,%%zmm0,%%zmm6,%%zmm6\n\t"
+				     "vmovdqa64 %0,%%zmm5\n\t"
+				     "vmovdqa64 %1,%%zmm7\n\t"
+				     "vpxorq %%zmm5,%%zmm2,%%zmm2\n\t"
+				     "vpxorq %%zmm7,%%zmm3,%%zmm3\n\t"
+				     "vpxorq %%zmm5,%%zmm4,%%zmm4\n\t"
+				     "vpxorq %%zmm7,%%zmm6,%%zmm6"
+				     :
+				     : "m" (dptr[z][d]),  "m" (dptr[z][d+64]));
+		}
+		/* P/Q left side optimization: multiply by 2^start at once */
+		if (start)
+			asm volatile("vgf2p8affineqb $0,%%zmm1,%%zmm4,%%zmm4\n\t"
+				     "vgf2p8affineqb $0,%%zmm1,%%zmm6,%%zmm6"
+				     : : );
+		asm volatile("vpxorq %0,%%zmm4,%%zmm4\n\t"
+			     "vpxorq %1,%%zmm6,%%zmm6\n\t"
+			     /* Don't use movntdq for r/w
+			      * memory area < cache line
+			      */
+			     "vmovdqa64 %%zmm4,%0\n\t"
+			     "vmovdqa64 %%zmm6,%1\n\t"
+			     "vmovdqa64 %%zmm2,%2\n\t"
+			     "vmovdqa64 %%zmm3,%3"
+			     :
+			     : "m" (q[d]), "m" (q[d+64]), "m" (p[d]),
+			       "m" (p[d+64]));
+	}
+
+	asm volatile("sfence" : : : "memory");
+	kernel_fpu_end();
+}
+
+const struct raid6_calls raid6_gfnix2 = {
+	raid6_gfni2_gen_syndrome,
+	raid6_gfni2_xor_syndrome,
+	raid6_have_gfni,
+	"gfnix2",
+	.priority = 3		/* Prefer GFNI over plain AVX512 */
+};
+
+#ifdef CONFIG_X86_64
+
+/*
+ * Unrolled-by-4 AVX512 + GFNI implementation
+ */
+static void raid6_gfni4_gen_syndrome(int disks, size_t bytes, void **ptrs)
+{
+	u8 **dptr = (u8 **)ptrs;
+	u8 *p, *q;
+	int d, z, z0;
+
+	z0 = disks - 3;		/* Highest data disk */
+	p = dptr[z0+1];		/* XOR parity */
+	q = dptr[z0+2];		/* RS syndrome */
+
+	kernel_fpu_begin();
+
+	asm volatile("vpbroadcastq %0,%%zmm0" : : "m" (raid6_gfni_mul2));
+
+	for (d = 0; d < bytes; d += 256) {
+		asm volatile("prefetchnta %0\n\t"
+			     "prefetchnta %1\n\t"
+			     "prefetchnta %2\n\t"
+			     "prefetchnta %3\n\t"
+			     "vmovdqa64 %0,%%zmm2\n\t"		/* P[0] */
+			     "vmovdqa64 %1,%%zmm3\n\t"		/* P[1] */
+			     "vmovdqa64 %2,%%zmm10\n\t"		/* P[2] */
+			     "vmovdqa64 %3,%%zmm11\n\t"		/* P[3] */
+			     "vmovdqa64 %%zmm2,%%zmm4\n\t"	/* Q[0] */
+			     "vmovdqa64 %%zmm3,%%zmm6\n\t"	/* Q[1] */
+			     "vmovdqa64 %%zmm10,%%zmm12\n\t"	/* Q[2] */
+			     "vmovdqa64 %%zmm11,%%zmm14"	/* Q[3] */
+			     :
+			     : "m" (dptr[z0][d]), "m" (dptr[z0][d+64]),
+			       "m" (dptr[z0][d+128]), "m" (dptr[z0][d+192]));
+		for (z = z0-1; z >= 0; z--) {
+			asm volatile("prefetchnta %0\n\t"
+				     "prefetchnta %1\n\t"
+				     "prefetchnta %2\n\t"
+				     "prefetchnta %3\n\t"
+				     "vgf2p8affineqb $0,%%zmm0,%%zmm4,%%zmm4\n\t"
+				     "vgf2p8affineqb $0,%%zmm0,%%zmm6,%%zmm6\n\t"
+				     "vgf2p8affineqb $0,%%zmm0,%%zmm12,%%zmm12\n\t"
+				     "vgf2p8affineqb $0,%%zmm0,%%zmm14,%%zmm14\n\t"
+				     "vmovdqa64 %0,%%zmm5\n\t"
+				     "vmovdqa64 %1,%%zmm7\n\t"
+				     "vmovdqa64 %2,%%zmm13\n\t"
+				     "vmovdqa64 %3,%%zmm15\n\t"
+				     "vpxorq %%zmm5,%%zmm2,%%zmm2\n\t"
+				     "vpxorq %%zmm7,%%zmm3,%%zmm3\n\t"
+				     "vpxorq %%zmm13,%%zmm10,%%zmm10\n\t"
+				     "vpxorq %%zmm15,%%zmm11,%%zmm11\n\t"
+				     "vpxorq %%zmm5,%%zmm4,%%zmm4\n\t"
+				     "vpxorq %%zmm7,%%zmm6,%%zmm6\n\t"
+				     "vpxorq %%zmm13,%%zmm12,%%zmm12\n\t"
+				     "vpxorq %%zmm15,%%zmm14,%%zmm14"
+				     :
+				     : "m" (dptr[z][d]), "m" (dptr[z][d+64]),
+				       "m" (dptr[z][d+128]),
+				       "m" (dptr[z][d+192]));
+		}
+		asm volatile("vmovntdq %%zmm2,%0\n\t"
+			     "vmovntdq %%zmm3,%1\n\t"
+			     "vmovntdq %%zmm10,%2\n\t"
+			     "vmovntdq %%zmm11,%3\n\t"
+			     "vmovntdq %%zmm4,%4\n\t"
+			     "vmovntdq %%zmm6,%5\n\t"
+			     "vmovntdq %%zmm12,%6\n\t"
+			     "vmovntdq %%zmm14,%7"
+			     :
+			     : "m" (p[d]), "m" (p[d+64]), "m" (p[d+128]),
+			       "m" (p[d+192]), "m" (q[d]), "m" (q[d+64]),
+			       "m" (q[d+128]), "m" (q[d+192]));
+	}
+
+	asm volatile("sfence" : : : "memory");
+	kernel_fpu_end();
+}
+
+static void raid6_gfni4_xor_syndrome(int disks, int start, int stop,
+				     size_t bytes, void **ptrs)
+{
+	u8 **dptr = (u8 **)ptrs;
+	u64 mulstart = raid6_gfni_matrix(raid6_gfexp[start]);
+	u8 *p, *q;
+	int d, z, z0;
+
+	z0 = stop;		/* P/Q right side optimization */
+	p = dptr[disks-2];	/* XOR parity */
+	q = dptr[disks-1];	/* RS syndrome */
+
+	kernel_fpu_begin();
+
+	asm volatile("vpbroadcastq %0,%%zmm0\n\t"
+		     "vpbroadcastq %1,%%zmm1"
+		     :
+		     : "m" (raid6_gfni_mul2), "m" (mulstart));
+
+	for (d = 0 ; d < bytes ; d += 256) {
+		asm volatile("vmovdqa64 %0,%%zmm4\n\t"
+			     "vmovdqa64 %1,%%zmm6\n\t"
+			     "vmovdqa64 %2,%%zmm12\n\t"
+			     "vmovdqa64 %3,%%zmm14\n\t"
+			     "vmovdqa64 %4,%%zmm2\n\t"
+			     "vmovdqa64 %5,%%zmm3\n\t"
+			     "vmovdqa64 %6,%%zmm10\n\t"
+			     "vmovdqa64 %7,%%zmm11\n\t"
+			     "vpxorq %%zmm4,%%zmm2,%%zmm2\n\t"
+			     "vpxorq %%zmm6,%%zmm3,%%zmm3\n\t"
+			     "vpxorq %%zmm12,%%zmm10,%%zmm10\n\t"
+			     "vpxorq %%zmm14,%%zmm11,%%zmm11"
+			     :
+			     : "m" (dptr[z0][d]), "m" (dptr[z0][d+64]),
+			       "m" (dptr[z0][d+128]), "m" (dptr[z0][d+192]),
+			       "m" (p[d]), "m" (p[d+64]), "m" (p[d+128]),
+			       "m" (p[d+192]));
+		/* P/Q data pages */
+		for (z = z0-1 ; z >= start ; z--) {
+			asm volatile("prefetchnta %0\n\t"
+				     "prefetchnta %2\n\t"
+				     "vgf2p8affineqb $0,%%zmm0,%%zmm4,%%zmm4\n\t"
+				     "vgf2p8affineqb $0,%%zmm0,%%zmm6,%%zmm6\n\t"
+				     "vgf2p8affineqb $0,%%zmm0,%%zmm12,%%zmm12\n\t"
+				     "vgf2p8affineqb $0,%%zmm0,%%zmm14,%%zmm14\n\t"
+				     "vmovdqa64 %0,%%zmm5\n\t"
+				     "vmovdqa64 %1,%%zmm7\n\t"
+				     "vmovdqa64 %2,%%zmm13\n\t"
+				     "vmovdqa64 %3,%%zmm15\n\t"
+				     "vpxorq %%zmm5,%%zmm2,%%zmm2\n\t"
+				     "vpxorq %%zmm7,%%zmm3,%%zmm3\n\t"
+				     "vpxorq %%zmm13,%%zmm10,%%zmm10\n\t"
+				     "vpxorq %%zmm15,%%zmm11,%%zmm11\n\t"
+				     "vpxorq %%zmm5,%%zmm4,%%zmm4\n\t"
+				     "vpxorq %%zmm7,%%zmm6,%%zmm6\n\t"
+				     "vpxorq %%zmm13,%%zmm12,%%zmm12\n\t"
+				     "vpxorq %%zmm15,%%zmm14,%%zmm14"
+				     :
+				     : "m" (dptr[z][d]), "m" (dptr[z][d+64]),
+				       "m" (dptr[z][d+128]),
+				       "m" (dptr[z][d+192]));
+		}
+		/* P/Q left side optimization: multiply by 2^start at once */
+		if (start)
+			asm volatile("vgf2p8affineqb $0,%%zmm1,%%zmm4,%%zmm4\n\t"
+				     "vgf2p8affineqb $0,%%zmm1,%%zmm6,%%zmm6\n\t"
+				     "vgf2p8affineqb $0,%%zmm1,%%zmm12,%%zmm12\n\t"
+				     "vgf2p8affineqb $0,%%zmm1,%%zmm14,%%zmm14"
+				     : : );
+		asm volatile("prefetchnta %0\n\t"
+			     "prefetchnta %2\n\t"
+			     "vpxorq %0,%%zmm4,%%zmm4\n\t"
+			     "vpxorq %1,%%zmm6,%%zmm6\n\t"
+			     "vpxorq %2,%%zmm12,%%zmm12\n\t"
+			     "vpxorq %3,%%zmm14,%%zmm14\n\t"
+			     "vmovntdq %%zmm4,%0\n\t"
+			     "vmovntdq %%zmm6,%1\n\t"
+			     "vmovntdq %%zmm12,%2\n\t"
+			     "vmovntdq %%zmm14,%3\n\t"
+			     "vmovntdq %%zmm2,%4\n\t"
+			     "vmovntdq %%zmm3,%5\n\t"
+			     "vmovntdq %%zmm10,%6\n\t"
+			     "vmovntdq %%zmm11,%7"
+			     :
+			     : "m" (q[d]), "m" (q[d+64]), "m" (q[d+128]),
+			       "m" (q[d+192]), "m" (p[d]), "m" (p[d+64]),
+			       "m" (p[d+128]), "m" (p[d+192]));
+	}
+	asm volatile("sfence" : : : "memory");
+	kernel_fpu_end();
+}
+
+const struct raid6_calls raid6_gfnix4 = {
+	raid6_gfni4_gen_syndrome,
+	raid6_gfni4_xor_syndrome,
+	raid6_have_gfni,
+	"gfnix4",
+	.priority = 3		/* Prefer GFNI over plain AVX512 */
+};
+#endif
+
+#endif /* CONFIG_AS_GFNI */
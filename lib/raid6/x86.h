@@ -52,24 +52,45 @@ static inline void kernel_fpu_end(void)
 					   * Extensions
 					   */
 #define X86_FEATURE_MMXEXT	(1*32+22) /* AMD MMX extensions */
+#define X86_FEATURE_GFNI	(16*32+ 8) /* Galois Field New Instructions */
 
 /* Should work well enough on modern CPUs for testing */
 static inline int boot_cpu_has(int flag)
 {
 	u32 eax, ebx, ecx, edx;
 
-	eax = (flag & 0x100) ? 7 :
+	eax = (flag & 0x300) ? 7 :
 		(flag & 0x20) ? 0x80000001 : 1;
 	ecx = 0;
 
 	asm volatile("cpuid"
 		     : "+a" (eax), "=b" (ebx), "=d" (edx), "+c" (ecx));
 
-	return ((flag & 0x100 ? ebx :
+	return ((flag & 0x200 ? ecx : flag & 0x100 ? ebx :
 		(flag & 0x80) ? ecx : edx) >> (flag & 31)) & 1;
 }
 
 #endif /* ndef __KERNEL__ */
 
+/*
+ * Bit matrix for vgf2p8affineqb that multiplies each byte by the constant
+ * c in the RAID-6 field.  Row i, selecting output bit i, lives in byte
+ * 7 - i of the qword; its bit j is bit i of c * 2^j.
+ */
+static inline u64 raid6_gfni_matrix(u8 c)
+{
+	u64 m = 0;
+	int i, j;
+
+	for (j = 0; j < 8; j++) {
+		u8 col = raid6_gfmul[c][1 << j];
+
+		for (i = 0; i < 8; i++)
+			if (col & (1 << i))
+				m |= 1ULL << ((7 - i) * 8 + j);
+	}
+	return m;
+}
+
 #endif
 #endif
@@ -22,6 +22,12 @@
  */
 #define ZSTD_DISABLE_ASM 1
 
+/*
+ * There are no workqueues to run the parallel multi-frame decompression on
+ * in the pre-boot environment.
+ */
+#define ZSTD_DISABLE_PARALLEL_FRAMES 1
+
 #include "common/debug.c"
 #include "common/entropy_common.c"
 #include "common/error_private.c"
@@ -9,9 +9,13 @@
  * You may select, at your option, one of the above-listed licenses.
  */
 
+#include <linux/atomic.h>
 #include <linux/kernel.h>
+#include <linux/mm.h>
 #include <linux/module.h>
+#include <linux/slab.h>
 #include <linux/string.h>
+#include <linux/workqueue.h>
 #include <linux/zstd.h>
 
 #include "common/zstd_deps.h"
@@ -160,5 +164,124 @@ size_t zstd_end_stream(zstd_cstream *cstream, zstd_out_buffer *output)
 }
 EXPORT_SYMBOL(zstd_end_stream);
 
+size_t zstd_compress_frames_bound(size_t src_size, size_t frame_size)
+{
+	size_t nr_frames = src_size ? DIV_ROUND_UP(src_size, frame_size) : 1;
+
+	return nr_frames * ZSTD_compressBound(min(src_size, frame_size));
+}
+EXPORT_SYMBOL(zstd_compress_frames_bound);
+
+struct zstd_frames_ctx {
+	const zstd_parameters *parameters;
+	const void *src;
+	size_t src_size;
+	size_t frame_size;
+	void *dst;
+	size_t frame_bound;
+	size_t nr_frames;
+	size_t *sizes;
+	atomic_long_t next;
+};
+
+struct zstd_frames_job {
+	struct work_struct work;
+	struct zstd_frames_ctx *ctx;
+	zstd_cctx *cctx;
+};
+
+static void zstd_compress_frames_job(struct zstd_frames_ctx *ctx,
+	zstd_cctx *cctx)
+{
+	size_t i;
+
+	while ((i = atomic_long_inc_return(&ctx->next) - 1) < ctx->nr_frames) {
+		size_t const offset = i * ctx->frame_size;
+
+		ctx->sizes[i] = zstd_compress_cctx(cctx,
+			(char *)ctx->dst + i * ctx->frame_bound, ctx->frame_bound,
+			(const char *)ctx->src + offset,
+			min(ctx->src_size - offset, ctx->frame_size),
+			ctx->parameters);
+		cond_resched();
+	}
+}
+
+static void zstd_compress_frames_work(struct work_struct *work)
+{
+	struct zstd_frames_job *job =
+		container_of(work, struct zstd_frames_job, work);
+
+	zstd_compress_frames_job(job->ctx, job->cctx);
+}
+
+size_t zstd_compress_frames(zstd_cctx **cctxs, unsigned int nr_cctxs,
+	void *dst, size_t dst_capacity, const void *src, size_t src_size,
+	size_t frame_size, const zstd_parameters *parameters)
+{
+	zstd_parameters frame_parameters = *parameters;
+	struct zstd_frames_ctx ctx = {
+		.parameters = &frame_parameters,
+		.src = src,
+		.src_size = src_size,
+		.frame_size = frame_size,
+		.dst = dst,
+		.frame_bound = ZSTD_compressBound(min(src_size, frame_size)),
+		.nr_frames = src_size ? DIV_ROUND_UP(src_size, frame_size) : 1,
+		.next = ATOMIC_LONG_INIT(0),
+	};
+	struct zstd_frames_job *jobs = NULL;
+	unsigned int i, nr_jobs;
+	size_t f, out = 0;
+
+	if (!nr_cctxs || !frame_size)
+		return ERROR(parameter_outOfBound);
+	if (dst_capacity < zstd_compress_frames_bound(src_size, frame_size))
+		return ERROR(dstSize_tooSmall);
+
+	/* zstd_decompress_frames() places each frame by its content size */
+	frame_parameters.fParams.contentSizeFlag = 1;
+
+	ctx.sizes = kvmalloc_array(ctx.nr_frames, sizeof(size_t), GFP_KERNEL);
+	if (!ctx.sizes)
+		return ERROR(memory_allocation);
+
+	nr_jobs = min_t(size_t, nr_cctxs, ctx.nr_frames);
+	if (nr_jobs > 1)
+		jobs = kcalloc(nr_jobs - 1, sizeof(*jobs), GFP_KERNEL);
+	if (!jobs)
+		nr_jobs = 1;
+
+	for (i = 1; i < nr_jobs; i++) {
+		struct zstd_frames_job *job = &jobs[i - 1];
+
+		job->ctx = &ctx;
+		job->cctx = cctxs[i];
+		INIT_WORK(&job->work, zstd_compress_frames_work);
+		queue_work(system_unbound_wq, &job->work);
+	}
+	zstd_compress_frames_job(&ctx, cctxs[0]);
+	for (i = 1; i < nr_jobs; i++)
+		flush_work(&jobs[i - 1].work);
+	kfree(jobs);
+
+	/* Close the gaps between the frames */
+	for (f = 0; f < ctx.nr_frames; f++) {
+		size_t const size = ctx.sizes[f];
+
+		if (ZSTD_isError(size)) {
+			out = size;
+			break;
+		}
+		memmove((char *)dst + out, (char *)dst + f * ctx.frame_bound,
+			size);
+		out += size;
+	}
+
+	kvfree(ctx.sizes);
+	return out;
+}
+EXPORT_SYMBOL(zstd_compress_frames);
+
 MODULE_LICENSE("Dual BSD/GPL");
 MODULE_DESCRIPTION("Zstd Compressor");
@@ -16,6 +16,15 @@
 
 #include "common/zstd_deps.h"
 
+#ifndef ZSTD_DISABLE_PARALLEL_FRAMES
+#include <linux/atomic.h>
+#include <linux/mm.h>
+#include <linux/slab.h>
+#include <linux/workqueue.h>
+
+#include "common/error_private.h"
+#endif
+
 /* Common symbols. zstd_compress must depend on zstd_decompress. */
 
 unsigned int zstd_is_error(size_t code)
@@ -101,5 +110,165 @@ size_t zstd_get_frame_header(zstd_frame_header *header, const void *src,
 }
 EXPORT_SYMBOL(zstd_get_frame_header);
 
+#ifndef ZSTD_DISABLE_PARALLEL_FRAMES
+
+struct zstd_frame_loc {
+	size_t src_offset;
+	size_t src_size;
+	size_t dst_offset;
+	size_t dst_size;
+	size_t ret;
+};
+
+struct zstd_frames_ctx {
+	const void *src;
+	void *dst;
+	struct zstd_frame_loc *frames;
+	size_t nr_frames;
+	atomic_long_t next;
+};
+
+struct zstd_frames_job {
+	struct work_struct work;
+	struct zstd_frames_ctx *ctx;
+	zstd_dctx *dctx;
+};
+
+static void zstd_decompress_frames_job(struct zstd_frames_ctx *ctx,
+	zstd_dctx *dctx)
+{
+	size_t i;
+
+	while ((i = atomic_long_inc_return(&ctx->next) - 1) < ctx->nr_frames) {
+		struct zstd_frame_loc *frame = &ctx->frames[i];
+
+		frame->ret = ZSTD_decompressDCtx(dctx,
+			(char *)ctx->dst + frame->dst_offset, frame->dst_size,
+			(const char *)ctx->src + frame->src_offset,
+			frame->src_size);
+		cond_resched();
+	}
+}
+
+static void zstd_decompress_frames_work(struct work_struct *work)
+{
+	struct zstd_frames_job *job =
+		container_of(work, struct zstd_frames_job, work);
+
+	zstd_decompress_frames_job(job->ctx, job->dctx);
+}
+
+/*
+ * Locates the frames of src and where their content goes in dst. Returns the
+ * number of frames, 0 if a frame does not record its content size, or an
+ * error.
+ */
+static size_t zstd_locate_frames(struct zstd_frame_loc *frames,
+	size_t max_frames, const void *src, size_t src_size,
+	size_t dst_capacity)
+{
+	size_t src_offset = 0, dst_offset = 0, nr_frames = 0;
+
+	while (src_offset < src_size) {
+		const char *frame = (const char *)src + src_offset;
+		size_t const remaining = src_size - src_offset;
+		size_t const frame_size = ZSTD_findFrameCompressedSize(frame,
+			remaining);
+		unsigned long long content_size;
+
+		if (ZSTD_isError(frame_size))
+			return frame_size;
+		content_size = ZSTD_getFrameContentSize(frame, frame_size);
+		if (content_size == ZSTD_CONTENTSIZE_UNKNOWN)
+			return 0;
+		if (content_size == ZSTD_CONTENTSIZE_ERROR)
+			return ERROR(corruption_detected);
+		if (content_size > dst_capacity - dst_offset)
+			return ERROR(dstSize_tooSmall);
+
+		if (frames && nr_frames < max_frames) {
+			frames[nr_frames].src_offset = src_offset;
+			frames[nr_frames].src_size = frame_size;
+			frames[nr_frames].dst_offset = dst_offset;
+			frames[nr_frames].dst_size = content_size;
+		}
+		nr_frames++;
+		src_offset += frame_size;
+		dst_offset += content_size;
+	}
+	return nr_frames;
+}
+
+size_t zstd_decompress_frames(zstd_dctx **dctxs, unsigned int nr_dctxs,
+	void *dst, size_t dst_capacity, const void *src, size_t src_size)
+{
+	struct zstd_frames_ctx ctx = {
+		.src = src,
+		.dst = dst,
+		.next = ATOMIC_LONG_INIT(0),
+	};
+	struct zstd_frames_job *jobs = NULL;
+	unsigned int i, nr_jobs;
+	size_t f, ret;
+
+	if (!nr_dctxs)
+		return ERROR(parameter_outOfBound);
+
+	ret = zstd_locate_frames(NULL, 0, src, src_size, dst_capacity);
+	if (ZSTD_isError(ret))
+		return ret;
+	/* Nothing to split up */
+	if (nr_dctxs == 1 || ret < 2)
+		return ZSTD_decompressDCtx(dctxs[0], dst, dst_capacity, src,
+			src_size);
+
+	ctx.nr_frames = ret;
+	ctx.frames = kvmalloc_array(ctx.nr_frames, sizeof(*ctx.frames),
+		GFP_KERNEL);
+	if (!ctx.frames)
+		return ERROR(memory_allocation);
+	zstd_locate_frames(ctx.frames, ctx.nr_frames, src, src_size,
+		dst_capacity);
+
+	nr_jobs = min_t(size_t, nr_dctxs, ctx.nr_frames);
+	jobs = kcalloc(nr_jobs - 1, sizeof(*jobs), GFP_KERNEL);
+	if (!jobs)
+		nr_jobs = 1;
+
+	for (i = 1; i < nr_jobs; i++) {
+		struct zstd_frames_job *job = &jobs[i - 1];
+
+		job->ctx = &ctx;
+		job->dctx = dctxs[i];
+		INIT_WORK(&job->work, zstd_decompress_frames_work);
+		queue_work(system_unbound_wq, &job->work);
+	}
+	zstd_decompress_frames_job(&ctx, dctxs[0]);
+	for (i = 1; i < nr_jobs; i++)
+		flush_work(&jobs[i - 1].work);
+	kfree(jobs);
+
+	ret = 0;
+	for (f = 0; f < ctx.nr_frames; f++) {
+		struct zstd_frame_loc *frame = &ctx.frames[f];
+
+		if (ZSTD_isError(frame->ret)) {
+			ret = frame->ret;
+			break;
+		}
+		if (frame->ret != frame->dst_size) {
+			ret = ERROR(corruption_detected);
+			break;
+		}
+		ret += frame->ret;
+	}
+
+	kvfree(ctx.frames);
+	return ret;
+}
+EXPORT_SYMBOL(zstd_decompress_frames);
+
+#endif /* ZSTD_DISABLE_PARALLEL_FRAMES */
+
 MODULE_LICENSE("Dual BSD/GPL");
 MODULE_DESCRIPTION("Zstd Decompressor");
@@ -1953,8 +1953,8 @@ static int kdamond_fn(void *data)
 	complete(&ctx->kdamond_started);
 	kdamond_init_intervals_sis(ctx);
 
-	if (ctx->ops.init)
-		ctx->ops.init(ctx);
+	if (ctx->ops.init && ctx->ops.init(ctx))
+		goto done;
 	if (ctx->callback.before_start && ctx->callback.before_start(ctx))
 		goto done;
 
@@ -15,6 +15,8 @@
 #include <linux/memory-tiers.h>
 #include <linux/migrate.h>
 #include <linux/mm_inline.h>
+#include <linux/perf_event.h>
+#include <linux/sort.h>
 
 #include "../internal.h"
 #include "ops-common.h"
@@ -264,11 +266,14 @@ static unsigned long damon_pa_pageout(struct damon_region *r, struct damos *s)
 		damos_add_filter(s, filter);
 	}
 
-	for (addr = r->ar.start; addr < r->ar.end; addr += PAGE_SIZE) {
+	addr = r->ar.start;
+	while (addr < r->ar.end) {
 		struct folio *folio = damon_get_folio(PHYS_PFN(addr));
 
-		if (!folio)
+		if (!folio) {
+			addr += PAGE_SIZE;
 			continue;
+		}
 
 		if (damos_pa_filter_out(s, folio))
 			goto put_folio;
@@ -282,6 +287,8 @@ static unsigned long damon_pa_pageout(struct damon_region *r, struct damos *s)
 		else
 			list_add(&folio->lru, &folio_list);
 put_folio:
+		/* damon_get_folio() only returns head pages */
+		addr += folio_size(folio);
 		folio_put(folio);
 	}
 	if (install_young_filter)
@@ -296,11 +303,14 @@ static inline unsigned long damon_pa_mark_accessed_or_deactivate(
 {
 	unsigned long addr, applied = 0;
 
-	for (addr = r->ar.start; addr < r->ar.end; addr += PAGE_SIZE) {
+	addr = r->ar.start;
+	while (addr < r->ar.end) {
 		struct folio *folio = damon_get_folio(PHYS_PFN(addr));
 
-		if (!folio)
+		if (!folio) {
+			addr += PAGE_SIZE;
 			continue;
+		}
 
 		if (damos_pa_filter_out(s, folio))
 			goto put_folio;
@@ -311,6 +321,7 @@ static inline unsigned long damon_pa_mark_accessed_or_deactivate(
 			folio_deactivate(folio);
 		applied += folio_nr_pages(folio);
 put_folio:
+		addr += folio_size(folio);
 		folio_put(folio);
 	}
 	return applied * PAGE_SIZE;
@@ -454,11 +465,14 @@ static unsigned long damon_pa_migrate(struct damon_region *r, struct damos *s)
 	unsigned long addr, applied;
 	LIST_HEAD(folio_list);
 
-	for (addr = r->ar.start; addr < r->ar.end; addr += PAGE_SIZE) {
+	addr = r->ar.start;
+	while (addr < r->ar.end) {
 		struct folio *folio = damon_get_folio(PHYS_PFN(addr));
 
-		if (!folio)
+		if (!folio) {
+			addr += PAGE_SIZE;
 			continue;
+		}
 
 		if (damos_pa_filter_out(s, folio))
 			goto put_folio;
@@ -467,6 +481,7 @@ static unsigned long damon_pa_migrate(struct damon_region *r, struct damos *s)
 			goto put_folio;
 		list_add(&folio->lru, &folio_list);
 put_folio:
+		addr += folio_size(folio);
 		folio_put(folio);
 	}
 	applied = damon_pa_migrate_pages(&folio_list, s->target_nid);
@@ -520,11 +535,273 @@ static int damon_pa_scheme_score(struct damon_ctx *context,
 	return DAMOS_MAX_SCORE;
 }
 
+static int damon_pa_nid(unsigned long paddr)
+{
+	struct page *page = pfn_to_online_page(PHYS_PFN(paddr));
+
+	return page ? page_to_nid(page) : NUMA_NO_NODE;
+}
+
+/*
+ * If all monitoring regions are backed by the memory of one NUMA node that
+ * has CPUs, run kdamond on that node, so that the access checks and scheme
+ * actions touch node-local page structs and page tables.  Monitoring the
+ * physical address space of a big machine can then be sharded by running
+ * one kdamond per node, each monitoring the address ranges of its node.
+ */
+static void damon_pa_bind_kdamond(struct damon_ctx *ctx)
+{
+	struct damon_target *t;
+	struct damon_region *r;
+	int nid = NUMA_NO_NODE;
+
+	if (!IS_ENABLED(CONFIG_NUMA) || num_online_nodes() < 2)
+		return;
+
+	damon_for_each_target(t, ctx) {
+		damon_for_each_region(r, t) {
+			int start_nid = damon_pa_nid(r->ar.start);
+
+			if (start_nid == NUMA_NO_NODE ||
+			    start_nid != damon_pa_nid(r->ar.end - 1))
+				return;
+			if (nid != NUMA_NO_NODE && nid != start_nid)
+				return;
+			nid = start_nid;
+		}
+	}
+
+	if (nid == NUMA_NO_NODE || cpumask_empty(cpumask_of_node(nid)))
+		return;
+
+	set_cpus_allowed_ptr(current, cpumask_of_node(nid));
+}
+
+static int damon_pa_init(struct damon_ctx *ctx)
+{
+	damon_pa_bind_kdamond(ctx);
+	return 0;
+}
+
+#ifdef CONFIG_PERF_EVENTS
+/*
+ * Access checks fed by hardware memory access sampling (e.g. Intel PEBS
+ * load latency, AMD IBS op or Arm SPE), instead of accessed bits.  A
+ * PMU event that reports data addresses is opened on each online CPU and
+ * the physical addresses of its samples are queued per CPU.  At each
+ * sampling interval, the queued samples are marked on the regions they
+ * fall into.  Only one context can use the sampling at a time.
+ */
+#ifdef MODULE_PARAM_PREFIX
+#undef MODULE_PARAM_PREFIX
+#endif
+#define MODULE_PARAM_PREFIX "damon_pa_sampled."
+
+/* perf_event_attr of the sampling event, see perf_event_open(2) */
+static unsigned int event_type __read_mostly = PERF_TYPE_RAW;
+module_param(event_type, uint, 0600);
+
+static unsigned long event_config __read_mostly;
+module_param(event_config, ulong, 0600);
+
+static unsigned long event_config1 __read_mostly;
+module_param(event_config1, ulong, 0600);
+
+static unsigned long sample_period __read_mostly = 10007;
+module_param(sample_period, ulong, 0600);
+
+static unsigned int precise_ip __read_mostly = 2;
+module_param(precise_ip, uint, 0600);
+
+#define DAMON_PA_SAMPLES_PER_CPU	512
+#define DAMON_PA_SAMPLES_MAX		8192
+
+struct damon_pa_sample_ring {
+	unsigned int head;		/* written by the PMU interrupt */
+	unsigned int tail;		/* written by kdamond */
+	u64 addrs[DAMON_PA_SAMPLES_PER_CPU];
+};
+
+static DEFINE_MUTEX(damon_pa_sampled_lock);
+static struct damon_ctx *damon_pa_sampled_owner;
+static struct damon_pa_sample_ring __percpu *damon_pa_sample_rings;
+static struct perf_event **damon_pa_sample_events;
+static u64 *damon_pa_samples;
+
+static void damon_pa_sample_overflow(struct perf_event *event,
+		struct perf_sample_data *data, struct pt_regs *regs)
+{
+	struct damon_pa_sample_ring *ring = this_cpu_ptr(damon_pa_sample_rings);
+	unsigned int head = ring->head;
+
+	perf_prepare_sample(data, event, regs);
+	if (!data->phys_addr)
+		return;
+
+	/* Drop the sample if kdamond hasn't caught up */
+	if (head - smp_load_acquire(&ring->tail) >= DAMON_PA_SAMPLES_PER_CPU)
+		return;
+
+	ring->addrs[head % DAMON_PA_SAMPLES_PER_CPU] = data->phys_addr;
+	smp_store_release(&ring->head, head + 1);
+}
+
+static void damon_pa_sampled_release(void)
+{
+	int cpu;
+
+	if (damon_pa_sample_events) {
+		for_each_possible_cpu(cpu) {
+			if (damon_pa_sample_events[cpu])
+				perf_event_release_kernel(damon_pa_sample_events[cpu]);
+		}
+	}
+	kfree(damon_pa_sample_events);
+	damon_pa_sample_events = NULL;
+	free_percpu(damon_pa_sample_rings);
+	damon_pa_sample_rings = NULL;
+	kvfree(damon_pa_samples);
+	damon_pa_samples = NULL;
+	damon_pa_sampled_owner = NULL;
+}
+
+static int damon_pa_sampled_init(struct damon_ctx *ctx)
+{
+	struct perf_event_attr attr = {
+		.type = event_type,
+		.size = sizeof(attr),
+		.config = event_config,
+		.config1 = event_config1,
+		.sample_period = sample_period,
+		.sample_type = PERF_SAMPLE_ADDR | PERF_SAMPLE_PHYS_ADDR,
+		.precise_ip = precise_ip,
+		.pinned = 1,
+	};
+	struct perf_event *event;
+	int cpu, err = 0;
+
+	damon_pa_bind_kdamond(ctx);
+
+	mutex_lock(&damon_pa_sampled_lock);
+	if (damon_pa_sampled_owner) {
+		pr_warn("access sampling is in use by another context\n");
+		err = -EBUSY;
+		goto out;
+	}
+
+	damon_pa_sample_events = kcalloc(nr_cpu_ids,
+			sizeof(*damon_pa_sample_events), GFP_KERNEL);
+	damon_pa_sample_rings = alloc_percpu(struct damon_pa_sample_ring);
+	damon_pa_samples = kvmalloc_array(DAMON_PA_SAMPLES_MAX,
+			sizeof(*damon_pa_samples), GFP_KERNEL);
+	if (!damon_pa_sample_events || !damon_pa_sample_rings ||
+			!damon_pa_samples) {
+		err = -ENOMEM;
+		goto err;
+	}
+
+	/* Monitoring with only part of the CPUs sampled would be misleading */
+	cpus_read_lock();
+	for_each_online_cpu(cpu) {
+		event = perf_event_create_kernel_counter(&attr, cpu, NULL,
+				damon_pa_sample_overflow, NULL);
+		if (IS_ERR(event)) {
+			err = PTR_ERR(event);
+			pr_warn("cannot open sampling event on cpu %d (%d)\n",
+					cpu, err);
+			break;
+		}
+		damon_pa_sample_events[cpu] = event;
+	}
+	cpus_read_unlock();
+	if (err)
+		goto err;
+
+	damon_pa_sampled_owner = ctx;
+	goto out;
+err:
+	damon_pa_sampled_release();
+out:
+	mutex_unlock(&damon_pa_sampled_lock);
+	return err;
+}
+
+static void damon_pa_sampled_cleanup(struct damon_ctx *ctx)
+{
+	mutex_lock(&damon_pa_sampled_lock);
+	if (damon_pa_sampled_owner == ctx)
+		damon_pa_sampled_release();
+	mutex_unlock(&damon_pa_sampled_lock);
+}
+
+static int damon_pa_sample_cmp(const void *a, const void *b)
+{
+	u64 l = *(const u64 *)a, r = *(const u64 *)b;
+
+	return l < r ? -1 : l > r;
+}
+
+/* Move the queued samples of all CPUs into damon_pa_samples[] */
+static unsigned int damon_pa_drain_samples(void)
+{
+	unsigned int nr = 0;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		struct damon_pa_sample_ring *ring;
+		unsigned int head, tail;
+
+		if (!damon_pa_sample_events[cpu])
+			continue;
+
+		ring = per_cpu_ptr(damon_pa_sample_rings, cpu);
+		head = smp_load_acquire(&ring->head);
+		for (tail = ring->tail; tail != head; tail++) {
+			if (nr < DAMON_PA_SAMPLES_MAX)
+				damon_pa_samples[nr++] =
+					ring->addrs[tail % DAMON_PA_SAMPLES_PER_CPU];
+		}
+		smp_store_release(&ring->tail, tail);
+	}
+	return nr;
+}
+
+static unsigned int damon_pa_sampled_check_accesses(struct damon_ctx *ctx)
+{
+	struct damon_target *t;
+	struct damon_region *r;
+	unsigned int max_nr_accesses = 0;
+	unsigned int i, nr = 0;
+
+	if (damon_pa_sampled_owner == ctx) {
+		nr = damon_pa_drain_samples();
+		sort(damon_pa_samples, nr, sizeof(*damon_pa_samples),
+				damon_pa_sample_cmp, NULL);
+	}
+
+	/* Both the samples and the regions are sorted by address */
+	damon_for_each_target(t, ctx) {
+		i = 0;
+		damon_for_each_region(r, t) {
+			bool accessed;
+
+			while (i < nr && damon_pa_samples[i] < r->ar.start)
+				i++;
+			accessed = i < nr && damon_pa_samples[i] < r->ar.end;
+			damon_update_region_access_rate(r, accessed, &ctx->attrs);
+			max_nr_accesses = max(r->nr_accesses, max_nr_accesses);
+		}
+	}
+
+	return max_nr_accesses;
+}
+#endif	/* CONFIG_PERF_EVENTS */
+
 static int __init damon_pa_initcall(void)
 {
 	struct damon_operations ops = {
 		.id = DAMON_OPS_PADDR,
-		.init = NULL,
+		.init = damon_pa_init,
 		.update = NULL,
 		.prepare_access_checks = damon_pa_prepare_access_checks,
 		.check_accesses = damon_pa_check_accesses,
@@ -535,7 +812,21 @@ static int __init damon_pa_initcall(void)
 		.get_scheme_score = damon_pa_scheme_score,
 	};
 
-	return damon_register_ops(&ops);
+	int err;
+
+	err = damon_register_ops(&ops);
+	if (err)
+		return err;
+
+#ifdef CONFIG_PERF_EVENTS
+	ops.id = DAMON_OPS_PADDR_SAMPLED;
+	ops.init = damon_pa_sampled_init;
+	ops.prepare_access_checks = NULL;
+	ops.check_accesses = damon_pa_sampled_check_accesses;
+	ops.cleanup = damon_pa_sampled_cleanup;
+	err = damon_register_ops(&ops);
+#endif
+	return err;
 };
 
 subsys_initcall(damon_pa_initcall);
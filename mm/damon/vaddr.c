@@ -271,7 +271,7 @@ static void __damon_va_init_regions(struct damon_ctx *ctx,
 }
 
 /* Initialize '->regions_list' of every target (task) */
-static void damon_va_init(struct damon_ctx *ctx)
+static int damon_va_init(struct damon_ctx *ctx)
 {
 	struct damon_target *t;
 
@@ -280,6 +280,7 @@ static void damon_va_init(struct damon_ctx *ctx)
 		if (!damon_nr_regions(t))
 			__damon_va_init_regions(ctx, t);
 	}
+	return 0;
 }
 
 /*
@@ -228,6 +228,18 @@ static inline bool poison_slab_object(struct kmem_cache *cache, void *object,
 	if (unlikely(cache->flags & SLAB_TYPESAFE_BY_RCU))
 		return false;
 
+	/*
+	 * An object excluded due to sampling was handed out with a match-all
+	 * tag, so a double free can't be told apart and no alloc info was
+	 * saved for it. Still poison it, so that stale tagged pointers into
+	 * its memory keep faulting.
+	 */
+	if (kasan_slab_sampled_out(tagged_object)) {
+		kasan_poison(object, round_up(cache->object_size, KASAN_GRANULE_SIZE),
+				KASAN_SLAB_FREE, init);
+		return false;
+	}
+
 	if (!kasan_byte_accessible(tagged_object)) {
 		kasan_report_invalid_free(tagged_object, ip, KASAN_REPORT_DOUBLE_FREE);
 		return true;
@@ -327,6 +339,18 @@ void * __must_check __kasan_slab_alloc(struct kmem_cache *cache,
 	if (is_kfence_address(object))
 		return (void *)object;
 
+	/*
+	 * Hand out a match-all pointer without tagging the object if it is
+	 * excluded due to sampling. KASAN is responsible for initializing
+	 * the memory in this mode.
+	 */
+	if (!kasan_sample_slab_alloc(cache)) {
+		object = set_tag(object, KASAN_TAG_KERNEL);
+		if (init)
+			memset(object, 0, cache->object_size);
+		return object;
+	}
+
 	/*
 	 * Generate and assign random tag for tag-based modes.
 	 * Tag is ignored in set_tag() for the generic mode.
@@ -383,6 +407,10 @@ void * __must_check __kasan_kmalloc(struct kmem_cache *cache, const void *object
 	if (is_kfence_address(object))
 		return (void *)object;
 
+	/* Bail out if allocation was excluded due to sampling. */
+	if (kasan_slab_sampled_out(object))
+		return (void *)object;
+
 	/* The object has already been unpoisoned by kasan_slab_alloc(). */
 	poison_kmalloc_redzone(cache, object, size, flags);
 
@@ -441,6 +469,10 @@ void * __must_check __kasan_krealloc(const void *object, size_t size, gfp_t flag
 	if (is_kfence_address(object))
 		return (void *)object;
 
+	/* Bail out if the slab object was excluded due to sampling. */
+	if (kasan_slab_sampled_out(object) && virt_to_slab(object))
+		return (void *)object;
+
 	/*
 	 * Unpoison the object's data.
 	 * Part of it might already have been unpoisoned, but it's unknown
@@ -531,6 +563,10 @@ void __kasan_mempool_unpoison_object(void *ptr, size_t size, unsigned long ip)
 	if (is_kfence_address(ptr))
 		return;
 
+	/* Bail out if allocation was excluded due to sampling. */
+	if (kasan_slab_sampled_out(ptr))
+		return;
+
 	/* Unpoison the object and save alloc info for non-kmalloc() allocations. */
 	unpoison_slab_object(slab->slab_cache, ptr, flags, false);
 
@@ -83,6 +83,23 @@ unsigned int kasan_page_alloc_sample_order = PAGE_ALLOC_SAMPLE_ORDER_DEFAULT;
 
 DEFINE_PER_CPU(long, kasan_page_alloc_skip);
 
+#define SLAB_SAMPLE_DEFAULT	1
+#define SLAB_SAMPLE_SIZE_DEFAULT	0
+
+/*
+ * Sampling interval of slab allocation (un)poisoning.
+ * Defaults to no sampling.
+ */
+unsigned long kasan_slab_sample = SLAB_SAMPLE_DEFAULT;
+
+/*
+ * Minimum object size of a cache that slab sampling is applied to.
+ * Defaults to all caches.
+ */
+unsigned int kasan_slab_sample_size = SLAB_SAMPLE_SIZE_DEFAULT;
+
+DEFINE_PER_CPU(long, kasan_slab_skip);
+
 /* kasan=off/on */
 static int __init early_kasan_flag(char *arg)
 {
@@ -191,6 +208,48 @@ static int __init early_kasan_flag_page_alloc_sample_order(char *arg)
 }
 early_param("kasan.page_alloc.sample.order", early_kasan_flag_page_alloc_sample_order);
 
+/* kasan.slab.sample=<sampling interval> */
+static int __init early_kasan_flag_slab_sample(char *arg)
+{
+	int rv;
+
+	if (!arg)
+		return -EINVAL;
+
+	rv = kstrtoul(arg, 0, &kasan_slab_sample);
+	if (rv)
+		return rv;
+
+	if (!kasan_slab_sample || kasan_slab_sample > LONG_MAX) {
+		kasan_slab_sample = SLAB_SAMPLE_DEFAULT;
+		return -EINVAL;
+	}
+
+	return 0;
+}
+early_param("kasan.slab.sample", early_kasan_flag_slab_sample);
+
+/* kasan.slab.sample.size=<minimum object size> */
+static int __init early_kasan_flag_slab_sample_size(char *arg)
+{
+	int rv;
+
+	if (!arg)
+		return -EINVAL;
+
+	rv = kstrtouint(arg, 0, &kasan_slab_sample_size);
+	if (rv)
+		return rv;
+
+	if (kasan_slab_sample_size > KMALLOC_MAX_SIZE) {
+		kasan_slab_sample_size = SLAB_SAMPLE_SIZE_DEFAULT;
+		return -EINVAL;
+	}
+
+	return 0;
+}
+early_param("kasan.slab.sample.size", early_kasan_flag_slab_sample_size);
+
 /*
  * kasan_init_hw_tags_cpu() is called for each CPU.
  * Not marked as __init as a CPU can be hot-plugged after boot.
@@ -46,6 +46,10 @@ extern unsigned long kasan_page_alloc_sample;
 extern unsigned int kasan_page_alloc_sample_order;
 DECLARE_PER_CPU(long, kasan_page_alloc_skip);
 
+extern unsigned long kasan_slab_sample;
+extern unsigned int kasan_slab_sample_size;
+DECLARE_PER_CPU(long, kasan_slab_skip);
+
 static inline bool kasan_vmalloc_enabled(void)
 {
 	/* Static branch is never enabled with CONFIG_KASAN_VMALLOC disabled. */
@@ -80,6 +84,27 @@ static inline bool kasan_sample_page_alloc(unsigned int order)
 	return false;
 }
 
+static inline bool kasan_sample_slab_alloc(struct kmem_cache *cache)
+{
+	/* Fast-path for when sampling is disabled. */
+	if (kasan_slab_sample == 1)
+		return true;
+
+	if (cache->object_size < kasan_slab_sample_size)
+		return true;
+
+	/* Objects in these caches keep the tag assigned at slab creation. */
+	if (cache->ctor || (cache->flags & SLAB_TYPESAFE_BY_RCU))
+		return true;
+
+	if (this_cpu_dec_return(kasan_slab_skip) < 0) {
+		this_cpu_write(kasan_slab_skip, kasan_slab_sample - 1);
+		return true;
+	}
+
+	return false;
+}
+
 #else /* CONFIG_KASAN_HW_TAGS */
 
 static inline bool kasan_vmalloc_enabled(void)
@@ -102,6 +127,11 @@ static inline bool kasan_sample_page_alloc(unsigned int order)
 	return true;
 }
 
+static inline bool kasan_sample_slab_alloc(struct kmem_cache *cache)
+{
+	return true;
+}
+
 #endif /* CONFIG_KASAN_HW_TAGS */
 
 #ifdef CONFIG_KASAN_GENERIC
@@ -497,6 +527,15 @@ static inline bool kasan_byte_accessible(const void *addr)
 	return ptr_tag == KASAN_TAG_KERNEL || ptr_tag == mem_tag;
 }
 
+/*
+ * Slab objects excluded due to sampling are handed out with the match-all
+ * KASAN_TAG_KERNEL tag, which sampled objects never get.
+ */
+static inline bool kasan_slab_sampled_out(const void *object)
+{
+	return kasan_slab_sample != 1 && get_tag(object) == KASAN_TAG_KERNEL;
+}
+
 #else /* CONFIG_KASAN_HW_TAGS */
 
 /**
@@ -523,6 +562,11 @@ void kasan_unpoison(const void *addr, size_t size, bool init);
 
 bool kasan_byte_accessible(const void *addr);
 
+static inline bool kasan_slab_sampled_out(const void *object)
+{
+	return false;
+}
+
 #endif /* CONFIG_KASAN_HW_TAGS */
 
 #ifdef CONFIG_KASAN_GENERIC
@@ -23,6 +23,8 @@
 #include <linux/smp.h>
 #include <linux/cpumask.h>
 #include <linux/audit.h>
+#include <linux/etherdevice.h>
+#include <linux/sort.h>
 #include <net/sock.h>
 #include <net/netns/generic.h>
 /* needed for logical [in,out]-dev filtering */
@@ -188,6 +190,64 @@ ebt_get_target_c(const struct ebt_entry *e)
 	return ebt_get_target((struct ebt_entry *)e);
 }
 
+/* Runs of at least EBT_MACIDX_MIN_RUN consecutive rules of one chain that all
+ * match a single exact (full mask, not inverted) source or destination MAC
+ * are dispatched through a per-run index sorted by address: a rule carrying
+ * another address cannot match, so the walk jumps straight to the next rule
+ * of the run with the packet's address, or past the run if there is none.
+ */
+#define EBT_MACIDX_MIN_RUN	8
+
+enum {
+	EBT_MACIDX_NONE,
+	EBT_MACIDX_SRC,
+	EBT_MACIDX_DST,
+};
+
+struct ebt_mac_key {
+	u64 mac;
+	unsigned int rule;	/* global rule number */
+};
+
+struct ebt_mac_run {
+	unsigned int end;	/* global rule number past the run */
+	unsigned int nkeys;
+	int type;
+	struct ebt_mac_key *keys;	/* sorted by mac, then rule */
+};
+
+struct ebt_macidx {
+	/* per global rule number: 1 + index of its run, 0 if none */
+	unsigned int *run;
+	struct ebt_entry **entry;
+	struct ebt_mac_key *keys;
+	unsigned int nruns;
+	struct ebt_mac_run runs[];
+};
+
+/* first rule >= g in the run that can match the packet's address */
+static unsigned int ebt_macidx_next(const struct ebt_mac_run *run,
+				    const struct sk_buff *skb, unsigned int g)
+{
+	const struct ethhdr *h = eth_hdr(skb);
+	unsigned int lo = 0, hi = run->nkeys, mid;
+	u64 mac;
+
+	mac = ether_addr_to_u64(run->type == EBT_MACIDX_SRC ? h->h_source :
+							    h->h_dest);
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (run->keys[mid].mac < mac ||
+		    (run->keys[mid].mac == mac && run->keys[mid].rule < g))
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (lo < run->nkeys && run->keys[lo].mac == mac)
+		return run->keys[lo].rule;
+	return run->end;
+}
+
 /* Do some firewalling */
 unsigned int ebt_do_table(void *priv, struct sk_buff *skb,
 			  const struct nf_hook_state *state)
@@ -203,6 +263,7 @@ unsigned int ebt_do_table(void *priv, struct sk_buff *skb,
 	struct ebt_entries *chaininfo;
 	const char *base;
 	const struct ebt_table_info *private;
+	const struct ebt_macidx *macidx;
 	struct xt_action_param acpar;
 
 	acpar.state   = state;
@@ -210,6 +271,7 @@ unsigned int ebt_do_table(void *priv, struct sk_buff *skb,
 
 	read_lock_bh(&table->lock);
 	private = table->private;
+	macidx = private->macidx;
 	cb_base = COUNTER_BASE(private->counters, private->nentries,
 	   smp_processor_id());
 	if (private->chainstack)
@@ -224,6 +286,22 @@ unsigned int ebt_do_table(void *priv, struct sk_buff *skb,
 	base = private->entries;
 	i = 0;
 	while (i < nentries) {
+		if (macidx) {
+			unsigned int g = chaininfo->counter_offset + i;
+			unsigned int next;
+
+			if (macidx->run[g]) {
+				next = ebt_macidx_next(&macidx->runs[macidx->run[g] - 1],
+						       skb, g);
+				if (next != g) {
+					i += next - g;
+					if (i >= nentries)
+						break;
+					point = macidx->entry[next];
+				}
+			}
+		}
+
 		if (ebt_basic_match(point, skb, state->in, state->out))
 			goto letscontinue;
 
@@ -379,10 +457,23 @@ find_table_lock(struct net *net, const char *name, int *error,
 	return find_inlist_lock(net, name, "ebtable_", error, mutex);
 }
 
+static void ebt_free_macidx(struct ebt_macidx *idx)
+{
+	if (!idx)
+		return;
+	kvfree(idx->run);
+	kvfree(idx->entry);
+	kvfree(idx->keys);
+	kvfree(idx);
+}
+
 static inline void ebt_free_table_info(struct ebt_table_info *info)
 {
 	int i;
 
+	ebt_free_macidx(info->macidx);
+	info->macidx = NULL;
+
 	if (info->chainstack) {
 		for_each_possible_cpu(i)
 			vfree(info->chainstack[i]);
@@ -863,6 +954,127 @@ static int check_chainloops(const struct ebt_entries *chain, struct ebt_cl_stack
 	return 0;
 }
 
+/* state while grouping the rules of a table into MAC index runs */
+struct ebt_macidx_walk {
+	struct ebt_macidx *idx;	/* NULL while only counting */
+	unsigned int g;		/* global number of the current rule */
+	unsigned int start;	/* first rule of the open run */
+	int type;		/* key of the open run */
+	unsigned int nruns;
+	unsigned int nkeys;
+};
+
+static int ebt_macidx_type(const struct ebt_entry *e, int prefer)
+{
+	bool src, dst;
+
+	src = (e->bitmask & EBT_SOURCEMAC) && !(e->invflags & EBT_ISOURCE) &&
+	      is_broadcast_ether_addr(e->sourcemsk);
+	dst = (e->bitmask & EBT_DESTMAC) && !(e->invflags & EBT_IDEST) &&
+	      is_broadcast_ether_addr(e->destmsk);
+
+	if (dst && (prefer == EBT_MACIDX_DST || !src))
+		return EBT_MACIDX_DST;
+	return src ? EBT_MACIDX_SRC : EBT_MACIDX_NONE;
+}
+
+static int ebt_mac_key_cmp(const void *a, const void *b)
+{
+	const struct ebt_mac_key *ka = a, *kb = b;
+
+	if (ka->mac != kb->mac)
+		return ka->mac < kb->mac ? -1 : 1;
+	return ka->rule < kb->rule ? -1 : ka->rule > kb->rule;
+}
+
+static void ebt_macidx_close(struct ebt_macidx_walk *w)
+{
+	unsigned int n = w->g - w->start, g;
+	const struct ebt_entry *e;
+	struct ebt_mac_run *run;
+
+	if (w->type == EBT_MACIDX_NONE || n < EBT_MACIDX_MIN_RUN)
+		goto out;
+
+	if (w->idx) {
+		run = &w->idx->runs[w->nruns];
+		run->end = w->g;
+		run->nkeys = n;
+		run->type = w->type;
+		run->keys = w->idx->keys + w->nkeys;
+		for (g = w->start; g < w->g; g++) {
+			e = w->idx->entry[g];
+			run->keys[g - w->start].mac = ether_addr_to_u64(
+				w->type == EBT_MACIDX_SRC ? e->sourcemac :
+							    e->destmac);
+			run->keys[g - w->start].rule = g;
+			w->idx->run[g] = w->nruns + 1;
+		}
+		sort(run->keys, n, sizeof(*run->keys), ebt_mac_key_cmp, NULL);
+	}
+	w->nruns++;
+	w->nkeys += n;
+out:
+	w->type = EBT_MACIDX_NONE;
+}
+
+static int ebt_macidx_walk_entry(struct ebt_entry *e, struct ebt_macidx_walk *w)
+{
+	int type;
+
+	/* a chain header ends any run */
+	if ((e->bitmask & EBT_ENTRY_OR_ENTRIES) == 0) {
+		ebt_macidx_close(w);
+		return 0;
+	}
+
+	if (w->idx)
+		w->idx->entry[w->g] = e;
+	type = ebt_macidx_type(e, w->type);
+	if (type != w->type) {
+		ebt_macidx_close(w);
+		w->type = type;
+		w->start = w->g;
+	}
+	w->g++;
+	return 0;
+}
+
+/* The index only saves work, a table without one behaves the same, so
+ * allocation failures are not reported.
+ */
+static void ebt_build_macidx(struct ebt_table_info *newinfo)
+{
+	struct ebt_macidx_walk w = {};
+	struct ebt_macidx *idx;
+
+	EBT_ENTRY_ITERATE(newinfo->entries, newinfo->entries_size,
+			  ebt_macidx_walk_entry, &w);
+	ebt_macidx_close(&w);
+	if (!w.nruns)
+		return;
+
+	idx = kvzalloc(struct_size(idx, runs, w.nruns), GFP_KERNEL);
+	if (!idx)
+		return;
+	idx->nruns = w.nruns;
+	idx->run = kvcalloc(newinfo->nentries, sizeof(*idx->run), GFP_KERNEL);
+	idx->entry = kvcalloc(newinfo->nentries, sizeof(*idx->entry),
+			      GFP_KERNEL);
+	idx->keys = kvcalloc(w.nkeys, sizeof(*idx->keys), GFP_KERNEL);
+	if (!idx->run || !idx->entry || !idx->keys) {
+		ebt_free_macidx(idx);
+		return;
+	}
+
+	memset(&w, 0, sizeof(w));
+	w.idx = idx;
+	EBT_ENTRY_ITERATE(newinfo->entries, newinfo->entries_size,
+			  ebt_macidx_walk_entry, &w);
+	ebt_macidx_close(&w);
+	newinfo->macidx = idx;
+}
+
 /* do the parsing of the table/chains/entries/matches/watchers/targets, heh */
 static int translate_table(struct net *net, const char *name,
 			   struct ebt_table_info *newinfo)
@@ -978,6 +1190,8 @@ static int translate_table(struct net *net, const char *name,
 	if (ret != 0) {
 		EBT_ENTRY_ITERATE(newinfo->entries, newinfo->entries_size,
 				  ebt_cleanup_entry, net, &i);
+	} else {
+		ebt_build_macidx(newinfo);
 	}
 	vfree(cl_s);
 	return ret;
@@ -1025,6 +1239,7 @@ static int do_replace_finish(struct net *net, struct ebt_replace *repl,
 	}
 
 	newinfo->chainstack = NULL;
+	newinfo->macidx = NULL;
 	ret = ebt_verify_pointers(repl, newinfo);
 	if (ret != 0)
 		goto free_counterstmp;
@@ -1223,6 +1438,7 @@ int ebt_register_table(struct net *net, const struct ebt_table *input_table,
 
 	/* fill in newinfo and parse the entries */
 	newinfo->chainstack = NULL;
+	newinfo->macidx = NULL;
 	for (i = 0; i < NF_BR_NUMHOOKS; i++) {
 		if ((repl->valid_hooks & (1 << i)) == 0)
 			newinfo->hook_entry[i] = NULL;
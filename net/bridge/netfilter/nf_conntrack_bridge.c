@@ -10,6 +10,7 @@
 #include <linux/sysctl.h>
 #include <net/route.h>
 #include <net/ip.h>
+#include <net/ipv6.h>
 
 #include <net/netfilter/nf_conntrack.h>
 #include <net/netfilter/nf_conntrack_core.h>
@@ -21,6 +22,14 @@
 
 #include "../br_private.h"
 
+/* Bridged fragments are reassembled for conntrack and refragmented on the
+ * way out.  Rulesets that accept fragmented traffic statelessly can instead
+ * let them through as-is, untracked, and save the reassembly.
+ */
+static bool frag_passthrough __read_mostly;
+MODULE_PARM_DESC(frag_passthrough, "Forward IPv4/IPv6 fragments untracked instead of reassembling them");
+module_param(frag_passthrough, bool, 0644);
+
 /* Best effort variant of ip_do_fragment which preserves geometry, unless skbuff
  * has been linearized or cloned.
  */
@@ -237,6 +246,20 @@ static int nf_ct_br_ipv6_check(const struct sk_buff *skb)
 	return 0;
 }
 
+static bool nf_ct_br_ipv6_is_fragment(const struct sk_buff *skb)
+{
+	unsigned int offset = 0;
+	struct frag_hdr _fh;
+	const struct frag_hdr *fh;
+
+	if (ipv6_find_hdr(skb, &offset, NEXTHDR_FRAGMENT, NULL, NULL) < 0)
+		return false;
+
+	fh = skb_header_pointer(skb, offset, sizeof(_fh), &_fh);
+	/* atomic fragments are whole packets, track them as usual */
+	return fh && (fh->frag_off & htons(IP6_OFFSET | IP6_MF));
+}
+
 static unsigned int nf_ct_bridge_pre(void *priv, struct sk_buff *skb,
 				     const struct nf_hook_state *state)
 {
@@ -263,6 +286,9 @@ static unsigned int nf_ct_bridge_pre(void *priv, struct sk_buff *skb,
 		if (nf_ct_br_ip_check(skb))
 			return NF_ACCEPT;
 
+		if (READ_ONCE(frag_passthrough) && ip_is_fragment(ip_hdr(skb)))
+			goto untracked;
+
 		bridge_state.pf = NFPROTO_IPV4;
 		ret = nf_ct_br_defrag4(skb, &bridge_state);
 		break;
@@ -277,18 +303,27 @@ static unsigned int nf_ct_bridge_pre(void *priv, struct sk_buff *skb,
 		if (nf_ct_br_ipv6_check(skb))
 			return NF_ACCEPT;
 
+		if (READ_ONCE(frag_passthrough) &&
+		    nf_ct_br_ipv6_is_fragment(skb))
+			goto untracked;
+
 		bridge_state.pf = NFPROTO_IPV6;
 		ret = nf_ct_br_defrag6(skb, &bridge_state);
 		break;
 	default:
-		nf_ct_set(skb, NULL, IP_CT_UNTRACKED);
-		return NF_ACCEPT;
+		goto untracked;
 	}
 
 	if (ret != NF_ACCEPT)
 		return ret;
 
 	return nf_conntrack_in(skb, &bridge_state);
+
+untracked:
+	/* drop a zone template the raw table may have attached */
+	nf_reset_ct(skb);
+	nf_ct_set(skb, NULL, IP_CT_UNTRACKED);
+	return NF_ACCEPT;
 }
 
 static unsigned int nf_ct_bridge_in(void *priv, struct sk_buff *skb,
@@ -164,11 +164,26 @@ struct trie_stat {
 	unsigned int nodesizes[MAX_STAT_DEPTH];
 };
 
+#ifdef CONFIG_IP_FIB_TRIE_JUMP_TABLE
+/* The jump table is indexed by the top FIB_JUMP_BITS bits of the key */
+#define FIB_JUMP_BITS	16
+#define FIB_JUMP_SHIFT	(KEYLENGTH - FIB_JUMP_BITS)
+#define FIB_JUMP_SIZE	(1ul << FIB_JUMP_BITS)
+
+struct trie_jump {
+	DECLARE_BITMAP(dirty, FIB_JUMP_SIZE);
+	struct key_vector __rcu *node[FIB_JUMP_SIZE];
+};
+#endif
+
 struct trie {
 	struct key_vector kv[1];
 #ifdef CONFIG_IP_FIB_TRIE_STATS
 	struct trie_use_stats __percpu *stats;
 #endif
+#ifdef CONFIG_IP_FIB_TRIE_JUMP_TABLE
+	struct trie_jump *jump;
+#endif
 };
 
 static struct key_vector *resize(struct trie *t, struct key_vector *tn);
@@ -475,6 +490,121 @@ static inline void put_child_root(struct key_vector *tp, t_key key,
 		put_child(tp, get_index(key, tp), n);
 }
 
+#ifdef CONFIG_IP_FIB_TRIE_JUMP_TABLE
+/* The jump table caches, for each /16, the deepest tnode that every key in
+ * it walks through and whose key and index bits lie entirely within those
+ * 16 bits.  Lookups can start from that tnode and skip the upper levels of
+ * the trie.  Since such a tnode is on the path of every key in the range
+ * for as long as it is part of the trie, entries only go stale when their
+ * tnode is freed.  tnodes are never modified in place in a way that moves
+ * them, so clearing the entry before the tnode is handed to RCU is enough
+ * for lookups; the entry is recomputed once the trie is consistent again.
+ */
+static void trie_jump_mark(struct trie *t, struct key_vector *tn, bool forget)
+{
+	struct trie_jump *jump = t->jump;
+	unsigned long first, nr, i;
+
+	if (!jump || IS_TRIE(tn) || tn->pos < FIB_JUMP_SHIFT)
+		return;
+
+	first = tn->key >> FIB_JUMP_SHIFT;
+	nr = 1ul << (tn->pos + tn->bits - FIB_JUMP_SHIFT);
+
+	for (i = first; i < first + nr; i++) {
+		if (forget && rtnl_dereference(jump->node[i]) == tn)
+			RCU_INIT_POINTER(jump->node[i], NULL);
+	}
+	bitmap_set(jump->dirty, first, nr);
+}
+
+static void trie_jump_forget(struct trie *t, struct key_vector *tn)
+{
+	trie_jump_mark(t, tn, true);
+}
+
+static void trie_jump_dirty(struct trie *t, struct key_vector *tn)
+{
+	trie_jump_mark(t, tn, false);
+}
+
+static struct key_vector *trie_jump_build(struct trie *t, t_key key)
+{
+	struct key_vector *n = get_child(t->kv, 0), *tn = NULL;
+
+	while (n && IS_TNODE(n) && n->pos >= FIB_JUMP_SHIFT) {
+		unsigned long index = get_cindex(key, n);
+
+		if (index >= (1ul << n->bits))
+			break;
+
+		tn = n;
+		n = get_child(n, index);
+	}
+
+	return tn;
+}
+
+/* caller must hold RTNL and the trie must be consistent */
+static void trie_jump_update(struct trie *t)
+{
+	struct trie_jump *jump = t->jump;
+	unsigned long i;
+
+	if (!jump)
+		return;
+
+	for_each_set_bit(i, jump->dirty, FIB_JUMP_SIZE)
+		rcu_assign_pointer(jump->node[i],
+				   trie_jump_build(t, i << FIB_JUMP_SHIFT));
+
+	bitmap_zero(jump->dirty, FIB_JUMP_SIZE);
+}
+
+static inline struct key_vector *trie_jump_lookup(struct trie *t, t_key key)
+{
+	if (!t->jump)
+		return NULL;
+
+	return rcu_dereference_rtnl(t->jump->node[key >> FIB_JUMP_SHIFT]);
+}
+
+static void trie_jump_init(struct trie *t)
+{
+	t->jump = kvzalloc(sizeof(*t->jump), GFP_KERNEL);
+}
+
+static void trie_jump_free(struct trie *t)
+{
+	kvfree(t->jump);
+}
+#else
+static inline void trie_jump_forget(struct trie *t, struct key_vector *tn)
+{
+}
+
+static inline void trie_jump_dirty(struct trie *t, struct key_vector *tn)
+{
+}
+
+static inline void trie_jump_update(struct trie *t)
+{
+}
+
+static inline struct key_vector *trie_jump_lookup(struct trie *t, t_key key)
+{
+	return NULL;
+}
+
+static inline void trie_jump_init(struct trie *t)
+{
+}
+
+static inline void trie_jump_free(struct trie *t)
+{
+}
+#endif
+
 static inline void tnode_free_init(struct key_vector *tn)
 {
 	tn_info(tn)->rcu.next = NULL;
@@ -487,13 +617,14 @@ static inline void tnode_free_append(struct key_vector *tn,
 	tn_info(tn)->rcu.next = &tn_info(n)->rcu;
 }
 
-static void tnode_free(struct key_vector *tn)
+static void tnode_free(struct trie *t, struct key_vector *tn)
 {
 	struct callback_head *head = &tn_info(tn)->rcu;
 
 	while (head) {
 		head = head->next;
 		tnode_free_size += TNODE_SIZE(1ul << tn->bits);
+		trie_jump_forget(t, tn);
 		node_free(tn);
 
 		tn = container_of(head, struct tnode, rcu)->kv;
@@ -520,7 +651,7 @@ static struct key_vector *replace(struct trie *t,
 	update_children(tn);
 
 	/* all pointers should be clean so we are done */
-	tnode_free(oldtnode);
+	tnode_free(t, oldtnode);
 
 	/* resize children now that oldtnode is freed */
 	for (i = child_length(tn); i;) {
@@ -625,7 +756,7 @@ static struct key_vector *inflate(struct trie *t,
 	return replace(t, oldtnode, tn);
 nomem:
 	/* all pointers should be clean so we are done */
-	tnode_free(tn);
+	tnode_free(t, tn);
 notnode:
 	return NULL;
 }
@@ -680,7 +811,7 @@ static struct key_vector *halve(struct trie *t,
 	return replace(t, oldtnode, tn);
 nomem:
 	/* all pointers should be clean so we are done */
-	tnode_free(tn);
+	tnode_free(t, tn);
 notnode:
 	return NULL;
 }
@@ -701,6 +832,7 @@ static struct key_vector *collapse(struct trie *t,
 	node_set_parent(n, tp);
 
 	/* drop dead node */
+	trie_jump_forget(t, oldtnode);
 	node_free(oldtnode);
 
 	return tp;
@@ -1105,6 +1237,8 @@ static void trie_rebalance(struct trie *t, struct key_vector *tn)
 {
 	while (!IS_TRIE(tn))
 		tn = resize(t, tn);
+
+	trie_jump_update(t);
 }
 
 static int fib_insert_node(struct trie *t, struct key_vector *tp,
@@ -1139,6 +1273,7 @@ static int fib_insert_node(struct trie *t, struct key_vector *tp,
 		/* start adding routes into the node */
 		put_child_root(tp, key, tn);
 		node_set_parent(n, tn);
+		trie_jump_dirty(t, tn);
 
 		/* parent now has a NULL spot where the leaf can go */
 		tp = tn;
@@ -1468,6 +1603,21 @@ int fib_table_lookup(struct fib_table *tb, const struct flowi4 *flp,
 	this_cpu_inc(stats->gets);
 #endif
 
+	/* Skip the levels of the trie that are fully determined by the top
+	 * bits of the key.  The jump tnode becomes pn unconditionally; for a
+	 * tnode with no suffix to chop that only costs a few extra steps
+	 * when backtracing, the result is the same.
+	 */
+	pn = trie_jump_lookup(t, key);
+	if (pn) {
+		cindex = get_cindex(key, pn);
+		n = get_child_rcu(pn, cindex);
+		if (unlikely(!n))
+			goto backtrace;
+	} else {
+		pn = t->kv;
+	}
+
 	/* Step 1: Travel to the longest prefix match in the trie */
 	for (;;) {
 		index = get_cindex(key, n);
@@ -1895,6 +2045,7 @@ static void fib_trie_free(struct fib_table *tb)
 #ifdef CONFIG_IP_FIB_TRIE_STATS
 	free_percpu(t->stats);
 #endif
+	trie_jump_free(t);
 	kfree(tb);
 }
 
@@ -2023,6 +2174,8 @@ void fib_table_flush_external(struct fib_table *tb)
 			node_free(n);
 		}
 	}
+
+	trie_jump_update(t);
 }
 
 /* Caller must hold RTNL. */
@@ -2110,6 +2263,8 @@ int fib_table_flush(struct net *net, struct fib_table *tb, bool flush_all)
 		}
 	}
 
+	trie_jump_update(t);
+
 	pr_debug("trie_flush found=%d\n", found);
 	return found;
 }
@@ -2253,12 +2408,14 @@ int fib_notify(struct net *net, struct notifier_block *nb,
 static void __trie_free_rcu(struct rcu_head *head)
 {
 	struct fib_table *tb = container_of(head, struct fib_table, rcu);
-#ifdef CONFIG_IP_FIB_TRIE_STATS
 	struct trie *t = (struct trie *)tb->tb_data;
 
-	if (tb->tb_data == tb->__data)
+	if (tb->tb_data == tb->__data) {
+#ifdef CONFIG_IP_FIB_TRIE_STATS
 		free_percpu(t->stats);
 #endif /* CONFIG_IP_FIB_TRIE_STATS */
+		trie_jump_free(t);
+	}
 	kfree(tb);
 }
 
@@ -2436,9 +2593,11 @@ struct fib_table *fib_trie_table(u32 id, struct fib_table *alias)
 	t->stats = alloc_percpu(struct trie_use_stats);
 	if (!t->stats) {
 		kfree(tb);
-		tb = NULL;
+		return NULL;
 	}
 #endif
+	/* the jump table is only an accelerator, run without on failure */
+	trie_jump_init(t);
 
 	return tb;
 }
@@ -171,6 +171,7 @@ static void fqdir_free_fn(struct work_struct *work)
 		if (refcount_dec_and_test(&f->refcnt))
 			complete(&f->completion);
 
+		percpu_counter_destroy(&fqdir->mem);
 		kfree(fqdir);
 	}
 }
@@ -196,8 +197,14 @@ int fqdir_init(struct fqdir **fqdirp, struct inet_frags *f, struct net *net)
 		return -ENOMEM;
 	fqdir->f = f;
 	fqdir->net = net;
+	res = percpu_counter_init(&fqdir->mem, 0, GFP_KERNEL);
+	if (res < 0) {
+		kfree(fqdir);
+		return res;
+	}
 	res = rhashtable_init(&fqdir->rhashtable, &fqdir->f->rhash_params);
 	if (res < 0) {
+		percpu_counter_destroy(&fqdir->mem);
 		kfree(fqdir);
 		return res;
 	}
@@ -365,7 +372,7 @@ struct inet_frag_queue *inet_frag_find(struct fqdir *fqdir, void *key)
 	long high_thresh = READ_ONCE(fqdir->high_thresh);
 	struct inet_frag_queue *fq = NULL, *prev;
 
-	if (!high_thresh || frag_mem_limit(fqdir) > high_thresh)
+	if (!high_thresh || frag_mem_over_limit(fqdir, high_thresh))
 		return NULL;
 
 	rcu_read_lock();
@@ -1226,27 +1226,57 @@ int inet_hashinfo2_init_mod(struct inet_hashinfo *h)
 }
 EXPORT_SYMBOL_GPL(inet_hashinfo2_init_mod);
 
+/* Number of ehash locks per possible cpu, each on its own cache line.
+ * The default of 0 packs the locks densely, which is cheaper in memory but
+ * makes cpus inserting and removing unrelated connections bounce the same
+ * cache lines, showing up on servers setting up connections on all cpus.
+ */
+static unsigned int ehash_locks_per_cpu __ro_after_init;
+static int __init set_ehash_locks_per_cpu(char *str)
+{
+	ssize_t ret;
+
+	if (!str)
+		return 0;
+
+	ret = kstrtouint(str, 0, &ehash_locks_per_cpu);
+	if (ret)
+		return 0;
+
+	return 1;
+}
+__setup("ehash_locks_per_cpu=", set_ehash_locks_per_cpu);
+
 int inet_ehash_locks_alloc(struct inet_hashinfo *hashinfo)
 {
 	unsigned int locksz = sizeof(spinlock_t);
-	unsigned int i, nblocks = 1;
+	unsigned int i, nblocks = 1, shift = 0;
 
 	if (locksz != 0) {
-		/* allocate 2 cache lines or at least one spinlock per cpu */
-		nblocks = max(2U * L1_CACHE_BYTES / locksz, 1U);
+		if (ehash_locks_per_cpu) {
+			/* one cache line per lock, or more for large locks */
+			nblocks = ehash_locks_per_cpu;
+			shift = order_base_2(DIV_ROUND_UP(L1_CACHE_BYTES,
+							  locksz));
+		} else {
+			/* allocate 2 cache lines or at least one spinlock per cpu */
+			nblocks = max(2U * L1_CACHE_BYTES / locksz, 1U);
+		}
 		nblocks = roundup_pow_of_two(nblocks * num_possible_cpus());
 
 		/* no more locks than number of hash buckets */
 		nblocks = min(nblocks, hashinfo->ehash_mask + 1);
 
-		hashinfo->ehash_locks = kvmalloc_array(nblocks, locksz, GFP_KERNEL);
+		hashinfo->ehash_locks = kvmalloc_array(nblocks << shift, locksz,
+						       GFP_KERNEL);
 		if (!hashinfo->ehash_locks)
 			return -ENOMEM;
 
 		for (i = 0; i < nblocks; i++)
-			spin_lock_init(&hashinfo->ehash_locks[i]);
+			spin_lock_init(&hashinfo->ehash_locks[i << shift]);
 	}
 	hashinfo->ehash_locks_mask = nblocks - 1;
+	hashinfo->ehash_locks_shift = shift;
 	return 0;
 }
 EXPORT_SYMBOL_GPL(inet_ehash_locks_alloc);
@@ -84,14 +84,18 @@ void __init inet_initpeers(void)
 	peer_cachep = KMEM_CACHE(inet_peer, SLAB_HWCACHE_ALIGN | SLAB_PANIC);
 }
 
-/* Called with rcu_read_lock() or base->lock held */
+/* Called with rcu_read_lock() or base->lock held.
+ * Without 'ref' the entry is returned without taking a reference, it is
+ * then only valid until the caller leaves its RCU read side section.
+ */
 static struct inet_peer *lookup(const struct inetpeer_addr *daddr,
 				struct inet_peer_base *base,
 				unsigned int seq,
 				struct inet_peer *gc_stack[],
 				unsigned int *gc_cnt,
 				struct rb_node **parent_p,
-				struct rb_node ***pp_p)
+				struct rb_node ***pp_p,
+				bool ref)
 {
 	struct rb_node **pp, *parent, *next;
 	struct inet_peer *p;
@@ -108,7 +112,8 @@ static struct inet_peer *lookup(const struct inetpeer_addr *daddr,
 		p = rb_entry(parent, struct inet_peer, rb_node);
 		cmp = inetpeer_addr_cmp(daddr, &p->daddr);
 		if (cmp == 0) {
-			if (!refcount_inc_not_zero(&p->refcnt))
+			if (ref ? !refcount_inc_not_zero(&p->refcnt) :
+				  !refcount_read(&p->refcnt))
 				break;
 			return p;
 		}
@@ -173,9 +178,9 @@ static void inet_peer_gc(struct inet_peer_base *base,
 	}
 }
 
-struct inet_peer *inet_getpeer(struct inet_peer_base *base,
-			       const struct inetpeer_addr *daddr,
-			       int create)
+static struct inet_peer *__inet_getpeer(struct inet_peer_base *base,
+					const struct inetpeer_addr *daddr,
+					int create, bool ref)
 {
 	struct inet_peer *p, *gc_stack[PEER_MAX_GC];
 	struct rb_node **pp, *parent;
@@ -187,7 +192,7 @@ struct inet_peer *inet_getpeer(struct inet_peer_base *base,
 	 */
 	rcu_read_lock();
 	seq = read_seqbegin(&base->lock);
-	p = lookup(daddr, base, seq, NULL, &gc_cnt, &parent, &pp);
+	p = lookup(daddr, base, seq, NULL, &gc_cnt, &parent, &pp, ref);
 	invalidated = read_seqretry(&base->lock, seq);
 	rcu_read_unlock();
 
@@ -205,13 +210,13 @@ struct inet_peer *inet_getpeer(struct inet_peer_base *base,
 	write_seqlock_bh(&base->lock);
 
 	gc_cnt = 0;
-	p = lookup(daddr, base, seq, gc_stack, &gc_cnt, &parent, &pp);
+	p = lookup(daddr, base, seq, gc_stack, &gc_cnt, &parent, &pp, ref);
 	if (!p && create) {
 		p = kmem_cache_alloc(peer_cachep, GFP_ATOMIC);
 		if (p) {
 			p->daddr = *daddr;
 			p->dtime = (__u32)jiffies;
-			refcount_set(&p->refcnt, 2);
+			refcount_set(&p->refcnt, ref ? 2 : 1);
 			atomic_set(&p->rid, 0);
 			p->metrics[RTAX_LOCK-1] = INETPEER_METRICS_NEW;
 			p->rate_tokens = 0;
@@ -232,8 +237,40 @@ struct inet_peer *inet_getpeer(struct inet_peer_base *base,
 
 	return p;
 }
+
+struct inet_peer *inet_getpeer(struct inet_peer_base *base,
+			       const struct inetpeer_addr *daddr,
+			       int create)
+{
+	return __inet_getpeer(base, daddr, create, true);
+}
 EXPORT_SYMBOL_GPL(inet_getpeer);
 
+/*
+ * Same as inet_getpeer() but does not take a reference on the entry.
+ * Meant for short lived users such as rate limiters, that would otherwise
+ * bounce the refcount and dtime cache line between all cpus hitting the
+ * same peer.  Must be called under rcu_read_lock(); the entry goes away
+ * once the caller leaves the read side section.
+ */
+struct inet_peer *inet_getpeer_rcu(struct inet_peer_base *base,
+				   const struct inetpeer_addr *daddr,
+				   int create)
+{
+	struct inet_peer *p;
+	__u32 now;
+
+	p = __inet_getpeer(base, daddr, create, false);
+	if (p) {
+		/* what inet_putpeer() would have done, at most once a jiffy */
+		now = (__u32)jiffies;
+		if (READ_ONCE(p->dtime) != now)
+			WRITE_ONCE(p->dtime, now);
+	}
+	return p;
+}
+EXPORT_SYMBOL_GPL(inet_getpeer_rcu);
+
 void inet_putpeer(struct inet_peer *p)
 {
 	/* The WRITE_ONCE() pairs with itself (we run lockless)
@@ -266,23 +303,32 @@ EXPORT_SYMBOL_GPL(inet_putpeer);
 #define XRLIM_BURST_FACTOR 6
 bool inet_peer_xrlim_allow(struct inet_peer *peer, int timeout)
 {
-	unsigned long now, token;
+	unsigned long now, token, last;
 	bool rc = false;
 
 	if (!peer)
 		return true;
 
-	token = peer->rate_tokens;
+	token = READ_ONCE(peer->rate_tokens);
+	last = READ_ONCE(peer->rate_last);
 	now = jiffies;
-	token += now - peer->rate_last;
-	peer->rate_last = now;
+
+	/* Nothing was refilled since the last update and there is not
+	 * enough for one message: reject without dirtying the peer, so a
+	 * flood on many cpus only shares the cache line for reading.
+	 */
+	if (now == last && token < timeout)
+		return false;
+
+	token += now - last;
+	WRITE_ONCE(peer->rate_last, now);
 	if (token > XRLIM_BURST_FACTOR * timeout)
 		token = XRLIM_BURST_FACTOR * timeout;
 	if (token >= timeout) {
 		token -= timeout;
 		rc = true;
 	}
-	peer->rate_tokens = token;
+	WRITE_ONCE(peer->rate_tokens, token);
 	return rc;
 }
 EXPORT_SYMBOL(inet_peer_xrlim_allow);
@@ -65,6 +65,39 @@ static bool ip_tunnel_key_match(const struct ip_tunnel_parm_kern *p,
 	return test_bit(IP_TUNNEL_KEY_BIT, p->i_flags) && p->i_key == key;
 }
 
+/* Per-CPU cache of the exact (local, remote, key, link) matches found by the
+ * first pass of ip_tunnel_lookup().  ip_tunnel_find() keeps such a match
+ * unique and it outranks every other candidate, so a hit only has to
+ * recheck the cached tunnel itself.  ip_tunnel_del() bumps the generation
+ * before an unhashed tunnel can be freed.
+ */
+#define IP_TNL_CACHE_BITS	6
+
+struct ip_tunnel_cache_ent {
+	const struct ip_tunnel_net *itn;
+	struct ip_tunnel *t;
+	__be32 remote;
+	__be32 local;
+	__be32 key;
+	int link;
+	u64 gen;
+};
+
+static DEFINE_PER_CPU(struct ip_tunnel_cache_ent [1 << IP_TNL_CACHE_BITS],
+		      ip_tunnel_cache);
+static atomic64_t ip_tunnel_cache_gen = ATOMIC64_INIT(1);
+
+static bool ip_tunnel_exact_match(const struct ip_tunnel *t, int link,
+				  const unsigned long *flags,
+				  __be32 remote, __be32 local, __be32 key)
+{
+	return local == t->parms.iph.saddr &&
+	       remote == t->parms.iph.daddr &&
+	       (t->dev->flags & IFF_UP) &&
+	       ip_tunnel_key_match(&t->parms, flags, key) &&
+	       READ_ONCE(t->parms.link) == link;
+}
+
 /* Fallback tunnel: no source, no destination, no key, no options
 
    Tunnel hash table:
@@ -82,9 +115,21 @@ struct ip_tunnel *ip_tunnel_lookup(struct ip_tunnel_net *itn,
 				   __be32 key)
 {
 	struct ip_tunnel *t, *cand = NULL;
+	struct ip_tunnel_cache_ent *ent;
 	struct hlist_head *head;
 	struct net_device *ndev;
 	unsigned int hash;
+	u64 gen;
+
+	/* Pairs with ip_tunnel_del(), orders the walk after the read */
+	gen = atomic64_read_acquire(&ip_tunnel_cache_gen);
+	hash = hash_32((__force u32)(remote ^ local ^ key) ^ link,
+		       IP_TNL_CACHE_BITS);
+	ent = this_cpu_ptr(&ip_tunnel_cache[hash]);
+	if (ent->gen == gen && ent->itn == itn && ent->remote == remote &&
+	    ent->local == local && ent->key == key && ent->link == link &&
+	    ip_tunnel_exact_match(ent->t, link, flags, remote, local, key))
+		return ent->t;
 
 	hash = ip_tunnel_hash(key, remote);
 	head = &itn->tunnels[hash];
@@ -98,8 +143,16 @@ struct ip_tunnel *ip_tunnel_lookup(struct ip_tunnel_net *itn,
 		if (!ip_tunnel_key_match(&t->parms, flags, key))
 			continue;
 
-		if (READ_ONCE(t->parms.link) == link)
+		if (READ_ONCE(t->parms.link) == link) {
+			ent->itn = itn;
+			ent->t = t;
+			ent->remote = remote;
+			ent->local = local;
+			ent->key = key;
+			ent->link = link;
+			ent->gen = gen;
 			return t;
+		}
 		cand = t;
 	}
 
@@ -201,6 +254,9 @@ static void ip_tunnel_del(struct ip_tunnel_net *itn, struct ip_tunnel *t)
 	if (t->collect_md)
 		rcu_assign_pointer(itn->collect_md_tun, NULL);
 	hlist_del_init_rcu(&t->hash_node);
+	/* drop every cached lookup, t may be among them */
+	smp_mb__before_atomic();
+	atomic64_inc(&ip_tunnel_cache_gen);
 }
 
 static struct ip_tunnel *ip_tunnel_find(struct ip_tunnel_net *itn,
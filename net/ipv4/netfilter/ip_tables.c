@@ -218,6 +218,28 @@ struct ipt_entry *ipt_next_entry(const struct ipt_entry *entry)
 	return (void *)entry + entry->next_offset;
 }
 
+/* Large rulesets tend to come in long runs of rules for one protocol
+ * (-p tcp ... -p tcp ...), every one of which fails ip_packet_match()
+ * for a packet of another protocol. Once the table is checked, the low
+ * bits of comefrom keep the hook mask and its upper bits store, for each
+ * rule of such a run, the distance to the first rule after the run in
+ * 4 byte units, so a packet of another protocol skips the whole run.
+ * Runs are cut at chain boundaries since heads and policies match any
+ * protocol.
+ */
+#define IPT_SKIP_SHIFT		8
+#define IPT_SKIP_MAX		(UINT_MAX >> IPT_SKIP_SHIFT)
+
+static u8 ipt_proto_key(const struct ipt_entry *e)
+{
+	return e->ip.invflags & IPT_INV_PROTO ? 0 : e->ip.proto;
+}
+
+static inline unsigned int ipt_proto_skip(const struct ipt_entry *e)
+{
+	return (e->comefrom >> IPT_SKIP_SHIFT) << 2;
+}
+
 /* Returns one of the generic firewall policies, like NF_ACCEPT. */
 unsigned int
 ipt_do_table(void *priv,
@@ -280,6 +302,10 @@ ipt_do_table(void *priv,
 		struct xt_counters *counter;
 
 		WARN_ON(!e);
+		if (ipt_proto_skip(e) && e->ip.proto != ip->protocol) {
+			e = (void *)e + ipt_proto_skip(e);
+			continue;
+		}
 		if (!ip_packet_match(ip, indev, outdev,
 		    &e->ip, acpar.fragoff)) {
  no_match:
@@ -656,6 +682,31 @@ cleanup_entry(struct ipt_entry *e, struct net *net)
 
 /* Checks and translates the user-supplied table segment (held in
    newinfo) */
+static void set_proto_run_skip(struct ipt_entry *e, const void *end)
+{
+	for (; (void *)e < end; e = ipt_next_entry(e)) {
+		unsigned long dist = (end - (void *)e) >> 2;
+
+		if (dist <= IPT_SKIP_MAX)
+			e->comefrom |= dist << IPT_SKIP_SHIFT;
+	}
+}
+
+/* Must run after find_check_entry(), which passes comefrom as hook_mask */
+static void mark_proto_runs(struct xt_table_info *newinfo, void *entry0)
+{
+	struct ipt_entry *iter, *run = NULL;
+
+	xt_entry_foreach(iter, entry0, newinfo->size) {
+		if (run && ipt_proto_key(iter) == ipt_proto_key(run))
+			continue;
+		if (run)
+			set_proto_run_skip(run, iter);
+		run = ipt_proto_key(iter) ? iter : NULL;
+	}
+	/* A run reaching the end of the table is left alone */
+}
+
 static int
 translate_table(struct net *net, struct xt_table_info *newinfo, void *entry0,
 		const struct ipt_replace *repl)
@@ -729,6 +780,7 @@ translate_table(struct net *net, struct xt_table_info *newinfo, void *entry0,
 		return ret;
 	}
 
+	mark_proto_runs(newinfo, entry0);
 	return ret;
  out_free:
 	kvfree(offsets);
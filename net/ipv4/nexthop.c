@@ -1386,22 +1386,36 @@ static bool nexthop_is_good_nh(const struct nexthop *nh)
 	return false;
 }
 
-static struct nexthop *nexthop_select_path_fdb(struct nh_group *nhg, int hash)
+/* Upper bounds are nondecreasing and the last one covers the whole hash
+ * space, so the first entry whose range holds @hash can be bisected for
+ * rather than scanned for in large ECMP groups.
+ */
+static int nexthop_hthr_first_entry(struct nh_group *nhg, int hash)
 {
-	int i;
-
-	for (i = 0; i < nhg->num_nh; i++) {
-		struct nh_grp_entry *nhge = &nhg->nh_entries[i];
+	int lo = 0, hi = nhg->num_nh - 1;
 
-		if (hash > atomic_read(&nhge->hthr.upper_bound))
-			continue;
+	while (lo < hi) {
+		int mid = lo + (hi - lo) / 2;
 
-		nh_grp_entry_stats_inc(nhge);
-		return nhge->nh;
+		if (hash > atomic_read(&nhg->nh_entries[mid].hthr.upper_bound))
+			lo = mid + 1;
+		else
+			hi = mid;
 	}
 
-	WARN_ON_ONCE(1);
-	return NULL;
+	return lo;
+}
+
+static struct nexthop *nexthop_select_path_fdb(struct nh_group *nhg, int hash)
+{
+	struct nh_grp_entry *nhge;
+
+	nhge = &nhg->nh_entries[nexthop_hthr_first_entry(nhg, hash)];
+	if (WARN_ON_ONCE(hash > atomic_read(&nhge->hthr.upper_bound)))
+		return NULL;
+
+	nh_grp_entry_stats_inc(nhge);
+	return nhge->nh;
 }
 
 static struct nexthop *nexthop_select_path_hthr(struct nh_group *nhg, int hash)
@@ -1412,7 +1426,7 @@ static struct nexthop *nexthop_select_path_hthr(struct nh_group *nhg, int hash)
 	if (nhg->fdb_nh)
 		return nexthop_select_path_fdb(nhg, hash);
 
-	for (i = 0; i < nhg->num_nh; ++i) {
+	for (i = nexthop_hthr_first_entry(nhg, hash); i < nhg->num_nh; ++i) {
 		struct nh_grp_entry *nhge = &nhg->nh_entries[i];
 
 		/* nexthops always check if it is good and does
@@ -1421,16 +1435,18 @@ static struct nexthop *nexthop_select_path_hthr(struct nh_group *nhg, int hash)
 		if (!nexthop_is_good_nh(nhge->nh))
 			continue;
 
-		if (!nhge0)
-			nhge0 = nhge;
-
-		if (hash > atomic_read(&nhge->hthr.upper_bound))
-			continue;
-
 		nh_grp_entry_stats_inc(nhge);
 		return nhge->nh;
 	}
 
+	/* nothing usable from the hash onwards, take the first good one */
+	for (i = 0; i < nhg->num_nh; ++i) {
+		if (nexthop_is_good_nh(nhg->nh_entries[i].nh)) {
+			nhge0 = &nhg->nh_entries[i];
+			break;
+		}
+	}
+
 	if (!nhge0)
 		nhge0 = &nhg->nh_entries[0];
 	nh_grp_entry_stats_inc(nhge0);
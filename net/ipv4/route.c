@@ -975,21 +975,27 @@ static int ip_error(struct sk_buff *skb)
 		break;
 	}
 
-	peer = inet_getpeer_v4(net->ipv4.peers, ip_hdr(skb)->saddr,
-			       l3mdev_master_ifindex(skb->dev), 1);
+	/* called under rcu_read_lock() from the input path */
+	peer = inet_getpeer_v4_rcu(net->ipv4.peers, ip_hdr(skb)->saddr,
+				   l3mdev_master_ifindex(skb->dev), 1);
 
 	send = true;
 	if (peer) {
 		now = jiffies;
-		peer->rate_tokens += now - peer->rate_last;
-		if (peer->rate_tokens > ip_rt_error_burst)
-			peer->rate_tokens = ip_rt_error_burst;
-		peer->rate_last = now;
-		if (peer->rate_tokens >= ip_rt_error_cost)
-			peer->rate_tokens -= ip_rt_error_cost;
-		else
+		if (now == READ_ONCE(peer->rate_last) &&
+		    READ_ONCE(peer->rate_tokens) < ip_rt_error_cost) {
+			/* no refill yet, don't dirty the peer */
 			send = false;
-		inet_putpeer(peer);
+		} else {
+			peer->rate_tokens += now - peer->rate_last;
+			if (peer->rate_tokens > ip_rt_error_burst)
+				peer->rate_tokens = ip_rt_error_burst;
+			peer->rate_last = now;
+			if (peer->rate_tokens >= ip_rt_error_cost)
+				peer->rate_tokens -= ip_rt_error_cost;
+			else
+				send = false;
+		}
 	}
 	if (send)
 		icmp_send(skb, ICMP_DEST_UNREACH, code, 0);
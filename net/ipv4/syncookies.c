@@ -14,7 +14,7 @@
 #include <net/tcp.h>
 #include <net/route.h>
 
-static siphash_aligned_key_t syncookie_secret[2];
+static siphash_aligned_key_t syncookie_secret;
 
 #define COOKIEBITS 24	/* Upper bits store count */
 #define COOKIEMASK (((__u32)1 << COOKIEBITS) - 1)
@@ -42,13 +42,17 @@ static siphash_aligned_key_t syncookie_secret[2];
  */
 #define TSBITS	6
 
-static u32 cookie_hash(__be32 saddr, __be32 daddr, __be16 sport, __be16 dport,
-		       u32 count, int c)
+/* Both 32-bit halves of a single SipHash output are used, the low one to
+ * hide the count and the high one to authenticate count and data: this
+ * costs one SipHash per SYN-ACK sent, which is what a SYN flood exercises.
+ */
+static u64 cookie_hash(__be32 saddr, __be32 daddr, __be16 sport, __be16 dport,
+		       u32 count)
 {
-	net_get_random_once(syncookie_secret, sizeof(syncookie_secret));
+	net_get_random_once(&syncookie_secret, sizeof(syncookie_secret));
 	return siphash_4u32((__force u32)saddr, (__force u32)daddr,
 			    (__force u32)sport << 16 | (__force u32)dport,
-			    count, &syncookie_secret[c]);
+			    count, &syncookie_secret);
 }
 
 /*
@@ -86,19 +90,18 @@ static __u32 secure_tcp_syn_cookie(__be32 saddr, __be32 daddr, __be16 sport,
 {
 	/*
 	 * Compute the secure sequence number.
-	 * The output should be:
-	 *   HASH(sec1,saddr,sport,daddr,dport,sec1) + sseq + (count * 2^24)
-	 *      + (HASH(sec2,saddr,sport,daddr,dport,count,sec2) % 2^24).
+	 * With H = HASH(sec,saddr,sport,daddr,dport,count), the output is:
+	 *   LO32(H) + sseq + (count * 2^24) + (HI32(H) % 2^24).
 	 * Where sseq is their sequence number and count increases every
 	 * minute by 1.
 	 * As an extra hack, we add a small "data" value that encodes the
 	 * MSS into the second hash value.
 	 */
 	u32 count = tcp_cookie_time();
-	return (cookie_hash(saddr, daddr, sport, dport, 0, 0) +
-		sseq + (count << COOKIEBITS) +
-		((cookie_hash(saddr, daddr, sport, dport, count, 1) + data)
-		 & COOKIEMASK));
+	u64 hash = cookie_hash(saddr, daddr, sport, dport, count);
+
+	return (lower_32_bits(hash) + sseq + (count << COOKIEBITS) +
+		((upper_32_bits(hash) + data) & COOKIEMASK));
 }
 
 /*
@@ -109,23 +112,28 @@ static __u32 secure_tcp_syn_cookie(__be32 saddr, __be32 daddr, __be16 sport,
  * The count value used to generate the cookie must be less than
  * MAX_SYNCOOKIE_AGE minutes in the past.
  * The return value (__u32)-1 if this test fails.
+ *
+ * The count is hidden by a hash that covers it, so it can't be read
+ * back before hashing: a bogus cookie costs MAX_SYNCOOKIE_AGE hashes,
+ * where a cookie from the current period costs one.
  */
 static __u32 check_tcp_syn_cookie(__u32 cookie, __be32 saddr, __be32 daddr,
 				  __be16 sport, __be16 dport, __u32 sseq)
 {
 	u32 diff, count = tcp_cookie_time();
 
-	/* Strip away the layers from the cookie */
-	cookie -= cookie_hash(saddr, daddr, sport, dport, 0, 0) + sseq;
+	for (diff = 0; diff < MAX_SYNCOOKIE_AGE; diff++, count--) {
+		u64 hash = cookie_hash(saddr, daddr, sport, dport, count);
+		u32 val = cookie - lower_32_bits(hash) - sseq;
 
-	/* Cookie is now reduced to (count * 2^24) ^ (hash % 2^24) */
-	diff = (count - (cookie >> COOKIEBITS)) & ((__u32) -1 >> COOKIEBITS);
-	if (diff >= MAX_SYNCOOKIE_AGE)
-		return (__u32)-1;
+		/* Now reduced to (count * 2^24) + (hash % 2^24) + data */
+		if ((val >> COOKIEBITS) != (count & ((__u32)-1 >> COOKIEBITS)))
+			continue;
 
-	return (cookie -
-		cookie_hash(saddr, daddr, sport, dport, count - diff, 1))
-		& COOKIEMASK;	/* Leaving the data behind */
+		return (val - upper_32_bits(hash))
+			& COOKIEMASK;	/* Leaving the data behind */
+	}
+	return (__u32)-1;
 }
 
 /*
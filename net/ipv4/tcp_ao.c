@@ -547,12 +547,9 @@ int tcp_ao_hash_hdr(unsigned short int family, char *ao_hash,
 {
 	int tkey_len = tcp_ao_digest_size(key);
 	int hash_offset = ao_hash - (char *)th;
+	/* The pool only holds synchronous ahashes: no DMA into the digest */
+	u8 hash_buf[HASH_MAX_DIGESTSIZE];
 	struct tcp_sigpool hp;
-	void *hash_buf = NULL;
-
-	hash_buf = kmalloc(tkey_len, GFP_ATOMIC);
-	if (!hash_buf)
-		goto clear_hash_noput;
 
 	if (tcp_sigpool_start(key->tcp_sigpool_id, &hp))
 		goto clear_hash_noput;
@@ -589,14 +586,12 @@ int tcp_ao_hash_hdr(unsigned short int family, char *ao_hash,
 
 	memcpy(ao_hash, hash_buf, tcp_ao_maclen(key));
 	tcp_sigpool_end(&hp);
-	kfree(hash_buf);
 	return 0;
 
 clear_hash:
 	tcp_sigpool_end(&hp);
 clear_hash_noput:
 	memset(ao_hash, 0, tcp_ao_maclen(key));
-	kfree(hash_buf);
 	return 1;
 }
 
@@ -607,12 +602,8 @@ int tcp_ao_hash_skb(unsigned short int family,
 {
 	const struct tcphdr *th = tcp_hdr(skb);
 	int tkey_len = tcp_ao_digest_size(key);
+	u8 hash_buf[HASH_MAX_DIGESTSIZE];
 	struct tcp_sigpool hp;
-	void *hash_buf = NULL;
-
-	hash_buf = kmalloc(tkey_len, GFP_ATOMIC);
-	if (!hash_buf)
-		goto clear_hash_noput;
 
 	if (tcp_sigpool_start(key->tcp_sigpool_id, &hp))
 		goto clear_hash_noput;
@@ -640,14 +631,12 @@ int tcp_ao_hash_skb(unsigned short int family,
 
 	memcpy(ao_hash, hash_buf, tcp_ao_maclen(key));
 	tcp_sigpool_end(&hp);
-	kfree(hash_buf);
 	return 0;
 
 clear_hash:
 	tcp_sigpool_end(&hp);
 clear_hash_noput:
 	memset(ao_hash, 0, tcp_ao_maclen(key));
-	kfree(hash_buf);
 	return 1;
 }
 
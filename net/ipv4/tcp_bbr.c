@@ -100,7 +100,7 @@ struct bbr {
 		round_start:1,	     /* start of packet-timed tx->ack round? */
 		idle_restart:1,	     /* restarting after idle? */
 		probe_rtt_round_done:1,  /* a BBR_PROBE_RTT round at 4 pkts? */
-		unused:13,
+		round_lost:13,	     /* packets lost in this round (saturated) */
 		lt_is_sampling:1,    /* taking long-term ("LT") samples now? */
 		lt_rtt_cnt:7,	     /* round trips in long-term interval */
 		lt_use_bw:1;	     /* use lt_bw as our bw estimate? */
@@ -124,7 +124,7 @@ struct bbr {
 	u32	ack_epoch_acked:20,	/* packets (S)ACKed in sampling epoch */
 		extra_acked_win_rtts:5,	/* age of extra_acked, in round trips */
 		extra_acked_win_idx:1,	/* current index in extra_acked array */
-		unused_c:6;
+		inflight_hi:6;		/* loss bound on cwnd, in BDP/16 units */
 };
 
 #define CYCLE_LEN	8	/* number of phases in a pacing gain cycle */
@@ -201,6 +201,26 @@ static const u32 bbr_ack_epoch_acked_reset_thresh = 1U << 20;
 /* Time period for clamping cwnd increment due to ack aggregation */
 static const u32 bbr_extra_acked_max_us = 100 * 1000;
 
+/* Loss-aware bound on inflight, enabled by the loss_thresh parameter: a round
+ * losing more than loss_thresh percent of its packets caps cwnd to bbr_beta
+ * times the inflight that caused it, which avoids repeated loss episodes on
+ * shallow-buffered bottlenecks that BBR's bw and min_rtt model cannot see.
+ * The cap is kept in units of 1/16th of the estimated BDP, never below one
+ * BDP so the pipe stays full, and is raised by 1/16th each lossless round.
+ */
+static int loss_thresh __read_mostly;
+module_param(loss_thresh, int, 0644);
+MODULE_PARM_DESC(loss_thresh, "percent of a round's packets lost to bound inflight (0: off)");
+
+#define BBR_HI_SHIFT	4			/* inflight_hi units: BDP / 16 */
+#define BBR_HI_MIN	(1 << BBR_HI_SHIFT)	/* never cap below one BDP */
+#define BBR_HI_NONE	63			/* inflight_hi: no bound */
+/* Multiplicative cut of inflight upon a lossy round: */
+static const u32 bbr_beta = BBR_UNIT * 7 / 10;
+/* Rounds with fewer losses than this carry too little signal: */
+static const u32 bbr_loss_min_pkts = 3;
+#define BBR_ROUND_LOST_MAX	((1U << 13) - 1)
+
 static void bbr_check_probe_rtt_done(struct sock *sk);
 
 /* Do we estimate that STARTUP filled the pipe? */
@@ -227,6 +247,17 @@ static u32 bbr_bw(const struct sock *sk)
 	return bbr->lt_use_bw ? bbr->lt_bw : bbr_max_bw(sk);
 }
 
+/* Return the cwnd gain to use, capped by the loss-aware inflight bound. */
+static int bbr_bound_gain(const struct sock *sk, int gain)
+{
+	const struct bbr *bbr = inet_csk_ca(sk);
+
+	if (bbr->inflight_hi == BBR_HI_NONE)
+		return gain;
+	return min_t(int, gain,
+		     bbr->inflight_hi << (BBR_SCALE - BBR_HI_SHIFT));
+}
+
 /* Return maximum extra acked in past k-2k round trips,
  * where k = bbr_extra_acked_win_rtts.
  */
@@ -529,7 +560,7 @@ static void bbr_set_cwnd(struct sock *sk, const struct rate_sample *rs,
 	if (bbr_set_cwnd_to_recover_or_restore(sk, rs, acked, &cwnd))
 		goto done;
 
-	target_cwnd = bbr_bdp(sk, bw, gain);
+	target_cwnd = bbr_bdp(sk, bw, bbr_bound_gain(sk, gain));
 
 	/* Increment the cwnd to account for excess ACKed data that seems
 	 * due to aggregation (of data and/or ACKs) visible in the ACK stream.
@@ -757,6 +788,40 @@ static void bbr_lt_bw_sampling(struct sock *sk, const struct rate_sample *rs)
 	bbr_lt_bw_interval_done(sk, bw);
 }
 
+/* At the end of each round, see whether it lost too much to be sustainable.
+ * A lossy round in STARTUP means the pipe is full, even if bw still grows.
+ */
+static void bbr_check_loss_round(struct sock *sk, u32 delivered)
+{
+	struct tcp_sock *tp = tcp_sk(sk);
+	struct bbr *bbr = inet_csk_ca(sk);
+	u32 lost = bbr->round_lost, thresh = READ_ONCE(loss_thresh);
+	u32 bdp, hi;
+
+	bbr->round_lost = 0;
+	if (!thresh || !delivered)
+		return;
+
+	if (lost < bbr_loss_min_pkts ||
+	    (u64)lost * 100 <= (u64)thresh * (lost + delivered)) {
+		/* Lossless round: probe for more inflight, gently. */
+		if (bbr->inflight_hi != BBR_HI_NONE &&
+		    bbr->mode == BBR_PROBE_BW &&
+		    ++bbr->inflight_hi << (BBR_SCALE - BBR_HI_SHIFT) >=
+		    bbr_cwnd_gain)
+			bbr->inflight_hi = BBR_HI_NONE;
+		return;
+	}
+
+	bbr->full_bw_reached = 1;
+	bdp = bbr_bdp(sk, bbr_max_bw(sk), BBR_UNIT);
+	if (!bdp)
+		return;
+	hi = div_u64((u64)tcp_snd_cwnd(tp) * bbr_beta <<
+		     BBR_HI_SHIFT >> BBR_SCALE, bdp);
+	bbr->inflight_hi = clamp_t(u32, hi, BBR_HI_MIN, BBR_HI_NONE - 1);
+}
+
 /* Estimate the bandwidth based on how fast packets are delivered */
 static void bbr_update_bw(struct sock *sk, const struct rate_sample *rs)
 {
@@ -765,11 +830,16 @@ static void bbr_update_bw(struct sock *sk, const struct rate_sample *rs)
 	u64 bw;
 
 	bbr->round_start = 0;
+	if (rs->losses > 0)
+		bbr->round_lost = min_t(u32, bbr->round_lost + rs->losses,
+					BBR_ROUND_LOST_MAX);
 	if (rs->delivered < 0 || rs->interval_us <= 0)
 		return; /* Not a valid observation */
 
 	/* See if we've reached the next RTT */
 	if (!before(rs->prior_delivered, bbr->next_rtt_delivered)) {
+		bbr_check_loss_round(sk, tp->delivered -
+					 bbr->next_rtt_delivered);
 		bbr->next_rtt_delivered = tp->delivered;
 		bbr->rtt_cnt++;
 		bbr->round_start = 1;
@@ -1075,6 +1145,9 @@ __bpf_kfunc static void bbr_init(struct sock *sk)
 	bbr->extra_acked[0] = 0;
 	bbr->extra_acked[1] = 0;
 
+	bbr->round_lost = 0;
+	bbr->inflight_hi = BBR_HI_NONE;
+
 	cmpxchg(&sk->sk_pacing_status, SK_PACING_NONE, SK_PACING_NEEDED);
 }
 
@@ -77,6 +77,7 @@ int tcp_fastopen_reset_cipher(struct net *net, struct sock *sk,
 	} else {
 		ctx->num = 1;
 	}
+	ctx->stamp = jiffies;
 
 	if (sk) {
 		q = &inet_csk(sk)->icsk_accept_queue.fastopenq;
@@ -147,6 +148,42 @@ static bool __tcp_fastopen_cookie_gen_cipher(struct request_sock *req,
 	return false;
 }
 
+/* With tcp_fastopen_key_rotate_secs set, the per-netns primary key is
+ * replaced by a fresh random one once it gets that old, and demoted to
+ * backup so that cookies handed out with it keep validating for one more
+ * period. This is done lazily by the first cookie generation to notice,
+ * and only when no listener-specific key is in use. Losing the race to
+ * another CPU simply keeps the winner's context.
+ */
+static struct tcp_fastopen_context *
+tcp_fastopen_maybe_rotate(struct net *net, struct tcp_fastopen_context *ctx)
+{
+	unsigned int secs = READ_ONCE(net->ipv4.sysctl_tcp_fastopen_key_rotate_secs);
+	struct tcp_fastopen_context *nctx;
+
+	if (likely(!secs) || time_before(jiffies, ctx->stamp + secs * HZ))
+		return ctx;
+
+	nctx = kmalloc(sizeof(*nctx), GFP_ATOMIC);
+	if (!nctx)
+		return ctx;
+
+	get_random_bytes(&nctx->key[0], sizeof(nctx->key[0]));
+	nctx->key[1] = ctx->key[0];
+	nctx->num = 2;
+	nctx->stamp = jiffies;
+
+	if (unrcu_pointer(cmpxchg(&net->ipv4.tcp_fastopen_ctx,
+				  RCU_INITIALIZER(ctx),
+				  RCU_INITIALIZER(nctx))) != ctx) {
+		kfree_sensitive(nctx);
+		return rcu_dereference(net->ipv4.tcp_fastopen_ctx) ? : ctx;
+	}
+
+	call_rcu(&ctx->rcu, tcp_fastopen_ctx_free);
+	return nctx;
+}
+
 /* Generate the fastopen cookie by applying SipHash to both the source and
  * destination addresses.
  */
@@ -158,7 +195,12 @@ static void tcp_fastopen_cookie_gen(struct sock *sk,
 	struct tcp_fastopen_context *ctx;
 
 	rcu_read_lock();
-	ctx = tcp_fastopen_get_ctx(sk);
+	ctx = rcu_dereference(inet_csk(sk)->icsk_accept_queue.fastopenq.ctx);
+	if (!ctx) {
+		ctx = rcu_dereference(sock_net(sk)->ipv4.tcp_fastopen_ctx);
+		if (ctx)
+			ctx = tcp_fastopen_maybe_rotate(sock_net(sk), ctx);
+	}
 	if (ctx)
 		__tcp_fastopen_cookie_gen_cipher(req, syn, &ctx->key[0], foc);
 	rcu_read_unlock();
@@ -1754,6 +1754,22 @@ static struct sk_buff *tcp_sacktag_walk(struct sk_buff *skb, struct sock *sk,
 		 * shifting can eat and free both this skb and the next,
 		 * so not even _safe variant of the loop is enough.
 		 */
+		if (in_sack <= 0 && !dup_sack &&
+		    (TCP_SKB_CB(skb)->sacked & TCPCB_SACKED_ACKED) &&
+		    !before(TCP_SKB_CB(skb)->seq, start_seq) &&
+		    !after(TCP_SKB_CB(skb)->end_seq, end_seq)) {
+			/* Already SACKed by an earlier ACK, as happens for
+			 * every skb of a block that recv_sack_cache can't
+			 * cover: tagging it again would be a no-op, it only
+			 * gets a chance to be collapsed into prev.
+			 */
+			tmp = tcp_shift_skb_data(sk, skb, state,
+						 start_seq, end_seq, false);
+			if (tmp)
+				skb = tmp;
+			continue;
+		}
+
 		if (in_sack <= 0) {
 			tmp = tcp_shift_skb_data(sk, skb, state,
 						 start_seq, end_seq, dup_sack);
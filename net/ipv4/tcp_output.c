@@ -2559,19 +2559,31 @@ static int tcp_mtu_probe(struct sock *sk)
 	return -1;
 }
 
+/* With tcp_pacing_train_us set, skbs whose departure time falls within
+ * that horizon are sent right away, carrying their EDT in skb->tstamp,
+ * and the pacing timer fires once per train instead of once per skb.
+ */
+static u64 tcp_pacing_train_ns(const struct sock *sk)
+{
+	return (u64)READ_ONCE(sock_net(sk)->ipv4.sysctl_tcp_pacing_train_us) *
+	       NSEC_PER_USEC;
+}
+
 static bool tcp_pacing_check(struct sock *sk)
 {
 	struct tcp_sock *tp = tcp_sk(sk);
+	u64 train_ns;
 
 	if (!tcp_needs_internal_pacing(sk))
 		return false;
 
-	if (tp->tcp_wstamp_ns <= tp->tcp_clock_cache)
+	train_ns = tcp_pacing_train_ns(sk);
+	if (tp->tcp_wstamp_ns <= tp->tcp_clock_cache + train_ns)
 		return false;
 
 	if (!hrtimer_is_queued(&tp->pacing_timer)) {
 		hrtimer_start(&tp->pacing_timer,
-			      ns_to_ktime(tp->tcp_wstamp_ns),
+			      ns_to_ktime(tp->tcp_wstamp_ns - train_ns),
 			      HRTIMER_MODE_ABS_PINNED_SOFT);
 		sock_hold(sk);
 	}
@@ -2614,6 +2626,15 @@ static bool tcp_small_queue_check(struct sock *sk, const struct sk_buff *skb,
 			      READ_ONCE(sock_net(sk)->ipv4.sysctl_tcp_limit_output_bytes));
 	limit <<= factor;
 
+	/* Leave room for a whole pacing train in qdisc/device queues */
+	if (tcp_needs_internal_pacing(sk)) {
+		u64 train_ns = tcp_pacing_train_ns(sk);
+
+		if (train_ns)
+			limit += div64_u64((u64)READ_ONCE(sk->sk_pacing_rate) *
+					   train_ns, NSEC_PER_SEC);
+	}
+
 	if (static_branch_unlikely(&tcp_tx_delay_enabled) &&
 	    tcp_sk(sk)->tcp_tx_delay) {
 		u64 extra_bytes = (u64)READ_ONCE(sk->sk_pacing_rate) *
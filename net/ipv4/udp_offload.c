@@ -601,6 +601,45 @@ struct sk_buff *udp_gro_receive(struct list_head *head, struct sk_buff *skb,
 }
 EXPORT_SYMBOL(udp_gro_receive);
 
+/* Under a high rate of datagrams from one peer, the packets of a train
+ * mostly land on top of a segment GRO candidate held for the very same
+ * 4-tuple. The socket lookup already took the aggregation decision for
+ * that tuple, so reuse it rather than walking the UDP hash tables again
+ * for every datagram: this is what makes GRO affordable for unconnected
+ * sockets, which otherwise pay the two-stage wildcard lookup twice per
+ * packet. A concurrent socket table change is caught at delivery time by
+ * udp_unexpected_gso(), as it already is for the races with a lookup.
+ */
+static struct sk_buff *udp_gro_held_segment(struct list_head *head,
+					    struct sk_buff *skb,
+					    struct udphdr *uh)
+{
+	unsigned int off = skb_gro_offset(skb);
+	struct udphdr *uh2;
+	struct sk_buff *p;
+
+	if (skb->encapsulation || NAPI_GRO_CB(skb)->encap_mark)
+		return NULL;
+
+	list_for_each_entry(p, head, list) {
+		if (!NAPI_GRO_CB(p)->same_flow)
+			continue;
+
+		uh2 = (struct udphdr *)(p->data + off);
+		if (*(u32 *)&uh->source != *(u32 *)&uh2->source)
+			continue;
+
+		/* Held by a tunnel gro_receive handler, must go there again.
+		 * fou and gue clear encap_mark but leave is_fou behind.
+		 */
+		if (NAPI_GRO_CB(p)->encap_mark || NAPI_GRO_CB(p)->is_fou)
+			return NULL;
+
+		return p;
+	}
+	return NULL;
+}
+
 static struct sock *udp4_gro_lookup_skb(struct sk_buff *skb, __be16 sport,
 					__be16 dport)
 {
@@ -620,7 +659,7 @@ struct sk_buff *udp4_gro_receive(struct list_head *head, struct sk_buff *skb)
 {
 	struct udphdr *uh = udp_gro_udphdr(skb);
 	struct sock *sk = NULL;
-	struct sk_buff *pp;
+	struct sk_buff *pp, *p;
 
 	if (unlikely(!uh))
 		goto flush;
@@ -638,8 +677,14 @@ struct sk_buff *udp4_gro_receive(struct list_head *head, struct sk_buff *skb)
 skip:
 	NAPI_GRO_CB(skb)->is_ipv6 = 0;
 
-	if (static_branch_unlikely(&udp_encap_needed_key))
+	if (static_branch_unlikely(&udp_encap_needed_key)) {
+		p = udp_gro_held_segment(head, skb, uh);
+		if (p) {
+			NAPI_GRO_CB(skb)->is_flist = NAPI_GRO_CB(p)->is_flist;
+			return call_gro_receive(udp_gro_receive_segment, head, skb);
+		}
 		sk = udp4_gro_lookup_skb(skb, uh->source, uh->dest);
+	}
 
 	pp = udp_gro_receive(head, skb, uh, sk);
 	return pp;
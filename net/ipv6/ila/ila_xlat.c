@@ -1,4 +1,5 @@
 // SPDX-License-Identifier: GPL-2.0
+#include <linux/hash.h>
 #include <linux/jhash.h>
 #include <linux/netfilter.h>
 #include <linux/rcupdate.h>
@@ -21,6 +22,23 @@ struct ila_map {
 	struct rcu_head rcu;
 };
 
+/* Per-CPU direct mapped cache of recent lookups, misses included. An entry
+ * is only valid while its generation matches the table's, so any mapping
+ * change drops the whole cache before the old ila_map can be freed.
+ */
+#define ILA_CACHE_BITS 6
+
+struct ila_cache_ent {
+	__be64 loc;
+	int ifindex;
+	u64 gen;
+	struct ila_map *ila;
+};
+
+struct ila_xlat_cache {
+	struct ila_cache_ent ent[1 << ILA_CACHE_BITS];
+};
+
 #define MAX_LOCKS 1024
 #define	LOCKS_PER_CPU 10
 
@@ -140,6 +158,37 @@ static inline struct ila_map *ila_lookup_wildcards(struct ila_addr *iaddr,
 	return NULL;
 }
 
+/* Must be called with rcu readlock and BHs disabled */
+static struct ila_map *ila_lookup_cached(struct ila_addr *iaddr, int ifindex,
+					 struct ila_net *ilan)
+{
+	/* pairs with ila_cache_flush(), orders the lookup after the read */
+	u64 gen = atomic64_read_acquire(&ilan->xlat.gen);
+	struct ila_cache_ent *ent;
+
+	ent = &this_cpu_ptr(ilan->xlat.cache)->ent[
+		hash_64((__force u64)iaddr->loc.v64 ^ ifindex, ILA_CACHE_BITS)];
+	if (ent->gen == gen && ent->loc == iaddr->loc.v64 &&
+	    ent->ifindex == ifindex)
+		return ent->ila;
+
+	ent->ila = ila_lookup_wildcards(iaddr, ifindex, ilan);
+	ent->loc = iaddr->loc.v64;
+	ent->ifindex = ifindex;
+	ent->gen = gen;
+
+	return ent->ila;
+}
+
+/* Invalidate all cached lookups, called with the bucket lock held after the
+ * table has been changed and before any unlinked ila_map is released.
+ */
+static inline void ila_cache_flush(struct ila_net *ilan)
+{
+	smp_mb__before_atomic();
+	atomic64_inc(&ilan->xlat.gen);
+}
+
 /* Must be called with rcu readlock */
 static inline struct ila_map *ila_lookup_by_params(struct ila_xlat_params *xp,
 						   struct ila_net *ilan)
@@ -271,6 +320,8 @@ static int ila_add_mapping(struct net *net, struct ila_xlat_params *xp)
 	}
 
 out:
+	if (!err)
+		ila_cache_flush(ilan);
 	spin_unlock(lock);
 
 	if (err)
@@ -330,6 +381,7 @@ static int ila_del_mapping(struct net *net, struct ila_xlat_params *xp)
 			}
 		}
 
+		ila_cache_flush(ilan);
 		ila_release(ila);
 
 		break;
@@ -405,8 +457,10 @@ int ila_xlat_nl_cmd_flush(struct sk_buff *skb, struct genl_info *info)
 
 		ret = rhashtable_remove_fast(&ilan->xlat.rhash_table,
 					     &ila->node, rht_params);
-		if (!ret)
+		if (!ret) {
+			ila_cache_flush(ilan);
 			ila_free_node(ila);
+		}
 
 		spin_unlock(lock);
 
@@ -610,8 +664,16 @@ int ila_xlat_init_net(struct net *net)
 	if (err)
 		return err;
 
+	ilan->xlat.cache = alloc_percpu(struct ila_xlat_cache);
+	if (!ilan->xlat.cache) {
+		free_bucket_spinlocks(ilan->xlat.locks);
+		return -ENOMEM;
+	}
+	atomic64_set(&ilan->xlat.gen, 1);
+
 	err = rhashtable_init(&ilan->xlat.rhash_table, &rht_params);
 	if (err) {
+		free_percpu(ilan->xlat.cache);
 		free_bucket_spinlocks(ilan->xlat.locks);
 		return err;
 	}
@@ -630,6 +692,8 @@ void ila_xlat_exit_net(struct net *net)
 	if (ilan->xlat.hooks_registered)
 		nf_unregister_net_hooks(net, ila_nf_hook_ops,
 					ARRAY_SIZE(ila_nf_hook_ops));
+
+	free_percpu(ilan->xlat.cache);
 }
 
 static int ila_xlat_addr(struct sk_buff *skb, bool sir2ila)
@@ -648,11 +712,13 @@ static int ila_xlat_addr(struct sk_buff *skb, bool sir2ila)
 	 */
 
 	rcu_read_lock();
+	local_bh_disable();
 
-	ila = ila_lookup_wildcards(iaddr, skb->dev->ifindex, ilan);
+	ila = ila_lookup_cached(iaddr, skb->dev->ifindex, ilan);
 	if (ila)
 		ila_update_ipv6_locator(skb, &ila->xp.ip, sir2ila);
 
+	local_bh_enable();
 	rcu_read_unlock();
 
 	return 0;
@@ -85,6 +85,7 @@ struct htable {
 	u8 htable_bits;		/* size of hash table == 2^htable_bits */
 	u32 maxelem;		/* Maxelem per region */
 	struct ip_set_region *hregion;	/* Region locks and ext sizes */
+	unsigned long *pfilter;	/* Probe filter, for types with nets */
 	struct hbucket __rcu *bucket[]; /* hashtable buckets */
 };
 
@@ -126,6 +127,19 @@ htable_size(u8 hbits)
 #define __CIDR(cidr, i)		(cidr)
 #endif
 
+/* Testing an address probes the hash once per prefix length in the set,
+ * and for most of them there is nothing to find. The probe filter keeps
+ * one bit per hash value of all stored elements, on HPFILTER_EXTRA more
+ * bits than the bucket index, so that most of the probes are answered
+ * by a single bit in a table a quarter of the size of the bucket array,
+ * reusing the hash computed for the bucket index. Deleted and expired
+ * elements leave their bit set until the next resize or flush.
+ */
+#define HPFILTER_EXTRA		4
+#define HPFILTER_BITS(hbits)	min_t(u8, (hbits) + HPFILTER_EXTRA, 31)
+#define hpfilter_size(hbits)	\
+	(BITS_TO_LONGS(jhash_size(HPFILTER_BITS(hbits))) * sizeof(unsigned long))
+
 /* cidr + 1 is stored in net_prefixes to support /0 */
 #define NCIDR_PUT(cidr)		((cidr) + 1)
 #define NCIDR_GET(cidr)		((cidr) - 1)
@@ -375,7 +389,13 @@ mtype_del_cidr(struct ip_set *set, struct htype *h, u8 cidr, u8 n)
 static size_t
 mtype_ahash_memsize(const struct htype *h, const struct htable *t)
 {
-	return sizeof(*h) + sizeof(*t) + ahash_sizeof_regions(t->htable_bits);
+	size_t memsize = sizeof(*h) + sizeof(*t) +
+			 ahash_sizeof_regions(t->htable_bits);
+
+#ifdef IP_SET_HASH_WITH_NETS
+	memsize += hpfilter_size(t->htable_bits);
+#endif
+	return memsize;
 }
 
 /* Get the ith element from the array block n */
@@ -402,6 +422,10 @@ mtype_flush(struct ip_set *set)
 	u32 r, i;
 
 	t = ipset_dereference_nfnl(h->table);
+#ifdef IP_SET_HASH_WITH_NETS
+	/* Before the regions: a concurrent add is either flushed or kept */
+	memset(t->pfilter, 0, hpfilter_size(t->htable_bits));
+#endif
 	for (r = 0; r < ahash_numof_locks(t->htable_bits); r++) {
 		spin_lock_bh(&t->hregion[r].lock);
 		for (i = ahash_bucket_start(r, t->htable_bits);
@@ -441,6 +465,7 @@ mtype_ahash_destroy(struct ip_set *set, struct htable *t, bool ext_destroy)
 		kfree(n);
 	}
 
+	ip_set_free(t->pfilter);
 	ip_set_free(t->hregion);
 	ip_set_free(t);
 }
@@ -614,9 +639,11 @@ static int
 mtype_del(struct ip_set *set, void *value, const struct ip_set_ext *ext,
 	  struct ip_set_ext *mext, u32 flags);
 
-/* Resize a hash: create a new hash table with doubling the hashsize
- * and inserting the elements to it. Repeat until we succeed or
- * fail due to memory pressures.
+/* Resize a hash: create a new hash table with at least doubling the
+ * hashsize and inserting the elements to it. Repeat until we succeed or
+ * fail due to memory pressures. Growing sets jump straight to a size
+ * where buckets mostly fit into their initial array block, so loading a
+ * large set takes a few resizes instead of one per doubling.
  */
 static int
 mtype_resize(struct ip_set *set, bool retried)
@@ -634,7 +661,7 @@ mtype_resize(struct ip_set *set, bool retried)
 	struct hbucket *n, *m;
 	struct list_head *l, *lt;
 	struct mtype_resize_ad *x;
-	u32 i, j, r, nr, key;
+	u32 i, j, r, nr, key, elements = 0;
 	int ret;
 
 #ifdef IP_SET_HASH_WITH_NETS
@@ -644,6 +671,11 @@ mtype_resize(struct ip_set *set, bool retried)
 #endif
 	orig = ipset_dereference_bh_nfnl(h->table);
 	htable_bits = orig->htable_bits;
+	for (r = 0; r < ahash_numof_locks(htable_bits); r++)
+		elements += orig->hregion[r].elements;
+	elements = DIV_ROUND_UP(elements, AHASH_INIT_SIZE);
+	if (htable_bits < 31 && elements > jhash_size(htable_bits + 1))
+		htable_bits = min_t(u32, order_base_2(elements), 31) - 1;
 
 retry:
 	ret = 0;
@@ -664,6 +696,15 @@ mtype_resize(struct ip_set *set, bool retried)
 		ret = -ENOMEM;
 		goto out;
 	}
+#ifdef IP_SET_HASH_WITH_NETS
+	t->pfilter = ip_set_alloc(hpfilter_size(htable_bits));
+	if (!t->pfilter) {
+		ip_set_free(t->hregion);
+		ip_set_free(t);
+		ret = -ENOMEM;
+		goto out;
+	}
+#endif
 	t->htable_bits = htable_bits;
 	t->maxelem = h->maxelem / ahash_numof_locks(htable_bits);
 	for (i = 0; i < ahash_numof_locks(htable_bits); i++)
@@ -699,8 +740,13 @@ mtype_resize(struct ip_set *set, bool retried)
 				memcpy(tmp, data, dsize);
 				data = tmp;
 				mtype_data_reset_flags(data, &flags);
-#endif
+				key = HKEY(data, h->initval,
+					   HPFILTER_BITS(htable_bits));
+				set_bit(key, t->pfilter);
+				key &= jhash_mask(htable_bits);
+#else
 				key = HKEY(data, h->initval, htable_bits);
+#endif
 				m = __ipset_dereference(hbucket(t, key));
 				nr = ahash_region(key, htable_bits);
 				if (!m) {
@@ -848,10 +894,18 @@ mtype_add(struct ip_set *set, void *value, const struct ip_set_ext *ext,
 	bool flag_exist = flags & IPSET_FLAG_EXIST;
 	bool deleted = false, forceadd = false, reuse = false;
 	u32 r, key, multi = 0, elements, maxelem;
+#ifdef IP_SET_HASH_WITH_NETS
+	u32 hash;
+#endif
 
 	rcu_read_lock_bh();
 	t = rcu_dereference_bh(h->table);
+#ifdef IP_SET_HASH_WITH_NETS
+	hash = HKEY(value, h->initval, HPFILTER_BITS(t->htable_bits));
+	key = hash & jhash_mask(t->htable_bits);
+#else
 	key = HKEY(value, h->initval, t->htable_bits);
+#endif
 	r = ahash_region(key, t->htable_bits);
 	atomic_inc(&t->uref);
 	elements = t->hregion[r].elements;
@@ -969,6 +1023,7 @@ mtype_add(struct ip_set *set, void *value, const struct ip_set_ext *ext,
 #ifdef IP_SET_HASH_WITH_NETS
 	for (i = 0; i < IPSET_NET_COUNT; i++)
 		mtype_add_cidr(set, h, NCIDR_PUT(DCIDR_GET(d->cidr, i)), i);
+	set_bit(hash, t->pfilter);
 #endif
 	memcpy(data, d, sizeof(struct mtype_elem));
 overwrite_extensions:
@@ -1184,7 +1239,10 @@ mtype_test_cidrs(struct ip_set *set, struct mtype_elem *d,
 #else
 		mtype_data_netmask(d, NCIDR_GET(h->nets[j].cidr[0]));
 #endif
-		key = HKEY(d, h->initval, t->htable_bits);
+		key = HKEY(d, h->initval, HPFILTER_BITS(t->htable_bits));
+		if (!test_bit(key, t->pfilter))
+			continue;
+		key &= jhash_mask(t->htable_bits);
 		n = rcu_dereference_bh(hbucket(t, key));
 		if (!n)
 			continue;
@@ -1576,6 +1634,15 @@ IPSET_TOKEN(HTYPE, _create)(struct net *net, struct ip_set *set,
 		kfree(h);
 		return -ENOMEM;
 	}
+#ifdef IP_SET_HASH_WITH_NETS
+	t->pfilter = ip_set_alloc(hpfilter_size(hbits));
+	if (!t->pfilter) {
+		ip_set_free(t->hregion);
+		ip_set_free(t);
+		kfree(h);
+		return -ENOMEM;
+	}
+#endif
 	h->gc.set = set;
 	for (i = 0; i < ahash_numof_locks(hbits); i++)
 		spin_lock_init(&t->hregion[i].lock);
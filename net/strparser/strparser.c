@@ -291,8 +291,12 @@ static int __strp_recv(read_descriptor_t *desc, struct sk_buff *orig_skb,
 
 		eaten += (cand_len - extra);
 
-		/* Hurray, we have a new message! */
-		cancel_delayed_work(&strp->msg_timer_work);
+		/* Hurray, we have a new message! A message that was
+		 * framed entirely from this skb never armed the RX timer,
+		 * so only cancel it for messages that were accumulated.
+		 */
+		if (stm->accum_len)
+			cancel_delayed_work(&strp->msg_timer_work);
 		strp->skb_head = NULL;
 		strp->need_bytes = 0;
 		STRP_STATS_INCR(strp->stats.msgs);
@@ -315,13 +315,9 @@ gss_krb5_checksum(struct crypto_ahash *tfm, char *header, int hdrlen,
 		  const struct xdr_buf *body, int body_offset,
 		  struct xdr_netobj *cksumout)
 {
+	u8 checksumdata[HASH_MAX_DIGESTSIZE];
 	struct ahash_request *req;
 	int err = -ENOMEM;
-	u8 *checksumdata;
-
-	checksumdata = kmalloc(crypto_ahash_digestsize(tfm), GFP_KERNEL);
-	if (!checksumdata)
-		return GSS_S_FAILURE;
 
 	req = ahash_request_alloc(tfm, GFP_KERNEL);
 	if (!req)
@@ -360,7 +356,7 @@ gss_krb5_checksum(struct crypto_ahash *tfm, char *header, int hdrlen,
 out_free_ahash:
 	ahash_request_free(req);
 out_free_cksum:
-	kfree_sensitive(checksumdata);
+	memzero_explicit(checksumdata, sizeof(checksumdata));
 	return err ? GSS_S_FAILURE : GSS_S_COMPLETE;
 }
 EXPORT_SYMBOL_IF_KUNIT(gss_krb5_checksum);
@@ -931,19 +927,11 @@ u32 krb5_etm_checksum(struct crypto_sync_skcipher *cipher,
 		      int body_offset, struct xdr_netobj *cksumout)
 {
 	unsigned int ivsize = crypto_sync_skcipher_ivsize(cipher);
+	u8 checksumdata[HASH_MAX_DIGESTSIZE];
 	struct ahash_request *req;
 	struct scatterlist sg[1];
-	u8 *iv, *checksumdata;
 	int err = -ENOMEM;
 
-	checksumdata = kmalloc(crypto_ahash_digestsize(tfm), GFP_KERNEL);
-	if (!checksumdata)
-		return GSS_S_FAILURE;
-	/* For RPCSEC, the "initial cipher state" is always all zeroes. */
-	iv = kzalloc(ivsize, GFP_KERNEL);
-	if (!iv)
-		goto out_free_mem;
-
 	req = ahash_request_alloc(tfm, GFP_KERNEL);
 	if (!req)
 		goto out_free_mem;
@@ -952,7 +940,9 @@ u32 krb5_etm_checksum(struct crypto_sync_skcipher *cipher,
 	if (err)
 		goto out_free_ahash;
 
-	sg_init_one(sg, iv, ivsize);
+	/* For RPCSEC, the "initial cipher state" is always all zeroes. */
+	sg_init_table(sg, 1);
+	sg_set_page(sg, ZERO_PAGE(0), ivsize, 0);
 	ahash_request_set_crypt(req, sg, NULL, ivsize);
 	err = crypto_ahash_update(req);
 	if (err)
@@ -971,8 +961,7 @@ u32 krb5_etm_checksum(struct crypto_sync_skcipher *cipher,
 out_free_ahash:
 	ahash_request_free(req);
 out_free_mem:
-	kfree(iv);
-	kfree_sensitive(checksumdata);
+	memzero_explicit(checksumdata, sizeof(checksumdata));
 	return err ? GSS_S_FAILURE : GSS_S_COMPLETE;
 }
 EXPORT_SYMBOL_IF_KUNIT(krb5_etm_checksum);
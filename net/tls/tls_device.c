@@ -459,7 +459,7 @@ static int tls_push_data(struct sock *sk,
 	/* TLS_HEADER_SIZE is not counted as part of the TLS record, and
 	 * we need to leave room for an authentication tag.
 	 */
-	max_open_record_len = TLS_MAX_PAYLOAD_SIZE +
+	max_open_record_len = tls_ctx->tx_max_payload_len +
 			      prot->prepend_size;
 	do {
 		rc = tls_do_allocation(sk, ctx, pfrag, prot->prepend_size);
@@ -614,8 +614,25 @@ struct tls_record_info *tls_get_record(struct tls_offload_context_tx *context,
 	struct tls_record_info *info, *last;
 
 	info = context->retransmit_hint;
-	if (!info ||
-	    before(seq, info->end_seq - info->len)) {
+	if (info && before(seq, tls_record_start_seq(info)) &&
+	    !list_is_first(&info->list, &context->records_list)) {
+		/* Retransmissions mostly step back a few records from the
+		 * last lookup, so walk back from the hint rather than forward
+		 * from the oldest unacked record.  Appends only touch the
+		 * list head and tail, and removals hold context->lock like
+		 * our callers, so the prev links are stable here.
+		 */
+		do {
+			info = list_prev_entry(info, list);
+			record_sn--;
+		} while (before(seq, tls_record_start_seq(info)) &&
+			 !list_is_first(&info->list, &context->records_list));
+
+		if (before(seq, tls_record_start_seq(info)) &&
+		    !tls_record_is_start_marker(info))
+			return NULL;
+	} else if (!info ||
+		   before(seq, info->end_seq - info->len)) {
 		/* if retransmit_hint is irrelevant start
 		 * from the beginning of the list
 		 */
@@ -1831,8 +1831,8 @@ static int unix_getname(struct socket *sock, struct sockaddr *uaddr, int peer)
 	return err;
 }
 
-/* The "user->unix_inflight" variable is protected by the garbage
- * collection lock, and we just read it locklessly here. If you go
+/* The "user->unix_inflight" counter is updated atomically outside of
+ * the garbage collection lock, and we just read it here. If you go
  * over the limit, there might be a tiny race in actually noticing
  * it across threads. Tough.
  */
@@ -1840,7 +1840,7 @@ static inline bool too_many_unix_fds(struct task_struct *p)
 {
 	struct user_struct *user = current_user();
 
-	if (unlikely(READ_ONCE(user->unix_inflight) > task_rlimit(p, RLIMIT_NOFILE)))
+	if (unlikely(atomic_long_read(&user->unix_inflight) > task_rlimit(p, RLIMIT_NOFILE)))
 		return !capable(CAP_SYS_RESOURCE) && !capable(CAP_SYS_ADMIN);
 	return false;
 }
@@ -191,11 +191,14 @@ void unix_add_edges(struct scm_fp_list *fpl, struct unix_sock *receiver)
 {
 	int i = 0, j = 0;
 
-	spin_lock(&unix_gc_lock);
-
+	/* Passing only non-AF_UNIX files cannot create a cycle, so
+	 * there is no need to serialise on the global GC lock.
+	 */
 	if (!fpl->count_unix)
 		goto out;
 
+	spin_lock(&unix_gc_lock);
+
 	do {
 		struct unix_sock *inflight = unix_get_socket(fpl->fp[j++]);
 		struct unix_edge *edge;
@@ -212,11 +215,10 @@ void unix_add_edges(struct scm_fp_list *fpl, struct unix_sock *receiver)
 
 	receiver->scm_stat.nr_unix_fds += fpl->count_unix;
 	WRITE_ONCE(unix_tot_inflight, unix_tot_inflight + fpl->count_unix);
-out:
-	WRITE_ONCE(fpl->user->unix_inflight, fpl->user->unix_inflight + fpl->count);
 
 	spin_unlock(&unix_gc_lock);
-
+out:
+	atomic_long_add(fpl->count, &fpl->user->unix_inflight);
 	fpl->inflight = true;
 
 	unix_free_vertices(fpl);
@@ -227,11 +229,11 @@ void unix_del_edges(struct scm_fp_list *fpl)
 	struct unix_sock *receiver;
 	int i = 0;
 
-	spin_lock(&unix_gc_lock);
-
 	if (!fpl->count_unix)
 		goto out;
 
+	spin_lock(&unix_gc_lock);
+
 	do {
 		struct unix_edge *edge = fpl->edges + i++;
 
@@ -243,11 +245,10 @@ void unix_del_edges(struct scm_fp_list *fpl)
 		receiver->scm_stat.nr_unix_fds -= fpl->count_unix;
 	}
 	WRITE_ONCE(unix_tot_inflight, unix_tot_inflight - fpl->count_unix);
-out:
-	WRITE_ONCE(fpl->user->unix_inflight, fpl->user->unix_inflight - fpl->count);
 
 	spin_unlock(&unix_gc_lock);
-
+out:
+	atomic_long_sub(fpl->count, &fpl->user->unix_inflight);
 	fpl->inflight = false;
 }
 
@@ -606,8 +607,8 @@ void wait_for_unix_gc(struct scm_fp_list *fpl)
 	/* If number of inflight sockets is insane,
 	 * force a garbage collect right now.
 	 *
-	 * Paired with the WRITE_ONCE() in unix_inflight(),
-	 * unix_notinflight(), and __unix_gc().
+	 * Paired with the WRITE_ONCE() in unix_add_edges(),
+	 * unix_del_edges(), and __unix_gc().
 	 */
 	if (READ_ONCE(unix_tot_inflight) > UNIX_INFLIGHT_TRIGGER_GC &&
 	    !READ_ONCE(gc_in_progress))
@@ -617,7 +618,7 @@ void wait_for_unix_gc(struct scm_fp_list *fpl)
 	 * but whose sockets have not been received yet.
 	 */
 	if (!fpl || !fpl->count_unix ||
-	    READ_ONCE(fpl->user->unix_inflight) < UNIX_INFLIGHT_SANE_USER)
+	    atomic_long_read(&fpl->user->unix_inflight) < UNIX_INFLIGHT_SANE_USER)
 		return;
 
 	if (READ_ONCE(gc_in_progress))
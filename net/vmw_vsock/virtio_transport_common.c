@@ -697,6 +697,9 @@ static int virtio_transport_seqpacket_do_dequeue(struct vsock_sock *vsk,
 	size_t user_buf_len = msg_data_left(msg);
 	bool msg_ready = false;
 	struct sk_buff *skb;
+	u32 fwd_cnt_delta;
+	bool no_msg_ready;
+	u32 free_space;
 
 	spin_lock_bh(&vvs->rx_lock);
 
@@ -759,9 +762,20 @@ static int virtio_transport_seqpacket_do_dequeue(struct vsock_sock *vsk,
 		kfree_skb(skb);
 	}
 
+	fwd_cnt_delta = vvs->fwd_cnt - vvs->last_fwd_cnt;
+	free_space = vvs->buf_alloc - fwd_cnt_delta;
+	no_msg_ready = !vvs->msg_count;
+
 	spin_unlock_bh(&vvs->rx_lock);
 
-	virtio_transport_send_credit_update(vsk);
+	/* Same coalescing as for stream sockets: only update credits
+	 * when the peer may be running short, or when no complete
+	 * message is queued, since the reader would then wait for the
+	 * rest of a message the peer may lack the credit to send.
+	 */
+	if (fwd_cnt_delta &&
+	    (free_space < VIRTIO_VSOCK_MAX_PKT_BUF_SIZE || no_msg_ready))
+		virtio_transport_send_credit_update(vsk);
 
 	return dequeued_len;
 }
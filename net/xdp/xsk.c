@@ -681,14 +681,9 @@ static struct sk_buff *xsk_build_skb(struct xdp_sock *xs,
 			if (unlikely(!skb))
 				goto free_err;
 
+			/* Freshly allocated and linear: a plain copy will do */
 			skb_reserve(skb, hr);
-			skb_put(skb, len);
-
-			err = skb_store_bits(skb, 0, buffer, len);
-			if (unlikely(err)) {
-				kfree_skb(skb);
-				goto free_err;
-			}
+			memcpy(skb_put(skb, len), buffer, len);
 
 			first_frag = true;
 		} else {
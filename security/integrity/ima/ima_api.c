@@ -254,6 +254,7 @@ int ima_collect_measurement(struct ima_iint_cache *iint, struct file *file,
 	int length;
 	void *tmpbuf;
 	u64 i_version = 0;
+	bool want_tree, tree = false;
 
 	/*
 	 * Always collect the modsig, because IMA might have already collected
@@ -263,7 +264,16 @@ int ima_collect_measurement(struct ima_iint_cache *iint, struct file *file,
 	if (modsig)
 		ima_collect_modsig(modsig, buf, size);
 
-	if (iint->flags & IMA_COLLECTED)
+	want_tree = (iint->flags & (IMA_TREE_DIGEST | IMA_APPRAISE)) ==
+		    IMA_TREE_DIGEST;
+
+	/*
+	 * A tree digest is only good for tree rules, in particular it cannot
+	 * be appraised against security.ima. Hash the file again if a rule
+	 * without digest_type=tree, or appraisal, needs it since.
+	 */
+	if ((iint->flags & IMA_COLLECTED) &&
+	    !(test_bit(IMA_TREE_HASHED, &iint->atomic_flags) && !want_tree))
 		goto out;
 
 	/*
@@ -289,6 +299,9 @@ int ima_collect_measurement(struct ima_iint_cache *iint, struct file *file,
 		}
 	} else if (buf) {
 		result = ima_calc_buffer_hash(buf, size, hash_hdr);
+	} else if (want_tree) {
+		result = ima_calc_file_tree_hash(file, hash_hdr);
+		tree = true;
 	} else {
 		result = ima_calc_file_hash(file, hash_hdr);
 	}
@@ -305,6 +318,10 @@ int ima_collect_measurement(struct ima_iint_cache *iint, struct file *file,
 
 	iint->ima_hash = tmpbuf;
 	memcpy(iint->ima_hash, &hash, length);
+	if (tree)
+		set_bit(IMA_TREE_HASHED, &iint->atomic_flags);
+	else
+		clear_bit(IMA_TREE_HASHED, &iint->atomic_flags);
 	if (real_inode == inode)
 		iint->real_inode.version = i_version;
 	else
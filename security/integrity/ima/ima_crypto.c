@@ -17,7 +17,9 @@
 #include <linux/crypto.h>
 #include <linux/scatterlist.h>
 #include <linux/err.h>
+#include <linux/sizes.h>
 #include <linux/slab.h>
+#include <linux/workqueue.h>
 #include <crypto/hash.h>
 
 #include "ima.h"
@@ -54,6 +56,11 @@ static const struct kernel_param_ops param_ops_bufsize = {
 module_param_named(ahash_bufsize, ima_bufsize, bufsize, 0644);
 MODULE_PARM_DESC(ahash_bufsize, "Maximum ahash buffer size");
 
+/* maximum number of threads hashing one file in tree mode */
+static unsigned int ima_tree_workers;
+module_param_named(tree_workers, ima_tree_workers, uint, 0644);
+MODULE_PARM_DESC(tree_workers, "Maximum threads per file for digest_type=tree (0: one per online CPU)");
+
 static struct crypto_shash *ima_shash_tfm;
 static struct crypto_ahash *ima_ahash_tfm;
 
@@ -515,6 +522,184 @@ static int ima_calc_file_shash(struct file *file, struct ima_digest_data *hash)
 	return rc;
 }
 
+/*
+ * Tree hash, used for digest_type=tree rules: the file is split into
+ * IMA_TREE_CHUNK sized chunks that are hashed independently, and in
+ * parallel on large files.  The digest is
+ *
+ *	H(le64 i_size || le32 IMA_TREE_CHUNK || H(chunk 0) || ... )
+ *
+ * with the same hash algorithm throughout; an empty file has no chunks.
+ */
+#define IMA_TREE_CHUNK		SZ_1M
+
+struct ima_tree_work {
+	struct work_struct work;
+	struct file *file;
+	struct crypto_shash *tfm;
+	u8 *leaves;
+	loff_t i_size;
+	unsigned long first;
+	unsigned long last;
+	atomic_t *pending;
+	struct completion *done;
+	int rc;
+};
+
+static int ima_tree_hash_chunks(struct ima_tree_work *tw)
+{
+	unsigned int digestsize = crypto_shash_digestsize(tw->tfm);
+	SHASH_DESC_ON_STACK(shash, tw->tfm);
+	unsigned long i;
+	size_t rbuf_size;
+	char *rbuf;
+	int rc = 0;
+
+	shash->tfm = tw->tfm;
+
+	rbuf = ima_alloc_pages(IMA_TREE_CHUNK, &rbuf_size, 1);
+	if (!rbuf)
+		return -ENOMEM;
+
+	for (i = tw->first; i < tw->last && !rc; i++) {
+		loff_t offset = (loff_t)i * IMA_TREE_CHUNK;
+		loff_t end = min_t(loff_t, offset + IMA_TREE_CHUNK, tw->i_size);
+
+		rc = crypto_shash_init(shash);
+		while (!rc && offset < end) {
+			int rbuf_len;
+
+			rbuf_len = integrity_kernel_read(tw->file, offset, rbuf,
+					min_t(loff_t, end - offset, rbuf_size));
+			if (rbuf_len <= 0) {
+				/* 0 is an unexpected EOF */
+				rc = rbuf_len ?: -EINVAL;
+				break;
+			}
+			offset += rbuf_len;
+
+			rc = crypto_shash_update(shash, rbuf, rbuf_len);
+		}
+		if (!rc)
+			rc = crypto_shash_final(shash,
+						tw->leaves + i * digestsize);
+	}
+
+	ima_free_pages(rbuf, rbuf_size);
+	return rc;
+}
+
+static void ima_tree_work_fn(struct work_struct *work)
+{
+	struct ima_tree_work *tw = container_of(work, struct ima_tree_work,
+						work);
+
+	tw->rc = ima_tree_hash_chunks(tw);
+	if (atomic_dec_and_test(tw->pending))
+		complete(tw->done);
+}
+
+static int ima_calc_file_tree_tfm(struct file *file,
+				  struct ima_digest_data *hash,
+				  struct crypto_shash *tfm)
+{
+	unsigned int digestsize = crypto_shash_digestsize(tfm);
+	DECLARE_COMPLETION_ONSTACK(done);
+	SHASH_DESC_ON_STACK(shash, tfm);
+	struct {
+		__le64 i_size;
+		__le32 chunk;
+	} __packed hdr;
+	unsigned long nchunks;
+	struct ima_tree_work *tw;
+	unsigned int nwork, i;
+	u8 *leaves = NULL;
+	atomic_t pending;
+	loff_t i_size;
+	int rc = 0;
+
+	hash->length = digestsize;
+
+	i_size = i_size_read(file_inode(file));
+	nchunks = DIV_ROUND_UP_ULL(i_size, IMA_TREE_CHUNK);
+
+	if (nchunks) {
+		leaves = kvmalloc_array(nchunks, digestsize, GFP_KERNEL);
+		if (!leaves)
+			return -ENOMEM;
+
+		nwork = ima_tree_workers ?: num_online_cpus();
+		nwork = clamp_t(unsigned long, nchunks, 1, nwork);
+		tw = kcalloc(nwork, sizeof(*tw), GFP_KERNEL);
+		if (!tw) {
+			kvfree(leaves);
+			return -ENOMEM;
+		}
+
+		/* Contiguous ranges per worker keep readahead effective */
+		atomic_set(&pending, nwork - 1);
+		for (i = 0; i < nwork; i++) {
+			tw[i].file = file;
+			tw[i].tfm = tfm;
+			tw[i].leaves = leaves;
+			tw[i].i_size = i_size;
+			tw[i].first = nchunks * i / nwork;
+			tw[i].last = nchunks * (i + 1) / nwork;
+			tw[i].pending = &pending;
+			tw[i].done = &done;
+		}
+
+		for (i = 1; i < nwork; i++) {
+			INIT_WORK(&tw[i].work, ima_tree_work_fn);
+			queue_work(system_unbound_wq, &tw[i].work);
+		}
+
+		/* The caller hashes the first range itself */
+		tw[0].rc = ima_tree_hash_chunks(&tw[0]);
+		if (nwork > 1)
+			wait_for_completion(&done);
+
+		for (i = 0; i < nwork && !rc; i++)
+			rc = tw[i].rc;
+		kfree(tw);
+	}
+
+	if (!rc) {
+		hdr.i_size = cpu_to_le64(i_size);
+		hdr.chunk = cpu_to_le32(IMA_TREE_CHUNK);
+		shash->tfm = tfm;
+
+		rc = crypto_shash_init(shash);
+		if (!rc)
+			rc = crypto_shash_update(shash, (u8 *)&hdr,
+						 sizeof(hdr));
+		for (i = 0; !rc && i < nchunks; i++)
+			rc = crypto_shash_update(shash, leaves + i * digestsize,
+						 digestsize);
+		if (!rc)
+			rc = crypto_shash_final(shash, hash->digest);
+	}
+
+	kvfree(leaves);
+	return rc;
+}
+
+static int ima_calc_file_tree(struct file *file, struct ima_digest_data *hash)
+{
+	struct crypto_shash *tfm;
+	int rc;
+
+	tfm = ima_alloc_tfm(hash->algo);
+	if (IS_ERR(tfm))
+		return PTR_ERR(tfm);
+
+	rc = ima_calc_file_tree_tfm(file, hash, tfm);
+
+	ima_free_tfm(tfm);
+
+	return rc;
+}
+
 /*
  * ima_calc_file_hash - calculate file hash
  *
@@ -528,7 +713,8 @@ static int ima_calc_file_shash(struct file *file, struct ima_digest_data *hash)
  * shash for the hash calculation.  If ahash fails, it falls back to using
  * shash.
  */
-int ima_calc_file_hash(struct file *file, struct ima_digest_data *hash)
+static int __ima_calc_file_hash(struct file *file, struct ima_digest_data *hash,
+				bool tree)
 {
 	loff_t i_size;
 	int rc;
@@ -557,6 +743,11 @@ int ima_calc_file_hash(struct file *file, struct ima_digest_data *hash)
 		new_file_instance = true;
 	}
 
+	if (tree) {
+		rc = ima_calc_file_tree(f, hash);
+		goto out;
+	}
+
 	i_size = i_size_read(file_inode(f));
 
 	if (ima_ahash_minsize && i_size >= ima_ahash_minsize) {
@@ -572,6 +763,22 @@ int ima_calc_file_hash(struct file *file, struct ima_digest_data *hash)
 	return rc;
 }
 
+int ima_calc_file_hash(struct file *file, struct ima_digest_data *hash)
+{
+	return __ima_calc_file_hash(file, hash, false);
+}
+
+/*
+ * ima_calc_file_tree_hash - calculate the tree hash of a file
+ *
+ * Only for measurement: the result is not a plain file hash and cannot be
+ * compared against security.ima.
+ */
+int ima_calc_file_tree_hash(struct file *file, struct ima_digest_data *hash)
+{
+	return __ima_calc_file_hash(file, hash, true);
+}
+
 /*
  * Calculate the hash of template data
  */
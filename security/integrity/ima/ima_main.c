@@ -311,6 +311,9 @@ static int process_measurement(struct file *file, const struct cred *cred,
 					 IMA_APPRAISED_SUBMASK);
 	}
 
+	/* The digest type is a property of the matching rule, not the inode */
+	iint->flags &= ~IMA_TREE_DIGEST;
+
 	/* Determine if already appraised/measured based on bitmask
 	 * (IMA_MEASURE, IMA_MEASURED, IMA_XXXX_APPRAISE, IMA_XXXX_APPRAISED,
 	 *  IMA_AUDIT, IMA_AUDITED)
@@ -586,7 +589,9 @@ static int __ima_inode_hash(struct inode *inode, struct file *file, char *buf,
 			mutex_lock(&iint->mutex);
 	}
 
-	if ((!iint || !(iint->flags & IMA_COLLECTED)) && file) {
+	/* A tree digest is not the file hash, compute that one instead */
+	if ((!iint || !(iint->flags & IMA_COLLECTED) ||
+	     test_bit(IMA_TREE_HASHED, &iint->atomic_flags)) && file) {
 		if (iint)
 			mutex_unlock(&iint->mutex);
 
@@ -614,7 +619,8 @@ static int __ima_inode_hash(struct inode *inode, struct file *file, char *buf,
 	 * ima_file_hash can be called when ima_collect_measurement has still
 	 * not been called, we might not always have a hash.
 	 */
-	if (!iint->ima_hash || !(iint->flags & IMA_COLLECTED)) {
+	if (!iint->ima_hash || !(iint->flags & IMA_COLLECTED) ||
+	    test_bit(IMA_TREE_HASHED, &iint->atomic_flags)) {
 		mutex_unlock(&iint->mutex);
 		return -EOPNOTSUPP;
 	}
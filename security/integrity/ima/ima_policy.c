@@ -1283,7 +1283,8 @@ static bool ima_validate_rule(struct ima_rule_entry *entry)
 				     IMA_FSNAME | IMA_GID | IMA_EGID |
 				     IMA_FGROUP | IMA_DIGSIG_REQUIRED |
 				     IMA_PERMIT_DIRECTIO | IMA_VALIDATE_ALGOS |
-				     IMA_CHECK_BLACKLIST | IMA_VERITY_REQUIRED))
+				     IMA_CHECK_BLACKLIST | IMA_VERITY_REQUIRED |
+				     IMA_TREE_DIGEST))
 			return false;
 
 		break;
@@ -1373,6 +1374,12 @@ static bool ima_validate_rule(struct ima_rule_entry *entry)
 	    !(entry->flags & IMA_DIGSIG_REQUIRED))
 		return false;
 
+	/* Tree digests are for measurement only, nothing signs them */
+	if ((entry->flags & IMA_TREE_DIGEST) &&
+	    (entry->action == APPRAISE ||
+	     entry->flags & IMA_VERITY_REQUIRED))
+		return false;
+
 	return true;
 }
 
@@ -1796,6 +1803,8 @@ static int ima_parse_rule(char *rule, struct ima_rule_entry *entry)
 				result = -EINVAL;
 			else if ((strcmp(args[0].from, "verity")) == 0)
 				entry->flags |= IMA_VERITY_REQUIRED;
+			else if ((strcmp(args[0].from, "tree")) == 0)
+				entry->flags |= IMA_TREE_DIGEST;
 			else
 				result = -EINVAL;
 			break;
@@ -1907,6 +1916,15 @@ static int ima_parse_rule(char *rule, struct ima_rule_entry *entry)
 				     "verity rules should include d-ngv2");
 	}
 
+	/* likewise for tree digests, which differ from a plain file hash */
+	if (!result && entry->action == MEASURE &&
+	    entry->flags & IMA_TREE_DIGEST) {
+		template_desc = entry->template ? entry->template :
+						  ima_template_desc_current();
+		check_template_field(template_desc, "d-ngv2",
+				     "tree rules should include d-ngv2");
+	}
+
 	audit_log_format(ab, "res=%d", !result);
 	audit_log_end(ab);
 	return result;
@@ -2269,6 +2287,8 @@ int ima_policy_show(struct seq_file *m, void *v)
 	}
 	if (entry->flags & IMA_VERITY_REQUIRED)
 		seq_puts(m, "digest_type=verity ");
+	if (entry->flags & IMA_TREE_DIGEST)
+		seq_puts(m, "digest_type=tree ");
 	if (entry->flags & IMA_PERMIT_DIRECTIO)
 		seq_puts(m, "permit_directio ");
 	rcu_read_unlock();
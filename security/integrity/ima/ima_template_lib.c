@@ -33,13 +33,15 @@ enum data_formats {
 enum digest_type {
 	DIGEST_TYPE_IMA,
 	DIGEST_TYPE_VERITY,
+	DIGEST_TYPE_TREE,
 	DIGEST_TYPE__LAST
 };
 
 #define DIGEST_TYPE_NAME_LEN_MAX 7	/* including NUL */
 static const char * const digest_type_name[DIGEST_TYPE__LAST] = {
 	[DIGEST_TYPE_IMA] = "ima",
-	[DIGEST_TYPE_VERITY] = "verity"
+	[DIGEST_TYPE_VERITY] = "verity",
+	[DIGEST_TYPE_TREE] = "tree"
 };
 
 static int ima_write_template_field_data(const void *data, const u32 datalen,
@@ -438,6 +440,8 @@ int ima_eventdigest_ngv2_init(struct ima_event_data *event_data,
 	hash_algo = event_data->iint->ima_hash->algo;
 	if (event_data->iint->flags & IMA_VERITY_REQUIRED)
 		digest_type = DIGEST_TYPE_VERITY;
+	else if (test_bit(IMA_TREE_HASHED, &event_data->iint->atomic_flags))
+		digest_type = DIGEST_TYPE_TREE;
 out:
 	return ima_eventdigest_init_common(cur_digest, cur_digestsize,
 					   digest_type, hash_algo,
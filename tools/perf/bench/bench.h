@@ -49,6 +49,16 @@ int bench_uprobe_trace_printk(int argc, const char **argv);
 int bench_uprobe_empty_ret(int argc, const char **argv);
 int bench_uprobe_trace_printk_ret(int argc, const char **argv);
 int bench_pmu_scan(int argc, const char **argv);
+int bench_io_uring(int argc, const char **argv);
+int bench_io_sync(int argc, const char **argv);
+int bench_net_stream(int argc, const char **argv);
+int bench_net_packet(int argc, const char **argv);
+int bench_kernel_lock_spin(int argc, const char **argv);
+int bench_kernel_lock_rwlock(int argc, const char **argv);
+int bench_kernel_lock_mutex(int argc, const char **argv);
+int bench_kernel_lock_rtmutex(int argc, const char **argv);
+int bench_kernel_lock_rwsem(int argc, const char **argv);
+int bench_kernel_lock_percpu_rwsem(int argc, const char **argv);
 
 #define BENCH_FORMAT_DEFAULT_STR	"default"
 #define BENCH_FORMAT_DEFAULT		0
@@ -0,0 +1,502 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * io.c
+ *
+ * io: Benchmarks for the file and block I/O submission paths
+ *
+ *  uring: random reads through io_uring, sweeping queue depth and batch size
+ *  sync:  random pread(2) calls from one or more threads, as a baseline
+ *
+ * Both read from --file, which can be a block device such as /dev/nullb0, or
+ * from a temporary file of --size MiB created for the run. Nothing is ever
+ * written to --file.
+ */
+#include <subcmd/parse-options.h>
+#include "bench.h"
+#include "latency.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <linux/compiler.h>
+#include <linux/fs.h>
+#include <linux/kernel.h>
+#include <linux/zalloc.h>
+
+#if defined(__has_include) && __has_include(<linux/io_uring.h>) && defined(__NR_io_uring_setup)
+#include <linux/io_uring.h>
+#define HAVE_BENCH_IO_URING
+#endif
+
+#define MAX_SWEEP	16
+
+static const char	*file;
+static unsigned int	size_mb = 64;
+static unsigned int	block_size = 4096;
+static const char	*depths_str = "1,4,16,64";
+static const char	*batches_str = "1,8";
+static unsigned int	runtime = 2;
+static unsigned int	nthreads = 1;
+static bool		direct;
+
+static const struct option options[] = {
+	OPT_STRING('f', "file", &file, "path", "File or block device to read from (default: a temporary file)"),
+	OPT_UINTEGER('s', "size", &size_mb, "Size in MiB of the temporary file"),
+	OPT_UINTEGER('b', "block-size", &block_size, "Size in bytes of each read"),
+	OPT_STRING('q', "depth", &depths_str, "n,...", "Queue depths to sweep (uring)"),
+	OPT_STRING('B', "batch", &batches_str, "n,...", "Submission batch sizes to sweep (uring)"),
+	OPT_UINTEGER('t', "threads", &nthreads, "Number of reader threads (sync)"),
+	OPT_UINTEGER('r', "runtime", &runtime, "Runtime in seconds of each measurement"),
+	OPT_BOOLEAN('d', "direct", &direct, "Use O_DIRECT"),
+	OPT_END()
+};
+
+static const char * const bench_io_uring_usage[] = {
+	"perf bench io uring <options>",
+	NULL
+};
+
+static const char * const bench_io_sync_usage[] = {
+	"perf bench io sync <options>",
+	NULL
+};
+
+static int parse_sweep(const char *str, unsigned int *vals)
+{
+	unsigned int nr = 0;
+	char *end;
+
+	while (*str && nr < MAX_SWEEP) {
+		unsigned long v = strtoul(str, &end, 0);
+
+		if (end == str || !v)
+			return -1;
+		vals[nr++] = v;
+		str = *end == ',' ? end + 1 : end;
+	}
+
+	return nr ? (int)nr : -1;
+}
+
+/* Open --file or create the temporary file, return its usable size in @size */
+static int io_open(u64 *size)
+{
+	char path[] = "/var/tmp/perf-bench-io-XXXXXX";
+	int flags = O_RDONLY | (direct ? O_DIRECT : 0);
+	u64 left, chunk = 1 << 20;
+	struct stat st;
+	void *buf;
+	int fd, wfd;
+
+	if (file) {
+		fd = open(file, flags);
+		if (fd < 0) {
+			fprintf(stderr, "Failed to open %s: %s\n", file, strerror(errno));
+			return -1;
+		}
+		if (fstat(fd, &st) < 0)
+			goto err_close;
+		if (S_ISBLK(st.st_mode)) {
+			if (ioctl(fd, BLKGETSIZE64, size) < 0)
+				goto err_close;
+		} else {
+			*size = st.st_size;
+		}
+		goto out;
+	}
+
+	wfd = mkstemp(path);
+	if (wfd < 0) {
+		fprintf(stderr, "Failed to create %s: %s\n", path, strerror(errno));
+		return -1;
+	}
+
+	buf = malloc(chunk);
+	if (!buf) {
+		close(wfd);
+		unlink(path);
+		return -1;
+	}
+	memset(buf, 0x5a, chunk);
+
+	for (left = (u64)size_mb << 20; left; left -= chunk) {
+		if (write(wfd, buf, chunk) != (ssize_t)chunk) {
+			fprintf(stderr, "Failed to fill %s\n", path);
+			free(buf);
+			close(wfd);
+			unlink(path);
+			return -1;
+		}
+	}
+	free(buf);
+	fsync(wfd);
+	close(wfd);
+
+	fd = open(path, flags);
+	unlink(path);
+	if (fd < 0) {
+		fprintf(stderr, "Failed to reopen %s: %s\n", path, strerror(errno));
+		return -1;
+	}
+	*size = (u64)size_mb << 20;
+out:
+	if (*size < block_size) {
+		fprintf(stderr, "Target is smaller than one block\n");
+		close(fd);
+		return -1;
+	}
+	return fd;
+
+err_close:
+	fprintf(stderr, "Failed to get the size of %s: %s\n", file, strerror(errno));
+	close(fd);
+	return -1;
+}
+
+/* Random block aligned offset within @nr_blocks */
+static u64 io_offset(u64 *state, u64 nr_blocks)
+{
+	u64 x = *state;
+
+	x ^= x << 13;
+	x ^= x >> 7;
+	x ^= x << 17;
+	*state = x;
+
+	return (x % nr_blocks) * block_size;
+}
+
+/* @qd is the queue depth for uring and the number of threads for sync */
+static void io_print(const char *name, unsigned int qd, unsigned int batch,
+		     const struct lat_hist *h, u64 elapsed)
+{
+	double secs = elapsed / 1e9;
+	double iops = h->count / secs;
+
+	if (bench_format == BENCH_FORMAT_SIMPLE) {
+		printf("%s qd=%u batch=%u bs=%u iops=%.0f mbps=%.1f",
+		       name, qd, batch, block_size, iops,
+		       iops * block_size / (1 << 20));
+		lat_hist__print(h);
+		return;
+	}
+
+	printf("# %s: %u byte random reads, %u in flight, batch %u\n",
+	       name, block_size, qd, batch);
+	printf(" %14s: %'.0f\n", "IOPS", iops);
+	printf(" %14s: %.1f MiB/sec\n", "bandwidth", iops * block_size / (1 << 20));
+	lat_hist__print(h);
+	printf("\n");
+}
+
+#ifdef HAVE_BENCH_IO_URING
+struct uring {
+	int			fd;
+	unsigned int		*sq_head, *sq_tail, *sq_mask, *sq_array;
+	unsigned int		*cq_head, *cq_tail, *cq_mask;
+	struct io_uring_sqe	*sqes;
+	struct io_uring_cqe	*cqes;
+	void			*sq_ptr, *cq_ptr;
+	size_t			sq_len, cq_len, sqes_len;
+};
+
+static int uring_init(struct uring *r, unsigned int entries)
+{
+	struct io_uring_params p;
+
+	memset(&p, 0, sizeof(p));
+	r->fd = syscall(__NR_io_uring_setup, entries, &p);
+	if (r->fd < 0)
+		return -errno;
+
+	r->sq_len = p.sq_off.array + p.sq_entries * sizeof(unsigned int);
+	r->sq_ptr = mmap(NULL, r->sq_len, PROT_READ | PROT_WRITE,
+			 MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQ_RING);
+	r->cq_len = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	r->cq_ptr = mmap(NULL, r->cq_len, PROT_READ | PROT_WRITE,
+			 MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_CQ_RING);
+	r->sqes_len = p.sq_entries * sizeof(struct io_uring_sqe);
+	r->sqes = mmap(NULL, r->sqes_len, PROT_READ | PROT_WRITE,
+		       MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQES);
+	if (r->sq_ptr == MAP_FAILED || r->cq_ptr == MAP_FAILED ||
+	    r->sqes == MAP_FAILED) {
+		close(r->fd);
+		return -ENOMEM;
+	}
+
+	r->sq_head = r->sq_ptr + p.sq_off.head;
+	r->sq_tail = r->sq_ptr + p.sq_off.tail;
+	r->sq_mask = r->sq_ptr + p.sq_off.ring_mask;
+	r->sq_array = r->sq_ptr + p.sq_off.array;
+	r->cq_head = r->cq_ptr + p.cq_off.head;
+	r->cq_tail = r->cq_ptr + p.cq_off.tail;
+	r->cq_mask = r->cq_ptr + p.cq_off.ring_mask;
+	r->cqes = r->cq_ptr + p.cq_off.cqes;
+	return 0;
+}
+
+static void uring_exit(struct uring *r)
+{
+	munmap(r->sqes, r->sqes_len);
+	munmap(r->cq_ptr, r->cq_len);
+	munmap(r->sq_ptr, r->sq_len);
+	close(r->fd);
+}
+
+/* Run one point of the sweep: @qd reads in flight, submitted @batch at a time */
+static int uring_run(int fd, u64 nr_blocks, unsigned int qd, unsigned int batch,
+		     struct lat_hist *h, u64 *elapsed)
+{
+	unsigned int *free_slots, nr_free = qd, inflight = 0, i;
+	u64 seed = 0x9e3779b97f4a7c15ULL, start, end, *issued;
+	struct iovec *iov;
+	struct uring r;
+	int ret;
+
+	ret = uring_init(&r, qd);
+	if (ret) {
+		fprintf(stderr, "io_uring_setup failed: %s\n", strerror(-ret));
+		return ret;
+	}
+
+	iov = calloc(qd, sizeof(*iov));
+	issued = calloc(qd, sizeof(*issued));
+	free_slots = calloc(qd, sizeof(*free_slots));
+	if (!iov || !issued || !free_slots) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	for (i = 0; i < qd; i++) {
+		if (posix_memalign(&iov[i].iov_base, 4096, block_size)) {
+			ret = -ENOMEM;
+			goto out;
+		}
+		iov[i].iov_len = block_size;
+		free_slots[i] = i;
+	}
+
+	start = lat_now();
+	end = start + runtime * 1000000000ULL;
+	for (;;) {
+		unsigned int tail = *r.sq_tail, head, n = 0;
+		u64 now = lat_now();
+
+		/* Keep @qd reads in flight, but only submit whole batches */
+		while (now < end && nr_free >= batch) {
+			for (i = 0; i < batch; i++) {
+				unsigned int slot = free_slots[--nr_free];
+				unsigned int idx = (tail + n) & *r.sq_mask;
+				struct io_uring_sqe *sqe = &r.sqes[idx];
+
+				memset(sqe, 0, sizeof(*sqe));
+				sqe->opcode = IORING_OP_READV;
+				sqe->fd = fd;
+				sqe->addr = (unsigned long)&iov[slot];
+				sqe->len = 1;
+				sqe->off = io_offset(&seed, nr_blocks);
+				sqe->user_data = slot;
+				r.sq_array[idx] = idx;
+				issued[slot] = now;
+				n++;
+			}
+			__atomic_store_n(r.sq_tail, tail + n, __ATOMIC_RELEASE);
+			ret = syscall(__NR_io_uring_enter, r.fd, batch, 0, 0, NULL, 0);
+			if (ret < 0) {
+				ret = -errno;
+				goto out;
+			}
+			inflight += batch;
+			tail += batch;
+			n = 0;
+		}
+
+		if (!inflight)
+			break;
+
+		ret = syscall(__NR_io_uring_enter, r.fd, 0,
+			      min(batch, inflight), IORING_ENTER_GETEVENTS, NULL, 0);
+		if (ret < 0 && errno != EINTR) {
+			ret = -errno;
+			goto out;
+		}
+
+		now = lat_now();
+		head = *r.cq_head;
+		while (head != __atomic_load_n(r.cq_tail, __ATOMIC_ACQUIRE)) {
+			struct io_uring_cqe *cqe = &r.cqes[head & *r.cq_mask];
+			unsigned int slot = cqe->user_data;
+
+			if (cqe->res < 0) {
+				fprintf(stderr, "read failed: %s\n", strerror(-cqe->res));
+				ret = cqe->res;
+				goto out;
+			}
+			lat_hist__add(h, now - issued[slot]);
+			free_slots[nr_free++] = slot;
+			inflight--;
+			head++;
+		}
+		__atomic_store_n(r.cq_head, head, __ATOMIC_RELEASE);
+	}
+	*elapsed = lat_now() - start;
+	ret = 0;
+out:
+	if (iov) {
+		for (i = 0; i < qd; i++)
+			free(iov[i].iov_base);
+	}
+	free(iov);
+	free(issued);
+	free(free_slots);
+	uring_exit(&r);
+	return ret;
+}
+
+int bench_io_uring(int argc, const char **argv)
+{
+	unsigned int depths[MAX_SWEEP], batches[MAX_SWEEP];
+	int nr_depths, nr_batches, d, b, fd, ret = 0;
+	u64 size;
+
+	argc = parse_options(argc, argv, options, bench_io_uring_usage, 0);
+	if (argc)
+		usage_with_options(bench_io_uring_usage, options);
+
+	nr_depths = parse_sweep(depths_str, depths);
+	nr_batches = parse_sweep(batches_str, batches);
+	if (nr_depths < 0 || nr_batches < 0) {
+		fprintf(stderr, "Invalid --depth or --batch list\n");
+		return -1;
+	}
+
+	fd = io_open(&size);
+	if (fd < 0)
+		return -1;
+
+	for (d = 0; d < nr_depths && !ret; d++) {
+		for (b = 0; b < nr_batches && !ret; b++) {
+			struct lat_hist *h;
+			u64 elapsed;
+
+			/* A batch larger than the depth could never be submitted */
+			if (batches[b] > depths[d])
+				continue;
+
+			h = zalloc(sizeof(*h));
+			if (!h) {
+				ret = -1;
+				break;
+			}
+			ret = uring_run(fd, size / block_size, depths[d],
+					batches[b], h, &elapsed);
+			if (!ret)
+				io_print("uring", depths[d], batches[b], h, elapsed);
+			free(h);
+		}
+	}
+
+	close(fd);
+	return ret;
+}
+#else
+int bench_io_uring(int argc __maybe_unused, const char **argv __maybe_unused)
+{
+	fprintf(stderr, "perf was built without io_uring headers\n");
+	return 0;
+}
+#endif
+
+struct sync_worker {
+	pthread_t		thread;
+	int			fd;
+	unsigned int		nr;
+	u64			nr_blocks;
+	u64			end;
+	struct lat_hist		hist;
+};
+
+static void *sync_worker_fn(void *arg)
+{
+	struct sync_worker *w = arg;
+	u64 seed = 0x9e3779b97f4a7c15ULL * (w->nr + 1), t0, t1;
+	void *buf;
+
+	if (posix_memalign(&buf, 4096, block_size))
+		return NULL;
+
+	do {
+		t0 = lat_now();
+		if (pread(w->fd, buf, block_size,
+			  io_offset(&seed, w->nr_blocks)) != (ssize_t)block_size) {
+			fprintf(stderr, "pread failed: %s\n", strerror(errno));
+			break;
+		}
+		t1 = lat_now();
+		lat_hist__add(&w->hist, t1 - t0);
+	} while (t1 < w->end);
+
+	free(buf);
+	return NULL;
+}
+
+int bench_io_sync(int argc, const char **argv)
+{
+	struct sync_worker *workers;
+	struct lat_hist *h;
+	unsigned int i;
+	u64 size, start;
+	int fd, ret = 0;
+
+	argc = parse_options(argc, argv, options, bench_io_sync_usage, 0);
+	if (argc)
+		usage_with_options(bench_io_sync_usage, options);
+
+	fd = io_open(&size);
+	if (fd < 0)
+		return -1;
+
+	workers = calloc(nthreads, sizeof(*workers));
+	h = zalloc(sizeof(*h));
+	if (!workers || !h) {
+		ret = -1;
+		goto out;
+	}
+
+	start = lat_now();
+	for (i = 0; i < nthreads; i++) {
+		workers[i].fd = fd;
+		workers[i].nr = i;
+		workers[i].nr_blocks = size / block_size;
+		workers[i].end = start + runtime * 1000000000ULL;
+		if (pthread_create(&workers[i].thread, NULL, sync_worker_fn, &workers[i])) {
+			fprintf(stderr, "pthread_create failed\n");
+			nthreads = i;
+			ret = -1;
+			break;
+		}
+	}
+
+	for (i = 0; i < nthreads; i++) {
+		pthread_join(workers[i].thread, NULL);
+		lat_hist__merge(h, &workers[i].hist);
+	}
+
+	if (!ret)
+		io_print("sync", nthreads, 1, h, lat_now() - start);
+out:
+	free(h);
+	free(workers);
+	close(fd);
+	return ret;
+}
@@ -0,0 +1,324 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * kernel-lock.c
+ *
+ * kernel-lock: contention benchmarks for kernel locking primitives
+ *
+ * Loads the locktorture module (CONFIG_LOCK_TORTURE_TEST=m) with the lock
+ * type, thread counts, placement and critical section lengths asked for,
+ * lets it run and collects the acquisition counts and acquire latency
+ * histograms from <debugfs>/locktorture/stats before unloading it again.
+ */
+#include <subcmd/parse-options.h>
+#include <subcmd/run-command.h>
+#include <api/fs/fs.h>
+#include "bench.h"
+#include "latency.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <linux/kernel.h>
+#include <linux/zalloc.h>
+
+/* Must match LOCK_TORTURE_LAT_BUCKETS in kernel/locking/locktorture.c */
+#define KLOCK_LAT_BUCKETS	32
+
+static int		nwriters = -1;
+static int		nreaders = -1;
+static const char	*cpus;
+static int		node = -1;
+static unsigned int	cs_ns;
+static unsigned int	ncs_ns;
+static unsigned int	runtime = 5;
+
+static const struct option options[] = {
+	OPT_INTEGER('w', "writers", &nwriters, "Number of write-locking threads (default: two per CPU, one per CPU for rw types without -R)"),
+	OPT_INTEGER('R', "readers", &nreaders, "Number of read-locking threads, for rw types (default: as many as writers)"),
+	OPT_STRING('C', "cpus", &cpus, "cpu-list", "Bind all lock threads to these CPUs"),
+	OPT_INTEGER('N', "node", &node, "Bind all lock threads to the CPUs of this NUMA node"),
+	OPT_UINTEGER(0, "cs-ns", &cs_ns, "Critical section length in ns (default: the lock type's own delays)"),
+	OPT_UINTEGER(0, "ncs-ns", &ncs_ns, "Delay between acquisitions in ns"),
+	OPT_UINTEGER('r', "runtime", &runtime, "Runtime in seconds"),
+	OPT_END()
+};
+
+static const char * const bench_kernel_lock_usage[] = {
+	"perf bench kernel-lock <type> <options>",
+	NULL
+};
+
+struct klock_side {
+	int		threads;
+	long long	acquired;
+	long long	fail;
+	long long	hist[KLOCK_LAT_BUCKETS];
+};
+
+struct klock_stats {
+	char			type[64];
+	struct klock_side	write;
+	struct klock_side	read;
+	bool			has_read;
+};
+
+static int klock_modprobe(const char *torture_type, const char *cpulist)
+{
+	char args[6][64];
+	const char *argv[32];
+	int argc = 0, nargs = 0;
+
+	argv[argc++] = "modprobe";
+	argv[argc++] = "locktorture";
+
+#define ADD_ARG(fmt, ...) do {						\
+		snprintf(args[nargs], sizeof(args[nargs]), fmt, __VA_ARGS__);	\
+		argv[argc++] = args[nargs++];					\
+	} while (0)
+
+	ADD_ARG("torture_type=%s", torture_type);
+	ADD_ARG("nwriters_stress=%d", nwriters);
+	ADD_ARG("nreaders_stress=%d", nreaders);
+	ADD_ARG("cs_ns=%u", cs_ns);
+	ADD_ARG("ncs_ns=%u", ncs_ns);
+#undef ADD_ARG
+
+	/* Measure steady state contention, not the torture perturbations */
+	argv[argc++] = "acq_lat_hist=1";
+	argv[argc++] = "long_hold=0";
+	argv[argc++] = "stutter=0";
+	argv[argc++] = "shuffle_interval=0";
+	argv[argc++] = "stat_interval=0";
+	argv[argc++] = "rt_boost=0";
+	argv[argc++] = "verbose=0";
+
+	if (cpulist) {
+		static char bind[2][PATH_MAX];
+
+		snprintf(bind[0], sizeof(bind[0]), "bind_writers=%s", cpulist);
+		snprintf(bind[1], sizeof(bind[1]), "bind_readers=%s", cpulist);
+		argv[argc++] = bind[0];
+		argv[argc++] = bind[1];
+	}
+	argv[argc] = NULL;
+
+	return run_command_v_opt(argv, RUN_COMMAND_NO_STDIN);
+}
+
+static void klock_rmmod(void)
+{
+	const char *argv[] = { "modprobe", "-r", "locktorture", NULL };
+
+	run_command_v_opt(argv, RUN_COMMAND_NO_STDIN);
+}
+
+/* Parse one "<side>_<key>: value..." line of the locktorture stats file */
+static void klock_parse_side(struct klock_side *side, const char *key, char *val)
+{
+	int b;
+
+	if (!strcmp(key, "threads")) {
+		side->threads = atoi(val);
+	} else if (!strcmp(key, "acquired")) {
+		side->acquired = atoll(val);
+	} else if (!strcmp(key, "fail")) {
+		side->fail = atoll(val);
+	} else if (!strcmp(key, "lat_ns")) {
+		for (b = 0; b < KLOCK_LAT_BUCKETS && *val; b++)
+			side->hist[b] = strtoll(val, &val, 10);
+	}
+}
+
+static int klock_read_stats(const char *path, struct klock_stats *st)
+{
+	char *line = NULL;
+	size_t len = 0;
+	FILE *fp;
+
+	fp = fopen(path, "r");
+	if (!fp) {
+		fprintf(stderr, "Failed to open %s: %s\n", path, strerror(errno));
+		return -1;
+	}
+
+	while (getline(&line, &len, fp) > 0) {
+		char *val = strchr(line, ':');
+
+		if (!val)
+			continue;
+		*val++ = '\0';
+		val[strcspn(val, "\n")] = '\0';
+
+		if (!strcmp(line, "type")) {
+			snprintf(st->type, sizeof(st->type), "%s", val + 1);
+		} else if (!strncmp(line, "write_", 6)) {
+			klock_parse_side(&st->write, line + 6, val);
+		} else if (!strncmp(line, "read_", 5)) {
+			klock_parse_side(&st->read, line + 5, val);
+			st->has_read = true;
+		}
+	}
+
+	free(line);
+	fclose(fp);
+	return st->type[0] ? 0 : -1;
+}
+
+/*
+ * locktorture buckets are powers of two, bucket b covering [2^b, 2^(b+1))
+ * ns. Fold each one into the finer histogram at its upper bound, the same
+ * value the kernel reports, so the common percentile printing applies.
+ */
+static void klock_to_hist(const struct klock_side *side, struct lat_hist *h)
+{
+	int b;
+
+	for (b = 0; b < KLOCK_LAT_BUCKETS; b++) {
+		u64 v = (2ULL << b) - 1;
+
+		if (!side->hist[b])
+			continue;
+		h->bucket[lat_idx(v)] += side->hist[b];
+		h->count += side->hist[b];
+		h->sum += side->hist[b] * ((3ULL << b) / 2);
+		h->max = v;
+	}
+}
+
+static void klock_print(const struct klock_stats *st, const char *name,
+			const struct klock_side *side, double secs)
+{
+	struct lat_hist *h = zalloc(sizeof(*h));
+
+	if (!h)
+		return;
+
+	klock_to_hist(side, h);
+
+	if (bench_format == BENCH_FORMAT_SIMPLE) {
+		printf("kernel-lock type=%s side=%s threads=%d ops_per_sec=%.0f fail=%lld",
+		       st->type, name, side->threads, side->acquired / secs, side->fail);
+	} else {
+		printf(" %14s: %d\n", name, side->threads);
+		printf(" %14s: %'.0f ops/sec\n", "throughput", side->acquired / secs);
+		printf(" %14s: %'.0f ops/sec\n", "per thread",
+		       side->threads ? side->acquired / secs / side->threads : 0.0);
+		if (side->fail)
+			printf(" %14s: %lld\n", "failures", side->fail);
+	}
+	lat_hist__print(h);
+	free(h);
+}
+
+/* The CPUs of @node, as a cpu-list string */
+static char *klock_node_cpus(int nid)
+{
+	char path[PATH_MAX], *buf = NULL;
+	size_t len;
+
+	snprintf(path, sizeof(path), "devices/system/node/node%d/cpulist", nid);
+	if (sysfs__read_str(path, &buf, &len) < 0)
+		return NULL;
+	buf[strcspn(buf, "\n")] = '\0';
+	return buf;
+}
+
+static int bench_kernel_lock(const char *torture_type, int argc, const char **argv)
+{
+	struct klock_stats st = {};
+	char path[PATH_MAX], *node_cpus = NULL;
+	const char *cpulist = cpus, *debugfs;
+	u64 start;
+	double secs;
+	int ret;
+
+	argc = parse_options(argc, argv, options, bench_kernel_lock_usage, 0);
+	if (argc)
+		usage_with_options(bench_kernel_lock_usage, options);
+
+	debugfs = debugfs__mountpoint();
+	if (!debugfs) {
+		fprintf(stderr, "debugfs is not mounted\n");
+		return -1;
+	}
+
+	if (node >= 0) {
+		node_cpus = klock_node_cpus(node);
+		if (!node_cpus) {
+			fprintf(stderr, "Cannot find the CPUs of node %d\n", node);
+			return -1;
+		}
+		cpulist = node_cpus;
+	}
+
+	if (!access("/sys/module/locktorture", F_OK)) {
+		fprintf(stderr, "locktorture is already loaded, not touching it\n");
+		ret = -1;
+		goto out;
+	}
+
+	ret = klock_modprobe(torture_type, cpulist);
+	if (ret) {
+		fprintf(stderr, "Failed to load locktorture, it needs root and CONFIG_LOCK_TORTURE_TEST=m\n");
+		ret = -1;
+		goto out;
+	}
+	start = lat_now();
+
+	sleep(runtime);
+
+	snprintf(path, sizeof(path), "%s/locktorture/stats", debugfs);
+	ret = klock_read_stats(path, &st);
+	secs = (lat_now() - start) / 1e9;
+	klock_rmmod();
+	if (ret)
+		goto out;
+
+	if (bench_format != BENCH_FORMAT_SIMPLE) {
+		printf("# %s for %.1f secs%s%s\n", st.type, secs,
+		       cpulist ? " on CPUs " : "", cpulist ?: "");
+		printf("\n");
+	}
+	klock_print(&st, "writers", &st.write, secs);
+	if (st.has_read) {
+		if (bench_format != BENCH_FORMAT_SIMPLE)
+			printf("\n");
+		klock_print(&st, "readers", &st.read, secs);
+	}
+out:
+	free(node_cpus);
+	return ret;
+}
+
+int bench_kernel_lock_spin(int argc, const char **argv)
+{
+	return bench_kernel_lock("spin_lock", argc, argv);
+}
+
+int bench_kernel_lock_rwlock(int argc, const char **argv)
+{
+	return bench_kernel_lock("rw_lock", argc, argv);
+}
+
+int bench_kernel_lock_mutex(int argc, const char **argv)
+{
+	return bench_kernel_lock("mutex_lock", argc, argv);
+}
+
+int bench_kernel_lock_rtmutex(int argc, const char **argv)
+{
+	return bench_kernel_lock("rtmutex_lock", argc, argv);
+}
+
+int bench_kernel_lock_rwsem(int argc, const char **argv)
+{
+	return bench_kernel_lock("rwsem_lock", argc, argv);
+}
+
+int bench_kernel_lock_percpu_rwsem(int argc, const char **argv)
+{
+	return bench_kernel_lock("percpu_rwsem_lock", argc, argv);
+}
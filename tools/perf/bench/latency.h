@@ -0,0 +1,121 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * Latency histogram shared by the I/O and network benchmarks.
+ *
+ * Values (nanoseconds) are kept in log-linear buckets: 16 linear sub-buckets
+ * per power of two, which bounds the error of a reported percentile to about
+ * 6% while keeping the histogram small enough to have one per thread.
+ */
+#ifndef _BENCH_LATENCY_H
+#define _BENCH_LATENCY_H
+
+#include <linux/bitops.h>
+#include <linux/kernel.h>
+#include <linux/types.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "bench.h"
+
+#define LAT_SUB_BITS	4
+#define LAT_SUB		(1 << LAT_SUB_BITS)
+#define LAT_BUCKETS	((64 - LAT_SUB_BITS + 1) * LAT_SUB)
+
+struct lat_hist {
+	u64	count;
+	u64	sum;
+	u64	max;
+	u64	bucket[LAT_BUCKETS];
+};
+
+static inline u64 lat_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (u64)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static inline unsigned int lat_idx(u64 v)
+{
+	unsigned int shift;
+
+	if (v < LAT_SUB)
+		return v;
+
+	shift = fls64(v) - 1 - LAT_SUB_BITS;
+	return (shift + 1) * LAT_SUB + ((v >> shift) & (LAT_SUB - 1));
+}
+
+/* Upper bound of the values counted in bucket @idx */
+static inline u64 lat_val(unsigned int idx)
+{
+	unsigned int shift;
+
+	if (idx < LAT_SUB)
+		return idx;
+
+	shift = idx / LAT_SUB - 1;
+	return ((u64)(LAT_SUB + idx % LAT_SUB) << shift) + (1ULL << shift) - 1;
+}
+
+static inline void lat_hist__add(struct lat_hist *h, u64 v)
+{
+	h->bucket[lat_idx(v)]++;
+	h->count++;
+	h->sum += v;
+	if (v > h->max)
+		h->max = v;
+}
+
+static inline void lat_hist__merge(struct lat_hist *dst, const struct lat_hist *src)
+{
+	unsigned int i;
+
+	for (i = 0; i < LAT_BUCKETS; i++)
+		dst->bucket[i] += src->bucket[i];
+	dst->count += src->count;
+	dst->sum += src->sum;
+	if (src->max > dst->max)
+		dst->max = src->max;
+}
+
+/* @pct in per mille, so 999 is the 99.9th percentile */
+static inline u64 lat_hist__pct(const struct lat_hist *h, unsigned int pct)
+{
+	u64 rank = (h->count * pct + 999) / 1000, seen = 0;
+	unsigned int i;
+
+	for (i = 0; i < LAT_BUCKETS; i++) {
+		seen += h->bucket[i];
+		if (seen >= rank && seen)
+			return lat_val(i) < h->max ? lat_val(i) : h->max;
+	}
+	return h->max;
+}
+
+/*
+ * Print the latency percentiles in usecs, either human readable or, with
+ * the simple format, as key=value pairs on the current line.
+ */
+static inline void lat_hist__print(const struct lat_hist *h)
+{
+	static const unsigned int pcts[] = { 500, 900, 990, 999 };
+	static const char * const names[] = { "p50", "p90", "p99", "p99.9" };
+	unsigned int i;
+
+	if (bench_format == BENCH_FORMAT_SIMPLE) {
+		for (i = 0; i < ARRAY_SIZE(pcts); i++)
+			printf(" %s_us=%.2f", names[i], lat_hist__pct(h, pcts[i]) / 1000.0);
+		printf(" max_us=%.2f\n", h->max / 1000.0);
+		return;
+	}
+
+	printf(" %14s: %.2f usecs\n", "avg latency",
+	       h->count ? (double)h->sum / h->count / 1000.0 : 0.0);
+	for (i = 0; i < ARRAY_SIZE(pcts); i++)
+		printf(" %14s: %.2f usecs\n", names[i], lat_hist__pct(h, pcts[i]) / 1000.0);
+	printf(" %14s: %.2f usecs\n", "max", h->max / 1000.0);
+}
+
+#endif /* _BENCH_LATENCY_H */
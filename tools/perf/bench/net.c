@@ -0,0 +1,589 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * net.c
+ *
+ * net: Benchmarks for the socket transmit paths
+ *
+ *  stream: bulk transfer over TCP loopback or an AF_UNIX socketpair, comparing
+ *          plain send(2), MSG_ZEROCOPY and vmsplice(2) + splice(2)
+ *  packet: AF_PACKET TX_RING to RX_RING frame rates over the loopback device
+ */
+#include <subcmd/parse-options.h>
+#include "bench.h"
+#include "latency.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <linux/compiler.h>
+#include <linux/errqueue.h>
+#include <linux/if_ether.h>
+#include <linux/if_packet.h>
+#include <linux/kernel.h>
+#include <linux/zalloc.h>
+
+#ifndef SO_ZEROCOPY
+#define SO_ZEROCOPY		60
+#endif
+#ifndef MSG_ZEROCOPY
+#define MSG_ZEROCOPY		0x4000000
+#endif
+#ifndef SO_EE_ORIGIN_ZEROCOPY
+#define SO_EE_ORIGIN_ZEROCOPY	5
+#endif
+#ifndef SO_EE_CODE_ZEROCOPY_COPIED
+#define SO_EE_CODE_ZEROCOPY_COPIED	1
+#endif
+
+/* IEEE 802 local experimental ethertype, nothing else on lo listens for it */
+#define ETH_P_BENCH		0x88b5
+
+static const char	*family_str = "tcp";
+static const char	*modes_str = "send,zerocopy,splice";
+static unsigned int	msg_size = 65536;
+static unsigned int	runtime = 2;
+
+static const struct option stream_options[] = {
+	OPT_STRING('F', "family", &family_str, "tcp|unix", "Socket family to stream over"),
+	OPT_STRING('m', "mode", &modes_str, "mode,...", "Transmit modes: send, zerocopy, splice"),
+	OPT_UINTEGER('s', "size", &msg_size, "Bytes per transmit call"),
+	OPT_UINTEGER('r', "runtime", &runtime, "Runtime in seconds of each measurement"),
+	OPT_END()
+};
+
+static const char	*ifname = "lo";
+static unsigned int	frame_len = 64;
+static unsigned int	tx_batch = 32;
+
+static const struct option packet_options[] = {
+	OPT_STRING('i', "interface", &ifname, "name", "Interface to send and receive on"),
+	OPT_UINTEGER('l', "length", &frame_len, "Frame length in bytes"),
+	OPT_UINTEGER('B', "batch", &tx_batch, "Frames queued per send(2) kick"),
+	OPT_UINTEGER('r', "runtime", &runtime, "Runtime in seconds"),
+	OPT_END()
+};
+
+static const char * const bench_net_stream_usage[] = {
+	"perf bench net stream <options>",
+	NULL
+};
+
+static const char * const bench_net_packet_usage[] = {
+	"perf bench net packet <options>",
+	NULL
+};
+
+enum stream_mode {
+	STREAM_SEND,
+	STREAM_ZEROCOPY,
+	STREAM_SPLICE,
+};
+
+static const char * const stream_mode_names[] = {
+	[STREAM_SEND]		= "send",
+	[STREAM_ZEROCOPY]	= "zerocopy",
+	[STREAM_SPLICE]		= "splice",
+};
+
+struct stream_sink {
+	pthread_t		thread;
+	int			fd;
+	u64			bytes;
+};
+
+static void *stream_sink_fn(void *arg)
+{
+	struct stream_sink *sink = arg;
+	size_t len = max(msg_size, 1U << 16);
+	char *buf = malloc(len);
+	ssize_t ret;
+
+	if (!buf)
+		return NULL;
+
+	while ((ret = recv(sink->fd, buf, len, 0)) > 0)
+		sink->bytes += ret;
+
+	free(buf);
+	return NULL;
+}
+
+static int stream_connect(bool unix_family, int *tx, int *rx)
+{
+	struct sockaddr_in addr = {
+		.sin_family	 = AF_INET,
+		.sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+	};
+	socklen_t len = sizeof(addr);
+	int sv[2], lfd;
+
+	if (unix_family) {
+		if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0)
+			return -errno;
+		*tx = sv[0];
+		*rx = sv[1];
+		return 0;
+	}
+
+	lfd = socket(AF_INET, SOCK_STREAM, 0);
+	if (lfd < 0)
+		return -errno;
+	if (bind(lfd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+	    getsockname(lfd, (struct sockaddr *)&addr, &len) < 0 ||
+	    listen(lfd, 1) < 0)
+		goto err;
+
+	*tx = socket(AF_INET, SOCK_STREAM, 0);
+	if (*tx < 0)
+		goto err;
+	if (connect(*tx, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		close(*tx);
+		goto err;
+	}
+	*rx = accept(lfd, NULL, NULL);
+	if (*rx < 0) {
+		close(*tx);
+		goto err;
+	}
+	close(lfd);
+	return 0;
+err:
+	close(lfd);
+	return -errno;
+}
+
+/*
+ * Reap MSG_ZEROCOPY completions from the error queue. Each notification covers
+ * a range of sends; return how many of them finished, and count the ones the
+ * kernel had to copy anyway in @copied.
+ */
+static unsigned int zerocopy_reap(int fd, bool wait, u64 *copied)
+{
+	char control[CMSG_SPACE(sizeof(struct sock_extended_err))];
+	struct msghdr msg = {};
+	struct cmsghdr *cm;
+	unsigned int done = 0;
+
+	if (wait) {
+		struct pollfd pfd = { .fd = fd, .events = 0 };
+
+		/* POLLERR is always reported, no need to ask for it */
+		poll(&pfd, 1, 100);
+	}
+
+	for (;;) {
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof(control);
+		if (recvmsg(fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0)
+			break;
+
+		for (cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+			struct sock_extended_err *ee = (void *)CMSG_DATA(cm);
+			unsigned int n;
+
+			if (ee->ee_errno || ee->ee_origin != SO_EE_ORIGIN_ZEROCOPY)
+				continue;
+			n = ee->ee_data - ee->ee_info + 1;
+			done += n;
+			if (ee->ee_code & SO_EE_CODE_ZEROCOPY_COPIED)
+				*copied += n;
+		}
+	}
+
+	return done;
+}
+
+static ssize_t stream_splice(int fd, int pipefd[2], void *buf)
+{
+	struct iovec iov = { .iov_base = buf, .iov_len = msg_size };
+	size_t left = msg_size;
+	ssize_t ret;
+
+	while (iov.iov_len) {
+		ret = vmsplice(pipefd[1], &iov, 1, 0);
+		if (ret < 0)
+			return ret;
+		iov.iov_base += ret;
+		iov.iov_len -= ret;
+
+		while (left > iov.iov_len) {
+			ret = splice(pipefd[0], NULL, fd, NULL, left - iov.iov_len,
+				     SPLICE_F_MOVE | SPLICE_F_MORE);
+			if (ret <= 0)
+				return -1;
+			left -= ret;
+		}
+	}
+
+	return msg_size;
+}
+
+static int stream_run(bool unix_family, enum stream_mode mode)
+{
+	u64 start, end, now, sent = 0, copied = 0, calls = 0;
+	unsigned int outstanding = 0;
+	struct stream_sink sink = {};
+	int tx, pipefd[2] = { -1, -1 };
+	struct lat_hist *h;
+	int one = 1, ret;
+	void *buf = NULL;
+
+	ret = stream_connect(unix_family, &tx, &sink.fd);
+	if (ret) {
+		fprintf(stderr, "Failed to set up the %s connection: %s\n",
+			family_str, strerror(-ret));
+		return -1;
+	}
+
+	if (mode == STREAM_ZEROCOPY &&
+	    setsockopt(tx, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) < 0) {
+		printf("# stream %s %s: not supported (%s), skipping\n",
+		       family_str, stream_mode_names[mode], strerror(errno));
+		close(tx);
+		close(sink.fd);
+		return 0;
+	}
+
+	if (mode == STREAM_SPLICE) {
+		if (pipe(pipefd) < 0) {
+			close(tx);
+			close(sink.fd);
+			return -1;
+		}
+		fcntl(pipefd[1], F_SETPIPE_SZ, msg_size);
+	}
+
+	h = zalloc(sizeof(*h));
+	if (posix_memalign(&buf, 4096, msg_size) || !h) {
+		ret = -1;
+		goto out;
+	}
+	memset(buf, 0x5a, msg_size);
+
+	if (pthread_create(&sink.thread, NULL, stream_sink_fn, &sink)) {
+		ret = -1;
+		goto out;
+	}
+
+	start = now = lat_now();
+	end = start + runtime * 1000000000ULL;
+	while (now < end) {
+		u64 t0 = now;
+		ssize_t n;
+
+		switch (mode) {
+		case STREAM_ZEROCOPY:
+			n = send(tx, buf, msg_size, MSG_ZEROCOPY);
+			if (n < 0 && errno == ENOBUFS) {
+				/* Out of optmem for notifications, wait for some */
+				outstanding -= zerocopy_reap(tx, true, &copied);
+				now = lat_now();
+				continue;
+			}
+			if (n >= 0)
+				outstanding++;
+			if (outstanding > 64)
+				outstanding -= zerocopy_reap(tx, false, &copied);
+			break;
+		case STREAM_SPLICE:
+			n = stream_splice(tx, pipefd, buf);
+			break;
+		case STREAM_SEND:
+		default:
+			n = send(tx, buf, msg_size, 0);
+			break;
+		}
+		if (n < 0) {
+			fprintf(stderr, "%s failed: %s\n", stream_mode_names[mode],
+				strerror(errno));
+			ret = -1;
+			break;
+		}
+
+		now = lat_now();
+		lat_hist__add(h, now - t0);
+		sent += n;
+		calls++;
+	}
+
+	while (mode == STREAM_ZEROCOPY && outstanding && !ret)
+		outstanding -= min(outstanding, zerocopy_reap(tx, true, &copied));
+
+	shutdown(tx, SHUT_WR);
+	pthread_join(sink.thread, NULL);
+	now = lat_now() - start;
+
+	if (ret)
+		goto out;
+
+	if (bench_format == BENCH_FORMAT_SIMPLE) {
+		printf("stream family=%s mode=%s size=%u gbps=%.3f calls=%llu copied=%llu",
+		       family_str, stream_mode_names[mode], msg_size,
+		       sink.bytes * 8.0 / now, (unsigned long long)calls,
+		       (unsigned long long)copied);
+	} else {
+		printf("# stream over %s using %s, %u bytes per call\n",
+		       family_str, stream_mode_names[mode], msg_size);
+		printf(" %14s: %.3f Gbit/sec\n", "throughput", sink.bytes * 8.0 / now);
+		printf(" %14s: %'llu\n", "calls", (unsigned long long)calls);
+		if (mode == STREAM_ZEROCOPY)
+			printf(" %14s: %'llu\n", "copied", (unsigned long long)copied);
+	}
+	lat_hist__print(h);
+	if (bench_format != BENCH_FORMAT_SIMPLE)
+		printf("\n");
+out:
+	if (pipefd[0] >= 0) {
+		close(pipefd[0]);
+		close(pipefd[1]);
+	}
+	free(buf);
+	free(h);
+	close(tx);
+	close(sink.fd);
+	return ret;
+}
+
+int bench_net_stream(int argc, const char **argv)
+{
+	char *modes, *tok, *saveptr = NULL;
+	bool unix_family;
+	unsigned int i;
+	int ret = 0;
+
+	argc = parse_options(argc, argv, stream_options, bench_net_stream_usage, 0);
+	if (argc || !msg_size)
+		usage_with_options(bench_net_stream_usage, stream_options);
+
+	if (!strcmp(family_str, "unix")) {
+		unix_family = true;
+	} else if (!strcmp(family_str, "tcp")) {
+		unix_family = false;
+	} else {
+		fprintf(stderr, "Unknown family: %s\n", family_str);
+		return -1;
+	}
+
+	modes = strdup(modes_str);
+	if (!modes)
+		return -1;
+
+	for (tok = strtok_r(modes, ",", &saveptr); tok && !ret;
+	     tok = strtok_r(NULL, ",", &saveptr)) {
+		for (i = 0; i < ARRAY_SIZE(stream_mode_names); i++) {
+			if (!strcmp(tok, stream_mode_names[i]))
+				break;
+		}
+		if (i == ARRAY_SIZE(stream_mode_names)) {
+			fprintf(stderr, "Unknown mode: %s\n", tok);
+			ret = -1;
+			break;
+		}
+		ret = stream_run(unix_family, i);
+	}
+
+	free(modes);
+	return ret;
+}
+
+struct packet_ring {
+	int			fd;
+	void			*map;
+	struct tpacket_req	req;
+};
+
+static int packet_ring_open(struct packet_ring *ring, int ifindex, int proto, int opt)
+{
+	struct sockaddr_ll sll = {
+		.sll_family	= AF_PACKET,
+		.sll_protocol	= htons(proto),
+		.sll_ifindex	= ifindex,
+	};
+	int ver = TPACKET_V2;
+
+	ring->fd = socket(AF_PACKET, SOCK_RAW, htons(proto));
+	if (ring->fd < 0)
+		return -errno;
+
+	ring->req.tp_block_size = 16 * 4096;
+	ring->req.tp_block_nr = 16;
+	ring->req.tp_frame_size = TPACKET_ALIGN(TPACKET2_HDRLEN + frame_len);
+	ring->req.tp_frame_nr = ring->req.tp_block_size / ring->req.tp_frame_size *
+				ring->req.tp_block_nr;
+
+	if (setsockopt(ring->fd, SOL_PACKET, PACKET_VERSION, &ver, sizeof(ver)) < 0 ||
+	    setsockopt(ring->fd, SOL_PACKET, opt, &ring->req, sizeof(ring->req)) < 0 ||
+	    bind(ring->fd, (struct sockaddr *)&sll, sizeof(sll)) < 0)
+		goto err;
+
+	ring->map = mmap(NULL, ring->req.tp_block_size * ring->req.tp_block_nr,
+			 PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, 0);
+	if (ring->map == MAP_FAILED)
+		goto err;
+
+	return 0;
+err:
+	close(ring->fd);
+	return -errno;
+}
+
+static void packet_ring_close(struct packet_ring *ring)
+{
+	munmap(ring->map, ring->req.tp_block_size * ring->req.tp_block_nr);
+	close(ring->fd);
+}
+
+static struct tpacket2_hdr *packet_frame(struct packet_ring *ring, unsigned int idx)
+{
+	unsigned int per_block = ring->req.tp_block_size / ring->req.tp_frame_size;
+
+	return ring->map + (idx / per_block) * ring->req.tp_block_size +
+	       (idx % per_block) * ring->req.tp_frame_size;
+}
+
+struct packet_sink {
+	pthread_t		thread;
+	struct packet_ring	ring;
+	bool			done;
+	u64			frames;
+};
+
+static void *packet_sink_fn(void *arg)
+{
+	struct packet_sink *sink = arg;
+	struct pollfd pfd = { .fd = sink->ring.fd, .events = POLLIN };
+	unsigned int idx = 0;
+
+	while (!__atomic_load_n(&sink->done, __ATOMIC_ACQUIRE)) {
+		struct tpacket2_hdr *hdr = packet_frame(&sink->ring, idx);
+
+		if (!(__atomic_load_n(&hdr->tp_status, __ATOMIC_ACQUIRE) & TP_STATUS_USER)) {
+			poll(&pfd, 1, 100);
+			continue;
+		}
+
+		sink->frames++;
+		__atomic_store_n(&hdr->tp_status, TP_STATUS_KERNEL, __ATOMIC_RELEASE);
+		idx = (idx + 1) % sink->ring.req.tp_frame_nr;
+	}
+
+	return NULL;
+}
+
+int bench_net_packet(int argc, const char **argv)
+{
+	u64 start, end, now, frames = 0;
+	struct packet_sink sink = {};
+	struct tpacket_stats stats = {};
+	socklen_t len = sizeof(stats);
+	struct packet_ring tx;
+	unsigned int idx = 0, i;
+	struct lat_hist *h;
+	int ifindex, ret;
+	double secs;
+
+	argc = parse_options(argc, argv, packet_options, bench_net_packet_usage, 0);
+	if (argc || !tx_batch || frame_len < ETH_ZLEN || frame_len > ETH_FRAME_LEN)
+		usage_with_options(bench_net_packet_usage, packet_options);
+
+	ifindex = if_nametoindex(ifname);
+	if (!ifindex) {
+		fprintf(stderr, "Unknown interface: %s\n", ifname);
+		return -1;
+	}
+
+	ret = packet_ring_open(&sink.ring, ifindex, ETH_P_BENCH, PACKET_RX_RING);
+	if (ret == -EPERM) {
+		printf("# packet: needs CAP_NET_RAW, skipping\n");
+		return 0;
+	}
+	if (ret) {
+		fprintf(stderr, "Failed to set up the RX ring: %s\n", strerror(-ret));
+		return -1;
+	}
+
+	/* Protocol 0: the transmit socket should not see its own frames */
+	ret = packet_ring_open(&tx, ifindex, 0, PACKET_TX_RING);
+	if (ret) {
+		fprintf(stderr, "Failed to set up the TX ring: %s\n", strerror(-ret));
+		packet_ring_close(&sink.ring);
+		return -1;
+	}
+	tx_batch = min(tx_batch, tx.req.tp_frame_nr);
+
+	h = zalloc(sizeof(*h));
+	if (!h || pthread_create(&sink.thread, NULL, packet_sink_fn, &sink)) {
+		ret = -1;
+		goto out;
+	}
+
+	start = now = lat_now();
+	end = start + runtime * 1000000000ULL;
+	while (now < end) {
+		u64 t0;
+
+		for (i = 0; i < tx_batch; i++) {
+			struct tpacket2_hdr *hdr = packet_frame(&tx, idx);
+			struct ethhdr *eth;
+
+			/* Still owned by the kernel: kick what we have */
+			if (__atomic_load_n(&hdr->tp_status, __ATOMIC_ACQUIRE) != TP_STATUS_AVAILABLE)
+				break;
+
+			eth = (void *)hdr + TPACKET2_HDRLEN - sizeof(struct sockaddr_ll);
+			memset(eth, 0, frame_len);
+			eth->h_proto = htons(ETH_P_BENCH);
+			hdr->tp_len = frame_len;
+			__atomic_store_n(&hdr->tp_status, TP_STATUS_SEND_REQUEST, __ATOMIC_RELEASE);
+			idx = (idx + 1) % tx.req.tp_frame_nr;
+		}
+
+		t0 = lat_now();
+		if (send(tx.fd, NULL, 0, 0) < 0) {
+			fprintf(stderr, "send failed: %s\n", strerror(errno));
+			ret = -1;
+			break;
+		}
+		now = lat_now();
+		lat_hist__add(h, now - t0);
+		frames += i;
+	}
+
+	__atomic_store_n(&sink.done, true, __ATOMIC_RELEASE);
+	pthread_join(sink.thread, NULL);
+	secs = (lat_now() - start) / 1e9;
+	getsockopt(sink.ring.fd, SOL_PACKET, PACKET_STATISTICS, &stats, &len);
+
+	if (ret)
+		goto out;
+
+	if (bench_format == BENCH_FORMAT_SIMPLE) {
+		printf("packet len=%u batch=%u tx_pps=%.0f rx_pps=%.0f rx_drops=%u",
+		       frame_len, tx_batch, frames / secs, sink.frames / secs,
+		       stats.tp_drops);
+	} else {
+		printf("# packet rings on %s, %u byte frames, %u frames per kick\n",
+		       ifname, frame_len, tx_batch);
+		printf(" %14s: %'.0f frames/sec\n", "TX", frames / secs);
+		printf(" %14s: %'.0f frames/sec\n", "RX", sink.frames / secs);
+		printf(" %14s: %'u\n", "RX drops", stats.tp_drops);
+	}
+	lat_hist__print(h);
+out:
+	free(h);
+	packet_ring_close(&tx);
+	packet_ring_close(&sink.ring);
+	return ret;
+}
@@ -16,6 +16,9 @@
  *  numa  ... NUMA scheduling and MM performance
  *  futex ... Futex performance
  *  epoll ... Event poll performance
+ *  io    ... File and block I/O submission performance
+ *  net   ... Socket transmit path performance
+ *  kernel-lock ... Kernel locking primitive contention
  */
 #include <subcmd/parse-options.h>
 #include "builtin.h"
@@ -89,6 +92,31 @@ static struct bench epoll_benchmarks[] = {
 };
 #endif // HAVE_EVENTFD_SUPPORT
 
+static struct bench io_benchmarks[] = {
+	{ "uring",	"Benchmark io_uring random reads across queue depths",	bench_io_uring	},
+	{ "sync",	"Benchmark pread() random reads",		bench_io_sync		},
+	{ "all",	"Run all I/O benchmarks",			NULL			},
+	{ NULL,		NULL,						NULL			}
+};
+
+static struct bench net_benchmarks[] = {
+	{ "stream",	"Benchmark send, MSG_ZEROCOPY and splice streaming",	bench_net_stream	},
+	{ "packet",	"Benchmark AF_PACKET TX and RX ring rates",	bench_net_packet	},
+	{ "all",	"Run all networking benchmarks",		NULL			},
+	{ NULL,		NULL,						NULL			}
+};
+
+static struct bench kernel_lock_benchmarks[] = {
+	{ "spin",	"Benchmark spinlock contention",		bench_kernel_lock_spin		},
+	{ "rwlock",	"Benchmark rwlock contention",			bench_kernel_lock_rwlock	},
+	{ "mutex",	"Benchmark mutex contention",			bench_kernel_lock_mutex		},
+	{ "rtmutex",	"Benchmark rt_mutex contention",		bench_kernel_lock_rtmutex	},
+	{ "rwsem",	"Benchmark rw_semaphore contention",		bench_kernel_lock_rwsem		},
+	{ "percpu-rwsem", "Benchmark percpu_rw_semaphore contention",	bench_kernel_lock_percpu_rwsem	},
+	{ "all",	"Run all kernel lock benchmarks",		NULL				},
+	{ NULL,		NULL,						NULL				}
+};
+
 static struct bench internals_benchmarks[] = {
 	{ "synthesize", "Benchmark perf event synthesis",	bench_synthesize	},
 	{ "kallsyms-parse", "Benchmark kallsyms parsing",	bench_kallsyms_parse	},
@@ -131,6 +159,9 @@ static struct collection collections[] = {
 #ifdef HAVE_EVENTFD_SUPPORT
 	{"epoll",       "Epoll stressing benchmarks",                   epoll_benchmarks        },
 #endif
+	{ "io",		"I/O path benchmarks",				io_benchmarks		},
+	{ "net",	"Networking benchmarks",			net_benchmarks		},
+	{ "kernel-lock", "Kernel lock contention benchmarks (locktorture)", kernel_lock_benchmarks },
 	{ "internals",	"Perf-internals benchmarks",			internals_benchmarks	},
 	{ "breakpoint",	"Breakpoint benchmarks",			breakpoint_benchmarks	},
 	{ "uprobe",	"uprobe benchmarks",				uprobe_benchmarks	},
@@ -205,6 +205,12 @@ static int record__threads_enabled(struct record *rec)
 	return rec->opts.threads_spec;
 }
 
+/*
+ * Number of CPUs from which on system wide recording defaults to parallel
+ * streaming, 0 disables it. Set with the record.threads-auto-cpus config.
+ */
+static int record_threads_auto_cpus = 128;
+
 static bool switch_output_signal(struct record *rec)
 {
 	return rec->switch_output.signal &&
@@ -2964,6 +2970,8 @@ static int perf_record_config(const char *var, const char *value, void *cb)
 			return -ENOMEM;
 		rec->debuginfod.set = true;
 	}
+	if (!strcmp(var, "record.threads-auto-cpus"))
+		return perf_config_int(&record_threads_auto_cpus, var, value);
 
 	return 0;
 }
@@ -3036,7 +3044,13 @@ static int record__parse_threads(const struct option *opt, const char *str, int
 	int s;
 	struct record_opts *opts = opt->value;
 
-	if (unset || !str || !strlen(str)) {
+	opts->threads_set = true;
+	if (unset) {
+		opts->threads_spec = THREAD_SPEC__UNDEFINED;
+		return 0;
+	}
+
+	if (!str || !strlen(str)) {
 		opts->threads_spec = THREAD_SPEC__CPU;
 	} else {
 		for (s = 1; s < THREAD_SPEC__MAX; s++) {
@@ -3927,6 +3941,46 @@ static int record__init_thread_default_masks(struct record *rec, struct perf_cpu
 	return 0;
 }
 
+/*
+ * With many CPUs a single reader can't keep up with the ring buffers at high
+ * sample rates and events get lost, so make system wide recording default to
+ * a reader thread per CPU there, unless --threads/--no-threads was given or
+ * an option is used that doesn't work in parallel streaming mode.
+ */
+static void record__auto_threads(struct record *rec)
+{
+	struct record_opts *opts = &rec->opts;
+	struct evsel *evsel;
+	struct stat st;
+
+	if (opts->threads_set || record_threads_auto_cpus <= 0)
+		return;
+
+	if (!opts->target.system_wide ||
+	    cpu__max_present_cpu().cpu < record_threads_auto_cpus)
+		return;
+
+	/* Parallel streaming writes a directory, which a pipe can't carry */
+	if (rec->data.path ? !strcmp(rec->data.path, "-") :
+	    !fstat(STDOUT_FILENO, &st) && S_ISFIFO(st.st_mode))
+		return;
+
+	if (opts->affinity != PERF_AFFINITY_SYS || record__aio_enabled(rec) ||
+	    opts->auxtrace_snapshot_opts || opts->auxtrace_sample_opts ||
+	    rec->switch_output.set || rec->switch_output_event_set ||
+	    rec->timestamp_filename)
+		return;
+
+	evlist__for_each_entry(rec->evlist, evsel) {
+		if (evsel__is_aux_event(evsel))
+			return;
+	}
+
+	opts->threads_spec = THREAD_SPEC__CPU;
+	pr_debug("threads_spec: %s (default for %d CPUs)\n",
+		 thread_spec_tags[opts->threads_spec], cpu__max_present_cpu().cpu);
+}
+
 static int record__init_thread_masks(struct record *rec)
 {
 	int ret = 0;
@@ -4034,6 +4088,8 @@ int cmd_record(int argc, const char **argv)
 	if (rec->opts.kcore)
 		rec->opts.text_poke = true;
 
+	record__auto_threads(rec);
+
 	if (rec->opts.kcore || record__threads_enabled(rec))
 		rec->data.is_dir = true;
 
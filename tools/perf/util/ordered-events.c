@@ -1,9 +1,11 @@
 // SPDX-License-Identifier: GPL-2.0
 #include <errno.h>
 #include <inttypes.h>
+#include <stdlib.h>
 #include <linux/list.h>
 #include <linux/compiler.h>
 #include <linux/string.h>
+#include <linux/zalloc.h>
 #include "ordered-events.h"
 #include "session.h"
 #include "asm/bug.h"
@@ -15,50 +17,184 @@
 
 #define pr(fmt, ...) pr_N(1, pr_fmt(fmt), ##__VA_ARGS__)
 
-static void queue_event(struct ordered_events *oe, struct ordered_event *new)
+/*
+ * Events mostly come in runs which are in order, one for each ring buffer
+ * read, but the runs of different CPUs overlap in time. Inserting them all
+ * into a single list means walking over the events of every other CPU for
+ * each run, which gets quadratic with the number of CPUs. Instead each run
+ * goes into its own time sorted shard and the shards are merged on flush.
+ */
+#define OE_MAX_SHARDS	1024
+
+static struct ordered_event *shard__first(struct ordered_events_shard *shard)
+{
+	return list_first_entry(&shard->events, struct ordered_event, list);
+}
+
+static struct ordered_event *shard__last(struct ordered_events_shard *shard)
 {
-	struct ordered_event *last = oe->last;
+	return list_last_entry(&shard->events, struct ordered_event, list);
+}
+
+static int ordered_events__add_shard(struct ordered_events *oe)
+{
+	struct ordered_events_shard *shard;
+
+	if (oe->nr_shards == oe->alloc_shards) {
+		unsigned int alloc = oe->alloc_shards ? oe->alloc_shards * 2 : 16;
+		struct ordered_events_shard **shards;
+		unsigned int *heap;
+
+		if (oe->alloc_shards >= OE_MAX_SHARDS)
+			return -1;
+
+		shards = realloc(oe->shards, alloc * sizeof(*shards));
+		if (!shards)
+			return -1;
+		oe->shards = shards;
+
+		heap = realloc(oe->heap, alloc * sizeof(*heap));
+		if (!heap)
+			return -1;
+		oe->heap = heap;
+
+		oe->alloc_shards = alloc;
+	}
+
+	shard = malloc(sizeof(*shard));
+	if (!shard)
+		return -1;
+
+	INIT_LIST_HEAD(&shard->events);
+	oe->shards[oe->nr_shards] = shard;
+	return oe->nr_shards++;
+}
+
+/*
+ * Pick the shard to queue an event with @timestamp into: the current one if
+ * the event just extends it, else the shard with the latest last event that
+ * is still not after @timestamp, else an empty or new one. When we run out
+ * of shards the event gets inserted into the one where that is the cheapest.
+ */
+static int ordered_events__select_shard(struct ordered_events *oe, u64 timestamp)
+{
+	int i, best = -1, empty = -1, fallback = -1;
+	u64 best_ts = 0, fallback_ts = 0;
+
+	i = oe->cur_shard;
+	if (i >= 0 && (list_empty(&oe->shards[i]->events) ||
+		       shard__last(oe->shards[i])->timestamp <= timestamp))
+		return i;
+
+	for (i = 0; i < (int)oe->nr_shards; i++) {
+		struct ordered_events_shard *shard = oe->shards[i];
+		u64 last;
+
+		if (list_empty(&shard->events)) {
+			if (empty < 0)
+				empty = i;
+			continue;
+		}
+
+		last = shard__last(shard)->timestamp;
+		if (last <= timestamp) {
+			if (best < 0 || last > best_ts) {
+				best = i;
+				best_ts = last;
+			}
+		} else if (fallback < 0 || last < fallback_ts) {
+			fallback = i;
+			fallback_ts = last;
+		}
+	}
+
+	if (best >= 0)
+		return best;
+	if (empty >= 0)
+		return empty;
+
+	i = ordered_events__add_shard(oe);
+	return i >= 0 ? i : fallback;
+}
+
+static void queue_event(struct ordered_events *oe, int idx,
+			struct ordered_event *new)
+{
+	struct ordered_events_shard *shard = oe->shards[idx];
 	u64 timestamp = new->timestamp;
-	struct list_head *p;
+	struct ordered_event *iter;
+
+	if (!oe->nr_events || timestamp > oe->max_timestamp)
+		oe->max_timestamp = timestamp;
 
 	++oe->nr_events;
+	new->seq = oe->seq++;
+	oe->cur_shard = idx;
 	oe->last = new;
 
 	pr_oe_time2(timestamp, "queue_event nr_events %u\n", oe->nr_events);
 
-	if (!last) {
-		list_add(&new->list, &oe->events);
-		oe->max_timestamp = timestamp;
-		return;
+	/* Usually we just append, else walk back to where the event belongs */
+	list_for_each_entry_reverse(iter, &shard->events, list) {
+		if (iter->timestamp <= timestamp) {
+			list_add(&new->list, &iter->list);
+			return;
+		}
 	}
+	list_add(&new->list, &shard->events);
+}
 
-	/*
-	 * last event might point to some random place in the list as it's
-	 * the last queued event. We expect that the new event is close to
-	 * this.
-	 */
-	if (last->timestamp <= timestamp) {
-		while (last->timestamp <= timestamp) {
-			p = last->list.next;
-			if (p == &oe->events) {
-				list_add_tail(&new->list, &oe->events);
-				oe->max_timestamp = timestamp;
-				return;
-			}
-			last = list_entry(p, struct ordered_event, list);
-		}
-		list_add_tail(&new->list, &last->list);
-	} else {
-		while (last->timestamp > timestamp) {
-			p = last->list.prev;
-			if (p == &oe->events) {
-				list_add(&new->list, &oe->events);
-				return;
-			}
-			last = list_entry(p, struct ordered_event, list);
-		}
-		list_add(&new->list, &last->list);
+/* Shard @a has an earlier first event than shard @b */
+static bool ordered_events__shard_before(struct ordered_events *oe,
+					 unsigned int a, unsigned int b)
+{
+	struct ordered_event *ea = shard__first(oe->shards[a]);
+	struct ordered_event *eb = shard__first(oe->shards[b]);
+
+	if (ea->timestamp != eb->timestamp)
+		return ea->timestamp < eb->timestamp;
+
+	/* Keep events with the same time in the order they were queued */
+	return ea->seq < eb->seq;
+}
+
+static void ordered_events__heap_down(struct ordered_events *oe,
+				      unsigned int nr, unsigned int pos)
+{
+	unsigned int *heap = oe->heap;
+
+	for (;;) {
+		unsigned int child = 2 * pos + 1, tmp;
+
+		if (child >= nr)
+			break;
+		if (child + 1 < nr &&
+		    ordered_events__shard_before(oe, heap[child + 1], heap[child]))
+			child++;
+		if (!ordered_events__shard_before(oe, heap[child], heap[pos]))
+			break;
+
+		tmp = heap[pos];
+		heap[pos] = heap[child];
+		heap[child] = tmp;
+		pos = child;
+	}
+}
+
+/* Build a min-heap of the non empty shards ordered by their first event */
+static unsigned int ordered_events__heap_init(struct ordered_events *oe)
+{
+	unsigned int i, nr = 0;
+
+	for (i = 0; i < oe->nr_shards; i++) {
+		if (!list_empty(&oe->shards[i]->events))
+			oe->heap[nr++] = i;
 	}
+
+	for (i = nr / 2; i-- > 0; )
+		ordered_events__heap_down(oe, nr, i);
+
+	return nr;
 }
 
 static union perf_event *__dup_event(struct ordered_events *oe,
@@ -173,11 +309,16 @@ ordered_events__new_event(struct ordered_events *oe, u64 timestamp,
 		    union perf_event *event)
 {
 	struct ordered_event *new;
+	int idx;
+
+	idx = ordered_events__select_shard(oe, timestamp);
+	if (idx < 0)
+		return NULL;
 
 	new = alloc_event(oe, event);
 	if (new) {
 		new->timestamp = timestamp;
-		queue_event(oe, new);
+		queue_event(oe, idx, new);
 	}
 
 	return new;
@@ -221,13 +362,49 @@ int ordered_events__queue(struct ordered_events *oe, union perf_event *event,
 	return 0;
 }
 
+/* Return the earliest queued event, NULL if there is none */
+static struct ordered_event *ordered_events__first(struct ordered_events *oe)
+{
+	struct ordered_event *first = NULL, *event;
+	unsigned int i;
+
+	for (i = 0; i < oe->nr_shards; i++) {
+		if (list_empty(&oe->shards[i]->events))
+			continue;
+
+		event = shard__first(oe->shards[i]);
+		if (!first || event->timestamp < first->timestamp)
+			first = event;
+	}
+
+	return first;
+}
+
+/* Return the queued event with the latest time, NULL if there is none */
+static struct ordered_event *ordered_events__latest(struct ordered_events *oe)
+{
+	struct ordered_event *latest = NULL, *event;
+	unsigned int i;
+
+	for (i = 0; i < oe->nr_shards; i++) {
+		if (list_empty(&oe->shards[i]->events))
+			continue;
+
+		event = shard__last(oe->shards[i]);
+		if (!latest || event->timestamp > latest->timestamp ||
+		    (event->timestamp == latest->timestamp && event->seq > latest->seq))
+			latest = event;
+	}
+
+	return latest;
+}
+
 static int do_flush(struct ordered_events *oe, bool show_progress)
 {
-	struct list_head *head = &oe->events;
-	struct ordered_event *tmp, *iter;
 	u64 limit = oe->next_flush;
 	u64 last_ts = oe->last ? oe->last->timestamp : 0ULL;
 	struct ui_progress prog;
+	unsigned int nr;
 	int ret;
 
 	if (!limit)
@@ -236,7 +413,12 @@ static int do_flush(struct ordered_events *oe, bool show_progress)
 	if (show_progress)
 		ui_progress__init(&prog, oe->nr_events, "Processing time ordered events...");
 
-	list_for_each_entry_safe(iter, tmp, head, list) {
+	nr = ordered_events__heap_init(oe);
+	while (nr) {
+		struct ordered_events_shard *shard = oe->shards[oe->heap[0]];
+		struct ordered_event *iter = shard__first(shard);
+		u64 seq = oe->seq;
+
 		if (session_done())
 			return 0;
 
@@ -251,12 +433,22 @@ static int do_flush(struct ordered_events *oe, bool show_progress)
 
 		if (show_progress)
 			ui_progress__update(&prog, 1);
+
+		/* Delivery queued more events, the shard heads may have moved */
+		if (oe->seq != seq) {
+			nr = ordered_events__heap_init(oe);
+			continue;
+		}
+
+		if (list_empty(&shard->events))
+			oe->heap[0] = oe->heap[--nr];
+		ordered_events__heap_down(oe, nr, 0);
 	}
 
-	if (list_empty(head))
+	if (!oe->nr_events)
 		oe->last = NULL;
 	else if (last_ts <= limit)
-		oe->last = list_entry(head->prev, struct ordered_event, list);
+		oe->last = ordered_events__latest(oe);
 
 	if (show_progress)
 		ui_progress__finish();
@@ -292,13 +484,12 @@ static int __ordered_events__flush(struct ordered_events *oe, enum oe_flush how,
 	case OE_FLUSH__HALF:
 	{
 		struct ordered_event *first, *last;
-		struct list_head *head = &oe->events;
 
-		first = list_entry(head->next, struct ordered_event, list);
+		first = ordered_events__first(oe);
 		last = oe->last;
 
 		/* Warn if we are called before any event got allocated. */
-		if (WARN_ONCE(!last || list_empty(head), "empty queue"))
+		if (WARN_ONCE(!last || !first, "empty queue"))
 			return 0;
 
 		oe->next_flush  = first->timestamp;
@@ -349,19 +540,19 @@ int ordered_events__flush_time(struct ordered_events *oe, u64 timestamp)
 
 u64 ordered_events__first_time(struct ordered_events *oe)
 {
-	struct ordered_event *event;
-
-	if (list_empty(&oe->events))
-		return 0;
+	struct ordered_event *event = ordered_events__first(oe);
 
-	event = list_first_entry(&oe->events, struct ordered_event, list);
-	return event->timestamp;
+	return event ? event->timestamp : 0;
 }
 
 void ordered_events__init(struct ordered_events *oe, ordered_events__deliver_t deliver,
 			  void *data)
 {
-	INIT_LIST_HEAD(&oe->events);
+	oe->shards = NULL;
+	oe->heap = NULL;
+	oe->nr_shards = 0;
+	oe->alloc_shards = 0;
+	oe->cur_shard = -1;
 	INIT_LIST_HEAD(&oe->cache);
 	INIT_LIST_HEAD(&oe->to_free);
 	oe->max_alloc_size = (u64) -1;
@@ -387,6 +578,15 @@ ordered_events_buffer__free(struct ordered_events_buffer *buffer,
 void ordered_events__free(struct ordered_events *oe)
 {
 	struct ordered_events_buffer *buffer, *tmp;
+	unsigned int i;
+
+	for (i = 0; i < oe->nr_shards; i++)
+		free(oe->shards[i]);
+	zfree(&oe->shards);
+	zfree(&oe->heap);
+	oe->nr_shards = 0;
+	oe->alloc_shards = 0;
+	oe->cur_shard = -1;
 
 	if (list_empty(&oe->to_free))
 		return;
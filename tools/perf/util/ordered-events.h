@@ -8,6 +8,7 @@ struct perf_sample;
 
 struct ordered_event {
 	u64			timestamp;
+	u64			seq;
 	u64			file_offset;
 	const char		*file_path;
 	union perf_event	*event;
@@ -33,13 +34,27 @@ struct ordered_events_buffer {
 	struct ordered_event	event[];
 };
 
+/*
+ * Queued events are kept in several time sorted lists, each holding runs of
+ * events that arrived in order (typically the events of one CPU's ring
+ * buffer), and merged when flushed.
+ */
+struct ordered_events_shard {
+	struct list_head	events;
+};
+
 struct ordered_events {
 	u64				 last_flush;
 	u64				 next_flush;
 	u64				 max_timestamp;
 	u64				 max_alloc_size;
 	u64				 cur_alloc_size;
-	struct list_head		 events;
+	u64				 seq;
+	struct ordered_events_shard	**shards;
+	unsigned int			*heap;
+	unsigned int			 nr_shards;
+	unsigned int			 alloc_shards;
+	int				 cur_shard;
 	struct list_head		 cache;
 	struct list_head		 to_free;
 	struct ordered_events_buffer	*buffer;
@@ -21,6 +21,38 @@ static char *directions[] = {
 	"FROM_DEVICE",
 };
 
+static char *modes[] = {
+	"SINGLE",
+	"SG",
+};
+
+/* upper bound in us of the histogram bucket holding the given percentile */
+static double hist_percentile(__u64 *hist, int percent)
+{
+	__u64 total = 0, sum = 0;
+	int i;
+
+	for (i = 0; i < DMA_MAP_HIST_BUCKETS; i++)
+		total += hist[i];
+
+	for (i = 0; i < DMA_MAP_HIST_BUCKETS; i++) {
+		sum += hist[i];
+		if (sum * 100 >= total * percent)
+			break;
+	}
+
+	if (i == DMA_MAP_HIST_BUCKETS)
+		i--;
+	return (double)(1ULL << (i + 1)) / 1000;
+}
+
+static void print_percentiles(const char *name, __u64 *hist)
+{
+	printf("%s latency percentiles(us): p50<=%.3f p90<=%.3f p99<=%.3f\n",
+	       name, hist_percentile(hist, 50), hist_percentile(hist, 90),
+	       hist_percentile(hist, 99));
+}
+
 int main(int argc, char **argv)
 {
 	struct map_benchmark map;
@@ -31,10 +63,12 @@ int main(int argc, char **argv)
 	int bits = 32, xdelay = 0, dir = DMA_MAP_BIDIRECTIONAL;
 	/* default granule 1 PAGESIZE */
 	int granule = 1;
+	/* default dma_map_single() with CPU cache maintenance */
+	int mode = DMA_MAP_SINGLE_MODE, skip_sync = 0;
 
 	int cmd = DMA_MAP_BENCHMARK;
 
-	while ((opt = getopt(argc, argv, "t:s:n:b:d:x:g:")) != -1) {
+	while ((opt = getopt(argc, argv, "t:s:n:b:d:x:g:m:a")) != -1) {
 		switch (opt) {
 		case 't':
 			threads = atoi(optarg);
@@ -57,6 +91,12 @@ int main(int argc, char **argv)
 		case 'g':
 			granule = atoi(optarg);
 			break;
+		case 'm':
+			mode = atoi(optarg);
+			break;
+		case 'a':
+			skip_sync = 1;
+			break;
 		default:
 			return -1;
 		}
@@ -97,6 +137,11 @@ int main(int argc, char **argv)
 		exit(1);
 	}
 
+	if (mode != DMA_MAP_SINGLE_MODE && mode != DMA_MAP_SG_MODE) {
+		fprintf(stderr, "invalid map mode\n");
+		exit(1);
+	}
+
 	fd = open("/sys/kernel/debug/dma_map_benchmark", O_RDWR);
 	if (fd == -1) {
 		perror("open");
@@ -111,18 +156,24 @@ int main(int argc, char **argv)
 	map.dma_dir = dir;
 	map.dma_trans_ns = xdelay;
 	map.granule = granule;
+	map.map_mode = mode;
+	if (skip_sync)
+		map.dma_attrs |= DMA_MAP_ATTR_SKIP_CPU_SYNC;
 
 	if (ioctl(fd, cmd, &map)) {
 		perror("ioctl");
 		exit(1);
 	}
 
-	printf("dma mapping benchmark: threads:%d seconds:%d node:%d dir:%s granule: %d\n",
-			threads, seconds, node, dir[directions], granule);
+	printf("dma mapping benchmark: threads:%d seconds:%d node:%d dir:%s granule: %d mode:%s%s\n",
+			threads, seconds, node, dir[directions], granule,
+			modes[mode], skip_sync ? " skip_cpu_sync" : "");
 	printf("average map latency(us):%.1f standard deviation:%.1f\n",
 			map.avg_map_100ns/10.0, map.map_stddev/10.0);
 	printf("average unmap latency(us):%.1f standard deviation:%.1f\n",
 			map.avg_unmap_100ns/10.0, map.unmap_stddev/10.0);
+	print_percentiles("map", map.map_hist);
+	print_percentiles("unmap", map.unmap_hist);
 
 	return 0;
 }
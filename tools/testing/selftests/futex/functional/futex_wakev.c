@@ -0,0 +1,173 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * futex_wakev() test
+ *
+ * Block a few threads on two private futexes, wake them with futex_wakev()
+ * and check the number of woken waiters, then check the error paths.
+ */
+
+#include <errno.h>
+#include <error.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdint.h>
+#include "futextest.h"
+#include "futex2test.h"
+#include "logging.h"
+
+#define TEST_NAME "futex-wakev"
+#define WAKE_WAIT_US 10000
+#define NR_WAITERS 4
+static futex_t futexes[2];
+static struct futex_waitv wakers[FUTEX_WAITV_MAX + 1];
+
+void usage(char *prog)
+{
+	printf("Usage: %s\n", prog);
+	printf("  -c	Use color\n");
+	printf("  -h	Display this help message\n");
+	printf("  -v L	Verbosity level: %d=QUIET %d=CRITICAL %d=INFO\n",
+	       VQUIET, VCRITICAL, VINFO);
+}
+
+void *waiterfn(void *arg)
+{
+	futex_t *f = arg;
+
+	if (futex_wait(f, 0, NULL, FUTEX_PRIVATE_FLAG))
+		ksft_test_result_fail("futex_wait returned: %d %s\n",
+				      errno, strerror(errno));
+	return NULL;
+}
+
+static void set_waker(int i, futex_t *f, unsigned int nr)
+{
+	wakers[i].uaddr = (uintptr_t)f;
+	wakers[i].flags = FUTEX_32 | FUTEX_PRIVATE_FLAG;
+	wakers[i].val = nr;
+	wakers[i].__reserved = 0;
+}
+
+static int check_wakev(const char *name, int nr, unsigned long flags,
+		       int expected)
+{
+	int res = futex_wakev(wakers, nr, flags);
+
+	if (res != expected) {
+		ksft_test_result_fail("%s returned: %d %s, expecting %d\n",
+				      name, res, res < 0 ? strerror(errno) : "",
+				      expected);
+		return RET_FAIL;
+	}
+	ksft_test_result_pass("%s\n", name);
+	return RET_PASS;
+}
+
+static int check_wakev_error(const char *name, volatile struct futex_waitv *w,
+			     int nr, unsigned long flags, int err)
+{
+	int res = futex_wakev(w, nr, flags);
+
+	if (res != -1 || errno != err) {
+		ksft_test_result_fail("%s returned: %d %s, expecting %s\n",
+				      name, res, res < 0 ? strerror(errno) : "",
+				      strerror(err));
+		return RET_FAIL;
+	}
+	ksft_test_result_pass("%s\n", name);
+	return RET_PASS;
+}
+
+int main(int argc, char *argv[])
+{
+	pthread_t waiters[NR_WAITERS];
+	int ret = RET_PASS;
+	int c, i;
+
+	while ((c = getopt(argc, argv, "cht:v:")) != -1) {
+		switch (c) {
+		case 'c':
+			log_color(1);
+			break;
+		case 'h':
+			usage(basename(argv[0]));
+			exit(0);
+		case 'v':
+			log_verbosity(atoi(optarg));
+			break;
+		default:
+			usage(basename(argv[0]));
+			exit(1);
+		}
+	}
+
+	ksft_print_header();
+	ksft_set_plan(12);
+	ksft_print_msg("%s: Test FUTEX_WAKEV\n",
+		       basename(argv[0]));
+
+	/* Two waiters on each futex */
+	for (i = 0; i < NR_WAITERS; i++) {
+		if (pthread_create(&waiters[i], NULL, waiterfn, &futexes[i % 2]))
+			error(1, errno, "pthread_create failed");
+	}
+
+	usleep(WAKE_WAIT_US);
+
+	/* Wake one of futexes[0] and both of futexes[1] */
+	set_waker(0, &futexes[0], 1);
+	set_waker(1, &futexes[1], 2);
+	ret |= check_wakev("futex_wakev wakes the requested count", 2, 0, 3);
+
+	/* Only one waiter is left, on futexes[0], listed twice */
+	set_waker(0, &futexes[0], 1);
+	set_waker(1, &futexes[0], 1);
+	ret |= check_wakev("futex_wakev with a futex listed twice", 2, 0, 1);
+
+	for (i = 0; i < NR_WAITERS; i++)
+		pthread_join(waiters[i], NULL);
+
+	ret |= check_wakev("futex_wakev without waiters", 2, 0, 0);
+
+	/* Error paths */
+	set_waker(0, &futexes[0], 1);
+	ret |= check_wakev_error("futex_wakev with flags", wakers, 1, 1, EINVAL);
+	ret |= check_wakev_error("futex_wakev with no futexes", wakers, 0, 0,
+				 EINVAL);
+	for (i = 0; i <= FUTEX_WAITV_MAX; i++)
+		set_waker(i, &futexes[0], 1);
+	ret |= check_wakev_error("futex_wakev with too many futexes", wakers,
+				 FUTEX_WAITV_MAX + 1, 0, EINVAL);
+	ret |= check_wakev_error("futex_wakev NULL address in *wakers", NULL, 1,
+				 0, EINVAL);
+	ret |= check_wakev_error("futex_wakev invalid address in *wakers",
+				 (void *)1, 1, 0, EFAULT);
+
+	wakers[0].flags = FUTEX_PRIVATE_FLAG;
+	ret |= check_wakev_error("futex_wakev without FUTEX_32", wakers, 1, 0,
+				 EINVAL);
+
+	set_waker(0, &futexes[0], 1);
+	wakers[0].__reserved = 1;
+	ret |= check_wakev_error("futex_wakev with __reserved set", wakers, 1,
+				 0, EINVAL);
+
+	set_waker(0, &futexes[0], 1);
+	wakers[0].uaddr = (uintptr_t)&futexes[0] + 1;
+	ret |= check_wakev_error("futex_wakev with an unaligned address",
+				 wakers, 1, 0, EINVAL);
+
+	/* A private NULL futex has no waiters, a shared one can't be looked up */
+	set_waker(0, &futexes[0], 1);
+	wakers[0].uaddr = 0;
+	wakers[0].flags = FUTEX_32;
+	ret |= check_wakev_error("futex_wakev NULL address in wakers.uaddr",
+				 wakers, 1, 0, EFAULT);
+
+	ksft_print_cnts();
+	return ret;
+}
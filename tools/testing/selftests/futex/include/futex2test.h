@@ -8,6 +8,10 @@
 
 #define u64_to_ptr(x) ((void *)(uintptr_t)(x))
 
+#ifndef __NR_futex_wakev
+#define __NR_futex_wakev 463
+#endif
+
 /**
  * futex_waitv - Wait at multiple futexes, wake on any
  * @waiters:    Array of waiters
@@ -20,3 +24,15 @@ static inline int futex_waitv(volatile struct futex_waitv *waiters, unsigned lon
 {
 	return syscall(__NR_futex_waitv, waiters, nr_waiters, flags, timo, clockid);
 }
+
+/**
+ * futex_wakev - Wake waiters on multiple futexes
+ * @wakers:    Array of futexes, val is the number of waiters to wake on each
+ * @nr_wakers: Length of wakers array
+ * @flags: Operation flags
+ */
+static inline int futex_wakev(volatile struct futex_waitv *wakers, unsigned long nr_wakers,
+			      unsigned long flags)
+{
+	return syscall(__NR_futex_wakev, wakers, nr_wakers, flags);
+}
@@ -19,6 +19,7 @@
 
 #include "kvm_util.h"
 #include "test_util.h"
+#include "ucall_common.h"
 
 static void test_file_read_write(int fd)
 {
@@ -170,6 +171,106 @@ static void test_create_guest_memfd_multiple(struct kvm_vm *vm)
 	close(fd1);
 }
 
+#ifdef __x86_64__
+static void guest_code(void)
+{
+	GUEST_DONE();
+}
+
+static void hugepage_pre_fault(struct kvm_vcpu *vcpu, uint64_t gpa,
+			       uint64_t size)
+{
+	struct kvm_pre_fault_memory range = {
+		.gpa = gpa,
+		.size = size,
+	};
+	int ret;
+
+	do {
+		ret = __vcpu_ioctl(vcpu, KVM_PRE_FAULT_MEMORY, &range);
+	} while (range.size && (ret >= 0 || errno == EINTR));
+
+	TEST_ASSERT(!ret && !range.size,
+		    "KVM_PRE_FAULT_MEMORY on huge guest_memfd should succeed, 0x%llx bytes left",
+		    range.size);
+}
+
+static void test_hugepage(void)
+{
+	const struct vm_shape shape = {
+		.mode = VM_MODE_DEFAULT,
+		.type = KVM_X86_SW_PROTECTED_VM,
+	};
+	size_t page_size = getpagesize();
+	size_t hpage_size, total_size;
+	struct kvm_vcpu *vcpu;
+	struct kvm_vm *vm;
+	uint64_t gpa;
+	int fd, ret;
+
+	if (!thp_configured() ||
+	    !(kvm_check_cap(KVM_CAP_VM_TYPES) & BIT(KVM_X86_SW_PROTECTED_VM))) {
+		pr_info("Skipping KVM_GUEST_MEMFD_ALLOW_HUGEPAGE tests\n");
+		return;
+	}
+
+	hpage_size = get_trans_hugepagesz();
+	total_size = hpage_size * 2;
+
+	vm = vm_create_shape_with_one_vcpu(shape, &vcpu, guest_code);
+
+	fd = __vm_create_guest_memfd(vm, total_size + page_size,
+				     KVM_GUEST_MEMFD_ALLOW_HUGEPAGE);
+	TEST_ASSERT(fd == -1 && errno == EINVAL,
+		    "huge guest_memfd() with non-huge-page-aligned size should fail with EINVAL");
+
+	fd = vm_create_guest_memfd(vm, total_size, KVM_GUEST_MEMFD_ALLOW_HUGEPAGE);
+
+	ret = fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, total_size);
+	TEST_ASSERT(!ret, "fallocate of huge guest_memfd should succeed");
+
+	ret = fallocate(fd, FALLOC_FL_KEEP_SIZE | FALLOC_FL_PUNCH_HOLE,
+			page_size, page_size);
+	TEST_ASSERT(ret == -1 && errno == EINVAL,
+		    "PUNCH_HOLE inside a huge page should fail with EINVAL");
+
+	ret = fallocate(fd, FALLOC_FL_KEEP_SIZE | FALLOC_FL_PUNCH_HOLE,
+			0, hpage_size + page_size);
+	TEST_ASSERT(ret == -1 && errno == EINVAL,
+		    "PUNCH_HOLE ending inside a huge page should fail with EINVAL");
+
+	ret = fallocate(fd, FALLOC_FL_KEEP_SIZE | FALLOC_FL_PUNCH_HOLE,
+			hpage_size, hpage_size);
+	TEST_ASSERT(!ret, "PUNCH_HOLE of a whole huge page should succeed");
+
+	gpa = align_down((vm->max_gfn + 1) * vm->page_size - total_size,
+			 hpage_size);
+
+	ret = __vm_set_user_memory_region2(vm, 10, KVM_MEM_GUEST_MEMFD, gpa,
+					   hpage_size, 0, fd, page_size);
+	TEST_ASSERT(ret == -1 && errno == EINVAL,
+		    "Binding huge guest_memfd at an unaligned offset should fail with EINVAL");
+
+	vm_mem_add(vm, VM_MEM_SRC_ANONYMOUS, gpa, 10, total_size / vm->page_size,
+		   KVM_MEM_GUEST_MEMFD, fd, 0);
+	vm_mem_set_private(vm, gpa, total_size);
+
+	if (kvm_check_cap(KVM_CAP_PRE_FAULT_MEMORY)) {
+		/* Faults in the punched huge page again, and the intact one */
+		hugepage_pre_fault(vcpu, gpa, total_size);
+
+		ret = fallocate(fd, FALLOC_FL_KEEP_SIZE | FALLOC_FL_PUNCH_HOLE,
+				0, hpage_size);
+		TEST_ASSERT(!ret, "PUNCH_HOLE of a mapped huge page should succeed");
+
+		hugepage_pre_fault(vcpu, gpa, total_size);
+	}
+
+	close(fd);
+	kvm_vm_free(vm);
+}
+#endif
+
 int main(int argc, char *argv[])
 {
 	size_t page_size;
@@ -196,4 +297,8 @@ int main(int argc, char *argv[])
 	test_invalid_punch_hole(fd, page_size, total_size);
 
 	close(fd);
+
+#ifdef __x86_64__
+	test_hugepage();
+#endif
 }
@@ -50,6 +50,7 @@ static bool kvm_dirty_ring_full(struct kvm_dirty_ring *ring)
 	return kvm_dirty_ring_used(ring) >= ring->size;
 }
 
+/* Called with mmu_lock held for write */
 static void kvm_reset_dirty_gfn(struct kvm *kvm, u32 slot, u64 offset, u64 mask)
 {
 	struct kvm_memory_slot *memslot;
@@ -69,9 +70,7 @@ static void kvm_reset_dirty_gfn(struct kvm *kvm, u32 slot, u64 offset, u64 mask)
 	if (!memslot || (offset + __fls(mask)) >= memslot->npages)
 		return;
 
-	KVM_MMU_LOCK(kvm);
 	kvm_arch_mmu_enable_log_dirty_pt_masked(kvm, memslot, offset, mask);
-	KVM_MMU_UNLOCK(kvm);
 }
 
 int kvm_dirty_ring_alloc(struct kvm_dirty_ring *ring, int index, u32 size)
@@ -116,6 +115,12 @@ int kvm_dirty_ring_reset(struct kvm *kvm, struct kvm_dirty_ring *ring)
 	/* This is only needed to make compilers happy */
 	cur_slot = cur_offset = mask = 0;
 
+	/*
+	 * Hold mmu_lock across the whole walk rather than once per
+	 * coalesced mask, yielding it only when someone else needs it.
+	 */
+	KVM_MMU_LOCK(kvm);
+
 	while (true) {
 		entry = &ring->dirty_gfns[ring->reset_index & (ring->size - 1)];
 
@@ -155,10 +160,18 @@ int kvm_dirty_ring_reset(struct kvm *kvm, struct kvm_dirty_ring *ring)
 		cur_offset = next_offset;
 		mask = 1;
 		first_round = false;
+
+		if (need_resched() || KVM_MMU_NEEDBREAK(kvm)) {
+			KVM_MMU_UNLOCK(kvm);
+			cond_resched();
+			KVM_MMU_LOCK(kvm);
+		}
 	}
 
 	kvm_reset_dirty_gfn(kvm, cur_slot, cur_offset, mask);
 
+	KVM_MMU_UNLOCK(kvm);
+
 	/*
 	 * The request KVM_REQ_DIRTY_RING_SOFT_FULL will be cleared
 	 * by the VCPU thread next time when it enters the guest.
@@ -68,14 +68,11 @@ static int kvm_gmem_prepare_folio(struct kvm *kvm, struct kvm_memory_slot *slot,
 	 * Preparing huge folios should always be safe, since it should
 	 * be possible to split them later if needed.
 	 *
-	 * Right now the folio order is always going to be zero, but the
-	 * code is ready for huge folios.  The only assumption is that
-	 * the base pgoff of memslots is naturally aligned with the
-	 * requested page order, ensuring that huge folios can also use
-	 * huge page table entries for GPA->HPA mapping.
-	 *
-	 * The order will be passed when creating the guest_memfd, and
-	 * checked when creating memslots.
+	 * Huge folios are only allocated for KVM_GUEST_MEMFD_ALLOW_HUGEPAGE
+	 * files, and kvm_gmem_bind() ensures that the base pgoff and gfn of
+	 * memslots bound to such files are naturally aligned with the folio
+	 * order, so that huge folios can also use huge page table entries
+	 * for GPA->HPA mapping.
 	 */
 	WARN_ON(!IS_ALIGNED(slot->gmem.pgoff, 1 << folio_order(folio)));
 	index = gfn - slot->base_gfn + slot->gmem.pgoff;
@@ -87,18 +84,69 @@ static int kvm_gmem_prepare_folio(struct kvm *kvm, struct kvm_memory_slot *slot,
 	return r;
 }
 
+static bool kvm_gmem_has_hugepages(struct inode *inode)
+{
+	return (unsigned long)inode->i_private & KVM_GUEST_MEMFD_ALLOW_HUGEPAGE;
+}
+
+static struct folio *kvm_gmem_get_huge_folio(struct inode *inode, pgoff_t index,
+					     unsigned int order)
+{
+	struct address_space *mapping = inode->i_mapping;
+	struct folio *folio;
+	gfp_t gfp;
+
+	/*
+	 * Huge pages are opportunistic, don't try too hard to allocate
+	 * them; falling back to small folios is always possible.
+	 */
+	gfp = mapping_gfp_mask(mapping) | __GFP_NORETRY | __GFP_NOWARN;
+
+	folio = filemap_alloc_folio(gfp, order);
+	if (!folio)
+		return NULL;
+
+	/*
+	 * This fails if any part of the range is already populated, either
+	 * by small folios or by a concurrent allocation of the same folio.
+	 */
+	if (filemap_add_folio(mapping, folio, round_down(index, 1ul << order), gfp)) {
+		folio_put(folio);
+		return NULL;
+	}
+
+	return folio;
+}
+
 /*
  * Returns a locked folio on success.  The caller is responsible for
  * setting the up-to-date flag before the memory is mapped into the guest.
  * There is no backing storage for the memory, so the folio will remain
  * up-to-date until it's removed.
  *
+ * If @max_order allows it and the file was created with
+ * KVM_GUEST_MEMFD_ALLOW_HUGEPAGE, try to allocate a PMD-sized folio
+ * covering @index.  The returned folio can be larger than a page even if
+ * @max_order is zero, if a huge folio already covers @index.
+ *
  * Ignore accessed, referenced, and dirty flags.  The memory is
  * unevictable and there is no storage to write back to.
  */
-static struct folio *kvm_gmem_get_folio(struct inode *inode, pgoff_t index)
+static struct folio *kvm_gmem_get_folio(struct inode *inode, pgoff_t index,
+					unsigned int max_order)
 {
-	/* TODO: Support huge pages. */
+	struct folio *folio;
+
+	if (max_order >= PMD_ORDER && kvm_gmem_has_hugepages(inode)) {
+		folio = filemap_lock_folio(inode->i_mapping, index);
+		if (!IS_ERR(folio))
+			return folio;
+
+		folio = kvm_gmem_get_huge_folio(inode, index, PMD_ORDER);
+		if (folio)
+			return folio;
+	}
+
 	return filemap_grab_folio(inode->i_mapping, index);
 }
 
@@ -192,6 +240,7 @@ static long kvm_gmem_allocate(struct inode *inode, loff_t offset, loff_t len)
 
 	r = 0;
 	for (index = start; index < end; ) {
+		unsigned int order = 0;
 		struct folio *folio;
 
 		if (signal_pending(current)) {
@@ -199,7 +248,11 @@ static long kvm_gmem_allocate(struct inode *inode, loff_t offset, loff_t len)
 			break;
 		}
 
-		folio = kvm_gmem_get_folio(inode, index);
+		if (IS_ALIGNED(index, 1ul << PMD_ORDER) &&
+		    end - index >= (1ul << PMD_ORDER))
+			order = PMD_ORDER;
+
+		folio = kvm_gmem_get_folio(inode, index, order);
 		if (IS_ERR(folio)) {
 			r = PTR_ERR(folio);
 			break;
@@ -236,6 +289,17 @@ static long kvm_gmem_fallocate(struct file *file, int mode, loff_t offset,
 	if (!PAGE_ALIGNED(offset) || !PAGE_ALIGNED(len))
 		return -EINVAL;
 
+	/*
+	 * truncate_inode_pages_range() only zeroes the part of a huge folio
+	 * that a hole covers, and the folio stays in the page cache and in
+	 * the guest's private mappings.  Huge folios are never split, so the
+	 * hole must cover whole ones.
+	 */
+	if ((mode & FALLOC_FL_PUNCH_HOLE) &&
+	    kvm_gmem_has_hugepages(file_inode(file)) &&
+	    !IS_ALIGNED(offset | len, PAGE_SIZE << PMD_ORDER))
+		return -EINVAL;
+
 	if (mode & FALLOC_FL_PUNCH_HOLE)
 		ret = kvm_gmem_punch_hole(file_inode(file), offset, len);
 	else
@@ -428,6 +492,8 @@ static int __kvm_gmem_create(struct kvm *kvm, loff_t size, u64 flags)
 	inode->i_mode |= S_IFREG;
 	inode->i_size = size;
 	mapping_set_gfp_mask(inode->i_mapping, GFP_HIGHUSER);
+	if (flags & KVM_GUEST_MEMFD_ALLOW_HUGEPAGE)
+		mapping_set_large_folios(inode->i_mapping);
 	mapping_set_inaccessible(inode->i_mapping);
 	/* Unmovable mappings are supposed to be marked unevictable as well. */
 	WARN_ON_ONCE(!mapping_unevictable(inode->i_mapping));
@@ -451,7 +517,7 @@ int kvm_gmem_create(struct kvm *kvm, struct kvm_create_guest_memfd *args)
 {
 	loff_t size = args->size;
 	u64 flags = args->flags;
-	u64 valid_flags = 0;
+	u64 valid_flags = KVM_GUEST_MEMFD_ALLOW_HUGEPAGE;
 
 	if (flags & ~valid_flags)
 		return -EINVAL;
@@ -459,6 +525,10 @@ int kvm_gmem_create(struct kvm *kvm, struct kvm_create_guest_memfd *args)
 	if (size <= 0 || !PAGE_ALIGNED(size))
 		return -EINVAL;
 
+	if ((flags & KVM_GUEST_MEMFD_ALLOW_HUGEPAGE) &&
+	    !IS_ALIGNED(size, PAGE_SIZE << PMD_ORDER))
+		return -EINVAL;
+
 	return __kvm_gmem_create(kvm, size, flags);
 }
 
@@ -491,6 +561,15 @@ int kvm_gmem_bind(struct kvm *kvm, struct kvm_memory_slot *slot,
 	    offset + size > i_size_read(inode))
 		goto err;
 
+	/*
+	 * Huge folios must not straddle bindings, and must be mappable with
+	 * huge page table entries.
+	 */
+	if (kvm_gmem_has_hugepages(inode) &&
+	    (!IS_ALIGNED(offset | size, PAGE_SIZE << PMD_ORDER) ||
+	     !IS_ALIGNED(slot->base_gfn, 1ul << PMD_ORDER)))
+		goto err;
+
 	filemap_invalidate_lock(inode->i_mapping);
 
 	start = offset >> PAGE_SHIFT;
@@ -553,8 +632,8 @@ void kvm_gmem_unbind(struct kvm_memory_slot *slot)
 /* Returns a locked folio on success.  */
 static struct folio *
 __kvm_gmem_get_pfn(struct file *file, struct kvm_memory_slot *slot,
-		   gfn_t gfn, kvm_pfn_t *pfn, bool *is_prepared,
-		   int *max_order)
+		   gfn_t gfn, unsigned int alloc_order, kvm_pfn_t *pfn,
+		   bool *is_prepared, int *max_order)
 {
 	pgoff_t index = gfn - slot->base_gfn + slot->gmem.pgoff;
 	struct kvm_gmem *gmem = file->private_data;
@@ -571,7 +650,7 @@ __kvm_gmem_get_pfn(struct file *file, struct kvm_memory_slot *slot,
 		return ERR_PTR(-EIO);
 	}
 
-	folio = kvm_gmem_get_folio(file_inode(file), index);
+	folio = kvm_gmem_get_folio(file_inode(file), index, alloc_order);
 	if (IS_ERR(folio))
 		return folio;
 
@@ -583,7 +662,7 @@ __kvm_gmem_get_pfn(struct file *file, struct kvm_memory_slot *slot,
 
 	*pfn = folio_file_pfn(folio, index);
 	if (max_order)
-		*max_order = 0;
+		*max_order = folio_order(folio);
 
 	*is_prepared = folio_test_uptodate(folio);
 	return folio;
@@ -600,7 +679,8 @@ int kvm_gmem_get_pfn(struct kvm *kvm, struct kvm_memory_slot *slot,
 	if (!file)
 		return -EFAULT;
 
-	folio = __kvm_gmem_get_pfn(file, slot, gfn, pfn, &is_prepared, max_order);
+	folio = __kvm_gmem_get_pfn(file, slot, gfn, PMD_ORDER, pfn, &is_prepared,
+				   max_order);
 	if (IS_ERR(folio)) {
 		r = PTR_ERR(folio);
 		goto out;
@@ -648,6 +728,7 @@ long kvm_gmem_populate(struct kvm *kvm, gfn_t start_gfn, void __user *src, long
 	for (i = 0; i < npages; i += (1 << max_order)) {
 		struct folio *folio;
 		gfn_t gfn = start_gfn + i;
+		unsigned int order = 0;
 		bool is_prepared = false;
 		kvm_pfn_t pfn;
 
@@ -656,7 +737,13 @@ long kvm_gmem_populate(struct kvm *kvm, gfn_t start_gfn, void __user *src, long
 			break;
 		}
 
-		folio = __kvm_gmem_get_pfn(file, slot, gfn, &pfn, &is_prepared, &max_order);
+		/* Only allocate a huge folio if it can be populated in full.  */
+		if (IS_ALIGNED(gfn, 1ul << PMD_ORDER) &&
+		    npages - i >= (1ul << PMD_ORDER))
+			order = PMD_ORDER;
+
+		folio = __kvm_gmem_get_pfn(file, slot, gfn, order, &pfn, &is_prepared,
+					   &max_order);
 		if (IS_ERR(folio)) {
 			ret = PTR_ERR(folio);
 			break;
@@ -670,14 +757,21 @@ long kvm_gmem_populate(struct kvm *kvm, gfn_t start_gfn, void __user *src, long
 		}
 
 		folio_unlock(folio);
-		WARN_ON(!IS_ALIGNED(gfn, 1 << max_order) ||
-			(npages - i) < (1 << max_order));
 
+		/*
+		 * The up-to-date flag covers the whole folio, so a huge folio
+		 * (e.g. one allocated by a previous fault or fallocate) must be
+		 * populated in full and must be entirely private.
+		 */
 		ret = -EINVAL;
+		if (!IS_ALIGNED(gfn, 1 << max_order) ||
+		    (npages - i) < (1 << max_order))
+			goto put_folio_and_exit;
+
 		while (!kvm_range_has_memory_attributes(kvm, gfn, gfn + (1 << max_order),
 							KVM_MEMORY_ATTRIBUTE_PRIVATE,
 							KVM_MEMORY_ATTRIBUTE_PRIVATE)) {
-			if (!max_order)
+			if (!max_order || folio_order(folio))
 				goto put_folio_and_exit;
 			max_order--;
 		}